@@ -0,0 +1,65 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.benchmark;
+
+import java.io.IOException;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+import java.util.Random;
+
+/**
+ * Inputs shared by benchmarks.
+ */
+final class BenchmarkData {
+
+    private static final String[] WORDS = {
+            "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "was", "with",
+            "<div class=\"item\">", "</div>", "{\"id\":", "\"name\":", "function", "return",
+            "var", "null", "true", "false", "https://", ".com/", "brotli", "compression"
+    };
+
+    private BenchmarkData() {
+    }
+
+    /**
+     * Returns contents of the given file, or text-like data of the given size if the path is empty.
+     *
+     * @param path corpus file, e.g. a file of the Silesia or Canterbury corpus
+     * @param size size of generated data
+     */
+    static byte[] load(String path, int size) throws IOException {
+        if (!path.isEmpty()) {
+            return Files.readAllBytes(Paths.get(path));
+        }
+        Random random = new Random(42);
+        StringBuilder text = new StringBuilder(size + 32);
+        while (text.length() < size) {
+            if (random.nextInt(8) == 0) {
+                text.append(random.nextInt(100000));
+            } else {
+                text.append(WORDS[random.nextInt(WORDS.length)]);
+            }
+            text.append(random.nextInt(6) == 0 ? '\n' : ' ');
+        }
+        byte[] data = new byte[size];
+        for (int i = 0; i < size; i++) {
+            data[i] = (byte) text.charAt(i);
+        }
+        return data;
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.benchmark;
+
+import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.decoder.BrotliInputStream;
+import com.aayushatharva.brotli4j.decoder.Decoder;
+import com.aayushatharva.brotli4j.decoder.DirectDecompress;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.Warmup;
+
+import java.io.ByteArrayInputStream;
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Decompression through the public API; compare with {@code brotli_bench} of the native build
+ * to see the JNI overhead.
+ */
+@State(Scope.Thread)
+@BenchmarkMode(Mode.AverageTime)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+@Warmup(iterations = 3, time = 2)
+@Measurement(iterations = 5, time = 2)
+@Fork(1)
+public class DecoderBenchmark {
+
+    /**
+     * Corpus file; empty for generated text of {@link #size} bytes.
+     */
+    @Param("")
+    public String file;
+
+    @Param({"1024", "65536", "1048576"})
+    public int size;
+
+    @Param({"5", "11"})
+    public int quality;
+
+    private byte[] compressed;
+    private ByteBuffer output;
+    private byte[] chunk;
+
+    @Setup
+    public void setup() throws IOException {
+        Brotli4jLoader.ensureAvailability();
+        byte[] data = BenchmarkData.load(file, size);
+        compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(quality));
+        output = ByteBuffer.allocateDirect(data.length);
+        chunk = new byte[16384];
+    }
+
+    @Benchmark
+    public DirectDecompress decompress() throws IOException {
+        return Decoder.decompress(compressed);
+    }
+
+    @Benchmark
+    public int decompressDirect() throws IOException {
+        ((Buffer) output).clear();
+        return Decoder.decompress(compressed, output);
+    }
+
+    @Benchmark
+    public long inputStream() throws IOException {
+        long total = 0;
+        try (BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed))) {
+            int read;
+            while ((read = input.read(chunk)) != -1) {
+                total += read;
+            }
+        }
+        return total;
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.benchmark;
+
+import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.encoder.BrotliOutputStream;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.Warmup;
+
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Compression through the public API; compare with {@code brotli_bench} of the native build
+ * to see the JNI overhead.
+ */
+@State(Scope.Thread)
+@BenchmarkMode(Mode.AverageTime)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+@Warmup(iterations = 3, time = 2)
+@Measurement(iterations = 5, time = 2)
+@Fork(1)
+public class EncoderBenchmark {
+
+    /**
+     * Corpus file; empty for generated text of {@link #size} bytes.
+     */
+    @Param("")
+    public String file;
+
+    @Param({"1024", "65536", "1048576"})
+    public int size;
+
+    @Param({"1", "5", "9", "11"})
+    public int quality;
+
+    private byte[] data;
+    private Encoder.Parameters params;
+    private ByteBuffer directInput;
+    private ByteBuffer directOutput;
+    private ByteArrayOutputStream sink;
+
+    @Setup
+    public void setup() throws IOException {
+        Brotli4jLoader.ensureAvailability();
+        data = BenchmarkData.load(file, size);
+        params = new Encoder.Parameters().setQuality(quality);
+        directInput = ByteBuffer.allocateDirect(data.length);
+        directInput.put(data);
+        directOutput = ByteBuffer.allocateDirect(Encoder.maxCompressedSize(data.length));
+        sink = new ByteArrayOutputStream(data.length);
+    }
+
+    @Benchmark
+    public byte[] compress() throws IOException {
+        return Encoder.compress(data, params);
+    }
+
+    @Benchmark
+    public int compressDirect() throws IOException {
+        ((Buffer) directInput).clear();
+        ((Buffer) directOutput).clear();
+        return Encoder.compress(directInput, directOutput, params);
+    }
+
+    @Benchmark
+    public int outputStream() throws IOException {
+        sink.reset();
+        try (BrotliOutputStream output = new BrotliOutputStream(sink, params)) {
+            output.write(data);
+        }
+        return sink.size();
+    }
+}
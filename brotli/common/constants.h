@@ -107,6 +107,11 @@ typedef struct BrotliDistanceCodeLimit {
   uint32_t max_distance;
 } BrotliDistanceCodeLimit;
 
+/* Body of the metadata block written with BROTLI_PARAM_DECLARE_SIZE: "Size"
+   followed by little-endian 64-bit uncompressed size of the stream. */
+#define BROTLI_SIZE_METADATA_MAGIC 0x657A6953u
+#define BROTLI_SIZE_METADATA_LENGTH 12
+
 /* This function calculates maximal size of distance alphabet, such that the
    distances greater than the given values can not be represented.
 
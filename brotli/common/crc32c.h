@@ -0,0 +1,23 @@
+/* Copyright 2024 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Checksum of uncompressed data, see ::BROTLI_PARAM_CHECKSUM. */
+
+#ifndef BROTLI_COMMON_CRC32C_H_
+#define BROTLI_COMMON_CRC32C_H_
+
+#include <brotli/port.h>
+#include <brotli/types.h>
+
+/* Trailing metadata block body: "crcC" followed by little-endian CRC-32C. */
+#define BROTLI_CHECKSUM_TRAILER_SIZE 8
+#define BROTLI_CHECKSUM_TRAILER_MAGIC 0x43637263u  /* "crcC" */
+
+/* Continues CRC-32C |crc| with |size| bytes of |data|; start with 0. */
+BROTLI_COMMON_API uint32_t BrotliCrc32c(
+    uint32_t crc, const uint8_t* data, size_t size);
+
+#endif  /* BROTLI_COMMON_CRC32C_H_ */
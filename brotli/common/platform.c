@@ -5,6 +5,7 @@
 */
 
 #include <stdlib.h>
+#include <time.h>  /* clock */
 
 #include "./platform.h"
 #include <brotli/types.h>
@@ -20,3 +21,20 @@ void BrotliDefaultFreeFunc(void* opaque, void* address) {
   BROTLI_UNUSED(opaque);
   free(address);
 }
+
+uint64_t BrotliReadTicks(void) {
+#if (defined(BROTLI_TARGET_X64) || defined(BROTLI_TARGET_X86)) && \
+    BROTLI_MSVC_VERSION_CHECK(18, 0, 0)
+  return (uint64_t)__rdtsc();
+#elif (defined(BROTLI_TARGET_X64) || defined(BROTLI_TARGET_X86)) && \
+    (defined(__GNUC__) || defined(__clang__))
+  return (uint64_t)__builtin_ia32_rdtsc();
+#elif defined(BROTLI_TARGET_ARMV8_64) && \
+    (defined(__GNUC__) || defined(__clang__))
+  uint64_t ticks;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return (uint64_t)clock();
+#endif
+}
@@ -18,6 +18,7 @@
     * BROTLI_DEBUG dumps file name and line number when decoder detects stream
       or memory error
     * BROTLI_ENABLE_LOG enables asserts and dumps various state information
+    * BROTLI_ENABLE_USDT enables static tracing probes, see probes.h
 */
 
 #ifndef BROTLI_COMMON_PLATFORM_H_
@@ -86,6 +87,15 @@ OR:
 #define BROTLI_PREDICT_TRUE(x) (x)
 #endif
 
+/* Define "BROTLI_PREFETCH" macro: hint that the cache line holding the given
+   address is going to be read soon. No-op for incapable compilers. */
+#if BROTLI_GNUC_HAS_BUILTIN(__builtin_prefetch, 3, 1, 0) || \
+    BROTLI_INTEL_VERSION_CHECK(16, 0, 0)
+#define BROTLI_PREFETCH(p) __builtin_prefetch((p))
+#else
+#define BROTLI_PREFETCH(p)
+#endif
+
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L) && \
     !defined(__cplusplus)
 #define BROTLI_RESTRICT restrict
@@ -561,6 +571,10 @@ BROTLI_COMMON_API void* BrotliDefaultAllocFunc(void* opaque, size_t size);
 /* Default brotli_free_func */
 BROTLI_COMMON_API void BrotliDefaultFreeFunc(void* opaque, void* address);
 
+/* Reads a cheap monotonic counter for work statistics: time-stamp counter
+   on x86, virtual counter on ARM64, clock() elsewhere. */
+BROTLI_COMMON_API uint64_t BrotliReadTicks(void);
+
 BROTLI_UNUSED_FUNCTION void BrotliSuppressUnusedFunctions(void) {
   BROTLI_UNUSED(&BrotliSuppressUnusedFunctions);
   BROTLI_UNUSED(&BrotliUnalignedRead16);
@@ -0,0 +1,56 @@
+/* Copyright 2024 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Static tracing probes (USDT) of provider "brotli".
+
+   Built with BROTLI_ENABLE_USDT on a platform with <sys/sdt.h> (SystemTap
+   headers), every probe is a single nop instruction plus an ELF note; tools
+   like bpftrace or perf attach to it at run time:
+
+     bpftrace -e 'usdt:libbrotli.so:brotli:metablock_end { @[arg3] = hist(arg1); }'
+
+   Otherwise probes expand to nothing. Arguments are evaluated only in the
+   former case, so they MUST NOT have side effects.
+
+   Hasher type is meaningless for qualities 0 and 1, which use hash tables of
+   their own.
+
+   Encoder probes:
+     encoder_create(state)
+     encoder_destroy(state, total_out)
+     metablock_start(state, quality, hasher_type)
+     metablock_end(state, input_size, output_size, quality)
+     flush(state, total_out)
+     encoder_ringbuffer_grow(ringbuffer, size)
+   Decoder probes:
+     decoder_create(state)
+     decoder_destroy(state)
+     decoder_ringbuffer_grow(state, size)
+     decode_error(state, error_code) */
+
+#ifndef BROTLI_COMMON_PROBES_H_
+#define BROTLI_COMMON_PROBES_H_
+
+#if defined(BROTLI_ENABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BROTLI_HAVE_USDT 1
+#endif
+#endif
+
+#if defined(BROTLI_HAVE_USDT)
+#define BROTLI_PROBE1(name, a) DTRACE_PROBE1(brotli, name, a)
+#define BROTLI_PROBE2(name, a, b) DTRACE_PROBE2(brotli, name, a, b)
+#define BROTLI_PROBE3(name, a, b, c) DTRACE_PROBE3(brotli, name, a, b, c)
+#define BROTLI_PROBE4(name, a, b, c, d) DTRACE_PROBE4(brotli, name, a, b, c, d)
+#else
+#define BROTLI_PROBE1(name, a)
+#define BROTLI_PROBE2(name, a, b)
+#define BROTLI_PROBE3(name, a, b, c)
+#define BROTLI_PROBE4(name, a, b, c, d)
+#endif
+
+#endif  /* BROTLI_COMMON_PROBES_H_ */
@@ -164,6 +164,27 @@ static BROTLI_INLINE void BrotliFillBitWindow(
 #endif
 }
 
+/* Wide bit window: on 64-bit targets with cheap unaligned loads the
+   accumulator can be refilled to at least 57 bits without branching. */
+#define BROTLI_WIDE_BIT_WINDOW (BROTLI_64_BITS && !BROTLI_ALIGNED_READ)
+
+#if BROTLI_WIDE_BIT_WINDOW
+/* Guarantees that there are at least 57 bits in accumulator.
+   Whole consumed bytes are dropped and replaced with the next input bytes
+   from a single unaligned 64-bit load; no more than 7 bytes are consumed.
+   Precondition: accumulator contains at least 1 bit and at least 8 bytes of
+   input are available. */
+static BROTLI_INLINE void BrotliFillBitWindowWide(BrotliBitReader* const br) {
+  uint32_t drop = br->bit_pos_ & ~7u;
+  /* Split shift keeps the count below 64 when nothing is dropped. */
+  br->val_ = (br->val_ >> drop) |
+             ((BROTLI_UNALIGNED_LOAD64LE(br->next_in) << 1) << (63 - drop));
+  br->bit_pos_ ^= drop;
+  br->avail_in -= drop >> 3;
+  br->next_in += drop >> 3;
+}
+#endif  /* BROTLI_WIDE_BIT_WINDOW */
+
 /* Mostly like BrotliFillBitWindow, but guarantees only 16 bits and reads no
    more than BROTLI_SHORT_FILL_BIT_WINDOW_READ bytes of input. */
 static BROTLI_INLINE void BrotliFillBitWindow16(BrotliBitReader* const br) {
@@ -243,6 +264,57 @@ static BROTLI_INLINE void BrotliBitReaderUnload(BrotliBitReader* br) {
   br->bit_pos_ += unused_bits;
 }
 
+/* Copies the next |n_bits| bits after the |from| position to |dst| without
+   consuming them. Bits are packed to bytes LSB-first, the last byte is padded
+   with zeros. Returns BROTLI_FALSE if there is not enough input. */
+static BROTLI_INLINE BROTLI_BOOL BrotliPeekBitString(
+    const BrotliBitReaderState* from, size_t n_bits, uint8_t* dst) {
+  uint32_t available = (BROTLI_64_BITS ? 64 : 32) - from->bit_pos_;
+  brotli_reg_t val = (available != 0) ? (from->val_ >> from->bit_pos_) : 0;
+  const uint8_t* next_in = from->next_in;
+  size_t left = n_bits;
+  if (n_bits > available &&
+      ((n_bits - available + 7) >> 3) > from->avail_in) {
+    return BROTLI_FALSE;
+  }
+  while (available >= 8 && left > 0) {
+    *dst++ = (uint8_t)val;
+    val >>= 8;
+    available -= 8;
+    left = (left > 8) ? left - 8 : 0;
+  }
+  /* Less than a byte is left in |val|; the rest comes from input. */
+  while (left > available) {
+    uint32_t byte = *next_in++;
+    *dst++ = (uint8_t)(val | (byte << available));
+    val = byte >> (8 - available);
+    left = (left > 8) ? left - 8 : 0;
+  }
+  if (left > 0) *dst++ = (uint8_t)val;
+  if ((n_bits & 7) != 0) dst[-1] &= (uint8_t)BitMask(n_bits & 7);
+  return BROTLI_TRUE;
+}
+
+/* Advances the bit pos by |n_bits|, consuming input as needed.
+   Precondition: there is enough input, e.g. they were peeked successfully with
+   BrotliPeekBitString. */
+static BROTLI_INLINE void BrotliSkipBits(
+    BrotliBitReader* const br, size_t n_bits) {
+  uint32_t available = BrotliGetAvailableBits(br);
+  size_t n_bytes;
+  if (n_bits < available) {
+    BrotliDropBits(br, (uint32_t)n_bits);
+    return;
+  }
+  BrotliDropBits(br, available);
+  n_bits -= available;
+  n_bytes = n_bits >> 3;
+  br->avail_in -= n_bytes;
+  br->next_in += n_bytes;
+  /* Keep accumulator non-empty, as fast refills expect. */
+  if (BrotliPullByte(br)) BrotliDropBits(br, (uint32_t)(n_bits & 7));
+}
+
 /* Reads the specified number of bits from |br| and advances the bit pos.
    Precondition: accumulator MUST contain at least |n_bits|. */
 static BROTLI_INLINE void BrotliTakeBits(
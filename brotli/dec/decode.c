@@ -11,8 +11,10 @@
 
 #include "../common/constants.h"
 #include "../common/context.h"
+#include "../common/crc32c.h"
 #include "../common/dictionary.h"
 #include "../common/platform.h"
+#include "../common/probes.h"
 #include "../common/shared_dictionary_internal.h"
 #include "../common/transform.h"
 #include "../common/version.h"
@@ -71,6 +73,27 @@ BROTLI_BOOL BrotliDecoderSetParameter(
       state->large_window = TO_BROTLI_BOOL(!!value);
       return BROTLI_TRUE;
 
+    case BROTLI_DECODER_PARAM_HUFFMAN_TABLE_CACHE:
+      state->huffman_table_cache = !!value ? 1 : 0;
+      return BROTLI_TRUE;
+
+    case BROTLI_DECODER_PARAM_STREAM_OFFSET:
+      /* Clamped to window size once it is known. */
+      state->stream_offset = (int)BROTLI_MIN(uint32_t, value, 1u << 30);
+      return BROTLI_TRUE;
+
+    case BROTLI_DECODER_PARAM_LOW_MEMORY:
+      state->low_memory = !!value ? 1 : 0;
+      return BROTLI_TRUE;
+
+    case BROTLI_DECODER_PARAM_COLLECT_STATS:
+      state->collect_stats = !!value ? 1 : 0;
+      return BROTLI_TRUE;
+
+    case BROTLI_DECODER_PARAM_CHECKSUM:
+      state->checksum = !!value ? 1 : 0;
+      return BROTLI_TRUE;
+
     default: return BROTLI_FALSE;
   }
 }
@@ -96,6 +119,7 @@ BrotliDecoderState* BrotliDecoderCreateInstance(
     }
     return 0;
   }
+  BROTLI_PROBE1(decoder_create, state);
   return state;
 }
 
@@ -106,11 +130,17 @@ void BrotliDecoderDestroyInstance(BrotliDecoderState* state) {
   } else {
     brotli_free_func free_func = state->free_func;
     void* opaque = state->memory_manager_opaque;
+    BROTLI_PROBE1(decoder_destroy, state);
     BrotliDecoderStateCleanup(state);
     free_func(opaque, state);
   }
 }
 
+BROTLI_BOOL BrotliDecoderResetInstance(BrotliDecoderState* state) {
+  if (!state) return BROTLI_FALSE;
+  return BrotliDecoderStateReset(state);
+}
+
 /* Saves error code and converts it to BrotliDecoderResult. */
 static BROTLI_NOINLINE BrotliDecoderResult SaveErrorCode(
     BrotliDecoderState* s, BrotliDecoderErrorCode e) {
@@ -126,6 +156,7 @@ static BROTLI_NOINLINE BrotliDecoderResult SaveErrorCode(
       return BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
 
     default:
+      BROTLI_PROBE2(decode_error, s, s->error_code);
       return BROTLI_DECODER_RESULT_ERROR;
   }
 }
@@ -178,6 +209,43 @@ static BROTLI_INLINE void memmove16(uint8_t* dst, uint8_t* src) {
 #endif
 }
 
+/* Backward copies from closer than that are assumed to hit the cache. */
+#define BROTLI_PREFETCH_MIN_DISTANCE (1 << 18)
+
+/* Hints the cache lines that a copy from |distance| bytes before |pos| reads
+   first; both, as 16 bytes from any offset may straddle a line. Copies are
+   made right after the distance is known, so the hint pays off for copies
+   whose source is far enough to be evicted. */
+static BROTLI_INLINE void PrefetchCopySource(
+    const BrotliDecoderState* s, int pos, int distance) {
+  if (distance >= BROTLI_PREFETCH_MIN_DISTANCE) {
+    const uint8_t* src = &s->ringbuffer[(pos - distance) & s->ringbuffer_mask];
+    BROTLI_PREFETCH(src);
+    BROTLI_PREFETCH(src + 63);
+  }
+}
+
+/* Largest multiple of distance that is not bigger than 16. */
+static const uint8_t kRepeatStep[16] = {
+  0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15
+};
+
+/* Copies |len| bytes from |distance| bytes before |dst|, where the regions
+   overlap. Each 16-byte copy reads only bytes that are already written; up
+   to 15 bytes are written past the end, as by the first guess copy. */
+static BROTLI_INLINE void CopyRepeated(uint8_t* dst, int distance, int len) {
+  int k;
+  if (distance >= 16) {
+    for (k = 0; k < len; k += 16) memmove16(dst + k, dst + k - distance);
+  } else {
+    /* Short distances, e.g. runs of RLE-like data: start the pattern, then
+       repeat it by whole periods. */
+    int step = kRepeatStep[distance];
+    for (k = 0; k < 16; ++k) dst[k] = dst[k - distance];
+    for (k = step; k < len; k += step) memmove16(dst + k, dst + k - step);
+  }
+}
+
 /* Decodes a number in the range [0..255], by reading 1 - 11 bits. */
 static BROTLI_NOINLINE BrotliDecoderErrorCode DecodeVarLenUint8(
     BrotliDecoderState* s, BrotliBitReader* br, uint32_t* value) {
@@ -461,6 +529,143 @@ static BROTLI_INLINE uint32_t ReadPreloadedSymbol(const HuffmanCode* table,
   return result;
 }
 
+/* Two-literal look-up table is indexed by that many next bits. */
+#define BROTLI_LITERAL_PAIR_BITS 11
+/* Table is built only if at least that many literals are decoded with the
+   same tree; otherwise building costs more than it saves. */
+#define BROTLI_LITERAL_PAIR_MIN_RUN 8192
+
+/* Fills the table of literals decodable from the next
+   BROTLI_LITERAL_PAIR_BITS bits with s->literal_htree. Entry holds the number
+   of bits to drop in bits 0-7, the first literal in bits 8-15, the second
+   literal in bits 16-23, and the flag of the second literal presence in bit
+   24. Entry is 0 if the first code does not fit the root table. */
+static BROTLI_NOINLINE BROTLI_BOOL BuildLiteralPairs(BrotliDecoderState* s) {
+  const HuffmanCode* table = s->literal_htree;
+  uint32_t* pairs = s->literal_pairs;
+  uint32_t idx;
+  if (!pairs) {
+    pairs = (uint32_t*)BROTLI_DECODER_ALLOC(s,
+        sizeof(uint32_t) << BROTLI_LITERAL_PAIR_BITS);
+    if (!pairs) return BROTLI_FALSE;
+    s->literal_pairs = pairs;
+  }
+  for (idx = 0; idx < (1u << BROTLI_LITERAL_PAIR_BITS); ++idx) {
+    const HuffmanCode* first = table;
+    const HuffmanCode* second = table;
+    uint32_t bits;
+    uint32_t entry;
+    BROTLI_HC_MARK_TABLE_FOR_FAST_LOAD(first);
+    BROTLI_HC_MARK_TABLE_FOR_FAST_LOAD(second);
+    BROTLI_HC_ADJUST_TABLE_INDEX(first, idx & HUFFMAN_TABLE_MASK);
+    bits = BROTLI_HC_FAST_LOAD_BITS(first);
+    if (bits > HUFFMAN_TABLE_BITS) {
+      pairs[idx] = 0;
+      continue;
+    }
+    entry = bits | (BROTLI_HC_FAST_LOAD_VALUE(first) << 8);
+    /* Bits above the table index are zero, so a code that is not longer than
+       the rest of index is matched by any of its replicated entries. Root
+       entries of longer codes point to second level tables instead. */
+    BROTLI_HC_ADJUST_TABLE_INDEX(second, (idx >> bits) & HUFFMAN_TABLE_MASK);
+    if (BROTLI_HC_FAST_LOAD_BITS(second) <= HUFFMAN_TABLE_BITS &&
+        BROTLI_HC_FAST_LOAD_BITS(second) <= BROTLI_LITERAL_PAIR_BITS - bits) {
+      entry = (bits + BROTLI_HC_FAST_LOAD_BITS(second)) |
+          (entry & 0xFF00u) | (BROTLI_HC_FAST_LOAD_VALUE(second) << 16) |
+          (1u << 24);
+    }
+    pairs[idx] = entry;
+  }
+  s->literal_pairs_tree = table;
+  return BROTLI_TRUE;
+}
+
+/* Checks if literals could be decoded 2 at a time; builds table if needed. */
+static BROTLI_INLINE BROTLI_BOOL PrepareLiteralPairs(BrotliDecoderState* s,
+                                                    int insert_length) {
+  uint32_t run;
+  if (s->literal_pairs_tree == s->literal_htree) return BROTLI_TRUE;
+  run = BROTLI_MIN(uint32_t, s->block_length[0],
+      (uint32_t)(s->meta_block_remaining_len + insert_length));
+  if (run < BROTLI_LITERAL_PAIR_MIN_RUN) return BROTLI_FALSE;
+  return BuildLiteralPairs(s);
+}
+
+/* Decodes one or two literals with the pair table; the next 15 bits MUST be
+   in the bit window. Returns the number of literals written to |dst|; one
+   more byte might be written. */
+static BROTLI_INLINE int DecodeLiteralPair(const uint32_t* pairs,
+    const HuffmanCode* table, BrotliBitReader* br, uint8_t* dst) {
+  uint32_t entry = pairs[BrotliGetBitsUnmasked(br) &
+      BitMask(BROTLI_LITERAL_PAIR_BITS)];
+  if (BROTLI_PREDICT_FALSE(entry == 0)) {
+    dst[0] = (uint8_t)DecodeSymbol(
+        (uint32_t)BrotliGetBitsUnmasked(br), table, br);
+    return 1;
+  }
+  BrotliDropBits(br, entry & 0xFF);
+  dst[0] = (uint8_t)(entry >> 8);
+  dst[1] = (uint8_t)(entry >> 16);
+  return 1 + (int)((entry >> 24) & 1);
+}
+
+/* Decodes up to |count| - 1 literals of a block with trivial literal context
+   into the ring-buffer at |pos|. The last literal, block end and ring-buffer
+   end are left to the generic loop, as well as input shortage. Bit reader is
+   copied to a local, so that the bit window stays in registers; this loop
+   is also kept out of ProcessCommandsInternal to spare its registers.
+   Returns the number of decoded literals. */
+static BROTLI_NOINLINE int DecodeTrivialContextLiterals(
+    BrotliDecoderState* s, int pos, int count) {
+  BrotliBitReader br = s->br;
+  uint8_t* BROTLI_RESTRICT dst = &s->ringbuffer[pos];
+  const HuffmanCode* table = s->literal_htree;
+  int limit = BROTLI_MIN(int, count, s->ringbuffer_size - pos) - 1;
+  int n = 0;
+  if (s->block_length[0] <= (uint32_t)limit) {
+    limit = (int)s->block_length[0] - 1;
+  }
+  if (PrepareLiteralPairs(s, count)) {
+    const uint32_t* pairs = s->literal_pairs;
+    /* 3 lookups of up to 15 bits per refill. */
+    while (n + 6 <= limit && BrotliCheckInputAmount(&br, 28)) {
+#if BROTLI_WIDE_BIT_WINDOW
+      BrotliFillBitWindowWide(&br);
+      n += DecodeLiteralPair(pairs, table, &br, &dst[n]);
+      n += DecodeLiteralPair(pairs, table, &br, &dst[n]);
+      n += DecodeLiteralPair(pairs, table, &br, &dst[n]);
+#else
+      BrotliFillBitWindow16(&br);
+      n += DecodeLiteralPair(pairs, table, &br, &dst[n]);
+      BrotliFillBitWindow16(&br);
+      n += DecodeLiteralPair(pairs, table, &br, &dst[n]);
+      BrotliFillBitWindow16(&br);
+      n += DecodeLiteralPair(pairs, table, &br, &dst[n]);
+#endif
+    }
+  } else {
+    while (n + 3 <= limit && BrotliCheckInputAmount(&br, 28)) {
+#if BROTLI_WIDE_BIT_WINDOW
+      BrotliFillBitWindowWide(&br);
+      dst[n] = (uint8_t)DecodeSymbol(
+          (uint32_t)BrotliGetBitsUnmasked(&br), table, &br);
+      dst[n + 1] = (uint8_t)DecodeSymbol(
+          (uint32_t)BrotliGetBitsUnmasked(&br), table, &br);
+      dst[n + 2] = (uint8_t)DecodeSymbol(
+          (uint32_t)BrotliGetBitsUnmasked(&br), table, &br);
+#else
+      dst[n] = (uint8_t)ReadSymbol(table, &br);
+      dst[n + 1] = (uint8_t)ReadSymbol(table, &br);
+      dst[n + 2] = (uint8_t)ReadSymbol(table, &br);
+#endif
+      n += 3;
+    }
+  }
+  s->br = br;
+  s->block_length[0] -= (uint32_t)n;
+  return n;
+}
+
 static BROTLI_INLINE uint32_t Log2Floor(uint32_t x) {
   uint32_t result = 0;
   while (x) {
@@ -746,11 +951,9 @@ static BrotliDecoderErrorCode ReadCodeLengthCodeLengths(BrotliDecoderState* s) {
          encoded with predefined entropy code. 32 - 74 bits are used.
     B.2) Decoded table is used to decode code lengths of symbols in resulting
          Huffman table. In worst case 3520 bits are read. */
-static BrotliDecoderErrorCode ReadHuffmanCode(uint32_t alphabet_size_max,
-                                              uint32_t alphabet_size_limit,
-                                              HuffmanCode* table,
-                                              uint32_t* opt_table_size,
-                                              BrotliDecoderState* s) {
+static BrotliDecoderErrorCode ReadHuffmanCodeInternal(
+    uint32_t alphabet_size_max, uint32_t alphabet_size_limit,
+    HuffmanCode* table, uint32_t* opt_table_size, BrotliDecoderState* s) {
   BrotliBitReader* br = &s->br;
   BrotliMetablockHeaderArena* h = &s->arena.header;
   /* State machine. */
@@ -870,6 +1073,142 @@ static BrotliDecoderErrorCode ReadHuffmanCode(uint32_t alphabet_size_max,
   }
 }
 
+/* Looks up the code that starts at the current position in the table cache.
+   On hit, code bits are skipped and the cached table is copied to |table|.
+   On miss, cache entry to be filled after decoding is remembered in the
+   header arena, if the code was seen recently. */
+static BROTLI_BOOL LookupHuffmanCode(uint32_t alphabet_size_max,
+    uint32_t alphabet_size_limit, HuffmanCode* table, uint32_t* table_size,
+    BrotliDecoderState* s) {
+  BrotliMetablockHeaderArena* h = &s->arena.header;
+  uint8_t bits[BROTLI_HUFFMAN_CACHE_MAX_CODE_BYTES];
+  BrotliHuffmanCacheEntry* entry;
+  uint64_t prefix = 0;
+  size_t i;
+  h->cache_entry = NULL;
+  BrotliBitReaderSaveState(&s->br, &h->cache_start);
+  if (!BrotliPeekBitString(&h->cache_start, 64, bits)) return BROTLI_FALSE;
+  for (i = 0; i < 8; ++i) prefix |= (uint64_t)bits[i] << (i * 8);
+  /* Simple codes are cheap to build. */
+  if ((prefix & 3) == 1) return BROTLI_FALSE;
+
+  if (!s->huffman_cache) {
+    size_t size = sizeof(BrotliHuffmanCacheEntry) << BROTLI_HUFFMAN_CACHE_BITS;
+    s->huffman_cache = (BrotliHuffmanCacheEntry*)BROTLI_DECODER_ALLOC(s, size);
+    if (!s->huffman_cache) return BROTLI_FALSE;
+    memset(s->huffman_cache, 0, size);
+  }
+  entry = &s->huffman_cache[((prefix ^ alphabet_size_limit) *
+      BROTLI_MAKE_UINT64_T(0x1FE35A7B, 0xD3579BD3)) >> (64 - BROTLI_HUFFMAN_CACHE_BITS)];
+  if (entry->prefix != prefix ||
+      entry->alphabet_size_max != alphabet_size_max ||
+      entry->alphabet_size_limit != alphabet_size_limit) {
+    /* First sighting; only prefix is remembered. */
+    entry->prefix = prefix;
+    entry->alphabet_size_max = (uint16_t)alphabet_size_max;
+    entry->alphabet_size_limit = (uint16_t)alphabet_size_limit;
+    entry->bit_size = 0;
+    return BROTLI_FALSE;
+  }
+  if (entry->bit_size != 0 &&
+      BrotliPeekBitString(&h->cache_start, entry->bit_size, bits) &&
+      memcmp(bits, &entry->table[entry->table_size],
+             (entry->bit_size + 7) >> 3) == 0) {
+    BrotliSkipBits(&s->br, entry->bit_size);
+    memcpy(table, entry->table, entry->table_size * sizeof(HuffmanCode));
+    *table_size = entry->table_size;
+    return BROTLI_TRUE;
+  }
+  h->cache_entry = entry;
+  return BROTLI_FALSE;
+}
+
+/* Puts the code that was just decoded from the |h->cache_start| position to
+   the cache entry chosen by LookupHuffmanCode. */
+static void StoreHuffmanCode(const HuffmanCode* table, uint32_t table_size,
+                             BrotliDecoderState* s) {
+  BrotliMetablockHeaderArena* h = &s->arena.header;
+  BrotliHuffmanCacheEntry* entry = h->cache_entry;
+  const BrotliBitReaderState* start = &h->cache_start;
+  /* Bits consumed from input, minus change of bits kept in accumulator. */
+  size_t bit_size = ((start->avail_in - s->br.avail_in) << 3) +
+      s->br.bit_pos_ - start->bit_pos_;
+  size_t size = table_size * sizeof(HuffmanCode) + ((bit_size + 7) >> 3);
+  h->cache_entry = NULL;
+  entry->bit_size = 0;
+  if (bit_size < 64 || bit_size > BROTLI_HUFFMAN_CACHE_MAX_CODE_BYTES * 8) {
+    return;
+  }
+  if (entry->capacity < size) {
+    BROTLI_DECODER_FREE(s, entry->table);
+    entry->table = (HuffmanCode*)BROTLI_DECODER_ALLOC(s, size);
+    /* Failure to allocate entry is not an error; table is just not cached. */
+    entry->capacity = entry->table ? size : 0;
+    if (!entry->table) return;
+  }
+  memcpy(entry->table, table, table_size * sizeof(HuffmanCode));
+  BrotliPeekBitString(start, bit_size, (uint8_t*)&entry->table[table_size]);
+  entry->table_size = table_size;
+  entry->bit_size = (uint32_t)bit_size;
+}
+
+/* Decodes Huffman code with ReadHuffmanCodeInternal. With huffman_table_cache
+   set, codes that are seen repeatedly are reused from the table cache, in
+   case the whole code is decoded in a single pass over the input. */
+static BrotliDecoderErrorCode ReadCachedHuffmanCode(
+    uint32_t alphabet_size_max, uint32_t alphabet_size_limit,
+    HuffmanCode* table, uint32_t* opt_table_size, BrotliDecoderState* s) {
+  BrotliMetablockHeaderArena* h = &s->arena.header;
+  BrotliDecoderErrorCode result;
+  uint32_t table_size = 0;
+  if (!s->huffman_table_cache) {
+    return ReadHuffmanCodeInternal(alphabet_size_max, alphabet_size_limit,
+                                   table, opt_table_size, s);
+  }
+  if (h->substate_huffman == BROTLI_STATE_HUFFMAN_NONE) {
+    if (LookupHuffmanCode(alphabet_size_max, alphabet_size_limit, table,
+                          &table_size, s)) {
+      if (opt_table_size) *opt_table_size = table_size;
+      return BROTLI_DECODER_SUCCESS;
+    }
+  }
+  result = ReadHuffmanCodeInternal(alphabet_size_max, alphabet_size_limit,
+                                   table, &table_size, s);
+  if (!!h->cache_entry) {
+    /* Input might be replaced after the interruption. */
+    if (result == BROTLI_DECODER_SUCCESS) {
+      StoreHuffmanCode(table, table_size, s);
+    } else {
+      h->cache_entry = NULL;
+    }
+  }
+  if (opt_table_size) *opt_table_size = table_size;
+  return result;
+}
+
+/* ReadCachedHuffmanCode, accounted in stats if collect_stats is set. Time of
+   interrupted reads is summed up; code is counted once it is complete. */
+static BrotliDecoderErrorCode ReadHuffmanCode(uint32_t alphabet_size_max,
+                                              uint32_t alphabet_size_limit,
+                                              HuffmanCode* table,
+                                              uint32_t* opt_table_size,
+                                              BrotliDecoderState* s) {
+  BrotliDecoderErrorCode result;
+  uint64_t start;
+  if (!s->collect_stats) {
+    return ReadCachedHuffmanCode(alphabet_size_max, alphabet_size_limit,
+                                 table, opt_table_size, s);
+  }
+  start = BrotliReadTicks();
+  result = ReadCachedHuffmanCode(alphabet_size_max, alphabet_size_limit,
+                                 table, opt_table_size, s);
+  s->stats[BROTLI_DECODER_STAT_PREFIX_CODE_TICKS] += BrotliReadTicks() - start;
+  if (result == BROTLI_DECODER_SUCCESS) {
+    s->stats[BROTLI_DECODER_STAT_PREFIX_CODES]++;
+  }
+  return result;
+}
+
 /* Decodes a block length by reading 3..39 bits. */
 static BROTLI_INLINE uint32_t ReadBlockLength(const HuffmanCode* table,
                                               BrotliBitReader* br) {
@@ -1262,6 +1601,96 @@ static size_t UnwrittenBytes(const BrotliDecoderState* s, BROTLI_BOOL wrap) {
   return partial_pos_rb - s->partial_pos_out;
 }
 
+/* Number of bytes decoded so far, written or not. */
+static size_t DecodedSize(const BrotliDecoderState* s) {
+  return (s->rb_roundtrips * (size_t)s->ringbuffer_size) + (size_t)s->pos;
+}
+
+/* Remembers the checksum trailer just read, if it is one. It is verified at
+   the end of stream, unless more data is decoded after it. */
+static void ReadChecksumTrailer(BrotliDecoderState* s) {
+  const uint8_t* head = s->metadata_head;
+  if (s->metadata_length != BROTLI_CHECKSUM_TRAILER_SIZE ||
+      BROTLI_UNALIGNED_LOAD32LE(head) != BROTLI_CHECKSUM_TRAILER_MAGIC) {
+    return;
+  }
+  s->checksum_trailer_seen = 1;
+  s->checksum_expected = BROTLI_UNALIGNED_LOAD32LE(head + 4);
+  s->checksum_position = DecodedSize(s);
+}
+
+/* Remembers the size declared by the metadata block just read, if it is one
+   and nothing is decoded before it. */
+static void ReadDeclaredSize(BrotliDecoderState* s) {
+  const uint8_t* head = s->metadata_head;
+  if (s->metadata_length != BROTLI_SIZE_METADATA_LENGTH ||
+      BROTLI_UNALIGNED_LOAD32LE(head) != BROTLI_SIZE_METADATA_MAGIC ||
+      DecodedSize(s) != 0 || s->declared_size_seen) {
+    return;
+  }
+  s->declared_size_seen = 1;
+  s->declared_size = BROTLI_UNALIGNED_LOAD32LE(head + 4) |
+      ((uint64_t)BROTLI_UNALIGNED_LOAD32LE(head + 8) << 32);
+}
+
+/* Hands |size| bytes of the current metadata block to the chunk callback;
+   only short blocks, i.e. possible checksum trailer or declared size, are
+   kept. */
+static void EmitMetadataChunk(BrotliDecoderState* s, const uint8_t* data,
+                              size_t size) {
+  if (s->metadata_length <= BROTLI_SIZE_METADATA_LENGTH) {
+    memcpy(s->metadata_head +
+               (s->metadata_length - s->meta_block_remaining_len),
+           data, size);
+  }
+  if (s->metadata_chunk_func) {
+    s->metadata_chunk_func(s->metadata_callback_opaque, data, size);
+  }
+  s->meta_block_remaining_len -= (int)size;
+}
+
+/* Consumes the body of metadata block. Bytes left in the bit-reader
+   accumulator are passed through a small buffer; the rest is passed straight
+   from input, so a block arriving in one piece makes a single chunk. */
+static BrotliDecoderErrorCode BROTLI_NOINLINE SkipMetadataBlock(
+    BrotliDecoderState* s) {
+  BrotliBitReader* br = &s->br;
+  size_t nbytes;
+
+  if (s->meta_block_remaining_len == 0) {
+    return BROTLI_DECODER_SUCCESS;
+  }
+
+  BROTLI_DCHECK((BrotliGetAvailableBits(br) & 7) == 0);
+
+  /* Drain accumulator. */
+  if (BrotliGetAvailableBits(br) >= 8) {
+    uint8_t buffer[sizeof(brotli_reg_t)];
+    nbytes = BrotliGetAvailableBits(br) >> 3;
+    if (nbytes > (size_t)s->meta_block_remaining_len) {
+      nbytes = (size_t)s->meta_block_remaining_len;
+    }
+    BrotliCopyBytes(buffer, br, nbytes);
+    EmitMetadataChunk(s, buffer, nbytes);
+    if (s->meta_block_remaining_len == 0) {
+      return BROTLI_DECODER_SUCCESS;
+    }
+  }
+
+  /* Direct access to metadata is possible. */
+  nbytes = br->avail_in;
+  if (nbytes > (size_t)s->meta_block_remaining_len) {
+    nbytes = (size_t)s->meta_block_remaining_len;
+  }
+  if (nbytes > 0) {
+    EmitMetadataChunk(s, br->next_in, nbytes);
+    br->next_in += nbytes;
+    br->avail_in -= nbytes;
+  }
+  return (s->meta_block_remaining_len == 0) ?
+      BROTLI_DECODER_SUCCESS : BROTLI_DECODER_NEEDS_MORE_INPUT;
+}
+
 /* Dumps output.
    Returns BROTLI_DECODER_NEEDS_MORE_OUTPUT only if there is more output to push
    and either ring-buffer is as big as window size, or |force| is true. */
@@ -1286,6 +1715,9 @@ static BrotliDecoderErrorCode BROTLI_NOINLINE WriteRingBuffer(
       *next_out += num_written;
     }
   }
+  if (s->checksum) {
+    s->checksum_value = BrotliCrc32c(s->checksum_value, start, num_written);
+  }
   *available_out -= num_written;
   BROTLI_LOG_UINT(to_write);
   BROTLI_LOG_UINT(num_written);
@@ -1331,21 +1763,56 @@ static BROTLI_BOOL BROTLI_NOINLINE BrotliEnsureRingBuffer(
     return BROTLI_TRUE;
   }
 
-  s->ringbuffer = (uint8_t*)BROTLI_DECODER_ALLOC(s,
-      (size_t)(s->new_ringbuffer_size) + kRingBufferWriteAheadSlack);
-  if (s->ringbuffer == 0) {
-    /* Restore previous value. */
-    s->ringbuffer = old_ringbuffer;
-    return BROTLI_FALSE;
+  if (!!old_ringbuffer && s->new_ringbuffer_size <= s->ringbuffer_capacity) {
+    /* Grow in place; first s->pos bytes are already there. */
+    if (s->new_ringbuffer_size - 2 >= s->pos) {
+      s->ringbuffer[s->new_ringbuffer_size - 2] = 0;
+    }
+    if (s->new_ringbuffer_size - 1 >= s->pos) {
+      s->ringbuffer[s->new_ringbuffer_size - 1] = 0;
+    }
+  } else if (!old_ringbuffer && !!s->spare_ringbuffer &&
+      s->new_ringbuffer_size <= s->spare_ringbuffer_capacity) {
+    /* Adopt ring-buffer retained by BrotliDecoderResetInstance. */
+    s->ringbuffer = s->spare_ringbuffer;
+    s->ringbuffer_capacity = s->spare_ringbuffer_capacity;
+    s->spare_ringbuffer = NULL;
+    s->spare_ringbuffer_capacity = 0;
+    s->ringbuffer[s->new_ringbuffer_size - 2] = 0;
+    s->ringbuffer[s->new_ringbuffer_size - 1] = 0;
+  } else {
+    s->ringbuffer = (uint8_t*)BROTLI_DECODER_ALLOC(s,
+        (size_t)(s->new_ringbuffer_size) + kRingBufferWriteAheadSlack);
+    if (s->ringbuffer == 0) {
+      /* Restore previous value. */
+      s->ringbuffer = old_ringbuffer;
+      return BROTLI_FALSE;
+    }
+    s->ringbuffer_capacity = s->new_ringbuffer_size;
+    s->ringbuffer[s->new_ringbuffer_size - 2] = 0;
+    s->ringbuffer[s->new_ringbuffer_size - 1] = 0;
+    if (s->collect_stats) {
+      s->stats[BROTLI_DECODER_STAT_RING_BUFFER_ALLOCATIONS]++;
+    }
+
+    if (!!old_ringbuffer) {
+      memcpy(s->ringbuffer, old_ringbuffer, (size_t)s->pos);
+      BROTLI_DECODER_FREE(s, old_ringbuffer);
+    }
+    if (!!s->spare_ringbuffer) {
+      BROTLI_DECODER_FREE(s, s->spare_ringbuffer);
+      s->spare_ringbuffer_capacity = 0;
+    }
   }
-  s->ringbuffer[s->new_ringbuffer_size - 2] = 0;
-  s->ringbuffer[s->new_ringbuffer_size - 1] = 0;
 
-  if (!!old_ringbuffer) {
-    memcpy(s->ringbuffer, old_ringbuffer, (size_t)s->pos);
-    BROTLI_DECODER_FREE(s, old_ringbuffer);
+  if (s->stream_offset != 0) {
+    /* Stale bytes are visible to backward references that reach before
+       the stream start. */
+    memset(&s->ringbuffer[s->pos], 0,
+        (size_t)(s->new_ringbuffer_size - s->pos));
   }
 
+  BROTLI_PROBE2(decoder_ringbuffer_grow, s, s->new_ringbuffer_size);
   s->ringbuffer_size = s->new_ringbuffer_size;
   s->ringbuffer_mask = s->new_ringbuffer_size - 1;
   s->ringbuffer_end = s->ringbuffer + s->ringbuffer_size;
@@ -1353,6 +1820,51 @@ static BROTLI_BOOL BROTLI_NOINLINE BrotliEnsureRingBuffer(
   return BROTLI_TRUE;
 }
 
+/* Copies stored bytes of uncompressed meta-block straight from input to the
+   caller's output. Only the last window worth of them is put to the
+   ring-buffer, where later meta-blocks may reference it. Both ring-buffer and
+   output MUST be in sync, i.e. there should be no unwritten bytes. */
+static void CopyUncompressedBytesDirectly(
+    size_t* available_out, uint8_t** next_out, size_t* total_out,
+    BrotliDecoderState* s) {
+  size_t nbytes = BrotliGetRemainingBytes(&s->br);
+  size_t ringbuffer_size = (size_t)s->ringbuffer_size;
+  size_t end;
+  size_t keep;
+  size_t tail;
+  uint8_t* dst = *next_out;
+  if (nbytes > (size_t)s->meta_block_remaining_len) {
+    nbytes = (size_t)s->meta_block_remaining_len;
+  }
+  if (nbytes > *available_out) nbytes = *available_out;
+  BrotliCopyBytes(dst, &s->br, nbytes);
+  if (s->checksum) {
+    s->checksum_value = BrotliCrc32c(s->checksum_value, dst, nbytes);
+  }
+  *next_out += nbytes;
+  *available_out -= nbytes;
+  s->meta_block_remaining_len -= (int)nbytes;
+  s->partial_pos_out += nbytes;
+  if (total_out) *total_out = s->partial_pos_out;
+
+  end = (size_t)s->pos + nbytes;
+  if (s->ringbuffer_size != 1 << s->window_bits) {
+    /* Smaller ring-buffer fits the rest of the stream and never wraps. */
+    BROTLI_DCHECK(end <= ringbuffer_size);
+    memcpy(&s->ringbuffer[s->pos], dst, nbytes);
+    s->pos = (int)end;
+    return;
+  }
+  keep = BROTLI_MIN(size_t, nbytes, ringbuffer_size);
+  s->rb_roundtrips += end / ringbuffer_size;
+  s->pos = (int)(end % ringbuffer_size);
+  tail = BROTLI_MIN(size_t, keep, (size_t)s->pos);
+  memcpy(&s->ringbuffer[(size_t)s->pos - tail], dst + nbytes - tail, tail);
+  memcpy(&s->ringbuffer[ringbuffer_size - (keep - tail)],
+         dst + nbytes - keep, keep - tail);
+  if (end >= ringbuffer_size) s->max_distance = s->max_backward_distance;
+}
+
 static BrotliDecoderErrorCode BROTLI_NOINLINE CopyUncompressedBlockToOutput(
     size_t* available_out, uint8_t** next_out, size_t* total_out,
     BrotliDecoderState* s) {
@@ -1365,7 +1877,25 @@ static BrotliDecoderErrorCode BROTLI_NOINLINE CopyUncompressedBlockToOutput(
   for (;;) {
     switch (s->substate_uncompressed) {
       case BROTLI_STATE_UNCOMPRESSED_NONE: {
-        int nbytes = (int)BrotliGetRemainingBytes(&s->br);
+        int nbytes;
+        /* With output at hand the stored bytes skip the ring-buffer, once
+           the bytes decoded before are pushed out. */
+        if (next_out && *next_out && *available_out != 0) {
+          if (UnwrittenBytes(s, BROTLI_FALSE) != 0) {
+            BrotliDecoderErrorCode result = WriteRingBuffer(
+                s, available_out, next_out, total_out, BROTLI_FALSE);
+            if (result != BROTLI_DECODER_SUCCESS) return result;
+          }
+          WrapRingBuffer(s);
+          if (UnwrittenBytes(s, BROTLI_FALSE) == 0 && *available_out != 0) {
+            CopyUncompressedBytesDirectly(
+                available_out, next_out, total_out, s);
+            if (s->meta_block_remaining_len == 0) {
+              return BROTLI_DECODER_SUCCESS;
+            }
+          }
+        }
+        nbytes = (int)BrotliGetRemainingBytes(&s->br);
         if (nbytes > s->meta_block_remaining_len) {
           nbytes = s->meta_block_remaining_len;
         }
@@ -1404,6 +1934,13 @@ static BrotliDecoderErrorCode BROTLI_NOINLINE CopyUncompressedBlockToOutput(
   BROTLI_DCHECK(0);  /* Unreachable */
 }
 
+static void ClearWordCache(BrotliDecoderState* s) {
+  if (s->word_cache) {
+    memset(s->word_cache, 0,
+           sizeof(BrotliWordCacheEntry) << BROTLI_WORD_CACHE_BITS);
+  }
+}
+
 static BROTLI_BOOL AttachCompoundDictionary(
     BrotliDecoderState* state, const uint8_t* data, size_t size) {
   BrotliDecoderCompoundDictionary* addon = state->compound_dictionary;
@@ -1499,9 +2036,12 @@ BROTLI_BOOL BrotliDecoderAttachDictionary(BrotliDecoderState* state,
   uint32_t i;
   uint32_t num_prefix_before = state->dictionary->num_prefix;
   if (state->state != BROTLI_STATE_UNINITED) return BROTLI_FALSE;
+  /* Borrowed dictionary must not be modified. */
+  if (state->dictionary_is_shared) return BROTLI_FALSE;
   if (!BrotliSharedDictionaryAttach(state->dictionary, type, data_size, data)) {
     return BROTLI_FALSE;
   }
+  ClearWordCache(state);
   for (i = num_prefix_before; i < state->dictionary->num_prefix; i++) {
     if (!AttachCompoundDictionary(
         state, state->dictionary->prefix[i],
@@ -1512,6 +2052,30 @@ BROTLI_BOOL BrotliDecoderAttachDictionary(BrotliDecoderState* state,
   return BROTLI_TRUE;
 }
 
+BROTLI_BOOL BrotliDecoderAttachSharedDictionary(BrotliDecoderState* state,
+    const BrotliSharedDictionary* dictionary) {
+  BrotliSharedDictionary* own = state->dictionary;
+  uint32_t i;
+  if (state->state != BROTLI_STATE_UNINITED) return BROTLI_FALSE;
+  /* Only a pristine decoder can switch to a borrowed dictionary. */
+  if (state->dictionary_is_shared || own->num_prefix != 0 ||
+      own->num_word_lists != 0 || own->num_transform_lists != 0) {
+    return BROTLI_FALSE;
+  }
+  /* Decoder only reads the dictionary, so casting constness away is safe. */
+  state->dictionary = (BrotliSharedDictionary*)dictionary;
+  state->dictionary_is_shared = 1;
+  BrotliSharedDictionaryDestroyInstance(own);
+  ClearWordCache(state);
+  for (i = 0; i < dictionary->num_prefix; i++) {
+    if (!AttachCompoundDictionary(
+        state, dictionary->prefix[i], dictionary->prefix_size[i])) {
+      return BROTLI_FALSE;
+    }
+  }
+  return BROTLI_TRUE;
+}
+
 /* Calculates the smallest feasible ring buffer.
 
    If we know the data size is small, do not allocate more ring buffer
@@ -1780,7 +2344,14 @@ static BROTLI_INLINE BROTLI_BOOL ReadCommandInternal(
   CmdLutElement v;
   BrotliBitReaderState memento;
   if (!safe) {
+#if BROTLI_WIDE_BIT_WINDOW
+    /* One refill covers the symbol and, almost always, both extra fields. */
+    BrotliFillBitWindowWide(br);
+    cmd_code = DecodeSymbol((uint32_t)BrotliGetBitsUnmasked(br),
+                            s->htree_command, br);
+#else
     cmd_code = ReadSymbol(s->htree_command, br);
+#endif
   } else {
     BrotliBitReaderSaveState(br, &memento);
     if (!SafeReadSymbol(s->htree_command, br, &cmd_code)) {
@@ -1793,10 +2364,21 @@ static BROTLI_INLINE BROTLI_BOOL ReadCommandInternal(
   s->dist_htree_index = s->dist_context_map_slice[s->distance_context];
   *insert_length = v.insert_len_offset;
   if (!safe) {
+#if BROTLI_WIDE_BIT_WINDOW
+    /* At least 42 bits are left after the symbol; only the longest
+       insert / copy length codes need another refill. */
+    if (BROTLI_PREDICT_FALSE(
+            v.insert_len_extra_bits + v.copy_len_extra_bits > 42)) {
+      BrotliFillBitWindowWide(br);
+    }
+    BrotliTakeBits(br, v.insert_len_extra_bits, &insert_len_extra);
+    BrotliTakeBits(br, v.copy_len_extra_bits, &copy_length);
+#else
     if (BROTLI_PREDICT_FALSE(v.insert_len_extra_bits != 0)) {
       insert_len_extra = BrotliReadBits24(br, v.insert_len_extra_bits);
     }
     copy_length = BrotliReadBits24(br, v.copy_len_extra_bits);
+#endif
   } else {
     if (!SafeReadBits(br, v.insert_len_extra_bits, &insert_len_extra) ||
         !SafeReadBits(br, v.copy_len_extra_bits, &copy_length)) {
@@ -1820,6 +2402,46 @@ static BROTLI_INLINE BROTLI_BOOL SafeReadCommand(
   return ReadCommandInternal(1, s, br, insert_length);
 }
 
+/* Writes transformed dictionary word to |dst|; words that recur with the
+   same transform are copied from the cache in 16-byte chunks, i.e. up to 15
+   bytes past the end of the word are overwritten. Returns length of the
+   result. */
+static BROTLI_NOINLINE int TransformDictionaryWord(BrotliDecoderState* s,
+    uint8_t* dst, const uint8_t* word, int len,
+    const BrotliTransforms* transforms, int transform_idx) {
+  BrotliWordCacheEntry* entry;
+  if (!s->word_cache) {
+    size_t size = sizeof(BrotliWordCacheEntry) << BROTLI_WORD_CACHE_BITS;
+    if (!s->low_memory) {
+      s->word_cache = (BrotliWordCacheEntry*)BROTLI_DECODER_ALLOC(s, size);
+    }
+    if (!s->word_cache) {
+      return BrotliTransformDictionaryWord(
+          dst, word, len, transforms, transform_idx);
+    }
+    memset(s->word_cache, 0, size);
+  }
+  entry = &s->word_cache[(((uint32_t)(size_t)word ^
+      ((uint32_t)transform_idx << 5)) * 0x1E35A7BDu) >>
+      (32 - BROTLI_WORD_CACHE_BITS)];
+  if (entry->word == word && entry->transform_idx == transform_idx &&
+      entry->transforms == transforms) {
+    int i;
+    for (i = 0; i < entry->len; i += 16) memcpy(&dst[i], &entry->data[i], 16);
+    return entry->len;
+  }
+  len = BrotliTransformDictionaryWord(dst, word, len, transforms,
+      transform_idx);
+  if (len <= BROTLI_WORD_CACHE_MAX_LENGTH) {
+    entry->word = word;
+    entry->transforms = transforms;
+    entry->transform_idx = transform_idx;
+    entry->len = len;
+    memcpy(entry->data, dst, (size_t)len);
+  }
+  return len;
+}
+
 static BROTLI_INLINE BROTLI_BOOL CheckInputAmount(
     int safe, BrotliBitReader* const br, size_t num) {
   if (safe) {
@@ -1840,13 +2462,16 @@ static BROTLI_INLINE BROTLI_BOOL CheckInputAmount(
     }                                             \
   }
 
+/* |plain| is set when there is no compound dictionary and a single static
+   dictionary that is not selected by literal context; the branches for those
+   are then compiled out. */
 static BROTLI_INLINE BrotliDecoderErrorCode ProcessCommandsInternal(
-    int safe, BrotliDecoderState* s) {
+    int safe, int plain, BrotliDecoderState* s) {
   int pos = s->pos;
   int i = s->loop_counter;
   BrotliDecoderErrorCode result = BROTLI_DECODER_SUCCESS;
   BrotliBitReader* br = &s->br;
-  int compound_dictionary_size = GetCompoundDictionarySize(s);
+  int compound_dictionary_size = plain ? 0 : GetCompoundDictionarySize(s);
 
   if (!CheckInputAmount(safe, br, 28)) {
     result = BROTLI_DECODER_NEEDS_MORE_INPUT;
@@ -1886,6 +2511,14 @@ CommandBegin:
   BROTLI_SAFE(ReadCommand(s, br, &i));
   BROTLI_LOG(("[ProcessCommandsInternal] pos = %d insert = %d copy = %d\n",
               pos, i, s->copy_length));
+  if (s->collect_stats) {
+    s->stats[BROTLI_DECODER_STAT_LITERAL_BYTES] += (uint32_t)i;
+  }
+  if (s->distance_code == 0) {
+    /* Implicit last distance is known before the insert: its source is
+       fetched while the literals are decoded. */
+    PrefetchCopySource(s, pos + i, s->dist_rb[(s->dist_rb_idx - 1) & 3]);
+  }
   if (i == 0) {
     goto CommandPostDecodeLiterals;
   }
@@ -1899,6 +2532,11 @@ CommandInner:
   if (s->trivial_literal_context) {
     uint32_t bits;
     uint32_t value;
+    if (!safe && i > 3) {
+      int n = DecodeTrivialContextLiterals(s, pos, i);
+      pos += n;
+      i -= n;
+    }
     PreloadSymbol(safe, s->literal_htree, br, &bits, &value);
     do {
       if (!CheckInputAmount(safe, br, 28)) {  /* 162 bits + 7 bytes */
@@ -1993,12 +2631,14 @@ CommandPostDecodeLiterals:
       BROTLI_SAFE(DecodeDistanceBlockSwitch(s));
     }
     BROTLI_SAFE(ReadDistance(s, br));
+    PrefetchCopySource(s, pos, s->distance_code);
   }
   BROTLI_LOG(("[ProcessCommandsInternal] pos = %d distance = %d\n",
               pos, s->distance_code));
   if (s->max_distance != s->max_backward_distance) {
-    s->max_distance =
-        (pos < s->max_backward_distance) ? pos : s->max_backward_distance;
+    int virtual_pos = pos + s->stream_offset;
+    s->max_distance = (virtual_pos < s->max_backward_distance) ?
+        virtual_pos : s->max_backward_distance;
   }
   i = s->copy_length;
   /* Apply copy of LZ77 back-reference, or static dictionary reference if
@@ -2019,6 +2659,9 @@ CommandPostDecodeLiterals:
       if (!InitializeCompoundDictionaryCopy(s, address, i)) {
         return BROTLI_FAILURE(BROTLI_DECODER_ERROR_COMPOUND_DICTIONARY);
       }
+      if (s->collect_stats) {
+        s->stats[BROTLI_DECODER_STAT_DICTIONARY_REFERENCES]++;
+      }
       pos += CopyFromCompoundDictionary(s, pos);
       if (pos >= s->ringbuffer_size) {
         s->state = BROTLI_STATE_COMMAND_POST_WRITE_1;
@@ -2028,7 +2671,7 @@ CommandPostDecodeLiterals:
                i <= SHARED_BROTLI_MAX_DICTIONARY_WORD_LENGTH) {
       uint8_t p1 = s->ringbuffer[(pos - 1) & s->ringbuffer_mask];
       uint8_t p2 = s->ringbuffer[(pos - 2) & s->ringbuffer_mask];
-      uint8_t dict_id = s->dictionary->context_based ?
+      uint8_t dict_id = (!plain && s->dictionary->context_based) ?
           s->dictionary->context_map[BROTLI_CONTEXT(p1, p2, s->context_lookup)]
           : 0;
       const BrotliDictionary* words = s->dictionary->words[dict_id];
@@ -2045,7 +2688,7 @@ CommandPostDecodeLiterals:
       offset += word_idx * i;
       /* If the distance is out of bound, select a next static dictionary if
          there exist multiple. */
-      if ((transform_idx >= (int)transforms->num_transforms ||
+      if (!plain && (transform_idx >= (int)transforms->num_transforms ||
           words->size_bits_by_length[i] == 0) &&
           s->dictionary->num_dictionaries > 1) {
         uint8_t dict_id2;
@@ -2089,11 +2732,19 @@ CommandPostDecodeLiterals:
         const uint8_t* word = &words->data[offset];
         int len = i;
         if (transform_idx == transforms->cutOffTransforms[0]) {
-          memcpy(&s->ringbuffer[pos], word, (size_t)len);
+          /* Words are up to 24 bytes long. Like in backward copies, less
+             than BROTLI_WINDOW_GAP bytes are written past the end; those are
+             never referenced, or are in the write-ahead slack. */
+          if ((size_t)offset + 32 <= words->data_size) {
+            memcpy(&s->ringbuffer[pos], word, 16);
+            if (len > 16) memcpy(&s->ringbuffer[pos + 16], word + 16, 16);
+          } else {
+            memcpy(&s->ringbuffer[pos], word, (size_t)len);
+          }
           BROTLI_LOG(("[ProcessCommandsInternal] dictionary word: [%.*s]\n",
                       len, word));
         } else {
-          len = BrotliTransformDictionaryWord(&s->ringbuffer[pos], word, len,
+          len = TransformDictionaryWord(s, &s->ringbuffer[pos], word, len,
               transforms, transform_idx);
           BROTLI_LOG(("[ProcessCommandsInternal] dictionary word: [%.*s],"
                       " transform_idx = %d, transformed: [%.*s]\n",
@@ -2103,6 +2754,9 @@ CommandPostDecodeLiterals:
             return BROTLI_FAILURE(BROTLI_DECODER_ERROR_FORMAT_TRANSFORM);
           }
         }
+        if (s->collect_stats) {
+          s->stats[BROTLI_DECODER_STAT_DICTIONARY_REFERENCES]++;
+        }
         pos += len;
         s->meta_block_remaining_len -= len;
         if (pos >= s->ringbuffer_size) {
@@ -2131,28 +2785,36 @@ CommandPostDecodeLiterals:
     s->dist_rb[s->dist_rb_idx & 3] = s->distance_code;
     ++s->dist_rb_idx;
     s->meta_block_remaining_len -= i;
+    if (s->collect_stats) {
+      s->stats[BROTLI_DECODER_STAT_COPIED_BYTES] += (uint32_t)i;
+    }
     /* There are 32+ bytes of slack in the ring-buffer allocation.
        Also, we have 16 short codes, that make these 16 bytes irrelevant
        in the ring-buffer. Let's copy over them as a first guess. */
     memmove16(copy_dst, copy_src);
     if (src_end > pos && dst_end > src_start) {
       /* Regions intersect. */
-      goto CommandPostWrapCopy;
-    }
-    if (dst_end >= s->ringbuffer_size || src_end >= s->ringbuffer_size) {
-      /* At least one region wraps. */
-      goto CommandPostWrapCopy;
-    }
-    pos += i;
-    if (i > 16) {
-      if (i > 32) {
-        memcpy(copy_dst + 16, copy_src + 16, (size_t)(i - 16));
-      } else {
-        /* This branch covers about 45% cases.
-           Fixed size short copy allows more compiler optimizations. */
-        memmove16(copy_dst + 16, copy_src + 16);
+      if (src_start >= pos || dst_end >= s->ringbuffer_size) {
+        /* At least one region wraps. */
+        goto CommandPostWrapCopy;
+      }
+      CopyRepeated(copy_dst, s->distance_code, i);
+    } else {
+      if (dst_end >= s->ringbuffer_size || src_end >= s->ringbuffer_size) {
+        /* At least one region wraps. */
+        goto CommandPostWrapCopy;
+      }
+      if (i > 16) {
+        if (i > 32) {
+          memcpy(copy_dst + 16, copy_src + 16, (size_t)(i - 16));
+        } else {
+          /* This branch covers about 45% cases.
+             Fixed size short copy allows more compiler optimizations. */
+          memmove16(copy_dst + 16, copy_src + 16);
+        }
       }
     }
+    pos += i;
   }
   BROTLI_LOG_UINT(s->meta_block_remaining_len);
   if (s->meta_block_remaining_len <= 0) {
@@ -2193,12 +2855,17 @@ saveStateAndReturn:
 
 static BROTLI_NOINLINE BrotliDecoderErrorCode ProcessCommands(
     BrotliDecoderState* s) {
-  return ProcessCommandsInternal(0, s);
+  return ProcessCommandsInternal(0, 0, s);
+}
+
+static BROTLI_NOINLINE BrotliDecoderErrorCode PlainProcessCommands(
+    BrotliDecoderState* s) {
+  return ProcessCommandsInternal(0, 1, s);
 }
 
 static BROTLI_NOINLINE BrotliDecoderErrorCode SafeProcessCommands(
     BrotliDecoderState* s) {
-  return ProcessCommandsInternal(1, s);
+  return ProcessCommandsInternal(1, 0, s);
 }
 
 BrotliDecoderResult BrotliDecoderDecompress(
@@ -2371,11 +3038,16 @@ BrotliDecoderResult BrotliDecoderDecompressStream(
         BROTLI_LOG_UINT(s->window_bits);
         /* Maximum distance, see section 9.1. of the spec. */
         s->max_backward_distance = (1 << s->window_bits) - BROTLI_WINDOW_GAP;
+        if (s->stream_offset > s->max_backward_distance) {
+          s->stream_offset = s->max_backward_distance;
+        }
 
         /* Allocate memory for both block_type_trees and block_len_trees. */
-        s->block_type_trees = (HuffmanCode*)BROTLI_DECODER_ALLOC(s,
-            sizeof(HuffmanCode) * 3 *
-                (BROTLI_HUFFMAN_MAX_SIZE_258 + BROTLI_HUFFMAN_MAX_SIZE_26));
+        if (!s->block_type_trees) {
+          s->block_type_trees = (HuffmanCode*)BROTLI_DECODER_ALLOC(s,
+              sizeof(HuffmanCode) * 3 *
+                  (BROTLI_HUFFMAN_MAX_SIZE_258 + BROTLI_HUFFMAN_MAX_SIZE_26));
+        }
         if (s->block_type_trees == 0) {
           result = BROTLI_FAILURE(BROTLI_DECODER_ERROR_ALLOC_BLOCK_TYPE_TREES);
           break;
@@ -2408,6 +3080,11 @@ BrotliDecoderResult BrotliDecoderDecompressStream(
           }
         }
         if (s->is_metadata) {
+          s->metadata_length = s->meta_block_remaining_len;
+          if (s->metadata_start_func) {
+            s->metadata_start_func(s->metadata_callback_opaque,
+                                   (size_t)s->metadata_length);
+          }
           s->state = BROTLI_STATE_METADATA;
           break;
         }
@@ -2415,6 +3092,9 @@ BrotliDecoderResult BrotliDecoderDecompressStream(
           s->state = BROTLI_STATE_METABLOCK_DONE;
           break;
         }
+        if (s->collect_stats) {
+          s->stats[BROTLI_DECODER_STAT_METABLOCKS]++;
+        }
         BrotliCalculateRingBufferSize(s);
         if (s->is_uncompressed) {
           s->state = BROTLI_STATE_UNCOMPRESSED;
@@ -2501,15 +3181,10 @@ BrotliDecoderResult BrotliDecoderDecompressStream(
       }
 
       case BROTLI_STATE_METADATA:
-        for (; s->meta_block_remaining_len > 0; --s->meta_block_remaining_len) {
-          uint32_t bits;
-          /* Read one byte and ignore it. */
-          if (!BrotliSafeReadBits(br, 8, &bits)) {
-            result = BROTLI_DECODER_NEEDS_MORE_INPUT;
-            break;
-          }
-        }
+        result = SkipMetadataBlock(s);
         if (result == BROTLI_DECODER_SUCCESS) {
+          if (s->checksum) ReadChecksumTrailer(s);
+          ReadDeclaredSize(s);
           s->state = BROTLI_STATE_METABLOCK_DONE;
         }
         break;
@@ -2631,7 +3306,12 @@ BrotliDecoderResult BrotliDecoderDecompressStream(
       case BROTLI_STATE_COMMAND_POST_DECODE_LITERALS:
       /* Fall through. */
       case BROTLI_STATE_COMMAND_POST_WRAP_COPY:
-        result = ProcessCommands(s);
+        if (!s->compound_dictionary && !s->dictionary->context_based &&
+            s->dictionary->num_dictionaries == 1) {
+          result = PlainProcessCommands(s);
+        } else {
+          result = ProcessCommands(s);
+        }
         if (result == BROTLI_DECODER_NEEDS_MORE_INPUT) {
           result = SafeProcessCommands(s);
         }
@@ -2709,6 +3389,11 @@ BrotliDecoderResult BrotliDecoderDecompressStream(
             break;
           }
         }
+        if (s->checksum && s->checksum_trailer_seen &&
+            s->checksum_position == DecodedSize(s) &&
+            s->checksum_value != s->checksum_expected) {
+          result = BROTLI_FAILURE(BROTLI_DECODER_ERROR_FORMAT_CHECKSUM);
+        }
         return SaveErrorCode(s, result);
     }
   }
@@ -2763,6 +3448,37 @@ BrotliDecoderErrorCode BrotliDecoderGetErrorCode(const BrotliDecoderState* s) {
   return (BrotliDecoderErrorCode)s->error_code;
 }
 
+uint32_t BrotliDecoderGetChecksum(const BrotliDecoderState* s) {
+  return s->checksum_value;
+}
+
+BROTLI_BOOL BrotliDecoderGetDeclaredSize(const BrotliDecoderState* s,
+    uint64_t* size) {
+  if (!s->declared_size_seen) return BROTLI_FALSE;
+  *size = s->declared_size;
+  return BROTLI_TRUE;
+}
+
+uint64_t BrotliDecoderGetDecodedSize(const BrotliDecoderState* s) {
+  return DecodedSize(s);
+}
+
+void BrotliDecoderSetMetadataCallbacks(
+    BrotliDecoderState* state,
+    brotli_decoder_metadata_start_func start_func,
+    brotli_decoder_metadata_chunk_func chunk_func, void* opaque) {
+  state->metadata_start_func = start_func;
+  state->metadata_chunk_func = chunk_func;
+  state->metadata_callback_opaque = opaque;
+}
+
+size_t BrotliDecoderGetStats(const BrotliDecoderState* s, size_t size,
+    uint64_t* stats) {
+  size_t n = BROTLI_MIN(size_t, size, BROTLI_DECODER_NUM_STATS);
+  if (n != 0) memcpy(stats, s->stats, n * sizeof(stats[0]));
+  return n;
+}
+
 const char* BrotliDecoderErrorString(BrotliDecoderErrorCode c) {
   switch (c) {
 #define BROTLI_ERROR_CODE_CASE_(PREFIX, NAME, CODE) \
@@ -33,6 +33,22 @@ BROTLI_BOOL BrotliDecoderStateInit(BrotliDecoderState* s,
   BrotliInitBitReader(&s->br);
   s->state = BROTLI_STATE_UNINITED;
   s->large_window = 0;
+  s->huffman_table_cache = 0;
+  s->low_memory = 0;
+  s->collect_stats = 0;
+  memset(s->stats, 0, sizeof(s->stats));
+  s->checksum = 0;
+  s->checksum_trailer_seen = 0;
+  s->checksum_value = 0;
+  s->checksum_expected = 0;
+  s->checksum_position = 0;
+  s->declared_size_seen = 0;
+  s->declared_size = 0;
+  s->metadata_length = 0;
+  s->metadata_start_func = NULL;
+  s->metadata_chunk_func = NULL;
+  s->metadata_callback_opaque = NULL;
+  s->dictionary_is_shared = 0;
   s->substate_metablock_header = BROTLI_STATE_METABLOCK_HEADER_NONE;
   s->substate_uncompressed = BROTLI_STATE_UNCOMPRESSED_NONE;
   s->substate_decode_uint8 = BROTLI_STATE_DECODE_UINT8_NONE;
@@ -50,6 +66,19 @@ BROTLI_BOOL BrotliDecoderStateInit(BrotliDecoderState* s,
   s->ringbuffer_size = 0;
   s->new_ringbuffer_size = 0;
   s->ringbuffer_mask = 0;
+  s->ringbuffer_capacity = 0;
+  s->spare_ringbuffer = NULL;
+  s->spare_ringbuffer_capacity = 0;
+  s->spare_htrees[0] = NULL;
+  s->spare_htrees[1] = NULL;
+  s->spare_htrees[2] = NULL;
+  s->spare_htrees_size[0] = 0;
+  s->spare_htrees_size[1] = 0;
+  s->spare_htrees_size[2] = 0;
+  s->literal_pairs = NULL;
+  s->literal_pairs_tree = NULL;
+  s->huffman_cache = NULL;
+  s->word_cache = NULL;
 
   s->context_map = NULL;
   s->context_modes = NULL;
@@ -72,6 +101,7 @@ BROTLI_BOOL BrotliDecoderStateInit(BrotliDecoderState* s,
 
   s->window_bits = 0;
   s->max_distance = 0;
+  s->stream_offset = 0;
   s->dist_rb[0] = 16;
   s->dist_rb[1] = 15;
   s->dist_rb[2] = 11;
@@ -109,6 +139,8 @@ void BrotliDecoderStateMetablockBegin(BrotliDecoderState* s) {
   s->dist_context_map = NULL;
   s->context_map_slice = NULL;
   s->literal_htree = NULL;
+  /* Tree memory is reused by the next metablock. */
+  s->literal_pairs_tree = NULL;
   s->dist_context_map_slice = NULL;
   s->dist_htree_index = 0;
   s->context_lookup = NULL;
@@ -120,38 +152,197 @@ void BrotliDecoderStateMetablockBegin(BrotliDecoderState* s) {
   s->distance_hgroup.htrees = NULL;
 }
 
+static size_t HuffmanTreeGroupAllocSize(uint32_t alphabet_size_limit,
+    uint32_t ntrees) {
+  /* 376 = 256 (1-st level table) + 4 + 7 + 15 + 31 + 63 (2-nd level mix-tables)
+     This number is discovered "unlimited" "enough" calculator; it is actually
+     a wee bigger than required in several cases (especially for alphabets with
+     less than 16 symbols). */
+  const size_t max_table_size = alphabet_size_limit + 376;
+  const size_t code_size = sizeof(HuffmanCode) * ntrees * max_table_size;
+  const size_t htree_size = sizeof(HuffmanCode*) * ntrees;
+  return code_size + htree_size;
+}
+
+/* Keeps the tree group allocation for the next metablock; the smallest spare
+   allocation is evicted if there is no free slot. */
+static void ReleaseHuffmanTreeGroup(BrotliDecoderState* s,
+    HuffmanTreeGroup* group) {
+  size_t size;
+  int slot = 0;
+  int i;
+  if (!group->htrees) return;
+  if (s->low_memory) {
+    BROTLI_DECODER_FREE(s, group->htrees);
+    return;
+  }
+  size = HuffmanTreeGroupAllocSize(group->alphabet_size_limit,
+                                   group->num_htrees);
+  for (i = 1; i < 3; ++i) {
+    if (s->spare_htrees_size[i] < s->spare_htrees_size[slot]) slot = i;
+  }
+  if (s->spare_htrees_size[slot] >= size) {
+    BROTLI_DECODER_FREE(s, group->htrees);
+    return;
+  }
+  if (s->spare_htrees[slot]) BROTLI_DECODER_FREE(s, s->spare_htrees[slot]);
+  s->spare_htrees[slot] = group->htrees;
+  s->spare_htrees_size[slot] = size;
+  group->htrees = NULL;
+}
+
 void BrotliDecoderStateCleanupAfterMetablock(BrotliDecoderState* s) {
   BROTLI_DECODER_FREE(s, s->context_modes);
   BROTLI_DECODER_FREE(s, s->context_map);
   BROTLI_DECODER_FREE(s, s->dist_context_map);
-  BROTLI_DECODER_FREE(s, s->literal_hgroup.htrees);
-  BROTLI_DECODER_FREE(s, s->insert_copy_hgroup.htrees);
-  BROTLI_DECODER_FREE(s, s->distance_hgroup.htrees);
+  ReleaseHuffmanTreeGroup(s, &s->literal_hgroup);
+  ReleaseHuffmanTreeGroup(s, &s->insert_copy_hgroup);
+  ReleaseHuffmanTreeGroup(s, &s->distance_hgroup);
+  if (s->low_memory) {
+    BROTLI_DECODER_FREE(s, s->literal_pairs);
+    s->literal_pairs_tree = NULL;
+  }
 }
 
 void BrotliDecoderStateCleanup(BrotliDecoderState* s) {
+  int i;
   BrotliDecoderStateCleanupAfterMetablock(s);
 
   BROTLI_DECODER_FREE(s, s->compound_dictionary);
-  BrotliSharedDictionaryDestroyInstance(s->dictionary);
+  if (!s->dictionary_is_shared) {
+    BrotliSharedDictionaryDestroyInstance(s->dictionary);
+  }
   s->dictionary = NULL;
+  s->dictionary_is_shared = 0;
   BROTLI_DECODER_FREE(s, s->ringbuffer);
+  BROTLI_DECODER_FREE(s, s->spare_ringbuffer);
   BROTLI_DECODER_FREE(s, s->block_type_trees);
+  BROTLI_DECODER_FREE(s, s->literal_pairs);
+  BROTLI_DECODER_FREE(s, s->word_cache);
+  for (i = 0; i < 3; ++i) {
+    if (s->spare_htrees[i]) BROTLI_DECODER_FREE(s, s->spare_htrees[i]);
+  }
+  if (s->huffman_cache) {
+    for (i = 0; i < (1 << BROTLI_HUFFMAN_CACHE_BITS); ++i) {
+      BROTLI_DECODER_FREE(s, s->huffman_cache[i].table);
+    }
+    BROTLI_DECODER_FREE(s, s->huffman_cache);
+  }
+}
+
+BROTLI_BOOL BrotliDecoderStateReset(BrotliDecoderState* s) {
+  brotli_alloc_func alloc_func = s->alloc_func;
+  brotli_free_func free_func = s->free_func;
+  void* opaque = s->memory_manager_opaque;
+  unsigned int canny_ringbuffer_allocation = s->canny_ringbuffer_allocation;
+  unsigned int large_window = s->large_window;
+  unsigned int huffman_table_cache = s->huffman_table_cache;
+  unsigned int low_memory = s->low_memory;
+  unsigned int collect_stats = s->collect_stats;
+  unsigned int checksum = s->checksum;
+  brotli_decoder_metadata_start_func metadata_start_func =
+      s->metadata_start_func;
+  brotli_decoder_metadata_chunk_func metadata_chunk_func =
+      s->metadata_chunk_func;
+  void* metadata_callback_opaque = s->metadata_callback_opaque;
+  BrotliHuffmanCacheEntry* huffman_cache = s->huffman_cache;
+  BrotliWordCacheEntry* word_cache = s->word_cache;
+  uint8_t* spare_ringbuffer = s->spare_ringbuffer;
+  int spare_ringbuffer_capacity = s->spare_ringbuffer_capacity;
+  HuffmanCode* block_type_trees = s->block_type_trees;
+  void* spare_htrees[3];
+  size_t spare_htrees_size[3];
+  int i;
+
+  BrotliDecoderStateCleanupAfterMetablock(s);
+  if (low_memory) {
+    /* Nothing but the Huffman table cache is retained. */
+    if (s->ringbuffer) BROTLI_DECODER_FREE(s, s->ringbuffer);
+    if (spare_ringbuffer) BROTLI_DECODER_FREE(s, spare_ringbuffer);
+    if (block_type_trees) BROTLI_DECODER_FREE(s, block_type_trees);
+    spare_ringbuffer_capacity = 0;
+    block_type_trees = NULL;
+    for (i = 0; i < 3; ++i) {
+      if (s->spare_htrees[i]) BROTLI_DECODER_FREE(s, s->spare_htrees[i]);
+      s->spare_htrees_size[i] = 0;
+    }
+  } else if (s->ringbuffer) {
+    /* Prefer the bigger buffer. */
+    if (s->ringbuffer_capacity >= spare_ringbuffer_capacity) {
+      if (spare_ringbuffer) BROTLI_DECODER_FREE(s, spare_ringbuffer);
+      spare_ringbuffer = s->ringbuffer;
+      spare_ringbuffer_capacity = s->ringbuffer_capacity;
+    } else {
+      BROTLI_DECODER_FREE(s, s->ringbuffer);
+    }
+  }
+  for (i = 0; i < 3; ++i) {
+    spare_htrees[i] = s->spare_htrees[i];
+    spare_htrees_size[i] = s->spare_htrees_size[i];
+    s->spare_htrees[i] = NULL;
+  }
+  /* Detach retained allocations, so that cleanup does not release them. */
+  s->ringbuffer = NULL;
+  s->spare_ringbuffer = NULL;
+  s->block_type_trees = NULL;
+  s->huffman_cache = NULL;
+  s->word_cache = NULL;
+  BrotliDecoderStateCleanup(s);
+
+  if (!BrotliDecoderStateInit(s, alloc_func, free_func, opaque)) {
+    s->spare_ringbuffer = spare_ringbuffer;
+    s->block_type_trees = block_type_trees;
+    s->huffman_cache = huffman_cache;
+    s->word_cache = word_cache;
+    for (i = 0; i < 3; ++i) {
+      s->spare_htrees[i] = spare_htrees[i];
+      s->spare_htrees_size[i] = spare_htrees_size[i];
+    }
+    return BROTLI_FALSE;
+  }
+  s->canny_ringbuffer_allocation = canny_ringbuffer_allocation;
+  s->large_window = large_window;
+  s->huffman_table_cache = huffman_table_cache;
+  s->low_memory = low_memory;
+  s->collect_stats = collect_stats;
+  s->checksum = checksum;
+  s->metadata_start_func = metadata_start_func;
+  s->metadata_chunk_func = metadata_chunk_func;
+  s->metadata_callback_opaque = metadata_callback_opaque;
+  s->huffman_cache = huffman_cache;
+  s->word_cache = word_cache;
+  s->spare_ringbuffer = spare_ringbuffer;
+  s->spare_ringbuffer_capacity = spare_ringbuffer_capacity;
+  s->block_type_trees = block_type_trees;
+  for (i = 0; i < 3; ++i) {
+    s->spare_htrees[i] = spare_htrees[i];
+    s->spare_htrees_size[i] = spare_htrees_size[i];
+  }
+  return BROTLI_TRUE;
 }
 
 BROTLI_BOOL BrotliDecoderHuffmanTreeGroupInit(BrotliDecoderState* s,
     HuffmanTreeGroup* group, uint32_t alphabet_size_max,
     uint32_t alphabet_size_limit, uint32_t ntrees) {
-  /* 376 = 256 (1-st level table) + 4 + 7 + 15 + 31 + 63 (2-nd level mix-tables)
-     This number is discovered "unlimited" "enough" calculator; it is actually
-     a wee bigger than required in several cases (especially for alphabets with
-     less than 16 symbols). */
-  const size_t max_table_size = alphabet_size_limit + 376;
-  const size_t code_size = sizeof(HuffmanCode) * ntrees * max_table_size;
-  const size_t htree_size = sizeof(HuffmanCode*) * ntrees;
-  /* Pointer alignment is, hopefully, wider than sizeof(HuffmanCode). */
-  HuffmanCode** p = (HuffmanCode**)BROTLI_DECODER_ALLOC(s,
-      code_size + htree_size);
+  const size_t size = HuffmanTreeGroupAllocSize(alphabet_size_limit, ntrees);
+  HuffmanCode** p = NULL;
+  int best = -1;
+  int i;
+  /* Take the smallest spare allocation that is big enough. */
+  for (i = 0; i < 3; ++i) {
+    if (s->spare_htrees[i] && s->spare_htrees_size[i] >= size &&
+        (best < 0 || s->spare_htrees_size[i] < s->spare_htrees_size[best])) {
+      best = i;
+    }
+  }
+  if (best >= 0) {
+    p = (HuffmanCode**)s->spare_htrees[best];
+    s->spare_htrees[best] = NULL;
+    s->spare_htrees_size[best] = 0;
+  } else {
+    /* Pointer alignment is, hopefully, wider than sizeof(HuffmanCode). */
+    p = (HuffmanCode**)BROTLI_DECODER_ALLOC(s, size);
+  }
   group->alphabet_size_max = (uint16_t)alphabet_size_max;
   group->alphabet_size_limit = (uint16_t)alphabet_size_limit;
   group->num_htrees = (uint16_t)ntrees;
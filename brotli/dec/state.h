@@ -10,8 +10,10 @@
 #define BROTLI_DEC_STATE_H_
 
 #include "../common/constants.h"
+#include "../common/crc32c.h"
 #include "../common/dictionary.h"
 #include "../common/platform.h"
+#include <brotli/decode.h>
 #include <brotli/shared_dictionary.h>
 #include "../common/transform.h"
 #include <brotli/types.h>
@@ -204,6 +206,42 @@ typedef struct BrotliDecoderCompoundDictionary {
   uint8_t block_map[256];
 } BrotliDecoderCompoundDictionary;
 
+/* Number of entries of prefix code table cache is 1 << this. */
+#define BROTLI_HUFFMAN_CACHE_BITS 8
+/* Longest complex prefix code: 2 bits of HSKIP, up to 18 4-bit code length
+   code lengths, up to 704 5-bit symbol code lengths. */
+#define BROTLI_HUFFMAN_CACHE_MAX_CODE_BYTES \
+  ((2 + 18 * 4 + BROTLI_NUM_COMMAND_SYMBOLS * 5 + 7) >> 3)
+
+/* Prefix code table cache entry; keyed by first 64 bits of the code and
+   alphabet size, verified with the whole bit string of the code. */
+typedef struct BrotliHuffmanCacheEntry {
+  uint64_t prefix;
+  uint16_t alphabet_size_max;
+  uint16_t alphabet_size_limit;
+  /* Length of the code in bits; 0 if only prefix is remembered. */
+  uint32_t bit_size;
+  uint32_t table_size;
+  /* Table is followed by the code bits; capacity is the size of the whole
+     block. */
+  size_t capacity;
+  HuffmanCode* table;
+} BrotliHuffmanCacheEntry;
+
+/* Number of entries of transformed dictionary word cache is 1 << this. */
+#define BROTLI_WORD_CACHE_BITS 6
+/* Longest transformed word that is cached; entries are copied out whole. */
+#define BROTLI_WORD_CACHE_MAX_LENGTH 48
+
+/* Dictionary word after transform; keyed by word and transform. */
+typedef struct BrotliWordCacheEntry {
+  const uint8_t* word;
+  const BrotliTransforms* transforms;
+  int transform_idx;
+  int len;
+  uint8_t data[BROTLI_WORD_CACHE_MAX_LENGTH];
+} BrotliWordCacheEntry;
+
 typedef struct BrotliMetablockHeaderArena {
   BrotliRunningTreeGroupState substate_tree_group;
   BrotliRunningContextMapState substate_context_map;
@@ -241,6 +279,10 @@ typedef struct BrotliMetablockHeaderArena {
   uint32_t max_run_length_prefix;
   uint32_t code;
   HuffmanCode context_map_table[BROTLI_HUFFMAN_MAX_SIZE_272];
+
+  /* For prefix code table cache. */
+  BrotliHuffmanCacheEntry* cache_entry;
+  BrotliBitReaderState cache_start;
 } BrotliMetablockHeaderArena;
 
 typedef struct BrotliMetablockBodyArena {
@@ -271,6 +313,9 @@ struct BrotliDecoderStateStruct {
   int pos;
   int max_backward_distance;
   int max_distance;
+  /* Virtual number of bytes before the stream; see
+     BROTLI_DECODER_PARAM_STREAM_OFFSET. */
+  int stream_offset;
   int ringbuffer_size;
   int ringbuffer_mask;
   int dist_rb_idx;
@@ -333,6 +378,16 @@ struct BrotliDecoderStateStruct {
   unsigned int should_wrap_ringbuffer : 1;
   unsigned int canny_ringbuffer_allocation : 1;
   unsigned int large_window : 1;
+  unsigned int huffman_table_cache : 1;
+  unsigned int low_memory : 1;
+  unsigned int collect_stats : 1;
+  unsigned int checksum : 1;
+  /* Checksum trailer was read and nothing was decoded after it. */
+  unsigned int checksum_trailer_seen : 1;
+  /* Stream starts with BROTLI_PARAM_DECLARE_SIZE metadata. */
+  unsigned int declared_size_seen : 1;
+  /* |dictionary| is borrowed from BrotliDecoderAttachSharedDictionary. */
+  unsigned int dictionary_is_shared : 1;
   unsigned int size_nibbles : 8;
   uint32_t window_bits;
 
@@ -345,8 +400,49 @@ struct BrotliDecoderStateStruct {
   BrotliSharedDictionary* dictionary;
   BrotliDecoderCompoundDictionary* compound_dictionary;
 
+  /* Allocated size of ringbuffer, without write-ahead slack. */
+  int ringbuffer_capacity;
+  /* Ring-buffer retained from the previous stream by BrotliDecoderStateReset;
+     it is adopted if the new stream fits into it. */
+  uint8_t* spare_ringbuffer;
+  int spare_ringbuffer_capacity;
+  /* Huffman tree group allocations retained between metablocks. */
+  void* spare_htrees[3];
+  size_t spare_htrees_size[3];
+
   uint32_t trivial_literal_contexts[8];  /* 256 bits */
 
+  /* Tables of complex prefix codes, kept across streams; allocated on first
+     use if huffman_table_cache is set. */
+  BrotliHuffmanCacheEntry* huffman_cache;
+
+  /* Recently transformed dictionary words, kept across streams; allocated
+     on first use, unless low_memory is set. Emptied when a dictionary is
+     attached, as words of a new one might reside at addresses of old ones. */
+  BrotliWordCacheEntry* word_cache;
+
+  /* Two-literal decoding table, built for literal_pairs_tree on demand. */
+  uint32_t* literal_pairs;
+  const HuffmanCode* literal_pairs_tree;
+
+  /* BrotliDecoderStat counters; updated only if collect_stats is set. */
+  uint64_t stats[BROTLI_DECODER_NUM_STATS];
+
+  /* CRC-32C of written output; updated only if checksum is set. */
+  uint32_t checksum_value;
+  /* Value of the checksum trailer, and the output size it was read at. */
+  uint32_t checksum_expected;
+  size_t checksum_position;
+  uint64_t declared_size;
+  /* Length and, if it is short, bytes of the current metadata block. */
+  int metadata_length;
+  uint8_t metadata_head[BROTLI_SIZE_METADATA_LENGTH];
+
+  /* Set with BrotliDecoderSetMetadataCallbacks; kept across resets. */
+  brotli_decoder_metadata_start_func metadata_start_func;
+  brotli_decoder_metadata_chunk_func metadata_chunk_func;
+  void* metadata_callback_opaque;
+
   union {
     BrotliMetablockHeaderArena header;
     BrotliMetablockBodyArena body;
@@ -359,6 +455,7 @@ typedef struct BrotliDecoderStateStruct BrotliDecoderStateInternal;
 BROTLI_INTERNAL BROTLI_BOOL BrotliDecoderStateInit(BrotliDecoderState* s,
     brotli_alloc_func alloc_func, brotli_free_func free_func, void* opaque);
 BROTLI_INTERNAL void BrotliDecoderStateCleanup(BrotliDecoderState* s);
+BROTLI_INTERNAL BROTLI_BOOL BrotliDecoderStateReset(BrotliDecoderState* s);
 BROTLI_INTERNAL void BrotliDecoderStateMetablockBegin(BrotliDecoderState* s);
 BROTLI_INTERNAL void BrotliDecoderStateCleanupAfterMetablock(
     BrotliDecoderState* s);
@@ -702,6 +702,56 @@ static void MergeMatches(BackwardMatch* dst,
   while (len2-- > 0) *dst++ = *src2++;
 }
 
+/* Quality 10 searches H10; qualities 5 to 9 search their hash chains. */
+static BROTLI_INLINE size_t ShortestPathHashTypeLength(const Hasher* hasher) {
+  switch (hasher->common.params.type) {
+#define CASE_(N) case N: return HashTypeLengthH ## N();
+    FOR_SHORTEST_PATH_HASHERS(CASE_)
+#undef CASE_
+    default: return 0;
+  }
+}
+
+static BROTLI_INLINE size_t ShortestPathStoreLookahead(const Hasher* hasher) {
+  switch (hasher->common.params.type) {
+#define CASE_(N) case N: return StoreLookaheadH ## N();
+    FOR_SHORTEST_PATH_HASHERS(CASE_)
+#undef CASE_
+    default: return 0;
+  }
+}
+
+static BROTLI_INLINE size_t ShortestPathFindAllMatches(Hasher* hasher,
+    const BrotliEncoderDictionary* dictionary, const uint8_t* data,
+    size_t ring_buffer_mask, size_t cur_ix, size_t max_length,
+    size_t max_backward, size_t dictionary_distance,
+    const BrotliEncoderParams* params, BackwardMatch* matches) {
+  switch (hasher->common.params.type) {
+#define CASE_(N)                                                          \
+    case N:                                                               \
+      return FindAllMatchesH ## N(&hasher->privat._H ## N, dictionary,    \
+          data, ring_buffer_mask, cur_ix, max_length, max_backward,       \
+          dictionary_distance, params, matches);
+    FOR_SHORTEST_PATH_HASHERS(CASE_)
+#undef CASE_
+    default: return 0;
+  }
+}
+
+static BROTLI_INLINE void ShortestPathStoreRange(Hasher* hasher,
+    const uint8_t* data, size_t mask, size_t ix_start, size_t ix_end) {
+  switch (hasher->common.params.type) {
+#define CASE_(N)                                                          \
+    case N:                                                               \
+      StoreRangeH ## N(&hasher->privat._H ## N, data, mask, ix_start,     \
+          ix_end);                                                        \
+      break;
+    FOR_SHORTEST_PATH_HASHERS(CASE_)
+#undef CASE_
+    default: break;
+  }
+}
+
 /* REQUIRES: nodes != NULL and len(nodes) >= num_bytes + 1 */
 size_t BrotliZopfliComputeShortestPath(MemoryManager* m, size_t num_bytes,
     size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
@@ -713,8 +763,10 @@ size_t BrotliZopfliComputeShortestPath(MemoryManager* m, size_t num_bytes,
   StartPosQueue queue;
   BackwardMatch* BROTLI_RESTRICT matches =
       BROTLI_ALLOC(m, BackwardMatch, 2 * (MAX_NUM_MATCHES_H10 + 64));
-  const size_t store_end = num_bytes >= StoreLookaheadH10() ?
-      position + num_bytes - StoreLookaheadH10() + 1 : position;
+  const size_t hash_type_length = ShortestPathHashTypeLength(hasher);
+  const size_t store_lookahead = ShortestPathStoreLookahead(hasher);
+  const size_t store_end = num_bytes >= store_lookahead ?
+      position + num_bytes - store_lookahead + 1 : position;
   size_t i;
   const CompoundDictionary* addon = &params->dictionary.compound;
   size_t gap = addon->total_size;
@@ -731,7 +783,7 @@ size_t BrotliZopfliComputeShortestPath(MemoryManager* m, size_t num_bytes,
   ZopfliCostModelSetFromLiteralCosts(
       model, position, ringbuffer, ringbuffer_mask);
   InitStartPosQueue(&queue);
-  for (i = 0; i + HashTypeLengthH10() - 1 < num_bytes; i++) {
+  for (i = 0; i + hash_type_length - 1 < num_bytes; i++) {
     const size_t pos = position + i;
     const size_t max_distance = BROTLI_MIN(size_t, pos, max_backward_limit);
     const size_t dictionary_start = BROTLI_MIN(size_t,
@@ -747,7 +799,7 @@ size_t BrotliZopfliComputeShortestPath(MemoryManager* m, size_t num_bytes,
       dict_id = params->dictionary.contextual.context_map[
           BROTLI_CONTEXT(p1, p2, literal_context_lut)];
     }
-    num_matches = FindAllMatchesH10(&hasher->privat._H10,
+    num_matches = ShortestPathFindAllMatches(hasher,
         params->dictionary.contextual.dict[dict_id],
         ringbuffer, ringbuffer_mask, pos, num_bytes - i, max_distance,
         dictionary_start + gap, params, &matches[lz_matches_offset]);
@@ -774,13 +826,13 @@ size_t BrotliZopfliComputeShortestPath(MemoryManager* m, size_t num_bytes,
     }
     if (skip > 1) {
       /* Add the tail of the copy to the hasher. */
-      StoreRangeH10(&hasher->privat._H10,
+      ShortestPathStoreRange(hasher,
           ringbuffer, ringbuffer_mask, pos + 1, BROTLI_MIN(
           size_t, pos + skip, store_end));
       skip--;
       while (skip) {
         i++;
-        if (i + HashTypeLengthH10() - 1 >= num_bytes) break;
+        if (i + hash_type_length - 1 >= num_bytes) break;
         EvaluateNode(position + stream_offset, i, max_backward_limit, gap,
             dist_cache, model, &queue, nodes);
         skip--;
@@ -793,13 +845,45 @@ size_t BrotliZopfliComputeShortestPath(MemoryManager* m, size_t num_bytes,
   return ComputeShortestPathFromNodes(num_bytes, nodes);
 }
 
-void BrotliCreateZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
+void BrotliInitZopfliArena(ZopfliArena* arena) {
+  arena->nodes = NULL;
+  arena->nodes_size = 0;
+  arena->num_matches = NULL;
+  arena->num_matches_size = 0;
+  arena->matches = NULL;
+  arena->matches_size = 0;
+}
+
+void BrotliCleanupZopfliArena(MemoryManager* m, ZopfliArena* arena) {
+  BROTLI_FREE(m, arena->nodes);
+  BROTLI_FREE(m, arena->num_matches);
+  BROTLI_FREE(m, arena->matches);
+  BrotliInitZopfliArena(arena);
+}
+
+/* Contents are not preserved; there is no need to copy them. */
+#define BROTLI_ARENA_ENSURE_SIZE(M, T, A, C, R) { \
+  if ((C) < (R)) {                                 \
+    BROTLI_FREE((M), A);                           \
+    C = 0;                                         \
+    A = BROTLI_ALLOC((M), T, (R));                 \
+    if (BROTLI_IS_OOM(M) || BROTLI_IS_NULL(A)) {   \
+      return;                                      \
+    }                                              \
+    C = (R);                                       \
+  }                                                \
+}
+
+void BrotliCreateZopfliBackwardReferences(MemoryManager* m,
+    ZopfliArena* arena, size_t num_bytes,
     size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
     ContextLut literal_context_lut, const BrotliEncoderParams* params,
     Hasher* hasher, int* dist_cache, size_t* last_insert_len,
     Command* commands, size_t* num_commands, size_t* num_literals) {
-  ZopfliNode* nodes = BROTLI_ALLOC(m, ZopfliNode, num_bytes + 1);
-  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(nodes)) return;
+  ZopfliNode* nodes;
+  BROTLI_ARENA_ENSURE_SIZE(m, ZopfliNode, arena->nodes, arena->nodes_size,
+      num_bytes + 1);
+  nodes = arena->nodes;
   BrotliInitZopfliNodes(nodes, num_bytes + 1);
   *num_commands += BrotliZopfliComputeShortestPath(m, num_bytes,
       position, ringbuffer, ringbuffer_mask, literal_context_lut, params,
@@ -807,18 +891,17 @@ void BrotliCreateZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
   if (BROTLI_IS_OOM(m)) return;
   BrotliZopfliCreateCommands(num_bytes, position, nodes, dist_cache,
       last_insert_len, params, commands, num_literals);
-  BROTLI_FREE(m, nodes);
 }
 
-void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
-    size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
+void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m,
+    ZopfliArena* arena, size_t num_bytes, size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
     ContextLut literal_context_lut, const BrotliEncoderParams* params,
     Hasher* hasher, int* dist_cache, size_t* last_insert_len,
     Command* commands, size_t* num_commands, size_t* num_literals) {
   const size_t stream_offset = params->stream_offset;
   const size_t max_backward_limit = BROTLI_MAX_BACKWARD_LIMIT(params->lgwin);
-  uint32_t* num_matches = BROTLI_ALLOC(m, uint32_t, num_bytes);
-  size_t matches_size = 4 * num_bytes;
+  uint32_t* num_matches;
+  size_t matches_size;
   const size_t store_end = num_bytes >= StoreLookaheadH10() ?
       position + num_bytes - StoreLookaheadH10() + 1 : position;
   size_t cur_match_pos = 0;
@@ -827,17 +910,22 @@ void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
   size_t orig_last_insert_len;
   int orig_dist_cache[4];
   size_t orig_num_commands;
-  ZopfliCostModel* model = BROTLI_ALLOC(m, ZopfliCostModel, 1);
+  ZopfliCostModel* model;
   ZopfliNode* nodes;
-  BackwardMatch* matches = BROTLI_ALLOC(m, BackwardMatch, matches_size);
+  BackwardMatch* matches;
   const CompoundDictionary* addon = &params->dictionary.compound;
   size_t gap = addon->total_size;
   size_t shadow_matches =
       (addon->num_chunks != 0) ? (MAX_NUM_MATCHES_H10 + 128) : 0;
-  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(model) ||
-      BROTLI_IS_NULL(num_matches) || BROTLI_IS_NULL(matches)) {
-    return;
-  }
+  BROTLI_ARENA_ENSURE_SIZE(m, uint32_t, arena->num_matches,
+      arena->num_matches_size, num_bytes);
+  BROTLI_ARENA_ENSURE_SIZE(m, BackwardMatch, arena->matches,
+      arena->matches_size, 4 * num_bytes);
+  num_matches = arena->num_matches;
+  matches = arena->matches;
+  matches_size = arena->matches_size;
+  model = BROTLI_ALLOC(m, ZopfliCostModel, 1);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(model)) return;
   for (i = 0; i + HashTypeLengthH10() - 1 < num_bytes; ++i) {
     const size_t pos = position + i;
     size_t max_distance = BROTLI_MIN(size_t, pos, max_backward_limit);
@@ -859,6 +947,8 @@ void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
     /* Ensure that we have enough free slots. */
     BROTLI_ENSURE_CAPACITY(m, BackwardMatch, matches, matches_size,
         cur_match_pos + MAX_NUM_MATCHES_H10 + shadow_matches);
+    arena->matches = matches;
+    arena->matches_size = matches_size;
     if (BROTLI_IS_OOM(m)) return;
     num_found_matches = FindAllMatchesH10(&hasher->privat._H10,
         params->dictionary.contextual.dict[dict_id],
@@ -902,8 +992,9 @@ void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
   orig_last_insert_len = *last_insert_len;
   memcpy(orig_dist_cache, dist_cache, 4 * sizeof(dist_cache[0]));
   orig_num_commands = *num_commands;
-  nodes = BROTLI_ALLOC(m, ZopfliNode, num_bytes + 1);
-  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(nodes)) return;
+  BROTLI_ARENA_ENSURE_SIZE(m, ZopfliNode, arena->nodes, arena->nodes_size,
+      num_bytes + 1);
+  nodes = arena->nodes;
   InitZopfliCostModel(m, model, &params->dist, num_bytes);
   if (BROTLI_IS_OOM(m)) return;
   for (i = 0; i < 2; i++) {
@@ -928,11 +1019,10 @@ void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m, size_t num_bytes,
   }
   CleanupZopfliCostModel(m, model);
   BROTLI_FREE(m, model);
-  BROTLI_FREE(m, nodes);
-  BROTLI_FREE(m, matches);
-  BROTLI_FREE(m, num_matches);
 }
 
+#undef BROTLI_ARENA_ENSURE_SIZE
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
@@ -23,20 +23,6 @@
 extern "C" {
 #endif
 
-BROTLI_INTERNAL void BrotliCreateZopfliBackwardReferences(MemoryManager* m,
-    size_t num_bytes,
-    size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
-    ContextLut literal_context_lut, const BrotliEncoderParams* params,
-    Hasher* hasher, int* dist_cache, size_t* last_insert_len,
-    Command* commands, size_t* num_commands, size_t* num_literals);
-
-BROTLI_INTERNAL void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m,
-    size_t num_bytes,
-    size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
-    ContextLut literal_context_lut, const BrotliEncoderParams* params,
-    Hasher* hasher, int* dist_cache, size_t* last_insert_len,
-    Command* commands, size_t* num_commands, size_t* num_literals);
-
 typedef struct ZopfliNode {
   /* Best length to get up to this byte (not including this byte itself)
      highest 7 bit is used to reconstruct the length code. */
@@ -64,6 +50,35 @@ typedef struct ZopfliNode {
 
 BROTLI_INTERNAL void BrotliInitZopfliNodes(ZopfliNode* array, size_t length);
 
+/* Transient buffers of quality 10 and 11 backward references search. Kept by
+   the encoder between input blocks and streams; they only grow. */
+typedef struct ZopfliArena {
+  ZopfliNode* nodes;
+  size_t nodes_size;
+  uint32_t* num_matches;
+  size_t num_matches_size;
+  BackwardMatch* matches;
+  size_t matches_size;
+} ZopfliArena;
+
+BROTLI_INTERNAL void BrotliInitZopfliArena(ZopfliArena* arena);
+BROTLI_INTERNAL void BrotliCleanupZopfliArena(
+    MemoryManager* m, ZopfliArena* arena);
+
+BROTLI_INTERNAL void BrotliCreateZopfliBackwardReferences(MemoryManager* m,
+    ZopfliArena* arena, size_t num_bytes,
+    size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
+    ContextLut literal_context_lut, const BrotliEncoderParams* params,
+    Hasher* hasher, int* dist_cache, size_t* last_insert_len,
+    Command* commands, size_t* num_commands, size_t* num_literals);
+
+BROTLI_INTERNAL void BrotliCreateHqZopfliBackwardReferences(MemoryManager* m,
+    ZopfliArena* arena, size_t num_bytes,
+    size_t position, const uint8_t* ringbuffer, size_t ringbuffer_mask,
+    ContextLut literal_context_lut, const BrotliEncoderParams* params,
+    Hasher* hasher, int* dist_cache, size_t* last_insert_len,
+    Command* commands, size_t* num_commands, size_t* num_literals);
+
 /* Computes the shortest path of commands from position to at most
    position + num_bytes.
 
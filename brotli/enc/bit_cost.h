@@ -56,6 +56,14 @@ BROTLI_INTERNAL double BrotliPopulationCostLiteral(const HistogramLiteral*);
 BROTLI_INTERNAL double BrotliPopulationCostCommand(const HistogramCommand*);
 BROTLI_INTERNAL double BrotliPopulationCostDistance(const HistogramDistance*);
 
+/* Same as BrotliPopulationCost* of the sum of two histograms. */
+BROTLI_INTERNAL double BrotliPopulationCostOfSumLiteral(
+    const HistogramLiteral*, const HistogramLiteral*);
+BROTLI_INTERNAL double BrotliPopulationCostOfSumCommand(
+    const HistogramCommand*, const HistogramCommand*);
+BROTLI_INTERNAL double BrotliPopulationCostOfSumDistance(
+    const HistogramDistance*, const HistogramDistance*);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
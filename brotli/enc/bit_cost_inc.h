@@ -8,8 +8,14 @@
 /* template parameters: FN */
 
 #define HistogramType FN(Histogram)
+#define BROTLI_POPULATION_COUNT(I) (b ? a[I] + b[I] : a[I])
 
-double FN(BrotliPopulationCost)(const HistogramType* histogram) {
+/* Estimates the cost of a histogram with counts a[i] + b[i]; b is NULL for
+   a single histogram. Elements are summed on the fly, so cost of combining
+   two histograms is evaluated without materializing the combination. */
+static BROTLI_INLINE double FN(PopulationCostInternal)(
+    const uint32_t* BROTLI_RESTRICT a, const uint32_t* BROTLI_RESTRICT b,
+    size_t total_count) {
   static const double kOneSymbolHistogramCost = 12;
   static const double kTwoSymbolHistogramCost = 20;
   static const double kThreeSymbolHistogramCost = 28;
@@ -19,11 +25,11 @@ double FN(BrotliPopulationCost)(const HistogramType* histogram) {
   size_t s[5];
   double bits = 0.0;
   size_t i;
-  if (histogram->total_count_ == 0) {
+  if (total_count == 0) {
     return kOneSymbolHistogramCost;
   }
   for (i = 0; i < data_size; ++i) {
-    if (histogram->data_[i] > 0) {
+    if (BROTLI_POPULATION_COUNT(i) > 0) {
       s[count] = i;
       ++count;
       if (count > 4) break;
@@ -33,12 +39,12 @@ double FN(BrotliPopulationCost)(const HistogramType* histogram) {
     return kOneSymbolHistogramCost;
   }
   if (count == 2) {
-    return (kTwoSymbolHistogramCost + (double)histogram->total_count_);
+    return (kTwoSymbolHistogramCost + (double)total_count);
   }
   if (count == 3) {
-    const uint32_t histo0 = histogram->data_[s[0]];
-    const uint32_t histo1 = histogram->data_[s[1]];
-    const uint32_t histo2 = histogram->data_[s[2]];
+    const uint32_t histo0 = BROTLI_POPULATION_COUNT(s[0]);
+    const uint32_t histo1 = BROTLI_POPULATION_COUNT(s[1]);
+    const uint32_t histo2 = BROTLI_POPULATION_COUNT(s[2]);
     const uint32_t histomax =
         BROTLI_MAX(uint32_t, histo0, BROTLI_MAX(uint32_t, histo1, histo2));
     return (kThreeSymbolHistogramCost +
@@ -49,7 +55,7 @@ double FN(BrotliPopulationCost)(const HistogramType* histogram) {
     uint32_t h23;
     uint32_t histomax;
     for (i = 0; i < 4; ++i) {
-      histo[i] = histogram->data_[s[i]];
+      histo[i] = BROTLI_POPULATION_COUNT(s[i]);
     }
     /* Sort */
     for (i = 0; i < 4; ++i) {
@@ -72,15 +78,16 @@ double FN(BrotliPopulationCost)(const HistogramType* histogram) {
        zero repeat code 17, but we don't use the non-zero repeat code 16. */
     size_t max_depth = 1;
     uint32_t depth_histo[BROTLI_CODE_LENGTH_CODES] = { 0 };
-    const double log2total = FastLog2(histogram->total_count_);
+    const double log2total = FastLog2(total_count);
     for (i = 0; i < data_size;) {
-      if (histogram->data_[i] > 0) {
+      const uint32_t population = BROTLI_POPULATION_COUNT(i);
+      if (population > 0) {
         /* Compute -log2(P(symbol)) = -log2(count(symbol)/total_count) =
                                     = log2(total_count) - log2(count(symbol)) */
-        double log2p = log2total - FastLog2(histogram->data_[i]);
+        double log2p = log2total - FastLog2(population);
         /* Approximate the bit depth by round(-log2(P(symbol))) */
         size_t depth = (size_t)(log2p + 0.5);
-        bits += histogram->data_[i] * log2p;
+        bits += population * log2p;
         if (depth > 15) {
           depth = 15;
         }
@@ -94,7 +101,8 @@ double FN(BrotliPopulationCost)(const HistogramType* histogram) {
            and 17 code length codes to the code length code histogram. */
         uint32_t reps = 1;
         size_t k;
-        for (k = i + 1; k < data_size && histogram->data_[k] == 0; ++k) {
+        for (k = i + 1;
+             k < data_size && BROTLI_POPULATION_COUNT(k) == 0; ++k) {
           ++reps;
         }
         i += reps;
@@ -124,4 +132,16 @@ double FN(BrotliPopulationCost)(const HistogramType* histogram) {
   return bits;
 }
 
+double FN(BrotliPopulationCost)(const HistogramType* histogram) {
+  return FN(PopulationCostInternal)(
+      histogram->data_, NULL, histogram->total_count_);
+}
+
+double FN(BrotliPopulationCostOfSum)(
+    const HistogramType* a, const HistogramType* b) {
+  return FN(PopulationCostInternal)(
+      a->data_, b->data_, a->total_count_ + b->total_count_);
+}
+
+#undef BROTLI_POPULATION_COUNT
 #undef HistogramType
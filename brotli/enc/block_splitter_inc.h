@@ -235,7 +235,7 @@ static void FN(ClusterBlocks)(MemoryManager* m,
   uint32_t* BROTLI_RESTRICT const block_lengths =
       u32 + 4 * HISTOGRAMS_PER_BATCH;
   /* TODO: move to arena? */
-  HistogramType* tmp = BROTLI_ALLOC(m, HistogramType, 2);
+  HistogramType* tmp = BROTLI_ALLOC(m, HistogramType, 1);
 
   if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(histogram_symbols) ||
       BROTLI_IS_NULL(u32) || BROTLI_IS_NULL(all_histograms) ||
@@ -278,7 +278,7 @@ static void FN(ClusterBlocks)(MemoryManager* m,
       sizes[j] = 1;
     }
     num_new_clusters = FN(BrotliHistogramCombine)(
-        histograms, tmp, sizes, symbols, new_clusters, pairs, num_to_combine,
+        histograms, sizes, symbols, new_clusters, pairs, num_to_combine,
         num_to_combine, HISTOGRAMS_PER_BATCH, max_num_pairs);
     BROTLI_ENSURE_CAPACITY(m, HistogramType, all_histograms,
         all_histograms_capacity, all_histograms_size + num_new_clusters);
@@ -313,7 +313,7 @@ static void FN(ClusterBlocks)(MemoryManager* m,
     clusters[i] = (uint32_t)i;
   }
   num_final_clusters = FN(BrotliHistogramCombine)(
-      all_histograms, tmp, cluster_size, histogram_symbols, clusters, pairs,
+      all_histograms, cluster_size, histogram_symbols, clusters, pairs,
       num_clusters, num_blocks, BROTLI_MAX_NUMBER_OF_BLOCK_TYPES,
       max_num_pairs);
   BROTLI_FREE(m, pairs);
@@ -338,10 +338,10 @@ static void FN(ClusterBlocks)(MemoryManager* m,
       /* TODO: should we give a block-switch discount here? */
       best_out = (i == 0) ? histogram_symbols[0] : histogram_symbols[i - 1];
       best_bits = FN(BrotliHistogramBitCostDistance)(
-          tmp, &all_histograms[best_out], tmp + 1);
+          tmp, &all_histograms[best_out]);
       for (j = 0; j < num_final_clusters; ++j) {
         const double cur_bits = FN(BrotliHistogramBitCostDistance)(
-            tmp, &all_histograms[clusters[j]], tmp + 1);
+            tmp, &all_histograms[clusters[j]]);
         if (cur_bits < best_bits) {
           best_bits = cur_bits;
           best_out = clusters[j];
@@ -442,7 +442,8 @@ static void FN(SplitByteVector)(MemoryManager* m,
                          num_histograms, histograms, tmp);
   {
     /* Find a good path through literals with the good entropy codes. */
-    uint8_t* block_ids = BROTLI_ALLOC(m, uint8_t, length);
+    uint8_t* block_ids = BROTLI_ALLOC(m, uint8_t, 2 * length);
+    uint8_t* prev_block_ids = block_ids + length;
     size_t num_blocks = 0;
     const size_t bitmaplen = (num_histograms + 7) >> 3;
     double* insert_cost = BROTLI_ALLOC(m, double, data_size * num_histograms);
@@ -464,6 +465,11 @@ static void FN(SplitByteVector)(MemoryManager* m,
                                   block_ids);
       num_histograms = FN(RemapBlockIds)(block_ids, length,
                                          new_id, num_histograms);
+      /* Same assignment gives same histograms, and then same assignment
+         again; refinement usually converges after a couple of rounds. */
+      if (i != 0 && memcmp(block_ids, prev_block_ids, length) == 0) break;
+      if (i + 1 == iters) break;
+      memcpy(prev_block_ids, block_ids, length);
       FN(BuildBlockHistograms)(data, length, block_ids,
                                num_histograms, histograms);
     }
@@ -83,7 +83,7 @@ static void BrotliEncodeMlen(size_t length, uint64_t* bits,
 }
 
 static BROTLI_INLINE void StoreCommandExtra(
-    const Command* cmd, size_t* storage_ix, uint8_t* storage) {
+    const Command* cmd, BrotliBitWriter* writer) {
   uint32_t copylen_code = CommandCopyLenCode(cmd);
   uint16_t inscode = GetInsertLengthCode(cmd->insert_len_);
   uint16_t copycode = GetCopyLengthCode(copylen_code);
@@ -91,8 +91,7 @@ static BROTLI_INLINE void StoreCommandExtra(
   uint64_t insextraval = cmd->insert_len_ - GetInsertBase(inscode);
   uint64_t copyextraval = copylen_code - GetCopyBase(copycode);
   uint64_t bits = (copyextraval << insnumextra) | insextraval;
-  BrotliWriteBits(
-      insnumextra + GetCopyExtra(copycode), bits, storage_ix, storage);
+  BrotliBitWriterPut(writer, insnumextra + GetCopyExtra(copycode), bits);
 }
 
 /* Data structure that stores almost everything that is needed to encode each
@@ -876,21 +875,23 @@ static void BuildAndStoreBlockSwitchEntropyCodes(BlockEncoder* self,
 
 /* Stores the next symbol with the entropy code of the current block type.
    Updates the block type and block length at block boundaries. */
-static void StoreSymbol(BlockEncoder* self, size_t symbol, size_t* storage_ix,
-    uint8_t* storage) {
+static void StoreSymbol(BlockEncoder* self, size_t symbol,
+    BrotliBitWriter* writer, uint8_t* storage) {
   if (self->block_len_ == 0) {
     size_t block_ix = ++self->block_ix_;
     uint32_t block_len = self->block_lengths_[block_ix];
     uint8_t block_type = self->block_types_[block_ix];
+    size_t storage_ix = BrotliBitWriterSync(writer, storage);
     self->block_len_ = block_len;
     self->entropy_ix_ = block_type * self->histogram_length_;
     StoreBlockSwitch(&self->block_split_code_, block_len, block_type, 0,
-        storage_ix, storage);
+        &storage_ix, storage);
+    BrotliBitWriterInit(writer, storage_ix, storage);
   }
   --self->block_len_;
   {
     size_t ix = self->entropy_ix_ + symbol;
-    BrotliWriteBits(self->depths_[ix], self->bits_[ix], storage_ix, storage);
+    BrotliBitWriterPut(writer, self->depths_[ix], self->bits_[ix]);
   }
 }
 
@@ -898,22 +899,24 @@ static void StoreSymbol(BlockEncoder* self, size_t symbol, size_t* storage_ix,
    context value.
    Updates the block type and block length at block boundaries. */
 static void StoreSymbolWithContext(BlockEncoder* self, size_t symbol,
-    size_t context, const uint32_t* context_map, size_t* storage_ix,
+    size_t context, const uint32_t* context_map, BrotliBitWriter* writer,
     uint8_t* storage, const size_t context_bits) {
   if (self->block_len_ == 0) {
     size_t block_ix = ++self->block_ix_;
     uint32_t block_len = self->block_lengths_[block_ix];
     uint8_t block_type = self->block_types_[block_ix];
+    size_t storage_ix = BrotliBitWriterSync(writer, storage);
     self->block_len_ = block_len;
     self->entropy_ix_ = (size_t)block_type << context_bits;
     StoreBlockSwitch(&self->block_split_code_, block_len, block_type, 0,
-        storage_ix, storage);
+        &storage_ix, storage);
+    BrotliBitWriterInit(writer, storage_ix, storage);
   }
   --self->block_len_;
   {
     size_t histo_ix = context_map[self->entropy_ix_ + context];
     size_t ix = histo_ix * self->histogram_length_ + symbol;
-    BrotliWriteBits(self->depths_[ix], self->bits_[ix], storage_ix, storage);
+    BrotliBitWriterPut(writer, self->depths_[ix], self->bits_[ix]);
   }
 }
 
@@ -962,6 +965,7 @@ void BrotliStoreMetaBlock(MemoryManager* m,
   BlockEncoder* command_enc = NULL;
   BlockEncoder* distance_enc = NULL;
   const BrotliDistanceParams* dist = &params->dist;
+  BrotliBitWriter writer;
   BROTLI_DCHECK(
       num_effective_distance_symbols <= BROTLI_NUM_HISTOGRAM_DISTANCE_SYMBOLS);
 
@@ -1031,15 +1035,16 @@ void BrotliStoreMetaBlock(MemoryManager* m,
   if (BROTLI_IS_OOM(m)) return;
   BROTLI_FREE(m, tree);
 
+  BrotliBitWriterInit(&writer, *storage_ix, storage);
   for (i = 0; i < n_commands; ++i) {
     const Command cmd = commands[i];
     size_t cmd_code = cmd.cmd_prefix_;
-    StoreSymbol(command_enc, cmd_code, storage_ix, storage);
-    StoreCommandExtra(&cmd, storage_ix, storage);
+    StoreSymbol(command_enc, cmd_code, &writer, storage);
+    StoreCommandExtra(&cmd, &writer);
     if (mb->literal_context_map_size == 0) {
       size_t j;
       for (j = cmd.insert_len_; j != 0; --j) {
-        StoreSymbol(literal_enc, input[pos & mask], storage_ix, storage);
+        StoreSymbol(literal_enc, input[pos & mask], &writer, storage);
         ++pos;
       }
     } else {
@@ -1049,7 +1054,7 @@ void BrotliStoreMetaBlock(MemoryManager* m,
             BROTLI_CONTEXT(prev_byte, prev_byte2, literal_context_lut);
         uint8_t literal = input[pos & mask];
         StoreSymbolWithContext(literal_enc, literal, context,
-            mb->literal_context_map, storage_ix, storage,
+            mb->literal_context_map, &writer, storage,
             BROTLI_LITERAL_CONTEXT_BITS);
         prev_byte2 = prev_byte;
         prev_byte = literal;
@@ -1065,17 +1070,18 @@ void BrotliStoreMetaBlock(MemoryManager* m,
         uint32_t distnumextra = cmd.dist_prefix_ >> 10;
         uint64_t distextra = cmd.dist_extra_;
         if (mb->distance_context_map_size == 0) {
-          StoreSymbol(distance_enc, dist_code, storage_ix, storage);
+          StoreSymbol(distance_enc, dist_code, &writer, storage);
         } else {
           size_t context = CommandDistanceContext(&cmd);
           StoreSymbolWithContext(distance_enc, dist_code, context,
-              mb->distance_context_map, storage_ix, storage,
+              mb->distance_context_map, &writer, storage,
               BROTLI_DISTANCE_CONTEXT_BITS);
         }
-        BrotliWriteBits(distnumextra, distextra, storage_ix, storage);
+        BrotliBitWriterPut(&writer, distnumextra, distextra);
       }
     }
   }
+  *storage_ix = BrotliBitWriterSync(&writer, storage);
   CleanupBlockEncoder(m, distance_enc);
   CleanupBlockEncoder(m, command_enc);
   CleanupBlockEncoder(m, literal_enc);
@@ -1097,12 +1103,11 @@ static void BuildHistograms(const uint8_t* input,
   size_t i;
   for (i = 0; i < n_commands; ++i) {
     const Command cmd = commands[i];
-    size_t j;
     HistogramAddCommand(cmd_histo, cmd.cmd_prefix_);
-    for (j = cmd.insert_len_; j != 0; --j) {
-      HistogramAddLiteral(lit_histo, input[pos & mask]);
-      ++pos;
-    }
+    BrotliHistogramAddRingBytes(
+        lit_histo->data_, input, pos, mask, cmd.insert_len_);
+    lit_histo->total_count_ += cmd.insert_len_;
+    pos += cmd.insert_len_;
     pos += CommandCopyLen(&cmd);
     if (CommandCopyLen(&cmd) && cmd.cmd_prefix_ >= 128) {
       HistogramAddDistance(dist_histo, cmd.dist_prefix_ & 0x3FF);
@@ -1125,17 +1130,17 @@ static void StoreDataWithHuffmanCodes(const uint8_t* input,
                                       uint8_t* storage) {
   size_t pos = start_pos;
   size_t i;
+  BrotliBitWriter writer;
+  BrotliBitWriterInit(&writer, *storage_ix, storage);
   for (i = 0; i < n_commands; ++i) {
     const Command cmd = commands[i];
     const size_t cmd_code = cmd.cmd_prefix_;
     size_t j;
-    BrotliWriteBits(
-        cmd_depth[cmd_code], cmd_bits[cmd_code], storage_ix, storage);
-    StoreCommandExtra(&cmd, storage_ix, storage);
+    BrotliBitWriterPut(&writer, cmd_depth[cmd_code], cmd_bits[cmd_code]);
+    StoreCommandExtra(&cmd, &writer);
     for (j = cmd.insert_len_; j != 0; --j) {
       const uint8_t literal = input[pos & mask];
-      BrotliWriteBits(
-          lit_depth[literal], lit_bits[literal], storage_ix, storage);
+      BrotliBitWriterPut(&writer, lit_depth[literal], lit_bits[literal]);
       ++pos;
     }
     pos += CommandCopyLen(&cmd);
@@ -1143,11 +1148,11 @@ static void StoreDataWithHuffmanCodes(const uint8_t* input,
       const size_t dist_code = cmd.dist_prefix_ & 0x3FF;
       const uint32_t distnumextra = cmd.dist_prefix_ >> 10;
       const uint32_t distextra = cmd.dist_extra_;
-      BrotliWriteBits(dist_depth[dist_code], dist_bits[dist_code],
-                      storage_ix, storage);
-      BrotliWriteBits(distnumextra, distextra, storage_ix, storage);
+      BrotliBitWriterPut(&writer, dist_depth[dist_code], dist_bits[dist_code]);
+      BrotliBitWriterPut(&writer, distnumextra, distextra);
     }
   }
+  *storage_ix = BrotliBitWriterSync(&writer, storage);
 }
 
 /* TODO: pull alloc/dealloc to caller? */
@@ -1231,12 +1236,9 @@ void BrotliStoreMetaBlockFast(MemoryManager* m,
     size_t i;
     for (i = 0; i < n_commands; ++i) {
       const Command cmd = commands[i];
-      size_t j;
-      for (j = cmd.insert_len_; j != 0; --j) {
-        ++histogram[input[pos & mask]];
-        ++pos;
-      }
+      BrotliHistogramAddRingBytes(histogram, input, pos, mask, cmd.insert_len_);
       num_literals += cmd.insert_len_;
+      pos += cmd.insert_len_;
       pos += CommandCopyLen(&cmd);
     }
     BrotliBuildAndStoreHuffmanTreeFast(arena->tree, histogram, num_literals,
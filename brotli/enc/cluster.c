@@ -27,6 +27,70 @@ static BROTLI_INLINE BROTLI_BOOL HistogramPairIsLess(
   return TO_BROTLI_BOOL((p1->idx2 - p1->idx1) > (p2->idx2 - p2->idx1));
 }
 
+/* The pair queue is a binary heap ordered by HistogramPairIsLess, so the best
+   pair is always pairs[0]. */
+static BROTLI_INLINE void HistogramPairSiftDown(
+    HistogramPair* pairs, size_t num_pairs, size_t i) {
+  HistogramPair p = pairs[i];
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= num_pairs) break;
+    if (child + 1 < num_pairs &&
+        HistogramPairIsLess(&pairs[child], &pairs[child + 1])) {
+      ++child;
+    }
+    if (!HistogramPairIsLess(&p, &pairs[child])) break;
+    pairs[i] = pairs[child];
+    i = child;
+  }
+  pairs[i] = p;
+}
+
+static BROTLI_INLINE void HistogramPairHeapPush(
+    HistogramPair* pairs, size_t* num_pairs, const HistogramPair* p) {
+  size_t i = (*num_pairs)++;
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!HistogramPairIsLess(&pairs[parent], p)) break;
+    pairs[i] = pairs[parent];
+    i = parent;
+  }
+  pairs[i] = *p;
+}
+
+static BROTLI_INLINE void HistogramPairHeapPop(
+    HistogramPair* pairs, size_t* num_pairs) {
+  --(*num_pairs);
+  if (*num_pairs > 0) {
+    pairs[0] = pairs[*num_pairs];
+    HistogramPairSiftDown(pairs, *num_pairs, 0);
+  }
+}
+
+/* Merged-away clusters have zero size. */
+static BROTLI_INLINE BROTLI_BOOL HistogramPairIsStale(
+    const HistogramPair* p, const uint32_t* cluster_size) {
+  return TO_BROTLI_BOOL(cluster_size[p->idx1] == 0 ||
+      cluster_size[p->idx2] == 0 ||
+      cluster_size[p->idx1] + cluster_size[p->idx2] != p->size_sum);
+}
+
+/* Drops stale pairs and restores the heap property. */
+static void HistogramPairCompact(
+    HistogramPair* pairs, size_t* num_pairs, const uint32_t* cluster_size) {
+  size_t copy_to_idx = 0;
+  size_t i;
+  for (i = 0; i < *num_pairs; ++i) {
+    if (!HistogramPairIsStale(&pairs[i], cluster_size)) {
+      pairs[copy_to_idx++] = pairs[i];
+    }
+  }
+  *num_pairs = copy_to_idx;
+  for (i = copy_to_idx / 2; i > 0; --i) {
+    HistogramPairSiftDown(pairs, copy_to_idx, i - 1);
+  }
+}
+
 /* Returns entropy reduction of the context map when we combine two clusters. */
 static BROTLI_INLINE double ClusterCostDiff(size_t size_a, size_t size_b) {
   size_t size_c = size_a + size_b;
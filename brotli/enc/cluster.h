@@ -18,9 +18,13 @@
 extern "C" {
 #endif
 
+/* Candidate merge of two clusters. |size_sum| is the sum of both cluster sizes
+   when the pair was evaluated; cluster sizes only grow, so a mismatch means one
+   of the clusters has been merged into since and the pair is stale. */
 typedef struct HistogramPair {
   uint32_t idx1;
   uint32_t idx2;
+  uint32_t size_sum;
   double cost_combo;
   double cost_diff;
 } HistogramPair;
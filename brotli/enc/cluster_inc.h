@@ -10,14 +10,14 @@
 #define HistogramType FN(Histogram)
 
 /* Computes the bit cost reduction by combining out[idx1] and out[idx2] and if
-   it is below a threshold, stores the pair (idx1, idx2) in the *pairs queue. */
+   it is below a threshold, stores the pair (idx1, idx2) in the *pairs heap. */
 BROTLI_INTERNAL void FN(BrotliCompareAndPushToQueue)(
-    const HistogramType* out, HistogramType* tmp, const uint32_t* cluster_size,
-    uint32_t idx1, uint32_t idx2, size_t max_num_pairs, HistogramPair* pairs,
+    const HistogramType* out, const uint32_t* cluster_size, uint32_t idx1,
+    uint32_t idx2, size_t max_num_pairs, HistogramPair* pairs,
     size_t* num_pairs) CODE({
   BROTLI_BOOL is_good_pair = BROTLI_FALSE;
   HistogramPair p;
-  p.idx1 = p.idx2 = 0;
+  p.idx1 = p.idx2 = p.size_sum = 0;
   p.cost_diff = p.cost_combo = 0;
   if (idx1 == idx2) {
     return;
@@ -42,10 +42,7 @@ BROTLI_INTERNAL void FN(BrotliCompareAndPushToQueue)(
   } else {
     double threshold = *num_pairs == 0 ? 1e99 :
         BROTLI_MAX(double, 0.0, pairs[0].cost_diff);
-    double cost_combo;
-    *tmp = out[idx1];
-    FN(HistogramAddHistogram)(tmp, &out[idx2]);
-    cost_combo = FN(BrotliPopulationCost)(tmp);
+    double cost_combo = FN(BrotliPopulationCostOfSum)(&out[idx1], &out[idx2]);
     if (cost_combo < threshold - p.cost_diff) {
       p.cost_combo = cost_combo;
       is_good_pair = BROTLI_TRUE;
@@ -53,22 +50,17 @@ BROTLI_INTERNAL void FN(BrotliCompareAndPushToQueue)(
   }
   if (is_good_pair) {
     p.cost_diff += p.cost_combo;
-    if (*num_pairs > 0 && HistogramPairIsLess(&pairs[0], &p)) {
-      /* Replace the top of the queue if needed. */
-      if (*num_pairs < max_num_pairs) {
-        pairs[*num_pairs] = pairs[0];
-        ++(*num_pairs);
-      }
+    p.size_sum = cluster_size[idx1] + cluster_size[idx2];
+    if (*num_pairs < max_num_pairs) {
+      HistogramPairHeapPush(pairs, num_pairs, &p);
+    } else if (HistogramPairIsLess(&pairs[0], &p)) {
+      /* Queue is full: the new best pair replaces the top. */
       pairs[0] = p;
-    } else if (*num_pairs < max_num_pairs) {
-      pairs[*num_pairs] = p;
-      ++(*num_pairs);
     }
   }
 })
 
 BROTLI_INTERNAL size_t FN(BrotliHistogramCombine)(HistogramType* out,
-                                                  HistogramType* tmp,
                                                   uint32_t* cluster_size,
                                                   uint32_t* symbols,
                                                   uint32_t* clusters,
@@ -82,13 +74,14 @@ BROTLI_INTERNAL size_t FN(BrotliHistogramCombine)(HistogramType* out,
   size_t num_pairs = 0;
 
   {
-    /* We maintain a vector of histogram pairs, with the property that the pair
-       with the maximum bit cost reduction is the first. */
+    /* We maintain a heap of histogram pairs, with the property that the pair
+       with the maximum bit cost reduction is the first. Pairs invalidated by
+       a merge are left in place and skipped once they reach the top. */
     size_t idx1;
     for (idx1 = 0; idx1 < num_clusters; ++idx1) {
       size_t idx2;
       for (idx2 = idx1 + 1; idx2 < num_clusters; ++idx2) {
-        FN(BrotliCompareAndPushToQueue)(out, tmp, cluster_size, clusters[idx1],
+        FN(BrotliCompareAndPushToQueue)(out, cluster_size, clusters[idx1],
             clusters[idx2], max_num_pairs, &pairs[0], &num_pairs);
       }
     }
@@ -109,6 +102,7 @@ BROTLI_INTERNAL size_t FN(BrotliHistogramCombine)(HistogramType* out,
     FN(HistogramAddHistogram)(&out[best_idx1], &out[best_idx2]);
     out[best_idx1].bit_cost_ = pairs[0].cost_combo;
     cluster_size[best_idx1] += cluster_size[best_idx2];
+    cluster_size[best_idx2] = 0;
     for (i = 0; i < symbols_size; ++i) {
       if (symbols[i] == best_idx2) {
         symbols[i] = best_idx1;
@@ -122,32 +116,19 @@ BROTLI_INTERNAL size_t FN(BrotliHistogramCombine)(HistogramType* out,
       }
     }
     --num_clusters;
-    {
-      /* Remove pairs intersecting the just combined best pair. */
-      size_t copy_to_idx = 0;
-      for (i = 0; i < num_pairs; ++i) {
-        HistogramPair* p = &pairs[i];
-        if (p->idx1 == best_idx1 || p->idx2 == best_idx1 ||
-            p->idx1 == best_idx2 || p->idx2 == best_idx2) {
-          /* Remove invalid pair from the queue. */
-          continue;
-        }
-        if (HistogramPairIsLess(&pairs[0], p)) {
-          /* Replace the top of the queue if needed. */
-          HistogramPair front = pairs[0];
-          pairs[0] = *p;
-          pairs[copy_to_idx] = front;
-        } else {
-          pairs[copy_to_idx] = *p;
-        }
-        ++copy_to_idx;
-      }
-      num_pairs = copy_to_idx;
+    /* Pairs intersecting the just combined best pair are now stale; the top
+       one always is. Discard them until a live pair reaches the top. */
+    do {
+      HistogramPairHeapPop(pairs, &num_pairs);
+    } while (num_pairs > 0 && HistogramPairIsStale(&pairs[0], cluster_size));
+    /* Purge the rest only if the new pairs might not fit otherwise. */
+    if (num_pairs + num_clusters > max_num_pairs) {
+      HistogramPairCompact(pairs, &num_pairs, cluster_size);
     }
 
     /* Push new pairs formed with the combined histogram to the heap. */
     for (i = 0; i < num_clusters; ++i) {
-      FN(BrotliCompareAndPushToQueue)(out, tmp, cluster_size, best_idx1,
+      FN(BrotliCompareAndPushToQueue)(out, cluster_size, best_idx1,
           clusters[i], max_num_pairs, &pairs[0], &num_pairs);
     }
   }
@@ -156,14 +137,12 @@ BROTLI_INTERNAL size_t FN(BrotliHistogramCombine)(HistogramType* out,
 
 /* What is the bit cost of moving histogram from cur_symbol to candidate. */
 BROTLI_INTERNAL double FN(BrotliHistogramBitCostDistance)(
-    const HistogramType* histogram, const HistogramType* candidate,
-    HistogramType* tmp) CODE({
+    const HistogramType* histogram, const HistogramType* candidate) CODE({
   if (histogram->total_count_ == 0) {
     return 0.0;
   } else {
-    *tmp = *histogram;
-    FN(HistogramAddHistogram)(tmp, candidate);
-    return FN(BrotliPopulationCost)(tmp) - candidate->bit_cost_;
+    return FN(BrotliPopulationCostOfSum)(histogram, candidate) -
+        candidate->bit_cost_;
   }
 })
 
@@ -173,16 +152,16 @@ BROTLI_INTERNAL double FN(BrotliHistogramBitCostDistance)(
    Note: we assume that out[]->bit_cost_ is already up-to-date. */
 BROTLI_INTERNAL void FN(BrotliHistogramRemap)(const HistogramType* in,
     size_t in_size, const uint32_t* clusters, size_t num_clusters,
-    HistogramType* out, HistogramType* tmp, uint32_t* symbols) CODE({
+    HistogramType* out, uint32_t* symbols) CODE({
   size_t i;
   for (i = 0; i < in_size; ++i) {
     uint32_t best_out = i == 0 ? symbols[0] : symbols[i - 1];
     double best_bits =
-        FN(BrotliHistogramBitCostDistance)(&in[i], &out[best_out], tmp);
+        FN(BrotliHistogramBitCostDistance)(&in[i], &out[best_out]);
     size_t j;
     for (j = 0; j < num_clusters; ++j) {
       const double cur_bits =
-          FN(BrotliHistogramBitCostDistance)(&in[i], &out[clusters[j]], tmp);
+          FN(BrotliHistogramBitCostDistance)(&in[i], &out[clusters[j]]);
       if (cur_bits < best_bits) {
         best_bits = cur_bits;
         best_out = clusters[j];
@@ -259,12 +238,10 @@ BROTLI_INTERNAL void FN(BrotliClusterHistograms)(
   size_t pairs_capacity = max_input_histograms * max_input_histograms / 2;
   /* For the first pass of clustering, we allow all pairs. */
   HistogramPair* pairs = BROTLI_ALLOC(m, HistogramPair, pairs_capacity + 1);
-  /* TODO: move to "persistent" arena? */
-  HistogramType* tmp = BROTLI_ALLOC(m, HistogramType, 1);
   size_t i;
 
   if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(cluster_size) ||
-      BROTLI_IS_NULL(clusters) || BROTLI_IS_NULL(pairs)|| BROTLI_IS_NULL(tmp)) {
+      BROTLI_IS_NULL(clusters) || BROTLI_IS_NULL(pairs)) {
     return;
   }
 
@@ -287,7 +264,7 @@ BROTLI_INTERNAL void FN(BrotliClusterHistograms)(
       clusters[num_clusters + j] = (uint32_t)(i + j);
     }
     num_new_clusters =
-        FN(BrotliHistogramCombine)(out, tmp, cluster_size,
+        FN(BrotliHistogramCombine)(out, cluster_size,
                                    &histogram_symbols[i],
                                    &clusters[num_clusters], pairs,
                                    num_to_combine, num_to_combine,
@@ -305,7 +282,7 @@ BROTLI_INTERNAL void FN(BrotliClusterHistograms)(
     if (BROTLI_IS_OOM(m)) return;
 
     /* Collapse similar histograms. */
-    num_clusters = FN(BrotliHistogramCombine)(out, tmp, cluster_size,
+    num_clusters = FN(BrotliHistogramCombine)(out, cluster_size,
                                               histogram_symbols, clusters,
                                               pairs, num_clusters, in_size,
                                               max_histograms, max_num_pairs);
@@ -314,8 +291,7 @@ BROTLI_INTERNAL void FN(BrotliClusterHistograms)(
   BROTLI_FREE(m, cluster_size);
   /* Find the optimal map from original histograms to the final ones. */
   FN(BrotliHistogramRemap)(in, in_size, clusters, num_clusters,
-                           out, tmp, histogram_symbols);
-  BROTLI_FREE(m, tmp);
+                           out, histogram_symbols);
   BROTLI_FREE(m, clusters);
   /* Convert the context map to a canonical form. */
   *out_size = FN(BrotliHistogramReindex)(m, out, histogram_symbols, in_size);
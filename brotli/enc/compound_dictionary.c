@@ -13,18 +13,20 @@
 
 static PreparedDictionary* CreatePreparedDictionaryWithParams(MemoryManager* m,
     const uint8_t* source, size_t source_size, uint32_t bucket_bits,
-    uint32_t slot_bits, uint32_t hash_bits, uint16_t bucket_limit) {
+    uint32_t slot_bits, uint32_t hash_bits, uint16_t bucket_limit,
+    uint32_t stride_bits, BROTLI_BOOL lean) {
   /* Step 1: create "bloated" hasher. */
   uint32_t num_slots = 1u << slot_bits;
   uint32_t num_buckets = 1u << bucket_bits;
   uint32_t hash_shift = 64u - bucket_bits;
   uint64_t hash_mask = (~((uint64_t)0U)) >> (64 - hash_bits);
   uint32_t slot_mask = num_slots - 1;
+  size_t num_positions = ((source_size >> stride_bits) + 1);
   size_t alloc_size = (sizeof(uint32_t) << slot_bits) +
       (sizeof(uint32_t) << slot_bits) +
       (sizeof(uint16_t) << bucket_bits) +
       (sizeof(uint32_t) << bucket_bits) +
-      (sizeof(uint32_t) * source_size);
+      (sizeof(uint32_t) * num_positions);
   uint8_t* flat = NULL;
   PreparedDictionary* result = NULL;
   uint16_t* num = NULL;
@@ -53,12 +55,13 @@ static PreparedDictionary* CreatePreparedDictionaryWithParams(MemoryManager* m,
   memset(num, 0, num_buckets * sizeof(num[0]));
 
   /* TODO: apply custom "store" order. */
-  for (i = 0; i + 7 < source_size; ++i) {
+  for (i = 0; i + 7 < source_size; i += 1u << stride_bits) {
     const uint64_t h = (BROTLI_UNALIGNED_LOAD64LE(&source[i]) & hash_mask) *
         kPreparedDictionaryHashMul64Long;
     const uint32_t key = (uint32_t)(h >> hash_shift);
     uint16_t count = num[key];
-    next_bucket[i] = (count == 0) ? ((uint32_t)(-1)) : bucket_heads[key];
+    next_bucket[i >> stride_bits] =
+        (count == 0) ? ((uint32_t)(-1)) : bucket_heads[key];
     bucket_heads[key] = i;
     count++;
     if (count > bucket_limit) count = bucket_limit;
@@ -97,7 +100,7 @@ static PreparedDictionary* CreatePreparedDictionaryWithParams(MemoryManager* m,
   /* Step 3: transfer data to "slim" hasher. */
   alloc_size = sizeof(PreparedDictionary) + (sizeof(uint32_t) << slot_bits) +
       (sizeof(uint16_t) << bucket_bits) + (sizeof(uint32_t) * total_items) +
-      source_size;
+      (lean ? sizeof(source) : source_size);
 
   result = (PreparedDictionary*)BROTLI_ALLOC(m, uint8_t, alloc_size);
   if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(result)) {
@@ -109,7 +112,8 @@ static PreparedDictionary* CreatePreparedDictionaryWithParams(MemoryManager* m,
   items = (uint32_t*)(&heads[num_buckets]);
   source_copy = (uint8_t*)(&items[total_items]);
 
-  result->magic = kPreparedDictionaryMagic;
+  result->magic =
+      lean ? kLeanPreparedDictionaryMagic : kPreparedDictionaryMagic;
   result->source_offset = total_items;
   result->source_size = (uint32_t)source_size;
   result->hash_bits = hash_bits;
@@ -139,31 +143,37 @@ static PreparedDictionary* CreatePreparedDictionaryWithParams(MemoryManager* m,
     pos = bucket_heads[i];
     for (j = 0; j < count; j++) {
       items[cursor++] = pos;
-      pos = next_bucket[pos];
+      pos = next_bucket[pos >> stride_bits];
     }
     items[cursor - 1] |= 0x80000000;
   }
 
   BROTLI_FREE(m, flat);
-  memcpy(source_copy, source, source_size);
+  if (lean) {
+    memcpy(source_copy, &source, sizeof(source));
+  } else {
+    memcpy(source_copy, source, source_size);
+  }
   return result;
 }
 
 PreparedDictionary* CreatePreparedDictionary(MemoryManager* m,
-    const uint8_t* source, size_t source_size) {
+    const uint8_t* source, size_t source_size, int quality, BROTLI_BOOL lean) {
   uint32_t bucket_bits = 17;
   uint32_t slot_bits = 7;
   uint32_t hash_bits = 40;
   uint16_t bucket_limit = 32;
+  /* Zopfli qualities look for every match anyway. */
+  uint32_t stride_bits = (quality >= 10) ? 0 : (quality >= 5) ? 1 : 2;
   size_t volume = 16u << bucket_bits;
-  /* Tune parameters to fit dictionary size. */
-  while (volume < source_size && bucket_bits < 22) {
+  /* Tune parameters to fit number of indexed positions. */
+  while (volume < (source_size >> stride_bits) && bucket_bits < 22) {
     bucket_bits++;
     slot_bits++;
     volume <<= 1;
   }
-  return CreatePreparedDictionaryWithParams(m,
-      source, source_size, bucket_bits, slot_bits, hash_bits, bucket_limit);
+  return CreatePreparedDictionaryWithParams(m, source, source_size,
+      bucket_bits, slot_bits, hash_bits, bucket_limit, stride_bits, lean);
 }
 
 void DestroyPreparedDictionary(MemoryManager* m,
@@ -188,13 +198,7 @@ BROTLI_BOOL AttachPreparedDictionary(
   compound->total_size += length;
   compound->chunks[index] = dictionary;
   compound->chunk_offsets[index + 1] = compound->total_size;
-  {
-    uint32_t* slot_offsets = (uint32_t*)(&dictionary[1]);
-    uint16_t* heads = (uint16_t*)(&slot_offsets[1u << dictionary->slot_bits]);
-    uint32_t* items = (uint32_t*)(&heads[1u << dictionary->bucket_bits]);
-    compound->chunk_source[index] =
-        (const uint8_t*)(&items[dictionary->source_offset]);
-  }
+  compound->chunk_source[index] = PreparedDictionarySource(dictionary);
   compound->num_chunks++;
   return BROTLI_TRUE;
 }
@@ -7,6 +7,8 @@
 #ifndef BROTLI_ENC_PREPARED_DICTIONARY_H_
 #define BROTLI_ENC_PREPARED_DICTIONARY_H_
 
+#include <string.h>  /* memcpy */
+
 #include "../common/platform.h"
 #include "../common/constants.h"
 #include <brotli/shared_dictionary.h>
@@ -14,6 +16,8 @@
 #include "./memory.h"
 
 static const uint32_t kPreparedDictionaryMagic = 0xDEBCEDE0;
+/* Same layout, but source is referenced rather than copied. */
+static const uint32_t kLeanPreparedDictionaryMagic = 0xDEBCEDE3;
 static const uint64_t kPreparedDictionaryHashMul64Long =
     BROTLI_MAKE_UINT64_T(0x1FE35A7Bu, 0xD3579BD3u);
 
@@ -31,11 +35,29 @@ typedef struct PreparedDictionary {
   /* uint16_t heads[1 << bucket_bits]; */
   /* uint32_t items[variable]; */
 
-  /* uint8_t source[source_size] */
+  /* uint8_t source[source_size] or, in lean one: const uint8_t* source */
 } PreparedDictionary;
 
+/* Lower |quality| indexes fewer positions of |source|: preparing is faster,
+   but matches are found a few bytes late. Lean dictionary references
+   |source|, which then must outlive it. */
 BROTLI_INTERNAL PreparedDictionary* CreatePreparedDictionary(MemoryManager* m,
-    const uint8_t* source, size_t source_size);
+    const uint8_t* source, size_t source_size, int quality, BROTLI_BOOL lean);
+
+static BROTLI_INLINE const uint8_t* PreparedDictionarySource(
+    const PreparedDictionary* dictionary) {
+  const uint32_t* slot_offsets = (const uint32_t*)(&dictionary[1]);
+  const uint16_t* heads =
+      (const uint16_t*)(&slot_offsets[1u << dictionary->slot_bits]);
+  const uint32_t* items =
+      (const uint32_t*)(&heads[1u << dictionary->bucket_bits]);
+  const uint8_t* source = (const uint8_t*)(&items[dictionary->source_offset]);
+  if (dictionary->magic == kLeanPreparedDictionaryMagic) {
+    /* Pointer is not necessarily aligned. */
+    memcpy(&source, source, sizeof(source));
+  }
+  return source;
+}
 
 BROTLI_INTERNAL void DestroyPreparedDictionary(MemoryManager* m,
     PreparedDictionary* dictionary);
@@ -22,6 +22,7 @@
 #include "./entropy_encode.h"
 #include "./fast_log.h"
 #include "./find_match_length.h"
+#include "./histogram.h"
 #include "./write_bits.h"
 
 #if defined(__cplusplus) || defined(c_plusplus)
@@ -54,13 +55,13 @@ static BROTLI_INLINE uint32_t HashBytesAtOffset(uint64_t v, size_t offset,
   }
 }
 
+/* Compares |length| (4 or 6) bytes with a single 64-bit load of each side;
+   there are at least 8 readable bytes after both pointers. */
 static BROTLI_INLINE BROTLI_BOOL IsMatch(const uint8_t* p1, const uint8_t* p2,
     size_t length) {
-  if (BrotliUnalignedRead32(p1) == BrotliUnalignedRead32(p2)) {
-    if (length == 4) return BROTLI_TRUE;
-    return TO_BROTLI_BOOL(p1[4] == p2[4] && p1[5] == p2[5]);
-  }
-  return BROTLI_FALSE;
+  const uint64_t diff =
+      BROTLI_UNALIGNED_LOAD64LE(p1) ^ BROTLI_UNALIGNED_LOAD64LE(p2);
+  return TO_BROTLI_BOOL((diff << (64 - 8 * length)) == 0);
 }
 
 /* Builds a command and distance prefix code (each 64 symbols) into "depth" and
@@ -471,15 +472,14 @@ static void StoreCommands(BrotliTwoPassArena* s,
   };
 
   size_t i;
+  BrotliBitWriter writer;
   memset(s->lit_histo, 0, sizeof(s->lit_histo));
   /* TODO: is that necessary? */
   memset(s->cmd_depth, 0, sizeof(s->cmd_depth));
   /* TODO: is that necessary? */
   memset(s->cmd_bits, 0, sizeof(s->cmd_bits));
   memset(s->cmd_histo, 0, sizeof(s->cmd_histo));
-  for (i = 0; i < num_literals; ++i) {
-    ++s->lit_histo[literals[i]];
-  }
+  BrotliHistogramAddBytes(s->lit_histo, literals, num_literals);
   BrotliBuildAndStoreHuffmanTreeFast(s->tmp_tree, s->lit_histo, num_literals,
                                      /* max_bits = */ 8, s->lit_depth,
                                      s->lit_bits, storage_ix, storage);
@@ -495,24 +495,25 @@ static void StoreCommands(BrotliTwoPassArena* s,
   s->cmd_histo[84] += 1;
   BuildAndStoreCommandPrefixCode(s, storage_ix, storage);
 
+  BrotliBitWriterInit(&writer, *storage_ix, storage);
   for (i = 0; i < num_commands; ++i) {
     const uint32_t cmd = commands[i];
     const uint32_t code = cmd & 0xFF;
     const uint32_t extra = cmd >> 8;
     BROTLI_DCHECK(code < 128);
-    BrotliWriteBits(s->cmd_depth[code], s->cmd_bits[code], storage_ix, storage);
-    BrotliWriteBits(kNumExtraBits[code], extra, storage_ix, storage);
+    BrotliBitWriterPut(&writer, s->cmd_depth[code], s->cmd_bits[code]);
+    BrotliBitWriterPut(&writer, kNumExtraBits[code], extra);
     if (code < 24) {
       const uint32_t insert = kInsertOffset[code] + extra;
       uint32_t j;
       for (j = 0; j < insert; ++j) {
         const uint8_t lit = *literals;
-        BrotliWriteBits(s->lit_depth[lit], s->lit_bits[lit], storage_ix,
-                        storage);
+        BrotliBitWriterPut(&writer, s->lit_depth[lit], s->lit_bits[lit]);
         ++literals;
       }
     }
   }
+  *storage_ix = BrotliBitWriterSync(&writer, storage);
 }
 
 /* Acceptable loss for uncompressible speedup is 2% */
@@ -0,0 +1,111 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Guessing of encoder settings from the beginning of input. */
+
+#include "./content_sniff.h"
+
+#include <string.h>  /* memcmp, memset */
+
+#include "../common/platform.h"
+#include <brotli/encode.h>
+#include <brotli/types.h>
+#include "./bit_cost.h"
+#include "./utf8_util.h"
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/* Minimal saving, in bits per byte, that counts as column structure. */
+static const double kMinLaneGain = 0.5;
+/* Markup and JSON pass as text with more non-UTF8 noise. */
+static const double kMinMarkupUTF8Ratio = 0.5;
+
+static BROTLI_BOOL IsFont(const uint8_t* data, size_t size) {
+  static const char kMagics[][4] = {
+    {'w', 'O', 'F', 'F'}, {'w', 'O', 'F', '2'}, {'O', 'T', 'T', 'O'},
+    {'t', 't', 'c', 'f'}, {'t', 'r', 'u', 'e'}, {0, 1, 0, 0}
+  };
+  size_t i;
+  if (size < 4) return BROTLI_FALSE;
+  for (i = 0; i < sizeof(kMagics) / sizeof(kMagics[0]); ++i) {
+    if (memcmp(data, kMagics[i], 4) == 0) return BROTLI_TRUE;
+  }
+  return BROTLI_FALSE;
+}
+
+/* Checks if data starts (after whitespace or BOM) with '<', '{', or '['. */
+static BROTLI_BOOL IsMarkup(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+    i = 3;
+  }
+  while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' ||
+         data[i] == '\n')) {
+    ++i;
+  }
+  if (i == size) return BROTLI_FALSE;
+  return TO_BROTLI_BOOL(data[i] == '<' || data[i] == '{' || data[i] == '[');
+}
+
+/* Returns bits per byte saved by coding each of |lanes| interleaved byte
+   columns with its own histogram. */
+static double LaneGain(const uint8_t* data, size_t size, size_t lanes,
+                       uint32_t* histograms) {
+  size_t total;
+  double whole;
+  double split = 0;
+  size_t i;
+  memset(histograms, 0, sizeof(uint32_t) * 256 * (lanes + 1));
+  for (i = 0; i < size; ++i) {
+    histograms[data[i]]++;
+    histograms[256 * (1 + (i % lanes)) + data[i]]++;
+  }
+  whole = ShannonEntropy(histograms, 256, &total);
+  for (i = 1; i <= lanes; ++i) {
+    split += ShannonEntropy(&histograms[256 * i], 256, &total);
+  }
+  return (whole - split) / (double)size;
+}
+
+void BrotliSniffContent(
+    const uint8_t* data, size_t size, BrotliContentPreset* preset) {
+  uint32_t histograms[256 * 5];
+  double gain2;
+  double gain4;
+  preset->mode = BROTLI_MODE_GENERIC;
+  preset->distance_postfix_bits = 0;
+  preset->num_direct_distance_codes = 0;
+  if (size > BROTLI_SNIFF_SIZE) size = BROTLI_SNIFF_SIZE;
+  if (size == 0) return;
+
+  if (IsFont(data, size)) {
+    /* Encoder picks the WOFF 2.0 distance parameters itself. */
+    preset->mode = BROTLI_MODE_FONT;
+    return;
+  }
+  if (BrotliIsMostlyUTF8(data, 0, ~(size_t)0, size, kMinUTF8Ratio) ||
+      (IsMarkup(data, size) && BrotliIsMostlyUTF8(
+          data, 0, ~(size_t)0, size, kMinMarkupUTF8Ratio))) {
+    preset->mode = BROTLI_MODE_TEXT;
+    return;
+  }
+
+  /* Records of 16- or 32-bit fields make distances multiples of the field
+     width; postfix bits let such distances be coded cheaper. */
+  gain2 = LaneGain(data, size, 2, histograms);
+  gain4 = LaneGain(data, size, 4, histograms);
+  if (gain4 >= kMinLaneGain && gain4 >= 2 * gain2) {
+    preset->distance_postfix_bits = 2;
+  } else if (gain2 >= kMinLaneGain) {
+    preset->distance_postfix_bits = 1;
+  }
+}
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}  /* extern "C" */
+#endif
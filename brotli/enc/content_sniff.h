@@ -0,0 +1,39 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Guessing of encoder settings from the beginning of input. */
+
+#ifndef BROTLI_ENC_CONTENT_SNIFF_H_
+#define BROTLI_ENC_CONTENT_SNIFF_H_
+
+#include "../common/platform.h"
+#include <brotli/encode.h>
+#include <brotli/types.h>
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+/* Only that many leading bytes are looked at. */
+#define BROTLI_SNIFF_SIZE 4096
+
+typedef struct BrotliContentPreset {
+  /* Never BROTLI_MODE_AUTO. */
+  BrotliEncoderMode mode;
+  uint32_t distance_postfix_bits;
+  uint32_t num_direct_distance_codes;
+} BrotliContentPreset;
+
+/* Classifies data as font, text, or binary; for binary with fixed-width
+   fields suggests aligned distance codes. */
+BROTLI_INTERNAL void BrotliSniffContent(
+    const uint8_t* data, size_t size, BrotliContentPreset* preset);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}  /* extern "C" */
+#endif
+
+#endif  /* BROTLI_ENC_CONTENT_SNIFF_H_ */
@@ -9,14 +9,18 @@
 #ifndef BROTLI_ENC_DICTIONARY_HASH_H_
 #define BROTLI_ENC_DICTIONARY_HASH_H_
 
+#include "../common/platform.h"
 #include <brotli/types.h>
 
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" {
 #endif
 
-extern const uint16_t kStaticDictionaryHashWords[32768];
-extern const uint8_t kStaticDictionaryHashLengths[32768];
+/* Filled by BrotliInitStaticDictionaryHash; see BrotliEncoderLazyStaticInit. */
+extern uint16_t kStaticDictionaryHashWords[32768];
+extern uint8_t kStaticDictionaryHashLengths[32768];
+
+BROTLI_INTERNAL void BrotliInitStaticDictionaryHash(void);
 
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
@@ -0,0 +1,229 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Builds raw prefix dictionaries from a corpus of samples.
+
+   Selection is frequency based: every sample is cut into overlapping 8-byte
+   "d-mers", and each d-mer is scored by the number of distinct samples it
+   occurs in. The corpus is split into as many epochs as there are segments
+   in the budget; from each epoch the segment with the highest sum of scores
+   of its distinct d-mers is taken. Selected d-mers stop scoring, so that
+   later segments bring in new content instead of repeating earlier ones. */
+
+#include <string.h>  /* memcpy, memset */
+
+#include "../common/platform.h"
+#include <brotli/encode.h>
+#include <brotli/types.h>
+#include "./memory.h"
+
+#define BROTLI_TRAINER_DMER_SIZE 8
+#define BROTLI_TRAINER_SEGMENT_SIZE 512
+#define BROTLI_TRAINER_MIN_HASH_BITS 16
+#define BROTLI_TRAINER_MAX_HASH_BITS 22
+#define BROTLI_TRAINER_NO_DMER 0xFFFFFFFFu
+
+static const uint64_t kTrainerHashMul64 =
+    BROTLI_MAKE_UINT64_T(0x1FE35A7Bu, 0xD3579BD3u);
+
+typedef struct TrainerSegment {
+  size_t begin;
+  size_t score;
+} TrainerSegment;
+
+static BROTLI_INLINE uint32_t TrainerHash(const uint8_t* p, uint32_t bits) {
+  uint64_t h = BROTLI_UNALIGNED_LOAD64LE(p) * kTrainerHashMul64;
+  return (uint32_t)(h >> (64 - bits));
+}
+
+/* Sorts segments by ascending score; shell sort keeps this allocation free. */
+static void SortSegments(TrainerSegment* segments, size_t count) {
+  static const size_t kGaps[] = {701, 301, 132, 57, 23, 10, 4, 1};
+  size_t g;
+  for (g = 0; g < sizeof(kGaps) / sizeof(kGaps[0]); ++g) {
+    size_t gap = kGaps[g];
+    size_t i;
+    for (i = gap; i < count; ++i) {
+      TrainerSegment tmp = segments[i];
+      size_t j = i;
+      while (j >= gap && segments[j - gap].score > tmp.score) {
+        segments[j] = segments[j - gap];
+        j -= gap;
+      }
+      segments[j] = tmp;
+    }
+  }
+}
+
+BROTLI_BOOL BrotliEncoderTrainDictionary(size_t num_samples,
+    const size_t sample_sizes[BROTLI_ARRAY_PARAM(num_samples)],
+    const uint8_t* samples, size_t* dictionary_size,
+    uint8_t dictionary[BROTLI_ARRAY_PARAM(*dictionary_size)]) {
+  MemoryManager memory_manager;
+  MemoryManager* m = &memory_manager;
+  const size_t d = BROTLI_TRAINER_DMER_SIZE;
+  size_t k = BROTLI_TRAINER_SEGMENT_SIZE;
+  size_t budget = *dictionary_size;
+  size_t total_size = 0;
+  size_t num_segments = 0;
+  size_t num_epochs;
+  size_t epoch_size;
+  size_t epoch;
+  size_t pos;
+  size_t out;
+  size_t i;
+  uint32_t hash_bits = BROTLI_TRAINER_MIN_HASH_BITS;
+  uint32_t* dmers = NULL;
+  uint32_t* freq = NULL;
+  uint32_t* seen = NULL;
+  TrainerSegment* segments = NULL;
+
+  for (i = 0; i < num_samples; ++i) total_size += sample_sizes[i];
+
+  /* Everything fits: the corpus is the best dictionary there is. */
+  if (total_size <= budget) {
+    memcpy(dictionary, samples, total_size);
+    *dictionary_size = total_size;
+    return BROTLI_TRUE;
+  }
+  if (budget < d) {
+    *dictionary_size = 0;
+    return BROTLI_FALSE;
+  }
+  if (budget < k) k = budget;
+
+  while (hash_bits < BROTLI_TRAINER_MAX_HASH_BITS &&
+         ((size_t)1 << hash_bits) < total_size) {
+    hash_bits++;
+  }
+
+  BrotliInitMemoryManager(m, 0, 0, 0);
+  num_epochs = budget / k;
+  if (total_size / num_epochs < k) num_epochs = total_size / k;
+  epoch_size = total_size / num_epochs;
+  dmers = BROTLI_ALLOC(m, uint32_t, total_size);
+  freq = BROTLI_ALLOC(m, uint32_t, (size_t)1 << hash_bits);
+  seen = BROTLI_ALLOC(m, uint32_t, (size_t)1 << hash_bits);
+  segments = BROTLI_ALLOC(m, TrainerSegment, num_epochs);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(dmers) || BROTLI_IS_NULL(freq) ||
+      BROTLI_IS_NULL(seen) || BROTLI_IS_NULL(segments)) {
+    BrotliWipeOutMemoryManager(m);
+    *dictionary_size = 0;
+    return BROTLI_FALSE;
+  }
+  memset(freq, 0, sizeof(uint32_t) << hash_bits);
+  memset(seen, 0, sizeof(uint32_t) << hash_bits);
+
+  /* Hash every d-mer that does not cross a sample boundary, and count the
+     samples each one appears in. */
+  pos = 0;
+  for (i = 0; i < num_samples; ++i) {
+    size_t end = pos + sample_sizes[i];
+    uint32_t tag = (uint32_t)i + 1;
+    for (; pos + d <= end; ++pos) {
+      uint32_t h = TrainerHash(&samples[pos], hash_bits);
+      dmers[pos] = h;
+      if (seen[h] != tag) {
+        seen[h] = tag;
+        freq[h]++;
+      }
+    }
+    for (; pos < end; ++pos) dmers[pos] = BROTLI_TRAINER_NO_DMER;
+  }
+
+  /* A d-mer that occurs in a single sample does not help other samples. */
+  for (i = 0; i < ((size_t)1 << hash_bits); ++i) {
+    if (freq[i] < 2) freq[i] = 0;
+  }
+
+  /* From now on |seen| counts d-mer occurrences inside the sliding window. */
+  memset(seen, 0, sizeof(uint32_t) << hash_bits);
+  for (epoch = 0; epoch < num_epochs; ++epoch) {
+    size_t begin = epoch * epoch_size;
+    size_t end = (epoch + 1 == num_epochs) ? total_size : begin + epoch_size;
+    size_t best_begin = begin;
+    size_t best_score = 0;
+    size_t score = 0;
+    size_t left = begin;
+    /* Window holds d-mers starting in [left, pos]; segment bytes are
+       [left, left + k). */
+    for (pos = begin; pos + d <= end; ++pos) {
+      uint32_t h = dmers[pos];
+      if (h != BROTLI_TRAINER_NO_DMER) {
+        if (seen[h]++ == 0) score += freq[h];
+      }
+      if (pos + d - left > k) {
+        uint32_t g = dmers[left];
+        if (g != BROTLI_TRAINER_NO_DMER) {
+          if (--seen[g] == 0) score -= freq[g];
+        }
+        left++;
+      }
+      if (score > best_score) {
+        best_score = score;
+        best_begin = left;
+      }
+    }
+    for (; left < pos; ++left) {
+      uint32_t g = dmers[left];
+      if (g != BROTLI_TRAINER_NO_DMER) seen[g]--;
+    }
+    if (best_score == 0) continue;
+    if (best_begin + k > end) best_begin = end - k;
+    /* Selected content does not score again. */
+    for (pos = best_begin; pos + d <= best_begin + k; ++pos) {
+      uint32_t h = dmers[pos];
+      if (h != BROTLI_TRAINER_NO_DMER) freq[h] = 0;
+    }
+    segments[num_segments].begin = best_begin;
+    segments[num_segments].score = best_score;
+    num_segments++;
+  }
+
+  /* Most valuable segments go last, where backward distances are shortest. */
+  SortSegments(segments, num_segments);
+  out = 0;
+  for (i = 0; i < num_segments; ++i) {
+    memcpy(&dictionary[out], &samples[segments[i].begin], k);
+    out += k;
+  }
+  *dictionary_size = out;
+
+  BROTLI_FREE(m, segments);
+  BROTLI_FREE(m, seen);
+  BROTLI_FREE(m, freq);
+  BROTLI_FREE(m, dmers);
+  return BROTLI_TRUE;
+}
+
+BROTLI_BOOL BrotliEncoderSerializeDictionary(size_t raw_size,
+    const uint8_t raw[BROTLI_ARRAY_PARAM(raw_size)], size_t* serialized_size,
+    uint8_t serialized[BROTLI_ARRAY_PARAM(*serialized_size)]) {
+  size_t capacity = *serialized_size;
+  size_t pos = 0;
+  uint32_t length = (uint32_t)raw_size;
+  *serialized_size = 0;
+  if (raw_size > 0xFFFFFFFFu ||
+      capacity < raw_size + BROTLI_SERIALIZED_DICTIONARY_OVERHEAD) {
+    return BROTLI_FALSE;
+  }
+  /* Magic header. */
+  serialized[pos++] = 0x91;
+  serialized[pos++] = 0;
+  /* LZ77_DICTIONARY_LENGTH as varint, then the prefix itself. */
+  while (length >= 128) {
+    serialized[pos++] = (uint8_t)(length | 128);
+    length >>= 7;
+  }
+  serialized[pos++] = (uint8_t)length;
+  memcpy(&serialized[pos], raw, raw_size);
+  pos += raw_size;
+  /* NUM_WORD_LISTS and NUM_TRANSFORM_LISTS: keep the built-in ones. */
+  serialized[pos++] = 0;
+  serialized[pos++] = 0;
+  *serialized_size = pos;
+  return BROTLI_TRUE;
+}
@@ -13,7 +13,9 @@
 
 #include "../common/constants.h"
 #include "../common/context.h"
+#include "../common/crc32c.h"
 #include "../common/platform.h"
+#include "../common/probes.h"
 #include "../common/version.h"
 #include "./backward_references.h"
 #include "./backward_references_hq.h"
@@ -21,12 +23,14 @@
 #include "./brotli_bit_stream.h"
 #include "./compress_fragment.h"
 #include "./compress_fragment_two_pass.h"
+#include "./content_sniff.h"
 #include "./dictionary_hash.h"
 #include "./encoder_dict.h"
 #include "./entropy_encode.h"
 #include "./fast_log.h"
 #include "./hash.h"
 #include "./histogram.h"
+#include "./literal_cost.h"
 #include "./memory.h"
 #include "./metablock.h"
 #include "./prefix.h"
@@ -41,6 +45,9 @@ extern "C" {
 
 #define COPY_ARRAY(dst, src) memcpy(dst, src, sizeof(src));
 
+/* Number of last input bytes that choose content-defined cut points. */
+#define BROTLI_CHUNK_WINDOW 32
+
 typedef enum BrotliEncoderStreamState {
   /* Default state. */
   BROTLI_STREAM_PROCESSING = 0,
@@ -70,6 +77,10 @@ typedef struct BrotliEncoderStateStruct {
 
   uint64_t input_pos_;
   RingBuffer ringbuffer_;
+  /* Caller's input of the whole stream, read in place instead of the ring
+     buffer; positions never wrap, so masking it is a no-op. */
+  const uint8_t* linear_input_;
+  size_t linear_input_size_;
   size_t cmd_alloc_size_;
   Command* commands_;
   size_t num_commands_;
@@ -87,10 +98,42 @@ typedef struct BrotliEncoderStateStruct {
   int8_t flint_;
   uint8_t prev_byte_;
   uint8_t prev_byte2_;
+  /* Input bytes stored uncompressed after the entropy pre-scan. */
+  uint64_t stored_incompressible_bytes_;
+  /* BrotliEncoderStat counters; updated only with params.collect_stats. */
+  uint64_t stats_[BROTLI_ENCODER_NUM_STATS];
+  /* CRC-32C of consumed input; updated only with params.checksum. */
+  uint32_t checksum_;
+  /* Progress of appending the checksum trailer, see FinishWithChecksum. */
+  uint8_t checksum_stage_;
+  uint8_t checksum_trailer_pos_;
+  uint8_t checksum_trailer_[BROTLI_CHECKSUM_TRAILER_SIZE];
+  /* Progress of declaring the stream size, see DeclareSize. */
+  uint8_t size_stage_;
+  uint8_t size_metadata_pos_;
+  uint8_t size_metadata_[BROTLI_SIZE_METADATA_LENGTH];
   size_t storage_size_;
   uint8_t* storage_;
+  /* Output bytes left to BrotliEncoderCompressToBudget; 0 if unlimited. */
+  size_t output_budget_;
+  /* Content-defined chunking: rolling hash of the last input bytes, kept in
+     |chunk_window_|, size of the current chunk and number of bytes of
+     caller's input scanned but not consumed yet, see CompressChunks. */
+  uint32_t chunk_hash_;
+  uint32_t chunk_window_pos_;
+  size_t chunk_size_;
+  size_t chunk_ahead_;
+  BROTLI_BOOL chunk_cut_;
+  uint8_t chunk_window_[BROTLI_CHUNK_WINDOW];
+  /* Ramp of BROTLI_PARAM_FIRST_BLOCK_BITS, see StepFirstBlocks: log2 of the
+     current input block size, or 0 once blocks are of full size, quality of
+     the blocks after the first one, and whether the first one is out. */
+  int ramp_bits_;
+  int ramp_quality_;
+  BROTLI_BOOL first_block_done_;
 
   Hasher hasher_;
+  ZopfliArena zopfli_arena_;
 
   /* Hash table for FAST_ONE_PASS_COMPRESSION_QUALITY mode. */
   int small_table_[1 << 10];  /* 4KiB */
@@ -117,13 +160,21 @@ typedef struct BrotliEncoderStateStruct {
 
   BROTLI_BOOL is_last_block_emitted_;
   BROTLI_BOOL is_initialized_;
+
+  /* Values passed to BrotliEncoderSetParameter; replayed on reset. */
+  uint32_t param_values_[BROTLI_PARAM_FIRST_BLOCK_BITS + 1];
+  uint32_t param_set_mask_;
 } BrotliEncoderStateStruct;
 
+static const uint8_t* InputData(BrotliEncoderState* s) {
+  return s->linear_input_ ? s->linear_input_ : s->ringbuffer_.buffer_;
+}
+
 static size_t InputBlockSize(BrotliEncoderState* s) {
-  return (size_t)1 << s->params.lgblock;
+  return (size_t)1 << (s->ramp_bits_ ? s->ramp_bits_ : s->params.lgblock);
 }
 
-static uint64_t UnprocessedInputSize(BrotliEncoderState* s) {
+static uint64_t UnprocessedInputSize(const BrotliEncoderState* s) {
   return s->input_pos_ - s->last_processed_pos_;
 }
 
@@ -134,11 +185,8 @@ static size_t RemainingInputBlockSize(BrotliEncoderState* s) {
   return block_size - (size_t)delta;
 }
 
-BROTLI_BOOL BrotliEncoderSetParameter(
+static BROTLI_BOOL ApplyParameter(
     BrotliEncoderState* state, BrotliEncoderParameter p, uint32_t value) {
-  /* Changing parameters on the fly is not implemented yet. */
-  if (state->is_initialized_) return BROTLI_FALSE;
-  /* TODO: Validate/clamp parameters here. */
   switch (p) {
     case BROTLI_PARAM_MODE:
       state->params.mode = (BrotliEncoderMode)value;
@@ -182,10 +230,133 @@ BROTLI_BOOL BrotliEncoderSetParameter(
       state->params.stream_offset = value;
       return BROTLI_TRUE;
 
+    case BROTLI_PARAM_SKIP_INCOMPRESSIBLE:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.skip_incompressible = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_MEMORY_LIMIT:
+      state->params.memory_limit = value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_LOW_LATENCY_FLUSH:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.low_latency_flush = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_HASHER_TYPE:
+      if (value != 0 && !IsConfigurableHasherType((int)value)) {
+        return BROTLI_FALSE;
+      }
+      if (IsForgetfulChainHasher((int)value) && state->params.quality >= 2 &&
+          state->params.quality < 4) {
+        return BROTLI_FALSE;
+      }
+      state->params.custom_hasher.type = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_HASHER_BUCKET_BITS:
+      if (value != 0 && (value < BROTLI_MIN_HASHER_BUCKET_BITS ||
+                         value > BROTLI_MAX_HASHER_BUCKET_BITS)) {
+        return BROTLI_FALSE;
+      }
+      state->params.custom_hasher.bucket_bits = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_HASHER_BLOCK_BITS:
+      if (value > BROTLI_MAX_HASHER_BLOCK_BITS) return BROTLI_FALSE;
+      state->params.custom_hasher.block_bits = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_HASHER_NUM_LAST_DISTANCES:
+      if (value > BROTLI_MAX_HASHER_NUM_LAST_DISTANCES) return BROTLI_FALSE;
+      state->params.custom_hasher.num_last_distances_to_check = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_LONG_DISTANCE_MATCHING:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.long_distance_matching = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_COLLECT_STATS:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.collect_stats = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_CHECKSUM:
+      if (value > 2) return BROTLI_FALSE;
+      state->params.checksum = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_FRAGMENT:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.fragment = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_DECLARE_SIZE:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.declare_size = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_HASHER_TREE_BITS:
+      if (value != 0 && (value < BROTLI_MIN_WINDOW_BITS ||
+                         value > BROTLI_LARGE_MAX_WINDOW_BITS)) {
+        return BROTLI_FALSE;
+      }
+      state->params.custom_hasher.tree_bits = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_WORK_BUDGET:
+      state->params.work_budget = value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_CHUNK_BITS:
+      if (value != 0 && (value < BROTLI_MIN_CHUNK_BITS ||
+                         value > BROTLI_MAX_CHUNK_BITS)) {
+        return BROTLI_FALSE;
+      }
+      state->params.chunk_bits = (int)value;
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_INDEPENDENT_CHUNKS:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.independent_chunks = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_SHORTEST_PATH:
+      if ((value != 0) && (value != 1)) return BROTLI_FALSE;
+      state->params.shortest_path = TO_BROTLI_BOOL(!!value);
+      return BROTLI_TRUE;
+
+    case BROTLI_PARAM_FIRST_BLOCK_BITS:
+      if (value != 0 && (value < BROTLI_MIN_FIRST_BLOCK_BITS ||
+                         value > BROTLI_MAX_FIRST_BLOCK_BITS)) {
+        return BROTLI_FALSE;
+      }
+      state->params.first_block_bits = (int)value;
+      return BROTLI_TRUE;
+
     default: return BROTLI_FALSE;
   }
 }
 
+BROTLI_BOOL BrotliEncoderSetParameter(
+    BrotliEncoderState* state, BrotliEncoderParameter p, uint32_t value) {
+  /* Changing parameters on the fly is not implemented yet. */
+  if (state->is_initialized_) return BROTLI_FALSE;
+  /* TODO: Validate/clamp parameters here. */
+  if (!ApplyParameter(state, p, value)) return BROTLI_FALSE;
+  if (state->hasher_.common.is_setup_) {
+    /* Hasher retained from the previous stream might not match new
+       parameters. */
+    DestroyHasher(&state->memory_manager_, &state->hasher_);
+    HasherInit(&state->hasher_);
+  }
+  state->param_values_[p] = value;
+  state->param_set_mask_ |= 1u << p;
+  return BROTLI_TRUE;
+}
+
 /* Wraps 64-bit input position to 32-bit ring-buffer position preserving
    "not-a-first-lap" feature. */
 static uint32_t WrapPosition(uint64_t position) {
@@ -503,6 +674,23 @@ static void DecideOverLiteralContextModeling(const uint8_t* input,
   }
 }
 
+/* Checks if entropy of every |sample_rate|-th byte of the given data is
+   close to 8 bits. */
+static BROTLI_BOOL IsMostlyRandom(const uint8_t* data, const size_t mask,
+    const uint64_t start_pos, const size_t bytes, const uint32_t sample_rate) {
+  uint32_t literal_histo[256] = { 0 };
+  static const double kMinEntropy = 7.92;
+  const double bit_cost_threshold = (double)bytes * kMinEntropy / sample_rate;
+  size_t t = (bytes + sample_rate - 1) / sample_rate;
+  uint32_t pos = (uint32_t)start_pos;
+  size_t i;
+  for (i = 0; i < t; i++) {
+    ++literal_histo[data[pos & mask]];
+    pos += sample_rate;
+  }
+  return TO_BROTLI_BOOL(BitsEntropy(literal_histo, 256) > bit_cost_threshold);
+}
+
 static BROTLI_BOOL ShouldCompress(
     const uint8_t* data, const size_t mask, const uint64_t last_flush_pos,
     const size_t bytes, const size_t num_literals, const size_t num_commands) {
@@ -510,19 +698,8 @@ static BROTLI_BOOL ShouldCompress(
   if (bytes <= 2) return BROTLI_FALSE;
   if (num_commands < (bytes >> 8) + 2) {
     if ((double)num_literals > 0.99 * (double)bytes) {
-      uint32_t literal_histo[256] = { 0 };
       static const uint32_t kSampleRate = 13;
-      static const double kMinEntropy = 7.92;
-      const double bit_cost_threshold =
-          (double)bytes * kMinEntropy / kSampleRate;
-      size_t t = (bytes + kSampleRate - 1) / kSampleRate;
-      uint32_t pos = (uint32_t)last_flush_pos;
-      size_t i;
-      for (i = 0; i < t; i++) {
-        ++literal_histo[data[pos & mask]];
-        pos += kSampleRate;
-      }
-      if (BitsEntropy(literal_histo, 256) > bit_cost_threshold) {
+      if (IsMostlyRandom(data, mask, last_flush_pos, bytes, kSampleRate)) {
         return BROTLI_FALSE;
       }
     }
@@ -530,6 +707,23 @@ static BROTLI_BOOL ShouldCompress(
   return BROTLI_TRUE;
 }
 
+/* Pre-scan runs before any hashing, so denser sampling is still cheap; it lets
+   smaller blocks reach the entropy threshold. */
+static const uint32_t kPrescanSampleRate = 4;
+static const size_t kMinPrescanBytes = (size_t)1 << 14;
+
+/* Makes ring-buffer style addressing work on plain input buffers. */
+static const size_t kLinearMask = ~(size_t)0 >> 1;
+
+static BROTLI_BOOL ShouldSkipBlock(const BrotliEncoderParams* params,
+    const uint8_t* data, const size_t mask, const uint32_t position,
+    const size_t bytes) {
+  if (!params->skip_incompressible || bytes < kMinPrescanBytes) {
+    return BROTLI_FALSE;
+  }
+  return IsMostlyRandom(data, mask, position, bytes, kPrescanSampleRate);
+}
+
 /* Chooses the literal context mode for a metablock */
 static ContextType ChooseContextMode(const BrotliEncoderParams* params,
     const uint8_t* data, const size_t pos, const size_t mask,
@@ -543,6 +737,85 @@ static ContextType ChooseContextMode(const BrotliEncoderParams* params,
   return CONTEXT_UTF8;
 }
 
+/* Flushed meta-blocks up to this size are candidates for compact encoding. */
+#define BROTLI_LOW_LATENCY_MAX_METABLOCK_SIZE 4096
+
+/* Small meta-blocks pay mostly for their own prefix codes: RFC 7932 gives no
+   way to reuse the codes of the previous meta-block. Re-encodes the one just
+   stored with the cheaper codes of lower qualities, and keeps the shortest
+   result. Those encoders only support the default distance parameters, so
+   |commands| distances are converted back from |block_dist| to them. */
+static void StoreShortestMetaBlock(MemoryManager* m,
+                                   const uint8_t* data,
+                                   const uint32_t wrapped_last_flush_pos,
+                                   const size_t bytes,
+                                   const size_t mask,
+                                   const BROTLI_BOOL is_last,
+                                   const BrotliEncoderParams* params,
+                                   const BrotliDistanceParams* block_dist,
+                                   Command* commands,
+                                   const size_t num_commands,
+                                   const uint16_t last_bytes,
+                                   const uint8_t last_bytes_bits,
+                                   size_t* storage_ix,
+                                   uint8_t* storage) {
+  size_t best_ix = *storage_ix;
+  /* Also keeps the (partial) byte the next meta-block starts in. */
+  size_t best_size = (best_ix >> 3) + 1;
+  uint8_t* best;
+  int i;
+  if (!params->low_latency_flush || params->large_window ||
+      bytes > BROTLI_LOW_LATENCY_MAX_METABLOCK_SIZE ||
+      params->dist.distance_postfix_bits != 0 ||
+      params->dist.num_direct_distance_codes != 0) {
+    return;
+  }
+  best = BROTLI_ALLOC(m, uint8_t, best_size);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(best)) return;
+  memcpy(best, storage, best_size);
+  /* Commands are not used after the meta-block is stored. */
+  BrotliRecomputeDistancePrefixes(commands, num_commands, block_dist,
+                                  &params->dist);
+  for (i = 0; i < 2; ++i) {
+    /* Fast first: it is used as is for the lowest qualities. */
+    BROTLI_BOOL use_fast = TO_BROTLI_BOOL(i == 0);
+    if (use_fast ? (params->quality <= MAX_QUALITY_FOR_STATIC_ENTROPY_CODES) :
+        (params->quality > MAX_QUALITY_FOR_STATIC_ENTROPY_CODES &&
+         params->quality < MIN_QUALITY_FOR_BLOCK_SPLIT)) {
+      continue;
+    }
+    storage[0] = (uint8_t)last_bytes;
+    storage[1] = (uint8_t)(last_bytes >> 8);
+    *storage_ix = last_bytes_bits;
+    if (use_fast) {
+      BrotliStoreMetaBlockFast(m, data, wrapped_last_flush_pos, bytes, mask,
+                               is_last, params, commands, num_commands,
+                               storage_ix, storage);
+    } else {
+      BrotliStoreMetaBlockTrivial(m, data, wrapped_last_flush_pos, bytes, mask,
+                                  is_last, params, commands, num_commands,
+                                  storage_ix, storage);
+    }
+    if (BROTLI_IS_OOM(m)) return;
+    if (*storage_ix < best_ix) {
+      best_ix = *storage_ix;
+      best_size = (best_ix >> 3) + 1;
+      memcpy(best, storage, best_size);
+    }
+  }
+  memcpy(storage, best, best_size);
+  *storage_ix = best_ix;
+  BROTLI_FREE(m, best);
+}
+
+/* Adds ticks passed since |*start| to |stats[stat]|, and restarts. */
+static void AddStatsTicks(uint64_t* stats, BrotliEncoderStat stat,
+                          uint64_t* start) {
+  uint64_t now = BrotliReadTicks();
+  stats[stat] += now - *start;
+  *start = now;
+}
+
 static void WriteMetaBlockInternal(MemoryManager* m,
                                    const uint8_t* data,
                                    const size_t mask,
@@ -558,6 +831,7 @@ static void WriteMetaBlockInternal(MemoryManager* m,
                                    Command* commands,
                                    const int* saved_dist_cache,
                                    int* dist_cache,
+                                   uint64_t* stats,
                                    size_t* storage_ix,
                                    uint8_t* storage) {
   const uint32_t wrapped_last_flush_pos = WrapPosition(last_flush_pos);
@@ -565,6 +839,7 @@ static void WriteMetaBlockInternal(MemoryManager* m,
   uint8_t last_bytes_bits;
   ContextLut literal_context_lut = BROTLI_CONTEXT_LUT(literal_context_mode);
   BrotliEncoderParams block_params = *params;
+  uint64_t start = 0;
 
   if (bytes == 0) {
     /* Write the ISLAST and ISEMPTY bits. */
@@ -573,6 +848,18 @@ static void WriteMetaBlockInternal(MemoryManager* m,
     return;
   }
 
+  if (stats) {
+    size_t i;
+    start = BrotliReadTicks();
+    stats[BROTLI_ENCODER_STAT_METABLOCKS]++;
+    stats[BROTLI_ENCODER_STAT_LITERALS] += num_literals;
+    for (i = 0; i < num_commands; ++i) {
+      if (CommandCopyLen(&commands[i]) != 0) {
+        stats[BROTLI_ENCODER_STAT_MATCHES]++;
+      }
+    }
+  }
+
   if (!ShouldCompress(data, mask, last_flush_pos, bytes,
                       num_literals, num_commands)) {
     /* Restore the distance cache, as its last update by
@@ -581,6 +868,7 @@ static void WriteMetaBlockInternal(MemoryManager* m,
     BrotliStoreUncompressedMetaBlock(is_last, data,
                                      wrapped_last_flush_pos, mask, bytes,
                                      storage_ix, storage);
+    if (stats) AddStatsTicks(stats, BROTLI_ENCODER_STAT_STORE_TICKS, &start);
     return;
   }
 
@@ -593,7 +881,8 @@ static void WriteMetaBlockInternal(MemoryManager* m,
                              commands, num_commands,
                              storage_ix, storage);
     if (BROTLI_IS_OOM(m)) return;
-  } else if (params->quality < MIN_QUALITY_FOR_BLOCK_SPLIT) {
+  } else if (params->quality < MIN_QUALITY_FOR_BLOCK_SPLIT &&
+             params->profile.num_contexts == 0) {
     BrotliStoreMetaBlockTrivial(m, data, wrapped_last_flush_pos,
                                 bytes, mask, is_last, params,
                                 commands, num_commands,
@@ -605,7 +894,12 @@ static void WriteMetaBlockInternal(MemoryManager* m,
     if (params->quality < MIN_QUALITY_FOR_HQ_BLOCK_SPLITTING) {
       size_t num_literal_contexts = 1;
       const uint32_t* literal_context_map = NULL;
-      if (!params->disable_literal_context_modeling) {
+      if (params->disable_literal_context_modeling) {
+        /* Single literal context. */
+      } else if (params->profile.num_contexts != 0) {
+        num_literal_contexts = params->profile.num_contexts;
+        literal_context_map = params->profile.context_map;
+      } else {
         /* TODO: pull to higher level and reuse. */
         uint32_t* arena = BROTLI_ALLOC(m, uint32_t, 14 * 32);
         if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(arena)) return;
@@ -633,6 +927,9 @@ static void WriteMetaBlockInternal(MemoryManager* m,
          for "Large Window Brotli" (32-bit). */
       BrotliOptimizeHistograms(block_params.dist.alphabet_size_limit, &mb);
     }
+    if (stats) {
+      AddStatsTicks(stats, BROTLI_ENCODER_STAT_METABLOCK_TICKS, &start);
+    }
     BrotliStoreMetaBlock(m, data, wrapped_last_flush_pos, bytes, mask,
                          prev_byte, prev_byte2,
                          is_last,
@@ -644,6 +941,10 @@ static void WriteMetaBlockInternal(MemoryManager* m,
     if (BROTLI_IS_OOM(m)) return;
     DestroyMetaBlockSplit(m, &mb);
   }
+  StoreShortestMetaBlock(m, data, wrapped_last_flush_pos, bytes, mask, is_last,
+                         params, &block_params.dist, commands, num_commands,
+                         last_bytes, last_bytes_bits, storage_ix, storage);
+  if (BROTLI_IS_OOM(m)) return;
   if (bytes + 4 < (*storage_ix >> 3)) {
     /* Restore the distance cache and last byte. */
     memcpy(dist_cache, saved_dist_cache, 4 * sizeof(dist_cache[0]));
@@ -654,6 +955,7 @@ static void WriteMetaBlockInternal(MemoryManager* m,
                                      wrapped_last_flush_pos, mask,
                                      bytes, storage_ix, storage);
   }
+  if (stats) AddStatsTicks(stats, BROTLI_ENCODER_STAT_STORE_TICKS, &start);
 }
 
 static void ChooseDistanceParams(BrotliEncoderParams* params) {
@@ -682,6 +984,58 @@ static void ChooseDistanceParams(BrotliEncoderParams* params) {
                            num_direct_distance_codes, params->large_window);
 }
 
+/* Input size assumed for stream of unknown length; it makes the estimate
+   include full-size meta-blocks. */
+static const size_t kUnknownStreamSize = (size_t)1 << 30;
+
+/* Cuts window to the size hint, then lowers window (down to 64 KiB), quality
+   (down to 2), and window again until the estimated peak memory usage fits
+   |params->memory_limit|. */
+static void FitMemoryLimit(BrotliEncoderParams* params) {
+  size_t input_size =
+      (params->size_hint != 0) ? params->size_hint : kUnknownStreamSize;
+  if (params->size_hint != 0) {
+    int lgwin = BROTLI_MIN_WINDOW_BITS;
+    while (lgwin < params->lgwin &&
+           BROTLI_MAX_BACKWARD_LIMIT(lgwin) < (uint64_t)params->size_hint) {
+      lgwin++;
+    }
+    params->lgwin = lgwin;
+  }
+  while (BrotliEncoderEstimatePeakMemoryUsage(
+      params->quality, params->lgwin, input_size) > params->memory_limit) {
+    if (params->lgwin > 16) {
+      params->lgwin--;
+    } else if (params->quality > FAST_TWO_PASS_COMPRESSION_QUALITY + 1) {
+      params->quality--;
+    } else if (params->lgwin > BROTLI_MIN_WINDOW_BITS) {
+      params->lgwin--;
+    } else {
+      break;
+    }
+  }
+  if (params->lgwin <= BROTLI_MAX_WINDOW_BITS) {
+    params->large_window = BROTLI_FALSE;
+  }
+}
+
+static const uint32_t kChunkHashMul = 69069;
+
+/* Content-defined cut points are chosen by a rolling hash of the last
+   BROTLI_CHUNK_WINDOW bytes, as in hash_rolling_inc.h; the window starts
+   filled with zeros. */
+static void ResetChunkScanner(BrotliEncoderState* s) {
+  uint32_t hash = 0;
+  size_t i;
+  for (i = 0; i < BROTLI_CHUNK_WINDOW; ++i) hash = hash * kChunkHashMul + 1u;
+  s->chunk_hash_ = hash;
+  s->chunk_window_pos_ = 0;
+  s->chunk_size_ = 0;
+  s->chunk_ahead_ = 0;
+  s->chunk_cut_ = BROTLI_FALSE;
+  memset(s->chunk_window_, 0, sizeof(s->chunk_window_));
+}
+
 static BROTLI_BOOL EnsureInitialized(BrotliEncoderState* s) {
   MemoryManager* m = &s->memory_manager_;
   if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
@@ -691,11 +1045,26 @@ static BROTLI_BOOL EnsureInitialized(BrotliEncoderState* s) {
   s->last_bytes_ = 0;
   s->flint_ = BROTLI_FLINT_DONE;
   s->remaining_metadata_bytes_ = BROTLI_UINT32_MAX;
+  ResetChunkScanner(s);
 
+  if (s->params.fragment) s->params.large_window = BROTLI_FALSE;
   SanitizeParams(&s->params);
+  if (s->params.memory_limit != 0) FitMemoryLimit(&s->params);
   s->params.lgblock = ComputeLgBlock(&s->params);
   ChooseDistanceParams(&s->params);
 
+  if (s->params.fragment) {
+    /* Header is omitted as for any stream offset. Dictionary references are
+       encoded as distances past the window, which are interpreted relative
+       to the (unknown) position of fragment; cap distances to forbid them. */
+    if (s->params.stream_offset == 0) {
+      s->params.stream_offset = BROTLI_MAX_BACKWARD_LIMIT(s->params.lgwin);
+    }
+    s->params.dist.max_distance = BROTLI_MIN(size_t,
+        s->params.dist.max_distance,
+        BROTLI_MAX_BACKWARD_LIMIT(s->params.lgwin));
+  }
+
   if (s->params.stream_offset != 0) {
     s->flint_ = BROTLI_FLINT_NEEDS_2_BYTES;
     /* Poison the distance cache. -16 +- 3 is still less than zero (invalid). */
@@ -706,6 +1075,19 @@ static BROTLI_BOOL EnsureInitialized(BrotliEncoderState* s) {
     memcpy(s->saved_dist_cache_, s->dist_cache_, sizeof(s->saved_dist_cache_));
   }
 
+  /* The ring buffer holds at least twice the window. Input that fits the
+     window is never wrapped, so it can be read in place, unless independent
+     chunks restart positions or the hasher relies on the ring buffer slack. */
+  if (s->linear_input_) {
+    BrotliHasherParams hasher = s->params.hasher;
+    ChooseHasher(&s->params, &hasher);
+    if ((s->params.chunk_bits != 0 && s->params.independent_chunks) ||
+        s->linear_input_size_ > ((size_t)1 << BROTLI_MIN(int,
+        s->params.lgwin, BROTLI_MAX_WINDOW_BITS)) ||
+        !ReadsInputInPlace(hasher.type)) {
+      s->linear_input_ = NULL;
+    }
+  }
   RingBufferSetup(&s->params, &s->ringbuffer_);
 
   /* Initialize last byte with stream header. */
@@ -725,13 +1107,35 @@ static BROTLI_BOOL EnsureInitialized(BrotliEncoderState* s) {
     }
   }
 
+  /* Arenas could be already allocated, if instance is reused. */
   if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY) {
-    s->one_pass_arena_ = BROTLI_ALLOC(m, BrotliOnePassArena, 1);
-    if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+    if (!s->one_pass_arena_) {
+      s->one_pass_arena_ = BROTLI_ALLOC(m, BrotliOnePassArena, 1);
+      if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+    }
     InitCommandPrefixCodes(s->one_pass_arena_);
   } else if (s->params.quality == FAST_TWO_PASS_COMPRESSION_QUALITY) {
-    s->two_pass_arena_ = BROTLI_ALLOC(m, BrotliTwoPassArena, 1);
-    if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+    if (!s->two_pass_arena_) {
+      s->two_pass_arena_ = BROTLI_ALLOC(m, BrotliTwoPassArena, 1);
+      if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+    }
+  }
+
+  /* Block size and distance parameters are chosen for the requested quality
+     already; only the first block is compressed at the fast one. */
+  s->ramp_bits_ = 0;
+  s->ramp_quality_ = s->params.quality;
+  s->first_block_done_ = BROTLI_FALSE;
+  if (s->params.first_block_bits != 0 &&
+      s->params.quality > FAST_TWO_PASS_COMPRESSION_QUALITY) {
+    s->ramp_bits_ = BROTLI_MIN(int,
+        s->params.first_block_bits, s->params.lgblock);
+    if (s->params.custom_hasher.type == 0 &&
+        s->params.quality > FIRST_BLOCK_QUALITY) {
+      s->params.quality = FIRST_BLOCK_QUALITY;
+      /* Hasher kept by reset is set up again for that quality. */
+      s->hasher_.common.is_setup_ = BROTLI_FALSE;
+    }
   }
 
   s->is_initialized_ = BROTLI_TRUE;
@@ -741,6 +1145,26 @@ static BROTLI_BOOL EnsureInitialized(BrotliEncoderState* s) {
 static void BrotliEncoderInitParams(BrotliEncoderParams* params) {
   params->mode = BROTLI_DEFAULT_MODE;
   params->large_window = BROTLI_FALSE;
+  params->skip_incompressible = BROTLI_FALSE;
+  params->memory_limit = 0;
+  params->low_latency_flush = BROTLI_FALSE;
+  params->long_distance_matching = BROTLI_FALSE;
+  params->collect_stats = BROTLI_FALSE;
+  params->checksum = 0;
+  params->fragment = BROTLI_FALSE;
+  params->declare_size = BROTLI_FALSE;
+  params->work_budget = 0;
+  params->chunk_bits = 0;
+  params->independent_chunks = BROTLI_FALSE;
+  params->shortest_path = BROTLI_FALSE;
+  params->first_block_bits = 0;
+  params->custom_hasher.type = 0;
+  params->custom_hasher.bucket_bits = 0;
+  params->custom_hasher.block_bits = -1;
+  params->custom_hasher.hash_len = 0;
+  params->custom_hasher.num_last_distances_to_check = 0;
+  params->custom_hasher.tree_bits = 0;
+  params->profile.num_contexts = 0;
   params->quality = BROTLI_DEFAULT_QUALITY;
   params->lgwin = BROTLI_DEFAULT_WINDOW;
   params->lgblock = 0;
@@ -771,9 +1195,17 @@ static void BrotliEncoderInitState(BrotliEncoderState* s) {
   s->last_processed_pos_ = 0;
   s->prev_byte_ = 0;
   s->prev_byte2_ = 0;
+  s->stored_incompressible_bytes_ = 0;
+  memset(s->stats_, 0, sizeof(s->stats_));
+  s->checksum_ = 0;
+  s->checksum_stage_ = 0;
+  s->checksum_trailer_pos_ = 0;
+  s->size_stage_ = 0;
+  s->size_metadata_pos_ = 0;
   s->storage_size_ = 0;
   s->storage_ = 0;
   HasherInit(&s->hasher_);
+  BrotliInitZopfliArena(&s->zopfli_arena_);
   s->large_table_ = NULL;
   s->large_table_size_ = 0;
   s->one_pass_arena_ = NULL;
@@ -783,11 +1215,15 @@ static void BrotliEncoderInitState(BrotliEncoderState* s) {
   s->next_out_ = NULL;
   s->available_out_ = 0;
   s->total_out_ = 0;
+  s->output_budget_ = 0;
   s->stream_state_ = BROTLI_STREAM_PROCESSING;
   s->is_last_block_emitted_ = BROTLI_FALSE;
   s->is_initialized_ = BROTLI_FALSE;
+  s->param_set_mask_ = 0;
 
   RingBufferInit(&s->ringbuffer_);
+  s->linear_input_ = NULL;
+  s->linear_input_size_ = 0;
 
   s->commands_ = 0;
   s->cmd_alloc_size_ = 0;
@@ -813,6 +1249,7 @@ BrotliEncoderState* BrotliEncoderCreateInstance(
   BrotliInitMemoryManager(
       &state->memory_manager_, alloc_func, free_func, opaque);
   BrotliEncoderInitState(state);
+  BROTLI_PROBE1(encoder_create, state);
   return state;
 }
 
@@ -826,6 +1263,7 @@ static void BrotliEncoderCleanupState(BrotliEncoderState* s) {
   BROTLI_FREE(m, s->commands_);
   RingBufferFree(m, &s->ringbuffer_);
   DestroyHasher(m, &s->hasher_);
+  BrotliCleanupZopfliArena(m, &s->zopfli_arena_);
   BROTLI_FREE(m, s->large_table_);
   BROTLI_FREE(m, s->one_pass_arena_);
   BROTLI_FREE(m, s->two_pass_arena_);
@@ -839,21 +1277,97 @@ void BrotliEncoderDestroyInstance(BrotliEncoderState* state) {
   if (!state) {
     return;
   } else {
+    BROTLI_PROBE2(encoder_destroy, state, state->total_out_);
     BrotliEncoderCleanupState(state);
     BrotliBootstrapFree(state, &state->memory_manager_);
   }
 }
 
-/*
-   Copies the given input data to the internal ring buffer of the compressor.
-   No processing of the data occurs at this time and this function can be
-   called multiple times before calling WriteBrotliData() to process the
-   accumulated input. At most input_block_size() bytes of input data can be
-   copied to the ring buffer, otherwise the next WriteBrotliData() will fail.
- */
-static void CopyInputToRingBuffer(BrotliEncoderState* s,
-                                  const size_t input_size,
-                                  const uint8_t* input_buffer) {
+/* Makes hasher forget the input; its tables are kept. */
+static void ResetHasher(BrotliEncoderState* s) {
+  if (s->hasher_.common.is_setup_) {
+    int type = s->hasher_.common.params.type;
+    if (type == 10 || type == 35 || type == 55 || type == 65) {
+      /* H10 forest might be sized for the previous one-shot input; rolling
+         table of composite hashers is cleared only by Initialize. They are
+         set up again, keeping the tables that are big enough. */
+      s->hasher_.common.is_setup_ = BROTLI_FALSE;
+    } else {
+      HasherReset(&s->hasher_);
+      s->hasher_.common.dict_num_lookups = 0;
+      s->hasher_.common.dict_num_matches = 0;
+    }
+  }
+}
+
+BROTLI_BOOL BrotliEncoderResetInstance(BrotliEncoderState* s) {
+  MemoryManager* m = &s->memory_manager_;
+  BrotliLiteralProfile profile;
+  uint32_t p;
+  if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+
+  /* Replay parameters over defaults; attached dictionaries are released. Do
+     not reuse the sanitized / adjusted values left by the previous stream. */
+  profile = s->params.profile;
+  BrotliEncoderCleanupParams(m, &s->params);
+  BrotliEncoderInitParams(&s->params);
+  for (p = 0; p <= BROTLI_PARAM_FIRST_BLOCK_BITS; ++p) {
+    if (s->param_set_mask_ & (1u << p)) {
+      ApplyParameter(s, (BrotliEncoderParameter)p, s->param_values_[p]);
+    }
+  }
+  s->params.profile = profile;
+
+  s->input_pos_ = 0;
+  s->num_commands_ = 0;
+  s->num_literals_ = 0;
+  s->last_insert_len_ = 0;
+  s->last_flush_pos_ = 0;
+  s->last_processed_pos_ = 0;
+  s->prev_byte_ = 0;
+  s->prev_byte2_ = 0;
+  s->stored_incompressible_bytes_ = 0;
+  memset(s->stats_, 0, sizeof(s->stats_));
+  s->checksum_ = 0;
+  s->checksum_stage_ = 0;
+  s->checksum_trailer_pos_ = 0;
+  s->size_stage_ = 0;
+  s->size_metadata_pos_ = 0;
+  s->next_out_ = NULL;
+  s->available_out_ = 0;
+  s->total_out_ = 0;
+  s->output_budget_ = 0;
+  s->stream_state_ = BROTLI_STREAM_PROCESSING;
+  s->is_last_block_emitted_ = BROTLI_FALSE;
+  s->is_initialized_ = BROTLI_FALSE;
+
+  /* Ring buffer, command buffer, storage, Zopfli arena, and hash tables are
+     kept. */
+  RingBufferReset(&s->ringbuffer_);
+  s->linear_input_ = NULL;
+  ResetHasher(s);
+
+  s->dist_cache_[0] = 4;
+  s->dist_cache_[1] = 11;
+  s->dist_cache_[2] = 15;
+  s->dist_cache_[3] = 16;
+  memcpy(s->saved_dist_cache_, s->dist_cache_, sizeof(s->saved_dist_cache_));
+  return BROTLI_TRUE;
+}
+
+BROTLI_BOOL BrotliEncoderAttachInput(BrotliEncoderState* s,
+    size_t input_size, const uint8_t input[BROTLI_ARRAY_PARAM(input_size)]) {
+  if (s->is_initialized_) return BROTLI_FALSE;
+  s->linear_input_ = input;
+  s->linear_input_size_ = input_size;
+  return BROTLI_TRUE;
+}
+
+/* Copies data to the ring buffer; unlike CopyInputToRingBuffer, it is not
+   accounted in the checksum and it is never read in place. */
+static void AppendToRingBuffer(BrotliEncoderState* s,
+                               const size_t input_size,
+                               const uint8_t* input_buffer) {
   RingBuffer* ringbuffer_ = &s->ringbuffer_;
   MemoryManager* m = &s->memory_manager_;
   RingBufferWrite(m, input_buffer, input_size, ringbuffer_);
@@ -906,6 +1420,28 @@ static void CopyInputToRingBuffer(BrotliEncoderState* s,
   }
 }
 
+/*
+   Copies the given input data to the internal ring buffer of the compressor.
+   No processing of the data occurs at this time and this function can be
+   called multiple times before calling WriteBrotliData() to process the
+   accumulated input. At most input_block_size() bytes of input data can be
+   copied to the ring buffer, otherwise the next WriteBrotliData() will fail.
+ */
+static void CopyInputToRingBuffer(BrotliEncoderState* s,
+                                  const size_t input_size,
+                                  const uint8_t* input_buffer) {
+  if (s->params.checksum) {
+    s->checksum_ = BrotliCrc32c(s->checksum_, input_buffer, input_size);
+  }
+  if (s->linear_input_) {
+    BROTLI_DCHECK(input_buffer == s->linear_input_ + s->input_pos_);
+    BROTLI_DCHECK(s->input_pos_ + input_size <= s->ringbuffer_.size_);
+    s->input_pos_ += input_size;
+    return;
+  }
+  AppendToRingBuffer(s, input_size, input_buffer);
+}
+
 /* Marks all input as processed.
    Returns true if position wrapping occurs. */
 static BROTLI_BOOL UpdateLastProcessedPos(BrotliEncoderState* s) {
@@ -918,7 +1454,7 @@ static BROTLI_BOOL UpdateLastProcessedPos(BrotliEncoderState* s) {
 static void ExtendLastCommand(BrotliEncoderState* s, uint32_t* bytes,
                               uint32_t* wrapped_last_processed_pos) {
   Command* last_command = &s->commands_[s->num_commands_ - 1];
-  const uint8_t* data = s->ringbuffer_.buffer_;
+  const uint8_t* data = InputData(s);
   const uint32_t mask = s->ringbuffer_.mask_;
   uint64_t max_backward_distance =
       (((uint64_t)1) << s->params.lgwin) - BROTLI_WINDOW_GAP;
@@ -983,6 +1519,206 @@ static void ExtendLastCommand(BrotliEncoderState* s, uint32_t* bytes,
   }
 }
 
+/* Emits the pending meta-block, if any, followed by the unprocessed input
+   stored as is. Hasher does not see the stored bytes. */
+static BROTLI_BOOL StoreIncompressibleBlock(BrotliEncoderState* s,
+    const BROTLI_BOOL is_last, size_t* out_size, uint8_t** output) {
+  MemoryManager* m = &s->memory_manager_;
+  const uint8_t* data = InputData(s);
+  const uint32_t mask = s->ringbuffer_.mask_;
+  const uint32_t pending_size =
+      (uint32_t)(s->last_processed_pos_ - s->last_flush_pos_);
+  const uint32_t bytes = (uint32_t)(s->input_pos_ - s->last_processed_pos_);
+  uint8_t* storage =
+      GetBrotliStorage(s, 2 * (size_t)(pending_size + bytes) + 1006);
+  size_t storage_ix = s->last_bytes_bits_;
+  if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+  storage[0] = (uint8_t)s->last_bytes_;
+  storage[1] = (uint8_t)(s->last_bytes_ >> 8);
+
+  if (pending_size != 0) {
+    ContextType literal_context_mode;
+    if (s->last_insert_len_ > 0) {
+      InitInsertCommand(&s->commands_[s->num_commands_++], s->last_insert_len_);
+      s->num_literals_ += s->last_insert_len_;
+      s->last_insert_len_ = 0;
+    }
+    literal_context_mode = ChooseContextMode(
+        &s->params, data, WrapPosition(s->last_flush_pos_), mask, pending_size);
+    WriteMetaBlockInternal(
+        m, data, mask, s->last_flush_pos_, pending_size, BROTLI_FALSE,
+        literal_context_mode, &s->params, s->prev_byte_, s->prev_byte2_,
+        s->num_literals_, s->num_commands_, s->commands_, s->saved_dist_cache_,
+        s->dist_cache_, s->params.collect_stats ? s->stats_ : NULL,
+        &storage_ix, storage);
+    if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+  }
+  BrotliStoreUncompressedMetaBlock(is_last, data,
+      WrapPosition(s->last_processed_pos_), mask, bytes, &storage_ix, storage);
+  s->stored_incompressible_bytes_ += bytes;
+  if (s->params.collect_stats) s->stats_[BROTLI_ENCODER_STAT_METABLOCKS]++;
+  BROTLI_PROBE4(metablock_end, s, pending_size + bytes, storage_ix >> 3,
+      s->params.quality);
+
+  s->last_bytes_ = (uint16_t)(storage[storage_ix >> 3]);
+  s->last_bytes_bits_ = storage_ix & 7u;
+  s->last_flush_pos_ = s->input_pos_;
+  if (UpdateLastProcessedPos(s)) {
+    HasherReset(&s->hasher_);
+  }
+  s->prev_byte_ = data[((uint32_t)s->last_flush_pos_ - 1) & mask];
+  s->prev_byte2_ = data[(uint32_t)(s->last_flush_pos_ - 2) & mask];
+  s->num_commands_ = 0;
+  s->num_literals_ = 0;
+  memcpy(s->saved_dist_cache_, s->dist_cache_, sizeof(s->saved_dist_cache_));
+  *output = &storage[0];
+  *out_size = storage_ix >> 3;
+  return BROTLI_TRUE;
+}
+
+/* Output bytes needed to end the stream after a meta-block that ends at
+   |storage_ix|: the last meta-block is byte-aligned, otherwise the empty last
+   meta-block (2 bits) follows. */
+static size_t BytesToEndStream(size_t storage_ix, BROTLI_BOOL is_last) {
+  return (storage_ix + (is_last ? 0 : 2) + 7) >> 3;
+}
+
+/* Writes the pending commands, cut to cover at most |prefix| input bytes, as
+   the last meta-block. Copies are shortened too, unless they refer to static
+   dictionary, where length selects the word. |commands| are kept intact, cut
+   ones are placed to |cut|. Stores the number of covered bytes to |*bytes|.
+   Returns the number of output bytes. */
+static size_t WriteMetaBlockPrefix(BrotliEncoderState* s, const uint8_t* data,
+    uint32_t mask, ContextType literal_context_mode, const Command* commands,
+    Command* cut, size_t prefix, size_t* bytes, size_t* storage_ix,
+    uint8_t* storage) {
+  MemoryManager* m = &s->memory_manager_;
+  const size_t max_backward = BROTLI_MAX_BACKWARD_LIMIT(s->params.lgwin);
+  size_t num_commands = 0;
+  size_t num_literals = 0;
+  size_t covered = 0;
+  for (; num_commands < s->num_commands_ && covered < prefix; ++num_commands) {
+    const Command* cmd = &commands[num_commands];
+    const size_t insert_len = cmd->insert_len_;
+    const size_t copy_len = CommandCopyLen(cmd);
+    const size_t rest = prefix - covered;
+    if (insert_len + copy_len <= rest) {
+      cut[num_commands] = *cmd;
+      covered += insert_len + copy_len;
+      num_literals += insert_len;
+      continue;
+    }
+    if (rest >= insert_len + 2 && (cmd->copy_len_ >> 25) == 0) {
+      const uint32_t code = CommandRestoreDistanceCode(cmd, &s->params.dist);
+      const uint64_t pos = s->last_flush_pos_ + covered + insert_len;
+      const size_t distance = code - (BROTLI_NUM_DISTANCE_SHORT_CODES - 1);
+      if (code < BROTLI_NUM_DISTANCE_SHORT_CODES ||
+          (distance <= max_backward && distance <= pos)) {
+        Command* last = &cut[num_commands++];
+        *last = *cmd;
+        last->copy_len_ = (uint32_t)(rest - insert_len);
+        GetLengthCode(insert_len, rest - insert_len,
+            TO_BROTLI_BOOL((last->dist_prefix_ & 0x3FF) == 0),
+            &last->cmd_prefix_);
+        covered = prefix;
+        num_literals += insert_len;
+        break;
+      }
+    }
+    if (insert_len != 0) {
+      const size_t n = BROTLI_MIN(size_t, rest, insert_len);
+      InitInsertCommand(&cut[num_commands++], n);
+      covered += n;
+      num_literals += n;
+    }
+    break;
+  }
+  storage[0] = (uint8_t)s->last_bytes_;
+  storage[1] = (uint8_t)(s->last_bytes_ >> 8);
+  *storage_ix = s->last_bytes_bits_;
+  WriteMetaBlockInternal(
+      m, data, mask, s->last_flush_pos_, covered, BROTLI_TRUE,
+      literal_context_mode, &s->params, s->prev_byte_, s->prev_byte2_,
+      num_literals, num_commands, cut, s->saved_dist_cache_,
+      s->dist_cache_, NULL, storage_ix, storage);
+  *bytes = covered;
+  return BytesToEndStream(*storage_ix, BROTLI_TRUE);
+}
+
+/* Writes the pending meta-block of BrotliEncoderCompressToBudget. If it does
+   not leave room to end the stream within |s->output_budget_| bytes, the
+   longest prefix that does is written as the last meta-block instead.
+   Returns the number of input bytes written. */
+static size_t WriteMetaBlockWithinBudget(BrotliEncoderState* s,
+    const uint8_t* data, uint32_t mask, BROTLI_BOOL is_last,
+    ContextType literal_context_mode, size_t metablock_size,
+    size_t* storage_ix, uint8_t* storage) {
+  MemoryManager* m = &s->memory_manager_;
+  const size_t budget = s->output_budget_;
+  const size_t num_commands = s->num_commands_;
+  /* Storing re-encodes distances in place; prefixes are cut from a copy. */
+  Command* commands = BROTLI_ALLOC(m, Command, 2 * num_commands + 1);
+  Command* cut = commands + num_commands;
+  size_t lo = 0;
+  size_t lo_size = 1;
+  size_t hi = metablock_size + 1;
+  size_t written = hi;
+  size_t bytes = 0;
+  double lo_excess;
+  double hi_excess;
+  int side = 0;
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(commands)) return 0;
+  memcpy(commands, s->commands_, num_commands * sizeof(Command));
+
+  WriteMetaBlockInternal(
+      m, data, mask, s->last_flush_pos_, metablock_size, is_last,
+      literal_context_mode, &s->params, s->prev_byte_, s->prev_byte2_,
+      s->num_literals_, num_commands, s->commands_, s->saved_dist_cache_,
+      s->dist_cache_, NULL, storage_ix, storage);
+  if (BROTLI_IS_OOM(m)) return 0;
+  if (BytesToEndStream(*storage_ix, is_last) <= budget) {
+    BROTLI_FREE(m, commands);
+    return metablock_size;
+  }
+  if (is_last) hi = metablock_size;
+
+  /* Output size grows almost linearly with prefix; find where it crosses the
+     budget with the Illinois variant of regula falsi. */
+  lo_excess = (double)lo_size - ((double)budget + 0.5);
+  hi_excess = (double)BytesToEndStream(*storage_ix, is_last) -
+      ((double)budget + 0.5);
+  while (hi - lo > 1 && lo_size < budget) {
+    size_t mid = lo + (size_t)((double)(hi - lo) *
+        (-lo_excess / (hi_excess - lo_excess)));
+    size_t size;
+    mid = BROTLI_MIN(size_t, BROTLI_MAX(size_t, mid, lo + 1), hi - 1);
+    size = WriteMetaBlockPrefix(s, data, mask, literal_context_mode, commands,
+        cut, mid, &bytes, storage_ix, storage);
+    if (BROTLI_IS_OOM(m)) return 0;
+    written = mid;
+    if (size <= budget) {
+      lo = mid;
+      lo_size = size;
+      lo_excess = (double)size - ((double)budget + 0.5);
+      if (side < 0) hi_excess /= 2;
+      side = -1;
+    } else {
+      hi = mid;
+      hi_excess = (double)size - ((double)budget + 0.5);
+      if (side > 0) lo_excess /= 2;
+      side = 1;
+    }
+  }
+  if (written != lo) {
+    WriteMetaBlockPrefix(s, data, mask, literal_context_mode, commands, cut,
+        lo, &bytes, storage_ix, storage);
+    if (BROTLI_IS_OOM(m)) return 0;
+  }
+  BROTLI_FREE(m, commands);
+  s->is_last_block_emitted_ = BROTLI_TRUE;
+  return bytes;
+}
+
 /*
    Processes the accumulated input data and sets |*out_size| to the length of
    the new output meta-block, or to zero if no new output meta-block has been
@@ -1001,13 +1737,14 @@ static BROTLI_BOOL EncodeData(
   const uint64_t delta = UnprocessedInputSize(s);
   uint32_t bytes = (uint32_t)delta;
   uint32_t wrapped_last_processed_pos = WrapPosition(s->last_processed_pos_);
-  uint8_t* data;
+  const uint8_t* data;
   uint32_t mask;
   MemoryManager* m = &s->memory_manager_;
   ContextType literal_context_mode;
   ContextLut literal_context_lut;
+  uint64_t start;
 
-  data = s->ringbuffer_.buffer_;
+  data = InputData(s);
   mask = s->ringbuffer_.mask_;
 
   if (s->params.quality > s->params.dictionary.max_quality) return BROTLI_FALSE;
@@ -1036,6 +1773,7 @@ static BROTLI_BOOL EncodeData(
     size_t storage_ix = s->last_bytes_bits_;
     size_t table_size;
     int* table;
+    uint64_t start;
 
     if (delta == 0 && !is_last) {
       /* We have no new input data and we don't have to finish the stream, so
@@ -1047,9 +1785,17 @@ static BROTLI_BOOL EncodeData(
     if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
     storage[0] = (uint8_t)s->last_bytes_;
     storage[1] = (uint8_t)(s->last_bytes_ >> 8);
-    table = GetHashTable(s, s->params.quality, bytes, &table_size);
-    if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
-    if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY) {
+    BROTLI_PROBE3(metablock_start, s, s->params.quality,
+        s->params.hasher.type);
+    start = s->params.collect_stats ? BrotliReadTicks() : 0;
+    if (ShouldSkipBlock(&s->params, data, mask, wrapped_last_processed_pos,
+                        bytes)) {
+      BrotliStoreUncompressedMetaBlock(is_last, data,
+          wrapped_last_processed_pos, mask, bytes, &storage_ix, storage);
+      s->stored_incompressible_bytes_ += bytes;
+    } else if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY) {
+      table = GetHashTable(s, s->params.quality, bytes, &table_size);
+      if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
       BrotliCompressFragmentFast(
           s->one_pass_arena_, &data[wrapped_last_processed_pos & mask],
           bytes, is_last,
@@ -1057,6 +1803,8 @@ static BROTLI_BOOL EncodeData(
           &storage_ix, storage);
       if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
     } else {
+      table = GetHashTable(s, s->params.quality, bytes, &table_size);
+      if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
       BrotliCompressFragmentTwoPass(
           s->two_pass_arena_, &data[wrapped_last_processed_pos & mask],
           bytes, is_last,
@@ -1065,9 +1813,15 @@ static BROTLI_BOOL EncodeData(
           &storage_ix, storage);
       if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
     }
+    if (s->params.collect_stats) {
+      s->stats_[BROTLI_ENCODER_STAT_METABLOCKS]++;
+      AddStatsTicks(s->stats_, BROTLI_ENCODER_STAT_MATCH_SEARCH_TICKS, &start);
+    }
     s->last_bytes_ = (uint16_t)(storage[storage_ix >> 3]);
     s->last_bytes_bits_ = storage_ix & 7u;
     UpdateLastProcessedPos(s);
+    BROTLI_PROBE4(metablock_end, s, bytes, storage_ix >> 3,
+        s->params.quality);
     *output = &storage[0];
     *out_size = storage_ix >> 3;
     return BROTLI_TRUE;
@@ -1092,6 +1846,17 @@ static BROTLI_BOOL EncodeData(
     }
   }
 
+  /* Input blocks are merged into a metablock until it is written. */
+  if (s->last_processed_pos_ == s->last_flush_pos_) {
+    BROTLI_PROBE3(metablock_start, s, s->params.quality,
+        s->params.hasher.type);
+  }
+
+  if (ShouldSkipBlock(&s->params, data, mask, wrapped_last_processed_pos,
+                      bytes)) {
+    return StoreIncompressibleBlock(s, is_last, out_size, output);
+  }
+
   InitOrStitchToPreviousBlock(m, &s->hasher_, data, mask, &s->params,
       wrapped_last_processed_pos, bytes, is_last);
 
@@ -1106,9 +1871,13 @@ static BROTLI_BOOL EncodeData(
     ExtendLastCommand(s, &bytes, &wrapped_last_processed_pos);
   }
 
-  if (s->params.quality == ZOPFLIFICATION_QUALITY) {
-    BROTLI_DCHECK(s->params.hasher.type == 10);
-    BrotliCreateZopfliBackwardReferences(m, bytes, wrapped_last_processed_pos,
+  start = s->params.collect_stats ? BrotliReadTicks() : 0;
+  if (s->params.quality == ZOPFLIFICATION_QUALITY ||
+      UsesShortestPath(&s->params)) {
+    BROTLI_DCHECK(s->params.hasher.type == 10 ||
+                  UsesShortestPath(&s->params));
+    BrotliCreateZopfliBackwardReferences(m, &s->zopfli_arena_,
+        bytes, wrapped_last_processed_pos,
         data, mask, literal_context_lut, &s->params,
         &s->hasher_, s->dist_cache_,
         &s->last_insert_len_, &s->commands_[s->num_commands_],
@@ -1116,7 +1885,8 @@ static BROTLI_BOOL EncodeData(
     if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
   } else if (s->params.quality == HQ_ZOPFLIFICATION_QUALITY) {
     BROTLI_DCHECK(s->params.hasher.type == 10);
-    BrotliCreateHqZopfliBackwardReferences(m, bytes, wrapped_last_processed_pos,
+    BrotliCreateHqZopfliBackwardReferences(m, &s->zopfli_arena_,
+        bytes, wrapped_last_processed_pos,
         data, mask, literal_context_lut, &s->params,
         &s->hasher_, s->dist_cache_,
         &s->last_insert_len_, &s->commands_[s->num_commands_],
@@ -1129,6 +1899,9 @@ static BROTLI_BOOL EncodeData(
         &s->last_insert_len_, &s->commands_[s->num_commands_],
         &s->num_commands_, &s->num_literals_);
   }
+  if (s->params.collect_stats) {
+    AddStatsTicks(s->stats_, BROTLI_ENCODER_STAT_MATCH_SEARCH_TICKS, &start);
+  }
 
   {
     const size_t max_length = MaxMetablockSize(&s->params);
@@ -1174,22 +1947,29 @@ static BROTLI_BOOL EncodeData(
   BROTLI_DCHECK(s->input_pos_ > s->last_flush_pos_ || is_last);
   BROTLI_DCHECK(s->input_pos_ - s->last_flush_pos_ <= 1u << 24);
   {
-    const uint32_t metablock_size =
-        (uint32_t)(s->input_pos_ - s->last_flush_pos_);
+    size_t metablock_size = (size_t)(s->input_pos_ - s->last_flush_pos_);
     uint8_t* storage = GetBrotliStorage(s, 2 * metablock_size + 503);
     size_t storage_ix = s->last_bytes_bits_;
     if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
     storage[0] = (uint8_t)s->last_bytes_;
     storage[1] = (uint8_t)(s->last_bytes_ >> 8);
-    WriteMetaBlockInternal(
-        m, data, mask, s->last_flush_pos_, metablock_size, is_last,
-        literal_context_mode, &s->params, s->prev_byte_, s->prev_byte2_,
-        s->num_literals_, s->num_commands_, s->commands_, s->saved_dist_cache_,
-        s->dist_cache_, &storage_ix, storage);
+    if (s->output_budget_ != 0) {
+      metablock_size = WriteMetaBlockWithinBudget(s, data, mask, is_last,
+          literal_context_mode, metablock_size, &storage_ix, storage);
+    } else {
+      WriteMetaBlockInternal(
+          m, data, mask, s->last_flush_pos_, metablock_size, is_last,
+          literal_context_mode, &s->params, s->prev_byte_, s->prev_byte2_,
+          s->num_literals_, s->num_commands_, s->commands_,
+          s->saved_dist_cache_, s->dist_cache_,
+          s->params.collect_stats ? s->stats_ : NULL, &storage_ix, storage);
+    }
     if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+    BROTLI_PROBE4(metablock_end, s, metablock_size, storage_ix >> 3,
+        s->params.quality);
     s->last_bytes_ = (uint16_t)(storage[storage_ix >> 3]);
     s->last_bytes_bits_ = storage_ix & 7u;
-    s->last_flush_pos_ = s->input_pos_;
+    s->last_flush_pos_ += metablock_size;
     if (UpdateLastProcessedPos(s)) {
       HasherReset(&s->hasher_);
     }
@@ -1317,13 +2097,15 @@ static BROTLI_BOOL BrotliCompressBufferQuality10(
     ContextLut literal_context_lut = BROTLI_CONTEXT_LUT(literal_context_mode);
 
     size_t block_start;
+    /* Nodes are shared by all blocks of the meta-block. */
+    ZopfliNode* nodes = BROTLI_ALLOC(m, ZopfliNode, BROTLI_MIN(size_t,
+        metablock_end - metablock_start, max_block_size) + 1);
+    if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(nodes)) goto oom;
     for (block_start = metablock_start; block_start < metablock_end; ) {
       size_t block_size =
           BROTLI_MIN(size_t, metablock_end - block_start, max_block_size);
-      ZopfliNode* nodes = BROTLI_ALLOC(m, ZopfliNode, block_size + 1);
       size_t path_size;
       size_t new_cmd_alloc_size;
-      if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(nodes)) goto oom;
       BrotliInitZopfliNodes(nodes, block_size + 1);
       StitchToPreviousBlockH10(&hasher->privat._H10, block_size, block_start,
                                input_buffer, mask);
@@ -1356,12 +2138,12 @@ static BROTLI_BOOL BrotliCompressBufferQuality10(
       num_commands += path_size;
       block_start += block_size;
       metablock_size += block_size;
-      BROTLI_FREE(m, nodes);
       if (num_literals > max_literals_per_metablock ||
           num_commands > max_commands_per_metablock) {
         break;
       }
     }
+    BROTLI_FREE(m, nodes);
 
     if (last_insert_len > 0) {
       InitInsertCommand(&commands[num_commands++], last_insert_len);
@@ -1474,6 +2256,45 @@ oom:
   return BROTLI_FALSE;
 }
 
+BROTLI_BOOL BrotliEncoderConcatenate(int lgwin, size_t num_fragments,
+    const size_t fragment_sizes[BROTLI_ARRAY_PARAM(num_fragments)],
+    const uint8_t* const fragments[BROTLI_ARRAY_PARAM(num_fragments)],
+    size_t* encoded_size,
+    uint8_t encoded_buffer[BROTLI_ARRAY_PARAM(*encoded_size)]) {
+  uint16_t header;
+  uint8_t header_bits;
+  size_t header_size;
+  size_t total;
+  size_t pos;
+  size_t i;
+  if (lgwin < BROTLI_MIN_WINDOW_BITS || lgwin > BROTLI_MAX_WINDOW_BITS) {
+    return BROTLI_FALSE;
+  }
+  EncodeWindowBits(lgwin, BROTLI_FALSE, &header, &header_bits);
+  /* Pad header to byte boundary with an empty metadata block, as flush does:
+     is_last = 0, data_nibbles = 11, reserved = 0, meta_nibbles = 00. */
+  header = (uint16_t)(header | (0x6u << header_bits));
+  header_size = (header_bits + 6u + 7u) >> 3;
+  total = header_size + 1;
+  for (i = 0; i < num_fragments; ++i) {
+    total += fragment_sizes[i];
+    if (total < fragment_sizes[i]) return BROTLI_FALSE;
+  }
+  if (*encoded_size < total) return BROTLI_FALSE;
+  encoded_buffer[0] = (uint8_t)header;
+  if (header_size > 1) encoded_buffer[1] = (uint8_t)(header >> 8);
+  pos = header_size;
+  for (i = 0; i < num_fragments; ++i) {
+    if (fragment_sizes[i] == 0) continue;
+    memcpy(encoded_buffer + pos, fragments[i], fragment_sizes[i]);
+    pos += fragment_sizes[i];
+  }
+  /* is_last = 1, is_empty = 1 */
+  encoded_buffer[pos++] = 3;
+  *encoded_size = pos;
+  return BROTLI_TRUE;
+}
+
 size_t BrotliEncoderMaxCompressedSize(size_t input_size) {
   /* [window bits / empty metadata] + N * [uncompressed] + [last empty] */
   size_t num_large_blocks = input_size >> 14;
@@ -1483,6 +2304,198 @@ size_t BrotliEncoderMaxCompressedSize(size_t input_size) {
   return (result < input_size) ? 0 : result;
 }
 
+size_t BrotliEncoderEstimatePeakMemoryUsage(int quality, int lgwin,
+                                            size_t input_size) {
+  BrotliEncoderParams params;
+  size_t state_size = sizeof(BrotliEncoderState);
+  BrotliEncoderInitParams(&params);
+  params.quality = quality;
+  params.lgwin = lgwin;
+  params.size_hint = input_size;
+  params.large_window = TO_BROTLI_BOOL(lgwin > BROTLI_MAX_WINDOW_BITS);
+  SanitizeParams(&params);
+  params.lgblock = ComputeLgBlock(&params);
+  ChooseHasher(&params, &params.hasher);
+  if (params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY ||
+      params.quality == FAST_TWO_PASS_COMPRESSION_QUALITY) {
+    size_t block_size =
+        BROTLI_MIN(size_t, input_size, (size_t)1 << params.lgwin);
+    size_t hash_table_size =
+        HashTableSize(MaxHashTableSize(params.quality), block_size);
+    /* Small tables live in the state itself. */
+    size_t hash_size =
+        (hash_table_size <= (1u << 10)) ? 0 : sizeof(int) * hash_table_size;
+    size_t cmdbuf_size = 0;
+    size_t outbuf_size = 2 * block_size + 503;
+    if (params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY) {
+      state_size += sizeof(BrotliOnePassArena);
+    } else {
+      size_t buf_size =
+          BROTLI_MIN(size_t, block_size, kCompressFragmentTwoPassBlockSize);
+      state_size += sizeof(BrotliTwoPassArena);
+      cmdbuf_size = buf_size * (sizeof(uint32_t) + sizeof(uint8_t));
+    }
+    return state_size + hash_size + cmdbuf_size + outbuf_size;
+  } else {
+    size_t short_ringbuffer_size = (size_t)1 << params.lgblock;
+    /* Ring buffer gets its full size on the second write. */
+    size_t ringbuffer_size =
+        ((size_t)1 << ComputeRbBits(&params)) + short_ringbuffer_size;
+    size_t hash_size[4] = {0};
+    size_t metablock_size =
+        BROTLI_MIN(size_t, input_size, MaxMetablockSize(&params));
+    size_t inputblock_size =
+        BROTLI_MIN(size_t, input_size, short_ringbuffer_size);
+    /* Commands array is grown by 3/4 of block on demand; a single block
+       needs a single allocation, otherwise old array is alive while the
+       buffer grows. */
+    size_t cmdbuf_size = (input_size <= short_ringbuffer_size) ?
+        (inputblock_size / 2 + inputblock_size / 4 + 17) * sizeof(Command) :
+        2 * (metablock_size / 2 + inputblock_size / 2 + inputblock_size / 4 +
+             17) * sizeof(Command);
+    size_t outbuf_size = 2 * metablock_size + 503;
+    size_t zopfli_size = 0;
+    size_t histogram_size = 0;
+    /* Input that fits the first block is processed as a whole. */
+    HasherSize(&params, TO_BROTLI_BOOL(input_size <= short_ringbuffer_size),
+               input_size, hash_size);
+    if (params.quality < MIN_QUALITY_FOR_BLOCK_SPLIT) {
+      /* Meta-block is emitted after each input block. */
+      cmdbuf_size = BROTLI_MIN(size_t, cmdbuf_size,
+          (MAX_NUM_DELAYED_SYMBOLS + inputblock_size) * sizeof(Command));
+    }
+    if (params.quality == ZOPFLIFICATION_QUALITY) {
+      zopfli_size = (inputblock_size + 1) * sizeof(ZopfliNode);
+    } else if (params.quality == HQ_ZOPFLIFICATION_QUALITY) {
+      /* Nodes, match counts, a few matches per position and cost model. */
+      zopfli_size = (inputblock_size + 1) * sizeof(ZopfliNode) +
+          inputblock_size * (sizeof(uint32_t) + 8 * sizeof(BackwardMatch) +
+                             sizeof(float));
+    }
+    if (params.quality >= MIN_QUALITY_FOR_HQ_BLOCK_SPLITTING) {
+      /* Only a very rough estimation, based on enwik8. */
+      histogram_size = BROTLI_MIN(size_t, 200u << 20,
+          metablock_size * 12 + (1u << 20));
+    } else if (params.quality >= MIN_QUALITY_FOR_BLOCK_SPLIT) {
+      size_t num_histograms = BROTLI_MIN(size_t, metablock_size / 6144, 256);
+      histogram_size = num_histograms * (sizeof(HistogramLiteral) +
+          sizeof(HistogramCommand) + sizeof(HistogramDistance));
+    }
+    /* Entropy codes, block split data and other small transient arrays. */
+    return state_size + (512u << 10) + ringbuffer_size +
+        hash_size[0] + hash_size[1] + hash_size[2] + hash_size[3] +
+        cmdbuf_size + outbuf_size + zopfli_size + histogram_size;
+  }
+}
+
+/* BrotliEncoderEstimate looks at up to that many blocks of that size. */
+#define BROTLI_ESTIMATE_BLOCK_SIZE 2048
+#define BROTLI_ESTIMATE_MAX_BLOCKS 32
+#define BROTLI_ESTIMATE_HASH_BITS 11
+
+/* Approximate cost of a command with a new distance. */
+static const double kEstimateCommandBits = 20.0;
+
+/* Compression ratio reached at each quality is close to the one of the greedy
+   probe raised to this power; fitted on text, logs, tables and source code. */
+static const double kEstimateRatioExponent[12] = {
+  1.27, 1.36, 1.43, 1.43, 1.48, 1.54, 1.55, 1.56, 1.57, 1.58, 1.60, 1.63
+};
+
+/* Encoding time at each quality, picoseconds per compressible input byte,
+   measured on a 2 GHz Xeon core. Incompressible input is encoded faster. */
+static const uint32_t kEstimatePicosPerByte[12] = {
+  3240, 4550, 7550, 8920, 14430, 24690, 31650, 47420, 62820, 100240,
+  681180, 1675110
+};
+
+BROTLI_BOOL BrotliEncoderEstimate(int quality, int lgwin, size_t input_size,
+    const uint8_t input_buffer[BROTLI_ARRAY_PARAM(input_size)],
+    size_t* compressed_size, uint64_t* encode_nanos) {
+  size_t table[1 << BROTLI_ESTIMATE_HASH_BITS];
+  size_t histogram[3 * 256];
+  float cost[BROTLI_ESTIMATE_BLOCK_SIZE];
+  const size_t block_size = BROTLI_ESTIMATE_BLOCK_SIZE;
+  const size_t max_size = BrotliEncoderMaxCompressedSize(input_size);
+  size_t max_distance;
+  size_t num_blocks;
+  size_t sampled = 0;
+  size_t num_matches = 0;
+  double literal_bits = 0.0;
+  double ratio;
+  double estimate;
+  size_t i;
+  const uint8_t* input = input_buffer;
+  if (max_size == 0 || (input_size != 0 && !input)) return BROTLI_FALSE;
+  quality = BROTLI_MIN(int, BROTLI_MAX_QUALITY,
+      BROTLI_MAX(int, BROTLI_MIN_QUALITY, quality));
+  lgwin = BROTLI_MIN(int, BROTLI_LARGE_MAX_WINDOW_BITS,
+      BROTLI_MAX(int, BROTLI_MIN_WINDOW_BITS, lgwin));
+  max_distance = BROTLI_MAX_BACKWARD_LIMIT(lgwin);
+  *encode_nanos = (uint64_t)input_size *
+      kEstimatePicosPerByte[quality] / 1000;
+  if (input_size == 0) {
+    *compressed_size = 1;
+    return BROTLI_TRUE;
+  }
+
+  /* Short input is looked at as a whole, longer is sampled evenly. */
+  num_blocks = BROTLI_MIN(size_t, BROTLI_ESTIMATE_MAX_BLOCKS,
+      (input_size + block_size - 1) / block_size);
+  memset(table, 0, sizeof(table));
+  for (i = 0; i < num_blocks; ++i) {
+    size_t start;
+    size_t len;
+    size_t pos;
+    if (input_size <= BROTLI_ESTIMATE_MAX_BLOCKS * block_size) {
+      start = i * block_size;
+      len = BROTLI_MIN(size_t, block_size, input_size - start);
+    } else {
+      start = (input_size - block_size) / (num_blocks - 1) * i;
+      len = block_size;
+    }
+    BrotliEstimateBitCostsForLiterals(
+        start, len, kLinearMask, input, histogram, cost);
+    /* Greedy single-probe matching, as of the fastest hashers. */
+    pos = start;
+    while (pos < start + len) {
+      size_t match_len = 0;
+      if (pos + 4 <= start + len) {
+        uint32_t key = (BROTLI_UNALIGNED_LOAD32LE(&input[pos]) * kHashMul32) >>
+            (32 - BROTLI_ESTIMATE_HASH_BITS);
+        size_t candidate = table[key];
+        table[key] = pos + 1;
+        if (candidate != 0 && pos - (candidate - 1) <= max_distance) {
+          const uint8_t* a = &input[candidate - 1];
+          const uint8_t* b = &input[pos];
+          size_t limit = start + len - pos;
+          while (match_len < limit && a[match_len] == b[match_len]) {
+            ++match_len;
+          }
+          if (match_len < 4) match_len = 0;
+        }
+      }
+      if (match_len != 0) {
+        ++num_matches;
+        pos += match_len;
+      } else {
+        literal_bits += cost[pos - start];
+        ++pos;
+      }
+    }
+    sampled += len;
+  }
+
+  ratio = (literal_bits + (double)num_matches * kEstimateCommandBits) /
+      (8.0 * (double)sampled);
+  if (ratio > 1.0) ratio = 1.0;
+  estimate = (double)input_size * pow(ratio, kEstimateRatioExponent[quality])
+      + 2.0;
+  *compressed_size = (estimate < (double)max_size) ?
+      (size_t)estimate : max_size;
+  return BROTLI_TRUE;
+}
+
 /* Wraps data to uncompressed brotli stream with minimal window size.
    |output| should point at region with at least BrotliEncoderMaxCompressedSize
    addressable bytes.
@@ -1539,7 +2552,7 @@ BROTLI_BOOL BrotliEncoderCompress(
     *encoded_buffer = 6;
     return BROTLI_TRUE;
   }
-  if (quality == 10) {
+  if (quality == 10 && MAX_ENCODER_QUALITY >= 10) {
     /* TODO: Implement this direct path for all quality levels. */
     const int lg_win = BROTLI_MIN(int, BROTLI_LARGE_MAX_WINDOW_BITS,
                                        BROTLI_MAX(int, 16, lgwin));
@@ -1568,6 +2581,7 @@ BROTLI_BOOL BrotliEncoderCompress(
     if (lgwin > BROTLI_MAX_WINDOW_BITS) {
       BrotliEncoderSetParameter(s, BROTLI_PARAM_LARGE_WINDOW, BROTLI_TRUE);
     }
+    BrotliEncoderAttachInput(s, input_size, input_buffer);
     result = BrotliEncoderCompressStream(s, BROTLI_OPERATION_FINISH,
         &available_in, &next_in, &available_out, &next_out, &total_out);
     if (!BrotliEncoderIsFinished(s)) result = 0;
@@ -1589,6 +2603,78 @@ fallback:
   return BROTLI_FALSE;
 }
 
+/* Input bytes to gather into the next meta-block of the budgeted compression:
+   twice as much as would fill the rest of the budget at the ratio achieved so
+   far, or 8 times the rest before any output. Meta-blocks that do not fit are
+   cut, so erring on the large side only costs time. */
+static size_t BudgetedMetaBlockSize(const BrotliEncoderState* s,
+    size_t total_out) {
+  const double ratio = (total_out == 0) ? 4.0 :
+      (double)s->last_flush_pos_ / (double)total_out;
+  const double size = 2.0 * ratio * (double)s->output_budget_;
+  return (size < (double)(1u << 24)) ? (size_t)size + 1 : (1u << 24);
+}
+
+BROTLI_BOOL BrotliEncoderCompressToBudget(
+    int quality, int lgwin, BrotliEncoderMode mode, size_t input_size,
+    const uint8_t input_buffer[BROTLI_ARRAY_PARAM(input_size)],
+    size_t* consumed_size, size_t* encoded_size,
+    uint8_t encoded_buffer[BROTLI_ARRAY_PARAM(*encoded_size)]) {
+  const size_t budget = *encoded_size;
+  BrotliEncoderState* s;
+  size_t total_out = 0;
+  size_t pos = 0;
+  BROTLI_BOOL ok = BROTLI_TRUE;
+  *consumed_size = 0;
+  *encoded_size = 0;
+  if (budget == 0) return BROTLI_FALSE;
+
+  s = BrotliEncoderCreateInstance(0, 0, 0);
+  if (!s) return BROTLI_FALSE;
+  /* Fastest qualities do not keep commands to cut meta-blocks at. */
+  BrotliEncoderSetParameter(s, BROTLI_PARAM_QUALITY, (uint32_t)BROTLI_MAX(
+      int, quality, FAST_TWO_PASS_COMPRESSION_QUALITY + 1));
+  BrotliEncoderSetParameter(s, BROTLI_PARAM_LGWIN, (uint32_t)lgwin);
+  BrotliEncoderSetParameter(s, BROTLI_PARAM_MODE, (uint32_t)mode);
+  if (lgwin > BROTLI_MAX_WINDOW_BITS) {
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_LARGE_WINDOW, BROTLI_TRUE);
+  }
+  BrotliEncoderAttachInput(s, input_size, input_buffer);
+  ok = EnsureInitialized(s);
+  s->output_budget_ = budget;
+
+  while (ok && !s->is_last_block_emitted_) {
+    const size_t limit = BudgetedMetaBlockSize(s, total_out);
+    const size_t pending = (size_t)(s->input_pos_ - s->last_flush_pos_);
+    size_t block = BROTLI_MIN(size_t, input_size - pos,
+        RemainingInputBlockSize(s));
+    size_t out_size = 0;
+    uint8_t* output = NULL;
+    if (pending + block > limit) {
+      block = (limit > pending) ? limit - pending : 0;
+    }
+    CopyInputToRingBuffer(s, block, &input_buffer[pos]);
+    pos += block;
+    ok = EncodeData(s, TO_BROTLI_BOOL(pos == input_size),
+        TO_BROTLI_BOOL(pending + block >= limit), &out_size, &output);
+    if (!ok || out_size > s->output_budget_) {
+      ok = BROTLI_FALSE;
+      break;
+    }
+    if (out_size != 0) {
+      memcpy(&encoded_buffer[total_out], output, out_size);
+      total_out += out_size;
+      s->output_budget_ -= out_size;
+    }
+  }
+  if (ok) {
+    *consumed_size = (size_t)s->last_flush_pos_;
+    *encoded_size = total_out;
+  }
+  BrotliEncoderDestroyInstance(s);
+  return ok;
+}
+
 static void InjectBytePaddingBlock(BrotliEncoderState* s) {
   uint32_t seal = s->last_bytes_;
   size_t seal_bits = s->last_bytes_bits_;
@@ -1638,11 +2724,44 @@ static BROTLI_BOOL InjectFlushOrPushOutput(BrotliEncoderState* s,
   return BROTLI_FALSE;
 }
 
+static BROTLI_BOOL IsIdle(const BrotliEncoderState* s) {
+  return TO_BROTLI_BOOL(s->stream_state_ == BROTLI_STREAM_PROCESSING &&
+      s->available_out_ == 0 && UnprocessedInputSize(s) == 0 &&
+      s->num_commands_ == 0 && s->last_insert_len_ == 0 &&
+      s->remaining_metadata_bytes_ == BROTLI_UINT32_MAX);
+}
+
+/* Frees everything that is allocated again on demand. Output storage is kept
+   unless |release_storage|: caller of BrotliEncoderTakeOutput might still
+   read it. */
+static void ReleaseIdleMemory(BrotliEncoderState* s,
+                              BROTLI_BOOL release_storage) {
+  MemoryManager* m = &s->memory_manager_;
+  DestroyHasher(m, &s->hasher_);
+  HasherInit(&s->hasher_);
+  BROTLI_FREE(m, s->commands_);
+  s->cmd_alloc_size_ = 0;
+  BrotliCleanupZopfliArena(m, &s->zopfli_arena_);
+  BROTLI_FREE(m, s->large_table_);
+  s->large_table_size_ = 0;
+  BROTLI_FREE(m, s->command_buf_);
+  BROTLI_FREE(m, s->literal_buf_);
+  if (release_storage) {
+    BROTLI_FREE(m, s->storage_);
+    s->storage_size_ = 0;
+    s->next_out_ = NULL;
+  }
+}
+
 static void CheckFlushComplete(BrotliEncoderState* s) {
   if (s->stream_state_ == BROTLI_STREAM_FLUSH_REQUESTED &&
       s->available_out_ == 0) {
+    BROTLI_PROBE2(flush, s, s->total_out_);
     s->stream_state_ = BROTLI_STREAM_PROCESSING;
     s->next_out_ = 0;
+    if (s->params.memory_limit != 0 && IsIdle(s)) {
+      ReleaseIdleMemory(s, BROTLI_FALSE);
+    }
   }
 }
 
@@ -1650,13 +2769,19 @@ static BROTLI_BOOL BrotliEncoderCompressStreamFast(
     BrotliEncoderState* s, BrotliEncoderOperation op, size_t* available_in,
     const uint8_t** next_in, size_t* available_out, uint8_t** next_out,
     size_t* total_out) {
-  const size_t block_size_limit = (size_t)1 << s->params.lgwin;
+  /* Blocks span the window, unless the work budget cuts them; blocks under
+     64 KiB cost too much ratio. */
+  const size_t block_size_limit = (s->params.work_budget == 0) ?
+      ((size_t)1 << s->params.lgwin) :
+      BROTLI_MIN(size_t, (size_t)1 << s->params.lgwin,
+          BROTLI_MAX(size_t, s->params.work_budget, (size_t)1 << 16));
   const size_t buf_size = BROTLI_MIN(size_t, kCompressFragmentTwoPassBlockSize,
       BROTLI_MIN(size_t, *available_in, block_size_limit));
   uint32_t* tmp_command_buf = NULL;
   uint32_t* command_buf = NULL;
   uint8_t* tmp_literal_buf = NULL;
   uint8_t* literal_buf = NULL;
+  size_t work = 0;
   MemoryManager* m = &s->memory_manager_;
   if (s->params.quality != FAST_ONE_PASS_COMPRESSION_QUALITY &&
       s->params.quality != FAST_TWO_PASS_COMPRESSION_QUALITY) {
@@ -1692,6 +2817,11 @@ static BROTLI_BOOL BrotliEncoderCompressStreamFast(
     if (InjectFlushOrPushOutput(s, available_out, next_out, total_out)) {
       continue;
     }
+    /* Yield between blocks once the work budget is spent. */
+    if (s->params.work_budget != 0 && work >= s->params.work_budget &&
+        *available_in != 0) {
+      break;
+    }
 
     /* Compress block only when internal output buffer is empty, stream is not
        finished, there is no pending flush request, and there is either
@@ -1710,6 +2840,7 @@ static BROTLI_BOOL BrotliEncoderCompressStreamFast(
       size_t storage_ix = s->last_bytes_bits_;
       size_t table_size;
       int* table;
+      uint64_t start;
 
       if (force_flush && block_size == 0) {
         s->stream_state_ = BROTLI_STREAM_FLUSH_REQUESTED;
@@ -1727,7 +2858,14 @@ static BROTLI_BOOL BrotliEncoderCompressStreamFast(
       table = GetHashTable(s, s->params.quality, block_size, &table_size);
       if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
 
-      if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY) {
+      BROTLI_PROBE3(metablock_start, s, s->params.quality,
+          s->params.hasher.type);
+      start = s->params.collect_stats ? BrotliReadTicks() : 0;
+      if (ShouldSkipBlock(&s->params, *next_in, kLinearMask, 0, block_size)) {
+        BrotliStoreUncompressedMetaBlock(is_last, *next_in, 0, kLinearMask,
+            block_size, &storage_ix, storage);
+        s->stored_incompressible_bytes_ += block_size;
+      } else if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY) {
         BrotliCompressFragmentFast(s->one_pass_arena_, *next_in, block_size,
             is_last, table, table_size, &storage_ix, storage);
         if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
@@ -1737,9 +2875,20 @@ static BROTLI_BOOL BrotliEncoderCompressStreamFast(
             &storage_ix, storage);
         if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
       }
+      if (s->params.collect_stats) {
+        s->stats_[BROTLI_ENCODER_STAT_METABLOCKS]++;
+        AddStatsTicks(s->stats_, BROTLI_ENCODER_STAT_MATCH_SEARCH_TICKS,
+                      &start);
+      }
+      BROTLI_PROBE4(metablock_end, s, block_size, storage_ix >> 3,
+          s->params.quality);
       if (block_size != 0) {
+        if (s->params.checksum) {
+          s->checksum_ = BrotliCrc32c(s->checksum_, *next_in, block_size);
+        }
         *next_in += block_size;
         *available_in -= block_size;
+        work += block_size;
       }
       if (inplace) {
         size_t out_bytes = storage_ix >> 3;
@@ -1766,6 +2915,10 @@ static BROTLI_BOOL BrotliEncoderCompressStreamFast(
   BROTLI_FREE(m, tmp_command_buf);
   BROTLI_FREE(m, tmp_literal_buf);
   CheckFlushComplete(s);
+  if (s->params.memory_limit != 0 && op == BROTLI_OPERATION_FLUSH &&
+      IsIdle(s)) {
+    ReleaseIdleMemory(s, BROTLI_TRUE);
+  }
   return BROTLI_TRUE;
 }
 
@@ -1820,10 +2973,24 @@ static BROTLI_BOOL ProcessMetadata(
         s->remaining_metadata_bytes_ -= copy;
         *next_out += copy;
         *available_out -= copy;
+        s->total_out_ += copy;
+        if (total_out) *total_out = s->total_out_;
       } else {
-        /* This guarantees progress in "TakeOutput" workflow. */
-        uint32_t copy = BROTLI_MIN(uint32_t, s->remaining_metadata_bytes_, 16);
-        s->next_out_ = s->tiny_buf_.u8;
+        /* "TakeOutput" workflow: copy through the storage, in chunks big
+           enough to make the round-trips per block few; tiny blocks go
+           through tiny_buf_. */
+        size_t chunk = BROTLI_MAX(size_t, s->storage_size_, 1u << 16);
+        uint32_t copy = (uint32_t)BROTLI_MIN(
+            size_t, s->remaining_metadata_bytes_, chunk);
+        if (copy <= 16) {
+          s->next_out_ = s->tiny_buf_.u8;
+        } else {
+          s->next_out_ = GetBrotliStorage(s, copy);
+          if (BROTLI_IS_OOM(&s->memory_manager_) ||
+              BROTLI_IS_NULL(s->next_out_)) {
+            return BROTLI_FALSE;
+          }
+        }
         memcpy(s->next_out_, *next_in, copy);
         *next_in += copy;
         *available_in -= copy;
@@ -1852,30 +3019,175 @@ static void UpdateSizeHint(BrotliEncoderState* s, size_t available_in) {
   }
 }
 
-BROTLI_BOOL BrotliEncoderCompressStream(
-    BrotliEncoderState* s, BrotliEncoderOperation op, size_t* available_in,
-    const uint8_t** next_in, size_t* available_out,uint8_t** next_out,
-    size_t* total_out) {
-  if (!EnsureInitialized(s)) return BROTLI_FALSE;
+/* Resolves BROTLI_MODE_AUTO using the first input chunk. Explicitly set
+   parameters take precedence. */
+static void ApplyContentPreset(BrotliEncoderState* s,
+    BrotliEncoderOperation op, size_t available_in, const uint8_t* next_in) {
+  BrotliContentPreset preset;
+  if (op == BROTLI_OPERATION_EMIT_METADATA) available_in = 0;
+  BrotliSniffContent(next_in, available_in, &preset);
+  s->params.mode = preset.mode;
+  if (!(s->param_set_mask_ & (1u << BROTLI_PARAM_NPOSTFIX)) &&
+      !(s->param_set_mask_ & (1u << BROTLI_PARAM_NDIRECT))) {
+    s->params.dist.distance_postfix_bits = preset.distance_postfix_bits;
+    s->params.dist.num_direct_distance_codes =
+        preset.num_direct_distance_codes;
+  }
+  if (op == BROTLI_OPERATION_FINISH && available_in != 0 &&
+      !(s->param_set_mask_ & (1u << BROTLI_PARAM_LGWIN))) {
+    int lgwin = BROTLI_MIN_WINDOW_BITS;
+    while (lgwin < BROTLI_MAX_WINDOW_BITS &&
+           BROTLI_MAX_BACKWARD_LIMIT(lgwin) < (uint64_t)available_in) {
+      lgwin++;
+    }
+    if (lgwin < s->params.lgwin) s->params.lgwin = lgwin;
+  }
+}
 
-  /* Unfinished metadata block; check requirements. */
-  if (s->remaining_metadata_bytes_ != BROTLI_UINT32_MAX) {
-    if (*available_in != s->remaining_metadata_bytes_) return BROTLI_FALSE;
-    if (op != BROTLI_OPERATION_EMIT_METADATA) return BROTLI_FALSE;
+/* Stages of appending the checksum trailer. */
+#define BROTLI_CHECKSUM_FLUSHING 0
+#define BROTLI_CHECKSUM_EMITTING 1
+#define BROTLI_CHECKSUM_EMITTED 2
+
+/* Finishes stream with the checksum trailer: the rest of input is flushed
+   as non-last meta-blocks, then the trailer is emitted as a metadata block,
+   and then the empty last meta-block ends the stream. Each stage returns as
+   soon as output space is exhausted; the client keeps calling with FINISH. */
+static BROTLI_BOOL FinishWithChecksum(
+    BrotliEncoderState* s, size_t* available_in, const uint8_t** next_in,
+    size_t* available_out, uint8_t** next_out, size_t* total_out) {
+  if (s->checksum_stage_ == BROTLI_CHECKSUM_FLUSHING) {
+    uint32_t magic = BROTLI_CHECKSUM_TRAILER_MAGIC;
+    int i;
+    if (!BrotliEncoderCompressStream(s, BROTLI_OPERATION_FLUSH, available_in,
+        next_in, available_out, next_out, total_out)) {
+      return BROTLI_FALSE;
+    }
+    if (*available_in != 0 || s->available_out_ != 0 ||
+        s->stream_state_ != BROTLI_STREAM_PROCESSING) {
+      return BROTLI_TRUE;
+    }
+    for (i = 0; i < 4; ++i) {
+      s->checksum_trailer_[i] = (uint8_t)(magic >> (8 * i));
+      s->checksum_trailer_[4 + i] = (uint8_t)(s->checksum_ >> (8 * i));
+    }
+    s->checksum_stage_ = BROTLI_CHECKSUM_EMITTING;
+  }
+  if (s->checksum_stage_ == BROTLI_CHECKSUM_EMITTING) {
+    size_t remaining =
+        BROTLI_CHECKSUM_TRAILER_SIZE - s->checksum_trailer_pos_;
+    const uint8_t* next = s->checksum_trailer_ + s->checksum_trailer_pos_;
+    if (!BrotliEncoderCompressStream(s, BROTLI_OPERATION_EMIT_METADATA,
+        &remaining, &next, available_out, next_out, total_out)) {
+      return BROTLI_FALSE;
+    }
+    s->checksum_trailer_pos_ =
+        (uint8_t)(BROTLI_CHECKSUM_TRAILER_SIZE - remaining);
+    /* Metadata workflow is over only when its output is pushed out. */
+    if (s->remaining_metadata_bytes_ != BROTLI_UINT32_MAX) return BROTLI_TRUE;
+    s->checksum_stage_ = BROTLI_CHECKSUM_EMITTED;
+  }
+  return BrotliEncoderCompressStream(s, BROTLI_OPERATION_FINISH, available_in,
+      next_in, available_out, next_out, total_out);
+}
+
+/* Finishes fragment with a flush; the stream is considered finished as soon
+   as the flush is complete. */
+static BROTLI_BOOL FinishFragment(
+    BrotliEncoderState* s, size_t* available_in, const uint8_t** next_in,
+    size_t* available_out, uint8_t** next_out, size_t* total_out) {
+  if (s->stream_state_ == BROTLI_STREAM_FINISHED) {
+    return (*available_in == 0) ? BROTLI_TRUE : BROTLI_FALSE;
+  }
+  if (!BrotliEncoderCompressStream(s, BROTLI_OPERATION_FLUSH, available_in,
+      next_in, available_out, next_out, total_out)) {
+    return BROTLI_FALSE;
+  }
+  if (*available_in == 0 && s->available_out_ == 0 &&
+      s->stream_state_ == BROTLI_STREAM_PROCESSING) {
+    s->stream_state_ = BROTLI_STREAM_FINISHED;
+  }
+  return BROTLI_TRUE;
+}
+
+/* Stages of declaring the stream size. */
+#define BROTLI_SIZE_UNDECIDED 0
+#define BROTLI_SIZE_EMITTING 1
+#define BROTLI_SIZE_DONE 2
+
+/* Emits the leading metadata block with the uncompressed size. Size is known
+   only if the first call has the whole input and FINISH operation; parts
+   of a stream and fragments never declare it. */
+static BROTLI_BOOL DeclareSize(BrotliEncoderState* s,
+    BrotliEncoderOperation op, size_t input_size, size_t* available_out,
+    uint8_t** next_out, size_t* total_out) {
+  size_t remaining;
+  const uint8_t* next;
+  if (s->size_stage_ == BROTLI_SIZE_UNDECIDED) {
+    uint32_t magic = BROTLI_SIZE_METADATA_MAGIC;
+    uint64_t size = input_size;
+    int i;
+    if (op != BROTLI_OPERATION_FINISH || s->params.stream_offset != 0) {
+      s->size_stage_ = BROTLI_SIZE_DONE;
+      return BROTLI_TRUE;
+    }
+    for (i = 0; i < 4; ++i) {
+      s->size_metadata_[i] = (uint8_t)(magic >> (8 * i));
+    }
+    for (i = 0; i < 8; ++i) {
+      s->size_metadata_[4 + i] = (uint8_t)(size >> (8 * i));
+    }
+    s->size_stage_ = BROTLI_SIZE_EMITTING;
+  }
+  remaining = BROTLI_SIZE_METADATA_LENGTH - s->size_metadata_pos_;
+  next = s->size_metadata_ + s->size_metadata_pos_;
+  if (!BrotliEncoderCompressStream(s, BROTLI_OPERATION_EMIT_METADATA,
+      &remaining, &next, available_out, next_out, total_out)) {
+    return BROTLI_FALSE;
+  }
+  s->size_metadata_pos_ =
+      (uint8_t)(BROTLI_SIZE_METADATA_LENGTH - remaining);
+  /* Metadata workflow is over only when its output is pushed out. */
+  if (s->remaining_metadata_bytes_ == BROTLI_UINT32_MAX) {
+    s->size_stage_ = BROTLI_SIZE_DONE;
   }
+  return BROTLI_TRUE;
+}
 
-  if (op == BROTLI_OPERATION_EMIT_METADATA) {
-    UpdateSizeHint(s, 0);  /* First data metablock might be emitted here. */
-    return ProcessMetadata(
-        s, available_in, next_in, available_out, next_out, total_out);
+/* Pads the block of the ramp that was just compressed to a byte boundary, so
+   that all of it can be pushed out, and makes the next block twice as big. */
+static void StepFirstBlocks(BrotliEncoderState* s) {
+  if (s->last_bytes_bits_ != 0) InjectBytePaddingBlock(s);
+  if (++s->ramp_bits_ >= s->params.lgblock) s->ramp_bits_ = 0;
+  s->first_block_done_ = BROTLI_TRUE;
+}
+
+/* Restores the requested quality after the first block. Its hasher is set up
+   over the input compressed so far, as the window is primed; that is left
+   until the next block, so that it does not hold the first one back. */
+static void RestoreQuality(BrotliEncoderState* s) {
+  s->params.quality = s->ramp_quality_;
+  s->hasher_.common.is_setup_ = BROTLI_FALSE;
+  if (s->last_processed_pos_ != 0) {
+    HasherPrependWindow(&s->memory_manager_, &s->hasher_, InputData(s),
+        s->ringbuffer_.mask_, &s->params, (size_t)s->last_processed_pos_);
   }
+}
 
+/* Compresses input, after the special operations and stages are handled. */
+static BROTLI_BOOL CompressStreamData(
+    BrotliEncoderState* s, BrotliEncoderOperation op, size_t* available_in,
+    const uint8_t** next_in, size_t* available_out, uint8_t** next_out,
+    size_t* total_out) {
+  uint64_t work = 0;
   if (s->stream_state_ == BROTLI_STREAM_METADATA_HEAD ||
       s->stream_state_ == BROTLI_STREAM_METADATA_BODY) {
     return BROTLI_FALSE;
   }
 
-  if (s->stream_state_ != BROTLI_STREAM_PROCESSING && *available_in != 0) {
+  /* Flush forced by flint may be pending while input is not consumed yet. */
+  if (s->stream_state_ != BROTLI_STREAM_PROCESSING && *available_in != 0 &&
+      s->flint_ != BROTLI_FLINT_WAITING_FOR_FLUSHING) {
     return BROTLI_FALSE;
   }
   if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY ||
@@ -1885,12 +3197,16 @@ BROTLI_BOOL BrotliEncoderCompressStream(
   }
   while (BROTLI_TRUE) {
     size_t remaining_block_size = RemainingInputBlockSize(s);
+    /* Once the work budget is spent, stop taking input; caller resumes with
+       the rest of it. */
+    BROTLI_BOOL yield = TO_BROTLI_BOOL(s->params.work_budget != 0 &&
+        work >= s->params.work_budget && *available_in != 0);
     /* Shorten input to flint size. */
     if (s->flint_ >= 0 && remaining_block_size > (size_t)s->flint_) {
       remaining_block_size = (size_t)s->flint_;
     }
 
-    if (remaining_block_size != 0 && *available_in != 0) {
+    if (!yield && remaining_block_size != 0 && *available_in != 0) {
       size_t copy_input_size =
           BROTLI_MIN(size_t, remaining_block_size, *available_in);
       CopyInputToRingBuffer(s, copy_input_size, *next_in);
@@ -1913,23 +3229,38 @@ BROTLI_BOOL BrotliEncoderCompressStream(
 
     /* Compress data only when internal output buffer is empty, stream is not
        finished and there is no pending flush request. */
-    if (s->available_out_ == 0 &&
+    if (!yield && s->available_out_ == 0 &&
         s->stream_state_ == BROTLI_STREAM_PROCESSING) {
       if (remaining_block_size == 0 || op != BROTLI_OPERATION_PROCESS) {
         BROTLI_BOOL is_last = TO_BROTLI_BOOL(
             (*available_in == 0) && op == BROTLI_OPERATION_FINISH);
         BROTLI_BOOL force_flush = TO_BROTLI_BOOL(
             (*available_in == 0) && op == BROTLI_OPERATION_FLUSH);
+        /* Blocks of the first block ramp are emitted as soon as they are
+           compressed, without waiting for the caller to flush; flint is not
+           one of them. */
+        BROTLI_BOOL ramp = TO_BROTLI_BOOL(s->ramp_bits_ != 0 && !is_last &&
+            UnprocessedInputSize(s) != 0 &&
+            s->flint_ != BROTLI_FLINT_WAITING_FOR_PROCESSING);
         BROTLI_BOOL result;
+        /* Stream that ends in its first block is compressed at the requested
+           quality, as without the ramp. */
+        if (s->params.quality != s->ramp_quality_ &&
+            (s->first_block_done_ || is_last)) {
+          RestoreQuality(s);
+          if (BROTLI_IS_OOM(&s->memory_manager_)) return BROTLI_FALSE;
+        }
         /* Force emitting (uncompressed) piece containing flint. */
         if (!is_last && s->flint_ == 0) {
           s->flint_ = BROTLI_FLINT_WAITING_FOR_FLUSHING;
           force_flush = BROTLI_TRUE;
         }
         UpdateSizeHint(s, *available_in);
-        result = EncodeData(s, is_last, force_flush,
+        work += UnprocessedInputSize(s);
+        result = EncodeData(s, is_last, TO_BROTLI_BOOL(force_flush || ramp),
             &s->available_out_, &s->next_out_);
         if (!result) return BROTLI_FALSE;
+        if (ramp) StepFirstBlocks(s);
         if (force_flush) s->stream_state_ = BROTLI_STREAM_FLUSH_REQUESTED;
         if (is_last) s->stream_state_ = BROTLI_STREAM_FINISHED;
         continue;
@@ -1938,9 +3269,162 @@ BROTLI_BOOL BrotliEncoderCompressStream(
     break;
   }
   CheckFlushComplete(s);
+  if (s->params.memory_limit != 0 && op == BROTLI_OPERATION_FLUSH &&
+      IsIdle(s)) {
+    ReleaseIdleMemory(s, BROTLI_TRUE);
+  }
   return BROTLI_TRUE;
 }
 
+/* Finds the next cut point in |size| bytes of |data|; returns the number of
+   bytes scanned, i.e. up to the cut point, if there is one. */
+static size_t ScanChunk(
+    BrotliEncoderState* s, const uint8_t* data, size_t size) {
+  const size_t min_size = (size_t)1 << (s->params.chunk_bits - 2);
+  const size_t max_size = (size_t)1 << (s->params.chunk_bits + 2);
+  const int shift = 32 - s->params.chunk_bits;
+  uint32_t factor_remove = 1;
+  uint32_t hash = s->chunk_hash_;
+  uint32_t pos = s->chunk_window_pos_;
+  size_t chunk_size = s->chunk_size_;
+  size_t i;
+  for (i = 0; i < BROTLI_CHUNK_WINDOW; ++i) factor_remove *= kChunkHashMul;
+  for (i = 0; i < size;) {
+    uint8_t byte = data[i++];
+    uint8_t removed = s->chunk_window_[pos];
+    s->chunk_window_[pos] = byte;
+    pos = (pos + 1) & (BROTLI_CHUNK_WINDOW - 1);
+    hash = kChunkHashMul * hash + (byte + 1u) - factor_remove * (removed + 1u);
+    /* Top bits of the hash depend on all bytes of the window. */
+    if (++chunk_size >= max_size ||
+        (chunk_size >= min_size && (hash >> shift) == 0)) {
+      s->chunk_cut_ = BROTLI_TRUE;
+      chunk_size = 0;
+      break;
+    }
+  }
+  s->chunk_hash_ = hash;
+  s->chunk_window_pos_ = pos;
+  s->chunk_size_ = chunk_size;
+  return i;
+}
+
+/* Continues the stream with a chunk that does not refer to the data before
+   it, like a new instance with the stream offset does. Stream is flushed. */
+static void RestartChunk(BrotliEncoderState* s) {
+  int lgwin = s->params.lgwin;
+  size_t limit;
+  if (s->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY ||
+      s->params.quality == FAST_TWO_PASS_COMPRESSION_QUALITY) {
+    lgwin = BROTLI_MAX(int, lgwin, 18);
+  }
+  limit = BROTLI_MAX_BACKWARD_LIMIT(lgwin);
+  if (s->input_pos_ >= limit - s->params.stream_offset) {
+    s->params.stream_offset = limit;
+  } else {
+    s->params.stream_offset += (size_t)s->input_pos_;
+  }
+  s->input_pos_ = 0;
+  s->last_processed_pos_ = 0;
+  s->last_flush_pos_ = 0;
+  s->num_commands_ = 0;
+  s->num_literals_ = 0;
+  s->last_insert_len_ = 0;
+  s->prev_byte_ = 0;
+  s->prev_byte2_ = 0;
+  RingBufferReset(&s->ringbuffer_);
+  ResetHasher(s);
+  if (s->one_pass_arena_) InitCommandPrefixCodes(s->one_pass_arena_);
+  s->flint_ = BROTLI_FLINT_NEEDS_2_BYTES;
+  s->dist_cache_[0] = -16;
+  s->dist_cache_[1] = -16;
+  s->dist_cache_[2] = -16;
+  s->dist_cache_[3] = -16;
+  memcpy(s->saved_dist_cache_, s->dist_cache_, sizeof(s->saved_dist_cache_));
+}
+
+/* Passes input to CompressStreamData up to the next cut point, and flushes
+   the stream there. Scanned input is counted in |chunk_ahead_| until it is
+   consumed. */
+static BROTLI_BOOL CompressChunks(
+    BrotliEncoderState* s, BrotliEncoderOperation op, size_t* available_in,
+    const uint8_t** next_in, size_t* available_out, uint8_t** next_out,
+    size_t* total_out) {
+  if (*available_in < s->chunk_ahead_) return BROTLI_FALSE;
+  while (BROTLI_TRUE) {
+    size_t ahead;
+    if (!s->chunk_cut_ && s->chunk_ahead_ < *available_in) {
+      s->chunk_ahead_ += ScanChunk(s, *next_in + s->chunk_ahead_,
+          *available_in - s->chunk_ahead_);
+      /* Last chunk is finished anyway. */
+      if (s->chunk_cut_ && op == BROTLI_OPERATION_FINISH &&
+          s->chunk_ahead_ == *available_in) {
+        s->chunk_cut_ = BROTLI_FALSE;
+      }
+    }
+    ahead = s->chunk_ahead_;
+    if (!CompressStreamData(s, s->chunk_cut_ ? BROTLI_OPERATION_FLUSH : op,
+        &ahead, next_in, available_out, next_out, total_out)) {
+      return BROTLI_FALSE;
+    }
+    *available_in -= s->chunk_ahead_ - ahead;
+    s->chunk_ahead_ = ahead;
+    if (!s->chunk_cut_ || ahead != 0 || s->available_out_ != 0 ||
+        s->stream_state_ != BROTLI_STREAM_PROCESSING) {
+      return BROTLI_TRUE;
+    }
+    s->chunk_cut_ = BROTLI_FALSE;
+    if (s->params.independent_chunks) RestartChunk(s);
+  }
+}
+
+BROTLI_BOOL BrotliEncoderCompressStream(
+    BrotliEncoderState* s, BrotliEncoderOperation op, size_t* available_in,
+    const uint8_t** next_in, size_t* available_out,uint8_t** next_out,
+    size_t* total_out) {
+  if (!s->is_initialized_ && s->params.mode == BROTLI_MODE_AUTO) {
+    ApplyContentPreset(s, op, *available_in, *next_in);
+  }
+  if (!EnsureInitialized(s)) return BROTLI_FALSE;
+
+  if (s->params.declare_size && s->size_stage_ != BROTLI_SIZE_DONE &&
+      op != BROTLI_OPERATION_EMIT_METADATA) {
+    if (!DeclareSize(s, op, *available_in, available_out, next_out,
+        total_out)) {
+      return BROTLI_FALSE;
+    }
+    if (s->size_stage_ != BROTLI_SIZE_DONE) return BROTLI_TRUE;
+  }
+  if (op == BROTLI_OPERATION_FINISH && s->params.fragment) {
+    return FinishFragment(
+        s, available_in, next_in, available_out, next_out, total_out);
+  }
+  if (op == BROTLI_OPERATION_FINISH && s->params.checksum == 2 &&
+      s->checksum_stage_ != BROTLI_CHECKSUM_EMITTED) {
+    return FinishWithChecksum(
+        s, available_in, next_in, available_out, next_out, total_out);
+  }
+
+  /* Unfinished metadata block; check requirements. */
+  if (s->remaining_metadata_bytes_ != BROTLI_UINT32_MAX) {
+    if (*available_in != s->remaining_metadata_bytes_) return BROTLI_FALSE;
+    if (op != BROTLI_OPERATION_EMIT_METADATA) return BROTLI_FALSE;
+  }
+
+  if (op == BROTLI_OPERATION_EMIT_METADATA) {
+    UpdateSizeHint(s, 0);  /* First data metablock might be emitted here. */
+    return ProcessMetadata(
+        s, available_in, next_in, available_out, next_out, total_out);
+  }
+
+  if (s->params.chunk_bits != 0) {
+    return CompressChunks(
+        s, op, available_in, next_in, available_out, next_out, total_out);
+  }
+  return CompressStreamData(
+      s, op, available_in, next_in, available_out, next_out, total_out);
+}
+
 BROTLI_BOOL BrotliEncoderIsFinished(BrotliEncoderState* s) {
   return TO_BROTLI_BOOL(s->stream_state_ == BROTLI_STREAM_FINISHED &&
       !BrotliEncoderHasMoreOutput(s));
@@ -1950,6 +3434,93 @@ BROTLI_BOOL BrotliEncoderHasMoreOutput(BrotliEncoderState* s) {
   return TO_BROTLI_BOOL(s->available_out_ != 0);
 }
 
+uint64_t BrotliEncoderGetStoredIncompressibleBytes(
+    const BrotliEncoderState* s) {
+  return s->stored_incompressible_bytes_;
+}
+
+size_t BrotliEncoderGetStats(const BrotliEncoderState* s, size_t size,
+    uint64_t* stats) {
+  size_t n = BROTLI_MIN(size_t, size, BROTLI_ENCODER_NUM_STATS);
+  if (n != 0) memcpy(stats, s->stats_, n * sizeof(stats[0]));
+  return n;
+}
+
+uint32_t BrotliEncoderGetChecksum(const BrotliEncoderState* s) {
+  return s->checksum_;
+}
+
+BROTLI_BOOL BrotliEncoderReleaseIdleMemory(BrotliEncoderState* s) {
+  if (BROTLI_IS_OOM(&s->memory_manager_)) return BROTLI_FALSE;
+  if (!IsIdle(s)) return BROTLI_FALSE;
+  ReleaseIdleMemory(s, BROTLI_TRUE);
+  return BROTLI_TRUE;
+}
+
+BrotliEncoderState* BrotliEncoderForkInstance(const BrotliEncoderState* s,
+    brotli_alloc_func alloc_func, brotli_free_func free_func, void* opaque) {
+  const SharedEncoderDictionary* dict = &s->params.dictionary;
+  BrotliEncoderState* fork;
+  MemoryManager* m;
+  if (BROTLI_IS_OOM(&s->memory_manager_)) return 0;
+  /* Instance that has not started yet is idle as well. */
+  if (s->is_initialized_ && !IsIdle(s)) return 0;
+  /* Input read in place belongs to the caller of the original. */
+  if (s->linear_input_ != NULL) return 0;
+  /* Dictionary data is owned by the instance it is attached to. */
+  if (dict->compound.num_chunks != 0 || dict->contextual.num_instances_ != 1 ||
+      dict->contextual.instance_.hash_table_data_words_ != NULL) {
+    return 0;
+  }
+  fork = (BrotliEncoderState*)BrotliBootstrapAlloc(
+      sizeof(BrotliEncoderState), alloc_func, free_func, opaque);
+  if (fork == NULL) return 0;
+  memcpy(fork, s, sizeof(BrotliEncoderState));
+  m = &fork->memory_manager_;
+  BrotliInitMemoryManager(m, alloc_func, free_func, opaque);
+  BrotliInitSharedEncoderDictionary(&fork->params.dictionary);
+  fork->params.dictionary.max_quality = dict->max_quality;
+
+  /* Scratch buffers are allocated again on demand. */
+  fork->storage_size_ = 0;
+  fork->storage_ = 0;
+  fork->next_out_ = NULL;
+  fork->commands_ = 0;
+  fork->cmd_alloc_size_ = 0;
+  BrotliInitZopfliArena(&fork->zopfli_arena_);
+  fork->large_table_ = NULL;
+  fork->large_table_size_ = 0;
+  fork->command_buf_ = NULL;
+  fork->literal_buf_ = NULL;
+  fork->one_pass_arena_ = NULL;
+  fork->two_pass_arena_ = NULL;
+  HasherInit(&fork->hasher_);
+
+  /* Fast qualities keep the prefix codes of the next block in the arenas. */
+  if (s->one_pass_arena_) {
+    fork->one_pass_arena_ = BROTLI_ALLOC(m, BrotliOnePassArena, 1);
+    if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(fork->one_pass_arena_)) goto oom;
+    memcpy(fork->one_pass_arena_, s->one_pass_arena_,
+        sizeof(BrotliOnePassArena));
+  }
+  if (s->two_pass_arena_) {
+    fork->two_pass_arena_ = BROTLI_ALLOC(m, BrotliTwoPassArena, 1);
+    if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(fork->two_pass_arena_)) goto oom;
+    memcpy(fork->two_pass_arena_, s->two_pass_arena_,
+        sizeof(BrotliTwoPassArena));
+  }
+  RingBufferCopy(m, &fork->ringbuffer_, &s->ringbuffer_);
+  if (BROTLI_IS_OOM(m)) goto oom;
+  HasherCopy(m, &fork->hasher_, &s->hasher_, &fork->params);
+  if (BROTLI_IS_OOM(m)) goto oom;
+  BROTLI_PROBE1(encoder_create, fork);
+  return fork;
+
+oom:
+  BrotliEncoderDestroyInstance(fork);
+  return 0;
+}
+
 const uint8_t* BrotliEncoderTakeOutput(BrotliEncoderState* s, size_t* size) {
   size_t consumed_size = s->available_out_;
   uint8_t* result = s->next_out_;
@@ -1989,7 +3560,8 @@ BrotliEncoderPreparedDictionary* BrotliEncoderPrepareDictionary(
   }
   if (type == BROTLI_SHARED_DICTIONARY_RAW) {
     managed_dictionary->dictionary = (uint32_t*)CreatePreparedDictionary(
-        &managed_dictionary->memory_manager_, data, size);
+        &managed_dictionary->memory_manager_, data, size, quality,
+        BROTLI_FALSE);
   } else {
     SharedEncoderDictionary* dict = (SharedEncoderDictionary*)BrotliAllocate(
         &managed_dictionary->memory_manager_, sizeof(SharedEncoderDictionary));
@@ -2010,6 +3582,23 @@ BrotliEncoderPreparedDictionary* BrotliEncoderPrepareDictionary(
   return (BrotliEncoderPreparedDictionary*)managed_dictionary;
 }
 
+BrotliEncoderPreparedDictionary* BrotliEncoderPrepareLeanDictionary(
+    size_t size, const uint8_t data[BROTLI_ARRAY_PARAM(size)], int quality,
+    brotli_alloc_func alloc_func, brotli_free_func free_func, void* opaque) {
+  ManagedDictionary* managed_dictionary =
+      BrotliCreateManagedDictionary(alloc_func, free_func, opaque);
+  if (managed_dictionary == NULL) {
+    return NULL;
+  }
+  managed_dictionary->dictionary = (uint32_t*)CreatePreparedDictionary(
+      &managed_dictionary->memory_manager_, data, size, quality, BROTLI_TRUE);
+  if (managed_dictionary->dictionary == NULL) {
+    BrotliDestroyManagedDictionary(managed_dictionary);
+    return NULL;
+  }
+  return (BrotliEncoderPreparedDictionary*)managed_dictionary;
+}
+
 void BrotliEncoderDestroyPreparedDictionary(
     BrotliEncoderPreparedDictionary* dictionary) {
   ManagedDictionary* dict = (ManagedDictionary*)dictionary;
@@ -2019,20 +3608,8 @@ void BrotliEncoderDestroyPreparedDictionary(
   if (dict->magic != kManagedDictionaryMagic) {
     return;
   }
-  if (dict->dictionary == NULL) {
-    /* This should never ever happen. */
-  } else if (*dict->dictionary == kPreparedDictionaryMagic) {
-    DestroyPreparedDictionary(
-        &dict->memory_manager_, (PreparedDictionary*)dict->dictionary);
-  } else if (*dict->dictionary == kSharedDictionaryMagic) {
-    BrotliCleanupSharedEncoderDictionary(&dict->memory_manager_,
-        (SharedEncoderDictionary*)dict->dictionary);
-    BrotliFree(&dict->memory_manager_, dict->dictionary);
-  } else {
-    /* This should never ever happen. */
-  }
-  dict->dictionary = NULL;
-  BrotliDestroyManagedDictionary(dict);
+  /* Encoders it is attached to hold their own references. */
+  BrotliReleaseManagedDictionary(dict);
 }
 
 BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(BrotliEncoderState* state,
@@ -2040,15 +3617,20 @@ BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(BrotliEncoderState* state,
   /* First field of dictionary structs */
   const BrotliEncoderPreparedDictionary* dict = dictionary;
   uint32_t magic = *((const uint32_t*)dict);
-  SharedEncoderDictionary* current = NULL;
+  SharedEncoderDictionary* current = &state->params.dictionary;
+  ManagedDictionary* managed_dictionary = NULL;
   if (magic == kManagedDictionaryMagic) {
-    /* Unwrap managed dictionary. */
-    ManagedDictionary* managed_dictionary = (ManagedDictionary*)dict;
+    /* Unwrap managed dictionary; it is kept alive while attached, however
+       its creator disposes of it. */
+    managed_dictionary = (ManagedDictionary*)dict;
+    if (current->num_managed_ == SHARED_BROTLI_MAX_COMPOUND_DICTS + 1) {
+      return BROTLI_FALSE;
+    }
     magic = *managed_dictionary->dictionary;
     dict = (BrotliEncoderPreparedDictionary*)managed_dictionary->dictionary;
   }
-  current = &state->params.dictionary;
-  if (magic == kPreparedDictionaryMagic) {
+  if (magic == kPreparedDictionaryMagic ||
+      magic == kLeanPreparedDictionaryMagic) {
     const PreparedDictionary* prepared = (const PreparedDictionary*)dict;
     if (!AttachPreparedDictionary(&current->compound, prepared)) {
       return BROTLI_FALSE;
@@ -2070,6 +3652,12 @@ BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(BrotliEncoderState* state,
         kStaticDictionaryHashLengths;
     size_t i;
     if (state->is_initialized_) return BROTLI_FALSE;
+    /* Nothing is attached unless all of it is. */
+    if (!new_default && !was_default) return BROTLI_FALSE;
+    if (current->compound.num_chunks + attached->compound.num_chunks >
+        SHARED_BROTLI_MAX_COMPOUND_DICTS) {
+      return BROTLI_FALSE;
+    }
     current->max_quality =
         BROTLI_MIN(int, current->max_quality, attached->max_quality);
     for (i = 0; i < attached->compound.num_chunks; i++) {
@@ -2079,7 +3667,6 @@ BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(BrotliEncoderState* state,
       }
     }
     if (!new_default) {
-      if (!was_default) return BROTLI_FALSE;
       /* Copy by value, but then set num_instances_ to 0 because their memory
       is managed by attached, not by current */
       current->contextual = attached->contextual;
@@ -2088,6 +3675,88 @@ BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(BrotliEncoderState* state,
   } else {
     return BROTLI_FALSE;
   }
+  /* Referenced only once attached, so failures leave no reference behind. */
+  if (managed_dictionary != NULL) {
+    BrotliRetainManagedDictionary(managed_dictionary);
+    current->managed_[current->num_managed_++] = managed_dictionary;
+  }
+  return BROTLI_TRUE;
+}
+
+BROTLI_BOOL BrotliEncoderPrimeWindow(BrotliEncoderState* state,
+    size_t size, const uint8_t data[BROTLI_ARRAY_PARAM(size)]) {
+  MemoryManager* m = &state->memory_manager_;
+  size_t max_backward;
+  if (state->params.stream_offset == 0 || state->params.fragment ||
+      state->linear_input_) {
+    return BROTLI_FALSE;
+  }
+  if (!EnsureInitialized(state)) return BROTLI_FALSE;
+  if (state->input_pos_ != 0 || state->available_out_ != 0 ||
+      state->stream_state_ != BROTLI_STREAM_PROCESSING) {
+    return BROTLI_FALSE;
+  }
+  max_backward = BROTLI_MAX_BACKWARD_LIMIT(state->params.lgwin);
+  if (size > max_backward) {
+    data += size - max_backward;
+    size = max_backward;
+  }
+  /* Window can not reach before the stream start. Literal context depends on
+     the last 2 bytes, so those are required unless stream is shorter. */
+  if (size > state->params.stream_offset ||
+      (size < 2 && size < state->params.stream_offset)) {
+    return BROTLI_FALSE;
+  }
+  /* Size is never declared for a stream part. */
+  state->size_stage_ = BROTLI_SIZE_DONE;
+  /* Fast qualities do not look back past the current block. */
+  if (state->params.quality == FAST_ONE_PASS_COMPRESSION_QUALITY ||
+      state->params.quality == FAST_TWO_PASS_COMPRESSION_QUALITY ||
+      size == 0) {
+    return BROTLI_TRUE;
+  }
+
+  AppendToRingBuffer(state, size, data);
+  if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+  HasherPrependWindow(m, &state->hasher_, state->ringbuffer_.buffer_,
+      state->ringbuffer_.mask_, &state->params, size);
+  if (BROTLI_IS_OOM(m)) return BROTLI_FALSE;
+  state->last_processed_pos_ = size;
+  state->last_flush_pos_ = size;
+  state->prev_byte_ = data[size - 1];
+  if (size > 1) state->prev_byte2_ = data[size - 2];
+  /* Window is the tail of the processed part; positions in ring buffer start
+     that much earlier, so distance limits stay the same as for the decoder. */
+  state->params.stream_offset -= size;
+  return BROTLI_TRUE;
+}
+
+BROTLI_BOOL BrotliEncoderSetProfile(BrotliEncoderState* state,
+    size_t profile_size,
+    const uint8_t profile[BROTLI_ARRAY_PARAM(profile_size)]) {
+  BrotliLiteralProfile* current = &state->params.profile;
+  size_t num_contexts;
+  size_t i;
+  if (state->is_initialized_) return BROTLI_FALSE;
+  if (profile_size == 0) {
+    current->num_contexts = 0;
+    return BROTLI_TRUE;
+  }
+  if (profile_size != BROTLI_ENCODER_PROFILE_SIZE ||
+      profile[0] != BROTLI_PROFILE_MAGIC || profile[1] != CONTEXT_UTF8) {
+    return BROTLI_FALSE;
+  }
+  num_contexts = profile[2];
+  if (num_contexts == 0 || num_contexts > BROTLI_MAX_STATIC_CONTEXTS) {
+    return BROTLI_FALSE;
+  }
+  for (i = 0; i < (1 << BROTLI_LITERAL_CONTEXT_BITS); ++i) {
+    if (profile[3 + i] >= num_contexts) return BROTLI_FALSE;
+  }
+  for (i = 0; i < (1 << BROTLI_LITERAL_CONTEXT_BITS); ++i) {
+    current->context_map[i] = profile[3 + i];
+  }
+  current->num_contexts = num_contexts;
   return BROTLI_TRUE;
 }
 
@@ -18,6 +18,13 @@
 #include "./quality.h"
 #include "./hash.h"
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" {
 #endif
@@ -466,8 +473,8 @@ static BROTLI_BOOL ComputeDictionary(MemoryManager* m, int quality,
       &current->cutoffTransformsCount, &current->cutoffTransforms);
 
   /* Only compute the data for slow encoder if the requested quality is high
-     enough to need it */
-  if (quality >= ZOPFLIFICATION_QUALITY) {
+     enough to need it; shortest-path search needs it from quality 5 on */
+  if (quality >= MIN_QUALITY_FOR_EXTENSIVE_REFERENCE_SEARCH) {
     if (!BuildDictionaryLut(m, transforms, current)) return BROTLI_FALSE;
 
     /* For the built-in Brotli transforms, there is a hard-coded function to
@@ -499,6 +506,7 @@ void BrotliInitSharedEncoderDictionary(SharedEncoderDictionary* dict) {
   dict->contextual.instance_.parent = &dict->contextual;
 
   dict->max_quality = BROTLI_MAX_QUALITY;
+  dict->num_managed_ = 0;
 }
 
 /* TODO: make sure that tooling will warn user if not all the cutoff
@@ -517,7 +525,8 @@ static BROTLI_BOOL InitCustomSharedEncoderDictionary(
 
   for (i = 0; i < (int)decoded_dict->num_prefix; i++) {
     PreparedDictionary* prepared = CreatePreparedDictionary(m,
-        decoded_dict->prefix[i], decoded_dict->prefix_size[i]);
+        decoded_dict->prefix[i], decoded_dict->prefix_size[i],
+        BROTLI_MAX_QUALITY, BROTLI_FALSE);
     AttachPreparedDictionary(compound, prepared);
     /* remember for cleanup */
     compound->prepared_instances_[
@@ -602,6 +611,10 @@ void BrotliCleanupSharedEncoderDictionary(MemoryManager* m,
     }
     BrotliFree(m, dict->contextual.instances_);
   }
+  for (i = 0; i < dict->num_managed_; i++) {
+    BrotliReleaseManagedDictionary(dict->managed_[i]);
+  }
+  dict->num_managed_ = 0;
 }
 
 ManagedDictionary* BrotliCreateManagedDictionary(
@@ -614,6 +627,7 @@ ManagedDictionary* BrotliCreateManagedDictionary(
   BrotliInitMemoryManager(
       &result->memory_manager_, alloc_func, free_func, opaque);
   result->dictionary = NULL;
+  result->refcount_ = 1;
 
   return result;
 }
@@ -623,6 +637,79 @@ void BrotliDestroyManagedDictionary(ManagedDictionary* dictionary) {
   BrotliBootstrapFree(dictionary, &dictionary->memory_manager_);
 }
 
+#if defined(_WIN32)
+static long RefcountAdd(long* refcount, long delta) {
+  return InterlockedExchangeAdd((volatile LONG*)refcount, delta) + delta;
+}
+#elif BROTLI_GNUC_HAS_BUILTIN(__atomic_add_fetch, 4, 7, 0)
+static long RefcountAdd(long* refcount, long delta) {
+  /* Release of the last reference acquires the writes of the others. */
+  return __atomic_add_fetch(refcount, delta, __ATOMIC_ACQ_REL);
+}
+#else
+static pthread_mutex_t refcount_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long RefcountAdd(long* refcount, long delta) {
+  long result;
+  pthread_mutex_lock(&refcount_mutex);
+  result = (*refcount += delta);
+  pthread_mutex_unlock(&refcount_mutex);
+  return result;
+}
+#endif
+
+void BrotliRetainManagedDictionary(ManagedDictionary* dictionary) {
+  RefcountAdd(&dictionary->refcount_, 1);
+}
+
+void BrotliReleaseManagedDictionary(ManagedDictionary* dictionary) {
+  MemoryManager* m = &dictionary->memory_manager_;
+  if (RefcountAdd(&dictionary->refcount_, -1) != 0) return;
+  if (dictionary->dictionary == NULL) {
+    /* This should never ever happen. */
+  } else if (*dictionary->dictionary == kPreparedDictionaryMagic ||
+             *dictionary->dictionary == kLeanPreparedDictionaryMagic) {
+    DestroyPreparedDictionary(m, (PreparedDictionary*)dictionary->dictionary);
+  } else if (*dictionary->dictionary == kSharedDictionaryMagic) {
+    BrotliCleanupSharedEncoderDictionary(m,
+        (SharedEncoderDictionary*)dictionary->dictionary);
+    BrotliFree(m, dictionary->dictionary);
+  } else {
+    /* This should never ever happen. */
+  }
+  dictionary->dictionary = NULL;
+  BrotliDestroyManagedDictionary(dictionary);
+}
+
+#if defined(_WIN32)
+static INIT_ONCE hash_table_once = INIT_ONCE_STATIC_INIT;
+static INIT_ONCE lut_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK RunStaticInit(PINIT_ONCE once, PVOID init, PVOID* ctx) {
+  BROTLI_UNUSED(once);
+  BROTLI_UNUSED(ctx);
+  ((void (*)(void))init)();
+  return TRUE;
+}
+
+void BrotliEncoderLazyStaticInit(BROTLI_BOOL slow) {
+  InitOnceExecuteOnce(&hash_table_once, RunStaticInit,
+      (PVOID)BrotliInitStaticDictionaryHash, NULL);
+  if (slow) {
+    InitOnceExecuteOnce(&lut_once, RunStaticInit,
+        (PVOID)BrotliInitStaticDictionaryLut, NULL);
+  }
+}
+#else
+static pthread_once_t hash_table_once = PTHREAD_ONCE_INIT;
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+
+void BrotliEncoderLazyStaticInit(BROTLI_BOOL slow) {
+  pthread_once(&hash_table_once, BrotliInitStaticDictionaryHash);
+  if (slow) pthread_once(&lut_once, BrotliInitStaticDictionaryLut);
+}
+#endif
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
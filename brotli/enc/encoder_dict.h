@@ -106,6 +106,8 @@ typedef struct ContextualEncoderDictionary {
 static const uint32_t kSharedDictionaryMagic = 0xDEBCEDE1;
 static const uint32_t kManagedDictionaryMagic = 0xDEBCEDE2;
 
+struct ManagedDictionary;
+
 typedef struct SharedEncoderDictionary {
   /* Magic value to distinguish this struct from PreparedDictionary for
      certain external usages. */
@@ -119,12 +121,21 @@ typedef struct SharedEncoderDictionary {
 
   /* The maximum quality the dictionary was computed for */
   int max_quality;
+
+  /* Managed dictionaries attached to the encoder: 1 serialized and up to 15
+     raw ones. Their data is referenced, so they are retained until cleanup. */
+  size_t num_managed_;
+  struct ManagedDictionary* managed_[SHARED_BROTLI_MAX_COMPOUND_DICTS + 1];
 } SharedEncoderDictionary;
 
+/* Prepared dictionary is immutable once created, so it is shared by encoders
+   without copying. Creator holds one reference, and each encoder that it is
+   attached to holds another; the last release destroys it. */
 typedef struct ManagedDictionary {
   uint32_t magic;
   MemoryManager memory_manager_;
   uint32_t* dictionary;
+  long refcount_;
 } ManagedDictionary;
 
 /* Initializes to the brotli built-in dictionary */
@@ -147,6 +158,16 @@ BROTLI_INTERNAL ManagedDictionary* BrotliCreateManagedDictionary(
 BROTLI_INTERNAL void BrotliDestroyManagedDictionary(
     ManagedDictionary* dictionary);
 
+/* Thread-safe; any thread may release the last reference. */
+BROTLI_INTERNAL void BrotliRetainManagedDictionary(
+    ManagedDictionary* dictionary);
+BROTLI_INTERNAL void BrotliReleaseManagedDictionary(
+    ManagedDictionary* dictionary);
+
+/* Builds the tables of the built-in dictionary from their compact form, on
+   first call; |slow| also builds the ones of the slow encoder. Thread-safe. */
+BROTLI_INTERNAL void BrotliEncoderLazyStaticInit(BROTLI_BOOL slow);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
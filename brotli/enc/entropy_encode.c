@@ -53,6 +53,45 @@ static BROTLI_INLINE BROTLI_BOOL SortHuffmanTree(
   return TO_BROTLI_BOOL(v0->index_right_or_value_ > v1->index_right_or_value_);
 }
 
+/* Leaf counts above this use radix sort instead of Shell sort. */
+#define BROTLI_HUFFMAN_RADIX_SORT_MIN 64
+
+/* Sorts leaves by count, least popular first, keeping the input order of
+   equal counts. Leaves come in descending symbol order, so the result is
+   the one of SortHuffmanTree. LSD radix sort by bytes of the count; bytes
+   above the top one of max_count, and bytes equal in all counts, cost no
+   pass. scratch holds n nodes. */
+static void SortHuffmanLeavesRadix(HuffmanTree* items, HuffmanTree* scratch,
+                                   size_t n, uint32_t max_count) {
+  HuffmanTree* src = items;
+  HuffmanTree* dst = scratch;
+  uint32_t shift;
+  for (shift = 0; shift < 32 && (max_count >> shift) != 0; shift += 8) {
+    size_t offsets[256];
+    size_t sum = 0;
+    size_t i;
+    memset(offsets, 0, sizeof(offsets));
+    for (i = 0; i < n; ++i) {
+      ++offsets[(src[i].total_count_ >> shift) & 0xFF];
+    }
+    if (offsets[(src[0].total_count_ >> shift) & 0xFF] == n) continue;
+    for (i = 0; i < 256; ++i) {
+      size_t count = offsets[i];
+      offsets[i] = sum;
+      sum += count;
+    }
+    for (i = 0; i < n; ++i) {
+      dst[offsets[(src[i].total_count_ >> shift) & 0xFF]++] = src[i];
+    }
+    {
+      HuffmanTree* tmp = src;
+      src = dst;
+      dst = tmp;
+    }
+  }
+  if (src != items) memcpy(items, src, n * sizeof(items[0]));
+}
+
 /* This function will create a Huffman tree.
 
    The catch here is that the tree cannot be arbitrarily deep.
@@ -85,11 +124,15 @@ void BrotliCreateHuffmanTree(const uint32_t* data,
     size_t i;
     size_t j;
     size_t k;
+    uint32_t min_count = BROTLI_UINT32_MAX;
+    uint32_t max_count = 0;
     for (i = length; i != 0;) {
       --i;
       if (data[i]) {
         const uint32_t count = BROTLI_MAX(uint32_t, data[i], count_limit);
         InitHuffmanTree(&tree[n++], count, -1, (int16_t)i);
+        min_count = BROTLI_MIN(uint32_t, min_count, count);
+        max_count = BROTLI_MAX(uint32_t, max_count, count);
       }
     }
 
@@ -98,7 +141,12 @@ void BrotliCreateHuffmanTree(const uint32_t* data,
       break;
     }
 
-    SortHuffmanTreeItems(tree, n, SortHuffmanTree);
+    if (n < BROTLI_HUFFMAN_RADIX_SORT_MIN) {
+      SortHuffmanTreeItems(tree, n, SortHuffmanTree);
+    } else {
+      /* Parent nodes are not built yet; their slots are free. */
+      SortHuffmanLeavesRadix(tree, &tree[n], n, max_count);
+    }
 
     /* The nodes are:
        [0, n): the sorted leaf nodes that we start with.
@@ -146,6 +194,9 @@ void BrotliCreateHuffmanTree(const uint32_t* data,
          successful, add fake entities to the lowest values and retry. */
       break;
     }
+    /* Limits that do not exceed the smallest count give the same tree and
+       would fail the same way; skip them. */
+    while (count_limit <= min_count / 2) count_limit *= 2;
   }
 }
 
@@ -12,17 +12,78 @@
 #include "../common/platform.h"
 #include <brotli/types.h>
 
+#if defined(BROTLI_TZCNT64) && BROTLI_64_BITS && BROTLI_LITTLE_ENDIAN
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BROTLI_MATCH_VECTOR_SIZE 32
+#elif defined(BROTLI_TARGET_X64)
+#include <emmintrin.h>
+#define BROTLI_MATCH_VECTOR_SIZE 16
+#elif defined(BROTLI_TARGET_NEON) && defined(BROTLI_TARGET_ARMV8_64)
+#include <arm_neon.h>
+#define BROTLI_MATCH_VECTOR_SIZE 16
+#endif
+#endif
+
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" {
 #endif
 
 /* Separate implementation for little-endian 64-bit targets, for speed. */
 #if defined(BROTLI_TZCNT64) && BROTLI_64_BITS && BROTLI_LITTLE_ENDIAN
+
+#if defined(BROTLI_MATCH_VECTOR_SIZE)
+/* Returns the number of equal leading bytes in the next
+   BROTLI_MATCH_VECTOR_SIZE bytes of s1 and s2. SSE2 and NEON are baseline
+   on x86-64 and AArch64, so no runtime dispatch is required; AVX2 is used
+   only when the whole library is built for it. */
+static BROTLI_INLINE size_t FindMatchLengthVector(const uint8_t* s1,
+                                                  const uint8_t* s2) {
+#if defined(__AVX2__)
+  __m256i a = _mm256_loadu_si256((const __m256i*)(const void*)s1);
+  __m256i b = _mm256_loadu_si256((const __m256i*)(const void*)s2);
+  uint32_t mismatch = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+  if (mismatch == 0) return 32;
+  return (size_t)BROTLI_TZCNT64(mismatch);
+#elif defined(BROTLI_TARGET_X64)
+  __m128i a = _mm_loadu_si128((const __m128i*)(const void*)s1);
+  __m128i b = _mm_loadu_si128((const __m128i*)(const void*)s2);
+  uint32_t mismatch =
+      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xFFFFu;
+  if (mismatch == 0) return 16;
+  return (size_t)BROTLI_TZCNT64(mismatch);
+#else
+  uint8x16_t eq = vceqq_u8(vld1q_u8(s1), vld1q_u8(s2));
+  /* Narrow to 4 bits per byte. */
+  uint64_t mismatch = ~vget_lane_u64(vreinterpret_u64_u8(
+      vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+  if (mismatch == 0) return 16;
+  return (size_t)BROTLI_TZCNT64(mismatch) >> 2;
+#endif
+}
+#endif  /* BROTLI_MATCH_VECTOR_SIZE */
+
 static BROTLI_INLINE size_t FindMatchLengthWithLimit(const uint8_t* s1,
                                                      const uint8_t* s2,
                                                      size_t limit) {
   size_t matched = 0;
-  size_t limit2 = (limit >> 3) + 1;  /* + 1 is for pre-decrement in while */
+  size_t limit2;
+#if defined(BROTLI_MATCH_VECTOR_SIZE)
+  /* Most matches end within the first 8 bytes; only longer ones pay for
+     vector compare. */
+  if (limit >= 8 + BROTLI_MATCH_VECTOR_SIZE &&
+      BROTLI_UNALIGNED_LOAD64LE(s2) == BROTLI_UNALIGNED_LOAD64LE(s1)) {
+    matched = 8;
+    do {
+      size_t n = FindMatchLengthVector(s1 + matched, s2 + matched);
+      matched += n;
+      if (n != BROTLI_MATCH_VECTOR_SIZE) return matched;
+    } while (matched + BROTLI_MATCH_VECTOR_SIZE <= limit);
+    s2 += matched;
+    limit -= matched;
+  }
+#endif
+  limit2 = (limit >> 3) + 1;  /* + 1 is for pre-decrement in while */
   while (BROTLI_PREDICT_TRUE(--limit2)) {
     if (BROTLI_PREDICT_FALSE(BROTLI_UNALIGNED_LOAD64LE(s2) ==
                       BROTLI_UNALIGNED_LOAD64LE(s1 + matched))) {
@@ -11,7 +11,7 @@
 #define BROTLI_ENC_HASH_H_
 
 #include <stdlib.h>  /* exit */
-#include <string.h>  /* memcmp, memset */
+#include <string.h>  /* memcmp, memcpy, memset */
 
 #include "../common/constants.h"
 #include "../common/dictionary.h"
@@ -34,6 +34,8 @@ typedef struct {
    * "composite" hasher uses up to 4 allocations.
    */
   void* extra[4];
+  /* Sizes of "extra" allocations, in bytes. */
+  size_t extra_size[4];
 
   /**
    * False before the fisrt invocation of HasherSetup (where "extra" memory)
@@ -114,6 +116,15 @@ static BROTLI_INLINE void PrepareDistanceCache(
 /* Score must be positive after applying maximal penalty. */
 #define BROTLI_SCORE_BASE (BROTLI_DISTANCE_BIT_PENALTY * 8 * sizeof(size_t))
 
+/* Hashers that keep buckets in big tables prefetch the bucket of the position
+   this many bytes ahead, to hide the latency of cache misses behind the match
+   search of the current position. */
+#define BROTLI_HASHER_PREFETCH_DISTANCE 8
+
+/* StoreRange of those hashers computes keys (and prefetches buckets) for this
+   many positions at once, before the table is updated. */
+#define BROTLI_HASHER_STORE_BATCH 8
+
 /* Usually, we always choose the longest backward reference. This function
    allows for the exception of that rule.
 
@@ -238,6 +249,79 @@ static BROTLI_INLINE size_t BackwardMatchLengthCode(const BackwardMatch* self) {
   return code ? code : BackwardMatchLength(self);
 }
 
+/* FindAllMatches of chain hashers returns up to that many matches of the
+   window; a longer match found after that replaces the last one. */
+#define MAX_NUM_CHAIN_MATCHES 32
+
+/* Appends matches of 2 and 3 bytes up to 16 bytes back, that hash chains do
+   not keep, to |*matches|; returns the length of the longest one, or 1. */
+static BROTLI_INLINE size_t FindNearMatches(const uint8_t* BROTLI_RESTRICT data,
+    const size_t ring_buffer_mask, const size_t cur_ix,
+    const size_t max_length, const size_t max_backward,
+    BackwardMatch** matches) {
+  const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
+  const size_t stop = (cur_ix < 16) ? 0 : cur_ix - 16;
+  size_t best_len = 1;
+  size_t i;
+  for (i = cur_ix - 1; i > stop && best_len <= 2; --i) {
+    size_t prev_ix = i;
+    const size_t backward = cur_ix - prev_ix;
+    if (BROTLI_PREDICT_FALSE(backward > max_backward)) break;
+    prev_ix &= ring_buffer_mask;
+    if (data[cur_ix_masked] != data[prev_ix] ||
+        data[cur_ix_masked + 1] != data[prev_ix + 1]) {
+      continue;
+    }
+    {
+      const size_t len = FindMatchLengthWithLimit(&data[prev_ix],
+          &data[cur_ix_masked], max_length);
+      if (len > best_len) {
+        best_len = len;
+        InitBackwardMatch((*matches)++, backward, len);
+      }
+    }
+  }
+  return best_len;
+}
+
+/* Appends the match of |len| bytes at |backward| to chain hasher matches
+   that start at |first|. */
+static BROTLI_INLINE void AddChainMatch(BackwardMatch* first,
+    BackwardMatch** matches, size_t backward, size_t len) {
+  if (*matches - first == MAX_NUM_CHAIN_MATCHES) --(*matches);
+  InitBackwardMatch((*matches)++, backward, len);
+}
+
+/* Appends static dictionary matches longer than |best_len| to |*matches|. */
+static BROTLI_INLINE void FindAllStaticDictionaryMatches(
+    const BrotliEncoderDictionary* dictionary, const uint8_t* data,
+    size_t best_len, size_t max_length, size_t dictionary_distance,
+    size_t max_distance, BackwardMatch** matches) {
+  uint32_t dict_matches[BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN + 1];
+  const size_t minlen = BROTLI_MAX(size_t, 4, best_len + 1);
+  const size_t maxlen =
+      BROTLI_MIN(size_t, BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN, max_length);
+  size_t l;
+  /* Longer matches are out of the dictionary reach. */
+  if (best_len >= BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN) return;
+  for (l = 0; l <= BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN; ++l) {
+    dict_matches[l] = kInvalidMatch;
+  }
+  if (!BrotliFindAllStaticDictionaryMatches(dictionary, data, minlen,
+      max_length, &dict_matches[0])) {
+    return;
+  }
+  for (l = minlen; l <= maxlen; ++l) {
+    uint32_t dict_id = dict_matches[l];
+    if (dict_id < kInvalidMatch) {
+      size_t distance = dictionary_distance + (dict_id >> 5) + 1;
+      if (distance <= max_distance) {
+        InitDictionaryBackwardMatch((*matches)++, distance, l, dict_id & 31);
+      }
+    }
+  }
+}
+
 #define EXPAND_CAT(a, b) CAT(a, b)
 #define CAT(a, b) a ## b
 #define FN(X) EXPAND_CAT(X, HASHER())
@@ -391,6 +475,8 @@ static BROTLI_INLINE size_t BackwardMatchLengthCode(const BackwardMatch* self) {
 #define FOR_COMPOSITE_HASHERS(H) H(35) H(55) H(65)
 #define FOR_GENERIC_HASHERS(H) FOR_SIMPLE_HASHERS(H) FOR_COMPOSITE_HASHERS(H)
 #define FOR_ALL_HASHERS(H) FOR_GENERIC_HASHERS(H) H(10)
+/* Hashers with FindAllMatches, for the shortest-path search. */
+#define FOR_SHORTEST_PATH_HASHERS(H) H(5) H(6) H(40) H(41) H(42) H(10)
 
 typedef struct {
   HasherCommon common;
@@ -445,12 +531,26 @@ static BROTLI_INLINE void HasherSetup(MemoryManager* m, Hasher* hasher,
     size_t alloc_size[4] = {0};
     size_t i;
     ChooseHasher(params, &params->hasher);
+    /* Only H10 and the shortest-path chains look words up in the LUT of
+       the built-in dictionary. */
+    BrotliEncoderLazyStaticInit(TO_BROTLI_BOOL(
+        params->hasher.type == 10 || UsesShortestPath(params)));
     hasher->common.params = params->hasher;
     hasher->common.dict_num_lookups = 0;
     hasher->common.dict_num_matches = 0;
     HasherSize(params, one_shot, input_size, alloc_size);
     for (i = 0; i < 4; ++i) {
+      /* Tables kept from the previous stream are reused if big enough. */
+      if (hasher->common.extra[i] != NULL) {
+        if (alloc_size[i] != 0 &&
+            hasher->common.extra_size[i] >= alloc_size[i]) {
+          continue;
+        }
+        BROTLI_FREE(m, hasher->common.extra[i]);
+      }
+      hasher->common.extra_size[i] = 0;
       if (alloc_size[i] == 0) continue;
+      hasher->common.extra_size[i] = alloc_size[i];
       hasher->common.extra[i] = BROTLI_ALLOC(m, uint8_t, alloc_size[i]);
       if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(hasher->common.extra[i])) return;
     }
@@ -485,6 +585,44 @@ static BROTLI_INLINE void HasherSetup(MemoryManager* m, Hasher* hasher,
   }
 }
 
+/* Makes |dst| an independent copy of |src|, including the hash tables;
+   |dst| must be freshly initialized. |params| are the ones of |dst| owner. */
+static BROTLI_INLINE void HasherCopy(MemoryManager* m, Hasher* dst,
+    const Hasher* src, const BrotliEncoderParams* params) {
+  size_t i;
+  if (!src->common.is_setup_) return;
+  *dst = *src;
+  HasherInit(dst);
+  for (i = 0; i < 4; ++i) {
+    size_t size = src->common.extra_size[i];
+    if (size == 0) continue;
+    dst->common.extra[i] = BROTLI_ALLOC(m, uint8_t, size);
+    if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(dst->common.extra[i])) return;
+    memcpy(dst->common.extra[i], src->common.extra[i], size);
+  }
+  /* Simple hashers only derive pointers and constants in Initialize. */
+  switch (dst->common.params.type) {
+#define REBIND_(N)                            \
+    case N:                                   \
+      InitializeH ## N(&dst->common,          \
+          &dst->privat._H ## N, params);      \
+      break;
+    FOR_SIMPLE_HASHERS(REBIND_)
+    REBIND_(10)
+#undef REBIND_
+#define REBIND_(N)                            \
+    case N:                                   \
+      RebindH ## N(&dst->common,              \
+          &dst->privat._H ## N, params);      \
+      break;
+    FOR_COMPOSITE_HASHERS(REBIND_)
+#undef REBIND_
+    default:
+      break;
+  }
+  dst->common.is_setup_ = BROTLI_TRUE;
+}
+
 static BROTLI_INLINE void InitOrStitchToPreviousBlock(
     MemoryManager* m, Hasher* hasher, const uint8_t* data, size_t mask,
     BrotliEncoderParams* params, size_t position, size_t input_size,
@@ -504,14 +642,38 @@ static BROTLI_INLINE void InitOrStitchToPreviousBlock(
   }
 }
 
+/* Sets hasher up and stores the positions of window that was just written to
+   the beginning of the ring buffer, as if it was compressed by this instance.
+   The last few positions are stored when the first block is stitched. */
+static BROTLI_INLINE void HasherPrependWindow(
+    MemoryManager* m, Hasher* hasher, const uint8_t* data, size_t mask,
+    BrotliEncoderParams* params, size_t window_size) {
+  HasherSetup(m, hasher, params, data, 0, window_size, BROTLI_FALSE);
+  if (BROTLI_IS_OOM(m)) return;
+  switch (hasher->common.params.type) {
+#define PREPEND_(N)                                                  \
+    case N: {                                                        \
+      size_t overlap = StoreLookaheadH ## N() - 1;                   \
+      if (window_size > overlap) {                                   \
+        StoreRangeH ## N(&hasher->privat._H ## N, data, mask, 0,     \
+            window_size - overlap);                                  \
+      }                                                              \
+      break;                                                         \
+    }
+    FOR_ALL_HASHERS(PREPEND_)
+#undef PREPEND_
+    default: break;
+  }
+}
+
 /* NB: when seamless dictionary-ring-buffer copies are implemented, don't forget
        to add proper guards for non-zero-BROTLI_PARAM_STREAM_OFFSET. */
 static BROTLI_INLINE void FindCompoundDictionaryMatch(
-    const PreparedDictionary* self, const uint8_t* BROTLI_RESTRICT data,
+    const PreparedDictionary* self, const uint8_t* BROTLI_RESTRICT source,
+    const uint8_t* BROTLI_RESTRICT data,
     const size_t ring_buffer_mask, const int* BROTLI_RESTRICT distance_cache,
     const size_t cur_ix, const size_t max_length, const size_t distance_offset,
     const size_t max_distance, HasherSearchResult* BROTLI_RESTRICT out) {
-  const uint32_t source_offset = self->source_offset;
   const uint32_t source_size = self->source_size;
   const size_t boundary = distance_offset - source_size;
   const uint32_t hash_bits = self->hash_bits;
@@ -525,7 +687,6 @@ static BROTLI_INLINE void FindCompoundDictionaryMatch(
   const uint32_t* slot_offsets = (uint32_t*)(&self[1]);
   const uint16_t* heads = (uint16_t*)(&slot_offsets[1u << slot_bits]);
   const uint32_t* items = (uint32_t*)(&heads[1u << bucket_bits]);
-  const uint8_t* source = (uint8_t*)(&items[source_offset]);
 
   const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
   score_t best_score = out->score;
@@ -604,11 +765,11 @@ static BROTLI_INLINE void FindCompoundDictionaryMatch(
 /* NB: when seamless dictionary-ring-buffer copies are implemented, don't forget
        to add proper guards for non-zero-BROTLI_PARAM_STREAM_OFFSET. */
 static BROTLI_INLINE size_t FindAllCompoundDictionaryMatches(
-    const PreparedDictionary* self, const uint8_t* BROTLI_RESTRICT data,
+    const PreparedDictionary* self, const uint8_t* BROTLI_RESTRICT source,
+    const uint8_t* BROTLI_RESTRICT data,
     const size_t ring_buffer_mask, const size_t cur_ix, const size_t min_length,
     const size_t max_length, const size_t distance_offset,
     const size_t max_distance, BackwardMatch* matches, size_t match_limit) {
-  const uint32_t source_offset = self->source_offset;
   const uint32_t source_size = self->source_size;
   const uint32_t hash_bits = self->hash_bits;
   const uint32_t bucket_bits = self->bucket_bits;
@@ -621,7 +782,6 @@ static BROTLI_INLINE size_t FindAllCompoundDictionaryMatches(
   const uint32_t* slot_offsets = (uint32_t*)(&self[1]);
   const uint16_t* heads = (uint16_t*)(&slot_offsets[1u << slot_bits]);
   const uint32_t* items = (uint32_t*)(&heads[1u << bucket_bits]);
-  const uint8_t* source = (uint8_t*)(&items[source_offset]);
 
   const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
   size_t best_len = min_length;
@@ -675,8 +835,8 @@ static BROTLI_INLINE void LookupCompoundDictionaryMatch(
   for (d = 0; d < addon->num_chunks; ++d) {
     /* Only one prepared dictionary type is currently supported. */
     FindCompoundDictionaryMatch(
-        (const PreparedDictionary*)addon->chunks[d], data, ring_buffer_mask,
-        distance_cache, cur_ix, max_length,
+        (const PreparedDictionary*)addon->chunks[d], addon->chunk_source[d],
+        data, ring_buffer_mask, distance_cache, cur_ix, max_length,
         base_offset - addon->chunk_offsets[d], max_distance, sr);
   }
 }
@@ -693,9 +853,10 @@ static BROTLI_INLINE size_t LookupAllCompoundDictionaryMatches(
   for (d = 0; d < addon->num_chunks; ++d) {
     /* Only one prepared dictionary type is currently supported. */
     total_found += FindAllCompoundDictionaryMatches(
-        (const PreparedDictionary*)addon->chunks[d], data, ring_buffer_mask,
-        cur_ix, min_length, max_length, base_offset - addon->chunk_offsets[d],
-        max_distance, matches + total_found, match_limit - total_found);
+        (const PreparedDictionary*)addon->chunks[d], addon->chunk_source[d],
+        data, ring_buffer_mask, cur_ix, min_length, max_length,
+        base_offset - addon->chunk_offsets[d], max_distance,
+        matches + total_found, match_limit - total_found);
     if (total_found == match_limit) break;
     if (total_found > 0) {
       min_length = BackwardMatchLength(&matches[total_found - 1]);
@@ -75,6 +75,20 @@ static void FN(Prepare)(
   FN_B(Prepare)(&self->hb, one_shot, input_size, data);
 }
 
+/* Points a bitwise copy of the hasher to the "extra" memory of |common|. */
+static void FN(Rebind)(HasherCommon* common,
+    HashComposite* BROTLI_RESTRICT self, const BrotliEncoderParams* params) {
+  self->common = common;
+  self->params = params;
+  if (self->fresh) return;
+  self->ha_common.extra[0] = common->extra[0];
+  self->ha_common.extra[1] = common->extra[1];
+  self->hb_common.extra[0] = common->extra[2];
+  self->hb_common.extra[1] = common->extra[3];
+  FN_A(Initialize)(&self->ha_common, &self->ha, params);
+  FN_B(Rebind)(&self->hb_common, &self->hb);
+}
+
 static BROTLI_INLINE void FN(HashMemAllocInBytes)(
     const BrotliEncoderParams* params, BROTLI_BOOL one_shot,
     size_t input_size, size_t* alloc_size) {
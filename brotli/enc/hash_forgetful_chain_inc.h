@@ -210,6 +210,9 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
   size_t i;
   const size_t key = FN(HashBytes)(&data[cur_ix_masked]);
   const uint8_t tiny_hash = (uint8_t)(key);
+  /* Last distances need a 2-byte match; candidates whose first 2 bytes
+     differ are rejected with one compare before the full match extension. */
+  const uint16_t cur_head = BROTLI_UNALIGNED_LOAD16LE(&data[cur_ix_masked]);
   out->len = 0;
   out->len_code_delta = 0;
   /* Try last distance first. */
@@ -222,6 +225,9 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
       continue;
     }
     prev_ix &= ring_buffer_mask;
+    if (BROTLI_UNALIGNED_LOAD16LE(&data[prev_ix]) != cur_head) {
+      continue;
+    }
     {
       const size_t len = FindMatchLengthWithLimit(&data[prev_ix],
                                                   &data[cur_ix_masked],
@@ -288,6 +294,63 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
   }
 }
 
+/* Finds all backward matches of &data[cur_ix & ring_buffer_mask] up to the
+   length of max_length, for the shortest-path search, and stores the position
+   cur_ix in the hash table. Last distances are left to the search.
+
+   Stores up to MAX_NUM_CHAIN_MATCHES matches of the window in |matches|,
+   followed by static dictionary matches; all of them are sorted by strictly
+   increasing length and (non-strictly) increasing distance. Returns the
+   number of stored matches. */
+static BROTLI_INLINE size_t FN(FindAllMatches)(
+    HashForgetfulChain* BROTLI_RESTRICT self,
+    const BrotliEncoderDictionary* dictionary,
+    const uint8_t* BROTLI_RESTRICT data, const size_t ring_buffer_mask,
+    const size_t cur_ix, const size_t max_length, const size_t max_backward,
+    const size_t dictionary_distance, const BrotliEncoderParams* params,
+    BackwardMatch* matches) {
+  BackwardMatch* const orig_matches = matches;
+  uint32_t* BROTLI_RESTRICT addr = FN(Addr)(self->extra[0]);
+  uint16_t* BROTLI_RESTRICT head = FN(Head)(self->extra[0]);
+  FN(Bank)* BROTLI_RESTRICT banks = FN(Banks)(self->extra[1]);
+  const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
+  const size_t key = FN(HashBytes)(&data[cur_ix_masked]);
+  const size_t bank = key & (NUM_BANKS - 1);
+  size_t best_len = FindNearMatches(data, ring_buffer_mask, cur_ix,
+      max_length, max_backward, &matches);
+  size_t backward = 0;
+  size_t hops = self->max_hops;
+  size_t delta = cur_ix - addr[key];
+  size_t slot = head[key];
+  while (hops-- && best_len < max_length) {
+    size_t prev_ix;
+    size_t last = slot;
+    backward += delta;
+    if (backward > max_backward || (CAPPED_CHAINS && !delta)) break;
+    prev_ix = (cur_ix - backward) & ring_buffer_mask;
+    slot = banks[bank].slots[last].next;
+    delta = banks[bank].slots[last].delta;
+    if (cur_ix_masked + best_len > ring_buffer_mask ||
+        prev_ix + best_len > ring_buffer_mask ||
+        data[cur_ix_masked + best_len] != data[prev_ix + best_len]) {
+      continue;
+    }
+    {
+      const size_t len = FindMatchLengthWithLimit(&data[prev_ix],
+                                                  &data[cur_ix_masked],
+                                                  max_length);
+      if (len > best_len) {
+        best_len = len;
+        AddChainMatch(orig_matches, &matches, backward, len);
+      }
+    }
+  }
+  FN(Store)(self, data, ring_buffer_mask, cur_ix);
+  FindAllStaticDictionaryMatches(dictionary, &data[cur_ix_masked], best_len,
+      max_length, dictionary_distance, params->dist.max_distance, &matches);
+  return (size_t)(matches - orig_matches);
+}
+
 #undef BANK_SIZE
 #undef BUCKET_SIZE
 #undef CAPPED_CHAINS
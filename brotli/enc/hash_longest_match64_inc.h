@@ -104,6 +104,17 @@ static BROTLI_INLINE void FN(HashMemAllocInBytes)(
   alloc_size[1] = sizeof(uint32_t) * bucket_size * block_size;
 }
 
+/* Hints the cache about the counter and the head of the bucket that position
+   |ix| hashes to. */
+static BROTLI_INLINE void FN(Prefetch)(
+    HashLongestMatch* BROTLI_RESTRICT self, const uint8_t* BROTLI_RESTRICT data,
+    const size_t mask, const size_t ix) {
+  const uint32_t key = FN(HashBytes)(&data[ix & mask], self->hash_mask_,
+                                     self->hash_shift_);
+  BROTLI_PREFETCH(&self->num_[key]);
+  BROTLI_PREFETCH(&self->buckets_[key << self->block_bits_]);
+}
+
 /* Look at 4 bytes at &data[ix & mask].
    Compute a hash from these, and store the value of ix at that position. */
 static BROTLI_INLINE void FN(Store)(
@@ -122,8 +133,26 @@ static BROTLI_INLINE void FN(Store)(
 static BROTLI_INLINE void FN(StoreRange)(HashLongestMatch* BROTLI_RESTRICT self,
     const uint8_t* BROTLI_RESTRICT data, const size_t mask,
     const size_t ix_start, const size_t ix_end) {
-  size_t i;
-  for (i = ix_start; i < ix_end; ++i) {
+  uint16_t* BROTLI_RESTRICT num = self->num_;
+  uint32_t* BROTLI_RESTRICT buckets = self->buckets_;
+  size_t i = ix_start;
+  for (; i + BROTLI_HASHER_STORE_BATCH <= ix_end;
+       i += BROTLI_HASHER_STORE_BATCH) {
+    uint32_t keys[BROTLI_HASHER_STORE_BATCH];
+    size_t j;
+    for (j = 0; j < BROTLI_HASHER_STORE_BATCH; ++j) {
+      keys[j] = FN(HashBytes)(&data[(i + j) & mask],
+                               self->hash_mask_, self->hash_shift_);
+      BROTLI_PREFETCH(&num[keys[j]]);
+    }
+    for (j = 0; j < BROTLI_HASHER_STORE_BATCH; ++j) {
+      const uint32_t key = keys[j];
+      const size_t minor_ix = num[key] & self->block_mask_;
+      buckets[minor_ix + (key << self->block_bits_)] = (uint32_t)(i + j);
+      ++num[key];
+    }
+  }
+  for (; i < ix_end; ++i) {
     FN(Store)(self, data, mask, i);
   }
 }
@@ -177,6 +206,10 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
   size_t i;
   out->len = 0;
   out->len_code_delta = 0;
+  if (max_length > BROTLI_HASHER_PREFETCH_DISTANCE + FN(HashTypeLength)()) {
+    FN(Prefetch)(self, data, ring_buffer_mask,
+                 cur_ix + BROTLI_HASHER_PREFETCH_DISTANCE);
+  }
   /* Try last distance first. */
   for (i = 0; i < (size_t)self->num_last_distances_to_check_; ++i) {
     const size_t backward = (size_t)distance_cache[i];
@@ -264,4 +297,60 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
   }
 }
 
+/* Finds all backward matches of &data[cur_ix & ring_buffer_mask] up to the
+   length of max_length, for the shortest-path search, and stores the position
+   cur_ix in the hash table. Last distances are left to the search.
+
+   Stores up to MAX_NUM_CHAIN_MATCHES matches of the window in |matches|,
+   followed by static dictionary matches; all of them are sorted by strictly
+   increasing length and (non-strictly) increasing distance. Returns the
+   number of stored matches. */
+static BROTLI_INLINE size_t FN(FindAllMatches)(
+    HashLongestMatch* BROTLI_RESTRICT self,
+    const BrotliEncoderDictionary* dictionary,
+    const uint8_t* BROTLI_RESTRICT data, const size_t ring_buffer_mask,
+    const size_t cur_ix, const size_t max_length, const size_t max_backward,
+    const size_t dictionary_distance, const BrotliEncoderParams* params,
+    BackwardMatch* matches) {
+  BackwardMatch* const orig_matches = matches;
+  uint16_t* BROTLI_RESTRICT num = self->num_;
+  uint32_t* BROTLI_RESTRICT buckets = self->buckets_;
+  const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
+  const uint32_t key = FN(HashBytes)(
+      &data[cur_ix_masked], self->hash_mask_, self->hash_shift_);
+  uint32_t* BROTLI_RESTRICT bucket = &buckets[key << self->block_bits_];
+  const size_t down =
+      (num[key] > self->block_size_) ? (num[key] - self->block_size_) : 0u;
+  size_t best_len = FindNearMatches(data, ring_buffer_mask, cur_ix,
+      max_length, max_backward, &matches);
+  size_t i;
+  for (i = num[key]; i > down && best_len < max_length;) {
+    size_t prev_ix = bucket[--i & self->block_mask_];
+    const size_t backward = cur_ix - prev_ix;
+    if (BROTLI_PREDICT_FALSE(backward > max_backward)) {
+      break;
+    }
+    prev_ix &= ring_buffer_mask;
+    if (cur_ix_masked + best_len > ring_buffer_mask ||
+        prev_ix + best_len > ring_buffer_mask ||
+        data[cur_ix_masked + best_len] != data[prev_ix + best_len]) {
+      continue;
+    }
+    {
+      const size_t len = FindMatchLengthWithLimit(&data[prev_ix],
+                                                  &data[cur_ix_masked],
+                                                  max_length);
+      if (len > best_len) {
+        best_len = len;
+        AddChainMatch(orig_matches, &matches, backward, len);
+      }
+    }
+  }
+  bucket[num[key] & self->block_mask_] = (uint32_t)cur_ix;
+  ++num[key];
+  FindAllStaticDictionaryMatches(dictionary, &data[cur_ix_masked], best_len,
+      max_length, dictionary_distance, params->dist.max_distance, &matches);
+  return (size_t)(matches - orig_matches);
+}
+
 #undef HashLongestMatch
@@ -60,7 +60,9 @@ static void FN(Prepare)(
   size_t partial_prepare_threshold = BUCKET_SIZE >> 5;
   if (one_shot && input_size <= partial_prepare_threshold) {
     size_t i;
-    for (i = 0; i < input_size; ++i) {
+    /* Positions closer to the end are never stored; stopping there keeps
+       the reads inside the input. */
+    for (i = 0; i + FN(HashTypeLength)() <= input_size; ++i) {
       const uint32_t key = FN(HashBytes)(&data[i]);
       if (BUCKET_SWEEP == 1) {
         buckets[key] = 0;
@@ -155,7 +157,9 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
   uint32_t* BROTLI_RESTRICT buckets = self->buckets_;
   const size_t best_len_in = out->len;
   const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
-  int compare_char = data[cur_ix_masked + best_len_in];
+  /* No byte follows a match of |max_length|; -1 rejects every candidate. */
+  int compare_char =
+      best_len_in < max_length ? data[cur_ix_masked + best_len_in] : -1;
   size_t key = FN(HashBytes)(&data[cur_ix_masked]);
   size_t key_out;
   score_t min_score = out->score;
@@ -164,6 +168,12 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
   size_t cached_backward = (size_t)distance_cache[0];
   size_t prev_ix = cur_ix - cached_backward;
   out->len_code_delta = 0;
+  /* Smaller tables stay in cache anyway. */
+  if (BUCKET_BITS >= 20 &&
+      max_length > BROTLI_HASHER_PREFETCH_DISTANCE + FN(HashTypeLength)()) {
+    BROTLI_PREFETCH(&buckets[FN(HashBytes)(&data[
+        (cur_ix + BROTLI_HASHER_PREFETCH_DISTANCE) & ring_buffer_mask])]);
+  }
   if (prev_ix < cur_ix) {
     prev_ix &= (uint32_t)ring_buffer_mask;
     if (compare_char == data[prev_ix + best_len]) {
@@ -181,7 +191,7 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
           } else {
             best_len = len;
             best_score = score;
-            compare_char = data[cur_ix_masked + len];
+            compare_char = len < max_length ? data[cur_ix_masked + len] : -1;
           }
         }
       }
@@ -240,7 +250,7 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
         if (best_score < score) {
           best_len = len;
           out->len = len;
-          compare_char = data[cur_ix_masked + len];
+          compare_char = len < max_length ? data[cur_ix_masked + len] : -1;
           best_score = score;
           out->score = score;
           out->distance = backward;
@@ -75,6 +75,11 @@ static void FN(Initialize)(
   BROTLI_UNUSED(params);
 }
 
+/* Initialize would clear the table of a copied hasher. */
+static void FN(Rebind)(HasherCommon* common, HashRolling* BROTLI_RESTRICT self) {
+  self->table = (uint32_t*)common->extra[0];
+}
+
 static void FN(Prepare)(HashRolling* BROTLI_RESTRICT self, BROTLI_BOOL one_shot,
     size_t input_size, const uint8_t* BROTLI_RESTRICT data) {
   size_t i;
@@ -160,8 +165,8 @@ static BROTLI_INLINE void FN(FindLongestMatch)(
 
   if ((cur_ix & (JUMP - 1)) != 0) return;
 
-  /* Not enough lookahead */
-  if (max_length < CHUNKLEN) return;
+  /* Not enough lookahead; |add| below is the byte after the chunk. */
+  if (max_length <= CHUNKLEN) return;
 
   for (pos = self->next_ix; pos <= cur_ix; pos += JUMP) {
     uint32_t code = self->state & MASK;
@@ -13,11 +13,16 @@
    Each sequence is MAX_TREE_COMP_LENGTH long and is identified by its starting
    position in the input data. The binary tree is sorted by the lexicographic
    order of the sequences, and it is also a max-heap with respect to the
-   starting positions. */
+   starting positions.
+
+   The forest may span only the last 2^tree_bits positions of the window;
+   then positions that leave it are kept in a small forgetful hash chain of
+   FAR_SLOTS entries per bucket, that serves the rest of the window. */
 
 #define HashToBinaryTree HASHER()
 
 #define BUCKET_SIZE (1 << BUCKET_BITS)
+#define FAR_SLOTS 4
 
 static BROTLI_INLINE size_t FN(HashTypeLength)(void) { return 4; }
 static BROTLI_INLINE size_t FN(StoreLookahead)(void) {
@@ -35,6 +40,13 @@ typedef struct HashToBinaryTree {
   /* The window size minus 1 */
   size_t window_mask_;
 
+  /* The number of positions in the forest minus 1 */
+  size_t tree_mask_;
+
+  /* Maximum backward distance of tree nodes; farther nodes might be
+     overwritten. */
+  size_t tree_max_backward_;
+
   /* Hash table that maps the 4-byte hashes of the sequence to the last
      position where this hash was found, which is the root of the binary
      tree of sequences that share this hash bucket. */
@@ -52,15 +64,31 @@ typedef struct HashToBinaryTree {
      the left and right children of a sequence starting at pos are
      forest_[2 * pos] and forest_[2 * pos + 1]. */
   uint32_t* forest_;  /* uint32_t[2 * num_nodes] */
+
+  /* Positions that left the forest, FAR_SLOTS per hash bucket, and index of
+     the last written slot of each bucket; NULL if the forest spans the
+     whole window. */
+  uint32_t* far_;  /* uint32_t[BUCKET_SIZE * FAR_SLOTS] */
+  uint8_t* far_head_;  /* uint8_t[BUCKET_SIZE] */
 } HashToBinaryTree;
 
+static BROTLI_INLINE int FN(TreeBits)(const BrotliEncoderParams* params) {
+  int tree_bits = params->hasher.tree_bits;
+  return (tree_bits == 0 || tree_bits > params->lgwin) ?
+      params->lgwin : tree_bits;
+}
+
 static void FN(Initialize)(
     HasherCommon* common, HashToBinaryTree* BROTLI_RESTRICT self,
     const BrotliEncoderParams* params) {
   self->buckets_ = (uint32_t*)common->extra[0];
   self->forest_ = (uint32_t*)common->extra[1];
+  self->far_ = (uint32_t*)common->extra[2];
+  self->far_head_ = (uint8_t*)common->extra[3];
 
   self->window_mask_ = (1u << params->lgwin) - 1u;
+  self->tree_mask_ = ((size_t)1 << FN(TreeBits)(params)) - 1u;
+  self->tree_max_backward_ = self->tree_mask_ - BROTLI_WINDOW_GAP + 1;
   self->invalid_pos_ = (uint32_t)(0 - self->window_mask_);
 }
 
@@ -76,29 +104,42 @@ static void FN(Prepare)
   for (i = 0; i < BUCKET_SIZE; i++) {
     buckets[i] = invalid_pos;
   }
+  if (self->far_ != NULL) {
+    uint32_t* BROTLI_RESTRICT far = self->far_;
+    for (i = 0; i < BUCKET_SIZE * FAR_SLOTS; i++) {
+      far[i] = invalid_pos;
+    }
+    memset(self->far_head_, 0, BUCKET_SIZE);
+  }
 }
 
 static BROTLI_INLINE void FN(HashMemAllocInBytes)(
     const BrotliEncoderParams* params, BROTLI_BOOL one_shot,
     size_t input_size, size_t* alloc_size) {
-  size_t num_nodes = (size_t)1 << params->lgwin;
-  if (one_shot && input_size < num_nodes) {
+  size_t num_nodes = (size_t)1 << FN(TreeBits)(params);
+  BROTLI_BOOL fits_tree = TO_BROTLI_BOOL(params->lgwin <= FN(TreeBits)(params));
+  if (one_shot && input_size <= num_nodes) {
     num_nodes = input_size;
+    fits_tree = BROTLI_TRUE;
   }
   alloc_size[0] = sizeof(uint32_t) * BUCKET_SIZE;
   alloc_size[1] = 2 * sizeof(uint32_t) * num_nodes;
+  if (!fits_tree) {
+    alloc_size[2] = sizeof(uint32_t) * BUCKET_SIZE * FAR_SLOTS;
+    alloc_size[3] = BUCKET_SIZE;
+  }
 }
 
 static BROTLI_INLINE size_t FN(LeftChildIndex)(
     HashToBinaryTree* BROTLI_RESTRICT self,
     const size_t pos) {
-  return 2 * (pos & self->window_mask_);
+  return 2 * (pos & self->tree_mask_);
 }
 
 static BROTLI_INLINE size_t FN(RightChildIndex)(
     HashToBinaryTree* BROTLI_RESTRICT self,
     const size_t pos) {
-  return 2 * (pos & self->window_mask_) + 1;
+  return 2 * (pos & self->tree_mask_) + 1;
 }
 
 /* Stores the hash of the next 4 bytes and in a single tree-traversal, the
@@ -114,7 +155,7 @@ static BROTLI_INLINE size_t FN(RightChildIndex)(
 static BROTLI_INLINE BackwardMatch* FN(StoreAndFindMatches)(
     HashToBinaryTree* BROTLI_RESTRICT self, const uint8_t* BROTLI_RESTRICT data,
     const size_t cur_ix, const size_t ring_buffer_mask, const size_t max_length,
-    const size_t max_backward, size_t* const BROTLI_RESTRICT best_len,
+    size_t max_backward, size_t* const BROTLI_RESTRICT best_len,
     BackwardMatch* BROTLI_RESTRICT matches) {
   const size_t cur_ix_masked = cur_ix & ring_buffer_mask;
   const size_t max_comp_len =
@@ -140,6 +181,19 @@ static BROTLI_INLINE BackwardMatch* FN(StoreAndFindMatches)(
   size_t depth_remaining;
   if (should_reroot_tree) {
     buckets[key] = (uint32_t)cur_ix;
+    if (self->far_ != NULL && cur_ix > self->tree_mask_) {
+      /* Node of the position that leaves the forest is overwritten now. */
+      const size_t old_ix = cur_ix - self->tree_mask_ - 1;
+      const uint32_t old_key =
+          FN(HashBytes)(&data[old_ix & ring_buffer_mask]);
+      const uint8_t head = (uint8_t)((self->far_head_[old_key] + 1) &
+                                     (FAR_SLOTS - 1));
+      self->far_head_[old_key] = head;
+      self->far_[old_key * FAR_SLOTS + head] = (uint32_t)old_ix;
+    }
+  }
+  if (max_backward > self->tree_max_backward_) {
+    max_backward = self->tree_max_backward_;
   }
   for (depth_remaining = MAX_TREE_SEARCH_DEPTH; ; --depth_remaining) {
     const size_t backward = cur_ix - prev_ix;
@@ -241,11 +295,32 @@ static BROTLI_INLINE size_t FN(FindAllMatches)(
     matches = FN(StoreAndFindMatches)(self, data, cur_ix,
         ring_buffer_mask, max_length, max_backward, &best_len, matches);
   }
-  for (i = 0; i <= BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN; ++i) {
-    dict_matches[i] = kInvalidMatch;
+  if (self->far_ != NULL && best_len < max_length) {
+    /* Beyond the forest; slots are visited from the newest to the oldest,
+       so that distances grow. */
+    const uint32_t key = FN(HashBytes)(&data[cur_ix_masked]);
+    const uint32_t* BROTLI_RESTRICT far = &self->far_[key * FAR_SLOTS];
+    size_t head = self->far_head_[key];
+    for (i = 0; i < FAR_SLOTS; ++i) {
+      const size_t prev_ix = far[(head - i) & (FAR_SLOTS - 1)];
+      const size_t backward = cur_ix - prev_ix;
+      size_t len;
+      if (backward > max_backward) break;
+      len = FindMatchLengthWithLimit(&data[prev_ix & ring_buffer_mask],
+                                     &data[cur_ix_masked], max_length);
+      if (len > best_len) {
+        best_len = len;
+        InitBackwardMatch(matches++, backward, len);
+        if (len == max_length) break;
+      }
+    }
   }
-  {
+  if (best_len < BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN) {
+    /* Longer matches are out of the dictionary reach. */
     size_t minlen = BROTLI_MAX(size_t, 4, best_len + 1);
+    for (i = 0; i <= BROTLI_MAX_STATIC_DICTIONARY_MATCH_LEN; ++i) {
+      dict_matches[i] = kInvalidMatch;
+    }
     if (BrotliFindAllStaticDictionaryMatches(dictionary,
         &data[cur_ix_masked], minlen, max_length, &dict_matches[0])) {
       size_t maxlen = BROTLI_MIN(
@@ -325,6 +400,7 @@ static BROTLI_INLINE void FN(StitchToPreviousBlock)(
   }
 }
 
+#undef FAR_SLOTS
 #undef BUCKET_SIZE
 
 #undef HashToBinaryTree
@@ -47,6 +47,43 @@ extern "C" {
 #undef DATA_SIZE
 #undef FN
 
+/* Inputs shorter than that are not worth clearing extra counter lanes. */
+#define BROTLI_HISTOGRAM_LANES_THRESHOLD 2048
+
+/* Adds |length| bytes of |data| to the 256-symbol |histogram|. Long inputs
+   are counted with 4 independent counter sets: in runs of the same byte each
+   increment would otherwise wait for the store of the previous one. */
+static BROTLI_INLINE void BrotliHistogramAddBytes(
+    uint32_t* BROTLI_RESTRICT histogram, const uint8_t* data, size_t length) {
+  size_t i = 0;
+  if (length >= BROTLI_HISTOGRAM_LANES_THRESHOLD) {
+    uint32_t lanes[3][256];
+    size_t j;
+    memset(lanes, 0, sizeof(lanes));
+    for (; i + 4 <= length; i += 4) {
+      ++histogram[data[i]];
+      ++lanes[0][data[i + 1]];
+      ++lanes[1][data[i + 2]];
+      ++lanes[2][data[i + 3]];
+    }
+    for (j = 0; j < 256; ++j) {
+      histogram[j] += lanes[0][j] + lanes[1][j] + lanes[2][j];
+    }
+  }
+  for (; i < length; ++i) ++histogram[data[i]];
+}
+
+/* Same as BrotliHistogramAddBytes for |length| bytes of ring buffer |data|
+   starting at |pos|. */
+static BROTLI_INLINE void BrotliHistogramAddRingBytes(
+    uint32_t* BROTLI_RESTRICT histogram, const uint8_t* data, size_t pos,
+    size_t mask, size_t length) {
+  const size_t masked_pos = pos & mask;
+  const size_t head = BROTLI_MIN(size_t, length, mask + 1 - masked_pos);
+  BrotliHistogramAddBytes(histogram, data + masked_pos, head);
+  BrotliHistogramAddBytes(histogram, data, length - head);
+}
+
 BROTLI_INTERNAL void BrotliBuildHistogramsWithContext(
     const Command* cmds, const size_t num_commands,
     const BlockSplit* literal_split, const BlockSplit* insert_and_copy_split,
@@ -40,11 +40,24 @@ static size_t DecideMultiByteStatsLevel(size_t pos, size_t len, size_t mask,
   size_t counts[3] = { 0 };
   size_t max_utf8 = 1;  /* should be 2, but 1 compresses better. */
   size_t last_c = 0;
-  size_t i;
-  for (i = 0; i < len; ++i) {
-    size_t c = data[(pos + i) & mask];
+  size_t i = 0;
+  while (i < len) {
+    size_t masked_pos = (pos + i) & mask;
+    size_t c = data[masked_pos];
+    if (c < 128) {
+      /* ASCII bytes are 'Byte 1' whatever precedes them. */
+      size_t run = BrotliASCIIRunLength(&data[masked_pos],
+          BROTLI_MIN(size_t, len - i - 1, mask - masked_pos) + 1, BROTLI_TRUE);
+      if (run != 0) {
+        counts[0] += run;
+        i += run;
+        last_c = data[(pos + i - 1) & mask];
+        continue;
+      }
+    }
     ++counts[UTF8Position(last_c, c, 2)];
     last_c = c;
+    ++i;
   }
   if (counts[2] < 500) {
     max_utf8 = 1;
@@ -55,6 +68,17 @@ static size_t DecideMultiByteStatsLevel(size_t pos, size_t len, size_t mask,
   return max_utf8;
 }
 
+/* Returns FastLog2(v), recomputed only when v differs from the cached one;
+   window totals change rarely compared to how often they are read. */
+static BROTLI_INLINE double CachedLog2(size_t v, size_t* cached_v,
+                                       double* cached_log) {
+  if (v != *cached_v) {
+    *cached_v = v;
+    *cached_log = FastLog2(v);
+  }
+  return *cached_log;
+}
+
 static void EstimateBitCostsForLiteralsUTF8(size_t pos, size_t len, size_t mask,
                                             const uint8_t* data,
                                             size_t* histogram, float* cost) {
@@ -64,6 +88,15 @@ static void EstimateBitCostsForLiteralsUTF8(size_t pos, size_t len, size_t mask,
   size_t window_half = 495;
   size_t in_window = BROTLI_MIN(size_t, window_half, len);
   size_t in_window_utf8[3] = { 0 };
+  size_t log_v[3] = { 0 };
+  double log_in_window[3] = { 0.0 };
+  /* The bytes preceding the removed, added and current byte: the UTF-8
+     position of a byte depends on them only, and each of the three streams
+     moves by one byte per step, so they are carried along instead of being
+     reloaded from the ring buffer. */
+  size_t rm_c = 0, rm_last_c = 0;
+  size_t add_c = 0, add_last_c = 0;
+  size_t cur_c = 0, cur_last_c = 0;
   size_t i;
   memset(histogram, 0, 3 * 256 * sizeof(histogram[0]));
 
@@ -78,38 +111,41 @@ static void EstimateBitCostsForLiteralsUTF8(size_t pos, size_t len, size_t mask,
       last_c = c;
     }
   }
+  if (window_half < len) {
+    add_c = data[(pos + window_half - 1) & mask];
+    add_last_c = data[(pos + window_half - 2) & mask];
+  }
 
   /* Compute bit costs with sliding window. */
   for (i = 0; i < len; ++i) {
+    size_t cur = data[(pos + i) & mask];
     if (i >= window_half) {
       /* Remove a byte in the past. */
-      size_t c =
-          i < window_half + 1 ? 0 : data[(pos + i - window_half - 1) & mask];
-      size_t last_c =
-          i < window_half + 2 ? 0 : data[(pos + i - window_half - 2) & mask];
-      size_t utf8_pos2 = UTF8Position(last_c, c, max_utf8);
-      --histogram[256 * utf8_pos2 + data[(pos + i - window_half) & mask]];
+      size_t rm = data[(pos + i - window_half) & mask];
+      size_t utf8_pos2 = UTF8Position(rm_last_c, rm_c, max_utf8);
+      --histogram[256 * utf8_pos2 + rm];
       --in_window_utf8[utf8_pos2];
+      rm_last_c = rm_c;
+      rm_c = rm;
     }
     if (i + window_half < len) {
       /* Add a byte in the future. */
-      size_t c = data[(pos + i + window_half - 1) & mask];
-      size_t last_c = data[(pos + i + window_half - 2) & mask];
-      size_t utf8_pos2 = UTF8Position(last_c, c, max_utf8);
-      ++histogram[256 * utf8_pos2 + data[(pos + i + window_half) & mask]];
+      size_t add = data[(pos + i + window_half) & mask];
+      size_t utf8_pos2 = UTF8Position(add_last_c, add_c, max_utf8);
+      ++histogram[256 * utf8_pos2 + add];
       ++in_window_utf8[utf8_pos2];
+      add_last_c = add_c;
+      add_c = add;
     }
     {
-      size_t c = i < 1 ? 0 : data[(pos + i - 1) & mask];
-      size_t last_c = i < 2 ? 0 : data[(pos + i - 2) & mask];
-      size_t utf8_pos = UTF8Position(last_c, c, max_utf8);
-      size_t masked_pos = (pos + i) & mask;
-      size_t histo = histogram[256 * utf8_pos + data[masked_pos]];
+      size_t utf8_pos = UTF8Position(cur_last_c, cur_c, max_utf8);
+      size_t histo = histogram[256 * utf8_pos + cur];
       double lit_cost;
       if (histo == 0) {
         histo = 1;
       }
-      lit_cost = FastLog2(in_window_utf8[utf8_pos]) - FastLog2(histo);
+      lit_cost = CachedLog2(in_window_utf8[utf8_pos], &log_v[utf8_pos],
+                            &log_in_window[utf8_pos]) - FastLog2(histo);
       lit_cost += 0.02905;
       if (lit_cost < 1.0) {
         lit_cost *= 0.5;
@@ -123,6 +159,8 @@ static void EstimateBitCostsForLiteralsUTF8(size_t pos, size_t len, size_t mask,
         lit_cost += 0.7 - ((double)(2000 - i) / 2000.0 * 0.35);
       }
       cost[i] = (float)lit_cost;
+      cur_last_c = cur_c;
+      cur_c = cur;
     }
   }
 }
@@ -136,6 +174,8 @@ void BrotliEstimateBitCostsForLiterals(size_t pos, size_t len, size_t mask,
   } else {
     size_t window_half = 2000;
     size_t in_window = BROTLI_MIN(size_t, window_half, len);
+    size_t log_v = 0;
+    double log_in_window = 0.0;
     size_t i;
     memset(histogram, 0, 256 * sizeof(histogram[0]));
 
@@ -162,7 +202,8 @@ void BrotliEstimateBitCostsForLiterals(size_t pos, size_t len, size_t mask,
         histo = 1;
       }
       {
-        double lit_cost = FastLog2(in_window) - FastLog2(histo);
+        double lit_cost = CachedLog2(in_window, &log_v, &log_in_window) -
+            FastLog2(histo);
         lit_cost += 0.029;
         if (lit_cost < 1.0) {
           lit_cost *= 0.5;
@@ -9,6 +9,8 @@
 
 #include "./metablock.h"
 
+#include <string.h>  /* memcpy, memset */
+
 #include "../common/constants.h"
 #include "../common/context.h"
 #include "../common/platform.h"
@@ -54,10 +56,9 @@ void BrotliInitDistanceParams(BrotliDistanceParams* dist_params,
   dist_params->max_distance = max_distance;
 }
 
-static void RecomputeDistancePrefixes(Command* cmds,
-                                      size_t num_commands,
-                                      const BrotliDistanceParams* orig_params,
-                                      const BrotliDistanceParams* new_params) {
+void BrotliRecomputeDistancePrefixes(Command* cmds, size_t num_commands,
+    const BrotliDistanceParams* orig_params,
+    const BrotliDistanceParams* new_params) {
   size_t i;
 
   if (orig_params->distance_postfix_bits == new_params->distance_postfix_bits &&
@@ -78,8 +79,117 @@ static void RecomputeDistancePrefixes(Command* cmds,
   }
 }
 
-static BROTLI_BOOL ComputeDistanceCost(const Command* cmds,
-                                       size_t num_commands,
+/* Distance columns of a command array: distance codes of the commands that
+   have an explicit distance, and the positions of those commands, in dense
+   arrays. Besides, the codes are aggregated once for the distance parameter
+   search: short codes map to themselves under any NPOSTFIX/NDIRECT, so their
+   histogram is fixed; long codes are deduplicated and weighted, so each
+   candidate encodes every distinct distance only once. */
+typedef struct DistanceColumns {
+  uint32_t* codes;     /* Distance codes; do not depend on NPOSTFIX/NDIRECT. */
+  uint32_t* commands;  /* Index of the command each code belongs to. */
+  size_t size;
+  uint32_t* long_codes;   /* Distinct codes >= BROTLI_NUM_DISTANCE_SHORT_CODES */
+  uint32_t* long_counts;  /* and the number of their uses. */
+  size_t num_long;
+  uint32_t short_histogram[BROTLI_NUM_DISTANCE_SHORT_CODES];
+  size_t num_short;
+} DistanceColumns;
+
+static void InitDistanceColumns(MemoryManager* m, DistanceColumns* self,
+    const Command* cmds, size_t num_commands,
+    const BrotliDistanceParams* orig_params) {
+  size_t i;
+  size_t n = 0;
+  size_t table_bits = 4;
+  size_t table_size;
+  self->codes = BROTLI_ALLOC(m, uint32_t, num_commands);
+  self->commands = BROTLI_ALLOC(m, uint32_t, num_commands);
+  self->size = 0;
+  self->long_codes = NULL;
+  self->long_counts = NULL;
+  self->num_long = 0;
+  memset(self->short_histogram, 0, sizeof(self->short_histogram));
+  self->num_short = 0;
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(self->codes) ||
+      BROTLI_IS_NULL(self->commands)) {
+    return;
+  }
+  for (i = 0; i < num_commands; ++i) {
+    const Command* cmd = &cmds[i];
+    if (CommandCopyLen(cmd) && cmd->cmd_prefix_ >= 128) {
+      uint32_t code = CommandRestoreDistanceCode(cmd, orig_params);
+      self->codes[n] = code;
+      self->commands[n] = (uint32_t)i;
+      ++n;
+      if (code < BROTLI_NUM_DISTANCE_SHORT_CODES) {
+        ++self->short_histogram[code];
+        ++self->num_short;
+      }
+    }
+  }
+  self->size = n;
+
+  /* Count distinct long codes in an open-addressing table of at least twice
+     their number, then compact it. */
+  while (((size_t)1 << table_bits) < 2 * (n - self->num_short)) ++table_bits;
+  table_size = (size_t)1 << table_bits;
+  self->long_codes = BROTLI_ALLOC(m, uint32_t, table_size);
+  self->long_counts = BROTLI_ALLOC(m, uint32_t, table_size);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(self->long_codes) ||
+      BROTLI_IS_NULL(self->long_counts)) {
+    return;
+  }
+  memset(self->long_codes, 0, table_size * sizeof(self->long_codes[0]));
+  memset(self->long_counts, 0, table_size * sizeof(self->long_counts[0]));
+  for (i = 0; i < n; ++i) {
+    uint32_t code = self->codes[i];
+    size_t slot;
+    if (code < BROTLI_NUM_DISTANCE_SHORT_CODES) continue;
+    slot = (size_t)((code * 0x1E35A7BDu) >> (32 - table_bits));
+    /* Zero count marks an empty slot. */
+    while (self->long_counts[slot] != 0 && self->long_codes[slot] != code) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    self->long_codes[slot] = code;
+    ++self->long_counts[slot];
+  }
+  for (i = 0; i < table_size; ++i) {
+    if (self->long_counts[i] != 0) {
+      self->long_codes[self->num_long] = self->long_codes[i];
+      self->long_counts[self->num_long] = self->long_counts[i];
+      ++self->num_long;
+    }
+  }
+}
+
+static void CleanupDistanceColumns(MemoryManager* m, DistanceColumns* self) {
+  BROTLI_FREE(m, self->codes);
+  BROTLI_FREE(m, self->commands);
+  BROTLI_FREE(m, self->long_codes);
+  BROTLI_FREE(m, self->long_counts);
+}
+
+static void RecomputeDistancePrefixesFromColumns(Command* cmds,
+    const DistanceColumns* columns, const BrotliDistanceParams* orig_params,
+    const BrotliDistanceParams* new_params) {
+  size_t i;
+  if (orig_params->distance_postfix_bits == new_params->distance_postfix_bits &&
+      orig_params->num_direct_distance_codes ==
+      new_params->num_direct_distance_codes) {
+    return;
+  }
+  for (i = 0; i < columns->size; ++i) {
+    Command* cmd = &cmds[columns->commands[i]];
+    PrefixEncodeCopyDistance(columns->codes[i],
+                             new_params->num_direct_distance_codes,
+                             new_params->distance_postfix_bits,
+                             &cmd->dist_prefix_,
+                             &cmd->dist_extra_);
+  }
+}
+
+static BROTLI_BOOL ComputeDistanceCost(const DistanceColumns* columns,
                                        const BrotliDistanceParams* orig_params,
                                        const BrotliDistanceParams* new_params,
                                        double* cost,
@@ -88,7 +198,7 @@ static BROTLI_BOOL ComputeDistanceCost(const Command* cmds,
   BROTLI_BOOL equal_params = BROTLI_FALSE;
   uint16_t dist_prefix;
   uint32_t dist_extra;
-  double extra_bits = 0.0;
+  size_t extra_bits = 0;
   HistogramClearDistance(tmp);
 
   if (orig_params->distance_postfix_bits == new_params->distance_postfix_bits &&
@@ -97,28 +207,27 @@ static BROTLI_BOOL ComputeDistanceCost(const Command* cmds,
     equal_params = BROTLI_TRUE;
   }
 
-  for (i = 0; i < num_commands; i++) {
-    const Command* cmd = &cmds[i];
-    if (CommandCopyLen(cmd) && cmd->cmd_prefix_ >= 128) {
-      if (equal_params) {
-        dist_prefix = cmd->dist_prefix_;
-      } else {
-        uint32_t distance = CommandRestoreDistanceCode(cmd, orig_params);
-        if (distance > new_params->max_distance) {
-          return BROTLI_FALSE;
-        }
-        PrefixEncodeCopyDistance(distance,
-                                 new_params->num_direct_distance_codes,
-                                 new_params->distance_postfix_bits,
-                                 &dist_prefix,
-                                 &dist_extra);
-      }
-      HistogramAddDistance(tmp, dist_prefix & 0x3FF);
-      extra_bits += dist_prefix >> 10;
+  memcpy(tmp->data_, columns->short_histogram,
+         sizeof(columns->short_histogram));
+  tmp->total_count_ = columns->num_short;
+  for (i = 0; i < columns->num_long; i++) {
+    uint32_t distance = columns->long_codes[i];
+    uint32_t count = columns->long_counts[i];
+    /* Codes were valid for the original parameters. */
+    if (!equal_params && distance > new_params->max_distance) {
+      return BROTLI_FALSE;
     }
+    PrefixEncodeCopyDistance(distance,
+                             new_params->num_direct_distance_codes,
+                             new_params->distance_postfix_bits,
+                             &dist_prefix,
+                             &dist_extra);
+    tmp->data_[dist_prefix & 0x3FF] += count;
+    tmp->total_count_ += count;
+    extra_bits += (size_t)(dist_prefix >> 10) * count;
   }
 
-  *cost = BrotliPopulationCostDistance(tmp) + extra_bits;
+  *cost = BrotliPopulationCostDistance(tmp) + (double)extra_bits;
   return BROTLI_TRUE;
 }
 
@@ -149,8 +258,11 @@ void BrotliBuildMetaBlock(MemoryManager* m,
   BrotliDistanceParams orig_params = params->dist;
   BrotliDistanceParams new_params = params->dist;
   HistogramDistance* tmp = BROTLI_ALLOC(m, HistogramDistance, 1);
+  DistanceColumns columns;
 
   if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(tmp)) return;
+  InitDistanceColumns(m, &columns, cmds, num_commands, &orig_params);
+  if (BROTLI_IS_OOM(m)) return;
 
   for (npostfix = 0; npostfix <= BROTLI_MAX_NPOSTFIX; npostfix++) {
     for (; ndirect_msb < 16; ndirect_msb++) {
@@ -164,7 +276,7 @@ void BrotliBuildMetaBlock(MemoryManager* m,
         check_orig = BROTLI_FALSE;
       }
       skip = !ComputeDistanceCost(
-          cmds, num_commands, &orig_params, &new_params, &dist_cost, tmp);
+          &columns, &orig_params, &new_params, &dist_cost, tmp);
       if (skip || (dist_cost > best_dist_cost)) {
         break;
       }
@@ -176,7 +288,7 @@ void BrotliBuildMetaBlock(MemoryManager* m,
   }
   if (check_orig) {
     double dist_cost;
-    ComputeDistanceCost(cmds, num_commands, &orig_params, &orig_params,
+    ComputeDistanceCost(&columns, &orig_params, &orig_params,
                         &dist_cost, tmp);
     if (dist_cost < best_dist_cost) {
       /* NB: currently unused; uncomment when more param tuning is added. */
@@ -185,7 +297,9 @@ void BrotliBuildMetaBlock(MemoryManager* m,
     }
   }
   BROTLI_FREE(m, tmp);
-  RecomputeDistancePrefixes(cmds, num_commands, &orig_params, &params->dist);
+  RecomputeDistancePrefixesFromColumns(cmds, &columns, &orig_params,
+                                       &params->dist);
+  CleanupDistanceColumns(m, &columns);
 
   BrotliSplitBlock(m, cmds, num_commands,
                    ringbuffer, pos, mask, params,
@@ -297,8 +411,6 @@ void BrotliBuildMetaBlock(MemoryManager* m,
 #include "./metablock_inc.h"  /* NOLINT(build/include) */
 #undef FN
 
-#define BROTLI_MAX_STATIC_CONTEXTS 13
-
 /* Greedy block splitter for one block category (literal, command or distance).
    Gathers histograms for all context buckets. */
 typedef struct ContextBlockSplitter {
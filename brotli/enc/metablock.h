@@ -23,6 +23,9 @@
 extern "C" {
 #endif
 
+/* The most literal contexts BrotliBuildMetaBlockGreedy can take. */
+#define BROTLI_MAX_STATIC_CONTEXTS 13
+
 typedef struct MetaBlockSplit {
   BlockSplit literal_split;
   BlockSplit command_split;
@@ -98,6 +101,11 @@ BROTLI_INTERNAL void BrotliOptimizeHistograms(uint32_t num_distance_codes,
 BROTLI_INTERNAL void BrotliInitDistanceParams(BrotliDistanceParams* params,
     uint32_t npostfix, uint32_t ndirect, BROTLI_BOOL large_window);
 
+/* Re-encodes distances of |cmds| from |orig_params| to |new_params|. */
+BROTLI_INTERNAL void BrotliRecomputeDistancePrefixes(Command* cmds,
+    size_t num_commands, const BrotliDistanceParams* orig_params,
+    const BrotliDistanceParams* new_params);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
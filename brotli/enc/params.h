@@ -10,6 +10,7 @@
 #define BROTLI_ENC_PARAMS_H_
 
 #include <brotli/encode.h>
+#include "../common/constants.h"
 #include "./encoder_dict.h"
 
 typedef struct BrotliHasherParams {
@@ -18,6 +19,8 @@ typedef struct BrotliHasherParams {
   int block_bits;
   int hash_len;
   int num_last_distances_to_check;
+  /* log2 of positions kept in H10 binary trees; 0 for the whole window. */
+  int tree_bits;
 } BrotliHasherParams;
 
 typedef struct BrotliDistanceParams {
@@ -28,6 +31,15 @@ typedef struct BrotliDistanceParams {
   size_t max_distance;
 } BrotliDistanceParams;
 
+/* First byte of profiles made by BrotliEncoderTrainProfile. */
+#define BROTLI_PROFILE_MAGIC 0x70
+
+/* Literal context map of an encoder profile; num_contexts is 0 if unset. */
+typedef struct BrotliLiteralProfile {
+  size_t num_contexts;
+  uint32_t context_map[1 << BROTLI_LITERAL_CONTEXT_BITS];
+} BrotliLiteralProfile;
+
 /* Encoding parameters */
 typedef struct BrotliEncoderParams {
   BrotliEncoderMode mode;
@@ -38,6 +50,31 @@ typedef struct BrotliEncoderParams {
   size_t size_hint;
   BROTLI_BOOL disable_literal_context_modeling;
   BROTLI_BOOL large_window;
+  BROTLI_BOOL skip_incompressible;
+  /* 0 if unlimited. */
+  size_t memory_limit;
+  BROTLI_BOOL low_latency_flush;
+  BROTLI_BOOL long_distance_matching;
+  BROTLI_BOOL collect_stats;
+  /* BROTLI_PARAM_CHECKSUM value: 0 off, 1 compute, 2 compute and append. */
+  int checksum;
+  /* BROTLI_PARAM_FRAGMENT: output is a headerless unfinished fragment. */
+  BROTLI_BOOL fragment;
+  /* BROTLI_PARAM_DECLARE_SIZE: stream starts with its size, if known. */
+  BROTLI_BOOL declare_size;
+  /* BROTLI_PARAM_WORK_BUDGET: input bytes per stream call; 0 if unlimited. */
+  size_t work_budget;
+  /* BROTLI_PARAM_CHUNK_BITS: log2 of average chunk size; 0 if disabled. */
+  int chunk_bits;
+  /* BROTLI_PARAM_INDEPENDENT_CHUNKS: chunks do not refer to previous data. */
+  BROTLI_BOOL independent_chunks;
+  /* BROTLI_PARAM_SHORTEST_PATH: qualities 5 to 9 search the shortest path. */
+  BROTLI_BOOL shortest_path;
+  /* BROTLI_PARAM_FIRST_BLOCK_BITS: 0, or first block is small and fast. */
+  int first_block_bits;
+  /* BROTLI_PARAM_HASHER_* choices; 0 (-1 for block_bits) keeps default. */
+  BrotliHasherParams custom_hasher;
+  BrotliLiteralProfile profile;
   BrotliHasherParams hasher;
   BrotliDistanceParams dist;
   /* TODO(eustas): rename to BrotliShared... */
@@ -0,0 +1,205 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Learns encoder profiles from a corpus of samples.
+
+   Literals of every sample are counted per UTF8 context, scaled down to an
+   average sample and clustered the way quality 10 clusters literal
+   histograms of a meta-block. Each number of clusters is then measured by
+   compressing the samples, and the smallest result wins. The context map
+   replaces the cheap per meta-block choice among the static ones.
+
+   Profile layout: magic byte, literal context mode (CONTEXT_UTF8), number of
+   literal contexts, then 64 context map entries. */
+
+#include <string.h>  /* memcpy, memset */
+
+#include "../common/constants.h"
+#include "../common/context.h"
+#include "../common/platform.h"
+#include <brotli/encode.h>
+#include <brotli/types.h>
+#include "./cluster.h"
+#include "./histogram.h"
+#include "./memory.h"
+#include "./metablock.h"
+#include "./params.h"
+
+#define BROTLI_PROFILE_NUM_CONTEXTS (1 << BROTLI_LITERAL_CONTEXT_BITS)
+#define BROTLI_PROFILE_MIN_MATCH 4
+#define BROTLI_PROFILE_HASH_BITS 15
+
+static const uint32_t kProfileHashMul32 = 0x1E35A7BD;
+
+static BROTLI_INLINE uint32_t ProfileHash(const uint8_t* p) {
+  uint32_t h = BROTLI_UNALIGNED_LOAD32LE(p) * kProfileHashMul32;
+  return h >> (32 - BROTLI_PROFILE_HASH_BITS);
+}
+
+/* Returns total compressed size of samples, 0 in case of error. */
+static size_t ProfileCost(BrotliEncoderState* s, const uint8_t* profile,
+    size_t num_samples, const size_t* sample_sizes, const uint8_t* samples,
+    uint8_t* out, size_t out_size) {
+  size_t total = 0;
+  size_t pos = 0;
+  size_t i;
+  if (!BrotliEncoderSetProfile(s, BROTLI_ENCODER_PROFILE_SIZE, profile)) {
+    return 0;
+  }
+  for (i = 0; i < num_samples; ++i) {
+    size_t available_in = sample_sizes[i];
+    const uint8_t* next_in = &samples[pos];
+    size_t available_out = out_size;
+    uint8_t* next_out = out;
+    if (!BrotliEncoderCompressStream(s, BROTLI_OPERATION_FINISH,
+            &available_in, &next_in, &available_out, &next_out, NULL) ||
+        !BrotliEncoderIsFinished(s)) {
+      return 0;
+    }
+    total += out_size - available_out;
+    pos += sample_sizes[i];
+    /* Profile and quality are kept. */
+    if (!BrotliEncoderResetInstance(s)) return 0;
+  }
+  return total;
+}
+
+BROTLI_BOOL BrotliEncoderTrainProfile(int quality, size_t num_samples,
+    const size_t sample_sizes[BROTLI_ARRAY_PARAM(num_samples)],
+    const uint8_t* samples,
+    uint8_t profile[BROTLI_ENCODER_PROFILE_SIZE]) {
+  MemoryManager memory_manager;
+  MemoryManager* m = &memory_manager;
+  ContextLut lut = BROTLI_CONTEXT_LUT(CONTEXT_UTF8);
+  HistogramLiteral* histograms;
+  HistogramLiteral* clustered;
+  uint32_t* table;
+  uint32_t symbols[BROTLI_PROFILE_NUM_CONTEXTS];
+  uint8_t candidate[BROTLI_ENCODER_PROFILE_SIZE];
+  BrotliEncoderState* state;
+  uint8_t* out;
+  size_t out_size;
+  size_t max_sample_size = 0;
+  size_t max_clusters;
+  size_t best_cost = 0;
+  size_t pos = 0;
+  size_t i;
+
+  if (num_samples == 0) return BROTLI_FALSE;
+  quality = BROTLI_MIN(int, BROTLI_MAX(int, quality, 3), 9);
+  for (i = 0; i < num_samples; ++i) {
+    max_sample_size = BROTLI_MAX(size_t, max_sample_size, sample_sizes[i]);
+  }
+  out_size = BrotliEncoderMaxCompressedSize(max_sample_size);
+  if (out_size == 0) return BROTLI_FALSE;
+
+  BrotliInitMemoryManager(m, 0, 0, 0);
+  histograms = BROTLI_ALLOC(m, HistogramLiteral, BROTLI_PROFILE_NUM_CONTEXTS);
+  clustered = BROTLI_ALLOC(m, HistogramLiteral, BROTLI_PROFILE_NUM_CONTEXTS);
+  table = BROTLI_ALLOC(m, uint32_t, (size_t)1 << BROTLI_PROFILE_HASH_BITS);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(histograms) ||
+      BROTLI_IS_NULL(clustered) || BROTLI_IS_NULL(table)) {
+    BrotliWipeOutMemoryManager(m);
+    return BROTLI_FALSE;
+  }
+  ClearHistogramsLiteral(histograms, BROTLI_PROFILE_NUM_CONTEXTS);
+  /* Cleared once: entries left by earlier samples fail the range check. */
+  memset(table, 0, sizeof(uint32_t) << BROTLI_PROFILE_HASH_BITS);
+
+  /* Only literals matter, so bytes a greedy match search of the sample
+     itself would copy are skipped; each sample is compressed on its own. */
+  for (i = 0; i < num_samples; ++i) {
+    uint8_t prev_byte = 0;
+    uint8_t prev_byte2 = 0;
+    size_t begin = pos;
+    size_t end = pos + sample_sizes[i];
+    while (pos < end) {
+      size_t context;
+      if (pos + BROTLI_PROFILE_MIN_MATCH <= end) {
+        uint32_t h = ProfileHash(&samples[pos]);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)pos;
+        if (candidate >= begin && candidate < pos &&
+            BROTLI_UNALIGNED_LOAD32LE(&samples[candidate]) ==
+            BROTLI_UNALIGNED_LOAD32LE(&samples[pos])) {
+          size_t len = BROTLI_PROFILE_MIN_MATCH;
+          while (pos + len < end && samples[candidate + len] ==
+                 samples[pos + len]) {
+            ++len;
+          }
+          pos += len;
+          prev_byte2 = samples[pos - 2];
+          prev_byte = samples[pos - 1];
+          continue;
+        }
+      }
+      context = BROTLI_CONTEXT(prev_byte, prev_byte2, lut);
+      HistogramAddLiteral(&histograms[context], samples[pos]);
+      prev_byte2 = prev_byte;
+      prev_byte = samples[pos];
+      ++pos;
+    }
+  }
+
+  /* Every meta-block pays for its own prefix codes; clustering the corpus
+     totals would trade them against far more literals than a sample has.
+     Rounding up keeps symbols that occur at all. */
+  for (i = 0; i < BROTLI_PROFILE_NUM_CONTEXTS; ++i) {
+    HistogramLiteral* h = &histograms[i];
+    size_t j;
+    h->total_count_ = 0;
+    for (j = 0; j < BROTLI_NUM_LITERAL_SYMBOLS; ++j) {
+      h->data_[j] = (uint32_t)((h->data_[j] + num_samples - 1) / num_samples);
+      h->total_count_ += h->data_[j];
+    }
+  }
+
+  /* Clustering estimates do not know which bytes the real match search
+     leaves as literals, nor what block splits cost; so every number of
+     clusters is tried on the samples themselves. */
+  state = BrotliEncoderCreateInstance(0, 0, 0);
+  out = BROTLI_ALLOC(m, uint8_t, out_size);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(out) || state == NULL) {
+    if (state != NULL) BrotliEncoderDestroyInstance(state);
+    BrotliWipeOutMemoryManager(m);
+    return BROTLI_FALSE;
+  }
+  BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, (uint32_t)quality);
+  for (max_clusters = 1; max_clusters <= BROTLI_MAX_STATIC_CONTEXTS;
+       ++max_clusters) {
+    size_t num_clusters = 0;
+    size_t cost;
+    BrotliClusterHistogramsLiteral(m, histograms, BROTLI_PROFILE_NUM_CONTEXTS,
+        max_clusters, clustered, &num_clusters, symbols);
+    if (BROTLI_IS_OOM(m)) break;
+    /* Clustering stopped on its own; more clusters do not change anything. */
+    if (num_clusters < max_clusters) break;
+    candidate[0] = BROTLI_PROFILE_MAGIC;
+    candidate[1] = (uint8_t)CONTEXT_UTF8;
+    candidate[2] = (uint8_t)num_clusters;
+    for (i = 0; i < BROTLI_PROFILE_NUM_CONTEXTS; ++i) {
+      candidate[3 + i] = (uint8_t)symbols[i];
+    }
+    cost = ProfileCost(state, candidate, num_samples, sample_sizes, samples,
+                       out, out_size);
+    if (cost == 0) break;
+    if (best_cost == 0 || cost < best_cost) {
+      best_cost = cost;
+      memcpy(profile, candidate, BROTLI_ENCODER_PROFILE_SIZE);
+    }
+  }
+  BrotliEncoderDestroyInstance(state);
+  BROTLI_FREE(m, out);
+  if (BROTLI_IS_OOM(m) || best_cost == 0) {
+    BrotliWipeOutMemoryManager(m);
+    return BROTLI_FALSE;
+  }
+
+  BROTLI_FREE(m, table);
+  BROTLI_FREE(m, clustered);
+  BROTLI_FREE(m, histograms);
+  return BROTLI_TRUE;
+}
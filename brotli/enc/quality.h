@@ -19,6 +19,14 @@
 #define ZOPFLIFICATION_QUALITY 10
 #define HQ_ZOPFLIFICATION_QUALITY 11
 
+/* Encoder built with BROTLI_ENCODER_FAST_ONLY lowers quality to 1, so it never
+   builds the tables of the built-in dictionary. */
+#if defined(BROTLI_ENCODER_FAST_ONLY)
+#define MAX_ENCODER_QUALITY FAST_TWO_PASS_COMPRESSION_QUALITY
+#else
+#define MAX_ENCODER_QUALITY BROTLI_MAX_QUALITY
+#endif
+
 #define MAX_QUALITY_FOR_STATIC_ENTROPY_CODES 2
 #define MIN_QUALITY_FOR_BLOCK_SPLIT 4
 #define MIN_QUALITY_FOR_NONZERO_DISTANCE_PARAMS 4
@@ -27,6 +35,8 @@
 #define MIN_QUALITY_FOR_CONTEXT_MODELING 5
 #define MIN_QUALITY_FOR_HQ_CONTEXT_MODELING 7
 #define MIN_QUALITY_FOR_HQ_BLOCK_SPLITTING 10
+/* Fastest quality that splits blocks and takes any distance parameters. */
+#define FIRST_BLOCK_QUALITY 4
 
 /* For quality below MIN_QUALITY_FOR_BLOCK_SPLIT there is no block splitting,
    so we buffer at most this much literals and commands. */
@@ -44,6 +54,15 @@ static BROTLI_INLINE size_t MaxHashTableSize(int quality) {
 /* Do not thoroughly search when a long copy is found. */
 #define BROTLI_LONG_COPY_QUICK_STEP 16384
 
+/* Qualities 5 to 9 search the shortest path through the matches of their hash
+   chains when BROTLI_PARAM_SHORTEST_PATH is set. */
+static BROTLI_INLINE BROTLI_BOOL UsesShortestPath(
+    const BrotliEncoderParams* params) {
+  return TO_BROTLI_BOOL(params->shortest_path &&
+      params->quality >= MIN_QUALITY_FOR_EXTENSIVE_REFERENCE_SEARCH &&
+      params->quality < ZOPFLIFICATION_QUALITY);
+}
+
 static BROTLI_INLINE size_t MaxZopfliLen(const BrotliEncoderParams* params) {
   return params->quality <= 10 ?
       MAX_ZOPFLI_LEN_QUALITY_10 :
@@ -57,7 +76,7 @@ static BROTLI_INLINE size_t MaxZopfliCandidates(
 }
 
 static BROTLI_INLINE void SanitizeParams(BrotliEncoderParams* params) {
-  params->quality = BROTLI_MIN(int, BROTLI_MAX_QUALITY,
+  params->quality = BROTLI_MIN(int, MAX_ENCODER_QUALITY,
       BROTLI_MAX(int, BROTLI_MIN_QUALITY, params->quality));
   if (params->quality <= MAX_QUALITY_FOR_STATIC_ENTROPY_CODES) {
     params->large_window = BROTLI_FALSE;
@@ -118,10 +137,75 @@ static BROTLI_INLINE size_t LiteralSpreeLengthForSparseSearch(
   return params->quality < 9 ? 64 : 512;
 }
 
+/* Limits of BROTLI_PARAM_HASHER_* values. */
+#define BROTLI_MIN_HASHER_BUCKET_BITS 10
+#define BROTLI_MAX_HASHER_BUCKET_BITS 24
+#define BROTLI_MAX_HASHER_BLOCK_BITS 10
+#define BROTLI_MAX_HASHER_NUM_LAST_DISTANCES 16
+
+/* Hashers that can serve any of qualities 2 to 9. */
+static BROTLI_INLINE BROTLI_BOOL IsConfigurableHasherType(int type) {
+  switch (type) {
+    case 2: case 3: case 4: case 5: case 6: case 35: case 40: case 41:
+    case 42: case 54: case 55: case 65:
+      return BROTLI_TRUE;
+    default:
+      return BROTLI_FALSE;
+  }
+}
+
+/* Forgetful chains scale their hop limit from quality 4 up. */
+static BROTLI_INLINE BROTLI_BOOL IsForgetfulChainHasher(int type) {
+  return TO_BROTLI_BOOL(type == 40 || type == 41 || type == 42);
+}
+
+static BROTLI_INLINE BROTLI_BOOL IsBucketedChainHasher(int type) {
+  return TO_BROTLI_BOOL(type == 5 || type == 6 || type == 65);
+}
+
+/* Hashers that do not read past the end of the input, so it does not need
+   the zeroed slack of the ring buffer. Chain hashers compare the byte after
+   the best match of every candidate; guarding it costs them more than the
+   copy of the input saves. */
+static BROTLI_INLINE BROTLI_BOOL ReadsInputInPlace(int type) {
+  return TO_BROTLI_BOOL(type == 2 || type == 3 || type == 4 || type == 54 ||
+      type == 35 || type == 55 || type == 10);
+}
+
+/* Applies BROTLI_PARAM_HASHER_* choices over the hasher picked by quality
+   and window. Qualities 0 and 1 do not use hashers, and zopflification
+   requires H10, so only qualities 2 to 9 are affected. */
+static BROTLI_INLINE void ApplyCustomHasher(const BrotliEncoderParams* params,
+                                            BrotliHasherParams* hparams) {
+  const BrotliHasherParams* custom = &params->custom_hasher;
+  if (params->quality < 2 || params->quality > 9) return;
+  if (IsForgetfulChainHasher(custom->type) && params->quality < 4) return;
+  if (custom->type != 0 && custom->type != hparams->type) {
+    hparams->type = custom->type;
+    if (IsBucketedChainHasher(hparams->type)) {
+      /* Tuning the defaults would have picked for H5 / H6. */
+      hparams->block_bits = params->quality - 1;
+      hparams->bucket_bits = (params->quality < 7 && hparams->type == 5) ?
+          14 : 15;
+      hparams->hash_len = 5;
+      hparams->num_last_distances_to_check =
+          params->quality < 7 ? 4 : params->quality < 9 ? 10 : 16;
+    }
+  }
+  if (!IsBucketedChainHasher(hparams->type)) return;
+  if (custom->bucket_bits != 0) hparams->bucket_bits = custom->bucket_bits;
+  if (custom->block_bits >= 0) hparams->block_bits = custom->block_bits;
+  if (custom->num_last_distances_to_check != 0) {
+    hparams->num_last_distances_to_check =
+        custom->num_last_distances_to_check;
+  }
+}
+
 static BROTLI_INLINE void ChooseHasher(const BrotliEncoderParams* params,
                                        BrotliHasherParams* hparams) {
   if (params->quality > 9) {
     hparams->type = 10;
+    hparams->tree_bits = params->custom_hasher.tree_bits;
   } else if (params->quality == 4 && params->size_hint >= (1 << 20)) {
     hparams->type = 54;
   } else if (params->quality < 5) {
@@ -160,6 +244,43 @@ static BROTLI_INLINE void ChooseHasher(const BrotliEncoderParams* params,
       hparams->type = 65;
     }
   }
+
+  ApplyCustomHasher(params, hparams);
+
+  if (params->long_distance_matching && params->quality >= 2 &&
+      params->quality <= 9 && params->lgwin > 16) {
+    /* Pair the match finder with the rolling hash of the large window
+       hashers; the closest base hasher is used for those without a pair. */
+    if (hparams->type == 2 || hparams->type == 3) {
+      hparams->type = 35;
+    } else if (hparams->type == 4 || hparams->type == 54) {
+      hparams->type = 55;
+    } else if (hparams->type == 5 || hparams->type == 6 ||
+               (hparams->type >= 40 && hparams->type <= 42)) {
+      if (hparams->type != 5 && hparams->type != 6) {
+        hparams->block_bits = params->quality - 1;
+        hparams->bucket_bits = 15;
+        hparams->num_last_distances_to_check =
+            params->quality < 7 ? 4 : params->quality < 9 ? 10 : 16;
+      }
+      hparams->hash_len = 5;
+      hparams->type = 65;
+    }
+  }
+
+  if (UsesShortestPath(params) && hparams->type != 5 && hparams->type != 6 &&
+      (hparams->type < 40 || hparams->type > 42)) {
+    /* Shortest path lists all matches of a chain: H65 drops to its chain
+       half, the others to the H6 that quality would have picked. */
+    if (hparams->type != 65) {
+      hparams->block_bits = params->quality - 1;
+      hparams->bucket_bits = 15;
+      hparams->num_last_distances_to_check =
+          params->quality < 7 ? 4 : params->quality < 9 ? 10 : 16;
+    }
+    hparams->hash_len = 5;
+    hparams->type = 6;
+  }
 }
 
 #endif  /* BROTLI_ENC_QUALITY_H_ */
@@ -12,6 +12,7 @@
 #include <string.h>  /* memcpy */
 
 #include "../common/platform.h"
+#include "../common/probes.h"
 #include <brotli/types.h>
 #include "./memory.h"
 #include "./quality.h"
@@ -37,6 +38,9 @@ typedef struct RingBuffer {
   const uint32_t total_size_;
 
   uint32_t cur_size_;
+  /* Size of the allocated data_ region (without slack); could be bigger than
+     cur_size_ when the buffer is reused for a new stream. */
+  uint32_t capacity_;
   /* Position to write in the ring buffer. */
   uint32_t pos_;
   /* The actual ring buffer containing the copy of the last two bytes, the data,
@@ -48,6 +52,7 @@ typedef struct RingBuffer {
 
 static BROTLI_INLINE void RingBufferInit(RingBuffer* rb) {
   rb->cur_size_ = 0;
+  rb->capacity_ = 0;
   rb->pos_ = 0;
   rb->data_ = 0;
   rb->buffer_ = 0;
@@ -67,21 +72,49 @@ static BROTLI_INLINE void RingBufferFree(MemoryManager* m, RingBuffer* rb) {
   BROTLI_FREE(m, rb->data_);
 }
 
+/* Rewinds the ring buffer to the empty state, but keeps allocated memory, so
+   that the next RingBufferInitBuffer calls do not need to allocate again. */
+static BROTLI_INLINE void RingBufferReset(RingBuffer* rb) {
+  rb->cur_size_ = 0;
+  rb->pos_ = 0;
+}
+
+/* Makes |dst| an independent copy of |src|; |dst| must be a bitwise copy of
+   |src| on entry. Only the part in use is allocated. */
+static BROTLI_INLINE void RingBufferCopy(
+    MemoryManager* m, RingBuffer* dst, const RingBuffer* src) {
+  static const size_t kSlackForEightByteHashingEverywhere = 7;
+  const size_t size = 2 + src->cur_size_ + kSlackForEightByteHashingEverywhere;
+  dst->data_ = 0;
+  dst->buffer_ = 0;
+  dst->capacity_ = 0;
+  if (!src->data_) return;
+  dst->data_ = BROTLI_ALLOC(m, uint8_t, size);
+  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(dst->data_)) return;
+  memcpy(dst->data_, src->data_, size);
+  dst->buffer_ = dst->data_ + 2;
+  dst->capacity_ = src->cur_size_;
+}
+
 /* Allocates or re-allocates data_ to the given length + plus some slack
    region before and after. Fills the slack regions with zeros. */
 static BROTLI_INLINE void RingBufferInitBuffer(
     MemoryManager* m, const uint32_t buflen, RingBuffer* rb) {
   static const size_t kSlackForEightByteHashingEverywhere = 7;
-  uint8_t* new_data = BROTLI_ALLOC(
-      m, uint8_t, 2 + buflen + kSlackForEightByteHashingEverywhere);
   size_t i;
-  if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(new_data)) return;
-  if (rb->data_) {
-    memcpy(new_data, rb->data_,
-        2 + rb->cur_size_ + kSlackForEightByteHashingEverywhere);
-    BROTLI_FREE(m, rb->data_);
+  if (!rb->data_ || buflen > rb->capacity_) {
+    uint8_t* new_data = BROTLI_ALLOC(
+        m, uint8_t, 2 + buflen + kSlackForEightByteHashingEverywhere);
+    if (BROTLI_IS_OOM(m) || BROTLI_IS_NULL(new_data)) return;
+    if (rb->data_) {
+      memcpy(new_data, rb->data_,
+          2 + rb->cur_size_ + kSlackForEightByteHashingEverywhere);
+      BROTLI_FREE(m, rb->data_);
+    }
+    rb->data_ = new_data;
+    rb->capacity_ = buflen;
+    BROTLI_PROBE2(encoder_ringbuffer_grow, rb, buflen);
   }
-  rb->data_ = new_data;
   rb->cur_size_ = buflen;
   rb->buffer_ = rb->data_ + 2;
   rb->buffer_[-2] = rb->buffer_[-1] = 0;
@@ -103,6 +103,9 @@ static BROTLI_BOOL BrotliFindAllStaticDictionaryMatchesFor(
       const size_t id = w.idx;
       end = !!(w.len & 0x80);
       w.len = (uint8_t)l;
+      /* Words too short for any transform to reach |min_length| are not
+         worth reading; suffixes add at most 7 bytes. */
+      if (l + 7 < min_length) continue;
       if (w.transform == 0) {
         const size_t matchlen =
             DictMatchLength(dictionary->words, data, id, l, max_length);
@@ -348,6 +351,7 @@ static BROTLI_BOOL BrotliFindAllStaticDictionaryMatchesFor(
       const size_t id = w.idx;
       end = !!(w.len & 0x80);
       w.len = (uint8_t)l;
+      if (l + 3 < min_length) continue;
       if (w.transform == 0) {
         const uint8_t* s;
         if (!IsMatch(dictionary->words, w, &data[1], max_length - 1)) {
@@ -443,6 +447,7 @@ static BROTLI_BOOL BrotliFindAllStaticDictionaryMatchesFor(
         const size_t id = w.idx;
         end = !!(w.len & 0x80);
         w.len = (uint8_t)l;
+        if (l + 3 < min_length) continue;
         if (w.transform == 0 &&
             IsMatch(dictionary->words, w, &data[2], max_length - 2)) {
           if (data[0] == 0xC2) {
@@ -472,6 +477,8 @@ static BROTLI_BOOL BrotliFindAllStaticDictionaryMatchesFor(
         const size_t id = w.idx;
         end = !!(w.len & 0x80);
         w.len = (uint8_t)l;
+        /* Prefix and suffixes add at most 13 bytes. */
+        if (l + 13 < min_length) continue;
         if (w.transform == 0 &&
             IsMatch(dictionary->words, w, &data[5], max_length - 5)) {
           AddMatch(id + (data[0] == ' ' ? 41 : 72) * n, l + 5, l, matches);
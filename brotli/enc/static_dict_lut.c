@@ -0,0 +1,322 @@
+/* Copyright 2015 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Lookup table for static dictionary and transforms. */
+
+#include "./static_dict_lut.h"
+
+#include "../common/dictionary.h"
+#include "../common/platform.h"
+#include "../common/transform.h"
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+BROTLI_INTERNAL uint16_t kStaticDictionaryBuckets[32768];
+BROTLI_INTERNAL DictWord kStaticDictionaryWords[31705];
+
+/* Bit per dictionary word of length 4 and more, in (length, index) order; set
+   for the words looked up with the first letter, or all letters, uppercased.
+   All the words are looked up as is. */
+static const uint8_t kUppercaseFirstWordBits[1688] = {
+0xFE,0xFF,0xDF,0xF7,0xF5,0xFF,0xFB,0x9F,0xBF,0xFB,0xFF,0xFF,0xFF,0xFF,0xF6,0xFF,
+0x77,0x7F,0xEB,0xFF,0xEB,0xFD,0xFF,0xF7,0xFF,0x7F,0xBF,0x7C,0xEF,0xFF,0x9A,0xF9,
+0xEE,0xEB,0xBF,0xFF,0x9F,0xFF,0xFB,0xFB,0xF1,0xFF,0xFE,0xEF,0xAF,0xFE,0x5F,0xFA,
+0xFF,0xBD,0xFF,0x6F,0x7B,0x77,0x9F,0xAC,0xF6,0x7F,0xE6,0x9F,0x7D,0x7B,0xFF,0xFD,
+0xF8,0x5D,0xB1,0x4D,0xDD,0xED,0xEF,0x5D,0xAF,0x5F,0xAC,0x5C,0x03,0x6D,0x1F,0x3E,
+0xD0,0xEF,0x1F,0x4B,0xAD,0xF8,0xCD,0xE7,0xBF,0xF1,0x6F,0xF0,0xAF,0x8D,0xED,0x89,
+0x8E,0x37,0x4C,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x80,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0x07,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFE,0xDE,0xA7,0x67,0x3F,0xDB,0xFD,0xFD,0xFF,0xF7,0xFF,0x7F,0xFF,0xBF,0xFD,
+0xFF,0xDB,0xEF,0xFD,0xFB,0x5F,0xFE,0xEE,0xFF,0x3B,0xFD,0xFF,0xFE,0xFF,0xE6,0xFF,
+0xB7,0xBF,0xF7,0x77,0x9E,0xFF,0xFF,0x7F,0xED,0xFE,0x19,0xFF,0xFB,0x5F,0x7C,0xFF,
+0xF9,0xBB,0xDB,0xFF,0xD0,0xFF,0xDB,0xFF,0x2F,0xDD,0xDD,0xF9,0xFF,0xEB,0xEF,0xFA,
+0xCD,0xB1,0xD5,0xFB,0x9F,0xD7,0xF4,0x4B,0xCB,0xF9,0x56,0xA6,0x35,0xDB,0xE7,0xF7,
+0x36,0xDF,0xEE,0xCE,0xE2,0x7E,0x98,0x6F,0xB5,0xDB,0xAB,0xE8,0xE6,0xE9,0xFA,0xF7,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xBF,
+0xDF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFD,0xBF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xBC,0x6F,0xFE,0xEE,0xFF,0x7B,0xF7,0xEF,0x6D,0xF7,0x7B,0xFF,0xC9,0xBB,0xFF,0xFF,
+0xFF,0xFE,0xEE,0xE6,0x7E,0xF6,0xDF,0xFF,0xFE,0xFD,0xBF,0xFD,0xFB,0x7D,0xBE,0xD7,
+0xBC,0x77,0x57,0x5B,0xF8,0x66,0xE5,0xD9,0xDD,0xDE,0xF7,0xEE,0x32,0x7B,0xFF,0xCD,
+0xFD,0xF7,0x77,0x5D,0xF8,0xFF,0xF7,0xEF,0xDC,0x4F,0x75,0x72,0xFE,0xB6,0x7F,0xB3,
+0xA7,0xE7,0xFE,0x7D,0x7E,0xF1,0xD8,0xFD,0xCD,0x20,0xC4,0x3C,0x75,0xE1,0x05,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x80,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,0xFD,0xEF,0xFF,0x7F,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x40,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x99,0xC6,0x7E,0x49,0x49,0xD5,0x7D,0x35,0xCB,0xEF,0xA5,0x0F,0x9D,0xD9,0xBA,0xC7,
+0xBB,0xE7,0x6F,0x7B,0xDC,0x76,0x25,0x48,0xBD,0xBB,0xF9,0xB6,0xEB,0x47,0xF5,0xD5,
+0x6B,0xE6,0xE6,0x7D,0x78,0xB3,0x9F,0xBF,0x3C,0xEA,0xF5,0x5E,0xDF,0x7F,0xD5,0xFA,
+0x56,0x2F,0x5F,0xAE,0x4B,0x57,0xFE,0x3D,0xDF,0x2E,0x9B,0x50,0x45,0x4A,0xB7,0xF0,
+0x3E,0x57,0x1C,0xF7,0x6F,0xC6,0x3B,0xFA,0xDF,0xF9,0xD7,0xBF,0xED,0xCD,0xE9,0xFF,
+0x5E,0xAE,0xFE,0x53,0x79,0xF7,0x1E,0x5B,0xDF,0x8A,0xB5,0x1B,0xD1,0xF3,0x37,0xAC,
+0x2D,0x78,0xC4,0x77,0xE4,0xFB,0xFB,0x6B,0xFD,0x6B,0xAE,0xE9,0x7C,0xA1,0x4C,0x79,
+0xF0,0xBF,0x1C,0xF7,0xF9,0xDB,0xDE,0x5E,0x75,0x4D,0x6F,0x5F,0xFF,0xFF,0xB6,0xC9,
+0xBD,0xFD,0xFF,0xD8,0xE5,0xB9,0xD7,0x9E,0xAF,0xAF,0x95,0x69,0xB2,0x6D,0xB7,0x65,
+0xFF,0xDB,0x9F,0x2F,0x5D,0xAF,0xFF,0xAD,0x7B,0x87,0xFD,0x9E,0x73,0xFE,0x7F,0xE5,
+0xF9,0xB3,0x2D,0x44,0x37,0xED,0xBE,0xFA,0xB7,0x6F,0x3D,0xA7,0xFF,0xBF,0x6C,0xCB,
+0xB7,0xFB,0x76,0xFF,0x93,0xF7,0xFD,0x7D,0xF7,0x17,0xEE,0xFE,0xBF,0xD1,0x1B,0xBB,
+0x74,0xFF,0x5F,0xB2,0xFF,0xE2,0xBB,0xE7,0xFE,0xE6,0xBA,0xF9,0x7F,0x3F,0x5F,0xF7,
+0xB7,0x7D,0xFD,0x3F,0xDF,0xFF,0xFA,0x7E,0xDE,0xC7,0x57,0xFF,0xEF,0xE5,0x77,0xF0,
+0xBF,0xFB,0xFD,0xCA,0x6A,0xEB,0xF9,0x7E,0x7D,0xDE,0xBA,0xD7,0xB3,0xD9,0xEF,0xBB,
+0x8E,0x49,0x49,0xFF,0xFF,0xFF,0xFF,0xFF,0xF7,0xFF,0xBF,0xFF,0xFF,0xFF,0xFF,0xFE,
+0xEF,0xFE,0x7B,0xFE,0xDF,0xFF,0x7B,0xDF,0xFD,0xBF,0xFF,0xFF,0xFF,0xBF,0xFB,0xFF,
+0xEF,0xFF,0x7F,0x6E,0xFF,0xFF,0xFF,0x7F,0xBD,0xFE,0xC7,0xFE,0xDF,0xFF,0xAE,0xF7,
+0xFB,0xD0,0xFB,0xCF,0xDD,0x7B,0x69,0xFD,0xEC,0x4D,0xDF,0x5C,0xB7,0x5E,0xC3,0xF3,
+0x77,0x6D,0xEF,0x9F,0xDF,0xB7,0xAB,0x7C,0xD5,0xAF,0xD6,0xFA,0xD7,0xFF,0xBD,0x2B,
+0xEF,0x11,0xB5,0xAF,0x50,0x0B,0xDF,0xCC,0xFF,0xFE,0xA3,0xEE,0x3E,0xFF,0xFF,0xFF,
+0xB9,0x3F,0x5D,0x68,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0xDF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x6F,0xFF,0xF0,0xFF,0xF5,0x9B,0xFD,0xFB,0x9F,0xFF,0x7F,0xDF,0x34,0xAB,0xFA,0xFB,
+0xBB,0xEE,0x7D,0xDE,0x66,0xEF,0xF7,0x7F,0xFE,0xEE,0xEE,0xFD,0x9F,0xFF,0x5A,0x7E,
+0xCD,0xFB,0x7F,0xFC,0x4E,0x72,0xFF,0xEF,0x7A,0xEE,0xFF,0x7E,0x7F,0xDF,0xEF,0xC6,
+0xED,0xFF,0xED,0x7F,0xFF,0x6F,0xDD,0xC3,0x7E,0x7F,0xBF,0xCE,0xF7,0xFE,0xE2,0xBE,
+0x7F,0xFF,0xFB,0xF7,0xFF,0xFF,0xDE,0x7D,0x79,0xFB,0xFF,0x9D,0xDE,0xC3,0xF9,0xEF,
+0xC5,0x63,0xFF,0xFE,0xAD,0xF7,0xFF,0xF3,0xE7,0x8D,0xFF,0xBF,0x7F,0xE8,0x6E,0xF5,
+0xEF,0xE7,0x7D,0x4D,0x35,0x00,0x00,0x00,0x80,0xFF,0xFE,0xFD,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0x01,0x00,0x08,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x73,0xE0,0xB3,0xB5,0xAF,0x62,0x9E,0x3D,0x9F,0xFB,0xBB,0xDD,0xFB,0xCF,0xFE,0xF5,
+0xAB,0xFE,0x2B,0xAF,0x7E,0x6F,0x2C,0xFF,0xEF,0x4C,0xFE,0xBC,0x7F,0xCF,0xBF,0x0F,
+0x35,0xFC,0xCE,0x7F,0xB7,0xD6,0xF9,0xEB,0x75,0xDF,0xCF,0xAC,0x1E,0x5C,0xFD,0xDD,
+0xFF,0xFF,0x7E,0xBF,0xFE,0xAF,0xF7,0xD0,0xAE,0xFF,0xFF,0xCF,0xE1,0x37,0xEB,0xB9,
+0xFE,0x7D,0xF6,0xDF,0xFF,0xD5,0xFE,0xF7,0xFF,0xE3,0x77,0xFC,0xFF,0xB9,0xEF,0xED,
+0xF7,0xB7,0xEF,0xFF,0xFF,0x7F,0xFB,0x7F,0xFE,0xFF,0xFE,0xEF,0xFF,0x3F,0xE6,0xF6,
+0xB2,0xEC,0x97,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x0F,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x51,0xA3,0xF6,0x8E,0x3F,0x55,0xBF,0xCB,0xB2,0xD7,0xFD,0xFA,0x2A,0xCF,0xE9,0x9F,
+0xFF,0xF3,0x79,0xEE,0xC7,0x02,0xBA,0x13,0x7B,0xF7,0xF6,0x7B,0x7F,0xFD,0xEF,0x7F,
+0xFE,0x77,0x9D,0x5B,0xF9,0xEF,0xE7,0xFF,0xBF,0xFF,0x76,0xAD,0xA5,0xA7,0xBD,0xF5,
+0xEA,0xFF,0xFE,0xAF,0xBF,0xDF,0xB5,0xFF,0xED,0xCB,0xFE,0xF3,0xFF,0xEB,0xDF,0xEA,
+0xF8,0xFB,0xFB,0x9F,0xFE,0xFD,0x7F,0xFD,0x7A,0xF0,0xCF,0x7F,0x7F,0xFE,0x3F,0xEF,
+0xFF,0xDF,0xDF,0xFD,0xFF,0xF7,0xFB,0x7F,0xFF,0x7F,0xFB,0x7F,0xFD,0xDF,0xFB,0x5B,
+0xFF,0x7F,0xF6,0xFF,0x7F,0xFF,0xCF,0x7D,0xFF,0xFB,0xED,0xFF,0xFF,0xA9,0xFF,0x7D,
+0xFF,0x5F,0xEF,0xAF,0xFF,0xFE,0xBF,0xFF,0xFC,0xF7,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0x3B,0x4D,0x8A,0xDB,0x4D,0xCA,0x5F,0xB8,0xDF,0x99,0x79,0x9E,0xD3,0x33,0xBF,0xED,
+0x5D,0xD1,0xBD,0x39,0xD7,0xEA,0xCD,0xBF,0xEF,0x67,0xFF,0xDF,0xD7,0x31,0xBB,0xFB,
+0xDC,0xAF,0x9F,0xDF,0xF7,0xFF,0x7F,0x73,0x6F,0xDF,0x7E,0xFF,0xFF,0xE7,0xFE,0x5F,
+0xFF,0x7B,0xFF,0xFF,0x77,0xFD,0xFE,0xFF,0xFF,0xD4,0xEF,0xFF,0xFF,0xFD,0x9F,0xEB,
+0xFF,0xFB,0xBF,0xFD,0xD7,0xF9,0xE7,0xBF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0x6F,0xFF,
+0x1E,0x00,0xF0,0xFF,0xFF,0xFF,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x12,0x95,0x7F,0xBD,0xBE,0xCC,0xB5,0x7F,0xC7,0x3E,0x67,0xBF,0xEC,0xC7,0xFE,0x70,
+0xDB,0xAD,0xFF,0xFD,0xE7,0x9E,0xAF,0xF9,0xED,0xD7,0xF6,0xFF,0xBF,0xDE,0xF7,0xF7,
+0xBB,0x7D,0xE5,0xFB,0x9F,0xF6,0xFF,0x9B,0x7F,0x7B,0xFD,0xFD,0xFC,0x2A,0xF3,0xFE,
+0xCB,0x7F,0xFE,0xFF,0x7D,0xFF,0x7F,0xEF,0xEF,0x7F,0x4F,0x5F,0xFF,0xEF,0xFA,0xFF,
+0xB2,0x79,0x04,0x42,0xDE,0xF3,0xA6,0xDE,0xAA,0x61,0xAB,0xBC,0x16,0x66,0x2B,0x76,
+0x85,0x89,0x7B,0xFB,0xAF,0x57,0xF3,0xFF,0xF6,0xEF,0x97,0x7E,0xB1,0xFD,0xFD,0x8F,
+0xD5,0xF7,0xB7,0xFE,0xB7,0xD7,0x7A,0x67,0xCF,0x6C,0x75,0xFF,0x7E,0xFF,0xBD,0xFF,
+0xCF,0xDA,0xFF,0xFB,0xF5,0xD5,0x18,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x71,0x2A,0xFF,0x56,0xA3,0x62,0x71,0xF3,0x88,0xB5,0xF6,0xDF,0xFF,0xFF,0xFA,0xFD,
+0x3B,0xFF,0x3C,0xFD,0xEB,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x8D,0x80,0x06,0x5F,0x25,0xBE,0x94,0xE9,0xBD,0xC3,0x1A,0x05,0x00,0x00,0x00,0x00,
+0xC5,0x34,0x1B,0xC4,0xF8,0x9F,0x5B,0xDB,0xDE,0xBD,0x2F,0xF7,0xFF,0xFE,0xDD,0xFF,
+0xFD,0x04,0x51,0x6E,0x55,0xEC,0xE6,0xE4,0xCE,0x22,0xDD,0x67,0xFD,0xDF,0xFF,0x3C,
+0x38,0x7F,0x98,0x10,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xEB,0x43,0x72,0x94,0x37,0xDF,0x01,0x16,0x1C,0xF7,0xAB,0x3F,0xF6,0xF6,0xEF,0xED,
+0xB8,0x8C,0x80,0x4C,0xB5,0x29,0xAC,0x97,0xFB,0x6B,0xFE,0x77,0xFF,0x6F,0x00,0x00,
+0x97,0x68,0x64,0x31,0x00,0x00,0x00,0x00,0x83,0xD7,0xB0,0xE8,0xC3,0xFA,0x94,0x03,
+0x0A,0xD5,0x06,0xDF,0xE4,0x78,0x00,0x00
+};
+
+static const uint8_t kUppercaseAllWordBits[1688] = {
+0xFF,0xBF,0xF7,0xFD,0xBF,0xFF,0x7F,0xFF,0xBF,0xFB,0xFF,0xFF,0xFF,0xFF,0xFE,0xFF,
+0xF7,0x7F,0xFB,0xFF,0xFB,0xFD,0xFF,0xFF,0xFF,0x7F,0xBF,0xFE,0xFF,0xFF,0x9E,0xFB,
+0xEE,0xEF,0xFF,0xFF,0xFF,0xFF,0xFB,0xFF,0xFF,0xFF,0xFF,0xFF,0xAF,0xFE,0xFF,0xFA,
+0xFF,0xBD,0xFF,0x7F,0xFB,0x77,0x8F,0xBE,0xF7,0x7F,0xFE,0xBF,0x6D,0x7F,0xFF,0xFD,
+0xF9,0x7D,0xB1,0x55,0xDD,0xED,0xEF,0x7F,0xAD,0x7F,0x9C,0x7C,0x5B,0x3D,0x5F,0xBC,
+0xD1,0xFB,0x1F,0x4B,0xAD,0xF2,0xDD,0xE7,0xFF,0xFD,0x6F,0xB5,0xBF,0x8D,0xFD,0xC9,
+0x2E,0x33,0x4F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x80,0x7E,
+0xF9,0xFF,0xFD,0xFF,0xFF,0x07,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFD,0xFF,0x5F,0xFF,0xFF,0xFF,0xFB,0xFF,0xFF,0xFF,0xFF,0xE7,0xFF,
+0xBF,0xBF,0xF7,0x7F,0x9E,0xFF,0xFF,0xFF,0xEF,0xFF,0x5B,0xFF,0xFF,0x5F,0x7F,0xFF,
+0xFD,0xBF,0xFB,0xFF,0xF4,0xFF,0xDF,0xFF,0x2F,0xFF,0xFF,0xFB,0xFF,0xEF,0xFF,0xFE,
+0xCF,0xBD,0xFD,0xFF,0xBF,0xD7,0xF6,0xCF,0xEB,0xFF,0x5E,0xF6,0xB7,0xF7,0xE7,0xFF,
+0x37,0xDF,0xAE,0xFE,0xF6,0x7E,0xDF,0xFB,0xF7,0xFB,0xFD,0xFE,0xE7,0xDB,0xFA,0xF7,
+0xCF,0xFF,0xF1,0xFF,0xBF,0x7F,0xFB,0xFF,0xFF,0x7F,0xFB,0xBF,0xFF,0xDF,0xFF,0xBF,
+0xDF,0xFF,0xDF,0xEF,0xFF,0xFF,0xFF,0xBF,0xFF,0xFD,0xB7,0x77,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xEF,0xFF,0xFF,0xFE,0xFF,0xFF,0xFF,0xFD,0xBF,0xFD,0xFF,0xFF,0xBF,0xFF,
+0xBF,0x77,0x77,0xFB,0xFF,0xF7,0xED,0xFD,0xDD,0xFF,0xFF,0xFF,0xBF,0x7F,0xFF,0xEF,
+0xFD,0xFF,0xFF,0x5D,0xFD,0xBF,0xF7,0xFF,0xFD,0x5F,0x7D,0xF7,0xFF,0xFE,0x7F,0xFF,
+0xE7,0xF7,0xFF,0xFD,0x7F,0xFB,0xDC,0xFF,0xEF,0x3F,0xEF,0xFC,0xFF,0xFB,0x05,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x80,0xFF,0xF7,0xFF,0xDE,0xF7,
+0xFB,0xFB,0xFF,0xDE,0xF7,0xBF,0xFF,0xFF,0xFF,0xB7,0xF3,0xF5,0xE9,0x2B,0xBF,0x6F,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x40,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xDF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xF7,0xFF,0x7B,0xFD,0x7F,0xFF,0xDA,0xFF,0xBF,0xFB,0xFF,0xEB,0xFF,0xF5,0xF7,
+0xFF,0xFF,0xFE,0xFF,0xFB,0xFF,0xFF,0xBF,0x7D,0xFF,0xFF,0xDF,0xFF,0xFF,0xDD,0xFB,
+0x7F,0xFF,0xFF,0xFE,0xFF,0xF7,0xFF,0x7F,0xFF,0x6E,0xFF,0xF7,0xF7,0xFF,0xFF,0xFE,
+0x7F,0x7F,0x5F,0xFF,0xFF,0xEF,0xFB,0xFB,0xFF,0xFF,0xFF,0xFF,0xFF,0xDF,0xFF,0xFF,
+0x7F,0xFE,0xFF,0xDF,0xFB,0xFF,0xDF,0xFF,0xEF,0xDF,0xFF,0xFB,0xF3,0xF7,0xFF,0xFF,
+0x7F,0xFD,0xCF,0xFF,0xE7,0xFF,0xFF,0x7B,0xFD,0xEB,0xFF,0xFB,0x7D,0xF1,0xFC,0x79,
+0xFD,0xBF,0xFF,0xFF,0xFD,0xDF,0xDF,0xDE,0xFF,0xCD,0xEF,0x7F,0xFF,0xFF,0xB7,0xED,
+0xFF,0xFF,0xFF,0xDD,0xF7,0xFB,0xF7,0xFF,0xFF,0xBF,0xDF,0xFF,0xBB,0xEF,0xBF,0x7D,
+0xFF,0xDF,0xFF,0xFF,0xFF,0xFF,0xFF,0xED,0x7F,0xFF,0xED,0xFE,0xFF,0xFE,0x7F,0xFF,
+0xFD,0xFB,0x2F,0x7F,0xFF,0xFD,0xBF,0xFE,0xFF,0x7F,0xFF,0xF7,0xFF,0xFF,0xFD,0xAF,
+0xFF,0xFF,0xF6,0xFF,0xDF,0xFF,0xFD,0xFD,0xFF,0xFF,0xFE,0xFE,0xBF,0xFB,0xDF,0xFF,
+0x7E,0xFF,0xFF,0xFB,0xFF,0xFE,0xFF,0xFF,0xFE,0xEE,0xFF,0xFF,0x7F,0xBF,0xDF,0xF7,
+0xF7,0xFF,0xFF,0x7F,0xFF,0xFF,0xFF,0xFF,0xFE,0xFF,0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,
+0xFF,0xFB,0xFF,0xEF,0xEA,0xFF,0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,0xF3,0xFF,0xFF,0xFB,
+0xFF,0xFB,0x39,0xEF,0xBC,0xF7,0xEB,0xF6,0xF7,0xFF,0xBA,0xBF,0x7F,0x9E,0x3B,0xEE,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFD,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0x7F,0x7F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xDF,0xFE,0xDF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7D,0xFF,0xFF,0xFF,0xDF,0xD7,0xFF,
+0xFF,0x7F,0xFF,0xBF,0xFF,0xFF,0xFF,0x7E,0xFF,0xFF,0xFE,0xFF,0xFF,0xFF,0xFF,0xEF,
+0xEF,0xFF,0xFF,0xFF,0xFF,0xBF,0xFF,0xFB,0xFF,0xFE,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0x09,0xFE,0x7F,0xF7,0x7F,0xFB,0xBD,0xF6,0xF6,0x2F,0xDB,0xFF,0xEA,
+0xFD,0x13,0xCF,0x27,0xBB,0xCF,0x77,0xF9,0x3D,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xB7,0xFF,0xFF,0xFF,
+0xFB,0xFF,0xFF,0xFF,0xEF,0xFF,0xF7,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFE,
+0xFF,0xFF,0xFD,0xFF,0xFF,0x7F,0xFD,0xF3,0xFF,0xFF,0xBF,0xFF,0xFF,0xFF,0xFF,0xBF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xDF,0xDF,0x7F,0xFF,0xFB,0xFF,0xDF,0xFE,0xFF,0xFB,0xFF,
+0xFF,0x7B,0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,0xFF,0xFD,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xEF,0x05,0x00,0x00,0x00,0x80,0xBE,0xFA,0xED,0xCF,0x71,0x7D,0xEF,
+0xAF,0xBB,0x01,0x00,0x08,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xDF,0xFF,0xFD,0xFF,0xFF,0xDF,0xFF,0xFF,0xFF,0xBF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFB,0xFE,0xBF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0xFE,0xFF,0xFF,0xFF,0xFF,0xEF,
+0xFF,0xFF,0xFE,0xFF,0xFF,0xF7,0xFF,0xFF,0x7F,0xFF,0xEF,0xFF,0x5F,0x7E,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xBF,0xFE,0xEF,0xFF,0xDE,0xEF,0xFF,0xFF,0xFF,0xFF,0x3F,0xFF,0xBF,
+0xFE,0xFD,0xFF,0xFF,0xFF,0xDF,0xFE,0xF7,0xFF,0xEF,0xFF,0xFF,0xFF,0xBF,0xFF,0xEF,
+0xFF,0xF7,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,
+0xFF,0xFF,0x87,0xCD,0x37,0xE7,0xFB,0xF7,0xB5,0x0E,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFE,0xFF,0xFF,0xFF,0xFF,0xFF,0xFB,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xDF,0xFF,0xFF,0xFB,0xFF,0xFF,0xFF,0xFF,0xFF,0xFD,0xFF,0xFF,
+0xFF,0x7F,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFD,0xFF,0xBD,0xF7,
+0xFB,0xFF,0xFE,0xEF,0xFF,0xDF,0xFF,0xFF,0xEF,0xDF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,0xFF,0xFF,0xFF,0x3F,0xFF,
+0xFF,0xDF,0xDF,0xFD,0xFF,0xFF,0xFB,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x5F,
+0xFF,0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,0x7D,0xFF,0xFF,0xFF,0xFF,0xFF,0xA1,0xFF,0xFF,
+0xFF,0xDF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFE,0xF7,0x7D,0xE0,0xF4,0xD7,0x5E,0xBE,
+0xBF,0xFF,0xBF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFB,0xFF,0xFF,
+0x7F,0xFF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,
+0xFE,0xFF,0xFF,0xFF,0xF7,0xFF,0xFF,0xFF,0xFF,0xFF,0x7E,0xFF,0xFF,0xFF,0xFE,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFD,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xF9,
+0xFF,0xFB,0xFF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0x1F,0x00,0x20,0xEB,0x77,0x8D,0x37,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xBF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xBF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFE,0xFF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xBF,0x7F,0xFF,0xFF,0xFF,0x15,
+0xFF,0xFF,0xBF,0xFF,0xFF,0xFF,0xFF,0xFF,0xBF,0xFF,0xFF,0xDF,0xFF,0xFF,0xFF,0xFF,
+0xB7,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xBF,0xDF,0xFF,0xFF,0xFF,0xFF,0xFD,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xEF,0xFF,0xFF,0xF7,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFB,0xFF,0xFF,0xFF,0xAF,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x05,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,0xFF,0xFD,0xFE,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFB,0xFF,0xFF,0xFF,0xFF,0xFF,0xFD,
+0xFF,0xFF,0xFF,0x1F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x7F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+0xFF,0xFF,0xFF,0xFF,0xFF,0xEF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x2F,0x00,0x00,
+0xFF,0xFF,0xFF,0xFF,0x07,0x00,0x00,0x00,0xFF,0xFF,0xBF,0xFF,0xFF,0xEF,0xEF,0x01,
+0xDF,0xFF,0xFF,0xDF,0xFF,0xFF,0x03,0x00
+};
+
+/* Default transforms that uppercase the first letter, and all letters. */
+#define UPPERCASE_FIRST_TRANSFORM_ID 9
+#define UPPERCASE_ALL_TRANSFORM_ID 44
+
+/* In pass 0 counts the words of each bucket; in pass 1 stores the word right
+   below the bucket offset, and moves the offset down. */
+static void PlaceWord(int pass, const BrotliDictionary* dict, int len,
+    uint8_t transform, uint32_t idx) {
+  uint8_t word[BROTLI_MAX_DICTIONARY_WORD_LENGTH];
+  int transform_id = 0;
+  uint32_t key;
+  if (transform == BROTLI_TRANSFORM_UPPERCASE_FIRST) {
+    transform_id = UPPERCASE_FIRST_TRANSFORM_ID;
+  } else if (transform == BROTLI_TRANSFORM_UPPERCASE_ALL) {
+    transform_id = UPPERCASE_ALL_TRANSFORM_ID;
+  }
+  BrotliTransformDictionaryWord(word,
+      &dict->data[dict->offsets_by_length[len] + (size_t)len * idx], len,
+      BrotliGetTransforms(), transform_id);
+  key = (BROTLI_UNALIGNED_LOAD32LE(word) * kDictHashMul32) >>
+      (32 - kDictNumBits);
+  if (pass == 0) {
+    kStaticDictionaryBuckets[key]++;
+  } else {
+    DictWord* w = &kStaticDictionaryWords[--kStaticDictionaryBuckets[key]];
+    w->len = (uint8_t)((w->len & 0x80) | len);
+    w->transform = transform;
+    w->idx = (uint16_t)idx;
+  }
+}
+
+/* Visits the words backwards: words within a bucket are ordered by length and
+   index, words as is before uppercased ones. */
+static void PlaceWords(int pass, const BrotliDictionary* dict) {
+  int uppercase;
+  for (uppercase = 1; uppercase >= 0; --uppercase) {
+    size_t bit = sizeof(kUppercaseFirstWordBits) * 8;
+    int len;
+    for (len = BROTLI_MAX_DICTIONARY_WORD_LENGTH;
+         len >= BROTLI_MIN_DICTIONARY_WORD_LENGTH; --len) {
+      uint32_t idx = dict->size_bits_by_length[len] ?
+          (1u << dict->size_bits_by_length[len]) : 0;
+      while (idx-- > 0) {
+        const uint8_t mask = (uint8_t)(1u << (--bit & 7));
+        if (!uppercase) {
+          PlaceWord(pass, dict, len, 0, idx);
+          continue;
+        }
+        if (kUppercaseAllWordBits[bit >> 3] & mask) {
+          PlaceWord(pass, dict, len, BROTLI_TRANSFORM_UPPERCASE_ALL, idx);
+        }
+        if (kUppercaseFirstWordBits[bit >> 3] & mask) {
+          PlaceWord(pass, dict, len, BROTLI_TRANSFORM_UPPERCASE_FIRST, idx);
+        }
+      }
+    }
+  }
+}
+
+void BrotliInitStaticDictionaryLut(void) {
+  const BrotliDictionary* dict = BrotliGetDictionary();
+  /* Unused; makes offsets start from 1. */
+  size_t end = 1;
+  size_t i;
+  PlaceWords(0, dict);
+  /* Buckets point past their last word... */
+  for (i = 0; i < 32768; ++i) {
+    if (kStaticDictionaryBuckets[i] != 0) {
+      end += kStaticDictionaryBuckets[i];
+      kStaticDictionaryBuckets[i] = (uint16_t)end;
+      kStaticDictionaryWords[end - 1].len = 0x80;
+    }
+  }
+  /* ...and to the first one, once all the words are in place. */
+  PlaceWords(1, dict);
+}
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}  /* extern "C" */
+#endif
@@ -10,6 +10,13 @@
 
 #include <brotli/types.h>
 
+#if defined(BROTLI_TARGET_X64)
+#include <emmintrin.h>
+#elif defined(BROTLI_TARGET_NEON) && defined(BROTLI_TARGET_ARMV8_64)
+#include <arm_neon.h>
+#define BROTLI_ASCII_NEON
+#endif
+
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" {
 #endif
@@ -64,6 +71,39 @@ static size_t BrotliParseAsUTF8(
   return 1;
 }
 
+size_t BrotliASCIIRunLength(
+    const uint8_t* data, size_t length, BROTLI_BOOL allow_zero) {
+  size_t i = 0;
+#if defined(BROTLI_TARGET_X64)
+  /* SSE2 is baseline on x86-64. */
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + BROTLI_ASCII_BLOCK_SIZE <= length; i += BROTLI_ASCII_BLOCK_SIZE) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(const void*)&data[i]);
+    int stop = _mm_movemask_epi8(v);
+    if (!allow_zero) stop |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    if (stop != 0) break;
+  }
+#elif defined(BROTLI_ASCII_NEON)
+  for (; i + BROTLI_ASCII_BLOCK_SIZE <= length; i += BROTLI_ASCII_BLOCK_SIZE) {
+    uint8x16_t v = vld1q_u8(&data[i]);
+    if (vmaxvq_u8(v) >= 0x80) break;
+    if (!allow_zero && vminvq_u8(v) == 0) break;
+  }
+#else
+  const uint64_t high = 0x8080808080808080ULL;
+  const uint64_t low = 0x0101010101010101ULL;
+  for (; i + BROTLI_ASCII_BLOCK_SIZE <= length; i += BROTLI_ASCII_BLOCK_SIZE) {
+    uint64_t a = BROTLI_UNALIGNED_LOAD64LE(&data[i]);
+    uint64_t b = BROTLI_UNALIGNED_LOAD64LE(&data[i + 8]);
+    uint64_t stop = (a | b) & high;
+    /* Exact "has a zero byte" test. */
+    if (!allow_zero) stop |= ((a - low) & ~a & high) | ((b - low) & ~b & high);
+    if (stop != 0) break;
+  }
+#endif
+  return i;
+}
+
 /* Returns 1 if at least min_fraction of the data is UTF8-encoded.*/
 BROTLI_BOOL BrotliIsMostlyUTF8(
     const uint8_t* data, const size_t pos, const size_t mask,
@@ -72,8 +112,20 @@ BROTLI_BOOL BrotliIsMostlyUTF8(
   size_t i = 0;
   while (i < length) {
     int symbol;
-    size_t bytes_read =
-        BrotliParseAsUTF8(&symbol, &data[(pos + i) & mask], length - i);
+    size_t masked_pos = (pos + i) & mask;
+    size_t bytes_read;
+    if (data[masked_pos] - 1u < 0x7Fu) {
+      /* Runs of ASCII are counted a block at a time, up to the ring end. */
+      size_t run = BrotliASCIIRunLength(&data[masked_pos],
+          BROTLI_MIN(size_t, length - i - 1, mask - masked_pos) + 1,
+          BROTLI_FALSE);
+      if (run != 0) {
+        size_utf8 += run;
+        i += run;
+        continue;
+      }
+    }
+    bytes_read = BrotliParseAsUTF8(&symbol, &data[masked_pos], length - i);
     i += bytes_read;
     if (symbol < 0x110000) size_utf8 += bytes_read;
   }
@@ -25,6 +25,14 @@ BROTLI_INTERNAL BROTLI_BOOL BrotliIsMostlyUTF8(
     const uint8_t* data, const size_t pos, const size_t mask,
     const size_t length, const double min_fraction);
 
+/* Returns the length of the leading run of 7-bit bytes in data[0, length),
+   in whole blocks of BROTLI_ASCII_BLOCK_SIZE bytes; zero bytes end the run
+   unless allow_zero. Callers finish the tail byte by byte. */
+BROTLI_INTERNAL size_t BrotliASCIIRunLength(
+    const uint8_t* data, size_t length, BROTLI_BOOL allow_zero);
+
+#define BROTLI_ASCII_BLOCK_SIZE 16
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
@@ -80,6 +80,51 @@ static BROTLI_INLINE void BrotliWriteBitsPrepareStorage(
   array[pos >> 3] = 0;
 }
 
+/* Bit writer that gathers bits in a 64-bit accumulator and stores whole
+   words, for loops that emit many short codes in a row. The stream format
+   and the storage requirements are those of BrotliWriteBits: bits above
+   the position are zero, and 8 bytes after it are writable.
+
+   Position kept in a size_t is stale while a writer is active; get it with
+   BrotliBitWriterSync, and re-init the writer after writing with
+   BrotliWriteBits. */
+typedef struct BrotliBitWriter {
+  uint64_t bits;     /* Pending bits, least significant first. */
+  size_t bit_count;  /* Number of pending bits, less than 64. */
+  uint8_t* next;     /* Byte that holds the first pending bit. */
+} BrotliBitWriter;
+
+static BROTLI_INLINE void BrotliBitWriterInit(
+    BrotliBitWriter* w, size_t pos, uint8_t* array) {
+  w->next = &array[pos >> 3];
+  w->bit_count = pos & 7;
+  w->bits = *w->next & ((1u << w->bit_count) - 1);
+}
+
+/* Same as BrotliWriteBits: up to 56 bits in one go. */
+static BROTLI_INLINE void BrotliBitWriterPut(
+    BrotliBitWriter* w, size_t n_bits, uint64_t bits) {
+  BROTLI_DCHECK((bits >> n_bits) == 0);
+  BROTLI_DCHECK(n_bits <= 56);
+  if (w->bit_count + n_bits >= 64) {
+    /* Store all pending bits; keep the ones of the last partial byte. */
+    BROTLI_UNALIGNED_STORE64LE(w->next, w->bits);
+    w->next += w->bit_count >> 3;
+    w->bits >>= w->bit_count & ~(size_t)7;
+    w->bit_count &= 7;
+  }
+  w->bits |= bits << w->bit_count;
+  w->bit_count += n_bits;
+}
+
+/* Stores pending bits and returns the position after them. The writer
+   stays usable. */
+static BROTLI_INLINE size_t BrotliBitWriterSync(
+    BrotliBitWriter* w, uint8_t* array) {
+  BROTLI_UNALIGNED_STORE64LE(w->next, w->bits);
+  return (size_t)(w->next - array) * 8 + w->bit_count;
+}
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  /* extern "C" */
 #endif
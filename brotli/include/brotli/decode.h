@@ -85,8 +85,7 @@ typedef enum {
   BROTLI_ERROR_CODE(_ERROR_FORMAT_, PADDING_1, -14) SEPARATOR              \
   BROTLI_ERROR_CODE(_ERROR_FORMAT_, PADDING_2, -15) SEPARATOR              \
   BROTLI_ERROR_CODE(_ERROR_FORMAT_, DISTANCE, -16) SEPARATOR               \
-                                                                           \
-  /* -17 code is reserved */                                               \
+  BROTLI_ERROR_CODE(_ERROR_FORMAT_, CHECKSUM, -17) SEPARATOR               \
                                                                            \
   BROTLI_ERROR_CODE(_ERROR_, COMPOUND_DICTIONARY, -18) SEPARATOR           \
   BROTLI_ERROR_CODE(_ERROR_, DICTIONARY_NOT_SET, -19) SEPARATOR            \
@@ -141,9 +140,78 @@ typedef enum BrotliDecoderParameter {
   /**
    * Flag that determines if "Large Window Brotli" is used.
    */
-  BROTLI_DECODER_PARAM_LARGE_WINDOW = 1
+  BROTLI_DECODER_PARAM_LARGE_WINDOW = 1,
+  /**
+   * Flag that enables reuse of prefix code tables.
+   *
+   * Tables of complex prefix codes are cached by the bits encoding them;
+   * repeated codes (e.g. in many small similar streams produced by the same
+   * encoder) are neither decoded nor built again, but copied from the cache.
+   * Cache is kept when decoder is reset for the next stream; it takes up to
+   * about 1 MiB, though usually much less.
+   */
+  BROTLI_DECODER_PARAM_HUFFMAN_TABLE_CACHE = 2,
+  /**
+   * Number of bytes that stream data is expected to follow.
+   *
+   * Counterpart of ::BROTLI_PARAM_STREAM_OFFSET of the encoder: a chunk
+   * produced with that parameter is decoded alone when it is preceded by a
+   * stream header (and padding) and the same offset is set here. Static
+   * dictionary references then resolve as if the preceding data were decoded;
+   * backward references into it are not supported. Bigger values are
+   * equivalent to the window size. Applies to the next stream only.
+   */
+  BROTLI_DECODER_PARAM_STREAM_OFFSET = 3,
+  /**
+   * Flag that makes decoder keep no memory it does not need right now.
+   *
+   * Prefix code tables and context maps are freed after each metablock,
+   * instead of being retained for the next one; ring-buffer and other
+   * per-stream allocations are freed by ::BrotliDecoderResetInstance.
+   * Trades some CPU for a smaller resident footprint of idle decoders.
+   */
+  BROTLI_DECODER_PARAM_LOW_MEMORY = 4,
+  /**
+   * Flag that makes decoder count its work, see ::BrotliDecoderGetStats.
+   *
+   * Meant for spotting streams that cost far more CPU than their size
+   * suggests, e.g. ones made of many tiny meta-blocks with fresh prefix
+   * codes. Kept over ::BrotliDecoderResetInstance.
+   */
+  BROTLI_DECODER_PARAM_COLLECT_STATS = 5,
+  /**
+   * Flag that makes decoder compute CRC-32C of the output as it is written,
+   * see ::BrotliDecoderGetChecksum.
+   *
+   * A checksum trailer appended with ::BROTLI_PARAM_CHECKSUM is verified: if
+   * no data follows it and it does not match, decoding fails with
+   * ::BROTLI_DECODER_ERROR_FORMAT_CHECKSUM. Kept over
+   * ::BrotliDecoderResetInstance.
+   */
+  BROTLI_DECODER_PARAM_CHECKSUM = 6
 } BrotliDecoderParameter;
 
+/** Counters collected with ::BROTLI_DECODER_PARAM_COLLECT_STATS. */
+typedef enum BrotliDecoderStat {
+  /** Number of compressed and uncompressed meta-blocks. */
+  BROTLI_DECODER_STAT_METABLOCKS = 0,
+  /** Number of prefix codes read, including the ones taken from cache. */
+  BROTLI_DECODER_STAT_PREFIX_CODES = 1,
+  /** Ticks spent in reading prefix codes and building their tables. */
+  BROTLI_DECODER_STAT_PREFIX_CODE_TICKS = 2,
+  /** Number of ring-buffer (re)allocations. */
+  BROTLI_DECODER_STAT_RING_BUFFER_ALLOCATIONS = 3,
+  /** Number of bytes decoded as literals. */
+  BROTLI_DECODER_STAT_LITERAL_BYTES = 4,
+  /** Number of bytes copied by backward references. */
+  BROTLI_DECODER_STAT_COPIED_BYTES = 5,
+  /** Number of static and compound dictionary references. */
+  BROTLI_DECODER_STAT_DICTIONARY_REFERENCES = 6
+} BrotliDecoderStat;
+
+/** Number of ::BrotliDecoderStat counters. */
+#define BROTLI_DECODER_NUM_STATS 7
+
 /**
  * Sets the specified parameter to the given decoder instance.
  *
@@ -178,12 +246,32 @@ BROTLI_DEC_API BROTLI_BOOL BrotliDecoderAttachDictionary(
     BrotliDecoderState* state, BrotliSharedDictionaryType type,
     size_t data_size, const uint8_t data[BROTLI_ARRAY_PARAM(data_size)]);
 
+/**
+ * Makes decoder use an already parsed shared dictionary.
+ *
+ * Unlike ::BrotliDecoderAttachDictionary, dictionary is neither parsed nor
+ * copied; any number of decoders, in any threads, can use the same instance
+ * at once. It has to outlive all of them, and MUST NOT be modified meanwhile.
+ * Dictionary is forgotten by ::BrotliDecoderResetInstance.
+ *
+ * @note Could be used only before anything else is attached, and before
+ *       actual decoding is started. Nothing can be attached afterwards.
+ *
+ * @param state decoder instance
+ * @param dictionary shared dictionary, as filled by
+ *        ::BrotliSharedDictionaryAttach
+ * @returns ::BROTLI_FALSE if decoder has dictionaries attached already
+ * @returns ::BROTLI_TRUE if dictionary is accepted
+ */
+BROTLI_DEC_API BROTLI_BOOL BrotliDecoderAttachSharedDictionary(
+    BrotliDecoderState* state, const BrotliSharedDictionary* dictionary);
+
 /**
  * Creates an instance of ::BrotliDecoderState and initializes it.
  *
  * The instance can be used once for decoding and should then be destroyed with
- * ::BrotliDecoderDestroyInstance, it cannot be reused for a new decoding
- * session.
+ * ::BrotliDecoderDestroyInstance, or prepared for a new decoding session with
+ * ::BrotliDecoderResetInstance.
  *
  * @p alloc_func and @p free_func @b MUST be both zero or both non-zero. In the
  * case they are both zero, default memory allocators are used. @p opaque is
@@ -206,6 +294,21 @@ BROTLI_DEC_API BrotliDecoderState* BrotliDecoderCreateInstance(
  */
 BROTLI_DEC_API void BrotliDecoderDestroyInstance(BrotliDecoderState* state);
 
+/**
+ * Prepares the instance for a new decoding session.
+ *
+ * Decoder parameters are kept. Attached dictionaries are dropped and have to
+ * be attached again. Ring-buffer and Huffman table allocations are retained,
+ * so decoding a stream of similar size does not allocate them again.
+ *
+ * @param state decoder instance to be reset
+ * @returns ::BROTLI_FALSE if instance could not be reset; in this case the
+ *          instance can only be destroyed
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_DEC_API BROTLI_BOOL BrotliDecoderResetInstance(
+    BrotliDecoderState* state);
+
 /**
  * Performs one-shot memory-to-memory decompression.
  *
@@ -349,6 +452,106 @@ BROTLI_DEC_API BROTLI_BOOL BrotliDecoderIsFinished(
 BROTLI_DEC_API BrotliDecoderErrorCode BrotliDecoderGetErrorCode(
     const BrotliDecoderState* state);
 
+/**
+ * Reads counters collected with ::BROTLI_DECODER_PARAM_COLLECT_STATS.
+ *
+ * Counters are indexed with ::BrotliDecoderStat and cleared by
+ * ::BrotliDecoderResetInstance. Tick unit is CPU-specific, same as of
+ * ::BrotliEncoderGetStats; only ratios of tick counters are meaningful.
+ *
+ * @param state decoder instance
+ * @param size number of elements in @p stats
+ * @param[out] stats counter values; all zeroes while collection is disabled
+ * @returns number of counters stored, at most ::BROTLI_DECODER_NUM_STATS
+ */
+BROTLI_DEC_API size_t BrotliDecoderGetStats(const BrotliDecoderState* state,
+    size_t size, uint64_t* stats);
+
+/**
+ * Reads CRC-32C of the output produced so far.
+ *
+ * Computed only with ::BROTLI_DECODER_PARAM_CHECKSUM; cleared by
+ * ::BrotliDecoderResetInstance.
+ *
+ * @param state decoder instance
+ * @returns checksum, or 0 while it is not computed
+ */
+BROTLI_DEC_API uint32_t BrotliDecoderGetChecksum(
+    const BrotliDecoderState* state);
+
+/**
+ * Reads uncompressed size declared at the start of stream.
+ *
+ * Encoder writes it with ::BROTLI_PARAM_DECLARE_SIZE as the leading
+ * metadata block; it is read before the first data meta-block is decoded, so
+ * it is known as soon as output is requested, e.g. after a call to
+ * ::BrotliDecoderDecompressStream with no output space. The value is not
+ * verified: untrusted streams could declare any size.
+ *
+ * @param state decoder instance
+ * @param[out] size declared number of bytes in the stream
+ * @returns ::BROTLI_FALSE if stream does not declare its size, or the
+ *          declaration is not read yet
+ */
+BROTLI_DEC_API BROTLI_BOOL BrotliDecoderGetDeclaredSize(
+    const BrotliDecoderState* state, uint64_t* size);
+
+/**
+ * Reads the number of bytes decoded so far, including ones not taken out yet.
+ *
+ * Called from a metadata callback, it gives the stream position of the
+ * metadata block.
+ *
+ * @param state decoder instance
+ * @returns number of decoded bytes
+ */
+BROTLI_DEC_API uint64_t BrotliDecoderGetDecodedSize(
+    const BrotliDecoderState* state);
+
+/**
+ * Callback to fire on metadata block start.
+ *
+ * After this callback is fired, if @p size is not @c 0, it is followed by
+ * ::brotli_decoder_metadata_chunk_func as more metadata block contents become
+ * accessible.
+ *
+ * @param opaque callback handle
+ * @param size size of metadata block
+ */
+typedef void (*brotli_decoder_metadata_start_func)(void* opaque, size_t size);
+
+/**
+ * Callback to fire on metadata block chunk becomes available.
+ *
+ * This function can be invoked multiple times per metadata block; block should
+ * be considered finished when sum of @p size matches the announced metadata
+ * block size. Chunks contents pointed by @p data are transient and shouldn't
+ * be accessed after leaving the callback.
+ *
+ * @param opaque callback handle
+ * @param data pointer to metadata contents
+ * @param size size of metadata block chunk, at least @c 1
+ */
+typedef void (*brotli_decoder_metadata_chunk_func)(void* opaque,
+                                                   const uint8_t* data,
+                                                   size_t size);
+
+/**
+ * Sets callback for receiving metadata blocks.
+ *
+ * Chunks point straight into the input where possible, so metadata is not
+ * copied by the decoder. Callbacks are kept over ::BrotliDecoderResetInstance.
+ *
+ * @param state decoder instance
+ * @param start_func callback on metadata block start; may be @c NULL
+ * @param chunk_func callback on metadata block chunk; may be @c NULL
+ * @param opaque callback handle
+ */
+BROTLI_DEC_API void BrotliDecoderSetMetadataCallbacks(
+    BrotliDecoderState* state,
+    brotli_decoder_metadata_start_func start_func,
+    brotli_decoder_metadata_chunk_func chunk_func, void* opaque);
+
 /**
  * Converts error code to a c-string.
  */
@@ -41,6 +41,14 @@ extern "C" {
 #define BROTLI_MIN_QUALITY 0
 /** Maximal value for ::BROTLI_PARAM_QUALITY parameter. */
 #define BROTLI_MAX_QUALITY 11
+/** Minimal non-zero value for ::BROTLI_PARAM_CHUNK_BITS parameter. */
+#define BROTLI_MIN_CHUNK_BITS 10
+/** Maximal value for ::BROTLI_PARAM_CHUNK_BITS parameter. */
+#define BROTLI_MAX_CHUNK_BITS 24
+/** Minimal non-zero value for ::BROTLI_PARAM_FIRST_BLOCK_BITS parameter. */
+#define BROTLI_MIN_FIRST_BLOCK_BITS 10
+/** Maximal value for ::BROTLI_PARAM_FIRST_BLOCK_BITS parameter. */
+#define BROTLI_MAX_FIRST_BLOCK_BITS 24
 
 /** Options for ::BROTLI_PARAM_MODE parameter. */
 typedef enum BrotliEncoderMode {
@@ -54,7 +62,17 @@ typedef enum BrotliEncoderMode {
   /** Compression mode for UTF-8 formatted text input. */
   BROTLI_MODE_TEXT = 1,
   /** Compression mode used in WOFF 2.0. */
-  BROTLI_MODE_FONT = 2
+  BROTLI_MODE_FONT = 2,
+  /**
+   * Compression mode is guessed from the first few KiB of input.
+   *
+   * Input available on the first ::BrotliEncoderCompressStream invocation is
+   * classified as font, text, or binary. Binary input made of 16- or 32-bit
+   * fields gets matching ::BROTLI_PARAM_NPOSTFIX. If the whole input is given
+   * to the first ::BROTLI_OPERATION_FINISH, window is reduced to fit it.
+   * Parameters set explicitly are not changed.
+   */
+  BROTLI_MODE_AUTO = 3
 } BrotliEncoderMode;
 
 /** Default value for ::BROTLI_PARAM_QUALITY parameter. */
@@ -218,9 +236,256 @@ typedef enum BrotliEncoderParameter {
    * maximal window size have the same effect. Values greater than 2**30 are not
    * allowed.
    */
-  BROTLI_PARAM_STREAM_OFFSET = 9
+  BROTLI_PARAM_STREAM_OFFSET = 9,
+  /**
+   * Flag that makes encoder estimate entropy of each input block before
+   * searching backward references in it.
+   *
+   * Blocks that look close to random (already compressed or encrypted data)
+   * are stored uncompressed right away, which saves most of the CPU spent on
+   * them. Small blocks (and one-shot ::BrotliEncoderCompress at qualities 10
+   * and 11) are not pre-scanned.
+   *
+   * The default value is 0 (disabled). See
+   * ::BrotliEncoderGetStoredIncompressibleBytes.
+   */
+  BROTLI_PARAM_SKIP_INCOMPRESSIBLE = 10,
+  /**
+   * Upper bound of memory used by encoder instance, in bytes.
+   *
+   * When set, window is cut to fit ::BROTLI_PARAM_SIZE_HINT (if known) and
+   * then window and quality are lowered until the estimate of peak memory
+   * usage (see ::BrotliEncoderEstimatePeakMemoryUsage) fits the limit; limit
+   * below the footprint of the smallest settings is not enforced. Also hash
+   * tables and work buffers are released once a flush completes, see
+   * ::BrotliEncoderReleaseIdleMemory.
+   *
+   * The default value is 0 (unlimited).
+   */
+  BROTLI_PARAM_MEMORY_LIMIT = 11,
+  /**
+   * Flag that makes encoder pick the shortest encoding for small meta-blocks.
+   *
+   * Streams flushed after every short message (server-sent events, RPC
+   * streaming) consist of small meta-blocks, each carrying its own prefix
+   * codes. With this flag meta-blocks of at most 4 KiB are also tried with the
+   * cheaper codes of lower qualities, and the shortest variant is kept; output
+   * is never larger than without the flag, at the cost of encoding such
+   * meta-blocks up to three times.
+   *
+   * Has effect for quality 2 and above, when ::BROTLI_PARAM_NPOSTFIX and
+   * ::BROTLI_PARAM_NDIRECT are 0 and large window is off. The default value
+   * is 0 (disabled).
+   */
+  BROTLI_PARAM_LOW_LATENCY_FLUSH = 12,
+  /**
+   * Match finder (hasher) used by qualities 2 to 9, instead of the one that
+   * quality and window would pick.
+   *
+   * Accepted types are 2, 3, 4 and 54 (hash tables of 2^16, 2^16, 2^17 and
+   * 2^20 buckets that sweep 1, 2, 4 and 4 slots), 5 and 6 (bucketed chains of
+   * 4 and 8 byte hashes), 35, 55 and 65 (3, 54 and 6 with a rolling hash for
+   * distant matches), and 40, 41 and 42 (forgetful chains sized for windows
+   * up to 64 KiB). Qualities 0, 1, 10 and 11 have dedicated match finders and
+   * ignore this parameter. Forgetful chains take quality 4 and above; they
+   * are refused at quality 2 and 3, and ignored if quality is lowered there
+   * later.
+   *
+   * The default value is 0 (picked by quality and window).
+   */
+  BROTLI_PARAM_HASHER_TYPE = 13,
+  /**
+   * log2 of the number of buckets of hashers 5, 6 and 65, in range [10, 24].
+   *
+   * The default value is 0 (14 or 15, depending on quality).
+   */
+  BROTLI_PARAM_HASHER_BUCKET_BITS = 14,
+  /**
+   * log2 of the chain depth (number of recent positions kept per bucket) of
+   * hashers 5, 6 and 65, in range [0, 10]; hash table takes
+   * 4 << (bucket bits + block bits) bytes.
+   *
+   * Not set by default, then quality - 1 is used.
+   */
+  BROTLI_PARAM_HASHER_BLOCK_BITS = 15,
+  /**
+   * Number of recently used distances tried ahead of hash lookups by hashers
+   * 5, 6 and 65, in range [1, 16].
+   *
+   * The default value is 0 (4, 10 or 16, depending on quality).
+   */
+  BROTLI_PARAM_HASHER_NUM_LAST_DISTANCES = 16,
+  /**
+   * Flag that enables long-distance matching.
+   *
+   * The match finder is paired with a rolling-hash index of 32-byte chunks
+   * that samples one position in 64 to 256, and thus finds long repeats
+   * anywhere in the window (up to 1 GiB with large window), far beyond the
+   * reach of the regular hash chains. Meant for inputs with large
+   * repeated regions, like VM images or database dumps. The index takes
+   * 64 MiB.
+   *
+   * Has effect for qualities 2 to 9 with window above 64 KiB; large window
+   * mode already pairs some of match finders of qualities 3 to 9 with such
+   * index. The default value is 0 (disabled).
+   */
+  BROTLI_PARAM_LONG_DISTANCE_MATCHING = 17,
+  /**
+   * Flag that makes encoder count its work per stage.
+   *
+   * Counters are read with ::BrotliEncoderGetStats. Each encoding stage adds
+   * two reads of the CPU tick counter per meta-block. The default value is 0
+   * (disabled).
+   */
+  BROTLI_PARAM_COLLECT_STATS = 18,
+  /**
+   * Checksum of uncompressed data, computed while input is copied in.
+   *
+   * 0 (default) disables it; 1 makes encoder compute CRC-32C of the input,
+   * read with ::BrotliEncoderGetChecksum; 2 also appends it to the stream in
+   * a metadata block just before the last (empty) meta-block, so that
+   * decoders with ::BROTLI_DECODER_PARAM_CHECKSUM verify it. The trailer
+   * costs a flush and 10 bytes; its body is "crcC" followed by little-endian
+   * CRC. Other decoders skip it, like any metadata.
+   */
+  BROTLI_PARAM_CHECKSUM = 19,
+  /**
+   * Flag that makes output a fragment to be joined with
+   * ::BrotliEncoderConcatenate.
+   *
+   * Fragment has no stream header, starts at byte boundary and is finished
+   * with a flush instead of the last meta-block. It does not refer to
+   * the static or attached dictionaries, whose distances depend on the place
+   * of fragment in the stream, so fragments are joined in any order without
+   * recompression. This costs some ratio on short text. Fragments are not
+   * valid streams on their own. ::BROTLI_PARAM_LARGE_WINDOW is ignored, and
+   * ::BROTLI_PARAM_CHECKSUM trailer is not appended. The default value is 0
+   * (disabled).
+   */
+  BROTLI_PARAM_FRAGMENT = 20,
+  /**
+   * Flag that makes encoder start the stream with its uncompressed size.
+   *
+   * Size is written as a metadata block, "Size" followed by little-endian
+   * 64-bit value, that costs 15 bytes; decoders read it with
+   * ::BrotliDecoderGetDeclaredSize to allocate output up front, others skip
+   * it. Size is known, and declared, only if the first call to
+   * ::BrotliEncoderCompressStream passes the whole input with
+   * ::BROTLI_OPERATION_FINISH. The default value is 0 (disabled).
+   */
+  BROTLI_PARAM_DECLARE_SIZE = 21,
+  /**
+   * log2 of the number of recent positions kept in the binary trees of
+   * qualities 10 and 11, in range [::BROTLI_MIN_WINDOW_BITS,
+   * ::BROTLI_LARGE_MAX_WINDOW_BITS].
+   *
+   * Trees take 8 bytes per window position, i.e. 128 MiB for a 24-bit
+   * window. A smaller tree bounds that to 8 << bits bytes; positions that
+   * leave the tree stay reachable through a small hash chain (2.1 MiB) that
+   * keeps the last 4 of them per hash bucket. This costs some ratio on
+   * inputs with many long-distance repeats. The default value is 0 (the
+   * tree spans the whole window).
+   */
+  BROTLI_PARAM_HASHER_TREE_BITS = 22,
+  /**
+   * Number of input bytes that one ::BrotliEncoderCompressStream call
+   * encodes before it yields.
+   *
+   * Encoder stops at the first input block boundary after the budget is
+   * spent and returns with some input left unconsumed, as if output buffer
+   * was full; the caller continues with the next call. This lets event loops
+   * interleave long streams with other work. Work is counted in whole input
+   * blocks, so ::BROTLI_PARAM_LGBLOCK bounds the latency of a single call;
+   * qualities 0 and 1 cut their blocks to the budget, but not below 64 KiB.
+   * The default value is 0 (unlimited).
+   */
+  BROTLI_PARAM_WORK_BUDGET = 23,
+  /**
+   * log2 of the average size of content-defined chunks, in range
+   * [::BROTLI_MIN_CHUNK_BITS, ::BROTLI_MAX_CHUNK_BITS], or 0.
+   *
+   * Encoder flushes the stream at cut points chosen by a rolling hash of the
+   * last 32 input bytes, so that cuts move along with the content when data
+   * is inserted or removed before them. Chunks are 1/4 to 4 times the
+   * average size. With ::BROTLI_PARAM_INDEPENDENT_CHUNKS, compressed chunks
+   * of identical input regions are identical as well, which lets storage
+   * deduplicate them across versions of a file. Each cut costs a flush.
+   * Input left unconsumed by ::BrotliEncoderCompressStream is scanned
+   * already and MUST be passed again. The default value is 0 (disabled).
+   */
+  BROTLI_PARAM_CHUNK_BITS = 24,
+  /**
+   * Flag that makes each content-defined chunk independent of the data
+   * before it.
+   *
+   * At each cut, encoder forgets the window, match finder and distance cache,
+   * and continues as if started with ::BROTLI_PARAM_STREAM_OFFSET; the first
+   * 2 bytes of a chunk are stored uncompressed to detach literal context.
+   * Dictionary references depend on the position until the stream is past
+   * its first window, so only chunks after it repeat exactly. Qualities 0 and
+   * 1 compress the input of each call separately; their chunks repeat only if
+   * calls pass the same pieces of input. This costs some ratio, more with
+   * smaller chunks. The default value is 0 (disabled).
+   */
+  BROTLI_PARAM_INDEPENDENT_CHUNKS = 25,
+  /**
+   * Flag that makes qualities 5 to 9 choose backward references with a
+   * shortest-path search, as quality 10 does.
+   *
+   * Search makes one pass over all matches listed by the hash chains of
+   * the quality, instead of the binary trees of quality 10, and takes
+   * the cost model from literal costs only, without refinement. Quality 9
+   * with this flag gains about half of the ratio that quality 10 adds, at
+   * several times the cost of quality 9, yet mostly below quality 10.
+   * Qualities that would use other hashers, and
+   * ::BROTLI_PARAM_LONG_DISTANCE_MATCHING, switch to a hash chain. The
+   * default value is 0 (disabled).
+   */
+  BROTLI_PARAM_SHORTEST_PATH = 26,
+  /**
+   * log2 of the size of the first input block, in range
+   * [::BROTLI_MIN_FIRST_BLOCK_BITS, ::BROTLI_MAX_FIRST_BLOCK_BITS], or 0.
+   *
+   * Streamed documents, like HTML, are usable as soon as their first bytes
+   * arrive, yet encoder buffers a whole input block before it compresses
+   * anything, unless the caller flushes. With this parameter the first block
+   * is compressed at quality 4, or the requested one if lower, and is pushed
+   * out flushed as soon as it is filled. Each next block is compressed at
+   * the requested quality, and is twice as big as the previous one and
+   * flushed as well, until blocks reach ::BROTLI_PARAM_LGBLOCK. This costs a
+   * bit of ratio in the first block and a few flushes. Qualities 0 and 1
+   * compress the input of each call at once, and ignore the parameter. With
+   * a custom ::BROTLI_PARAM_HASHER_TYPE the first block keeps the requested
+   * quality. The default value is 0 (disabled).
+   */
+  BROTLI_PARAM_FIRST_BLOCK_BITS = 27
 } BrotliEncoderParameter;
 
+/** Counters collected with ::BROTLI_PARAM_COLLECT_STATS. */
+typedef enum BrotliEncoderStat {
+  /**
+   * Number of meta-blocks produced, including uncompressed ones; qualities 0
+   * and 1 count compressed input blocks instead.
+   */
+  BROTLI_ENCODER_STAT_METABLOCKS = 0,
+  /** Number of backward references (commands with a copy). */
+  BROTLI_ENCODER_STAT_MATCHES = 1,
+  /** Number of literals left by backward reference search. */
+  BROTLI_ENCODER_STAT_LITERALS = 2,
+  /**
+   * Ticks spent in backward reference search; qualities 0 and 1 encode in
+   * a single pass, which is all accounted here.
+   */
+  BROTLI_ENCODER_STAT_MATCH_SEARCH_TICKS = 3,
+  /** Ticks spent in block splitting and histogram clustering. */
+  BROTLI_ENCODER_STAT_METABLOCK_TICKS = 4,
+  /** Ticks spent in writing prefix codes and commands to bitstream. */
+  BROTLI_ENCODER_STAT_STORE_TICKS = 5
+} BrotliEncoderStat;
+
+/** Number of ::BrotliEncoderStat counters. */
+#define BROTLI_ENCODER_NUM_STATS 6
+
 /**
  * Opaque structure that holds encoder state.
  *
@@ -270,6 +535,23 @@ BROTLI_ENC_API BrotliEncoderState* BrotliEncoderCreateInstance(
  */
 BROTLI_ENC_API void BrotliEncoderDestroyInstance(BrotliEncoderState* state);
 
+/**
+ * Prepares ::BrotliEncoderState instance for encoding of a new stream.
+ *
+ * Parameters set with ::BrotliEncoderSetParameter are preserved; attached
+ * dictionaries are detached. Ring buffer, hash tables and command buffers stay
+ * allocated and are reused by the next stream, which saves allocating and
+ * zeroing them again.
+ *
+ * @note hasher selected for the previous stream is kept, unless parameters
+ *       are modified after reset.
+ *
+ * @param state encoder instance to be reused
+ * @returns ::BROTLI_FALSE if instance is in unrecoverable state (e.g. OOM)
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderResetInstance(BrotliEncoderState* state);
+
 /* Opaque type for pointer to different possible internal structures containing
    dictionary prepared for the encoder */
 typedef struct BrotliEncoderPreparedDictionaryStruct
@@ -287,7 +569,9 @@ typedef struct BrotliEncoderPreparedDictionaryStruct
  * @param data_size size of @p data buffer
  * @param data pointer to the dictionary data
  * @param quality the maximum Brotli quality to prepare the dictionary for,
- *        use BROTLI_MAX_QUALITY by default
+ *        use BROTLI_MAX_QUALITY by default; raw dictionaries prepared for
+ *        qualities below @c 10 index only every 2nd (every 4th below @c 5)
+ *        position, which makes preparing faster and the index smaller
  * @param alloc_func custom memory allocation function
  * @param free_func custom memory free function
  * @param opaque custom memory manager handle
@@ -298,6 +582,38 @@ BrotliEncoderPrepareDictionary(BrotliSharedDictionaryType type,
     int quality,
     brotli_alloc_func alloc_func, brotli_free_func free_func, void* opaque);
 
+/**
+ * Prepares a raw (LZ77) dictionary that references @p data instead of copying.
+ *
+ * Meant for delta compression against a previous version of the content:
+ * @p data can be a memory-mapped reference file that is never read into
+ * memory as a whole. Decoder has to attach the same data as a raw dictionary.
+ * Dictionary is reachable only within ::BROTLI_MAX_DISTANCE, i.e. its size
+ * plus window size should not exceed it. Qualities below @c 5 do not search
+ * raw dictionaries at all.
+ *
+ * @param data_size size of @p data buffer
+ * @param data dictionary data; @b MUST outlive the prepared dictionary
+ * @param quality see ::BrotliEncoderPrepareDictionary
+ * @param alloc_func custom memory allocation function
+ * @param free_func custom memory free function
+ * @param opaque custom memory manager handle
+ * @returns @c 0 if memory is exhausted
+ */
+BROTLI_ENC_API BrotliEncoderPreparedDictionary*
+BrotliEncoderPrepareLeanDictionary(size_t data_size,
+    const uint8_t data[BROTLI_ARRAY_PARAM(data_size)], int quality,
+    brotli_alloc_func alloc_func, brotli_free_func free_func, void* opaque);
+
+/**
+ * Releases the reference to a prepared dictionary taken by its creation.
+ *
+ * Encoders it is attached to hold references of their own, so it is freed
+ * once the last of them is destroyed or reset. Data that the dictionary was
+ * prepared from has to outlive it all the same, unless it was copied.
+ *
+ * @param dictionary prepared dictionary, or @c 0
+ */
 BROTLI_ENC_API void BrotliEncoderDestroyPreparedDictionary(
     BrotliEncoderPreparedDictionary* dictionary);
 
@@ -308,6 +624,9 @@ BROTLI_ENC_API void BrotliEncoderDestroyPreparedDictionary(
  * dictionaries and/or max 1 serialized dictionary with custom words can be
  * attached.
  *
+ * Prepared dictionary is not modified or copied, so one prepared once can be
+ * attached to any number of encoders, from any threads, at a constant cost.
+ *
  * @returns ::BROTLI_FALSE in case of error
  * @returns ::BROTLI_TRUE otherwise
  */
@@ -315,6 +634,121 @@ BROTLI_ENC_API BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(
     BrotliEncoderState* state,
     const BrotliEncoderPreparedDictionary* dictionary);
 
+/**
+ * Fills the window with the tail of the input already compressed by a
+ * different instance, so that the stream is continued as if it was never
+ * interrupted.
+ *
+ * MUST be invoked after ::BROTLI_PARAM_STREAM_OFFSET is set to the size of
+ * the processed input, and before the first portion of input. Data is neither
+ * compressed nor accounted in ::BROTLI_PARAM_CHECKSUM; only the last
+ * window-size bytes are used. Together with the same quality and window size,
+ * it makes the continuation almost as dense as the single run, and the
+ * predecessor output followed by the output of this instance is a valid
+ * stream. Unlike attached dictionaries, the window does not need to be known
+ * to the decoder.
+ *
+ * @param state encoder instance
+ * @param size size of @p data; at least 2 bytes are required, unless the
+ *        stream offset is smaller
+ * @param data the last bytes of the processed input
+ * @returns ::BROTLI_FALSE if stream offset is not set, encoder makes a
+ *          fragment, input is attached with ::BrotliEncoderAttachInput, data
+ *          is longer than the offset, or the encoder has already started
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderPrimeWindow(BrotliEncoderState* state,
+    size_t size, const uint8_t data[BROTLI_ARRAY_PARAM(size)]);
+
+/**
+ * Trains a raw prefix dictionary on a corpus of samples.
+ *
+ * Picks the substrings shared by most samples, up to @p *dictionary_size
+ * bytes in total; the most useful ones are placed at the end. When all the
+ * samples fit the budget the result is their concatenation. The result can
+ * be used as ::BROTLI_SHARED_DICTIONARY_RAW by both encoder and decoder.
+ *
+ * @param num_samples number of samples
+ * @param sample_sizes sizes of the samples
+ * @param samples samples, concatenated
+ * @param[in, out] dictionary_size @b in: size limit of @p dictionary; \n
+ *                 @b out: length of the trained dictionary
+ * @param[out] dictionary trained dictionary
+ * @returns ::BROTLI_FALSE if the limit is too small or memory is exhausted
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderTrainDictionary(size_t num_samples,
+    const size_t sample_sizes[BROTLI_ARRAY_PARAM(num_samples)],
+    const uint8_t* samples, size_t* dictionary_size,
+    uint8_t dictionary[BROTLI_ARRAY_PARAM(*dictionary_size)]);
+
+/**
+ * Maximal number of bytes ::BrotliEncoderSerializeDictionary adds to the raw
+ * dictionary.
+ */
+#define BROTLI_SERIALIZED_DICTIONARY_OVERHEAD 9
+
+/**
+ * Wraps a raw prefix dictionary into the serialized shared dictionary format,
+ * accepted as ::BROTLI_SHARED_DICTIONARY_SERIALIZED by encoder and decoder.
+ * Built-in static dictionary words and transforms are kept.
+ *
+ * @param raw_size size of @p raw
+ * @param raw raw prefix dictionary
+ * @param[in, out] serialized_size @b in: size of @p serialized buffer,
+ *                 at least @p raw_size +
+ *                 ::BROTLI_SERIALIZED_DICTIONARY_OVERHEAD; \n
+ *                 @b out: length of the serialized dictionary
+ * @param[out] serialized serialized dictionary
+ * @returns ::BROTLI_FALSE if the buffer is too small
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderSerializeDictionary(size_t raw_size,
+    const uint8_t raw[BROTLI_ARRAY_PARAM(raw_size)], size_t* serialized_size,
+    uint8_t serialized[BROTLI_ARRAY_PARAM(*serialized_size)]);
+
+/** Size of an encoder profile made by ::BrotliEncoderTrainProfile. */
+#define BROTLI_ENCODER_PROFILE_SIZE 67
+
+/**
+ * Learns an encoder profile from a corpus of structurally similar samples.
+ *
+ * The profile holds the literal context map that clusters the literal
+ * statistics of an average sample. Encoders with the profile set use it
+ * instead of deciding over literal context modeling for every meta-block,
+ * and apply context modeling down to quality @c 3. Candidate maps are
+ * compared by compressing every sample with them, so training takes about
+ * a dozen compressions of the corpus.
+ *
+ * @param quality quality the profile is tuned for, clamped to [3, 9]
+ * @param num_samples number of samples
+ * @param sample_sizes sizes of the samples
+ * @param samples samples, concatenated
+ * @param[out] profile trained profile
+ * @returns ::BROTLI_FALSE if there are no samples or memory is exhausted
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderTrainProfile(int quality,
+    size_t num_samples,
+    const size_t sample_sizes[BROTLI_ARRAY_PARAM(num_samples)],
+    const uint8_t* samples, uint8_t profile[BROTLI_ENCODER_PROFILE_SIZE]);
+
+/**
+ * Sets the profile made by ::BrotliEncoderTrainProfile.
+ *
+ * Takes effect for qualities @c 3 to @c 9. Like parameters, the profile is
+ * kept over ::BrotliEncoderResetInstance.
+ *
+ * @param state encoder instance
+ * @param profile_size size of @p profile; @c 0 to clear the profile
+ * @param profile profile data, copied by the encoder
+ * @returns ::BROTLI_FALSE if the profile is malformed or encoding is started
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderSetProfile(BrotliEncoderState* state,
+    size_t profile_size,
+    const uint8_t profile[BROTLI_ARRAY_PARAM(profile_size)]);
+
 /**
  * Calculates the output size bound for the given @p input_size.
  *
@@ -327,6 +761,77 @@ BROTLI_ENC_API BROTLI_BOOL BrotliEncoderAttachPreparedDictionary(
  */
 BROTLI_ENC_API size_t BrotliEncoderMaxCompressedSize(size_t input_size);
 
+/**
+ * Estimates peak memory usage of encoder instance.
+ *
+ * Result is an upper bound for ::BrotliEncoderCompressStream that is given
+ * @p input_size bytes in several calls; one-shot compression of inputs smaller
+ * than the window might use less. Block splitting histograms of qualities
+ * @c 10 and @c 11 are estimated only roughly.
+ *
+ * @param quality quality parameter value, e.g. ::BROTLI_DEFAULT_QUALITY
+ * @param lgwin lgwin parameter value, e.g. ::BROTLI_DEFAULT_WINDOW
+ * @param input_size size of projected input
+ * @returns estimated number of bytes
+ */
+BROTLI_ENC_API size_t BrotliEncoderEstimatePeakMemoryUsage(
+    int quality, int lgwin, size_t input_size);
+
+/**
+ * Predicts compressed size and encoding time without compressing.
+ *
+ * Looks at no more than 64 KiB sampled evenly across the input: literal costs
+ * are estimated from adaptive histograms, and repetitions are found with a
+ * single-probe hash, like in the fastest qualities. Sampling misses matches
+ * between samples, so highly redundant big inputs are predicted on the large
+ * side. Predictions are calibrated on text, logs, tables, source code and
+ * random data; typical error is within 30%. Time prediction is for a 2 GHz
+ * x86-64 core and is an upper bound for incompressible input.
+ *
+ * @param quality quality parameter value, e.g. ::BROTLI_DEFAULT_QUALITY
+ * @param lgwin lgwin parameter value, e.g. ::BROTLI_DEFAULT_WINDOW
+ * @param input_size size of input
+ * @param input data to look at
+ * @param[out] compressed_size predicted compressed size; at most
+ *             ::BrotliEncoderMaxCompressedSize(@p input_size)
+ * @param[out] encode_nanos predicted time of one-shot compression
+ * @returns ::BROTLI_FALSE if arguments are invalid
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderEstimate(int quality, int lgwin,
+    size_t input_size,
+    const uint8_t input_buffer[BROTLI_ARRAY_PARAM(input_size)],
+    size_t* compressed_size, uint64_t* encode_nanos);
+
+/** Maximal number of bytes ::BrotliEncoderConcatenate adds to fragments. */
+#define BROTLI_CONCATENATE_OVERHEAD 3
+
+/**
+ * Joins fragments made with ::BROTLI_PARAM_FRAGMENT into a single stream.
+ *
+ * Fragments are copied as is, in the given order; only the stream header
+ * and the last (empty) meta-block are added.
+ *
+ * @param lgwin window of the stream, from ::BROTLI_MIN_WINDOW_BITS to
+ *        ::BROTLI_MAX_WINDOW_BITS; not less than ::BROTLI_PARAM_LGWIN of
+ *        any fragment
+ * @param num_fragments number of fragments
+ * @param fragment_sizes sizes of fragments
+ * @param fragments fragment data
+ * @param[in, out] encoded_size @b in: size of @p encoded_buffer; \n
+ *                 @b out: length of the stream
+ * @param encoded_buffer stream destination buffer; sum of fragment sizes
+ *        plus ::BROTLI_CONCATENATE_OVERHEAD bytes is always enough
+ * @returns ::BROTLI_FALSE if @p lgwin is invalid or output buffer is too
+ *          small
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderConcatenate(int lgwin,
+    size_t num_fragments,
+    const size_t fragment_sizes[BROTLI_ARRAY_PARAM(num_fragments)],
+    const uint8_t* const fragments[BROTLI_ARRAY_PARAM(num_fragments)],
+    size_t* encoded_size,
+    uint8_t encoded_buffer[BROTLI_ARRAY_PARAM(*encoded_size)]);
+
 /**
  * Performs one-shot memory-to-memory compression.
  *
@@ -361,6 +866,38 @@ BROTLI_ENC_API BROTLI_BOOL BrotliEncoderCompress(
     size_t* encoded_size,
     uint8_t encoded_buffer[BROTLI_ARRAY_PARAM(*encoded_size)]);
 
+/**
+ * Compresses as much of the input as fits the given output budget.
+ *
+ * Output is a complete stream that decodes to the first @p *consumed_size
+ * bytes of input; the rest may be compressed to the next stream. Meta-blocks
+ * are sized after the compression ratio achieved so far; the one that would
+ * overflow the budget is cut to the longest prefix that still fits and ends
+ * the stream, so no input is compressed twice from scratch. If the budget is
+ * too small for any input, empty stream is produced.
+ *
+ * Qualities @c 0 and @c 1 are compressed as @c 2.
+ *
+ * @param quality quality parameter value, e.g. ::BROTLI_DEFAULT_QUALITY
+ * @param lgwin lgwin parameter value, e.g. ::BROTLI_DEFAULT_WINDOW
+ * @param mode mode parameter value, e.g. ::BROTLI_DEFAULT_MODE
+ * @param input_size size of @p input_buffer
+ * @param input_buffer input data buffer
+ * @param[out] consumed_size number of input bytes in the stream
+ * @param[in, out] encoded_size @b in: output budget, size of
+ *                 @p encoded_buffer; \n
+ *                 @b out: length of the stream
+ * @param encoded_buffer compressed data destination buffer
+ * @returns ::BROTLI_FALSE if even empty stream does not fit the budget, or
+ *          in case of compression error
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderCompressToBudget(
+    int quality, int lgwin, BrotliEncoderMode mode, size_t input_size,
+    const uint8_t input_buffer[BROTLI_ARRAY_PARAM(input_size)],
+    size_t* consumed_size, size_t* encoded_size,
+    uint8_t encoded_buffer[BROTLI_ARRAY_PARAM(*encoded_size)]);
+
 /**
  * Compresses input stream to output stream.
  *
@@ -428,6 +965,26 @@ BROTLI_ENC_API BROTLI_BOOL BrotliEncoderCompressStream(
     const uint8_t** next_in, size_t* available_out, uint8_t** next_out,
     size_t* total_out);
 
+/**
+ * Lets encoder read the whole input of the stream in place.
+ *
+ * Saves copying the input to the ring buffer, e.g. for a memory-mapped file.
+ * The same bytes have to be passed to ::BrotliEncoderCompressStream, from the
+ * start and in order. Input that does not fit the window is copied as usual,
+ * as is the input of qualities 5 to 9: their match finders are faster with
+ * the ring buffer.
+ *
+ * @note @p input @b MUST stay unchanged until the encoder is finished.
+ *
+ * @param state encoder instance; no data should be compressed yet
+ * @param input_size size of the whole input
+ * @param input the whole input
+ * @returns ::BROTLI_FALSE if encoding has already started
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderAttachInput(BrotliEncoderState* state,
+    size_t input_size, const uint8_t input[BROTLI_ARRAY_PARAM(input_size)]);
+
 /**
  * Checks if encoder instance reached the final state.
  *
@@ -448,6 +1005,87 @@ BROTLI_ENC_API BROTLI_BOOL BrotliEncoderIsFinished(BrotliEncoderState* state);
 BROTLI_ENC_API BROTLI_BOOL BrotliEncoderHasMoreOutput(
     BrotliEncoderState* state);
 
+/**
+ * Reports how much input was stored uncompressed by the entropy pre-scan.
+ *
+ * Only blocks rejected by ::BROTLI_PARAM_SKIP_INCOMPRESSIBLE pre-scan are
+ * accounted; counter is cleared by ::BrotliEncoderResetInstance.
+ *
+ * @param state encoder instance
+ * @returns number of input bytes passed through without compression
+ */
+BROTLI_ENC_API uint64_t BrotliEncoderGetStoredIncompressibleBytes(
+    const BrotliEncoderState* state);
+
+/**
+ * Reads counters collected with ::BROTLI_PARAM_COLLECT_STATS.
+ *
+ * Counters are indexed with ::BrotliEncoderStat and cleared by
+ * ::BrotliEncoderResetInstance. Tick unit is CPU-specific (time-stamp counter
+ * on x86, virtual counter on ARM64, @c clock elsewhere); only ratios of tick
+ * counters are meaningful. Matches and literals are not counted at
+ * qualities 0 and 1.
+ *
+ * @param state encoder instance
+ * @param size number of elements in @p stats
+ * @param[out] stats counter values; all zeroes while collection is disabled
+ * @returns number of counters stored, at most ::BROTLI_ENCODER_NUM_STATS
+ */
+BROTLI_ENC_API size_t BrotliEncoderGetStats(const BrotliEncoderState* state,
+    size_t size, uint64_t* stats);
+
+/**
+ * Reads CRC-32C of the input consumed so far.
+ *
+ * Computed only with ::BROTLI_PARAM_CHECKSUM; cleared by
+ * ::BrotliEncoderResetInstance.
+ *
+ * @param state encoder instance
+ * @returns checksum, or 0 while it is not computed
+ */
+BROTLI_ENC_API uint32_t BrotliEncoderGetChecksum(
+    const BrotliEncoderState* state);
+
+/**
+ * Releases memory that encoder does not need while it is idle.
+ *
+ * Encoder is idle when all pushed input is flushed and all output is taken.
+ * Hash tables, command buffers and output storage are freed, and allocated
+ * again when data resumes. Window contents are kept, so that further data
+ * still references preceding data; only match finder history is lost, which
+ * costs a little compression ratio right after the idle period.
+ *
+ * @param state encoder instance
+ * @returns ::BROTLI_FALSE if encoder is not idle
+ * @returns ::BROTLI_TRUE otherwise
+ */
+BROTLI_ENC_API BROTLI_BOOL BrotliEncoderReleaseIdleMemory(
+    BrotliEncoderState* state);
+
+/**
+ * Creates a copy of idle encoder instance.
+ *
+ * Copy continues the stream exactly as the original would: window contents,
+ * hash tables, distance cache, parameters and output position are
+ * duplicated. Streams that share a prefix thus compress it once: flush the
+ * prefix, then fork the instance for each tail.
+ *
+ * Copying costs about as much as zeroing the hash tables; it is proportional
+ * to window and hash table size, not to the length of the prefix.
+ *
+ * @param state idle encoder instance, see ::BrotliEncoderReleaseIdleMemory,
+ *        or one that has not started yet; it is not modified
+ * @param alloc_func custom memory allocation function for the copy
+ * @param free_func custom memory free function for the copy
+ * @param opaque custom memory manager handle for the copy
+ * @returns @c 0 if instance is not idle, has dictionaries attached, or
+ *          memory is exhausted
+ * @returns pointer to new ::BrotliEncoderState otherwise
+ */
+BROTLI_ENC_API BrotliEncoderState* BrotliEncoderForkInstance(
+    const BrotliEncoderState* state, brotli_alloc_func alloc_func,
+    brotli_free_func free_func, void* opaque);
+
 /**
  * Acquires pointer to internal output buffer.
  *
@@ -0,0 +1,708 @@
+/* Copyright 2014 Google Inc. All Rights Reserved.
+
+   Distributed under MIT license.
+   See file LICENSE for detail or copy at https://opensource.org/licenses/MIT
+*/
+
+/* Benchmark of one-shot compression and decompression.
+
+   Every input file is compressed with BrotliEncoderCompress and decompressed
+   with BrotliDecoderDecompress, for each quality / window combination. Pass
+   the files of a corpus (e.g. Silesia, Canterbury, or a set of web assets) as
+   arguments:
+
+     brotli_bench -q 0-11 -w 18,22,24 -i 5 silesia/dickens silesia/xml ...
+
+   For each combination a line is printed with the compression ratio of the
+   whole corpus, the throughput (uncompressed MB per second of wall time),
+   50th and 99th percentile of per-file latency (ms), and the peak heap usage of
+   encoder and decoder instances for the largest file.
+
+   Match finder settings are swept with -H (hasher types), -b (bucket bits)
+   and -c (block bits, i.e. log2 of chain depth); these cases are compressed
+   with a streaming encoder configured through BROTLI_PARAM_HASHER_*:
+
+     brotli_bench -q 5 -H 0,5,6,54 -b 0,16,18 silesia/dickens
+
+   Encoder modes and input block sizes are swept with -m and -l. With -o the
+   sweep also works as an offline tuner: cases that are not beaten on ratio,
+   throughput and encoder memory at once (the Pareto front) are appended to
+   the given preset file under the -n name, one line per case, fastest first:
+
+     brotli_bench -q 0-11 -m 0,1 -l 0,18 -n html -o presets html/a.html ...
+
+   Encoder.Parameters.fromPreset loads these files in Brotli4j. */
+
+/* Mute strerror/strcpy warnings. */
+#if !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#define MAX_LIST 16
+#define MAX_PRESET_NAME 64
+
+typedef struct {
+  const char* path;
+  uint8_t* data;
+  size_t size;
+} InputFile;
+
+/* Match finder settings of a case. */
+typedef struct {
+  int type;
+  int bucket_bits;
+  int block_bits;
+} HasherChoice;
+
+/* Encoder settings of a case. */
+typedef struct {
+  int quality;
+  int lgwin;
+  int mode;
+  /* 0 stands for default. */
+  int lgblock;
+  HasherChoice hasher;
+} Settings;
+
+/* Measured corpus-wide figures of a case. */
+typedef struct {
+  Settings settings;
+  double ratio;
+  double compress_speed;
+  size_t encoder_peak;
+} CaseResult;
+
+typedef struct {
+  int min_quality;
+  int max_quality;
+  int windows[MAX_LIST];
+  int num_windows;
+  int modes[MAX_LIST];
+  int num_modes;
+  int lgblocks[MAX_LIST];
+  int num_lgblocks;
+  /* BROTLI_PARAM_HASHER_* values; 0 (-1 for block bits) stands for default. */
+  int hashers[MAX_LIST];
+  int num_hashers;
+  int bucket_bits[MAX_LIST];
+  int num_bucket_bits;
+  int block_bits[MAX_LIST];
+  int num_block_bits;
+  int iterations;
+  InputFile* files;
+  size_t num_files;
+  size_t total_size;
+  size_t max_size;
+  /* Tuner output; NULL unless -o is given. */
+  const char* preset_path;
+  const char* preset_name;
+  CaseResult* results;
+  size_t num_results;
+} Context;
+
+/* Heap usage of a single encoder / decoder instance. */
+typedef struct {
+  size_t current;
+  size_t peak;
+} MemoryTracker;
+
+/* Keeps maximal alignment of the returned block. */
+typedef union {
+  size_t size;
+  double d;
+  void* p;
+  uint64_t u;
+} AllocationHeader;
+
+static void* TrackingAlloc(void* opaque, size_t size) {
+  MemoryTracker* tracker = (MemoryTracker*)opaque;
+  AllocationHeader* header =
+      (AllocationHeader*)malloc(sizeof(AllocationHeader) + size);
+  if (!header) return NULL;
+  header->size = size;
+  tracker->current += size;
+  if (tracker->current > tracker->peak) tracker->peak = tracker->current;
+  return header + 1;
+}
+
+static void TrackingFree(void* opaque, void* address) {
+  MemoryTracker* tracker = (MemoryTracker*)opaque;
+  AllocationHeader* header;
+  if (!address) return;
+  header = (AllocationHeader*)address - 1;
+  tracker->current -= header->size;
+  free(header);
+}
+
+static uint64_t NowNanos(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)((double)counter.QuadPart * 1e9 /
+                    (double)frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static BROTLI_BOOL ParseInt(const char* s, int low, int high, int* result) {
+  char* end;
+  long value = strtol(s, &end, 10);
+  if (end == s || *end != 0 || value < low || value > high) {
+    return BROTLI_FALSE;
+  }
+  *result = (int)value;
+  return BROTLI_TRUE;
+}
+
+/* Parses "Q" or "MIN-MAX". */
+static BROTLI_BOOL ParseQualities(const char* s, Context* context) {
+  char buffer[16];
+  char* dash;
+  if (strlen(s) >= sizeof(buffer)) return BROTLI_FALSE;
+  strcpy(buffer, s);
+  dash = strchr(buffer, '-');
+  if (dash) *dash = 0;
+  if (!ParseInt(buffer, BROTLI_MIN_QUALITY, BROTLI_MAX_QUALITY,
+                &context->min_quality)) {
+    return BROTLI_FALSE;
+  }
+  context->max_quality = context->min_quality;
+  if (dash && !ParseInt(dash + 1, context->min_quality, BROTLI_MAX_QUALITY,
+                        &context->max_quality)) {
+    return BROTLI_FALSE;
+  }
+  return BROTLI_TRUE;
+}
+
+/* Parses comma separated list of values in range [low, high]. */
+static BROTLI_BOOL ParseList(const char* s, int low, int high, int* values,
+                             int* count) {
+  char buffer[128];
+  char* item;
+  if (strlen(s) >= sizeof(buffer)) return BROTLI_FALSE;
+  strcpy(buffer, s);
+  *count = 0;
+  for (item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+    if (*count == MAX_LIST) return BROTLI_FALSE;
+    if (!ParseInt(item, low, high, &values[*count])) return BROTLI_FALSE;
+    (*count)++;
+  }
+  return TO_BROTLI_BOOL(*count > 0);
+}
+
+static BROTLI_BOOL IsDefaultHasher(const HasherChoice* hasher) {
+  return TO_BROTLI_BOOL(hasher->type == 0 && hasher->bucket_bits == 0 &&
+                        hasher->block_bits < 0);
+}
+
+static void SetEncoderParameters(BrotliEncoderState* encoder,
+                                 const Settings* settings, size_t input_size) {
+  const HasherChoice* hasher = &settings->hasher;
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY,
+                            (uint32_t)settings->quality);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_LGWIN,
+                            (uint32_t)settings->lgwin);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_MODE,
+                            (uint32_t)settings->mode);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_LGBLOCK,
+                            (uint32_t)settings->lgblock);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_SIZE_HINT,
+                            (uint32_t)input_size);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_HASHER_TYPE,
+                            (uint32_t)hasher->type);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_HASHER_BUCKET_BITS,
+                            (uint32_t)hasher->bucket_bits);
+  if (hasher->block_bits >= 0) {
+    BrotliEncoderSetParameter(encoder, BROTLI_PARAM_HASHER_BLOCK_BITS,
+                              (uint32_t)hasher->block_bits);
+  }
+}
+
+/* BrotliEncoderCompress with custom block size and match finder settings. */
+static BROTLI_BOOL Compress(const Settings* settings, size_t input_size,
+    const uint8_t* input, size_t* encoded_size, uint8_t* encoded) {
+  BrotliEncoderState* encoder;
+  size_t available_in = input_size;
+  const uint8_t* next_in = input;
+  size_t available_out = *encoded_size;
+  uint8_t* next_out = encoded;
+  BROTLI_BOOL ok;
+  if (IsDefaultHasher(&settings->hasher) && settings->lgblock == 0) {
+    return BrotliEncoderCompress(settings->quality, settings->lgwin,
+        (BrotliEncoderMode)settings->mode, input_size, input, encoded_size,
+        encoded);
+  }
+  encoder = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+  if (!encoder) return BROTLI_FALSE;
+  SetEncoderParameters(encoder, settings, input_size);
+  ok = BrotliEncoderCompressStream(encoder, BROTLI_OPERATION_FINISH,
+      &available_in, &next_in, &available_out, &next_out, NULL);
+  ok = TO_BROTLI_BOOL(ok && BrotliEncoderIsFinished(encoder));
+  BrotliEncoderDestroyInstance(encoder);
+  *encoded_size -= available_out;
+  return ok;
+}
+
+static BROTLI_BOOL ReadInput(InputFile* file) {
+  FILE* fin = fopen(file->path, "rb");
+  long size;
+  if (!fin) {
+    fprintf(stderr, "failed to open %s\n", file->path);
+    return BROTLI_FALSE;
+  }
+  if (fseek(fin, 0, SEEK_END) != 0 || (size = ftell(fin)) < 0 ||
+      fseek(fin, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "failed to get size of %s\n", file->path);
+    fclose(fin);
+    return BROTLI_FALSE;
+  }
+  file->size = (size_t)size;
+  file->data = (uint8_t*)malloc(file->size ? file->size : 1);
+  if (!file->data ||
+      fread(file->data, 1, file->size, fin) != file->size) {
+    fprintf(stderr, "failed to read %s\n", file->path);
+    fclose(fin);
+    return BROTLI_FALSE;
+  }
+  fclose(fin);
+  return BROTLI_TRUE;
+}
+
+static int CompareNanos(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/* Sorts |samples| and returns the |percent|-th percentile, in milliseconds. */
+static double Percentile(uint64_t* samples, size_t count, int percent) {
+  size_t index;
+  qsort(samples, count, sizeof(uint64_t), CompareNanos);
+  index = (count * (size_t)percent + 99) / 100;
+  if (index > 0) index--;
+  return (double)samples[index] / 1e6;
+}
+
+static double Throughput(size_t bytes, uint64_t nanos) {
+  if (nanos == 0) return 0.0;
+  return (double)bytes / 1e6 / ((double)nanos / 1e9);
+}
+
+/* Measures peak heap usage of streaming instances on the given input. */
+static BROTLI_BOOL MeasureMemory(const InputFile* file,
+    const Settings* settings, uint8_t* compressed, size_t compressed_capacity,
+    uint8_t* decompressed, size_t* encoder_peak, size_t* decoder_peak) {
+  MemoryTracker tracker = {0, 0};
+  BrotliEncoderState* encoder;
+  BrotliDecoderState* decoder;
+  BrotliDecoderResult result;
+  size_t available_in = file->size;
+  const uint8_t* next_in = file->data;
+  size_t available_out = compressed_capacity;
+  uint8_t* next_out = compressed;
+  size_t compressed_size;
+  BROTLI_BOOL ok;
+
+  encoder = BrotliEncoderCreateInstance(TrackingAlloc, TrackingFree, &tracker);
+  if (!encoder) return BROTLI_FALSE;
+  SetEncoderParameters(encoder, settings, file->size);
+  ok = BrotliEncoderCompressStream(encoder, BROTLI_OPERATION_FINISH,
+      &available_in, &next_in, &available_out, &next_out, NULL);
+  ok = TO_BROTLI_BOOL(ok && BrotliEncoderIsFinished(encoder));
+  BrotliEncoderDestroyInstance(encoder);
+  if (!ok) return BROTLI_FALSE;
+  *encoder_peak = tracker.peak;
+  compressed_size = compressed_capacity - available_out;
+
+  tracker.current = 0;
+  tracker.peak = 0;
+  decoder = BrotliDecoderCreateInstance(TrackingAlloc, TrackingFree, &tracker);
+  if (!decoder) return BROTLI_FALSE;
+  available_in = compressed_size;
+  next_in = compressed;
+  available_out = file->size;
+  next_out = decompressed;
+  result = BrotliDecoderDecompressStream(decoder, &available_in, &next_in,
+      &available_out, &next_out, NULL);
+  BrotliDecoderDestroyInstance(decoder);
+  if (result != BROTLI_DECODER_RESULT_SUCCESS) return BROTLI_FALSE;
+  *decoder_peak = tracker.peak;
+  return BROTLI_TRUE;
+}
+
+static BROTLI_BOOL RunCase(Context* context, const Settings* settings,
+    uint8_t* compressed, size_t compressed_capacity, uint8_t* decompressed,
+    uint64_t* compress_samples, uint64_t* decompress_samples) {
+  const HasherChoice* hasher = &settings->hasher;
+  size_t num_samples = 0;
+  size_t compressed_total = 0;
+  uint64_t compress_nanos = 0;
+  uint64_t decompress_nanos = 0;
+  size_t encoder_peak = 0;
+  size_t decoder_peak = 0;
+  size_t largest = 0;
+  size_t i;
+  double ratio;
+  double compress_speed;
+  int iteration;
+
+  for (i = 0; i < context->num_files; ++i) {
+    const InputFile* file = &context->files[i];
+    if (file->size > context->files[largest].size) largest = i;
+    for (iteration = 0; iteration < context->iterations; ++iteration) {
+      size_t compressed_size = compressed_capacity;
+      size_t decompressed_size = file->size;
+      uint64_t start = NowNanos();
+      uint64_t elapsed;
+      if (!Compress(settings, file->size, file->data, &compressed_size,
+                    compressed)) {
+        fprintf(stderr, "compression of %s failed\n", file->path);
+        return BROTLI_FALSE;
+      }
+      elapsed = NowNanos() - start;
+      compress_nanos += elapsed;
+      compress_samples[num_samples] = elapsed;
+
+      start = NowNanos();
+      if (BrotliDecoderDecompress(compressed_size, compressed,
+          &decompressed_size, decompressed) != BROTLI_DECODER_RESULT_SUCCESS ||
+          decompressed_size != file->size ||
+          memcmp(decompressed, file->data, file->size) != 0) {
+        fprintf(stderr, "round-trip of %s failed\n", file->path);
+        return BROTLI_FALSE;
+      }
+      elapsed = NowNanos() - start;
+      decompress_nanos += elapsed;
+      decompress_samples[num_samples] = elapsed;
+      num_samples++;
+      if (iteration == 0) compressed_total += compressed_size;
+    }
+  }
+
+  if (!MeasureMemory(&context->files[largest], settings, compressed,
+                     compressed_capacity, decompressed, &encoder_peak,
+                     &decoder_peak)) {
+    fprintf(stderr, "streaming round-trip of %s failed\n",
+            context->files[largest].path);
+    return BROTLI_FALSE;
+  }
+
+  ratio = compressed_total ?
+      (double)context->total_size / (double)compressed_total : 0.0;
+  compress_speed = Throughput(
+      context->total_size * (size_t)context->iterations, compress_nanos);
+  if (context->results) {
+    CaseResult* result = &context->results[context->num_results++];
+    result->settings = *settings;
+    result->ratio = ratio;
+    result->compress_speed = compress_speed;
+    result->encoder_peak = encoder_peak;
+  }
+
+  printf("%2d %5d %4d %5d %4d %3d %3d %7.3f %9.2f %9.2f %9.3f %9.3f %9.3f "
+         "%9.3f %10lu %10lu\n",
+         settings->quality, settings->lgwin, settings->mode,
+         settings->lgblock, hasher->type, hasher->bucket_bits,
+         hasher->block_bits, ratio, compress_speed,
+         Throughput(context->total_size * (size_t)context->iterations,
+                    decompress_nanos),
+         Percentile(compress_samples, num_samples, 50),
+         Percentile(compress_samples, num_samples, 99),
+         Percentile(decompress_samples, num_samples, 50),
+         Percentile(decompress_samples, num_samples, 99),
+         (unsigned long)(encoder_peak >> 10),
+         (unsigned long)(decoder_peak >> 10));
+  fflush(stdout);
+  return BROTLI_TRUE;
+}
+
+/* Returns true if |a| is at least as good as |b| in every respect, and better
+   in at least one. */
+static BROTLI_BOOL Dominates(const CaseResult* a, const CaseResult* b) {
+  if (a->ratio < b->ratio || a->compress_speed < b->compress_speed ||
+      a->encoder_peak > b->encoder_peak) {
+    return BROTLI_FALSE;
+  }
+  return TO_BROTLI_BOOL(a->ratio > b->ratio ||
+                        a->compress_speed > b->compress_speed ||
+                        a->encoder_peak < b->encoder_peak);
+}
+
+static int CompareSpeed(const void* a, const void* b) {
+  double x = ((const CaseResult*)a)->compress_speed;
+  double y = ((const CaseResult*)b)->compress_speed;
+  return (x > y) ? -1 : ((x < y) ? 1 : 0);
+}
+
+static const char* ModeName(int mode) {
+  switch (mode) {
+    case BROTLI_MODE_TEXT: return "text";
+    case BROTLI_MODE_FONT: return "font";
+    default: return "generic";
+  }
+}
+
+/* Appends the Pareto front of measured cases to the preset file.
+   Reorders |context->results|. */
+static BROTLI_BOOL WritePresets(Context* context) {
+  CaseResult* results = context->results;
+  size_t num_front = 0;
+  size_t i;
+  size_t j;
+  FILE* fout;
+
+  for (i = 0; i < context->num_results; ++i) {
+    BROTLI_BOOL dominated = BROTLI_FALSE;
+    for (j = 0; j < context->num_results && !dominated; ++j) {
+      dominated = Dominates(&results[j], &results[i]);
+    }
+    if (!dominated) results[num_front++] = results[i];
+  }
+  qsort(results, num_front, sizeof(CaseResult), CompareSpeed);
+
+  fout = fopen(context->preset_path, "a");
+  if (!fout) {
+    fprintf(stderr, "failed to open %s\n", context->preset_path);
+    return BROTLI_FALSE;
+  }
+  fprintf(fout, "# %s: %lu files, %lu bytes, %lu of %lu cases\n",
+          context->preset_name, (unsigned long)context->num_files,
+          (unsigned long)context->total_size, (unsigned long)num_front,
+          (unsigned long)context->num_results);
+  for (i = 0; i < num_front; ++i) {
+    const Settings* settings = &results[i].settings;
+    fprintf(fout, "%s.%lu=quality=%d window=%d mode=%s lgblock=%d "
+            "hasher=%d bucket=%d block=%d ratio=%.3f speed=%.2f memory=%lu\n",
+            context->preset_name, (unsigned long)i, settings->quality,
+            settings->lgwin, ModeName(settings->mode), settings->lgblock,
+            settings->hasher.type, settings->hasher.bucket_bits,
+            settings->hasher.block_bits, results[i].ratio,
+            results[i].compress_speed,
+            (unsigned long)(results[i].encoder_peak >> 10));
+  }
+  if (fclose(fout) != 0) {
+    fprintf(stderr, "failed to write %s\n", context->preset_path);
+    return BROTLI_FALSE;
+  }
+  printf("%lu presets written to %s\n", (unsigned long)num_front,
+         context->preset_path);
+  return BROTLI_TRUE;
+}
+
+/* Preset names become property keys; keep them to safe characters. */
+static BROTLI_BOOL IsValidPresetName(const char* name) {
+  size_t i;
+  size_t length = strlen(name);
+  if (length == 0 || length > MAX_PRESET_NAME) return BROTLI_FALSE;
+  for (i = 0; i < length; ++i) {
+    char c = name[i];
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+      return BROTLI_FALSE;
+    }
+  }
+  return BROTLI_TRUE;
+}
+
+static void PrintHelp(const char* name) {
+  fprintf(stderr,
+      "Usage: %s [-q QUALITY[-QUALITY]] [-w LGWIN[,LGWIN...]] [-i NUM] "
+      "[-m MODE[,MODE...]] [-l BITS[,BITS...]] [-H TYPE[,TYPE...]] "
+      "[-b BITS[,BITS...]] [-c BITS[,BITS...]] [-o FILE -n NAME] FILE...\n"
+      "  -q  quality or range of qualities, default: 0-11\n"
+      "  -w  window sizes, default: 22\n"
+      "  -i  iterations per file and combination, default: 3\n"
+      "  -m  encoder modes, 0 generic, 1 text, 2 font, default: 0\n"
+      "  -l  input block bits, 0 for default, default: 0\n"
+      "  -H  hasher types, 0 for default, default: 0\n"
+      "  -b  hasher bucket bits, 0 for default, default: 0\n"
+      "  -c  hasher block bits, -1 for default, default: -1\n"
+      "  -o  append Pareto-optimal cases to this preset file\n"
+      "  -n  content type name of the presets\n",
+      name);
+}
+
+int main(int argc, char** argv) {
+  Context context;
+  uint8_t* compressed = NULL;
+  uint8_t* decompressed = NULL;
+  uint64_t* compress_samples = NULL;
+  uint64_t* decompress_samples = NULL;
+  size_t compressed_capacity;
+  size_t num_samples;
+  size_t i;
+  int first_file = 1;
+  size_t num_cases;
+  int quality;
+  int w;
+  int m;
+  int l;
+  int h;
+  int b;
+  int c;
+  int result = 1;
+
+  memset(&context, 0, sizeof(context));
+  context.min_quality = BROTLI_MIN_QUALITY;
+  context.max_quality = BROTLI_MAX_QUALITY;
+  context.windows[0] = BROTLI_DEFAULT_WINDOW;
+  context.num_windows = 1;
+  context.num_modes = 1;
+  context.num_lgblocks = 1;
+  context.num_hashers = 1;
+  context.num_bucket_bits = 1;
+  context.block_bits[0] = -1;
+  context.num_block_bits = 1;
+  context.iterations = 3;
+
+  while (first_file < argc && argv[first_file][0] == '-') {
+    const char* option = argv[first_file];
+    const char* value = (first_file + 1 < argc) ? argv[first_file + 1] : NULL;
+    BROTLI_BOOL ok = BROTLI_FALSE;
+    if (value) {
+      if (strcmp(option, "-q") == 0) {
+        ok = ParseQualities(value, &context);
+      } else if (strcmp(option, "-w") == 0) {
+        ok = ParseList(value, BROTLI_MIN_WINDOW_BITS, BROTLI_MAX_WINDOW_BITS,
+                       context.windows, &context.num_windows);
+      } else if (strcmp(option, "-m") == 0) {
+        ok = ParseList(value, BROTLI_MODE_GENERIC, BROTLI_MODE_FONT,
+                       context.modes, &context.num_modes);
+      } else if (strcmp(option, "-l") == 0) {
+        ok = ParseList(value, 0, BROTLI_MAX_INPUT_BLOCK_BITS,
+                       context.lgblocks, &context.num_lgblocks);
+        for (l = 0; ok && l < context.num_lgblocks; ++l) {
+          int bits = context.lgblocks[l];
+          ok = TO_BROTLI_BOOL(bits == 0 || bits >= BROTLI_MIN_INPUT_BLOCK_BITS);
+        }
+      } else if (strcmp(option, "-o") == 0) {
+        context.preset_path = value;
+        ok = BROTLI_TRUE;
+      } else if (strcmp(option, "-n") == 0) {
+        context.preset_name = value;
+        ok = IsValidPresetName(value);
+      } else if (strcmp(option, "-H") == 0) {
+        ok = ParseList(value, 0, 65, context.hashers, &context.num_hashers);
+      } else if (strcmp(option, "-b") == 0) {
+        ok = ParseList(value, 0, 24, context.bucket_bits,
+                       &context.num_bucket_bits);
+      } else if (strcmp(option, "-c") == 0) {
+        ok = ParseList(value, -1, 10, context.block_bits,
+                       &context.num_block_bits);
+      } else if (strcmp(option, "-i") == 0) {
+        ok = ParseInt(value, 1, 1000000, &context.iterations);
+      }
+    }
+    if (!ok) {
+      PrintHelp(argv[0]);
+      return 1;
+    }
+    first_file += 2;
+  }
+  if (first_file == argc ||
+      (context.preset_path == NULL) != (context.preset_name == NULL)) {
+    PrintHelp(argv[0]);
+    return 1;
+  }
+
+  context.num_files = (size_t)(argc - first_file);
+  context.files = (InputFile*)calloc(context.num_files, sizeof(InputFile));
+  if (!context.files) return 1;
+  for (i = 0; i < context.num_files; ++i) {
+    context.files[i].path = argv[first_file + (int)i];
+    if (!ReadInput(&context.files[i])) goto finish;
+    context.total_size += context.files[i].size;
+    if (context.files[i].size > context.max_size) {
+      context.max_size = context.files[i].size;
+    }
+  }
+
+  compressed_capacity = BrotliEncoderMaxCompressedSize(context.max_size);
+  if (compressed_capacity == 0) compressed_capacity = context.max_size + 1024;
+  num_samples = context.num_files * (size_t)context.iterations;
+  compressed = (uint8_t*)malloc(compressed_capacity);
+  decompressed = (uint8_t*)malloc(context.max_size ? context.max_size : 1);
+  compress_samples = (uint64_t*)malloc(num_samples * sizeof(uint64_t));
+  decompress_samples = (uint64_t*)malloc(num_samples * sizeof(uint64_t));
+  num_cases = (size_t)(context.max_quality - context.min_quality + 1) *
+      (size_t)context.num_windows * (size_t)context.num_modes *
+      (size_t)context.num_lgblocks * (size_t)context.num_hashers *
+      (size_t)context.num_bucket_bits * (size_t)context.num_block_bits;
+  if (context.preset_path) {
+    context.results = (CaseResult*)malloc(num_cases * sizeof(CaseResult));
+  }
+  if (!compressed || !decompressed || !compress_samples ||
+      !decompress_samples || (context.preset_path && !context.results)) {
+    fprintf(stderr, "out of memory\n");
+    goto finish;
+  }
+
+  printf("%lu files, %lu bytes\n", (unsigned long)context.num_files,
+         (unsigned long)context.total_size);
+  printf("%2s %5s %4s %5s %4s %3s %3s %7s %9s %9s %9s %9s %9s %9s %10s "
+         "%10s\n",
+         "q", "lgwin", "mode", "lgblk", "hash", "bkt", "blk", "ratio",
+         "comp MB/s", "dec MB/s", "comp p50", "comp p99", "dec p50",
+         "dec p99", "enc KiB", "dec KiB");
+  for (quality = context.min_quality; quality <= context.max_quality;
+       ++quality) {
+    for (w = 0; w < context.num_windows; ++w) {
+      for (m = 0; m < context.num_modes; ++m) {
+        for (l = 0; l < context.num_lgblocks; ++l) {
+          for (h = 0; h < context.num_hashers; ++h) {
+            for (b = 0; b < context.num_bucket_bits; ++b) {
+              for (c = 0; c < context.num_block_bits; ++c) {
+                Settings settings;
+                settings.quality = quality;
+                settings.lgwin = context.windows[w];
+                settings.mode = context.modes[m];
+                settings.lgblock = context.lgblocks[l];
+                settings.hasher.type = context.hashers[h];
+                settings.hasher.bucket_bits = context.bucket_bits[b];
+                settings.hasher.block_bits = context.block_bits[c];
+                if (!RunCase(&context, &settings, compressed,
+                             compressed_capacity, decompressed,
+                             compress_samples, decompress_samples)) {
+                  goto finish;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  if (context.preset_path && !WritePresets(&context)) goto finish;
+  result = 0;
+
+finish:
+  for (i = 0; i < context.num_files; ++i) free(context.files[i].data);
+  free(context.files);
+  free(compressed);
+  free(decompressed);
+  free(compress_samples);
+  free(decompress_samples);
+  free(context.results);
+  return result;
+}
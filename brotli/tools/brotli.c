@@ -26,13 +26,18 @@
 #include <brotli/encode.h>
 
 #if !defined(_WIN32)
+#include <pthread.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <utime.h>
 #define MAKE_BINARY(FILENO) (FILENO)
 #else
 #include <io.h>
+#include <process.h>
+#include <direct.h>
 #include <share.h>
 #include <sys/utime.h>
+#include <windows.h>
 
 #define MAKE_BINARY(FILENO) (_setmode((FILENO), _O_BINARY), (FILENO))
 
@@ -52,6 +57,10 @@
 #define fopen ms_fopen
 #define open ms_open
 
+#define fsync _commit
+#define ftruncate _chsize_s
+
+#define mkdir(P, M) _mkdir(P)
 #define chmod(F, P) (0)
 #define chown(F, O, G) (0)
 
@@ -79,6 +88,7 @@ typedef enum {
   COMMAND_HELP,
   COMMAND_INVALID,
   COMMAND_TEST_INTEGRITY,
+  COMMAND_TRAIN,
   COMMAND_NOOP,
   COMMAND_VERSION
 } Command;
@@ -86,11 +96,18 @@ typedef enum {
 #define DEFAULT_LGWIN 24
 #define DEFAULT_SUFFIX ".br"
 #define MAX_OPTIONS 20
+#define MAX_THREADS 64
+#define DEFAULT_TRAIN_SIZE_KIB 110
+#define MAX_TRAIN_SIZE_KIB 16384
+#define DEFAULT_CHECKPOINT_INTERVAL_MIB 256
+#define MAX_CHECKPOINT_INTERVAL_MIB 65536
 
 typedef struct {
   /* Parameters */
   int quality;
   int lgwin;
+  int threads;
+  int chunk_bits;
   int verbosity;
   BROTLI_BOOL force_overwrite;
   BROTLI_BOOL junk_source;
@@ -99,8 +116,16 @@ typedef struct {
   BROTLI_BOOL test_integrity;
   BROTLI_BOOL decompress;
   BROTLI_BOOL large_window;
+  BROTLI_BOOL long_distance;
+  BROTLI_BOOL shortest_path;
+  BROTLI_BOOL train_serialized;
+  BROTLI_BOOL solid;
+  size_t train_size;
+  uint64_t checkpoint_interval;
   const char* output_path;
   const char* dictionary_path;
+  const char* checkpoint_path;
+  const char* extract_name;
   const char* suffix;
   int not_input_indices[MAX_OPTIONS];
   size_t longest_path_len;
@@ -111,11 +136,14 @@ typedef struct {
   char** argv;
   uint8_t* dictionary;
   size_t dictionary_size;
+  BROTLI_BOOL dictionary_mapped;
   BrotliEncoderPreparedDictionary* prepared_dictionary;
   char* modified_path;  /* Storage for path with appended / cut suffix */
   int iterator;
   int ignore;
   BROTLI_BOOL iterator_error;
+  /* Once a checkpoint refers to the output, it is kept on failure. */
+  BROTLI_BOOL checkpoint_saved;
   uint8_t* buffer;
   uint8_t* input;
   uint8_t* output;
@@ -194,6 +222,10 @@ static Command ParseParams(Context* params) {
   BROTLI_BOOL keep_set = BROTLI_FALSE;
   BROTLI_BOOL lgwin_set = BROTLI_FALSE;
   BROTLI_BOOL suffix_set = BROTLI_FALSE;
+  BROTLI_BOOL threads_set = BROTLI_FALSE;
+  BROTLI_BOOL train_size_set = BROTLI_FALSE;
+  BROTLI_BOOL checkpoint_interval_set = BROTLI_FALSE;
+  BROTLI_BOOL chunk_bits_set = BROTLI_FALSE;
   BROTLI_BOOL after_dash_dash = BROTLI_FALSE;
   Command command = ParseAlias(argv[0]);
 
@@ -209,7 +241,8 @@ static Command ParseParams(Context* params) {
     }
 
     /* Too many options. The expected longest option list is:
-       "-q 0 -w 10 -o f -D d -S b -d -f -k -n -v --", i.e. 16 items in total.
+       "-q 0 -w 10 -T 4 -o f -D d -S b -d -f -k -n -v --", i.e. 18 items in
+       total.
        This check is an additional guard that is never triggered, but provides
        a guard for future changes. */
     if (next_option_index > (MAX_OPTIONS - 2)) {
@@ -314,8 +347,9 @@ static Command ParseParams(Context* params) {
           params->quality = 11;
           continue;
         }
-        /* o/q/w/D/S with parameter is expected */
-        if (c != 'o' && c != 'q' && c != 'w' && c != 'D' && c != 'S') {
+        /* o/q/w/D/S/T with parameter is expected */
+        if (c != 'o' && c != 'q' && c != 'w' && c != 'D' && c != 'S' &&
+            c != 'T') {
           fprintf(stderr, "invalid argument -%c\n", c);
           return COMMAND_INVALID;
         }
@@ -376,6 +410,16 @@ static Command ParseParams(Context* params) {
           }
           suffix_set = BROTLI_TRUE;
           params->suffix = argv[i];
+        } else if (c == 'T') {
+          if (threads_set) {
+            fprintf(stderr, "threads already set\n");
+            return COMMAND_INVALID;
+          }
+          threads_set = ParseInt(argv[i], 1, MAX_THREADS, &params->threads);
+          if (!threads_set) {
+            fprintf(stderr, "error parsing threads value [%s]\n", argv[i]);
+            return COMMAND_INVALID;
+          }
         }
       }
     } else {  /* Double-dash. */
@@ -410,6 +454,18 @@ static Command ParseParams(Context* params) {
         }
         keep_set = BROTLI_TRUE;
         params->junk_source = BROTLI_FALSE;
+      } else if (strcmp("long", arg) == 0) {
+        if (params->long_distance) {
+          fprintf(stderr, "argument --long already set\n");
+          return COMMAND_INVALID;
+        }
+        params->long_distance = BROTLI_TRUE;
+      } else if (strcmp("shortest-path", arg) == 0) {
+        if (params->shortest_path) {
+          fprintf(stderr, "argument --shortest-path already set\n");
+          return COMMAND_INVALID;
+        }
+        params->shortest_path = BROTLI_TRUE;
       } else if (strcmp("no-copy-stat", arg) == 0) {
         if (!params->copy_stat) {
           fprintf(stderr, "argument --no-copy-stat / -n already set\n");
@@ -423,6 +479,18 @@ static Command ParseParams(Context* params) {
         }
         keep_set = BROTLI_TRUE;
         params->junk_source = BROTLI_TRUE;
+      } else if (strcmp("serialized", arg) == 0) {
+        if (params->train_serialized) {
+          fprintf(stderr, "argument --serialized already set\n");
+          return COMMAND_INVALID;
+        }
+        params->train_serialized = BROTLI_TRUE;
+      } else if (strcmp("solid", arg) == 0) {
+        if (params->solid) {
+          fprintf(stderr, "argument --solid already set\n");
+          return COMMAND_INVALID;
+        }
+        params->solid = BROTLI_TRUE;
       } else if (strcmp("stdout", arg) == 0) {
         if (output_set) {
           fprintf(stderr, "write to standard output already set\n");
@@ -437,6 +505,13 @@ static Command ParseParams(Context* params) {
         }
         command_set = BROTLI_TRUE;
         command = COMMAND_TEST_INTEGRITY;
+      } else if (strcmp("train", arg) == 0) {
+        if (command_set) {
+          fprintf(stderr, "command already set when parsing --train\n");
+          return COMMAND_INVALID;
+        }
+        command_set = BROTLI_TRUE;
+        command = COMMAND_TRAIN;
       } else if (strcmp("verbose", arg) == 0) {
         if (params->verbosity > 0) {
           fprintf(stderr, "argument --verbose / -v already set\n");
@@ -456,12 +531,63 @@ static Command ParseParams(Context* params) {
         }
         key_len = (size_t)(value - arg);
         value++;
-        if (strncmp("dictionary", arg, key_len) == 0) {
+        if (strncmp("checkpoint", arg, key_len) == 0) {
+          if (params->checkpoint_path) {
+            fprintf(stderr, "checkpoint path already set\n");
+            return COMMAND_INVALID;
+          }
+          params->checkpoint_path = value;
+        } else if (strncmp("checkpoint-interval", arg, key_len) == 0) {
+          int interval_mib;
+          if (checkpoint_interval_set) {
+            fprintf(stderr, "checkpoint interval already set\n");
+            return COMMAND_INVALID;
+          }
+          checkpoint_interval_set = ParseInt(value, 1,
+              MAX_CHECKPOINT_INTERVAL_MIB, &interval_mib);
+          if (!checkpoint_interval_set) {
+            fprintf(stderr, "error parsing checkpoint interval value [%s]\n",
+                    value);
+            return COMMAND_INVALID;
+          }
+          params->checkpoint_interval = (uint64_t)interval_mib << 20;
+        } else if (strncmp("chunk-bits", arg, key_len) == 0) {
+          if (chunk_bits_set) {
+            fprintf(stderr, "chunk bits already set\n");
+            return COMMAND_INVALID;
+          }
+          chunk_bits_set = ParseInt(value, BROTLI_MIN_CHUNK_BITS,
+              BROTLI_MAX_CHUNK_BITS, &params->chunk_bits);
+          if (!chunk_bits_set) {
+            fprintf(stderr, "error parsing chunk bits value [%s]\n", value);
+            return COMMAND_INVALID;
+          }
+        } else if (strncmp("dictionary", arg, key_len) == 0) {
           if (params->dictionary_path) {
             fprintf(stderr, "dictionary path already set\n");
             return COMMAND_INVALID;
           }
           params->dictionary_path = value;
+        } else if (strncmp("dictionary-size", arg, key_len) == 0) {
+          int train_size_kib;
+          if (train_size_set) {
+            fprintf(stderr, "dictionary size already set\n");
+            return COMMAND_INVALID;
+          }
+          train_size_set = ParseInt(value, 1, MAX_TRAIN_SIZE_KIB,
+                                    &train_size_kib);
+          if (!train_size_set) {
+            fprintf(stderr, "error parsing dictionary size value [%s]\n",
+                    value);
+            return COMMAND_INVALID;
+          }
+          params->train_size = (size_t)train_size_kib << 10;
+        } else if (strncmp("extract", arg, key_len) == 0) {
+          if (params->extract_name) {
+            fprintf(stderr, "extract name already set\n");
+            return COMMAND_INVALID;
+          }
+          params->extract_name = value;
         } else if (strncmp("lgwin", arg, key_len) == 0) {
           if (lgwin_set) {
             fprintf(stderr, "lgwin parameter already set\n");
@@ -522,6 +648,16 @@ static Command ParseParams(Context* params) {
           }
           suffix_set = BROTLI_TRUE;
           params->suffix = value;
+        } else if (strncmp("threads", arg, key_len) == 0) {
+          if (threads_set) {
+            fprintf(stderr, "threads already set\n");
+            return COMMAND_INVALID;
+          }
+          threads_set = ParseInt(value, 1, MAX_THREADS, &params->threads);
+          if (!threads_set) {
+            fprintf(stderr, "error parsing threads value [%s]\n", value);
+            return COMMAND_INVALID;
+          }
         } else {
           fprintf(stderr, "invalid parameter: [%s]\n", arg);
           return COMMAND_INVALID;
@@ -535,7 +671,62 @@ static Command ParseParams(Context* params) {
   params->decompress = (command == COMMAND_DECOMPRESS);
   params->test_integrity = (command == COMMAND_TEST_INTEGRITY);
 
-  if (input_count > 1 && output_set) return COMMAND_INVALID;
+  if (command == COMMAND_TRAIN) {
+    if (!params->output_path && !params->write_to_stdout) {
+      fprintf(stderr, "--train requires an output (-o or -c)\n");
+      return COMMAND_INVALID;
+    }
+  } else if (params->train_serialized || train_size_set) {
+    fprintf(stderr, "--serialized and --dictionary-size need --train\n");
+    return COMMAND_INVALID;
+  }
+  if (params->checkpoint_path) {
+    /* Resumed run truncates the output and seeks the input. */
+    if (command != COMMAND_COMPRESS || input_count != 1 ||
+        params->write_to_stdout || params->threads > 1) {
+      fprintf(stderr, "--checkpoint needs compression of a single input file "
+                      "to a file with 1 thread\n");
+      return COMMAND_INVALID;
+    }
+  } else if (checkpoint_interval_set) {
+    fprintf(stderr, "--checkpoint-interval needs --checkpoint\n");
+    return COMMAND_INVALID;
+  }
+  if (chunk_bits_set &&
+      (command != COMMAND_COMPRESS || params->checkpoint_path)) {
+    /* Resumed run would not find the same cut points. */
+    fprintf(stderr, "--chunk-bits needs compression without --checkpoint\n");
+    return COMMAND_INVALID;
+  }
+  if (params->solid) {
+    BROTLI_BOOL has_output =
+        TO_BROTLI_BOOL(params->output_path || params->write_to_stdout);
+    if (command == COMMAND_COMPRESS) {
+      if (input_count == 0 || !has_output || params->checkpoint_path) {
+        fprintf(stderr, "--solid compression needs input files and "
+                        "an output (-o or -c)\n");
+        return COMMAND_INVALID;
+      }
+    } else if (command == COMMAND_DECOMPRESS) {
+      if (input_count != 1 || (params->output_path && !params->extract_name)) {
+        fprintf(stderr, "--solid decompression needs a single archive; "
+                        "-o needs --extract\n");
+        return COMMAND_INVALID;
+      }
+    } else {
+      fprintf(stderr, "--solid needs compression or decompression\n");
+      return COMMAND_INVALID;
+    }
+  }
+  if (params->extract_name &&
+      (!params->solid || command != COMMAND_DECOMPRESS)) {
+    fprintf(stderr, "--extract needs --solid decompression\n");
+    return COMMAND_INVALID;
+  }
+  if (input_count > 1 && output_set && command != COMMAND_TRAIN &&
+      !params->solid) {
+    return COMMAND_INVALID;
+  }
   if (params->test_integrity) {
     if (params->output_path) return COMMAND_INVALID;
     if (params->write_to_stdout) return COMMAND_INVALID;
@@ -577,7 +768,10 @@ static void PrintHelp(const char* name, BROTLI_BOOL error) {
           BROTLI_MIN_QUALITY, BROTLI_MAX_QUALITY);
   fprintf(media,
 "  -t, --test                  test compressed file integrity\n"
-"  -v, --verbose               verbose mode\n");
+"  -T NUM, --threads=NUM       compress with NUM threads (1-%d); several\n"
+"                              files are compressed by NUM parallel jobs\n"
+"  -v, --verbose               verbose mode\n",
+          MAX_THREADS);
   fprintf(media,
 "  -w NUM, --lgwin=NUM         set LZ77 window size (0, %d-%d)\n"
 "                              window size = 2**NUM - 16\n"
@@ -591,7 +785,38 @@ static void PrintHelp(const char* name, BROTLI_BOOL error) {
 "                              decodable with regular brotli decoders\n",
           BROTLI_MIN_WINDOW_BITS, BROTLI_LARGE_MAX_WINDOW_BITS);
   fprintf(media,
-"  -D FILE, --dictionary=FILE  use FILE as raw (LZ77) dictionary\n");
+"  --long                      find long repeats anywhere in the window\n"
+"                              (quality 2-9; takes 64 MiB more memory)\n"
+"  --shortest-path             pick matches by shortest path (quality 5-9;\n"
+"                              -q 9 --shortest-path is between 9 and 10)\n");
+  fprintf(media,
+"  -D FILE, --dictionary=FILE  use FILE as raw (LZ77) dictionary; a previous\n"
+"                              version of the input makes a delta (quality\n"
+"                              5 or more is needed to search it)\n");
+  fprintf(media,
+"  --train                     train a raw dictionary on sample FILE(s)\n"
+"  --dictionary-size=NUM       trained dictionary size in KiB (default: %d)\n"
+"  --serialized                write trained dictionary in shared dictionary\n"
+"                              format instead of raw\n",
+          DEFAULT_TRAIN_SIZE_KIB);
+  fprintf(media,
+"  --checkpoint=FILE           save progress to FILE every interval; if FILE\n"
+"                              exists, resume from it instead of starting\n"
+"                              over (single input and output file only)\n"
+"  --checkpoint-interval=NUM   checkpoint interval in MiB (default: %d)\n",
+          DEFAULT_CHECKPOINT_INTERVAL_MIB);
+  fprintf(media,
+"  --chunk-bits=NUM            cut stream into independent chunks of about\n"
+"                              2**NUM bytes (%d-%d) at content-defined points,\n"
+"                              so that identical data of different versions\n"
+"                              compresses to identical bytes for deduplication\n",
+          BROTLI_MIN_CHUNK_BITS, BROTLI_MAX_CHUNK_BITS);
+  fprintf(media,
+"  --solid                     compress all FILE(s) into one archive that\n"
+"                              shares the window (needs -o or -c); with -d,\n"
+"                              extract files of an archive\n"
+"  --extract=NAME              extract only file NAME of a solid archive;\n"
+"                              it is written to -o FILE or -c, if given\n");
   fprintf(media,
 "  -S SUF, --suffix=SUF        output file suffix (default:'%s')\n",
           DEFAULT_SUFFIX);
@@ -696,6 +921,25 @@ static void CopyStat(const char* input_path, const char* output_path) {
   }
 }
 
+/* A previous version given for a delta is often big; it is mapped instead of
+   copied where possible. Returns false if the file has to be read. */
+static BROTLI_BOOL MapDictionary(Context* context, FILE* f) {
+#if !defined(_WIN32)
+  void* mapped;
+  if (context->dictionary_size == 0) return BROTLI_FALSE;
+  mapped = mmap(NULL, context->dictionary_size, PROT_READ, MAP_PRIVATE,
+                fileno(f), 0);
+  if (mapped == MAP_FAILED) return BROTLI_FALSE;
+  context->dictionary = (uint8_t*)mapped;
+  context->dictionary_mapped = BROTLI_TRUE;
+  return BROTLI_TRUE;
+#else
+  (void)context;
+  (void)f;
+  return BROTLI_FALSE;
+#endif
+}
+
 /* Result ownership is passed to caller.
    |*dictionary_size| is set to resulting buffer size. */
 static BROTLI_BOOL ReadDictionary(Context* context, Command command) {
@@ -730,26 +974,30 @@ static BROTLI_BOOL ReadDictionary(Context* context, Command command) {
   }
   context->dictionary_size = (size_t)file_size_64;
 
-  buffer = (uint8_t*)malloc(context->dictionary_size);
-  if (!buffer) {
-    fprintf(stderr, "could not read dictionary: out of memory\n");
-    fclose(f);
-    return BROTLI_FALSE;
-  }
-  bytes_read = fread(buffer, sizeof(uint8_t), context->dictionary_size, f);
-  if (bytes_read != context->dictionary_size) {
-    free(buffer);
-    fprintf(stderr, "failed to read dictionary [%s]: %s\n",
-            PrintablePath(context->dictionary_path), strerror(errno));
-    fclose(f);
-    return BROTLI_FALSE;
+  if (!MapDictionary(context, f)) {
+    buffer = (uint8_t*)malloc(context->dictionary_size);
+    if (!buffer) {
+      fprintf(stderr, "could not read dictionary: out of memory\n");
+      fclose(f);
+      return BROTLI_FALSE;
+    }
+    bytes_read = fread(buffer, sizeof(uint8_t), context->dictionary_size, f);
+    if (bytes_read != context->dictionary_size) {
+      free(buffer);
+      fprintf(stderr, "failed to read dictionary [%s]: %s\n",
+              PrintablePath(context->dictionary_path), strerror(errno));
+      fclose(f);
+      return BROTLI_FALSE;
+    }
+    context->dictionary = buffer;
   }
   fclose(f);
-  context->dictionary = buffer;
   if (command == COMMAND_COMPRESS) {
-    context->prepared_dictionary = BrotliEncoderPrepareDictionary(
-        BROTLI_SHARED_DICTIONARY_RAW, context->dictionary_size,
-        context->dictionary, BROTLI_MAX_QUALITY, NULL, NULL, NULL);
+    /* The dictionary outlives the prepared one; index it in place, only as
+       densely as the chosen quality is going to search it. */
+    context->prepared_dictionary = BrotliEncoderPrepareLeanDictionary(
+        context->dictionary_size, context->dictionary, context->quality,
+        NULL, NULL, NULL);
     if (context->prepared_dictionary == NULL) {
       fprintf(stderr, "failed to prepare dictionary [%s]\n",
               PrintablePath(context->dictionary_path));
@@ -802,6 +1050,8 @@ static BROTLI_BOOL NextFile(Context* context) {
 
   if (context->output_path) return BROTLI_TRUE;
   if (context->write_to_stdout) return BROTLI_TRUE;
+  /* Solid archive names its own outputs. */
+  if (context->solid) return BROTLI_TRUE;
 
   strcpy(context->modified_path, arg);
   context->current_output_path = context->modified_path;
@@ -844,7 +1094,8 @@ static BROTLI_BOOL OpenFiles(Context* context) {
 static BROTLI_BOOL CloseFiles(Context* context, BROTLI_BOOL success) {
   BROTLI_BOOL is_ok = BROTLI_TRUE;
   if (!context->test_integrity && context->fout) {
-    if (!success && context->current_output_path) {
+    if (!success && context->current_output_path &&
+        !context->checkpoint_saved) {
       unlink(context->current_output_path);
     }
     if (fclose(context->fout) != 0) {
@@ -900,6 +1151,40 @@ static BROTLI_BOOL HasMoreInput(Context* context) {
   return feof(context->fin) ? BROTLI_FALSE : BROTLI_TRUE;
 }
 
+/* Input files bigger than the read buffer are mapped instead of read, so
+   that they are not copied through stdio. Returns NULL if the file has to be
+   read. */
+static const uint8_t* MapInputFile(Context* context, size_t* size) {
+#if !defined(_WIN32)
+  struct stat statbuf;
+  void* mapped;
+  if (!context->current_input_path) return NULL;
+  if (fstat(fileno(context->fin), &statbuf) != 0) return NULL;
+  if (!S_ISREG(statbuf.st_mode)) return NULL;
+  if ((uint64_t)statbuf.st_size <= kFileBufferSize) return NULL;
+  if ((uint64_t)statbuf.st_size != (uint64_t)(size_t)statbuf.st_size) {
+    return NULL;
+  }
+  *size = (size_t)statbuf.st_size;
+  mapped = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fileno(context->fin), 0);
+  if (mapped == MAP_FAILED) return NULL;
+  return (const uint8_t*)mapped;
+#else
+  (void)context;
+  (void)size;
+  return NULL;
+#endif
+}
+
+static void UnmapInputFile(const uint8_t* data, size_t size) {
+#if !defined(_WIN32)
+  munmap((void*)data, size);
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
 static BROTLI_BOOL ProvideInput(Context* context) {
   context->available_in =
       fread(context->input, 1, kFileBufferSize, context->fin);
@@ -913,14 +1198,13 @@ static BROTLI_BOOL ProvideInput(Context* context) {
   return BROTLI_TRUE;
 }
 
-/* Internal: should be used only in Provide-/Flush-Output. */
-static BROTLI_BOOL WriteOutput(Context* context) {
-  size_t out_size = (size_t)(context->next_out - context->output);
-  context->total_out += out_size;
-  if (out_size == 0) return BROTLI_TRUE;
+static BROTLI_BOOL WriteData(Context* context, const uint8_t* data,
+                             size_t size) {
+  context->total_out += size;
+  if (size == 0) return BROTLI_TRUE;
   if (context->test_integrity) return BROTLI_TRUE;
 
-  fwrite(context->output, 1, out_size, context->fout);
+  fwrite(data, 1, size, context->fout);
   if (ferror(context->fout)) {
     fprintf(stderr, "failed to write output [%s]: %s\n",
             PrintablePath(context->current_output_path), strerror(errno));
@@ -929,6 +1213,12 @@ static BROTLI_BOOL WriteOutput(Context* context) {
   return BROTLI_TRUE;
 }
 
+/* Internal: should be used only in Provide-/Flush-Output. */
+static BROTLI_BOOL WriteOutput(Context* context) {
+  return WriteData(context, context->output,
+                   (size_t)(context->next_out - context->output));
+}
+
 static BROTLI_BOOL ProvideOutput(Context* context) {
   if (!WriteOutput(context)) return BROTLI_FALSE;
   context->available_out = kFileBufferSize;
@@ -954,16 +1244,64 @@ static void PrintBytes(size_t value) {
   }
 }
 
-static void PrintFileProcessingProgress(Context* context) {
-  fprintf(stderr, "[%s]: ", PrintablePath(context->current_input_path));
-  PrintBytes(context->total_in);
+static void PrintProgress(const char* input_path, size_t total_in,
+                          size_t total_out, clock_t elapsed) {
+  fprintf(stderr, "[%s]: ", PrintablePath(input_path));
+  PrintBytes(total_in);
   fprintf(stderr, " -> ");
-  PrintBytes(context->total_out);
-  fprintf(stderr, " in %1.2f sec", (double)(context->end_time - context->start_time) / CLOCKS_PER_SEC);
+  PrintBytes(total_out);
+  fprintf(stderr, " in %1.2f sec", (double)elapsed / CLOCKS_PER_SEC);
+}
+
+static void PrintFileProcessingProgress(Context* context) {
+  PrintProgress(context->current_input_path, context->total_in,
+                context->total_out, context->end_time - context->start_time);
+}
+
+/* Decoder reads the mapping and its output is written straight from the ring
+   buffer. */
+static BROTLI_BOOL DecompressMappedFile(Context* context, BrotliDecoderState* s,
+    const uint8_t* input, size_t input_size) {
+  BrotliDecoderResult result;
+  size_t available_in = input_size;
+  const uint8_t* next_in = input;
+  size_t available_out = 0;
+  InitializeBuffers(context);
+  context->total_in = input_size;
+  for (;;) {
+    result = BrotliDecoderDecompressStream(s, &available_in, &next_in,
+        &available_out, NULL, NULL);
+    while (BrotliDecoderHasMoreOutput(s)) {
+      size_t size = 0;
+      const uint8_t* data = BrotliDecoderTakeOutput(s, &size);
+      if (!WriteData(context, data, size)) return BROTLI_FALSE;
+    }
+    if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) break;
+  }
+  if (result != BROTLI_DECODER_RESULT_SUCCESS || available_in != 0) {
+    fprintf(stderr, "corrupt input [%s]\n",
+            PrintablePath(context->current_input_path));
+    return BROTLI_FALSE;
+  }
+  if (context->verbosity > 0) {
+    context->end_time = clock();
+    fprintf(stderr, "Decompressed ");
+    PrintFileProcessingProgress(context);
+    fprintf(stderr, "\n");
+  }
+  return BROTLI_TRUE;
 }
 
 static BROTLI_BOOL DecompressFile(Context* context, BrotliDecoderState* s) {
   BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT;
+  size_t mapped_size = 0;
+  const uint8_t* mapped = MapInputFile(context, &mapped_size);
+  if (mapped) {
+    BROTLI_BOOL is_ok =
+        DecompressMappedFile(context, s, mapped, mapped_size);
+    UnmapInputFile(mapped, mapped_size);
+    return is_ok;
+  }
   InitializeBuffers(context);
   for (;;) {
     if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
@@ -1032,8 +1370,51 @@ static BROTLI_BOOL DecompressFiles(Context* context) {
   return BROTLI_TRUE;
 }
 
+/* Encoder reads the mapping in place, if it fits the window, and its output
+   is written straight from the encoder storage. */
+static BROTLI_BOOL CompressMappedFile(Context* context, BrotliEncoderState* s,
+    const uint8_t* input, size_t input_size) {
+  size_t available_in = input_size;
+  const uint8_t* next_in = input;
+  size_t available_out = 0;
+  InitializeBuffers(context);
+  context->total_in = input_size;
+  BrotliEncoderAttachInput(s, input_size, input);
+  for (;;) {
+    if (!BrotliEncoderCompressStream(s, BROTLI_OPERATION_FINISH,
+        &available_in, &next_in, &available_out, NULL, NULL)) {
+      fprintf(stderr, "failed to compress data [%s]\n",
+              PrintablePath(context->current_input_path));
+      return BROTLI_FALSE;
+    }
+    while (BrotliEncoderHasMoreOutput(s)) {
+      size_t size = 0;
+      const uint8_t* data = BrotliEncoderTakeOutput(s, &size);
+      if (!WriteData(context, data, size)) return BROTLI_FALSE;
+    }
+    if (BrotliEncoderIsFinished(s)) break;
+  }
+  if (context->verbosity > 0) {
+    context->end_time = clock();
+    fprintf(stderr, "Compressed ");
+    PrintFileProcessingProgress(context);
+    fprintf(stderr, "\n");
+  }
+  return BROTLI_TRUE;
+}
+
 static BROTLI_BOOL CompressFile(Context* context, BrotliEncoderState* s) {
   BROTLI_BOOL is_eof = BROTLI_FALSE;
+  size_t mapped_size = 0;
+  /* Qualities 0 and 1 cut blocks at the input chunks; a whole mapped file
+     makes quality 0 output about 5% bigger, so they keep streaming. */
+  const uint8_t* mapped = (context->quality > 1) ?
+      MapInputFile(context, &mapped_size) : NULL;
+  if (mapped) {
+    BROTLI_BOOL is_ok = CompressMappedFile(context, s, mapped, mapped_size);
+    UnmapInputFile(mapped, mapped_size);
+    return is_ok;
+  }
   InitializeBuffers(context);
   for (;;) {
     if (context->available_in == 0 && !is_eof) {
@@ -1068,137 +1449,1515 @@ static BROTLI_BOOL CompressFile(Context* context, BrotliEncoderState* s) {
   }
 }
 
-static BROTLI_BOOL CompressFiles(Context* context) {
-  while (NextFile(context)) {
-    BROTLI_BOOL is_ok = BROTLI_TRUE;
-    BrotliEncoderState* s = BrotliEncoderCreateInstance(NULL, NULL, NULL);
-    if (!s) {
-      fprintf(stderr, "out of memory\n");
-      return BROTLI_FALSE;
+/* Window size for the current input file, when it is not set by user. */
+static uint32_t ChooseLgwin(const Context* context) {
+  uint32_t lgwin = DEFAULT_LGWIN;
+  /* Use file size to limit lgwin. */
+  if (context->input_file_length >= 0) {
+    lgwin = BROTLI_MIN_WINDOW_BITS;
+    while (BROTLI_MAX_BACKWARD_LIMIT(lgwin) <
+           (uint64_t)context->input_file_length) {
+      lgwin++;
+      if (lgwin == BROTLI_MAX_WINDOW_BITS) break;
     }
-    BrotliEncoderSetParameter(s,
-        BROTLI_PARAM_QUALITY, (uint32_t)context->quality);
-    if (context->lgwin > 0) {
-      /* Specified by user. */
-      /* Do not enable "large-window" extension, if not required. */
-      if (context->lgwin > BROTLI_MAX_WINDOW_BITS) {
-        BrotliEncoderSetParameter(s, BROTLI_PARAM_LARGE_WINDOW, 1u);
-      }
-      BrotliEncoderSetParameter(s,
-          BROTLI_PARAM_LGWIN, (uint32_t)context->lgwin);
-    } else {
-      /* 0, or not specified by user; could be chosen by compressor. */
-      uint32_t lgwin = DEFAULT_LGWIN;
-      /* Use file size to limit lgwin. */
-      if (context->input_file_length >= 0) {
-        lgwin = BROTLI_MIN_WINDOW_BITS;
-        while (BROTLI_MAX_BACKWARD_LIMIT(lgwin) <
-               (uint64_t)context->input_file_length) {
-          lgwin++;
-          if (lgwin == BROTLI_MAX_WINDOW_BITS) break;
-        }
-      }
-      BrotliEncoderSetParameter(s, BROTLI_PARAM_LGWIN, lgwin);
+  }
+  return lgwin;
+}
+
+/* Applies compression parameters given by user, or chosen for the current
+   input file. */
+static void SetEncoderParameters(Context* context, BrotliEncoderState* s) {
+  BrotliEncoderSetParameter(s,
+      BROTLI_PARAM_QUALITY, (uint32_t)context->quality);
+  if (context->lgwin > 0) {
+    /* Specified by user. */
+    /* Do not enable "large-window" extension, if not required. */
+    if (context->lgwin > BROTLI_MAX_WINDOW_BITS) {
+      BrotliEncoderSetParameter(s, BROTLI_PARAM_LARGE_WINDOW, 1u);
     }
+    BrotliEncoderSetParameter(s,
+        BROTLI_PARAM_LGWIN, (uint32_t)context->lgwin);
+  } else {
+    /* 0, or not specified by user; could be chosen by compressor. */
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_LGWIN, ChooseLgwin(context));
+  }
+  {
+    /* Unknown size is set too: a reused encoder keeps the previous hint. */
+    uint32_t size_hint = 0;
     if (context->input_file_length > 0) {
-      uint32_t size_hint = context->input_file_length < (1 << 30) ?
+      size_hint = context->input_file_length < (1 << 30) ?
           (uint32_t)context->input_file_length : (1u << 30);
-      BrotliEncoderSetParameter(s, BROTLI_PARAM_SIZE_HINT, size_hint);
     }
-    if (context->dictionary) {
-      BrotliEncoderAttachPreparedDictionary(s, context->prepared_dictionary);
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_SIZE_HINT, size_hint);
+  }
+  if (context->long_distance) {
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_LONG_DISTANCE_MATCHING, 1u);
+  }
+  if (context->shortest_path) {
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_SHORTEST_PATH, 1u);
+  }
+  if (context->chunk_bits != 0) {
+    BrotliEncoderSetParameter(s,
+        BROTLI_PARAM_CHUNK_BITS, (uint32_t)context->chunk_bits);
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_INDEPENDENT_CHUNKS, 1u);
+  }
+}
+
+#if defined(_WIN32)
+typedef HANDLE WorkerThread;
+typedef unsigned (__stdcall* WorkerRoutine)(void*);
+#define WORKER_RESULT unsigned __stdcall
+#define WORKER_RESULT_VALUE 0
+#else
+typedef pthread_t WorkerThread;
+typedef void* (*WorkerRoutine)(void*);
+#define WORKER_RESULT void*
+#define WORKER_RESULT_VALUE NULL
+#endif
+
+/* Part of input compressed by a separate encoder instance. */
+typedef struct {
+  Context* context;
+  const uint8_t* input;
+  size_t input_size;
+  /* Number of input bytes before this chunk. */
+  size_t stream_offset;
+  BROTLI_BOOL is_last;
+  uint8_t* output;
+  size_t output_size;
+  BROTLI_BOOL is_ok;
+} CompressionChunk;
+
+/* Smallest chunk; smaller chunks lose too much of compression ratio. */
+static const size_t kMinChunkSize = 1 << 22;
+
+/* Encoders of all chunks use the same parameters, so their outputs could be
+   concatenated: every chunk but the last is flushed, and all but the first
+   are encoded with BROTLI_PARAM_STREAM_OFFSET, which omits stream header. */
+static WORKER_RESULT CompressChunk(void* arg) {
+  CompressionChunk* chunk = (CompressionChunk*)arg;
+  size_t available_in = chunk->input_size;
+  const uint8_t* next_in = chunk->input;
+  size_t available_out = 0;
+  BrotliEncoderOperation op = chunk->is_last ?
+      BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+  BrotliEncoderState* s = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+  chunk->is_ok = BROTLI_FALSE;
+  chunk->output = NULL;
+  chunk->output_size = 0;
+  if (!s) return WORKER_RESULT_VALUE;
+  SetEncoderParameters(chunk->context, s);
+  if (chunk->stream_offset != 0) {
+    size_t offset = chunk->stream_offset < (1u << 30) ?
+        chunk->stream_offset : (1u << 30);
+    BrotliEncoderSetParameter(s, BROTLI_PARAM_STREAM_OFFSET, (uint32_t)offset);
+  }
+  for (;;) {
+    if (!BrotliEncoderCompressStream(s, op, &available_in, &next_in,
+        &available_out, NULL, NULL)) {
+      break;
     }
-    is_ok = OpenFiles(context);
-    if (is_ok && !context->current_output_path &&
-        !context->force_overwrite && isatty(STDOUT_FILENO)) {
-      fprintf(stderr, "Use -h help. Use -f to force output to a terminal.\n");
-      is_ok = BROTLI_FALSE;
+    if (BrotliEncoderHasMoreOutput(s)) {
+      size_t size = 0;
+      const uint8_t* data = BrotliEncoderTakeOutput(s, &size);
+      uint8_t* output = (uint8_t*)realloc(chunk->output,
+                                          chunk->output_size + size);
+      if (!output) break;
+      memcpy(output + chunk->output_size, data, size);
+      chunk->output = output;
+      chunk->output_size += size;
+      continue;
+    }
+    if (available_in == 0 &&
+        (!chunk->is_last || BrotliEncoderIsFinished(s))) {
+      chunk->is_ok = BROTLI_TRUE;
+      break;
     }
-    if (is_ok) is_ok = CompressFile(context, s);
-    BrotliEncoderDestroyInstance(s);
-    if (!CloseFiles(context, is_ok)) is_ok = BROTLI_FALSE;
-    if (!is_ok) return BROTLI_FALSE;
   }
-  return BROTLI_TRUE;
+  BrotliEncoderDestroyInstance(s);
+  return WORKER_RESULT_VALUE;
 }
 
-int main(int argc, char** argv) {
-  Command command;
-  Context context;
+static BROTLI_BOOL StartWorker(
+    WorkerThread* thread, WorkerRoutine routine, void* arg) {
+#if defined(_WIN32)
+  *thread = (HANDLE)_beginthreadex(NULL, 0, routine, arg, 0, NULL);
+  return TO_BROTLI_BOOL(*thread != 0);
+#else
+  return TO_BROTLI_BOOL(pthread_create(thread, NULL, routine, arg) == 0);
+#endif
+}
+
+static void JoinWorker(WorkerThread thread) {
+#if defined(_WIN32)
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+/* Reads input by rounds of |threads| chunks, compresses chunks of a round in
+   parallel and writes results in order. */
+static BROTLI_BOOL CompressFileParallel(Context* context) {
   BROTLI_BOOL is_ok = BROTLI_TRUE;
+  BROTLI_BOOL is_eof = BROTLI_FALSE;
+  int threads = context->threads;
+  size_t chunk_size = kMinChunkSize;
+  size_t round_size;
+  size_t stream_offset = 0;
+  uint8_t* input;
+  CompressionChunk chunks[MAX_THREADS];
+  WorkerThread workers[MAX_THREADS];
   int i;
 
-  context.quality = 11;
-  context.lgwin = -1;
-  context.verbosity = 0;
-  context.force_overwrite = BROTLI_FALSE;
-  context.junk_source = BROTLI_FALSE;
-  context.copy_stat = BROTLI_TRUE;
-  context.test_integrity = BROTLI_FALSE;
-  context.write_to_stdout = BROTLI_FALSE;
-  context.decompress = BROTLI_FALSE;
-  context.large_window = BROTLI_FALSE;
-  context.output_path = NULL;
-  context.dictionary_path = NULL;
-  context.suffix = DEFAULT_SUFFIX;
-  for (i = 0; i < MAX_OPTIONS; ++i) context.not_input_indices[i] = 0;
-  context.longest_path_len = 1;
-  context.input_count = 0;
-
-  context.argc = argc;
-  context.argv = argv;
-  context.dictionary = NULL;
-  context.dictionary_size = 0;
-  context.prepared_dictionary = NULL;
-  context.modified_path = NULL;
-  context.iterator = 0;
-  context.ignore = 0;
-  context.iterator_error = BROTLI_FALSE;
-  context.buffer = NULL;
-  context.current_input_path = NULL;
-  context.current_output_path = NULL;
-  context.fin = NULL;
-  context.fout = NULL;
+  InitializeBuffers(context);
+  if (context->lgwin > 0 && context->lgwin <= 30 &&
+      ((size_t)1 << context->lgwin) > chunk_size) {
+    chunk_size = (size_t)1 << context->lgwin;
+  }
+  round_size = chunk_size * (size_t)threads;
+  input = (uint8_t*)malloc(round_size);
+  if (!input) {
+    fprintf(stderr, "out of memory\n");
+    return BROTLI_FALSE;
+  }
 
-  command = ParseParams(&context);
+  while (is_ok && !is_eof) {
+    size_t read_size = fread(input, 1, round_size, context->fin);
+    int num_chunks = 0;
+    int num_started = 0;
+    if (ferror(context->fin)) {
+      fprintf(stderr, "failed to read input [%s]: %s\n",
+              PrintablePath(context->current_input_path), strerror(errno));
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+    context->total_in += read_size;
+    is_eof = TO_BROTLI_BOOL(read_size < round_size || !HasMoreInput(context));
+    if (!is_eof) {
+      /* Exactly at the end of file? Then the last, empty, chunk follows. */
+      int c = fgetc(context->fin);
+      if (c == EOF) {
+        is_eof = BROTLI_TRUE;
+      } else {
+        ungetc(c, context->fin);
+      }
+    }
 
-  if (command == COMMAND_COMPRESS || command == COMMAND_DECOMPRESS ||
-      command == COMMAND_TEST_INTEGRITY) {
-    if (!ReadDictionary(&context, command)) is_ok = BROTLI_FALSE;
-    if (is_ok) {
-      size_t modified_path_len =
-          context.longest_path_len + strlen(context.suffix) + 1;
-      context.modified_path = (char*)malloc(modified_path_len);
-      context.buffer = (uint8_t*)malloc(kFileBufferSize * 2);
-      if (!context.modified_path || !context.buffer) {
-        fprintf(stderr, "out of memory\n");
+    do {
+      size_t offset = (size_t)num_chunks * chunk_size;
+      CompressionChunk* chunk = &chunks[num_chunks];
+      chunk->context = context;
+      chunk->input = input + offset;
+      chunk->input_size = BROTLI_MIN(size_t, read_size - offset, chunk_size);
+      chunk->stream_offset = stream_offset + offset;
+      chunk->is_last = TO_BROTLI_BOOL(
+          is_eof && offset + chunk->input_size == read_size);
+      chunk->output = NULL;
+      chunk->is_ok = BROTLI_FALSE;
+      num_chunks++;
+    } while ((size_t)num_chunks * chunk_size < read_size);
+    stream_offset += read_size;
+
+    for (i = 0; i < num_chunks; ++i) {
+      if (!StartWorker(&workers[i], CompressChunk, &chunks[i])) break;
+      num_started++;
+    }
+    /* Could not start threads; compress the rest on this thread. */
+    for (i = num_started; i < num_chunks; ++i) CompressChunk(&chunks[i]);
+    for (i = 0; i < num_started; ++i) JoinWorker(workers[i]);
+
+    for (i = 0; i < num_chunks; ++i) {
+      CompressionChunk* chunk = &chunks[i];
+      if (is_ok && !chunk->is_ok) {
+        fprintf(stderr, "failed to compress data [%s]\n",
+                PrintablePath(context->current_input_path));
         is_ok = BROTLI_FALSE;
-      } else {
-        context.input = context.buffer;
-        context.output = context.buffer + kFileBufferSize;
       }
+      if (is_ok && chunk->output_size != 0) {
+        context->total_out += chunk->output_size;
+        fwrite(chunk->output, 1, chunk->output_size, context->fout);
+        if (ferror(context->fout)) {
+          fprintf(stderr, "failed to write output [%s]: %s\n",
+                  PrintablePath(context->current_output_path),
+                  strerror(errno));
+          is_ok = BROTLI_FALSE;
+        }
+      }
+      free(chunk->output);
     }
   }
+  free(input);
 
-  if (!is_ok) command = COMMAND_NOOP;
-
-  switch (command) {
-    case COMMAND_NOOP:
-      break;
+  if (is_ok && context->verbosity > 0) {
+    context->end_time = clock();
+    fprintf(stderr, "Compressed ");
+    PrintFileProcessingProgress(context);
+    fprintf(stderr, "\n");
+  }
+  return is_ok;
+}
 
-    case COMMAND_VERSION:
-      PrintVersion();
-      break;
+/* Checkpoint file is "BrCp" magic followed by little-endian 64-bit input and
+   output offsets, 32-bit quality, lgwin and window size, and the window: the
+   input bytes just before the input offset. Output up to the output offset
+   is a flushed part of the stream that encodes the input up to the input
+   offset; the rest is compressed by an encoder primed with the window. */
+#define CHECKPOINT_HEADER_SIZE 32
 
-    case COMMAND_COMPRESS:
-      is_ok = CompressFiles(&context);
-      break;
+typedef struct {
+  uint64_t input_offset;
+  uint64_t output_offset;
+  int quality;
+  int lgwin;
+  size_t window_size;
+  uint8_t* window;
+} Checkpoint;
+
+static void StoreLE(uint8_t* dst, uint64_t value, int size) {
+  int i;
+  for (i = 0; i < size; ++i) dst[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t LoadLE(const uint8_t* src, int size) {
+  uint64_t value = 0;
+  int i;
+  for (i = size - 1; i >= 0; --i) value = (value << 8) | src[i];
+  return value;
+}
+
+static BROTLI_BOOL RenameFile(const char* from, const char* to) {
+#if defined(_WIN32)
+  return TO_BROTLI_BOOL(MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING));
+#else
+  return TO_BROTLI_BOOL(rename(from, to) == 0);
+#endif
+}
+
+/* Sets |*found| to false, if there is no checkpoint file. */
+static BROTLI_BOOL ReadCheckpoint(Context* context, Checkpoint* checkpoint,
+                                  BROTLI_BOOL* found) {
+  uint8_t header[CHECKPOINT_HEADER_SIZE];
+  FILE* f = fopen(context->checkpoint_path, "rb");
+  BROTLI_BOOL is_ok;
+  *found = TO_BROTLI_BOOL(f != NULL);
+  memset(checkpoint, 0, sizeof(*checkpoint));
+  if (!f) {
+    if (errno == ENOENT) return BROTLI_TRUE;
+    fprintf(stderr, "failed to open checkpoint file [%s]: %s\n",
+            PrintablePath(context->checkpoint_path), strerror(errno));
+    return BROTLI_FALSE;
+  }
+  is_ok = TO_BROTLI_BOOL(
+      fread(header, 1, CHECKPOINT_HEADER_SIZE, f) == CHECKPOINT_HEADER_SIZE &&
+      memcmp(header, "BrCp", 4) == 0);
+  if (is_ok) {
+    checkpoint->input_offset = LoadLE(header + 4, 8);
+    checkpoint->output_offset = LoadLE(header + 12, 8);
+    checkpoint->quality = (int)LoadLE(header + 20, 4);
+    checkpoint->lgwin = (int)LoadLE(header + 24, 4);
+    checkpoint->window_size = (size_t)LoadLE(header + 28, 4);
+    is_ok = TO_BROTLI_BOOL(
+        checkpoint->quality >= BROTLI_MIN_QUALITY &&
+        checkpoint->quality <= BROTLI_MAX_QUALITY &&
+        checkpoint->lgwin >= BROTLI_MIN_WINDOW_BITS &&
+        checkpoint->lgwin <= BROTLI_LARGE_MAX_WINDOW_BITS &&
+        checkpoint->input_offset != 0 &&
+        checkpoint->window_size <= checkpoint->input_offset &&
+        checkpoint->window_size <=
+            BROTLI_MAX_BACKWARD_LIMIT(checkpoint->lgwin));
+  }
+  if (is_ok && checkpoint->window_size != 0) {
+    checkpoint->window = (uint8_t*)malloc(checkpoint->window_size);
+    is_ok = TO_BROTLI_BOOL(checkpoint->window && fread(checkpoint->window, 1,
+        checkpoint->window_size, f) == checkpoint->window_size);
+  }
+  fclose(f);
+  if (!is_ok) {
+    fprintf(stderr, "invalid checkpoint file [%s]\n",
+            PrintablePath(context->checkpoint_path));
+    free(checkpoint->window);
+    checkpoint->window = NULL;
+  }
+  return is_ok;
+}
+
+/* Makes the output durable, then atomically replaces the checkpoint file.
+   Output is flushed; window is read back from the input. */
+static BROTLI_BOOL SaveCheckpoint(Context* context, uint8_t* window,
+                                  size_t max_window_size) {
+  uint8_t header[CHECKPOINT_HEADER_SIZE];
+  uint64_t input_offset = context->total_in;
+  size_t window_size = input_offset < max_window_size ?
+      (size_t)input_offset : max_window_size;
+  size_t path_size = strlen(context->checkpoint_path) + 5;
+  char* temp_path = (char*)malloc(path_size);
+  FILE* f = NULL;
+  BROTLI_BOOL is_ok = BROTLI_TRUE;
+
+  if (!temp_path) {
+    fprintf(stderr, "out of memory\n");
+    return BROTLI_FALSE;
+  }
+  snprintf(temp_path, path_size, "%s.tmp", context->checkpoint_path);
+  if (!ProvideOutput(context)) is_ok = BROTLI_FALSE;
+  if (is_ok && (fflush(context->fout) != 0 ||
+      fsync(fileno(context->fout)) != 0)) {
+    fprintf(stderr, "failed to write output [%s]: %s\n",
+            PrintablePath(context->current_output_path), strerror(errno));
+    is_ok = BROTLI_FALSE;
+  }
+  if (is_ok && (fseek(context->fin, input_offset - window_size, SEEK_SET) != 0 ||
+      fread(window, 1, window_size, context->fin) != window_size)) {
+    fprintf(stderr, "failed to read input [%s]: %s\n",
+            PrintablePath(context->current_input_path), strerror(errno));
+    is_ok = BROTLI_FALSE;
+  }
+  if (is_ok) {
+    memcpy(header, "BrCp", 4);
+    StoreLE(header + 4, input_offset, 8);
+    StoreLE(header + 12, context->total_out, 8);
+    StoreLE(header + 20, (uint64_t)context->quality, 4);
+    StoreLE(header + 24, (uint64_t)context->lgwin, 4);
+    StoreLE(header + 28, window_size, 4);
+    f = fopen(temp_path, "wb");
+    is_ok = TO_BROTLI_BOOL(f &&
+        fwrite(header, 1, CHECKPOINT_HEADER_SIZE, f) ==
+            CHECKPOINT_HEADER_SIZE &&
+        fwrite(window, 1, window_size, f) == window_size &&
+        fflush(f) == 0 && fsync(fileno(f)) == 0);
+    if (f && fclose(f) != 0) is_ok = BROTLI_FALSE;
+    if (is_ok) is_ok = RenameFile(temp_path, context->checkpoint_path);
+    if (!is_ok) {
+      fprintf(stderr, "failed to write checkpoint [%s]: %s\n",
+              PrintablePath(context->checkpoint_path), strerror(errno));
+      unlink(temp_path);
+    }
+  }
+  free(temp_path);
+  if (is_ok) context->checkpoint_saved = BROTLI_TRUE;
+  return is_ok;
+}
+
+/* Output of a resumed run is opened without truncation; only the part not
+   covered by the checkpoint is dropped. */
+static BROTLI_BOOL OpenResumedFiles(Context* context,
+                                    const Checkpoint* checkpoint) {
+  int64_t output_length = FileSize(context->current_output_path);
+  int fd;
+  if (!OpenInputFile(context->current_input_path, &context->fin)) {
+    return BROTLI_FALSE;
+  }
+  if (context->input_file_length < (int64_t)checkpoint->input_offset ||
+      output_length < (int64_t)checkpoint->output_offset) {
+    fprintf(stderr, "checkpoint [%s] does not match input or output\n",
+            PrintablePath(context->checkpoint_path));
+    return BROTLI_FALSE;
+  }
+  if (fseek(context->fin, checkpoint->input_offset, SEEK_SET) != 0) {
+    fprintf(stderr, "failed to read input [%s]: %s\n",
+            PrintablePath(context->current_input_path), strerror(errno));
+    return BROTLI_FALSE;
+  }
+  fd = open(context->current_output_path, O_WRONLY, S_IRUSR | S_IWUSR);
+  if (fd >= 0) context->fout = fdopen(fd, "wb");
+  if (!context->fout ||
+      ftruncate(fd, checkpoint->output_offset) != 0 ||
+      fseek(context->fout, checkpoint->output_offset, SEEK_SET) != 0) {
+    fprintf(stderr, "failed to open output file [%s]: %s\n",
+            PrintablePath(context->current_output_path), strerror(errno));
+    if (fd >= 0 && !context->fout) close(fd);
+    return BROTLI_FALSE;
+  }
+  return BROTLI_TRUE;
+}
+
+/* Flushes the stream and saves a checkpoint once every interval of input;
+   resumes from the checkpoint, if there is one. Parameters are taken from
+   the checkpoint, so that the resumed part obeys the same stream header. */
+static BROTLI_BOOL CompressCheckpointedFile(Context* context,
+                                            BrotliEncoderState* s) {
+  Checkpoint checkpoint;
+  BROTLI_BOOL found;
+  BROTLI_BOOL is_eof = BROTLI_FALSE;
+  BROTLI_BOOL is_ok;
+  uint64_t next_checkpoint;
+  uint8_t* window = NULL;
+  size_t max_window_size;
+
+  if (!ReadCheckpoint(context, &checkpoint, &found)) return BROTLI_FALSE;
+  if (found) {
+    context->quality = checkpoint.quality;
+    context->lgwin = checkpoint.lgwin;
+  } else if (context->lgwin <= 0) {
+    context->lgwin = (int)ChooseLgwin(context);
+  }
+  SetEncoderParameters(context, s);
+  if (context->dictionary) {
+    BrotliEncoderAttachPreparedDictionary(s, context->prepared_dictionary);
+  }
+  if (found) {
+    /* Output is kept whatever happens; checkpoint refers to it. */
+    context->checkpoint_saved = BROTLI_TRUE;
+    is_ok = OpenResumedFiles(context, &checkpoint);
+    if (is_ok) {
+      uint64_t offset = checkpoint.input_offset;
+      BrotliEncoderSetParameter(s, BROTLI_PARAM_STREAM_OFFSET,
+          offset < (1u << 30) ? (uint32_t)offset : (1u << 30));
+      if (!BrotliEncoderPrimeWindow(s, checkpoint.window_size,
+          checkpoint.window)) {
+        fprintf(stderr, "failed to resume from checkpoint [%s]\n",
+                PrintablePath(context->checkpoint_path));
+        is_ok = BROTLI_FALSE;
+      }
+    }
+    free(checkpoint.window);
+    if (is_ok && context->verbosity > 0) {
+      fprintf(stderr, "Resuming [%s] at ",
+              PrintablePath(context->current_input_path));
+      PrintBytes((size_t)checkpoint.input_offset);
+      fprintf(stderr, "\n");
+    }
+  } else {
+    is_ok = OpenFiles(context);
+  }
+
+  max_window_size = BROTLI_MAX_BACKWARD_LIMIT(context->lgwin);
+  if (context->input_file_length >= 0 &&
+      (uint64_t)context->input_file_length < max_window_size) {
+    max_window_size = (size_t)context->input_file_length;
+  }
+  if (is_ok) {
+    window = (uint8_t*)malloc(max_window_size ? max_window_size : 1);
+    if (!window) {
+      fprintf(stderr, "out of memory\n");
+      is_ok = BROTLI_FALSE;
+    }
+  }
+
+  InitializeBuffers(context);
+  if (found) {
+    context->total_in = (size_t)checkpoint.input_offset;
+    context->total_out = (size_t)checkpoint.output_offset;
+  }
+  next_checkpoint = context->total_in + context->checkpoint_interval;
+  while (is_ok) {
+    BrotliEncoderOperation op = BROTLI_OPERATION_PROCESS;
+    /* Input can not be added while the output of a flush is pending. */
+    if (context->available_in == 0 && !is_eof &&
+        !BrotliEncoderHasMoreOutput(s)) {
+      if (!ProvideInput(context)) {
+        is_ok = BROTLI_FALSE;
+        break;
+      }
+      is_eof = !HasMoreInput(context);
+    }
+    if (is_eof) {
+      op = BROTLI_OPERATION_FINISH;
+    } else if (context->total_in >= next_checkpoint) {
+      op = BROTLI_OPERATION_FLUSH;
+    }
+
+    if (!BrotliEncoderCompressStream(s, op,
+        &context->available_in, &context->next_in,
+        &context->available_out, &context->next_out, NULL)) {
+      fprintf(stderr, "failed to compress data [%s]\n",
+              PrintablePath(context->current_input_path));
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+
+    if (context->available_out == 0 && !ProvideOutput(context)) {
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+
+    if (op == BROTLI_OPERATION_FLUSH && context->available_in == 0 &&
+        !BrotliEncoderHasMoreOutput(s)) {
+      if (!SaveCheckpoint(context, window, max_window_size)) {
+        is_ok = BROTLI_FALSE;
+        break;
+      }
+      next_checkpoint = context->total_in + context->checkpoint_interval;
+    }
+
+    if (BrotliEncoderIsFinished(s)) {
+      if (!FlushOutput(context)) {
+        is_ok = BROTLI_FALSE;
+        break;
+      }
+      if (context->verbosity > 0) {
+        context->end_time = clock();
+        fprintf(stderr, "Compressed ");
+        PrintFileProcessingProgress(context);
+        fprintf(stderr, "\n");
+      }
+      break;
+    }
+  }
+  free(window);
+
+  if (!CloseFiles(context, is_ok)) is_ok = BROTLI_FALSE;
+  if (is_ok) {
+    unlink(context->checkpoint_path);
+  } else if (context->checkpoint_saved) {
+    fprintf(stderr, "rerun the same command to resume from [%s]\n",
+            PrintablePath(context->checkpoint_path));
+  }
+  context->checkpoint_saved = BROTLI_FALSE;
+  return is_ok;
+}
+
+/* Compresses the current file with |s|, a fresh or reset encoder. */
+static BROTLI_BOOL CompressOneFile(Context* context, BrotliEncoderState* s) {
+  BROTLI_BOOL is_ok = BROTLI_TRUE;
+  /* Chunks can not refer a dictionary placed before the whole stream;
+     content-defined chunks are cut by a single encoder. */
+  BROTLI_BOOL parallel = TO_BROTLI_BOOL(context->threads > 1 &&
+      !context->dictionary && context->chunk_bits == 0);
+  if (context->checkpoint_path) return CompressCheckpointedFile(context, s);
+  SetEncoderParameters(context, s);
+  if (context->dictionary) {
+    BrotliEncoderAttachPreparedDictionary(s, context->prepared_dictionary);
+  }
+  is_ok = OpenFiles(context);
+  if (is_ok && !context->current_output_path &&
+      !context->force_overwrite && isatty(STDOUT_FILENO)) {
+    fprintf(stderr, "Use -h help. Use -f to force output to a terminal.\n");
+    is_ok = BROTLI_FALSE;
+  }
+  if (is_ok) {
+    is_ok = parallel ? CompressFileParallel(context) : CompressFile(context, s);
+  }
+  if (!CloseFiles(context, is_ok)) is_ok = BROTLI_FALSE;
+  return is_ok;
+}
+
+/* Returns encoder ready for the next file: |s| reset, if it is reusable, or
+   a new one. Reset keeps ring buffer and other allocations of the previous
+   file. */
+static BrotliEncoderState* NextEncoderInstance(BrotliEncoderState* s) {
+  if (s && BrotliEncoderResetInstance(s)) return s;
+  if (s) BrotliEncoderDestroyInstance(s);
+  s = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+  if (!s) fprintf(stderr, "out of memory\n");
+  return s;
+}
+
+#if defined(_WIN32)
+typedef CRITICAL_SECTION WorkerMutex;
+#else
+typedef pthread_mutex_t WorkerMutex;
+#endif
+
+static BROTLI_BOOL InitMutex(WorkerMutex* mutex) {
+#if defined(_WIN32)
+  InitializeCriticalSection(mutex);
+  return BROTLI_TRUE;
+#else
+  return TO_BROTLI_BOOL(pthread_mutex_init(mutex, NULL) == 0);
+#endif
+}
+
+static void DestroyMutex(WorkerMutex* mutex) {
+#if defined(_WIN32)
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void LockMutex(WorkerMutex* mutex) {
+#if defined(_WIN32)
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+static void UnlockMutex(WorkerMutex* mutex) {
+#if defined(_WIN32)
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+/* Verbose output of a file compressed by a worker; kept until all the files
+   before it are reported. */
+typedef struct {
+  const char* input_path;
+  size_t total_in;
+  size_t total_out;
+  clock_t elapsed;
+  BROTLI_BOOL is_ok;
+  BROTLI_BOOL is_ready;
+} FileReport;
+
+/* Input files shared by the workers. Every worker takes the next file as soon
+   as it is done with the previous one, so a big file does not hold others
+   up. */
+typedef struct {
+  /* Iterates over the input files; guarded by |mutex|, as is the rest. */
+  Context* context;
+  WorkerMutex mutex;
+  BROTLI_BOOL has_more;
+  BROTLI_BOOL is_ok;
+  /* One per input file, in verbose mode only. */
+  FileReport* reports;
+  size_t num_taken;
+  size_t num_reported;
+} FilePool;
+
+/* Owns copies of the per-file parts of the context; the rest is shared
+   read-only. */
+typedef struct {
+  FilePool* pool;
+  Context context;
+  uint8_t* buffer;
+  char* modified_path;
+} FileWorker;
+
+/* Called with the pool locked, right after NextFile. */
+static void TakeFile(FileWorker* worker, Context* context) {
+  worker->context = *context;
+  worker->context.threads = 1;
+  /* Progress is reported by the pool, in order. */
+  worker->context.verbosity = 0;
+  worker->context.buffer = worker->buffer;
+  worker->context.input = worker->buffer;
+  worker->context.output = worker->buffer + kFileBufferSize;
+  worker->context.modified_path = worker->modified_path;
+  if (context->current_output_path == context->modified_path) {
+    strcpy(worker->modified_path, context->modified_path);
+    worker->context.current_output_path = worker->modified_path;
+  }
+}
+
+/* Called with the pool locked; prints every report that is not preceded by
+   a pending one. */
+static void ReportFiles(FilePool* pool) {
+  while (pool->num_reported < pool->num_taken &&
+         pool->reports[pool->num_reported].is_ready) {
+    FileReport* report = &pool->reports[pool->num_reported++];
+    if (report->is_ok) {
+      fprintf(stderr, "Compressed ");
+      PrintProgress(report->input_path, report->total_in, report->total_out,
+                    report->elapsed);
+      fprintf(stderr, "\n");
+    }
+  }
+}
+
+static WORKER_RESULT CompressFilesWorker(void* arg) {
+  FileWorker* worker = (FileWorker*)arg;
+  FilePool* pool = worker->pool;
+  BrotliEncoderState* s = NULL;
+  for (;;) {
+    size_t index;
+    BROTLI_BOOL is_console;
+    BROTLI_BOOL is_ok = BROTLI_FALSE;
+    clock_t start_time;
+
+    LockMutex(&pool->mutex);
+    if (!pool->is_ok || !pool->has_more || !NextFile(pool->context)) {
+      pool->has_more = BROTLI_FALSE;
+      UnlockMutex(&pool->mutex);
+      break;
+    }
+    index = pool->num_taken++;
+    TakeFile(worker, pool->context);
+    /* Console input is compressed to console; do not let workers race for
+       it: the pool stays locked. */
+    is_console = !worker->context.current_input_path;
+    if (!is_console) UnlockMutex(&pool->mutex);
+
+    start_time = clock();
+    s = NextEncoderInstance(s);
+    if (s) is_ok = CompressOneFile(&worker->context, s);
+
+    if (!is_console) LockMutex(&pool->mutex);
+    if (!is_ok) pool->is_ok = BROTLI_FALSE;
+    if (pool->reports) {
+      FileReport* report = &pool->reports[index];
+      report->input_path = worker->context.current_input_path;
+      report->total_in = worker->context.total_in;
+      report->total_out = worker->context.total_out;
+      report->elapsed = clock() - start_time;
+      report->is_ok = is_ok;
+      report->is_ready = BROTLI_TRUE;
+      ReportFiles(pool);
+    }
+    UnlockMutex(&pool->mutex);
+  }
+  if (s) BrotliEncoderDestroyInstance(s);
+  return WORKER_RESULT_VALUE;
+}
+
+/* Compresses files on a pool of |threads| workers. Every file is compressed
+   with a single thread: it is the only way to speed up batches of small
+   files, e.g. static assets, at high qualities. */
+static BROTLI_BOOL CompressFilesParallel(Context* context) {
+  FileWorker workers[MAX_THREADS];
+  WorkerThread threads[MAX_THREADS];
+  FilePool pool;
+  size_t path_size = context->longest_path_len + strlen(context->suffix) + 1;
+  int num_workers = 0;
+  int num_started = 0;
+  int i;
+
+  pool.context = context;
+  pool.has_more = BROTLI_TRUE;
+  pool.is_ok = BROTLI_TRUE;
+  pool.reports = NULL;
+  pool.num_taken = 0;
+  pool.num_reported = 0;
+  if (context->verbosity > 0) {
+    pool.reports =
+        (FileReport*)calloc(context->input_count, sizeof(FileReport));
+    if (!pool.reports) {
+      fprintf(stderr, "out of memory\n");
+      return BROTLI_FALSE;
+    }
+  }
+  if (!InitMutex(&pool.mutex)) {
+    fprintf(stderr, "failed to create mutex\n");
+    free(pool.reports);
+    return BROTLI_FALSE;
+  }
+
+  for (i = 0; i < context->threads; ++i) {
+    FileWorker* worker = &workers[i];
+    worker->pool = &pool;
+    worker->buffer = (uint8_t*)malloc(kFileBufferSize * 2);
+    worker->modified_path = (char*)malloc(path_size);
+    if (!worker->buffer || !worker->modified_path) {
+      free(worker->buffer);
+      free(worker->modified_path);
+      break;
+    }
+    num_workers++;
+  }
+  if (num_workers == 0) {
+    fprintf(stderr, "out of memory\n");
+    pool.is_ok = BROTLI_FALSE;
+  }
+
+  /* The first worker runs on this thread; a failure to start more of them
+     only makes the pool smaller. */
+  for (i = 1; i < num_workers; ++i) {
+    if (!StartWorker(&threads[i], CompressFilesWorker, &workers[i])) break;
+    num_started++;
+  }
+  if (num_workers > 0) CompressFilesWorker(&workers[0]);
+  for (i = 1; i <= num_started; ++i) JoinWorker(threads[i]);
+
+  for (i = 0; i < num_workers; ++i) {
+    free(workers[i].buffer);
+    free(workers[i].modified_path);
+  }
+  DestroyMutex(&pool.mutex);
+  free(pool.reports);
+  return pool.is_ok;
+}
+
+static BROTLI_BOOL CompressFiles(Context* context) {
+  BrotliEncoderState* s = NULL;
+  BROTLI_BOOL is_ok = BROTLI_TRUE;
+  if (context->threads > 1 && context->input_count > 1 &&
+      !context->write_to_stdout) {
+    return CompressFilesParallel(context);
+  }
+  while (is_ok && NextFile(context)) {
+    s = NextEncoderInstance(s);
+    is_ok = s ? CompressOneFile(context, s) : BROTLI_FALSE;
+  }
+  if (s) BrotliEncoderDestroyInstance(s);
+  return is_ok;
+}
+
+/* Solid archive is a single stream of all input files, so that small similar
+   files share the window. It is followed by the index in a metadata block:
+   for every file its 64-bit size, 16-bit name length and name, then the
+   "BrSo" trailer with 32-bit file count and 64-bit size of the entries (all
+   little-endian). Files are stored in order, so offsets are implied by
+   sizes. Only the last (empty) meta-block byte follows the index, so it is
+   read without decoding; a regular decoder skips it and yields all files
+   concatenated. */
+#define SOLID_TRAILER_SIZE 16
+#define SOLID_ENTRY_HEADER_SIZE 10
+#define SOLID_LAST_BLOCK 0x03
+/* Limit of the metadata block. */
+#define MAX_SOLID_INDEX_SIZE (1u << 24)
+
+typedef struct {
+  uint64_t size;
+  const char* name;
+  BROTLI_BOOL selected;
+} SolidEntry;
+
+typedef struct {
+  SolidEntry* entries;
+  size_t num_entries;
+  char* names;
+  /* Extraction progress: the entry being decoded and its decoded part. */
+  size_t current;
+  uint64_t current_offset;
+} SolidArchive;
+
+static BROTLI_BOOL IsPathSeparator(char c) {
+  return TO_BROTLI_BOOL(c == '/' || c == '\\');
+}
+
+/* Extraction only writes below the current directory. */
+static BROTLI_BOOL IsSafeEntryName(const char* name) {
+  const char* component = name;
+  if (name[0] == 0 || IsPathSeparator(name[0]) || strchr(name, ':')) {
+    return BROTLI_FALSE;
+  }
+  for (;;) {
+    size_t len = 0;
+    while (component[len] != 0 && !IsPathSeparator(component[len])) len++;
+    if (len == 2 && component[0] == '.' && component[1] == '.') {
+      return BROTLI_FALSE;
+    }
+    if (component[len] == 0) return BROTLI_TRUE;
+    component += len + 1;
+  }
+}
+
+/* Runs one encoder step; output buffer is written out once it is full. */
+static BROTLI_BOOL SolidCompressStream(Context* context, BrotliEncoderState* s,
+                                       BrotliEncoderOperation op) {
+  if (!BrotliEncoderCompressStream(s, op,
+      &context->available_in, &context->next_in,
+      &context->available_out, &context->next_out, NULL)) {
+    fprintf(stderr, "failed to compress data [%s]\n",
+            PrintablePath(context->current_input_path));
+    return BROTLI_FALSE;
+  }
+  if (context->available_out == 0) return ProvideOutput(context);
+  return BROTLI_TRUE;
+}
+
+static BROTLI_BOOL AddToSolidArchive(Context* context, BrotliEncoderState* s,
+                                     SolidEntry* entry) {
+  BROTLI_BOOL is_ok = OpenInputFile(context->current_input_path,
+                                    &context->fin);
+  size_t start = context->total_in;
+  while (is_ok) {
+    if (context->available_in == 0) {
+      if (!HasMoreInput(context)) break;
+      is_ok = ProvideInput(context);
+      continue;
+    }
+    is_ok = SolidCompressStream(context, s, BROTLI_OPERATION_PROCESS);
+  }
+  entry->size = context->total_in - start;
+  if (context->fin) fclose(context->fin);
+  context->fin = NULL;
+  return is_ok;
+}
+
+static uint8_t* BuildSolidIndex(const SolidEntry* entries, size_t num_entries,
+                                size_t* index_size) {
+  uint8_t* index = (uint8_t*)malloc(*index_size);
+  size_t pos = 0;
+  size_t i;
+  if (!index) return NULL;
+  for (i = 0; i < num_entries; ++i) {
+    size_t name_len = strlen(entries[i].name);
+    StoreLE(index + pos, entries[i].size, 8);
+    StoreLE(index + pos + 8, name_len, 2);
+    memcpy(index + pos + SOLID_ENTRY_HEADER_SIZE, entries[i].name, name_len);
+    pos += SOLID_ENTRY_HEADER_SIZE + name_len;
+  }
+  memcpy(index + pos, "BrSo", 4);
+  StoreLE(index + pos + 4, num_entries, 4);
+  StoreLE(index + pos + 8, pos, 8);
+  return index;
+}
+
+static BROTLI_BOOL CompressSolidArchive(Context* context) {
+  BrotliEncoderState* s = NULL;
+  SolidEntry* entries;
+  size_t num_entries = 0;
+  uint8_t* index = NULL;
+  size_t index_size = SOLID_TRAILER_SIZE;
+  int64_t total_size = 0;
+  BROTLI_BOOL is_ok = BROTLI_TRUE;
+
+  entries = (SolidEntry*)malloc(context->input_count * sizeof(SolidEntry));
+  if (!entries) {
+    fprintf(stderr, "out of memory\n");
+    return BROTLI_FALSE;
+  }
+  /* Names and total size are known before the first byte is compressed. */
+  while (is_ok && NextFile(context)) {
+    const char* name = context->current_input_path;
+    if (!name) {
+      fprintf(stderr, "solid archive can not store standard input\n");
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+    while (IsPathSeparator(name[0])) name++;
+    if (!IsSafeEntryName(name) || strlen(name) > 0xFFFF) {
+      fprintf(stderr, "can not store [%s] in solid archive\n", name);
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+    entries[num_entries].name = name;
+    entries[num_entries].size = 0;
+    num_entries++;
+    index_size += SOLID_ENTRY_HEADER_SIZE + strlen(name);
+    if (total_size >= 0) {
+      total_size = (context->input_file_length >= 0) ?
+          total_size + context->input_file_length : -1;
+    }
+  }
+  if (context->iterator_error) is_ok = BROTLI_FALSE;
+  if (is_ok && index_size > MAX_SOLID_INDEX_SIZE) {
+    fprintf(stderr, "too many files for solid archive index\n");
+    is_ok = BROTLI_FALSE;
+  }
+  if (is_ok) {
+    s = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (!s) {
+      fprintf(stderr, "out of memory\n");
+      is_ok = BROTLI_FALSE;
+    }
+  }
+  if (is_ok) {
+    context->input_file_length = total_size;
+    SetEncoderParameters(context, s);
+    if (context->dictionary) {
+      BrotliEncoderAttachPreparedDictionary(s, context->prepared_dictionary);
+    }
+    context->current_output_path = context->output_path;
+    is_ok = OpenOutputFile(
+        context->output_path, &context->fout, context->force_overwrite);
+  }
+  if (is_ok && !context->output_path &&
+      !context->force_overwrite && isatty(STDOUT_FILENO)) {
+    fprintf(stderr, "Use -h help. Use -f to force output to a terminal.\n");
+    is_ok = BROTLI_FALSE;
+  }
+
+  if (is_ok) {
+    size_t i;
+    InitializeBuffers(context);
+    context->iterator = 0;
+    context->ignore = 0;
+    for (i = 0; is_ok && i < num_entries; ++i) {
+      NextFile(context);
+      is_ok = AddToSolidArchive(context, s, &entries[i]);
+    }
+  }
+  if (is_ok) {
+    index = BuildSolidIndex(entries, num_entries, &index_size);
+    if (!index) {
+      fprintf(stderr, "out of memory\n");
+      is_ok = BROTLI_FALSE;
+    }
+  }
+  if (is_ok) {
+    /* Metadata input MUST stay the same till it is consumed. */
+    context->current_input_path = context->output_path;
+    context->next_in = index;
+    context->available_in = index_size;
+    while (is_ok &&
+           (context->available_in != 0 || BrotliEncoderHasMoreOutput(s))) {
+      is_ok = SolidCompressStream(context, s, BROTLI_OPERATION_EMIT_METADATA);
+    }
+    while (is_ok && !BrotliEncoderIsFinished(s)) {
+      is_ok = SolidCompressStream(context, s, BROTLI_OPERATION_FINISH);
+    }
+    if (is_ok) is_ok = FlushOutput(context);
+  }
+  if (is_ok && context->verbosity > 0) {
+    context->end_time = clock();
+    fprintf(stderr, "Compressed %lu files to ", (unsigned long)num_entries);
+    PrintProgress(context->output_path, context->total_in,
+                  context->total_out, context->end_time - context->start_time);
+    fprintf(stderr, "\n");
+  }
+
+  if (context->fout) {
+    if (fclose(context->fout) != 0 && is_ok) {
+      fprintf(stderr, "fclose failed [%s]: %s\n",
+              PrintablePath(context->output_path), strerror(errno));
+      is_ok = BROTLI_FALSE;
+    }
+    context->fout = NULL;
+    if (!is_ok && context->output_path) unlink(context->output_path);
+  }
+  if (is_ok && context->junk_source) {
+    context->iterator = 0;
+    context->ignore = 0;
+    while (NextFile(context)) unlink(context->current_input_path);
+  }
+  if (s) BrotliEncoderDestroyInstance(s);
+  free(index);
+  free(entries);
+  return is_ok;
+}
+
+/* Reads the index from the tail of the archive; the archive is rewound. */
+static BROTLI_BOOL ReadSolidIndex(Context* context, SolidArchive* archive) {
+  uint8_t tail[SOLID_TRAILER_SIZE + 1];
+  uint8_t* index = NULL;
+  int64_t archive_size;
+  uint64_t index_size = 0;
+  size_t pos = 0;
+  char* name;
+  size_t i;
+  BROTLI_BOOL is_ok;
+
+  archive->entries = NULL;
+  archive->names = NULL;
+  archive->num_entries = 0;
+  archive_size = (fseek(context->fin, 0, SEEK_END) == 0) ?
+      ftell(context->fin) : -1;
+  is_ok = TO_BROTLI_BOOL(archive_size >= (int64_t)sizeof(tail) &&
+      fseek(context->fin, archive_size - (int64_t)sizeof(tail), SEEK_SET) == 0 &&
+      fread(tail, 1, sizeof(tail), context->fin) == sizeof(tail) &&
+      tail[SOLID_TRAILER_SIZE] == SOLID_LAST_BLOCK &&
+      memcmp(tail, "BrSo", 4) == 0);
+  if (is_ok) {
+    archive->num_entries = (size_t)LoadLE(tail + 4, 4);
+    index_size = LoadLE(tail + 8, 8);
+    is_ok = TO_BROTLI_BOOL(
+        index_size <= MAX_SOLID_INDEX_SIZE &&
+        index_size + sizeof(tail) <= (uint64_t)archive_size &&
+        archive->num_entries <= index_size / SOLID_ENTRY_HEADER_SIZE);
+  }
+  if (is_ok) {
+    index = (uint8_t*)malloc((size_t)index_size + 1);
+    archive->entries = (SolidEntry*)malloc(
+        (archive->num_entries + 1) * sizeof(SolidEntry));
+    /* Every name is shorter than its entry. */
+    archive->names = (char*)malloc((size_t)index_size + 1);
+    if (!index || !archive->entries || !archive->names) {
+      fprintf(stderr, "out of memory\n");
+      free(index);
+      return BROTLI_FALSE;
+    }
+    is_ok = TO_BROTLI_BOOL(
+        fseek(context->fin,
+              archive_size - (int64_t)(sizeof(tail) + index_size),
+              SEEK_SET) == 0 &&
+        fread(index, 1, (size_t)index_size, context->fin) == index_size);
+  }
+  name = archive->names;
+  for (i = 0; is_ok && i < archive->num_entries; ++i) {
+    size_t name_len;
+    if (index_size - pos < SOLID_ENTRY_HEADER_SIZE) {
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+    name_len = (size_t)LoadLE(index + pos + 8, 2);
+    if (index_size - pos - SOLID_ENTRY_HEADER_SIZE < name_len) {
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+    archive->entries[i].size = LoadLE(index + pos, 8);
+    archive->entries[i].name = name;
+    memcpy(name, index + pos + SOLID_ENTRY_HEADER_SIZE, name_len);
+    name[name_len] = 0;
+    is_ok = TO_BROTLI_BOOL(strlen(name) == name_len && IsSafeEntryName(name));
+    name += name_len + 1;
+    pos += SOLID_ENTRY_HEADER_SIZE + name_len;
+  }
+  free(index);
+  if (is_ok && pos != index_size) is_ok = BROTLI_FALSE;
+  if (is_ok && fseek(context->fin, 0, SEEK_SET) != 0) is_ok = BROTLI_FALSE;
+  if (!is_ok) {
+    fprintf(stderr, "no solid archive index in [%s]\n",
+            PrintablePath(context->current_input_path));
+  }
+  return is_ok;
+}
+
+/* Creates missing directories on the way to |path|. */
+static BROTLI_BOOL MakeParentDirectories(const char* path) {
+  char* dir = (char*)malloc(strlen(path) + 1);
+  size_t i;
+  if (!dir) {
+    fprintf(stderr, "out of memory\n");
+    return BROTLI_FALSE;
+  }
+  strcpy(dir, path);
+  for (i = 1; dir[i] != 0; ++i) {
+    if (!IsPathSeparator(dir[i])) continue;
+    dir[i] = 0;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+      fprintf(stderr, "failed to create directory [%s]: %s\n",
+              dir, strerror(errno));
+      free(dir);
+      return BROTLI_FALSE;
+    }
+    dir[i] = path[i];
+  }
+  free(dir);
+  return BROTLI_TRUE;
+}
+
+/* With -o or -c all the selected files go to the single output. */
+static BROTLI_BOOL HasSharedOutput(const Context* context) {
+  return TO_BROTLI_BOOL(context->output_path || context->write_to_stdout);
+}
+
+static BROTLI_BOOL CloseExtractedFile(Context* context, BROTLI_BOOL success) {
+  BROTLI_BOOL is_ok = success;
+  if (!context->fout) return is_ok;
+  if (fclose(context->fout) != 0 && is_ok) {
+    fprintf(stderr, "fclose failed [%s]: %s\n",
+            PrintablePath(context->current_output_path), strerror(errno));
+    is_ok = BROTLI_FALSE;
+  }
+  context->fout = NULL;
+  if (!is_ok && context->current_output_path) {
+    unlink(context->current_output_path);
+  }
+  return is_ok;
+}
+
+/* Hands decoded data to the entries it belongs to; entries are opened and
+   closed as the data reaches and passes them. */
+static BROTLI_BOOL WriteSolidOutput(Context* context, SolidArchive* archive,
+                                    const uint8_t* data, size_t size) {
+  while (archive->current < archive->num_entries) {
+    SolidEntry* entry = &archive->entries[archive->current];
+    uint64_t left = entry->size - archive->current_offset;
+    size_t chunk = (left < size) ? (size_t)left : size;
+    if (entry->selected && !context->fout) {
+      context->current_output_path = entry->name;
+      if (!MakeParentDirectories(entry->name) ||
+          !OpenOutputFile(entry->name, &context->fout,
+                          context->force_overwrite)) {
+        return BROTLI_FALSE;
+      }
+    }
+    if (entry->selected && !WriteData(context, data, chunk)) {
+      return BROTLI_FALSE;
+    }
+    data += chunk;
+    size -= chunk;
+    archive->current_offset += chunk;
+    if (archive->current_offset < entry->size) break;
+    if (entry->selected) {
+      if (context->verbosity > 0) {
+        fprintf(stderr, "Extracted [%s]: ", entry->name);
+        PrintBytes((size_t)entry->size);
+        fprintf(stderr, "\n");
+      }
+      if (!HasSharedOutput(context) &&
+          !CloseExtractedFile(context, BROTLI_TRUE)) {
+        return BROTLI_FALSE;
+      }
+    }
+    archive->current++;
+    archive->current_offset = 0;
+  }
+  return BROTLI_TRUE;
+}
+
+/* Decodes the archive only up to the end of the last selected file. */
+static BROTLI_BOOL ExtractSolidArchive(Context* context) {
+  SolidArchive archive;
+  BrotliDecoderState* s = NULL;
+  BrotliDecoderResult result;
+  size_t end = 0;
+  size_t i;
+  BROTLI_BOOL is_ok;
+
+  archive.entries = NULL;
+  archive.names = NULL;
+  archive.current = 0;
+  archive.current_offset = 0;
+  NextFile(context);
+  if (!context->current_input_path) {
+    fprintf(stderr, "solid archive can not be read from standard input\n");
+    return BROTLI_FALSE;
+  }
+  is_ok = OpenInputFile(context->current_input_path, &context->fin);
+  if (is_ok) is_ok = ReadSolidIndex(context, &archive);
+  for (i = 0; is_ok && i < archive.num_entries; ++i) {
+    archive.entries[i].selected = TO_BROTLI_BOOL(!context->extract_name ||
+        (end == 0 && strcmp(context->extract_name, archive.entries[i].name) == 0));
+    if (archive.entries[i].selected) end = i + 1;
+  }
+  if (is_ok && context->extract_name && end == 0) {
+    fprintf(stderr, "no [%s] in solid archive [%s]\n", context->extract_name,
+            PrintablePath(context->current_input_path));
+    is_ok = BROTLI_FALSE;
+  }
+  if (is_ok) {
+    s = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+    if (!s) {
+      fprintf(stderr, "out of memory\n");
+      is_ok = BROTLI_FALSE;
+    }
+  }
+  if (is_ok) {
+    BrotliDecoderSetParameter(s, BROTLI_DECODER_PARAM_LARGE_WINDOW, 1u);
+    if (context->dictionary) {
+      BrotliDecoderAttachDictionary(s, BROTLI_SHARED_DICTIONARY_RAW,
+          context->dictionary_size, context->dictionary);
+    }
+    if (HasSharedOutput(context)) {
+      context->current_output_path = context->output_path;
+      is_ok = OpenOutputFile(
+          context->output_path, &context->fout, context->force_overwrite);
+    }
+  }
+
+  InitializeBuffers(context);
+  archive.num_entries = end;
+  while (is_ok && archive.current < archive.num_entries) {
+    result = BrotliDecoderDecompressStream(s, &context->available_in,
+        &context->next_in, &context->available_out, &context->next_out, 0);
+    is_ok = WriteSolidOutput(context, &archive, context->output,
+                             (size_t)(context->next_out - context->output));
+    context->available_out = kFileBufferSize;
+    context->next_out = context->output;
+    if (!is_ok || archive.current == archive.num_entries) break;
+    if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT &&
+        HasMoreInput(context)) {
+      is_ok = ProvideInput(context);
+    } else if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+      fprintf(stderr, "corrupt input [%s]\n",
+              PrintablePath(context->current_input_path));
+      is_ok = BROTLI_FALSE;
+    }
+  }
+  if (is_ok && context->verbosity > 0) {
+    context->end_time = clock();
+    fprintf(stderr, "Decompressed ");
+    PrintFileProcessingProgress(context);
+    fprintf(stderr, "\n");
+  }
+
+  if (!CloseExtractedFile(context, is_ok)) is_ok = BROTLI_FALSE;
+  if (context->fin) fclose(context->fin);
+  context->fin = NULL;
+  if (s) BrotliDecoderDestroyInstance(s);
+  free(archive.names);
+  free(archive.entries);
+  return is_ok;
+}
+
+/* Reads every input file as one sample and writes a dictionary trained on
+   them to the output. */
+static BROTLI_BOOL TrainDictionary(Context* context) {
+  uint8_t* samples = NULL;
+  size_t* sample_sizes = NULL;
+  size_t num_samples = 0;
+  size_t samples_capacity = 0;
+  size_t total_size = 0;
+  uint8_t* dictionary = NULL;
+  size_t dictionary_size = context->train_size;
+  uint8_t* serialized = NULL;
+  size_t serialized_size = 0;
+  FILE* fout = NULL;
+  BROTLI_BOOL is_ok = BROTLI_TRUE;
+
+  if (context->input_count > 0) {
+    sample_sizes = (size_t*)malloc(context->input_count * sizeof(size_t));
+  } else {
+    sample_sizes = (size_t*)malloc(sizeof(size_t));
+  }
+  if (!sample_sizes) {
+    fprintf(stderr, "out of memory\n");
+    return BROTLI_FALSE;
+  }
+  while (is_ok && NextFile(context)) {
+    FILE* fin;
+    size_t sample_size = 0;
+    if (!OpenInputFile(context->current_input_path, &fin)) {
+      is_ok = BROTLI_FALSE;
+      break;
+    }
+    for (;;) {
+      size_t bytes_read;
+      if (total_size + kFileBufferSize > samples_capacity) {
+        size_t new_capacity = samples_capacity * 2 + kFileBufferSize;
+        uint8_t* new_samples = (uint8_t*)realloc(samples, new_capacity);
+        if (!new_samples) {
+          fprintf(stderr, "out of memory\n");
+          is_ok = BROTLI_FALSE;
+          break;
+        }
+        samples = new_samples;
+        samples_capacity = new_capacity;
+      }
+      bytes_read = fread(samples + total_size, 1, kFileBufferSize, fin);
+      total_size += bytes_read;
+      sample_size += bytes_read;
+      if (bytes_read < kFileBufferSize) {
+        if (ferror(fin)) {
+          fprintf(stderr, "failed to read input [%s]: %s\n",
+                  PrintablePath(context->current_input_path), strerror(errno));
+          is_ok = BROTLI_FALSE;
+        }
+        break;
+      }
+    }
+    fclose(fin);
+    sample_sizes[num_samples++] = sample_size;
+  }
+  if (context->iterator_error) is_ok = BROTLI_FALSE;
+
+  if (is_ok) {
+    dictionary = (uint8_t*)malloc(dictionary_size);
+    serialized_size = dictionary_size + BROTLI_SERIALIZED_DICTIONARY_OVERHEAD;
+    if (context->train_serialized) {
+      serialized = (uint8_t*)malloc(serialized_size);
+    }
+    if (!dictionary || (context->train_serialized && !serialized)) {
+      fprintf(stderr, "out of memory\n");
+      is_ok = BROTLI_FALSE;
+    }
+  }
+  if (is_ok && !BrotliEncoderTrainDictionary(num_samples, sample_sizes,
+      samples, &dictionary_size, dictionary)) {
+    fprintf(stderr, "failed to train dictionary\n");
+    is_ok = BROTLI_FALSE;
+  }
+  if (is_ok && context->train_serialized) {
+    is_ok = BrotliEncoderSerializeDictionary(
+        dictionary_size, dictionary, &serialized_size, serialized);
+  }
+  if (is_ok) {
+    const uint8_t* data = context->train_serialized ? serialized : dictionary;
+    size_t data_size =
+        context->train_serialized ? serialized_size : dictionary_size;
+    is_ok = OpenOutputFile(
+        context->output_path, &fout, context->force_overwrite);
+    if (is_ok && fwrite(data, 1, data_size, fout) != data_size) {
+      fprintf(stderr, "failed to write output [%s]: %s\n",
+              PrintablePath(context->output_path), strerror(errno));
+      is_ok = BROTLI_FALSE;
+    }
+    if (fout && fclose(fout) != 0) {
+      fprintf(stderr, "fclose failed [%s]: %s\n",
+              PrintablePath(context->output_path), strerror(errno));
+      is_ok = BROTLI_FALSE;
+    }
+    if (!is_ok && context->output_path) unlink(context->output_path);
+  }
+  if (is_ok && context->verbosity > 0) {
+    fprintf(stderr, "Trained %lu byte dictionary on %lu samples (%lu bytes)\n",
+            (unsigned long)dictionary_size, (unsigned long)num_samples,
+            (unsigned long)total_size);
+  }
+
+  free(serialized);
+  free(dictionary);
+  free(sample_sizes);
+  free(samples);
+  return is_ok;
+}
+
+int main(int argc, char** argv) {
+  Command command;
+  Context context;
+  BROTLI_BOOL is_ok = BROTLI_TRUE;
+  int i;
+
+  context.quality = 11;
+  context.lgwin = -1;
+  context.threads = 1;
+  context.chunk_bits = 0;
+  context.verbosity = 0;
+  context.force_overwrite = BROTLI_FALSE;
+  context.junk_source = BROTLI_FALSE;
+  context.copy_stat = BROTLI_TRUE;
+  context.test_integrity = BROTLI_FALSE;
+  context.write_to_stdout = BROTLI_FALSE;
+  context.decompress = BROTLI_FALSE;
+  context.large_window = BROTLI_FALSE;
+  context.long_distance = BROTLI_FALSE;
+  context.shortest_path = BROTLI_FALSE;
+  context.train_serialized = BROTLI_FALSE;
+  context.solid = BROTLI_FALSE;
+  context.train_size = (size_t)DEFAULT_TRAIN_SIZE_KIB << 10;
+  context.checkpoint_interval = (uint64_t)DEFAULT_CHECKPOINT_INTERVAL_MIB << 20;
+  context.output_path = NULL;
+  context.dictionary_path = NULL;
+  context.checkpoint_path = NULL;
+  context.extract_name = NULL;
+  context.suffix = DEFAULT_SUFFIX;
+  for (i = 0; i < MAX_OPTIONS; ++i) context.not_input_indices[i] = 0;
+  context.longest_path_len = 1;
+  context.input_count = 0;
+
+  context.argc = argc;
+  context.argv = argv;
+  context.dictionary = NULL;
+  context.dictionary_size = 0;
+  context.dictionary_mapped = BROTLI_FALSE;
+  context.prepared_dictionary = NULL;
+  context.modified_path = NULL;
+  context.iterator = 0;
+  context.ignore = 0;
+  context.iterator_error = BROTLI_FALSE;
+  context.checkpoint_saved = BROTLI_FALSE;
+  context.buffer = NULL;
+  context.current_input_path = NULL;
+  context.current_output_path = NULL;
+  context.fin = NULL;
+  context.fout = NULL;
+
+  command = ParseParams(&context);
+
+  if (command == COMMAND_COMPRESS || command == COMMAND_DECOMPRESS ||
+      command == COMMAND_TEST_INTEGRITY) {
+    if (!ReadDictionary(&context, command)) is_ok = BROTLI_FALSE;
+    if (is_ok) {
+      size_t modified_path_len =
+          context.longest_path_len + strlen(context.suffix) + 1;
+      context.modified_path = (char*)malloc(modified_path_len);
+      context.buffer = (uint8_t*)malloc(kFileBufferSize * 2);
+      if (!context.modified_path || !context.buffer) {
+        fprintf(stderr, "out of memory\n");
+        is_ok = BROTLI_FALSE;
+      } else {
+        context.input = context.buffer;
+        context.output = context.buffer + kFileBufferSize;
+      }
+    }
+  }
+
+  if (!is_ok) command = COMMAND_NOOP;
+
+  switch (command) {
+    case COMMAND_NOOP:
+      break;
+
+    case COMMAND_VERSION:
+      PrintVersion();
+      break;
+
+    case COMMAND_COMPRESS:
+      is_ok = context.solid ?
+          CompressSolidArchive(&context) : CompressFiles(&context);
+      break;
 
     case COMMAND_DECOMPRESS:
+      is_ok = context.solid ?
+          ExtractSolidArchive(&context) : DecompressFiles(&context);
+      break;
+
     case COMMAND_TEST_INTEGRITY:
       is_ok = DecompressFiles(&context);
       break;
 
+    case COMMAND_TRAIN:
+      is_ok = TrainDictionary(&context);
+      break;
+
     case COMMAND_HELP:
     case COMMAND_INVALID:
     default:
@@ -1210,6 +2969,12 @@ int main(int argc, char** argv) {
   if (context.iterator_error) is_ok = BROTLI_FALSE;
 
   BrotliEncoderDestroyPreparedDictionary(context.prepared_dictionary);
+#if !defined(_WIN32)
+  if (context.dictionary_mapped) {
+    munmap(context.dictionary, context.dictionary_size);
+    context.dictionary = NULL;
+  }
+#endif
   free(context.dictionary);
   free(context.modified_path);
   free(context.buffer);
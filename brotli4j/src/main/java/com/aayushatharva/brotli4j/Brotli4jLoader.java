@@ -16,49 +16,106 @@
  */
 package com.aayushatharva.brotli4j;
 
+import java.io.ByteArrayOutputStream;
 import java.io.File;
+import java.io.IOException;
 import java.io.InputStream;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.FileSystems;
 import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.Paths;
 import java.nio.file.StandardCopyOption;
+import java.nio.file.attribute.PosixFilePermission;
+import java.nio.file.attribute.PosixFilePermissions;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.HashSet;
+import java.util.List;
+import java.util.Set;
 
 /**
  * Loads Brotli Native Library
+ * <p>
+ * Besides the baseline library, a platform may ship variants built for newer CPUs
+ * ({@code x86-64-v2}, {@code x86-64-v3}, {@code x86-64-v4}, {@code armv8.2-a}); the best
+ * one the running CPU supports is loaded. System property {@value #VARIANT_PROPERTY}
+ * overrides the choice: a variant name, or {@code baseline}.
+ * <p>
+ * Library packaged in the jar is extracted once to a cache directory (system property
+ * {@value #CACHE_DIR_PROPERTY}, by default {@code brotli4j-<user.name>} in
+ * {@code java.io.tmpdir}) under the SHA-256 of its content, and reused by later JVMs
+ * once its content is verified. Empty {@value #CACHE_DIR_PROPERTY} disables the cache.
+ * System property {@value #LIBRARY_PATH_PROPERTY} makes the loader use the given
+ * library file instead, without any extraction.
  */
 public class Brotli4jLoader {
 
+    /**
+     * Name of the system property that selects the native library variant.
+     */
+    public static final String VARIANT_PROPERTY = "brotli4j.variant";
+
+    /**
+     * Name of the system property with the directory of extracted native libraries.
+     */
+    public static final String CACHE_DIR_PROPERTY = "brotli4j.cache.dir";
+
+    /**
+     * Name of the system property with the path of the native library file to load.
+     */
+    public static final String LIBRARY_PATH_PROPERTY = "brotli4j.library.path";
+
+    private static final String BASELINE = "baseline";
+
+    /* Variants from the best; each requires the CPU features of the ones after it. */
+    private static final String[] X86_64_VARIANTS = {"x86-64-v4", "x86-64-v3", "x86-64-v2"};
+    private static final String[] AARCH64_VARIANTS = {"armv8.2-a"};
+
     private static final Throwable UNAVAILABILITY_CAUSE;
+    private static final String VARIANT;
 
     static {
         Throwable cause = null;
-        try {
-            System.loadLibrary("brotli");
-        } catch (Throwable t) {
+        String variant = null;
+        String libraryPath = System.getProperty(LIBRARY_PATH_PROPERTY);
+        if (libraryPath != null && !libraryPath.isEmpty()) {
             try {
-                String nativeLibName = System.mapLibraryName("brotli");
-                String libPath = "/lib/" + getPlatform() + "/" + nativeLibName;
-
-                File tempDir = new File(System.getProperty("java.io.tmpdir"), "com_aayushatharva_brotli4j_" + System.nanoTime());
-                tempDir.mkdir();
-                tempDir.deleteOnExit();
+                System.load(new File(libraryPath).getAbsolutePath());
+            } catch (Throwable throwable) {
+                cause = throwable;
+            }
+        } else {
+            try {
+                System.loadLibrary("brotli");
+            } catch (Throwable t) {
+                try {
+                    String nativeLibName = System.mapLibraryName("brotli");
+                    String platform = getPlatform();
+                    variant = selectVariant(platform, nativeLibName);
+                    String libPath = "/lib/" + platform + "/"
+                            + (variant.equals(BASELINE) ? "" : variant + "/") + nativeLibName;
+                    byte[] library = readResource(libPath);
 
-                File tempFile = new File(tempDir, nativeLibName);
+                    File libFile;
+                    try {
+                        libFile = extractCached(library, nativeLibName);
+                    } catch (Throwable throwable) {
+                        libFile = extractTemporary(library, nativeLibName);
+                    }
+                    System.load(libFile.getAbsolutePath());
 
-                try (InputStream in = Brotli4jLoader.class.getResourceAsStream(libPath)) {
-                    Files.copy(in, tempFile.toPath(), StandardCopyOption.REPLACE_EXISTING);
+                    cause = null;
                 } catch (Throwable throwable) {
-                    tempFile.delete();
-                    throw throwable;
+                    cause = throwable;
                 }
-
-                System.load(tempFile.getAbsolutePath());
-
-                cause = null;
-            } catch (Throwable throwable) {
-                cause = throwable;
             }
         }
 
         UNAVAILABILITY_CAUSE = cause;
+        VARIANT = (cause == null) ? variant : null;
     }
 
     /**
@@ -85,6 +142,199 @@ public class Brotli4jLoader {
         return UNAVAILABILITY_CAUSE;
     }
 
+    /**
+     * Returns the loaded native library variant.
+     *
+     * @return variant name, {@code baseline}, or {@code null} if the library is not loaded
+     *         or comes from {@code java.library.path}
+     */
+    public static String getVariant() {
+        return VARIANT;
+    }
+
+    private static byte[] readResource(String libPath) throws IOException {
+        try (InputStream in = Brotli4jLoader.class.getResourceAsStream(libPath)) {
+            if (in == null) {
+                throw new UnsatisfiedLinkError("native library " + libPath + " is not packaged");
+            }
+            ByteArrayOutputStream out = new ByteArrayOutputStream(1 << 20);
+            byte[] buffer = new byte[65536];
+            int n;
+            while ((n = in.read(buffer)) != -1) {
+                out.write(buffer, 0, n);
+            }
+            return out.toByteArray();
+        }
+    }
+
+    /**
+     * Returns the cached copy of {@code library}, writing it first if there is none yet.
+     * <p>
+     * Concurrent JVMs may race to write the same entry; each writes a private temporary
+     * file and renames it into place, so a library is never loaded half-written.
+     */
+    private static File extractCached(byte[] library, String nativeLibName)
+            throws IOException, NoSuchAlgorithmException {
+        String dir = System.getProperty(CACHE_DIR_PROPERTY);
+        if (dir == null) {
+            dir = new File(System.getProperty("java.io.tmpdir"), "brotli4j-" + System.getProperty("user.name"))
+                    .getPath();
+        } else if (dir.isEmpty()) {
+            throw new IOException("native library cache is disabled");
+        }
+        Path entryDir = createPrivateDirectory(Paths.get(dir)).resolve(sha256(library));
+        Path entry = entryDir.resolve(nativeLibName);
+        if (isCached(entry, library)) {
+            return entry.toFile();
+        }
+        Files.createDirectories(entryDir);
+        Path temp = Files.createTempFile(entryDir, nativeLibName, ".tmp");
+        try {
+            Files.write(temp, library);
+            try {
+                Files.move(temp, entry, StandardCopyOption.ATOMIC_MOVE);
+            } catch (IOException e) {
+                /* Entry written by another JVM meanwhile; on Windows it can not be replaced. */
+                if (!isCached(entry, library)) {
+                    throw e;
+                }
+            }
+        } finally {
+            Files.deleteIfExists(temp);
+        }
+        return entry.toFile();
+    }
+
+    private static boolean isCached(Path entry, byte[] library) throws IOException {
+        return Files.isRegularFile(entry) && Files.size(entry) == library.length
+                && Arrays.equals(Files.readAllBytes(entry), library);
+    }
+
+    /**
+     * Creates {@code dir} if needed; refuses directories others can write into, as
+     * libraries loaded from there could be replaced.
+     */
+    static Path createPrivateDirectory(Path dir) throws IOException {
+        boolean posix = FileSystems.getDefault().supportedFileAttributeViews().contains("posix");
+        if (!Files.isDirectory(dir)) {
+            if (posix) {
+                Files.createDirectories(dir,
+                        PosixFilePermissions.asFileAttribute(PosixFilePermissions.fromString("rwx------")));
+            } else {
+                Files.createDirectories(dir);
+            }
+        }
+        if (posix) {
+            Set<PosixFilePermission> permissions = Files.getPosixFilePermissions(dir);
+            if (permissions.contains(PosixFilePermission.GROUP_WRITE)
+                    || permissions.contains(PosixFilePermission.OTHERS_WRITE)
+                    || !Files.getOwner(dir).getName().equals(System.getProperty("user.name"))) {
+                throw new IOException("native library cache " + dir + " is not private");
+            }
+        }
+        return dir;
+    }
+
+    private static String sha256(byte[] data) throws NoSuchAlgorithmException {
+        byte[] digest = MessageDigest.getInstance("SHA-256").digest(data);
+        StringBuilder hex = new StringBuilder(digest.length * 2);
+        for (byte b : digest) {
+            hex.append(Character.forDigit((b >> 4) & 0xF, 16)).append(Character.forDigit(b & 0xF, 16));
+        }
+        return hex.toString();
+    }
+
+    /**
+     * Writes {@code library} to a new temporary directory, removed when the JVM exits.
+     */
+    private static File extractTemporary(byte[] library, String nativeLibName) throws IOException {
+        File tempDir = new File(System.getProperty("java.io.tmpdir"), "com_aayushatharva_brotli4j_" + System.nanoTime());
+        tempDir.mkdir();
+        tempDir.deleteOnExit();
+
+        File tempFile = new File(tempDir, nativeLibName);
+        tempFile.deleteOnExit();
+        try {
+            Files.write(tempFile.toPath(), library);
+        } catch (IOException e) {
+            tempFile.delete();
+            throw e;
+        }
+        return tempFile;
+    }
+
+    private static String selectVariant(String platform, String nativeLibName) {
+        String requested = System.getProperty(VARIANT_PROPERTY);
+        if (requested != null && !requested.isEmpty()) {
+            return requested;
+        }
+        String[] candidates;
+        if (platform.equals("linux-x86_64")) {
+            candidates = X86_64_VARIANTS;
+        } else if (platform.equals("linux-aarch64")) {
+            candidates = AARCH64_VARIANTS;
+        } else {
+            return BASELINE;
+        }
+        Set<String> features = readCpuFeatures();
+        for (String candidate : candidates) {
+            if (features.containsAll(requiredFeatures(candidate))
+                    && Brotli4jLoader.class.getResource("/lib/" + platform + "/" + candidate + "/" + nativeLibName) != null) {
+                return candidate;
+            }
+        }
+        return BASELINE;
+    }
+
+    /**
+     * Returns {@code /proc/cpuinfo} flags of the first CPU; empty if not readable.
+     */
+    private static Set<String> readCpuFeatures() {
+        Set<String> features = new HashSet<>();
+        try {
+            for (String line : Files.readAllLines(Paths.get("/proc/cpuinfo"), StandardCharsets.UTF_8)) {
+                /* "flags" on x86, "Features" on ARM. */
+                if (line.startsWith("flags") || line.startsWith("Features")) {
+                    int colon = line.indexOf(':');
+                    if (colon >= 0) {
+                        features.addAll(Arrays.asList(line.substring(colon + 1).trim().split("\\s+")));
+                        break;
+                    }
+                }
+            }
+        } catch (Throwable t) {
+            features.clear();
+        }
+        return features;
+    }
+
+    /**
+     * Returns {@code /proc/cpuinfo} flags that code built for {@code variant} relies on,
+     * in line with the flags of natives build scripts.
+     */
+    private static List<String> requiredFeatures(String variant) {
+        List<String> features = new ArrayList<>();
+        switch (variant) {
+            case "x86-64-v4":
+                features.addAll(Arrays.asList("avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl"));
+                /* Fall through. */
+            case "x86-64-v3":
+                features.addAll(Arrays.asList("avx", "avx2", "bmi1", "bmi2", "f16c", "fma", "abm", "movbe",
+                        "xsave"));
+                /* Fall through. */
+            case "x86-64-v2":
+                features.addAll(Arrays.asList("cx16", "lahf_lm", "popcnt", "pni", "ssse3", "sse4_1", "sse4_2"));
+                break;
+            case "armv8.2-a":
+                features.addAll(Arrays.asList("crc32", "atomics", "asimdrdm", "dcpop"));
+                break;
+            default:
+                /* Unknown variants are never selected automatically. */
+                features.add(variant);
+        }
+        return features;
+    }
+
     private static String getPlatform() {
         String osName = System.getProperty("os.name");
         String archName = System.getProperty("os.arch");
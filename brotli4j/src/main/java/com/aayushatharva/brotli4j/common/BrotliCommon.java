@@ -8,6 +8,9 @@ package com.aayushatharva.brotli4j.common;
 import java.io.IOException;
 import java.io.InputStream;
 import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
 import java.util.Arrays;
 
 /**
@@ -56,6 +59,26 @@ public class BrotliCommon {
         return Arrays.equals(RFC_DICTIONARY_SHA_256, digest);
     }
 
+    /**
+     * Checks whether the native library already has dictionary data.
+     * <p>
+     * It is the case when the library carries the compiled-in RFC dictionary (the
+     * default build), or once data has been set. Then the {@code setDictionaryData}
+     * methods return right away; nothing is read, copied or pinned.
+     */
+    public static boolean isDictionaryDataSet() {
+        synchronized (mutex) {
+            return isDictionaryDataSetLocked();
+        }
+    }
+
+    private static boolean isDictionaryDataSetLocked() {
+        if (!isDictionaryDataSet && CommonJNI.nativeHasDictionaryData()) {
+            isDictionaryDataSet = true;
+        }
+        return isDictionaryDataSet;
+    }
+
     /**
      * Copy bytes to a new direct ByteBuffer.
      * <p>
@@ -75,7 +98,7 @@ public class BrotliCommon {
             throw new IllegalArgumentException("invalid dictionary size");
         }
         synchronized (mutex) {
-            if (isDictionaryDataSet) {
+            if (isDictionaryDataSetLocked()) {
                 return;
             }
             setDictionaryData(makeNative(data));
@@ -87,7 +110,7 @@ public class BrotliCommon {
      */
     public static void setDictionaryData(InputStream src) throws IOException {
         synchronized (mutex) {
-            if (isDictionaryDataSet) {
+            if (isDictionaryDataSetLocked()) {
                 return;
             }
             ByteBuffer copy = ByteBuffer.allocateDirect(RFC_DICTIONARY_SIZE);
@@ -106,6 +129,28 @@ public class BrotliCommon {
         }
     }
 
+    /**
+     * Memory-maps a file (e.g. {@code dictionary.bin} of brotli sources) and sets it
+     * to be brotli dictionary.
+     * <p>
+     * Pages are shared with the page cache and loaded on first use, so there is no
+     * Java heap or direct buffer copy. The mapping stays alive for the lifetime of
+     * the process.
+     */
+    public static void setDictionaryData(Path file) throws IOException {
+        synchronized (mutex) {
+            if (isDictionaryDataSetLocked()) {
+                return;
+            }
+            try (FileChannel channel = FileChannel.open(file, StandardOpenOption.READ)) {
+                if (channel.size() != RFC_DICTIONARY_SIZE) {
+                    throw new IllegalArgumentException("invalid dictionary size");
+                }
+                setDictionaryData(channel.map(FileChannel.MapMode.READ_ONLY, 0, RFC_DICTIONARY_SIZE));
+            }
+        }
+    }
+
     /**
      * Sets data to be brotli dictionary.
      */
@@ -117,7 +162,7 @@ public class BrotliCommon {
             throw new IllegalArgumentException("invalid dictionary size");
         }
         synchronized (mutex) {
-            if (isDictionaryDataSet) {
+            if (isDictionaryDataSetLocked()) {
                 return;
             }
             if (!CommonJNI.nativeSetDictionaryData(data)) {
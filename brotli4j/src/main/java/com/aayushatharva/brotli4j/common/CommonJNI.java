@@ -12,4 +12,10 @@ import java.nio.ByteBuffer;
  */
 class CommonJNI {
     static native boolean nativeSetDictionaryData(ByteBuffer data);
+
+    static native boolean nativeHasDictionaryData();
+
+    static native void nativeSetMemoryBudget(long limit);
+
+    static native void nativeGetMemoryBudget(long[] values);
 }
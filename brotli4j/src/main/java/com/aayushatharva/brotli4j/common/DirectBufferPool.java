@@ -0,0 +1,106 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.common;
+
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/**
+ * Process-wide pool of direct buffers used to stage stream input.
+ * <p>
+ * Capacities are powers of two between {@link #MIN_CAPACITY} and {@link #MAX_CAPACITY}.
+ * Buffers are shared by all threads: stream objects are often created on one thread
+ * and closed on another. Each size class keeps at most 32 MiB of idle buffers;
+ * the rest is left to the garbage collector.
+ */
+public final class DirectBufferPool {
+    private static final int MIN_BITS = 12;
+    private static final int MAX_BITS = 24;
+    private static final int NUM_CLASSES = MAX_BITS - MIN_BITS + 1;
+
+    public static final int MIN_CAPACITY = 1 << MIN_BITS;
+    public static final int MAX_CAPACITY = 1 << MAX_BITS;
+    private static final int MAX_IDLE_BYTES_PER_CLASS = 1 << 25;
+
+    private static final ConcurrentLinkedQueue<ByteBuffer>[] IDLE = newQueues();
+    private static final AtomicInteger[] IDLE_COUNT = newCounters();
+
+    // Disallow instantiation.
+    private DirectBufferPool() {
+    }
+
+    @SuppressWarnings("unchecked")
+    private static ConcurrentLinkedQueue<ByteBuffer>[] newQueues() {
+        ConcurrentLinkedQueue<ByteBuffer>[] queues = new ConcurrentLinkedQueue[NUM_CLASSES];
+        for (int i = 0; i < NUM_CLASSES; i++) {
+            queues[i] = new ConcurrentLinkedQueue<>();
+        }
+        return queues;
+    }
+
+    private static AtomicInteger[] newCounters() {
+        AtomicInteger[] counters = new AtomicInteger[NUM_CLASSES];
+        for (int i = 0; i < NUM_CLASSES; i++) {
+            counters[i] = new AtomicInteger();
+        }
+        return counters;
+    }
+
+    private static int sizeClass(int capacity) {
+        return 32 - Integer.numberOfLeadingZeros(capacity - 1) - MIN_BITS;
+    }
+
+    /**
+     * Takes an idle buffer, or allocates a new one.
+     *
+     * @param capacity minimal capacity; rounded up to a power of two
+     * @return cleared direct buffer
+     */
+    public static ByteBuffer acquire(int capacity) {
+        if (capacity <= 0 || capacity > MAX_CAPACITY) {
+            throw new IllegalArgumentException("invalid buffer capacity");
+        }
+        int sizeClass = sizeClass(Math.max(capacity, MIN_CAPACITY));
+        ByteBuffer buffer = IDLE[sizeClass].poll();
+        if (buffer == null) {
+            return ByteBuffer.allocateDirect(1 << (sizeClass + MIN_BITS));
+        }
+        IDLE_COUNT[sizeClass].decrementAndGet();
+        ((Buffer) buffer).clear();
+        return buffer;
+    }
+
+    /**
+     * Returns a buffer obtained with {@link #acquire(int)}; it MUST NOT be used afterwards.
+     */
+    public static void release(ByteBuffer buffer) {
+        int capacity = buffer.capacity();
+        if (!buffer.isDirect() || capacity < MIN_CAPACITY || capacity > MAX_CAPACITY
+                || Integer.bitCount(capacity) != 1) {
+            return;
+        }
+        int sizeClass = sizeClass(capacity);
+        if (IDLE_COUNT[sizeClass].incrementAndGet() > MAX_IDLE_BYTES_PER_CLASS / capacity) {
+            IDLE_COUNT[sizeClass].decrementAndGet();
+            return;
+        }
+        IDLE[sizeClass].offer(buffer);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.common;
+
+/**
+ * Snapshot of native memory allocated by a single encoder or decoder state.
+ * <p>
+ * Peak and allocation count are taken since creation or the last reset;
+ * JNI input / output buffers are not included.
+ */
+public final class MemoryStats {
+    private final long currentBytes;
+    private final long peakBytes;
+    private final long allocationCount;
+
+    public MemoryStats(long currentBytes, long peakBytes, long allocationCount) {
+        this.currentBytes = currentBytes;
+        this.peakBytes = peakBytes;
+        this.allocationCount = allocationCount;
+    }
+
+    /**
+     * @return bytes allocated at the moment of the snapshot
+     */
+    public long getCurrentBytes() {
+        return currentBytes;
+    }
+
+    /**
+     * @return maximal number of bytes allocated at once
+     */
+    public long getPeakBytes() {
+        return peakBytes;
+    }
+
+    /**
+     * @return number of allocations performed
+     */
+    public long getAllocationCount() {
+        return allocationCount;
+    }
+
+    @Override
+    public String toString() {
+        return "MemoryStats{currentBytes=" + currentBytes + ", peakBytes=" + peakBytes
+                + ", allocationCount=" + allocationCount + '}';
+    }
+}
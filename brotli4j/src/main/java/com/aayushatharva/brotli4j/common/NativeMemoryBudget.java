@@ -0,0 +1,121 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.common;
+
+/**
+ * Process-wide budget of native memory of encoders and decoders.
+ * <p>
+ * Every native encoder or decoder state is charged for the memory it holds; once a
+ * limit is set, a native allocation that would take the total charge over it fails,
+ * so a stream fails instead of the process. Encoders of output streams and channels,
+ * {@code DirectEncoder}s and one-shot {@code Encoder.compress} are admitted up front:
+ * each reserves the peak memory estimated for its parameters, see
+ * {@code Encoder.estimatePeakMemory}, and never fails within it. When the budget has
+ * no room for a new encoder, its creation waits up to {@link #getMaxWait()} for others
+ * to close, then, if {@link #isDegrade() degrading} is allowed, lowers window and
+ * quality to fit the room left; otherwise creation fails with {@link java.io.IOException}.
+ * <p>
+ * Decoders are not admitted, as their memory depends on the stream; they, and other
+ * encoders (e.g. pooled ones for small inputs), are charged as they allocate. JNI
+ * input / output buffers are not included.
+ */
+public final class NativeMemoryBudget {
+    private static volatile long limit;
+    private static volatile long maxWaitMillis;
+    private static volatile boolean degrade = true;
+
+    private NativeMemoryBudget() {
+    }
+
+    /**
+     * Sets the budget; it applies to allocations and admissions that follow.
+     *
+     * @param bytes budget, or 0 for unlimited (default)
+     */
+    public static void setLimit(long bytes) {
+        if (bytes < 0) {
+            throw new IllegalArgumentException("limit can not be negative");
+        }
+        CommonJNI.nativeSetMemoryBudget(bytes);
+        limit = bytes;
+    }
+
+    /**
+     * @return budget in bytes, or 0 if unlimited
+     */
+    public static long getLimit() {
+        return limit;
+    }
+
+    /**
+     * Sets how long creation of an encoder waits for room in the budget.
+     *
+     * @param millis milliseconds; 0 (default) does not wait
+     */
+    public static void setMaxWait(long millis) {
+        if (millis < 0) {
+            throw new IllegalArgumentException("wait can not be negative");
+        }
+        maxWaitMillis = millis;
+    }
+
+    public static long getMaxWait() {
+        return maxWaitMillis;
+    }
+
+    /**
+     * Sets whether encoders that do not fit the budget after waiting are created with
+     * lower window and quality; otherwise their creation fails.
+     *
+     * @param enabled {@code true} (default) to degrade
+     */
+    public static void setDegrade(boolean enabled) {
+        degrade = enabled;
+    }
+
+    public static boolean isDegrade() {
+        return degrade;
+    }
+
+    /**
+     * @return bytes charged to the budget: reservations, and allocations beyond them
+     */
+    public static long getChargedBytes() {
+        return snapshot()[1];
+    }
+
+    /**
+     * @return bytes allocated by all native encoders and decoders
+     */
+    public static long getAllocatedBytes() {
+        return snapshot()[2];
+    }
+
+    /**
+     * @return maximal number of bytes allocated at once since the library was loaded
+     */
+    public static long getPeakAllocatedBytes() {
+        return snapshot()[3];
+    }
+
+    private static long[] snapshot() {
+        long[] values = new long[4];
+        CommonJNI.nativeGetMemoryBudget(values);
+        return values;
+    }
+}
@@ -26,17 +26,13 @@ import java.io.IOException;
 import java.nio.ByteBuffer;
 import java.nio.channels.ClosedChannelException;
 import java.nio.channels.ReadableByteChannel;
+import java.util.concurrent.locks.ReentrantLock;
 
 /**
  * ReadableByteChannel that wraps native brotli decoder.
  */
 public class BrotliDecoderChannel extends Decoder implements ReadableByteChannel {
-    /**
-     * The default internal buffer size used by the decoder.
-     */
-    private static final int DEFAULT_BUFFER_SIZE = 16384;
-
-    private final Object mutex = new Object();
+    private final ReentrantLock lock = new ReentrantLock();
 
     /**
      * Creates a BrotliDecoderChannel.
@@ -48,8 +44,14 @@ public class BrotliDecoderChannel extends Decoder implements ReadableByteChannel
         super(source, bufferSize);
     }
 
+    /**
+     * Creates a BrotliDecoderChannel with adaptive intermediate buffer.
+     *
+     * @param source underlying source
+     * @see BrotliInputStream#BrotliInputStream(java.io.InputStream)
+     */
     public BrotliDecoderChannel(ReadableByteChannel source) throws IOException {
-        this(source, DEFAULT_BUFFER_SIZE);
+        super(source);
     }
 
     @Override
@@ -57,23 +59,35 @@ public class BrotliDecoderChannel extends Decoder implements ReadableByteChannel
         super.attachDictionary(dictionary);
     }
 
+    @Override
+    public void attachDictionary(DecoderDictionary dictionary) throws IOException {
+        super.attachDictionary(dictionary);
+    }
+
     @Override
     public boolean isOpen() {
-        synchronized (mutex) {
+        lock.lock();
+        try {
             return !closed;
+        } finally {
+            lock.unlock();
         }
     }
 
     @Override
     public void close() throws IOException {
-        synchronized (mutex) {
+        lock.lock();
+        try {
             super.close();
+        } finally {
+            lock.unlock();
         }
     }
 
     @Override
     public int read(ByteBuffer dst) throws IOException {
-        synchronized (mutex) {
+        lock.lock();
+        try {
             if (closed) {
                 throw new ClosedChannelException();
             }
@@ -86,6 +100,8 @@ public class BrotliDecoderChannel extends Decoder implements ReadableByteChannel
                 result += consume(dst);
             }
             return result;
+        } finally {
+            lock.unlock();
         }
     }
 }
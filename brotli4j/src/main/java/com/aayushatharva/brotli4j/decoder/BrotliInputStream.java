@@ -31,11 +31,6 @@ import java.nio.channels.Channels;
  * InputStream that wraps native brotli decoder.
  */
 public class BrotliInputStream extends InputStream {
-    /**
-     * The default internal buffer size used by the decoder.
-     */
-    private static final int DEFAULT_BUFFER_SIZE = 16384;
-
     private final Decoder decoder;
 
     /**
@@ -49,18 +44,90 @@ public class BrotliInputStream extends InputStream {
         this.decoder = new Decoder(Channels.newChannel(source), bufferSize);
     }
 
+    /**
+     * Creates a BrotliInputStream with adaptive intermediate buffer.
+     * <p>
+     * Buffer is taken from {@link com.aayushatharva.brotli4j.common.DirectBufferPool};
+     * it grows while reads from {@code source} fill it and shrinks when they return
+     * little data.
+     *
+     * @param source underlying source
+     */
     public BrotliInputStream(InputStream source) throws IOException {
-        this(source, DEFAULT_BUFFER_SIZE);
+        this.decoder = new Decoder(Channels.newChannel(source));
     }
 
     public void attachDictionary(ByteBuffer dictionary) throws IOException {
         decoder.attachDictionary(dictionary);
     }
 
+    /**
+     * Uses already parsed dictionary; has to be the only one attached.
+     */
+    public void attachDictionary(DecoderDictionary dictionary) throws IOException {
+        decoder.attachDictionary(dictionary);
+    }
+
     public void enableEagerOutput() {
         decoder.enableEagerOutput();
     }
 
+    /**
+     * @see Decoder#setMetadataListener(Decoder.MetadataListener)
+     */
+    public void setMetadataListener(Decoder.MetadataListener listener) {
+        decoder.setMetadataListener(listener);
+    }
+
+    /**
+     * @see Decoder#enableLowMemory()
+     */
+    public void enableLowMemory() throws IOException {
+        decoder.enableLowMemory();
+    }
+
+    /**
+     * @see Decoder#enableStats()
+     */
+    public void enableStats() throws IOException {
+        decoder.enableStats();
+    }
+
+    /**
+     * @see Decoder#getStats()
+     */
+    public DecoderStats getStats() {
+        return decoder.getStats();
+    }
+
+    /**
+     * @see Decoder#enableChecksum()
+     */
+    public void enableChecksum() throws IOException {
+        decoder.enableChecksum();
+    }
+
+    /**
+     * @see Decoder#getChecksum()
+     */
+    public int getChecksum() {
+        return decoder.getChecksum();
+    }
+
+    /**
+     * @see Decoder#enableLargeWindow()
+     */
+    public void enableLargeWindow() throws IOException {
+        decoder.enableLargeWindow();
+    }
+
+    /**
+     * @see Decoder#disableRingBufferReallocation()
+     */
+    public void disableRingBufferReallocation() throws IOException {
+        decoder.disableRingBufferReallocation();
+    }
+
     @Override
     public void close() throws IOException {
         decoder.close();
@@ -0,0 +1,338 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.decoder;
+
+import java.io.Closeable;
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/**
+ * Random access to a file written by {@code BrotliSeekableOutputStream}.
+ * <p>
+ * Only the chunk that covers the requested position is read and decoded. Chunk
+ * data does not reference preceding bytes; it is decoded alone after a synthetic
+ * stream header, with {@code BROTLI_DECODER_PARAM_STREAM_OFFSET} set to the chunk
+ * start. The last decoded chunk is cached, so sequential reads decode each chunk
+ * once.
+ * <p>
+ * Not thread-safe.
+ */
+public class BrotliSeekableFile implements Closeable {
+    /* Index layout; see BrotliSeekableOutputStream. */
+    private static final int MAGIC = 0x6b537242;
+    private static final int FOOTER_SIZE = 12;
+    private static final int ENTRY_SIZE = 16;
+    /* ISLAST and ISLASTEMPTY bits. */
+    private static final byte LAST_EMPTY_METABLOCK = 3;
+    /* Stream header and empty metadata block take at most 13 bits. */
+    private static final int MAX_HEADER_SIZE = 2;
+
+    private final FileChannel channel;
+    private final int lgwin;
+    /* (uncompressed offset, compressed offset) pairs; the last one marks the end */
+    private final long[] index;
+    private final int chunkCount;
+    private final int maxInputSize;
+
+    private DecoderJNI.Wrapper decoder;
+    private int cachedChunk = -1;
+    private byte[] cachedData;
+    private boolean closed;
+
+    BrotliSeekableFile(FileChannel channel) throws IOException {
+        long fileSize = channel.size();
+        if (fileSize < FOOTER_SIZE + ENTRY_SIZE + 1) {
+            throw new IOException("not a seekable brotli file");
+        }
+        ByteBuffer footer = ByteBuffer.allocate(FOOTER_SIZE + 1);
+        readFully(channel, fileSize - FOOTER_SIZE - 1, footer);
+        int chunkCount = footer.getInt();
+        int lgwin = footer.getInt();
+        if (footer.getInt() != MAGIC || footer.get() != LAST_EMPTY_METABLOCK || chunkCount < 0
+                || lgwin < 10 || lgwin > 24
+                || (long) (chunkCount + 1) * ENTRY_SIZE > fileSize - FOOTER_SIZE - 1) {
+            throw new IOException("not a seekable brotli file");
+        }
+        ByteBuffer entries = ByteBuffer.allocate((chunkCount + 1) * ENTRY_SIZE);
+        readFully(channel, fileSize - FOOTER_SIZE - 1 - entries.capacity(), entries);
+        long[] index = new long[2 * chunkCount + 2];
+        for (int i = 0; i < index.length; i++) {
+            index[i] = entries.getLong();
+        }
+        int maxInputSize = 0;
+        for (int i = 0; i < chunkCount; i++) {
+            long chunkLength = index[2 * i + 2] - index[2 * i];
+            long compressedLength = index[2 * i + 3] - index[2 * i + 1];
+            if (chunkLength <= 0 || chunkLength > Integer.MAX_VALUE || compressedLength <= 0
+                    || compressedLength > Integer.MAX_VALUE - MAX_HEADER_SIZE - 1) {
+                throw new IOException("corrupted index");
+            }
+            maxInputSize = Math.max(maxInputSize, (int) compressedLength + MAX_HEADER_SIZE + 1);
+        }
+        if (index[0] != 0 || index[1] != 0 || index[2 * chunkCount + 1] > fileSize) {
+            throw new IOException("corrupted index");
+        }
+        this.channel = channel;
+        this.lgwin = lgwin;
+        this.index = index;
+        this.chunkCount = chunkCount;
+        this.maxInputSize = maxInputSize;
+    }
+
+    /**
+     * Reads {@code buffer.remaining()} bytes at {@code position}; buffer is flipped
+     * and switched to little-endian order.
+     */
+    private static void readFully(FileChannel channel, long position, ByteBuffer buffer) throws IOException {
+        long start = position - buffer.position();
+        while (buffer.hasRemaining()) {
+            if (channel.read(buffer, start + buffer.position()) < 0) {
+                throw new IOException("unexpected end of input");
+            }
+        }
+        ((Buffer) buffer).flip();
+        buffer.order(ByteOrder.LITTLE_ENDIAN);
+    }
+
+    /**
+     * Returns size of decoded data.
+     */
+    public long size() {
+        return index[2 * chunkCount];
+    }
+
+    public int getChunkCount() {
+        return chunkCount;
+    }
+
+    /**
+     * Reads decoded data starting at {@code position} into {@code dst}.
+     * <p>
+     * Data is taken from a single chunk, so fewer bytes than remaining in {@code dst}
+     * may be transferred.
+     *
+     * @return number of bytes read, or -1 if {@code position} is at or past the end
+     */
+    public int read(long position, ByteBuffer dst) throws IOException {
+        if (position < 0) {
+            throw new IllegalArgumentException("negative position");
+        }
+        if (closed) {
+            throw new IOException("read after close");
+        }
+        if (position >= size()) {
+            return -1;
+        }
+        /* Last chunk that starts at or before position. */
+        int lo = 0;
+        int hi = chunkCount - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) >>> 1;
+            if (index[2 * mid] <= position) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        if (lo != cachedChunk) {
+            if (decoder == null) {
+                decoder = new DecoderJNI.Wrapper(maxInputSize);
+            }
+            cachedChunk = -1;
+            byte[] data = new byte[(int) (index[2 * lo + 2] - index[2 * lo])];
+            decodeChunk(decoder, lo, data, 0);
+            cachedData = data;
+            cachedChunk = lo;
+        }
+        int offset = (int) (position - index[2 * lo]);
+        int limit = Math.min(dst.remaining(), cachedData.length - offset);
+        dst.put(cachedData, offset, limit);
+        return limit;
+    }
+
+    /**
+     * Decodes the whole file, each chunk straight into its place of the result.
+     * <p>
+     * Chunks are distributed among up to {@code threads} threads, each with its own
+     * native decoder.
+     */
+    byte[] decodeAll(int threads) throws IOException {
+        if (threads < 1) {
+            throw new IllegalArgumentException("threads must be positive");
+        }
+        if (size() > Integer.MAX_VALUE) {
+            throw new IOException("decoded data is too large");
+        }
+        final byte[] output = new byte[(int) size()];
+        final AtomicInteger nextChunk = new AtomicInteger();
+        Callable<Void> worker = new Callable<Void>() {
+            @Override
+            public Void call() throws IOException {
+                DecoderJNI.Wrapper decoder = new DecoderJNI.Wrapper(Math.max(maxInputSize, 1));
+                try {
+                    int chunk;
+                    while ((chunk = nextChunk.getAndIncrement()) < chunkCount) {
+                        decodeChunk(decoder, chunk, output, (int) index[2 * chunk]);
+                    }
+                } finally {
+                    decoder.destroy();
+                }
+                return null;
+            }
+        };
+        int workers = Math.min(threads, chunkCount);
+        if (workers <= 1) {
+            try {
+                worker.call();
+            } catch (IOException e) {
+                throw e;
+            } catch (Exception e) {
+                throw new IOException("decoding failed", e);
+            }
+            return output;
+        }
+        ExecutorService executor = Executors.newFixedThreadPool(workers);
+        try {
+            List<Future<Void>> results = new ArrayList<Future<Void>>(workers);
+            for (int i = 0; i < workers; i++) {
+                results.add(executor.submit(worker));
+            }
+            for (Future<Void> result : results) {
+                result.get();
+            }
+            return output;
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            throw new IOException("interrupted", e);
+        } catch (ExecutionException e) {
+            Throwable cause = e.getCause();
+            if (cause instanceof IOException) {
+                throw (IOException) cause;
+            }
+            throw new IOException("decoding failed", cause);
+        } finally {
+            executor.shutdownNow();
+        }
+    }
+
+    /**
+     * Decodes {@code chunk} into {@code output} starting at {@code offset}.
+     * <p>
+     * {@link FileChannel} positional reads are safe to run concurrently.
+     */
+    private void decodeChunk(DecoderJNI.Wrapper decoder, int chunk, byte[] output, int offset)
+            throws IOException {
+        long start = index[2 * chunk];
+        int length = (int) (index[2 * chunk + 2] - start);
+        long compressedStart = index[2 * chunk + 1];
+        int compressedLength = (int) (index[2 * chunk + 3] - compressedStart);
+
+        if (!decoder.reset()) {
+            throw new IOException("failed to reset native brotli decoder");
+        }
+        ByteBuffer input = decoder.getInputBuffer();
+        ((Buffer) input).clear();
+        /* The first chunk starts with the real stream header. */
+        if (chunk != 0) {
+            if (!decoder.setStreamOffset(start)) {
+                throw new IOException("failed to set stream offset");
+            }
+            putStreamHeader(input, lgwin);
+        }
+        ((Buffer) input).limit(input.position() + compressedLength);
+        readFully(channel, compressedStart, input);
+        int inputLength = input.limit();
+        ((Buffer) input).limit(inputLength + 1);
+        input.put(inputLength, LAST_EMPTY_METABLOCK);
+        inputLength++;
+
+        int written = 0;
+        while (true) {
+            written += decoder.decompressInto(inputLength, output, offset + written, length - written);
+            inputLength = 0;
+            switch (decoder.getStatus()) {
+                case DONE:
+                    if (written != length) {
+                        throw new IOException("corrupted input");
+                    }
+                    return;
+
+                case NEEDS_MORE_OUTPUT:
+                case OK:
+                    if (written == length) {
+                        throw new IOException("corrupted input");
+                    }
+                    break;
+
+                default:
+                    throw new IOException("corrupted input");
+            }
+        }
+    }
+
+    /**
+     * Puts stream header followed by empty metadata block padded to byte boundary.
+     */
+    private static void putStreamHeader(ByteBuffer input, int lgwin) {
+        int bits;
+        int bitCount;
+        if (lgwin == 16) {
+            bits = 0;
+            bitCount = 1;
+        } else if (lgwin == 17) {
+            bits = 1;
+            bitCount = 7;
+        } else if (lgwin > 17) {
+            bits = ((lgwin - 17) << 1) | 1;
+            bitCount = 4;
+        } else {
+            bits = ((lgwin - 8) << 4) | 1;
+            bitCount = 7;
+        }
+        /* ISLAST = 0, MNIBBLES = 0 (metadata), reserved = 0, MSKIPBYTES = 0 */
+        bits |= 3 << (bitCount + 1);
+        bitCount += 6;
+        input.put((byte) bits);
+        if (bitCount > 8) {
+            input.put((byte) (bits >>> 8));
+        }
+    }
+
+    @Override
+    public void close() throws IOException {
+        if (closed) {
+            return;
+        }
+        closed = true;
+        if (decoder != null) {
+            decoder.destroy();
+        }
+        channel.close();
+    }
+}
@@ -22,23 +22,78 @@
 */
 package com.aayushatharva.brotli4j.decoder;
 
+import com.aayushatharva.brotli4j.common.DirectBufferPool;
+import com.aayushatharva.brotli4j.common.MemoryStats;
+
 import java.io.IOException;
 import java.nio.Buffer;
 import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
 import java.nio.channels.ReadableByteChannel;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
 import java.util.ArrayList;
+import java.util.Arrays;
 
 /**
  * Base class for InputStream / Channel implementations.
  */
 public class Decoder {
     private static final ByteBuffer EMPTY_BUFFER = ByteBuffer.allocate(0);
+
+    /* Bounds of adaptive input buffer; see adaptInputBuffer. */
+    private static final int INITIAL_ADAPTIVE_BUFFER_SIZE = 16384;
+    private static final int MIN_ADAPTIVE_BUFFER_SIZE = DirectBufferPool.MIN_CAPACITY;
+    private static final int MAX_ADAPTIVE_BUFFER_SIZE = 1 << 18;
+
+    /* Largest array most JVMs allow. */
+    private static final int MAX_ARRAY_SIZE = Integer.MAX_VALUE - 8;
+
+    /* Initial output size of decompressPrefix; doubled while limit allows. */
+    private static final int PREFIX_CHUNK_SIZE = 8192;
+
     private final ReadableByteChannel source;
     private final DecoderJNI.Wrapper decoder;
     ByteBuffer buffer;
     boolean closed;
     boolean eager;
 
+    /* Adaptive input buffer taken from the pool; null if buffer size is fixed. */
+    private ByteBuffer pooledInput;
+    private int lastRead;
+
+    private MetadataListener metadataListener;
+
+    /**
+     * Receives metadata blocks of the stream, e.g. written with
+     * {@link com.aayushatharva.brotli4j.encoder.BrotliOutputStream#writeMetadata(byte[])}.
+     */
+    public interface MetadataListener {
+        /**
+         * Invoked when a metadata block is decoded; it could happen before the data
+         * preceding the block is read.
+         *
+         * @param position number of decompressed bytes before the block
+         * @param data     block contents
+         */
+        void onMetadata(long position, byte[] data) throws IOException;
+    }
+
+    /**
+     * Creates a Decoder wrapper with adaptive read buffer.
+     * <p>
+     * Read buffer is taken from {@link DirectBufferPool}. It grows while reads fill
+     * it and shrinks when reads return less than a quarter of it, e.g. for idle
+     * network streams.
+     *
+     * @param source underlying source
+     */
+    public Decoder(ReadableByteChannel source) throws IOException {
+        this(source, 1, false);
+        this.pooledInput = DirectBufferPool.acquire(INITIAL_ADAPTIVE_BUFFER_SIZE);
+        decoder.setInputBuffer(pooledInput);
+    }
+
     /**
      * Creates a Decoder wrapper.
      *
@@ -47,6 +102,19 @@ public class Decoder {
      */
     public Decoder(ReadableByteChannel source, int inputBufferSize)
             throws IOException {
+        this(source, inputBufferSize, false);
+    }
+
+    /**
+     * Creates a Decoder wrapper.
+     *
+     * @param source          underlying source
+     * @param inputBufferSize read buffer size
+     * @param pooledAllocator take native memory from per-thread caches of size-classed
+     *                        blocks instead of malloc; reduces heap fragmentation
+     */
+    public Decoder(ReadableByteChannel source, int inputBufferSize, boolean pooledAllocator)
+            throws IOException {
         if (inputBufferSize <= 0) {
             throw new IllegalArgumentException("buffer size must be positive");
         }
@@ -54,7 +122,7 @@ public class Decoder {
             throw new NullPointerException("source can not be null");
         }
         this.source = source;
-        this.decoder = new DecoderJNI.Wrapper(inputBufferSize);
+        this.decoder = new DecoderJNI.Wrapper(inputBufferSize, pooledAllocator);
     }
 
     private void fail(String message) throws IOException {
@@ -72,10 +140,100 @@ public class Decoder {
         }
     }
 
+    void attachDictionary(DecoderDictionary dictionary) throws IOException {
+        if (!decoder.attachDictionary(dictionary)) {
+            fail("failed to attach dictionary");
+        }
+    }
+
+    /**
+     * Returns memory used by native decoder state of this stream.
+     */
+    public MemoryStats getMemoryStats() {
+        return decoder.getMemoryStats();
+    }
+
+    /**
+     * Returns work counters of this stream; zeroes unless {@link #enableStats()} was called.
+     */
+    public DecoderStats getStats() {
+        return decoder.getStats();
+    }
+
     public void enableEagerOutput() {
         this.eager = true;
     }
 
+    /**
+     * Frees native tables as soon as they are not needed, for many concurrent or
+     * mostly idle streams under tight memory limits; has to be called before reading.
+     */
+    public void enableLowMemory() throws IOException {
+        if (!decoder.setLowMemory(true)) {
+            fail("decoding is already started");
+        }
+    }
+
+    /**
+     * Makes decoder count meta-blocks, prefix codes and decoded bytes of this stream,
+     * see {@link #getStats()}; has to be called before reading.
+     */
+    public void enableStats() throws IOException {
+        if (!decoder.setCollectStats(true)) {
+            fail("decoding is already started");
+        }
+    }
+
+    /**
+     * Makes decoder compute CRC-32C of the decompressed data, see {@link #getChecksum()},
+     * and fail with "corrupted input" if it does not match the trailer written with
+     * {@link com.aayushatharva.brotli4j.encoder.Encoder.Parameter#CHECKSUM}; has to be
+     * called before reading.
+     */
+    public void enableChecksum() throws IOException {
+        if (!decoder.setChecksum(true)) {
+            fail("decoding is already started");
+        }
+    }
+
+    /**
+     * Returns CRC-32C of the data decompressed so far; 0 unless {@link #enableChecksum()}
+     * was called.
+     */
+    public int getChecksum() {
+        return decoder.getChecksum();
+    }
+
+    /**
+     * Accepts "Large Window Brotli" streams; has to be called before reading.
+     */
+    public void enableLargeWindow() throws IOException {
+        if (!decoder.setLargeWindow(true)) {
+            fail("decoding is already started");
+        }
+    }
+
+    /**
+     * Allocates ring buffer for the whole stream window up front, instead of growing
+     * it with the decoded content; has to be called before reading.
+     */
+    public void disableRingBufferReallocation() throws IOException {
+        if (!decoder.setRingBufferReallocation(false)) {
+            fail("decoding is already started");
+        }
+    }
+
+    /**
+     * Makes decoder hand metadata blocks to {@code listener} instead of skipping them;
+     * blocks written by the encoder itself, e.g. the checksum trailer, are reported too.
+     *
+     * @param listener receives blocks in stream order; {@code null} to skip them again
+     */
+    public void setMetadataListener(MetadataListener listener) {
+        decoder.setMetadataCapture(listener != null);
+        this.metadataListener = listener;
+    }
+
     /**
      * Continue decoding.
      *
@@ -83,6 +241,9 @@ public class Decoder {
      */
     int decode() throws IOException {
         while (true) {
+            if (decoder.hasMetadata()) {
+                decoder.takeMetadata(metadataListener);
+            }
             if (buffer != null) {
                 if (!buffer.hasRemaining()) {
                     buffer = null;
@@ -105,9 +266,13 @@ public class Decoder {
                         buffer = decoder.pull();
                         break;
                     }
+                    if (pooledInput != null) {
+                        adaptInputBuffer();
+                    }
                     ByteBuffer inputBuffer = decoder.getInputBuffer();
                     ((Buffer) inputBuffer).clear();
                     int bytesRead = source.read(inputBuffer);
+                    lastRead = bytesRead;
                     if (bytesRead == -1) {
                         fail("unexpected end of input");
                     }
@@ -129,6 +294,29 @@ public class Decoder {
         }
     }
 
+    /**
+     * Resizes adaptive read buffer according to the previous read; staged input is
+     * already consumed at this point.
+     */
+    private void adaptInputBuffer() {
+        int capacity = pooledInput.capacity();
+        int size;
+        if (lastRead == capacity && capacity < MAX_ADAPTIVE_BUFFER_SIZE) {
+            size = capacity * 2;
+        } else if (lastRead > 0 && lastRead < capacity / 4 && capacity > MIN_ADAPTIVE_BUFFER_SIZE) {
+            size = capacity / 2;
+        } else {
+            return;
+        }
+        ByteBuffer resized = DirectBufferPool.acquire(size);
+        if (!decoder.setInputBuffer(resized)) {
+            DirectBufferPool.release(resized);
+            return;
+        }
+        DirectBufferPool.release(pooledInput);
+        pooledInput = resized;
+    }
+
     void discard(int length) {
         ((Buffer) buffer).position(buffer.position() + length);
         if (!buffer.hasRemaining()) {
@@ -151,58 +339,344 @@ public class Decoder {
         }
         closed = true;
         decoder.destroy();
+        if (pooledInput != null) {
+            DirectBufferPool.release(pooledInput);
+            pooledInput = null;
+        }
         source.close();
     }
 
+    /**
+     * Opens a file written by {@code BrotliSeekableOutputStream} for random access.
+     * <p>
+     * Index is read from the end of the file; the returned object owns {@code channel}.
+     *
+     * @throws IOException if the file has no valid index
+     */
+    public static BrotliSeekableFile openSeekable(FileChannel channel) throws IOException {
+        return new BrotliSeekableFile(channel);
+    }
+
+    /**
+     * Decodes a file written by {@code BrotliSeekableOutputStream} using up to
+     * {@code threads} threads.
+     * <p>
+     * Chunk boundaries are taken from the index; every chunk is decoded by its own
+     * native decoder straight into its place of the result. {@code channel} is
+     * left open.
+     *
+     * @throws IOException if the file has no valid index or is corrupted
+     */
+    public static byte[] decompressParallel(FileChannel channel, int threads) throws IOException {
+        return new BrotliSeekableFile(channel).decodeAll(threads);
+    }
+
+    /**
+     * Decodes file {@code input} to file {@code output} in native code.
+     * <p>
+     * Input is memory-mapped and output is written as it is produced, so neither passes
+     * through the Java heap. Input MUST be a single complete stream; large window streams
+     * are accepted.
+     *
+     * @param input  compressed file; MUST NOT change while being decoded
+     * @param output decompressed file; created or truncated
+     * @return size of the decompressed file
+     * @throws IOException if files can not be accessed, or input is corrupted
+     */
+    public static long decompressFile(Path input, Path output) throws IOException {
+        DecoderJNI.Wrapper decoder = new DecoderJNI.Wrapper(1);
+        try {
+            if (!decoder.setLargeWindow(true)) {
+                throw new IOException("failed to initialize native brotli decoder");
+            }
+            return decoder.decompressFile(input.toString(), output.toString());
+        } finally {
+            decoder.destroy();
+        }
+    }
+
     /**
      * Decodes the given data buffer.
      */
     public static DirectDecompress decompress(byte[] data) throws IOException {
-        DecoderJNI.Wrapper decoder = new DecoderJNI.Wrapper(data.length);
+        /* Input is read straight from data, so input buffer size does not matter. */
+        boolean pooled = data.length <= DecoderPool.BUFFER_SIZE;
+        DecoderJNI.Wrapper decoder = pooled ? DecoderPool.acquire() : new DecoderJNI.Wrapper(DecoderPool.BUFFER_SIZE);
+        try {
+            return decodeAll(decoder, data);
+        } finally {
+            if (pooled) {
+                DecoderPool.release(decoder);
+            } else {
+                decoder.destroy();
+            }
+        }
+    }
+
+    /**
+     * Decodes data produced by {@code Encoder.compressDelta} against the same reference.
+     *
+     * @param data      compressed delta
+     * @param reference previous version; MUST be direct; the whole capacity is used
+     */
+    public static DirectDecompress decompressDelta(byte[] data, ByteBuffer reference) throws IOException {
+        DecoderJNI.Wrapper decoder = new DecoderJNI.Wrapper(DecoderPool.BUFFER_SIZE);
+        try {
+            if (!decoder.attachDictionary(reference)) {
+                throw new IOException("failed to attach reference");
+            }
+            return decodeAll(decoder, data);
+        } finally {
+            decoder.destroy();
+        }
+    }
+
+    /**
+     * Decodes a delta against a previous version stored in a file.
+     * <p>
+     * The file is memory-mapped, not read; it MUST NOT change while being decoded.
+     */
+    public static DirectDecompress decompressDelta(byte[] data, Path reference) throws IOException {
+        try (FileChannel channel = FileChannel.open(reference, StandardOpenOption.READ)) {
+            return decompressDelta(data, channel.map(FileChannel.MapMode.READ_ONLY, 0, channel.size()));
+        }
+    }
+
+    /**
+     * Feeds the whole stream to a fresh decoder and collects the output.
+     * <p>
+     * If the stream declares its size, output goes straight into a single array of that
+     * size; otherwise chunks are gathered and joined at the end.
+     */
+    private static DirectDecompress decodeAll(DecoderJNI.Wrapper decoder, byte[] data) throws IOException {
         ArrayList<byte[]> output = new ArrayList<>();
+        byte[] exact = null;
+        boolean sizeChecked = false;
         int totalOutputSize = 0;
+        int offset = decoder.push(data, 0, data.length);
+        while (decoder.getStatus() != DecoderJNI.Status.DONE) {
+            switch (decoder.getStatus()) {
+                case OK:
+                    offset += decoder.push(data, offset, data.length - offset);
+                    break;
+
+                case NEEDS_MORE_OUTPUT:
+                    if (!sizeChecked) {
+                        // Size metadata precedes any output.
+                        sizeChecked = true;
+                        long declared = decoder.getDeclaredSize();
+                        if (declared >= 0 && declared <= MAX_ARRAY_SIZE) {
+                            exact = new byte[(int) declared];
+                        }
+                    }
+                    ByteBuffer buffer = decoder.pull();
+                    if (exact != null) {
+                        if (buffer.remaining() > exact.length - totalOutputSize) {
+                            return new DirectDecompress(DecoderJNI.Status.ERROR, null);
+                        }
+                        int length = buffer.remaining();
+                        buffer.get(exact, totalOutputSize, length);
+                        totalOutputSize += length;
+                        break;
+                    }
+                    byte[] chunk = new byte[buffer.remaining()];
+                    buffer.get(chunk);
+                    output.add(chunk);
+                    totalOutputSize += chunk.length;
+                    break;
+
+                case NEEDS_MORE_INPUT:
+                    // Give decoder a chance to process the rest of input.
+                    offset += decoder.push(data, offset, data.length - offset);
+                    // If decoder still needs input, this means that stream is truncated.
+                    if (decoder.getStatus() == DecoderJNI.Status.NEEDS_MORE_INPUT) {
+                        return new DirectDecompress(decoder.getStatus(), null);
+                    }
+                    break;
+
+                default:
+                    return new DirectDecompress(decoder.getStatus(), null);
+            }
+        }
+        if (offset != data.length) {
+            // Bytes after stream end are not allowed.
+            return new DirectDecompress(DecoderJNI.Status.ERROR, null);
+        }
+        if (exact != null) {
+            // Declared size is not verified by decoder.
+            if (totalOutputSize != exact.length) {
+                return new DirectDecompress(DecoderJNI.Status.ERROR, null);
+            }
+            return new DirectDecompress(DecoderJNI.Status.DONE, exact);
+        }
+        if (output.size() == 1) {
+            return new DirectDecompress(DecoderJNI.Status.DONE, output.get(0));
+        }
+        byte[] result = new byte[totalOutputSize];
+        int resultOffset = 0;
+        for (byte[] chunk : output) {
+            System.arraycopy(chunk, 0, result, resultOffset, chunk.length);
+            resultOffset += chunk.length;
+        }
+        return new DirectDecompress(DecoderJNI.Status.DONE, result);
+    }
+
+    /**
+     * Decodes the given data buffer straight into the remaining space of {@code output}.
+     * <p>
+     * No intermediate output chunks are created. Position of {@code output} is advanced
+     * by the number of decoded bytes.
+     *
+     * @param data   compressed data
+     * @param output destination of decoded data; direct or array-backed
+     * @return number of decoded bytes
+     * @throws IOException if data is corrupted or truncated, or {@code output} is too small
+     */
+    public static int decompress(byte[] data, ByteBuffer output) throws IOException {
+        if (output.isDirect()) {
+            return decompressInto(data, output, null, 0, 0);
+        }
+        if (!output.hasArray()) {
+            throw new IllegalArgumentException("output buffer must be direct or array-backed");
+        }
+        int written = decompressInto(data, null, output.array(), output.arrayOffset() + output.position(),
+                output.remaining());
+        ((Buffer) output).position(output.position() + written);
+        return written;
+    }
+
+    /**
+     * Decodes the given data buffer straight into {@code output[offset, offset + length)}.
+     *
+     * @return number of decoded bytes
+     * @throws IOException if data is corrupted or truncated, or output region is too small
+     */
+    public static int decompress(byte[] data, byte[] output, int offset, int length) throws IOException {
+        if (offset < 0 || length < 0 || offset > output.length - length) {
+            throw new IndexOutOfBoundsException("invalid output region");
+        }
+        return decompressInto(data, null, output, offset, length);
+    }
+
+    /**
+     * Decodes at most {@code maxOutput} first bytes of the stream, e.g. to sniff content.
+     * <p>
+     * Decoding stops as soon as that much output is produced: the rest of meta-blocks is
+     * neither decoded nor validated, and output grows on demand up to the limit, which
+     * makes it a cheap hard cap against decompression bombs. {@code data} may be only the
+     * beginning of a stream.
+     *
+     * @param data      compressed data, or its prefix
+     * @param maxOutput maximal number of bytes to decode
+     * @return decoded bytes; fewer than {@code maxOutput} only if data ends earlier
+     * @throws IOException if the decoded part of data is corrupted
+     */
+    public static byte[] decompressPrefix(byte[] data, int maxOutput) throws IOException {
+        if (maxOutput < 0) {
+            throw new IllegalArgumentException("negative output limit");
+        }
+        boolean pooled = data.length <= DecoderPool.BUFFER_SIZE;
+        DecoderJNI.Wrapper decoder = pooled ? DecoderPool.acquire() : new DecoderJNI.Wrapper(data.length);
+        byte[] output = new byte[Math.min(maxOutput, PREFIX_CHUNK_SIZE)];
+        int written = 0;
         try {
             decoder.getInputBuffer().put(data);
-            decoder.push(data.length);
-            while (decoder.getStatus() != DecoderJNI.Status.DONE) {
+            int inputLength = data.length;
+            while (written < maxOutput) {
+                if (written == output.length) {
+                    output = Arrays.copyOf(output, (int) Math.min(maxOutput, 2L * output.length));
+                }
+                written += decoder.decompressInto(inputLength, output, written, output.length - written);
+                inputLength = 0;
+                DecoderJNI.Status status = decoder.getStatus();
+                if (status == DecoderJNI.Status.DONE || status == DecoderJNI.Status.NEEDS_MORE_INPUT) {
+                    break;
+                } else if (status == DecoderJNI.Status.ERROR) {
+                    throw new IOException("corrupted input");
+                }
+            }
+        } finally {
+            if (pooled) {
+                DecoderPool.release(decoder);
+            } else {
+                decoder.destroy();
+            }
+        }
+        return (written == output.length) ? output : Arrays.copyOf(output, written);
+    }
+
+    /**
+     * Decodes many independent streams into one output buffer in a single native call.
+     * <p>
+     * Slices are decoded in order by one pooled decoder, directly from {@code input} into
+     * the remaining part of {@code output}. Each slice gets its own status:
+     * {@link DecoderJNI.Status#DONE} on success, {@link DecoderJNI.Status#NEEDS_MORE_INPUT}
+     * if it is truncated, or {@link DecoderJNI.Status#ERROR}; output of failed slices is
+     * dropped. If output space runs out, the rest of slices is left untouched and may be
+     * decoded by another call.
+     *
+     * @param input    compressed data; MUST be direct
+     * @param slices   {offset, length} pairs of absolute {@code input} indices
+     * @param output   destination of decoded data; MUST be direct; its position is
+     *                 advanced past the written data
+     * @param offsets  receives absolute {@code output} index of each item start, followed
+     *                 by the end of the last item; MUST have at least
+     *                 {@code slices.length / 2 + 1} elements
+     * @param statuses receives status of each processed slice
+     * @return number of processed slices
+     * @throws IOException if decoder fails
+     */
+    public static int decompressBatch(ByteBuffer input, int[] slices, ByteBuffer output, int[] offsets,
+                                      DecoderJNI.Status[] statuses) throws IOException {
+        if (slices.length % 2 != 0) {
+            throw new IllegalArgumentException("slices must be (offset, length) pairs");
+        }
+        DecoderJNI.Wrapper decoder = DecoderPool.acquire();
+        try {
+            return decoder.decompressBatch(input, slices, slices.length / 2, output, offsets, statuses);
+        } finally {
+            DecoderPool.release(decoder);
+        }
+    }
+
+    private static int decompressInto(byte[] data, ByteBuffer directOutput, byte[] arrayOutput,
+                                      int offset, int length) throws IOException {
+        boolean pooled = data.length <= DecoderPool.BUFFER_SIZE;
+        DecoderJNI.Wrapper decoder = pooled ? DecoderPool.acquire() : new DecoderJNI.Wrapper(data.length);
+        int written = 0;
+        try {
+            decoder.getInputBuffer().put(data);
+            int inputLength = data.length;
+            while (true) {
+                written += (directOutput != null)
+                        ? decoder.decompressInto(inputLength, directOutput)
+                        : decoder.decompressInto(inputLength, arrayOutput, offset + written, length - written);
+                inputLength = 0;
                 switch (decoder.getStatus()) {
-                    case OK:
-                        decoder.push(0);
-                        break;
+                    case DONE:
+                        return written;
 
                     case NEEDS_MORE_OUTPUT:
-                        ByteBuffer buffer = decoder.pull();
-                        byte[] chunk = new byte[buffer.remaining()];
-                        buffer.get(chunk);
-                        output.add(chunk);
-                        totalOutputSize += chunk.length;
+                    case OK:
+                        boolean full = (directOutput != null) ? !directOutput.hasRemaining() : written == length;
+                        if (full) {
+                            throw new IOException("output buffer is too small");
+                        }
                         break;
 
                     case NEEDS_MORE_INPUT:
-                        // Give decoder a chance to process the remaining of the buffered byte.
-                        decoder.push(0);
-                        // If decoder still needs input, this means that stream is truncated.
-                        if (decoder.getStatus() == DecoderJNI.Status.NEEDS_MORE_INPUT) {
-                            return new DirectDecompress(decoder.getStatus(), null);
-                        }
-                        break;
+                        throw new IOException("unexpected end of input");
 
                     default:
-                        return new DirectDecompress(decoder.getStatus(), null);
+                        throw new IOException("corrupted input");
                 }
             }
         } finally {
-            decoder.destroy();
-        }
-        if (output.size() == 1) {
-            return new DirectDecompress(decoder.getStatus(), output.get(0));
-        }
-        byte[] result = new byte[totalOutputSize];
-        int offset = 0;
-        for (byte[] chunk : output) {
-            System.arraycopy(chunk, 0, result, offset, chunk.length);
-            offset += chunk.length;
+            if (pooled) {
+                DecoderPool.release(decoder);
+            } else {
+                decoder.destroy();
+            }
         }
-        return new DirectDecompress(decoder.getStatus(), result);
     }
 }
@@ -0,0 +1,86 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.decoder;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Dictionary parsed once and shared by any number of decoders.
+ * <p>
+ * {@link BrotliInputStream#attachDictionary(ByteBuffer)} parses the dictionary for
+ * every stream; decoders given a {@code DecoderDictionary} only reference the
+ * already parsed form, which matters when many small payloads are decoded with a
+ * serialized dictionary. Decoders keep the native side alive while they use it, so
+ * this object may be collected at any time.
+ */
+public final class DecoderDictionary {
+    /* BrotliSharedDictionaryType */
+    private static final int RAW_DICTIONARY_TYPE = 0;
+    private static final int SERIALIZED_DICTIONARY_TYPE = 1;
+
+    private final long handle;
+
+    private DecoderDictionary(long handle) {
+        this.handle = handle;
+    }
+
+    /**
+     * Prepares raw (LZ77) dictionary.
+     *
+     * @param dictionary dictionary data; MUST be direct and MUST NOT be modified afterwards
+     */
+    public static DecoderDictionary prepare(ByteBuffer dictionary) {
+        return prepare(dictionary, RAW_DICTIONARY_TYPE);
+    }
+
+    /**
+     * Prepares dictionary in shared dictionary format.
+     *
+     * @param dictionary dictionary data; MUST be direct and MUST NOT be modified afterwards
+     */
+    public static DecoderDictionary prepareSerialized(ByteBuffer dictionary) {
+        return prepare(dictionary, SERIALIZED_DICTIONARY_TYPE);
+    }
+
+    private static DecoderDictionary prepare(ByteBuffer dictionary, int sharedDictionaryType) {
+        if (!dictionary.isDirect()) {
+            throw new IllegalArgumentException("only direct buffers allowed");
+        }
+        long handle = DecoderJNI.prepareDictionary(dictionary, sharedDictionaryType);
+        if (handle == 0) {
+            throw new IllegalArgumentException("invalid dictionary");
+        }
+        return new DecoderDictionary(handle);
+    }
+
+    long getHandle() {
+        return handle;
+    }
+
+    @Override
+    protected void finalize() throws Throwable {
+        try {
+            // Waits for attachments in progress, see DecoderJNI.Wrapper#attachDictionary.
+            synchronized (this) {
+                DecoderJNI.releaseDictionary(handle);
+            }
+        } finally {
+            super.finalize();
+        }
+    }
+}
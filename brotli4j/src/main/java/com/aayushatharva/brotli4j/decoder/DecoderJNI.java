@@ -22,8 +22,12 @@
 */
 package com.aayushatharva.brotli4j.decoder;
 
+import com.aayushatharva.brotli4j.common.MemoryStats;
+
 import java.io.IOException;
+import java.nio.Buffer;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 /**
  * JNI wrapper for brotli decoder.
@@ -31,13 +35,71 @@ import java.nio.ByteBuffer;
 public class DecoderJNI {
     private static native ByteBuffer nativeCreate(long[] context);
 
-    private static native void nativePush(long[] context, int length);
+    private static native int nativePush(long handle, int length);
+
+    private static native long nativePushArray(long handle, byte[] data, int offset, int length);
+
+    private static native long nativePull(long handle);
+
+    private static native ByteBuffer nativeGetOutputBuffer(long handle);
+
+    private static native void nativeDestroy(long handle);
+
+    private static native boolean nativeAttachDictionary(long handle, ByteBuffer dictionary);
+
+    private static native long nativePrepareDictionary(ByteBuffer dictionary, long type);
+
+    private static native void nativeReleaseDictionary(long dictionary);
+
+    private static native boolean nativeAttachPreparedDictionary(long handle, long dictionary);
+
+    private static native boolean nativeReset(long handle);
+
+    private static native boolean nativeSetInputBuffer(long handle, ByteBuffer buffer);
+
+    private static native boolean nativeSetStreamOffset(long handle, long streamOffset);
+
+    private static native boolean nativeSetParameter(long handle, int parameter, int value);
+
+    private static native void nativeGetMemoryStats(long handle, long[] stats);
 
-    private static native ByteBuffer nativePull(long[] context);
+    private static native void nativeGetStats(long handle, long[] stats);
 
-    private static native void nativeDestroy(long[] context);
+    private static native int nativeGetChecksum(long handle);
 
-    private static native boolean nativeAttachDictionary(long[] context, ByteBuffer dictionary);
+    private static native long nativeGetDeclaredSize(long handle);
+
+    private static native void nativeSetMetadataCapture(long handle, boolean enabled);
+
+    private static native byte[] nativeTakeMetadata(long handle);
+
+    private static native long nativeDecompressInto(long handle, int inputLength,
+                                                    ByteBuffer output, int outputOffset, int outputLength);
+
+    private static native long nativeDecompressIntoArray(long handle, int inputLength,
+                                                         byte[] output, int outputOffset, int outputLength);
+
+    private static native int nativeDecompressDirect(long handle, ByteBuffer input, ByteBuffer output,
+                                                     int[] regions);
+
+    private static native int nativeDecompressBatch(long handle, ByteBuffer input, int[] slices, int count,
+                                                    ByteBuffer output, int outputOffset, int outputLength,
+                                                    int[] offsets, int[] statuses);
+
+    private static native long nativeDecompressFile(long handle, String input, String output);
+
+    /**
+     * Parses dictionary natively; the result is referenced by {@link DecoderDictionary}.
+     *
+     * @return native handle; 0 if dictionary is not valid
+     */
+    static long prepareDictionary(ByteBuffer dictionary, int sharedDictionaryType) {
+        return nativePrepareDictionary(dictionary, sharedDictionaryType);
+    }
+
+    static void releaseDictionary(long dictionary) {
+        nativeReleaseDictionary(dictionary);
+    }
 
     public enum Status {
         ERROR,
@@ -48,15 +110,53 @@ public class DecoderJNI {
     }
 
     public static class Wrapper {
-        private final long[] context = new long[3];
-        private final ByteBuffer inputBuffer;
+        /* Flags or-ed to status code; see decoder_jni.cc */
+        private static final int HAS_MORE_OUTPUT = 8;
+        private static final int HAS_METADATA = 16;
+
+        /* Position and length preceding data of each metadata record. */
+        private static final int METADATA_HEADER_SIZE = 12;
+
+        /* BrotliDecoderParameter values; see decode.h */
+        private static final int PARAM_DISABLE_RING_BUFFER_REALLOCATION = 0;
+        private static final int PARAM_LARGE_WINDOW = 1;
+        private static final int PARAM_LOW_MEMORY = 4;
+        private static final int PARAM_COLLECT_STATS = 5;
+        private static final int PARAM_CHECKSUM = 6;
+
+        private long handle;
+        private final ByteBuffer ownInputBuffer;
+        private ByteBuffer inputBuffer;
+        private final ByteBuffer outputBuffer;
+        private final int inputBufferSize;
         private Status lastStatus = Status.NEEDS_MORE_INPUT;
+        private boolean hasOutput;
+        private boolean hasMetadata;
         private boolean fresh = true;
 
         public Wrapper(int inputBufferSize) throws IOException {
-            this.context[1] = inputBufferSize;
-            this.inputBuffer = nativeCreate(this.context);
-            if (this.context[0] == 0) {
+            this(inputBufferSize, false);
+        }
+
+        /**
+         * @param inputBufferSize size of direct input buffer
+         * @param pooledAllocator take native decoder memory from per-thread caches of
+         *                        size-classed blocks instead of malloc
+         */
+        public Wrapper(int inputBufferSize, boolean pooledAllocator) throws IOException {
+            this.inputBufferSize = inputBufferSize;
+            long[] context = new long[4];
+            context[1] = inputBufferSize;
+            context[3] = pooledAllocator ? 1 : 0;
+            this.ownInputBuffer = nativeCreate(context);
+            this.inputBuffer = ownInputBuffer;
+            if (context[0] == 0) {
+                throw new IOException("failed to initialize native brotli decoder");
+            }
+            this.handle = context[0];
+            this.outputBuffer = nativeGetOutputBuffer(handle);
+            if (this.outputBuffer == null) {
+                destroy();
                 throw new IOException("failed to initialize native brotli decoder");
             }
         }
@@ -65,20 +165,39 @@ public class DecoderJNI {
             if (!dictionary.isDirect()) {
                 throw new IllegalArgumentException("only direct buffers allowed");
             }
-            if (context[0] == 0) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("decoding is already started");
+            }
+            return nativeAttachDictionary(handle, dictionary);
+        }
+
+        /**
+         * Makes decoder use already parsed dictionary; nothing else can be attached then.
+         *
+         * @return false if a dictionary is already attached
+         */
+        public boolean attachDictionary(DecoderDictionary dictionary) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli decoder is already destroyed");
             }
             if (!fresh) {
                 throw new IllegalStateException("decoding is already started");
             }
-            return nativeAttachDictionary(context, dictionary);
+            // Holding the lock keeps the dictionary reachable until the decoder takes its
+            // reference, as the finalizer synchronizes on it as well.
+            synchronized (dictionary) {
+                return nativeAttachPreparedDictionary(handle, dictionary.getHandle());
+            }
         }
 
         public void push(int length) {
             if (length < 0) {
                 throw new IllegalArgumentException("negative block length");
             }
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli decoder is already destroyed");
             }
             if (lastStatus != Status.NEEDS_MORE_INPUT && lastStatus != Status.OK) {
@@ -88,12 +207,37 @@ public class DecoderJNI {
                 throw new IllegalStateException("pushing input to decoder in OK state");
             }
             fresh = false;
-            nativePush(context, length);
-            parseStatus();
+            parseStatus(nativePush(handle, length));
+        }
+
+        /**
+         * Pushes data straight from a heap array, without staging it in the input buffer.
+         * <p>
+         * Only a bounded window of the array is consumed per invocation; the rest of
+         * the data MUST be pushed again (after pulling the output, if any).
+         *
+         * @return number of consumed bytes
+         */
+        public int push(byte[] data, int offset, int length) {
+            if (offset < 0 || length < 0 || offset > data.length - length) {
+                throw new IndexOutOfBoundsException("invalid input region");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (lastStatus != Status.NEEDS_MORE_INPUT && lastStatus != Status.OK) {
+                throw new IllegalStateException("pushing input to decoder in " + lastStatus + " state");
+            }
+            fresh = false;
+            long result = nativePushArray(handle, data, offset, length);
+            parseStatus((int) result);
+            return (int) (result >>> 32);
         }
 
-        private void parseStatus() {
-            long status = context[1];
+        private void parseStatus(int packed) {
+            hasOutput = (packed & HAS_MORE_OUTPUT) != 0;
+            hasMetadata = (packed & HAS_METADATA) != 0;
+            int status = packed & ~(HAS_MORE_OUTPUT | HAS_METADATA);
             if (status == 1) {
                 lastStatus = Status.DONE;
             } else if (status == 2) {
@@ -116,36 +260,409 @@ public class DecoderJNI {
         }
 
         public boolean hasOutput() {
-            return context[2] != 0;
+            return hasOutput;
+        }
+
+        /**
+         * Returns {@code true} if metadata blocks kept with {@link #setMetadataCapture(boolean)}
+         * are waiting for {@link #takeMetadata(Decoder.MetadataListener)}.
+         */
+        public boolean hasMetadata() {
+            return hasMetadata;
         }
 
+        /**
+         * Makes decoder keep metadata blocks instead of skipping them; kept over resets.
+         */
+        public void setMetadataCapture(boolean enabled) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            nativeSetMetadataCapture(handle, enabled);
+            if (!enabled) {
+                hasMetadata = false;
+            }
+        }
+
+        /**
+         * Hands metadata blocks decoded since the previous invocation to {@code listener},
+         * in stream order.
+         */
+        public void takeMetadata(Decoder.MetadataListener listener) throws IOException {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            hasMetadata = false;
+            byte[] records = nativeTakeMetadata(handle);
+            if (records == null) {
+                throw new IOException("failed to keep metadata");
+            }
+            ByteBuffer view = ByteBuffer.wrap(records).order(ByteOrder.LITTLE_ENDIAN);
+            while (view.remaining() >= METADATA_HEADER_SIZE) {
+                long position = view.getLong();
+                byte[] data = new byte[view.getInt()];
+                view.get(data);
+                listener.onMetadata(position, data);
+            }
+        }
+
+        /**
+         * Pulls the next piece of output.
+         * <p>
+         * The same buffer is returned by every invocation; all the produced data
+         * MUST be consumed before pulling again.
+         */
         public ByteBuffer pull() {
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli decoder is already destroyed");
             }
             if (lastStatus != Status.NEEDS_MORE_OUTPUT && !hasOutput()) {
                 throw new IllegalStateException("pulling output from decoder in " + lastStatus + " state");
             }
             fresh = false;
-            ByteBuffer result = nativePull(context);
-            parseStatus();
+            long result = nativePull(handle);
+            parseStatus((int) result);
+            ((Buffer) outputBuffer).clear();
+            ((Buffer) outputBuffer).limit((int) (result >>> 32));
+            return outputBuffer;
+        }
+
+        /**
+         * Decodes directly into the remaining space of {@code output}.
+         * <p>
+         * Unlike {@link #push(int)} / {@link #pull()}, decoded data is written straight
+         * into caller memory; status becomes {@link Status#NEEDS_MORE_OUTPUT} when
+         * {@code output} is filled before the input is exhausted.
+         *
+         * @param inputLength number of bytes put into input buffer; 0 to continue with previous input
+         * @param output      destination; MUST be direct; position is advanced
+         * @return number of bytes written
+         */
+        public int decompressInto(int inputLength, ByteBuffer output) {
+            if (!output.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            checkDecompressInto(inputLength);
+            long result = nativeDecompressInto(handle, inputLength, output, output.position(), output.remaining());
+            if (result < 0) {
+                throw new IllegalArgumentException("output buffer is not accessible");
+            }
+            parseStatus((int) result);
+            int written = (int) (result >>> 32);
+            ((Buffer) output).position(output.position() + written);
+            return written;
+        }
+
+        /**
+         * Decodes directly into {@code output[offset, offset + length)}.
+         *
+         * @param inputLength number of bytes put into input buffer; 0 to continue with previous input
+         * @return number of bytes written
+         * @see #decompressInto(int, ByteBuffer)
+         */
+        public int decompressInto(int inputLength, byte[] output, int offset, int length) {
+            if (offset < 0 || length < 0 || offset > output.length - length) {
+                throw new IndexOutOfBoundsException("invalid output region");
+            }
+            checkDecompressInto(inputLength);
+            long result = nativeDecompressIntoArray(handle, inputLength, output, offset, length);
+            if (result < 0) {
+                throw new IllegalStateException("failed to access output array");
+            }
+            parseStatus((int) result);
+            return (int) (result >>> 32);
+        }
+
+        /**
+         * Decodes from the remaining part of {@code input} directly into the remaining
+         * space of {@code output}.
+         * <p>
+         * Neither side is staged: compressed data is read from, and decoded data is
+         * written to, caller memory. Data pushed to {@link #getInputBuffer()} MUST be
+         * consumed before. Both positions are advanced.
+         *
+         * @param input  compressed data; MUST be direct
+         * @param output destination; MUST be direct
+         * @return number of bytes written
+         */
+        public int decompress(ByteBuffer input, ByteBuffer output) {
+            if (!input.isDirect() || !output.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            checkDecompressInto(0);
+            int[] regions = {input.position(), input.limit(), output.position(), output.limit()};
+            parseStatus(nativeDecompressDirect(handle, input, output, regions));
+            int written = regions[2] - output.position();
+            ((Buffer) input).position(regions[0]);
+            ((Buffer) output).position(regions[2]);
+            return written;
+        }
+
+        /**
+         * Decodes each of {@code count} compressed slices as a separate stream.
+         * <p>
+         * Decoder is reset before every slice. Decoded items are written one after
+         * another to the remaining part of {@code output}, until one does not fit;
+         * output of slices that fail to decode is dropped. Both buffers MUST be direct;
+         * {@code output} position is advanced past the written data.
+         *
+         * @param slices   {offset, length} pairs of absolute {@code input} indices
+         * @param offsets  receives absolute {@code output} index of each item start,
+         *                 followed by the end of the last item
+         * @param statuses receives status of each processed slice
+         * @return number of processed slices
+         */
+        public int decompressBatch(ByteBuffer input, int[] slices, int count, ByteBuffer output,
+                                   int[] offsets, Status[] statuses) throws IOException {
+            if (!input.isDirect() || !output.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            if (count < 0 || count > slices.length / 2 || count >= offsets.length || count > statuses.length) {
+                throw new IndexOutOfBoundsException("invalid slice count");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            fresh = false;
+            int[] codes = new int[count];
+            int done = nativeDecompressBatch(handle, input, slices, count,
+                    output, output.position(), output.remaining(), offsets, codes);
+            if (done < 0) {
+                throw new IOException("decoding failed");
+            }
+            Status[] values = Status.values();
+            for (int i = 0; i < done; i++) {
+                statuses[i] = values[codes[i]];
+            }
+            ((Buffer) output).position(offsets[done]);
+            return done;
+        }
+
+        /**
+         * Decodes file {@code input}, a single complete stream, to file {@code output}
+         * natively; data does not pass through Java. Decoder MUST be fresh; it has to be
+         * reset before it is used again.
+         *
+         * @return decompressed size
+         */
+        public long decompressFile(String input, String output) throws IOException {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("decoding is already started");
+            }
+            fresh = false;
+            long result = nativeDecompressFile(handle, input, output);
+            if (result == -1) {
+                lastStatus = Status.ERROR;
+                throw new IOException("failed to read " + input + " or write " + output);
+            } else if (result < 0) {
+                lastStatus = Status.ERROR;
+                throw new IOException("corrupted input");
+            }
+            lastStatus = Status.DONE;
             return result;
         }
 
+        private void checkDecompressInto(int inputLength) {
+            if (inputLength < 0) {
+                throw new IllegalArgumentException("negative block length");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (lastStatus == Status.ERROR || lastStatus == Status.DONE) {
+                throw new IllegalStateException("decoding in " + lastStatus + " state");
+            }
+            if (lastStatus != Status.NEEDS_MORE_INPUT && inputLength != 0) {
+                throw new IllegalStateException("pushing input to decoder in " + lastStatus + " state");
+            }
+            fresh = false;
+        }
+
+        /**
+         * Prepares decoder for a new stream; native allocations are retained.
+         *
+         * @return {@code false} if decoder could not be reset and should be destroyed
+         */
+        public boolean reset() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (!nativeReset(handle)) {
+                return false;
+            }
+            hasOutput = false;
+            hasMetadata = false;
+            inputBuffer.clear();
+            lastStatus = Status.NEEDS_MORE_INPUT;
+            fresh = true;
+            return true;
+        }
+
+        /**
+         * Makes decoder stage input in {@code buffer} instead of the buffer allocated with it.
+         * <p>
+         * The buffer is referenced until replaced or the decoder is destroyed.
+         *
+         * @param buffer direct buffer; null to return to the own one
+         * @return false if staged input is not consumed yet
+         */
+        boolean setInputBuffer(ByteBuffer buffer) {
+            if (buffer != null && !buffer.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (!nativeSetInputBuffer(handle, buffer)) {
+                return false;
+            }
+            inputBuffer = (buffer != null) ? buffer : ownInputBuffer;
+            ((Buffer) inputBuffer).clear();
+            return true;
+        }
+
+        /**
+         * Makes decoder treat the next stream as a continuation after {@code streamOffset}
+         * bytes, see {@code BROTLI_DECODER_PARAM_STREAM_OFFSET}. Has to be set before
+         * decoding is started; reset clears it.
+         *
+         * @return {@code false} if decoding is already started
+         */
+        boolean setStreamOffset(long streamOffset) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (!fresh) {
+                return false;
+            }
+            return nativeSetStreamOffset(handle, streamOffset);
+        }
+
+        /**
+         * Makes decoder allocate ring buffer for the whole window at once, instead of
+         * growing it with the decoded content.
+         *
+         * @return {@code false} if decoding is already started
+         */
+        boolean setRingBufferReallocation(boolean enabled) {
+            return setParameter(PARAM_DISABLE_RING_BUFFER_REALLOCATION, enabled ? 0 : 1);
+        }
+
+        /**
+         * Accepts "Large Window Brotli" streams, with windows of up to 1 GiB.
+         *
+         * @return {@code false} if decoding is already started
+         */
+        boolean setLargeWindow(boolean enabled) {
+            return setParameter(PARAM_LARGE_WINDOW, enabled ? 1 : 0);
+        }
+
+        /**
+         * Makes decoder free prefix code tables after each metablock and everything
+         * but the Huffman table cache on reset, instead of retaining them for reuse.
+         *
+         * @return {@code false} if decoding is already started
+         */
+        boolean setLowMemory(boolean enabled) {
+            return setParameter(PARAM_LOW_MEMORY, enabled ? 1 : 0);
+        }
+
+        /**
+         * Makes decoder count its work, see {@link #getStats()}; kept over resets.
+         *
+         * @return {@code false} if decoding is already started
+         */
+        boolean setCollectStats(boolean enabled) {
+            return setParameter(PARAM_COLLECT_STATS, enabled ? 1 : 0);
+        }
+
+        /**
+         * Makes decoder compute CRC-32C of its output and verify it against the trailer
+         * written by encoder, see {@link #getChecksum()}; kept over resets.
+         *
+         * @return {@code false} if decoding is already started
+         */
+        boolean setChecksum(boolean enabled) {
+            return setParameter(PARAM_CHECKSUM, enabled ? 1 : 0);
+        }
+
+        private boolean setParameter(int parameter, int value) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            if (!fresh) {
+                return false;
+            }
+            return nativeSetParameter(handle, parameter, value);
+        }
+
+        int getInputBufferSize() {
+            return inputBufferSize;
+        }
+
+        /**
+         * Returns memory used by native decoder state.
+         */
+        public MemoryStats getMemoryStats() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            long[] stats = new long[3];
+            nativeGetMemoryStats(handle, stats);
+            return new MemoryStats(stats[0], stats[1], stats[2]);
+        }
+
+        /**
+         * Returns work counters of the current stream; zeroes unless collection is enabled.
+         */
+        public DecoderStats getStats() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            long[] stats = new long[7];
+            nativeGetStats(handle, stats);
+            return new DecoderStats(stats[0], stats[1], stats[2], stats[3], stats[4], stats[5], stats[6]);
+        }
+
+        /**
+         * Returns CRC-32C of output produced so far; 0 unless checksum is enabled.
+         */
+        int getChecksum() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            return nativeGetChecksum(handle);
+        }
+
+        /**
+         * Returns uncompressed size the stream starts with, see
+         * {@link com.aayushatharva.brotli4j.encoder.Encoder.Parameter#DECLARE_SIZE};
+         * -1 if it is not declared, or not read yet. The value is not verified.
+         */
+        long getDeclaredSize() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli decoder is already destroyed");
+            }
+            return nativeGetDeclaredSize(handle);
+        }
+
         /**
          * Releases native resources.
          */
         public void destroy() {
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli decoder is already destroyed");
             }
-            nativeDestroy(context);
-            context[0] = 0;
+            nativeDestroy(handle);
+            handle = 0;
         }
 
         @Override
         protected void finalize() throws Throwable {
-            if (context[0] != 0) {
+            if (handle != 0) {
                 /* TODO: log resource leak? */
                 destroy();
             }
@@ -0,0 +1,66 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.decoder;
+
+import java.io.IOException;
+import java.util.ArrayDeque;
+
+/**
+ * Per-thread pool of resettable native decoders.
+ * <p>
+ * A reset decoder keeps its ring buffer and Huffman tables, so decoding a series of
+ * similar payloads does not allocate them for each payload.
+ */
+final class DecoderPool {
+    /**
+     * Input buffer size of pooled decoders; larger payloads are not pooled.
+     */
+    static final int BUFFER_SIZE = 65536;
+
+    private static final int MAX_IDLE_PER_THREAD = 4;
+
+    private static final ThreadLocal<ArrayDeque<DecoderJNI.Wrapper>> IDLE =
+            ThreadLocal.withInitial(ArrayDeque::new);
+
+    // Disallow instantiation.
+    private DecoderPool() {
+    }
+
+    /**
+     * Takes an idle decoder, or creates a new one.
+     */
+    static DecoderJNI.Wrapper acquire() throws IOException {
+        DecoderJNI.Wrapper decoder = IDLE.get().pollFirst();
+        return decoder != null ? decoder : new DecoderJNI.Wrapper(BUFFER_SIZE);
+    }
+
+    /**
+     * Resets the decoder and returns it to the pool of the current thread.
+     */
+    static void release(DecoderJNI.Wrapper decoder) {
+        if (!decoder.reset()) {
+            decoder.destroy();
+            return;
+        }
+        ArrayDeque<DecoderJNI.Wrapper> idle = IDLE.get();
+        idle.addFirst(decoder);
+        if (idle.size() > MAX_IDLE_PER_THREAD) {
+            idle.removeLast().destroy();
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.decoder;
+
+/**
+ * Snapshot of work counters of a single decoder state.
+ * <p>
+ * Counters are collected only when enabled with {@link Decoder#enableStats()}, and are
+ * taken since the start of the current stream. Tick unit is CPU-specific (time-stamp
+ * counter on x86); compare prefix code ticks between streams rather than with wall time.
+ * Streams that spend most of their time in prefix codes, or consist of many tiny
+ * meta-blocks, are the ones that cost more than their size suggests.
+ */
+public final class DecoderStats {
+    private final long metaBlocks;
+    private final long prefixCodes;
+    private final long prefixCodeTicks;
+    private final long ringBufferAllocations;
+    private final long literalBytes;
+    private final long copiedBytes;
+    private final long dictionaryReferences;
+
+    public DecoderStats(long metaBlocks, long prefixCodes, long prefixCodeTicks, long ringBufferAllocations,
+                        long literalBytes, long copiedBytes, long dictionaryReferences) {
+        this.metaBlocks = metaBlocks;
+        this.prefixCodes = prefixCodes;
+        this.prefixCodeTicks = prefixCodeTicks;
+        this.ringBufferAllocations = ringBufferAllocations;
+        this.literalBytes = literalBytes;
+        this.copiedBytes = copiedBytes;
+        this.dictionaryReferences = dictionaryReferences;
+    }
+
+    /**
+     * @return number of compressed and uncompressed meta-blocks; metadata is not counted
+     */
+    public long getMetaBlocks() {
+        return metaBlocks;
+    }
+
+    /**
+     * @return number of prefix codes read, including the ones reused from table cache
+     */
+    public long getPrefixCodes() {
+        return prefixCodes;
+    }
+
+    /**
+     * @return ticks spent in reading prefix codes and building their decoding tables
+     */
+    public long getPrefixCodeTicks() {
+        return prefixCodeTicks;
+    }
+
+    /**
+     * @return number of ring buffer allocations and reallocations; retained buffers are not counted
+     */
+    public long getRingBufferAllocations() {
+        return ringBufferAllocations;
+    }
+
+    /**
+     * @return number of bytes decoded as literals of compressed meta-blocks
+     */
+    public long getLiteralBytes() {
+        return literalBytes;
+    }
+
+    /**
+     * @return number of bytes copied by backward references
+     */
+    public long getCopiedBytes() {
+        return copiedBytes;
+    }
+
+    /**
+     * @return number of static and compound dictionary references
+     */
+    public long getDictionaryReferences() {
+        return dictionaryReferences;
+    }
+
+    @Override
+    public String toString() {
+        return "DecoderStats{metaBlocks=" + metaBlocks + ", prefixCodes=" + prefixCodes
+                + ", prefixCodeTicks=" + prefixCodeTicks + ", ringBufferAllocations=" + ringBufferAllocations
+                + ", literalBytes=" + literalBytes + ", copiedBytes=" + copiedBytes
+                + ", dictionaryReferences=" + dictionaryReferences + '}';
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.decoder;
+
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.channels.ClosedChannelException;
+import java.nio.channels.ReadableByteChannel;
+import java.util.concurrent.locks.ReentrantLock;
+
+/**
+ * ReadableByteChannel that decodes from a caller-supplied direct buffer straight
+ * into the destination buffers.
+ * <p>
+ * Unlike {@link BrotliDecoderChannel}, neither compressed nor decoded data passes
+ * through decoder owned buffers: {@code source} fills the input buffer, native
+ * decoder reads it in place and writes to the memory of {@code dst}. Consequently
+ * only direct destination buffers are accepted.
+ */
+public class DirectDecoderChannel implements ReadableByteChannel {
+    /**
+     * The default size of input buffer allocated by the channel.
+     */
+    private static final int DEFAULT_BUFFER_SIZE = 65536;
+
+    private final ReentrantLock lock = new ReentrantLock();
+    private final ReadableByteChannel source;
+    private final ByteBuffer input;
+    private final DecoderJNI.Wrapper decoder;
+    private boolean closed;
+
+    /**
+     * Creates a DirectDecoderChannel.
+     * <p>
+     * Remaining bytes of {@code input} are decoded first; afterwards the buffer is
+     * refilled from {@code source}. The buffer MUST NOT be used by the caller until
+     * the channel is closed.
+     *
+     * @param source underlying source
+     * @param input  direct buffer for compressed data
+     */
+    public DirectDecoderChannel(ReadableByteChannel source, ByteBuffer input) throws IOException {
+        if (source == null) {
+            throw new NullPointerException("source can not be null");
+        }
+        if (!input.isDirect() || input.capacity() == 0) {
+            throw new IllegalArgumentException("input buffer must be direct and not empty");
+        }
+        this.source = source;
+        this.input = input;
+        /* Input is never staged, so decoder buffer size does not matter. */
+        this.decoder = new DecoderJNI.Wrapper(1);
+    }
+
+    public DirectDecoderChannel(ReadableByteChannel source) throws IOException {
+        this(source, emptyBuffer(DEFAULT_BUFFER_SIZE));
+    }
+
+    private static ByteBuffer emptyBuffer(int capacity) {
+        ByteBuffer buffer = ByteBuffer.allocateDirect(capacity);
+        ((Buffer) buffer).limit(0);
+        return buffer;
+    }
+
+    private void fail(String message) throws IOException {
+        try {
+            close();
+        } catch (IOException ex) {
+            /* Ignore */
+        }
+        throw new IOException(message);
+    }
+
+    public void attachDictionary(ByteBuffer dictionary) throws IOException {
+        if (!decoder.attachDictionary(dictionary)) {
+            fail("failed to attach dictionary");
+        }
+    }
+
+    public void attachDictionary(DecoderDictionary dictionary) throws IOException {
+        if (!decoder.attachDictionary(dictionary)) {
+            fail("failed to attach dictionary");
+        }
+    }
+
+    @Override
+    public boolean isOpen() {
+        lock.lock();
+        try {
+            return !closed;
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    @Override
+    public void close() throws IOException {
+        lock.lock();
+        try {
+            if (closed) {
+                return;
+            }
+            closed = true;
+            decoder.destroy();
+            source.close();
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /**
+     * Decodes into the remaining space of {@code dst}.
+     *
+     * @param dst destination; MUST be direct
+     * @return number of bytes written, possibly 0 if {@code source} has no data
+     *         available, or -1 if the stream is finished
+     */
+    @Override
+    public int read(ByteBuffer dst) throws IOException {
+        if (!dst.isDirect()) {
+            throw new IllegalArgumentException("only direct buffers allowed");
+        }
+        lock.lock();
+        try {
+            if (closed) {
+                throw new ClosedChannelException();
+            }
+            int result = 0;
+            while (dst.hasRemaining()) {
+                switch (decoder.getStatus()) {
+                    case DONE:
+                        return result == 0 ? -1 : result;
+
+                    case NEEDS_MORE_INPUT:
+                        if (!input.hasRemaining()) {
+                            input.compact();
+                            int bytesRead = source.read(input);
+                            ((Buffer) input).flip();
+                            if (bytesRead == -1) {
+                                fail("unexpected end of input");
+                            }
+                            if (bytesRead == 0) {
+                                // No input data is currently available.
+                                return result;
+                            }
+                        }
+                        result += decoder.decompress(input, dst);
+                        break;
+
+                    case NEEDS_MORE_OUTPUT:
+                        result += decoder.decompress(input, dst);
+                        break;
+
+                    default:
+                        fail("corrupted input");
+                }
+            }
+            return result;
+        } finally {
+            lock.unlock();
+        }
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+/**
+ * Picks compression quality for new streams so that they fit into a CPU budget.
+ * <p>
+ * An instance is meant to be shared by all streams of one kind (for example, of one
+ * route): pass it to {@link Encoder.Parameters#setAdaptiveQuality}. Each stream takes
+ * the current quality and window when it is created and, on close, reports the time
+ * spent in the native encoder along with its input and output sizes. Once enough
+ * input is accounted, the measured cost is compared to the budget: quality goes one
+ * step down when it is exceeded, and one step up when less than half of it is used.
+ * The window follows quality between the configured bounds.
+ * <p>
+ * Instances are thread-safe.
+ */
+public final class AdaptiveQuality {
+    /* Input accounted before each decision. */
+    private static final long DEFAULT_DECISION_BYTES = 4L << 20;
+    /* Overshoot tolerated before quality goes down. */
+    private static final double HIGH_WATERMARK = 1.1;
+    /* Quality goes up only if the next one likely fits too. */
+    private static final double LOW_WATERMARK = 0.5;
+
+    private final int minQuality;
+    private final int maxQuality;
+    private final long targetNanosPerMegabyte;
+    private int minWindow = -1;
+    private int maxWindow = -1;
+    private long decisionBytes = DEFAULT_DECISION_BYTES;
+
+    private volatile int quality;
+
+    /* Measurements for the current quality since the last decision. */
+    private long inputBytes;
+    private long outputBytes;
+    private long nanos;
+
+    private volatile double lastNanosPerMegabyte;
+    private volatile double lastRatio;
+
+    /**
+     * @param minQuality             lowest quality to degrade to
+     * @param maxQuality             quality used while the budget allows
+     * @param targetNanosPerMegabyte encoding time budget per MiB of input
+     */
+    public AdaptiveQuality(int minQuality, int maxQuality, long targetNanosPerMegabyte) {
+        if (minQuality < 0 || maxQuality > 11 || minQuality > maxQuality) {
+            throw new IllegalArgumentException("quality bounds should be in range [0, 11]");
+        }
+        if (targetNanosPerMegabyte <= 0) {
+            throw new IllegalArgumentException("budget must be positive");
+        }
+        this.minQuality = minQuality;
+        this.maxQuality = maxQuality;
+        this.targetNanosPerMegabyte = targetNanosPerMegabyte;
+        this.quality = maxQuality;
+    }
+
+    /**
+     * Lets window size follow quality: {@code minWindow} is used at the lowest quality
+     * and {@code maxWindow} at the highest. By default encoder picks the window.
+     *
+     * @param minWindow log2(LZ window size) for the lowest quality
+     * @param maxWindow log2(LZ window size) for the highest quality
+     */
+    public AdaptiveQuality setWindowRange(int minWindow, int maxWindow) {
+        if (minWindow < 10 || maxWindow > 24 || minWindow > maxWindow) {
+            throw new IllegalArgumentException("window bounds should be in range [10, 24]");
+        }
+        this.minWindow = minWindow;
+        this.maxWindow = maxWindow;
+        return this;
+    }
+
+    /**
+     * @param decisionBytes amount of input to measure before quality may change
+     */
+    public AdaptiveQuality setDecisionBytes(long decisionBytes) {
+        if (decisionBytes <= 0) {
+            throw new IllegalArgumentException("decisionBytes must be positive");
+        }
+        this.decisionBytes = decisionBytes;
+        return this;
+    }
+
+    /**
+     * Returns the quality for the next stream.
+     */
+    public int getQuality() {
+        return quality;
+    }
+
+    /**
+     * Returns log2(LZ window size) for the next stream, or -1 for default.
+     */
+    public int getWindow() {
+        return windowFor(quality);
+    }
+
+    /**
+     * Returns encoding time per MiB of input measured before the last decision;
+     * 0 until the first one.
+     */
+    public double getNanosPerMegabyte() {
+        return lastNanosPerMegabyte;
+    }
+
+    /**
+     * Returns input to output size ratio measured before the last decision;
+     * 0 until the first one.
+     */
+    public double getRatio() {
+        return lastRatio;
+    }
+
+    private int windowFor(int quality) {
+        if (minWindow == -1) {
+            return -1;
+        }
+        if (maxQuality == minQuality) {
+            return maxWindow;
+        }
+        return minWindow + (maxWindow - minWindow) * (quality - minQuality) / (maxQuality - minQuality);
+    }
+
+    /**
+     * Accounts a finished stream.
+     *
+     * @param streamQuality quality the stream was encoded with; reports for other than
+     *                      the current quality are stale and ignored
+     * @param input         number of bytes fed to the encoder
+     * @param output        number of bytes produced
+     * @param elapsedNanos  time spent in the native encoder
+     */
+    synchronized void record(int streamQuality, long input, long output, long elapsedNanos) {
+        if (streamQuality != quality || input <= 0) {
+            return;
+        }
+        inputBytes += input;
+        outputBytes += output;
+        nanos += elapsedNanos;
+        if (inputBytes < decisionBytes) {
+            return;
+        }
+        double cost = (double) nanos * (1 << 20) / inputBytes;
+        lastNanosPerMegabyte = cost;
+        lastRatio = outputBytes > 0 ? (double) inputBytes / outputBytes : 0;
+        if (cost > targetNanosPerMegabyte * HIGH_WATERMARK && quality > minQuality) {
+            quality--;
+        } else if (cost < targetNanosPerMegabyte * LOW_WATERMARK && quality < maxQuality) {
+            quality++;
+        }
+        inputBytes = 0;
+        outputBytes = 0;
+        nanos = 0;
+    }
+}
@@ -28,17 +28,22 @@ import java.nio.Buffer;
 import java.nio.ByteBuffer;
 import java.nio.channels.ClosedChannelException;
 import java.nio.channels.WritableByteChannel;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.Executor;
+import java.util.concurrent.FutureTask;
+import java.util.concurrent.locks.ReentrantLock;
 
 /**
  * WritableByteChannel that wraps native brotli encoder.
+ * <p>
+ * Operations are serialized with a {@link ReentrantLock} rather than a monitor, so that
+ * virtual threads waiting for the channel do not pin their carriers.
  */
 public class BrotliEncoderChannel extends Encoder implements WritableByteChannel {
-    /**
-     * The default internal buffer size used by the decoder.
-     */
-    private static final int DEFAULT_BUFFER_SIZE = 16384;
-
-    private final Object mutex = new Object();
+    private final ReentrantLock lock = new ReentrantLock();
+    private Executor offloadExecutor;
+    private int offloadThreshold;
 
     /**
      * Creates a BrotliEncoderChannel.
@@ -52,50 +57,184 @@ public class BrotliEncoderChannel extends Encoder implements WritableByteChannel
         super(destination, params, bufferSize);
     }
 
+    /**
+     * Creates a BrotliEncoderChannel with adaptive intermediate buffer.
+     *
+     * @param destination underlying destination
+     * @param params      encoding settings
+     * @see BrotliOutputStream#BrotliOutputStream(java.io.OutputStream, Encoder.Parameters)
+     */
     public BrotliEncoderChannel(WritableByteChannel destination, Encoder.Parameters params)
             throws IOException {
-        this(destination, params, DEFAULT_BUFFER_SIZE);
+        super(destination, params);
     }
 
     public BrotliEncoderChannel(WritableByteChannel destination) throws IOException {
         this(destination, new Encoder.Parameters());
     }
 
+    private BrotliEncoderChannel(BrotliEncoderChannel original, WritableByteChannel destination)
+            throws IOException {
+        super(original, destination);
+    }
+
+    /**
+     * Flushes this channel and creates another one that continues its stream.
+     * <p>
+     * The copy starts with the window and match finder state of this channel, so that
+     * streams sharing a prefix (e.g. a page template) compress it only once: write the
+     * prefix, then fork the channel for each response and write the rest. Output of the
+     * copy is the stream suffix; it has to be appended to the output of this channel
+     * written so far. Both channels are independent and have to be closed.
+     *
+     * @param destination underlying destination of the copy
+     * @throws IOException if this channel has dictionaries attached
+     */
+    public BrotliEncoderChannel fork(WritableByteChannel destination) throws IOException {
+        lock.lock();
+        try {
+            if (closed) {
+                throw new ClosedChannelException();
+            }
+            return new BrotliEncoderChannel(this, destination);
+        } finally {
+            lock.unlock();
+        }
+    }
+
     @Override
     public void attachDictionary(PreparedDictionary dictionary) throws IOException {
         super.attachDictionary(dictionary);
     }
 
+    /**
+     * Flushes this channel and writes {@code len} bytes of {@code data} as a metadata block.
+     *
+     * @see BrotliOutputStream#writeMetadata(byte[])
+     */
+    public void writeMetadata(byte[] data, int off, int len) throws IOException {
+        lock.lock();
+        try {
+            if (closed) {
+                throw new ClosedChannelException();
+            }
+            super.writeMetadata(data, off, len);
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /**
+     * Makes writes of at least {@code minBytes} compress on {@code executor}.
+     * <p>
+     * A native call can not be unmounted, so a virtual thread compressing a big write keeps
+     * its carrier busy for the whole call. With an executor of platform threads the writer
+     * just waits for the result, and its carrier is free to run other virtual threads.
+     * Writes of the same channel are still done one at a time.
+     *
+     * @param executor runs compression; {@code null} to compress on the writing thread
+     * @param minBytes size of the smallest write to hand over
+     */
+    public void setOffloadExecutor(Executor executor, int minBytes) {
+        if (minBytes < 0) {
+            throw new IllegalArgumentException("minBytes should be non-negative");
+        }
+        lock.lock();
+        try {
+            offloadExecutor = executor;
+            offloadThreshold = minBytes;
+        } finally {
+            lock.unlock();
+        }
+    }
+
     @Override
     public boolean isOpen() {
-        synchronized (mutex) {
+        lock.lock();
+        try {
             return !closed;
+        } finally {
+            lock.unlock();
         }
     }
 
     @Override
     public void close() throws IOException {
-        synchronized (mutex) {
+        lock.lock();
+        try {
             super.close();
+        } finally {
+            lock.unlock();
         }
     }
 
     @Override
     public int write(ByteBuffer src) throws IOException {
-        synchronized (mutex) {
+        lock.lock();
+        try {
             if (closed) {
                 throw new ClosedChannelException();
             }
-            int result = 0;
-            while (src.hasRemaining() && encode(EncoderJNI.Operation.PROCESS)) {
-                int limit = Math.min(src.remaining(), inputBuffer.remaining());
-                ByteBuffer slice = src.slice();
-                ((Buffer) slice).limit(limit);
-                inputBuffer.put(slice);
-                result += limit;
-                ((Buffer) src).position(src.position() + limit);
+            if (offloadExecutor != null && src.remaining() >= offloadThreshold) {
+                return offload(src);
+            }
+            return writeLocked(src);
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    private int writeLocked(ByteBuffer src) throws IOException {
+        int result = 0;
+        while (src.hasRemaining() && encode(EncoderJNI.Operation.PROCESS)) {
+            int limit = Math.min(src.remaining(), inputBuffer.remaining());
+            ByteBuffer slice = src.slice();
+            ((Buffer) slice).limit(limit);
+            inputBuffer.put(slice);
+            result += limit;
+            ((Buffer) src).position(src.position() + limit);
+        }
+        return result;
+    }
+
+    /**
+     * Runs {@link #writeLocked(ByteBuffer)} on the offload executor; the lock stays held by
+     * the calling thread, which waits until the task is over.
+     */
+    private int offload(final ByteBuffer src) throws IOException {
+        FutureTask<Integer> task = new FutureTask<Integer>(new Callable<Integer>() {
+            @Override
+            public Integer call() throws IOException {
+                return writeLocked(src);
+            }
+        });
+        offloadExecutor.execute(task);
+        boolean interrupted = false;
+        try {
+            while (true) {
+                try {
+                    return task.get();
+                } catch (InterruptedException e) {
+                    // Encoder is in use by the task; it has to be over before returning.
+                    interrupted = true;
+                }
+            }
+        } catch (ExecutionException e) {
+            Throwable cause = e.getCause();
+            if (cause instanceof IOException) {
+                throw (IOException) cause;
+            }
+            if (cause instanceof RuntimeException) {
+                throw (RuntimeException) cause;
+            }
+            if (cause instanceof Error) {
+                throw (Error) cause;
+            }
+            throw new IOException("encoding failed", cause);
+        } finally {
+            if (interrupted) {
+                Thread.currentThread().interrupt();
             }
-            return result;
         }
     }
 }
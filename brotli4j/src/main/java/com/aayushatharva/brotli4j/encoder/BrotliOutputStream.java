@@ -32,11 +32,13 @@ import java.nio.channels.Channels;
  */
 public class BrotliOutputStream extends OutputStream {
     /**
-     * The default internal buffer size used by the encoder.
+     * Input bytes per independently compressed chunk in parallel mode.
      */
-    private static final int DEFAULT_BUFFER_SIZE = 16384;
+    private static final int PARALLEL_CHUNK_SIZE = 1 << 22;
 
+    /* Exactly one of these is set. */
     private final Encoder encoder;
+    private final ParallelChunkEncoder parallel;
 
     /**
      * Creates a BrotliOutputStream.
@@ -47,37 +49,150 @@ public class BrotliOutputStream extends OutputStream {
      */
     public BrotliOutputStream(OutputStream destination, Encoder.Parameters params, int bufferSize)
             throws IOException {
-        this.encoder = new Encoder(Channels.newChannel(destination), params, bufferSize);
+        this(destination, params, bufferSize, 1);
     }
 
+    /**
+     * Creates a BrotliOutputStream that compresses on {@code parallelism} threads.
+     * <p>
+     * With parallelism above 1, input is cut into 4 MiB chunks (and at every
+     * {@link #flush()}) that are compressed concurrently with separate encoders and
+     * written in order. Chunks do not reference each other, which costs a little
+     * compression ratio; the output is still a single regular brotli stream. This
+     * pays off for fast qualities (0 to 2), where one thread can not keep up with
+     * the input. Dictionaries are not supported in this mode.
+     *
+     * @param destination underlying destination
+     * @param params      encoding settings
+     * @param bufferSize  intermediate buffer size; only used with parallelism 1
+     * @param parallelism number of compression threads for this stream
+     */
+    public BrotliOutputStream(OutputStream destination, Encoder.Parameters params, int bufferSize,
+                              int parallelism) throws IOException {
+        if (parallelism < 1) {
+            throw new IllegalArgumentException("parallelism must be positive");
+        }
+        if (parallelism == 1) {
+            this.encoder = new Encoder(Channels.newChannel(destination), params, bufferSize);
+            this.parallel = null;
+        } else {
+            this.encoder = null;
+            this.parallel = new ParallelChunkEncoder(destination, params, parallelism, PARALLEL_CHUNK_SIZE);
+        }
+    }
+
+    /**
+     * Creates a BrotliOutputStream with adaptive intermediate buffer.
+     * <p>
+     * Buffer is taken from {@link com.aayushatharva.brotli4j.common.DirectBufferPool};
+     * it grows with large writes up to the encoder input block size, and shrinks
+     * when little data is written between flushes.
+     *
+     * @param destination underlying destination
+     * @param params      encoding settings
+     */
     public BrotliOutputStream(OutputStream destination, Encoder.Parameters params)
             throws IOException {
-        this(destination, params, DEFAULT_BUFFER_SIZE);
+        this.encoder = new Encoder(Channels.newChannel(destination), params);
+        this.parallel = null;
     }
 
     public BrotliOutputStream(OutputStream destination) throws IOException {
         this(destination, new Encoder.Parameters());
     }
 
+    private BrotliOutputStream(Encoder encoder) {
+        this.encoder = encoder;
+        this.parallel = null;
+    }
+
+    /**
+     * Flushes this stream and creates another one that continues it.
+     * <p>
+     * Output of the copy has to be appended to the output of this stream written so far.
+     *
+     * @param destination underlying destination of the copy
+     * @throws IOException if this stream has dictionaries attached
+     * @see BrotliEncoderChannel#fork(java.nio.channels.WritableByteChannel)
+     */
+    public BrotliOutputStream fork(OutputStream destination) throws IOException {
+        if (parallel != null) {
+            throw new IllegalStateException("fork is not supported with parallelism");
+        }
+        if (encoder.closed) {
+            throw new IOException("write after close");
+        }
+        return new BrotliOutputStream(new Encoder(encoder, Channels.newChannel(destination)));
+    }
+
     public void attachDictionary(PreparedDictionary dictionary) throws IOException {
+        if (parallel != null) {
+            throw new IllegalStateException("dictionaries are not supported with parallelism");
+        }
         encoder.attachDictionary(dictionary);
     }
 
     @Override
     public void close() throws IOException {
+        if (parallel != null) {
+            parallel.close();
+            return;
+        }
         encoder.close();
     }
 
     @Override
     public void flush() throws IOException {
+        if (parallel != null) {
+            if (parallel.closed) {
+                throw new IOException("write after close");
+            }
+            parallel.flush();
+            return;
+        }
         if (encoder.closed) {
             throw new IOException("write after close");
         }
         encoder.flush();
     }
 
+    /**
+     * Flushes this stream and writes {@code data} as a metadata block.
+     * <p>
+     * Decoders skip metadata, unless they are given a listener, e.g. with
+     * {@link com.aayushatharva.brotli4j.decoder.BrotliInputStream#setMetadataListener};
+     * then it could carry record boundaries, offsets or timestamps in the stream itself.
+     *
+     * @param data at most 16 MiB of metadata
+     */
+    public void writeMetadata(byte[] data) throws IOException {
+        writeMetadata(data, 0, data.length);
+    }
+
+    /**
+     * Flushes this stream and writes {@code len} bytes of {@code b} as a metadata block.
+     *
+     * @see #writeMetadata(byte[])
+     */
+    public void writeMetadata(byte[] b, int off, int len) throws IOException {
+        if (parallel != null) {
+            throw new IllegalStateException("metadata is not supported with parallelism");
+        }
+        if (encoder.closed) {
+            throw new IOException("write after close");
+        }
+        encoder.writeMetadata(b, off, len);
+    }
+
     @Override
     public void write(int b) throws IOException {
+        if (parallel != null) {
+            if (parallel.closed) {
+                throw new IOException("write after close");
+            }
+            parallel.write(b);
+            return;
+        }
         if (encoder.closed) {
             throw new IOException("write after close");
         }
@@ -94,6 +209,13 @@ public class BrotliOutputStream extends OutputStream {
 
     @Override
     public void write(byte[] b, int off, int len) throws IOException {
+        if (parallel != null) {
+            if (parallel.closed) {
+                throw new IOException("write after close");
+            }
+            parallel.write(b, off, len);
+            return;
+        }
         if (encoder.closed) {
             throw new IOException("write after close");
         }
@@ -0,0 +1,190 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+import java.io.IOException;
+import java.io.OutputStream;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.Arrays;
+
+/**
+ * Output stream that produces a brotli stream decodable from the middle.
+ * <p>
+ * Input is cut into chunks of {@code chunkSize} bytes (and at every {@link #flush()}).
+ * Each chunk is compressed by a dedicated encoder that does not reference preceding
+ * data, and is flushed to a byte boundary; consecutive chunks still form a single
+ * regular stream. Before the end of stream an index is written as a metadata block,
+ * which decoders skip:
+ * <pre>
+ *   chunk count + 1 entries: (uncompressed offset, compressed offset) as uint64
+ *   uint32 chunk count
+ *   uint32 lgwin
+ *   uint32 {@link #MAGIC}
+ * </pre>
+ * all little-endian; the last entry points at the end of the data. The stream
+ * ends with the single byte of the empty last meta-block right after the index.
+ * Such files are read with {@code Decoder.openSeekable}.
+ * <p>
+ * Larger chunks give better compression; smaller ones make random reads cheaper.
+ */
+public class BrotliSeekableOutputStream extends OutputStream {
+    public static final int DEFAULT_CHUNK_SIZE = 1 << 20;
+
+    /**
+     * Last field of the index; "BrSk" in ASCII.
+     */
+    public static final int MAGIC = 0x6b537242;
+
+    private static final int DEFAULT_WINDOW = 22;
+    private static final int FOOTER_SIZE = 12;
+    private static final int ENTRY_SIZE = 16;
+    private static final int MAX_METADATA_SIZE = 1 << 24;
+
+    private final OutputStream destination;
+    private final int quality;
+    private final int lgwin;
+    private final Encoder.Mode mode;
+    private final byte[] chunk;
+    private int chunkLength;
+    private long uncompressedOffset;
+    private long compressedOffset;
+    /* (uncompressed offset, compressed offset) pairs */
+    private long[] index = new long[64];
+    private int chunkCount;
+    private boolean closed;
+
+    /**
+     * Creates a BrotliSeekableOutputStream.
+     *
+     * @param destination underlying destination
+     * @param params      encoding settings
+     * @param chunkSize   number of input bytes per independently decodable chunk
+     */
+    public BrotliSeekableOutputStream(OutputStream destination, Encoder.Parameters params, int chunkSize) {
+        if (chunkSize <= 0) {
+            throw new IllegalArgumentException("chunk size must be positive");
+        }
+        if (destination == null) {
+            throw new NullPointerException("destination can not be null");
+        }
+        this.destination = destination;
+        this.quality = params.getQuality();
+        this.lgwin = params.getWindow() != -1 ? params.getWindow() : DEFAULT_WINDOW;
+        this.mode = params.getMode();
+        this.chunk = new byte[chunkSize];
+    }
+
+    public BrotliSeekableOutputStream(OutputStream destination, Encoder.Parameters params) {
+        this(destination, params, DEFAULT_CHUNK_SIZE);
+    }
+
+    public BrotliSeekableOutputStream(OutputStream destination) {
+        this(destination, new Encoder.Parameters());
+    }
+
+    private void emitChunk() throws IOException {
+        if ((long) (chunkCount + 2) * ENTRY_SIZE + FOOTER_SIZE > MAX_METADATA_SIZE) {
+            throw new IOException("too many chunks");
+        }
+        byte[] output = EncoderJNI.compressChunk(chunk, 0, chunkLength, quality, lgwin, mode,
+                uncompressedOffset, false);
+        addEntry();
+        destination.write(output);
+        uncompressedOffset += chunkLength;
+        compressedOffset += output.length;
+        chunkCount++;
+        chunkLength = 0;
+    }
+
+    private void addEntry() {
+        if (2 * chunkCount + 2 > index.length) {
+            index = Arrays.copyOf(index, 2 * index.length);
+        }
+        index[2 * chunkCount] = uncompressedOffset;
+        index[2 * chunkCount + 1] = compressedOffset;
+    }
+
+    @Override
+    public void write(int b) throws IOException {
+        if (closed) {
+            throw new IOException("write after close");
+        }
+        if (chunkLength == chunk.length) {
+            emitChunk();
+        }
+        chunk[chunkLength++] = (byte) b;
+    }
+
+    @Override
+    public void write(byte[] b, int off, int len) throws IOException {
+        if (closed) {
+            throw new IOException("write after close");
+        }
+        while (len > 0) {
+            if (chunkLength == chunk.length) {
+                emitChunk();
+            }
+            int limit = Math.min(len, chunk.length - chunkLength);
+            System.arraycopy(b, off, chunk, chunkLength, limit);
+            chunkLength += limit;
+            off += limit;
+            len -= limit;
+        }
+    }
+
+    /**
+     * Ends the current chunk, so that all the data written so far becomes decodable.
+     */
+    @Override
+    public void flush() throws IOException {
+        if (closed) {
+            throw new IOException("write after close");
+        }
+        if (chunkLength != 0) {
+            emitChunk();
+        }
+        destination.flush();
+    }
+
+    @Override
+    public void close() throws IOException {
+        if (closed) {
+            return;
+        }
+        try {
+            if (chunkLength != 0) {
+                emitChunk();
+            }
+            /* Terminal entry marks the end of the last chunk. */
+            addEntry();
+            ByteBuffer metadata = ByteBuffer.allocate((chunkCount + 1) * ENTRY_SIZE + FOOTER_SIZE)
+                    .order(ByteOrder.LITTLE_ENDIAN);
+            for (int i = 0; i < 2 * chunkCount + 2; i++) {
+                metadata.putLong(index[i]);
+            }
+            metadata.putInt(chunkCount);
+            metadata.putInt(lgwin);
+            metadata.putInt(MAGIC);
+            destination.write(EncoderJNI.encodeMetadata(metadata.array(), uncompressedOffset, true));
+        } finally {
+            closed = true;
+            destination.close();
+        }
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+import java.nio.file.Files;
+import java.nio.file.NoSuchFileException;
+import java.nio.file.Path;
+import java.nio.file.StandardCopyOption;
+import java.nio.file.StandardOpenOption;
+
+/**
+ * Resume point of {@link Encoder#compressResumable}: output up to {@link #outputOffset}
+ * is a flushed part of the stream that encodes input up to {@link #inputOffset}.
+ * <p>
+ * File format is shared with {@code brotli --checkpoint}: "BrCp" magic followed by
+ * little-endian 64-bit input and output offsets, 32-bit quality, window bits and window
+ * size, and the window itself, i.e. the input bytes just before the input offset.
+ */
+final class Checkpoint {
+    private static final int HEADER_SIZE = 32;
+    private static final int MAGIC = 0x70437242;  // "BrCp"
+
+    final long inputOffset;
+    final long outputOffset;
+    final int quality;
+    final int lgwin;
+    final ByteBuffer window;
+
+    private Checkpoint(long inputOffset, long outputOffset, int quality, int lgwin, ByteBuffer window) {
+        this.inputOffset = inputOffset;
+        this.outputOffset = outputOffset;
+        this.quality = quality;
+        this.lgwin = lgwin;
+        this.window = window;
+    }
+
+    static long maxWindowSize(int lgwin) {
+        return (1L << lgwin) - 16;
+    }
+
+    /**
+     * @return checkpoint, or {@code null} if there is no file
+     * @throws IOException if file can not be read or is malformed
+     */
+    static Checkpoint read(Path path) throws IOException {
+        FileChannel channel;
+        try {
+            channel = FileChannel.open(path, StandardOpenOption.READ);
+        } catch (NoSuchFileException e) {
+            return null;
+        }
+        try {
+            ByteBuffer header = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+            readFully(channel, header);
+            long inputOffset = header.getLong(4);
+            long outputOffset = header.getLong(12);
+            int quality = header.getInt(20);
+            int lgwin = header.getInt(24);
+            long windowSize = header.getInt(28) & 0xFFFFFFFFL;
+            if (header.getInt(0) != MAGIC || quality < 0 || quality > 11 || lgwin < 10 || lgwin > 30
+                    || inputOffset <= 0 || outputOffset < 0 || windowSize > inputOffset
+                    || windowSize > maxWindowSize(lgwin)) {
+                throw new IOException("invalid checkpoint file " + path);
+            }
+            ByteBuffer window = ByteBuffer.allocateDirect((int) windowSize);
+            readFully(channel, window);
+            ((Buffer) window).flip();
+            return new Checkpoint(inputOffset, outputOffset, quality, lgwin, window);
+        } finally {
+            channel.close();
+        }
+    }
+
+    /**
+     * Atomically replaces the checkpoint file; output MUST be durable already.
+     *
+     * @param window bytes just before the input offset; its remaining bytes are written
+     */
+    static void write(Path path, long inputOffset, long outputOffset, int quality, int lgwin,
+                      ByteBuffer window) throws IOException {
+        ByteBuffer header = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+        header.putInt(MAGIC).putLong(inputOffset).putLong(outputOffset).putInt(quality).putInt(lgwin)
+                .putInt(window.remaining());
+        ((Buffer) header).flip();
+        Path temp = path.resolveSibling(path.getFileName() + ".tmp");
+        try (FileChannel channel = FileChannel.open(temp, StandardOpenOption.WRITE,
+                StandardOpenOption.CREATE, StandardOpenOption.TRUNCATE_EXISTING)) {
+            while (header.hasRemaining()) {
+                channel.write(header);
+            }
+            while (window.hasRemaining()) {
+                channel.write(window);
+            }
+            channel.force(true);
+        }
+        Files.move(temp, path, StandardCopyOption.ATOMIC_MOVE, StandardCopyOption.REPLACE_EXISTING);
+    }
+
+    private static void readFully(FileChannel channel, ByteBuffer buffer) throws IOException {
+        while (buffer.hasRemaining()) {
+            if (channel.read(buffer) < 0) {
+                throw new IOException("truncated checkpoint file");
+            }
+        }
+    }
+}
@@ -0,0 +1,314 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.util.Arrays;
+import java.util.Iterator;
+import java.util.LinkedHashMap;
+import java.util.Map;
+import java.util.concurrent.Executor;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.locks.ReentrantLock;
+import java.util.function.BiConsumer;
+
+/**
+ * Cache of compressed bodies, keyed by SHA-256 of the content and by encoding parameters.
+ * <p>
+ * Meant for servers that compress the same static or semi-static bodies over and over.
+ * A miss is answered right away with a quality 1 stream, and the body is recompressed
+ * at the requested quality in the background; the better stream then replaces the quick
+ * one. Compressed bytes are kept off-heap, in direct buffers, and least recently used
+ * entries are evicted when their total size exceeds the capacity.
+ * <p>
+ * Instances are thread-safe.
+ */
+public final class CompressedCache {
+    /**
+     * Quality of streams served on a miss.
+     */
+    public static final int QUICK_QUALITY = 1;
+
+    private final long capacity;
+    private final Executor executor;
+    private final ReentrantLock lock = new ReentrantLock();
+    private final LinkedHashMap<Key, Entry> entries = new LinkedHashMap<>(16, 0.75f, true);
+    private long storedBytes;
+    private final AtomicLong hits = new AtomicLong();
+    private final AtomicLong misses = new AtomicLong();
+    private final AtomicLong upgrades = new AtomicLong();
+
+    /**
+     * Creates a cache that recompresses on the shared pool of
+     * {@link Encoder#compressAsync(ByteBuffer, Encoder.Parameters)}.
+     *
+     * @param capacity limit of the total size of cached streams, in bytes
+     */
+    public CompressedCache(long capacity) {
+        this(capacity, null);
+    }
+
+    /**
+     * @param capacity limit of the total size of cached streams, in bytes
+     * @param executor runs background recompression, or {@code null} for the shared pool
+     */
+    public CompressedCache(long capacity, Executor executor) {
+        if (capacity <= 0) {
+            throw new IllegalArgumentException("capacity should be positive");
+        }
+        this.capacity = capacity;
+        this.executor = executor;
+    }
+
+    /**
+     * Returns the cached stream of the remaining bytes of {@code input}, or compresses
+     * them at {@link #QUICK_QUALITY} and schedules recompression with {@code params}.
+     * <p>
+     * Position of {@code input} is not changed, and {@code input} may be modified once
+     * this method returns. The result is a read-only view of the cached stream, so a
+     * later call may return a better stream for the same content.
+     *
+     * @param input  data to encode; direct or heap
+     * @param params encoding parameters; quality -1 stands for 11
+     * @return buffer with encoded data, ready to be read
+     * @throws IOException if encoding fails
+     */
+    public ByteBuffer compress(ByteBuffer input, Encoder.Parameters params) throws IOException {
+        int quality = params.getQuality() < 0 ? 11 : params.getQuality();
+        Key key = new Key(digest(input), input.remaining(), quality, params.outputKey());
+        Entry entry;
+        lock.lock();
+        try {
+            entry = entries.get(key);
+        } finally {
+            lock.unlock();
+        }
+        if (entry != null) {
+            hits.incrementAndGet();
+            return entry.data.asReadOnlyBuffer();
+        }
+        misses.incrementAndGet();
+
+        int quickQuality = Math.min(QUICK_QUALITY, quality);
+        ByteBuffer quick = toDirect(compressBuffer(input, params.withQuality(quickQuality)));
+        if (quick.capacity() > capacity) {
+            return quick.asReadOnlyBuffer();
+        }
+        entry = new Entry(quick);
+        lock.lock();
+        try {
+            Entry existing = entries.get(key);
+            if (existing != null) {
+                /* Lost the race; keep the entry that may already be upgraded. */
+                return existing.data.asReadOnlyBuffer();
+            }
+            entries.put(key, entry);
+            storedBytes += quick.capacity();
+            evict();
+        } finally {
+            lock.unlock();
+        }
+        if (quality > quickQuality) {
+            upgrade(key, entry, input, params.withQuality(quality));
+        }
+        return quick.asReadOnlyBuffer();
+    }
+
+    /**
+     * Drops all entries; running recompressions are discarded when they finish.
+     */
+    public void clear() {
+        lock.lock();
+        try {
+            entries.clear();
+            storedBytes = 0;
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /**
+     * @return number of cached streams
+     */
+    public int size() {
+        lock.lock();
+        try {
+            return entries.size();
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /**
+     * @return total size of cached streams, in bytes
+     */
+    public long getStoredBytes() {
+        lock.lock();
+        try {
+            return storedBytes;
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /**
+     * @return number of calls answered from the cache
+     */
+    public long getHits() {
+        return hits.get();
+    }
+
+    /**
+     * @return number of calls that had to compress
+     */
+    public long getMisses() {
+        return misses.get();
+    }
+
+    /**
+     * @return number of quick streams replaced by recompressed ones
+     */
+    public long getUpgrades() {
+        return upgrades.get();
+    }
+
+    private void upgrade(final Key key, final Entry entry, ByteBuffer input, Encoder.Parameters params) {
+        /* Caller may reuse input as soon as compress returns. */
+        ByteBuffer copy = ByteBuffer.allocateDirect(input.remaining());
+        copy.put(input.duplicate());
+        ((Buffer) copy).flip();
+        BiConsumer<ByteBuffer, Throwable> swap = new BiConsumer<ByteBuffer, Throwable>() {
+            @Override
+            public void accept(ByteBuffer better, Throwable error) {
+                /* On failure the quick stream stays; it is still valid. */
+                if (error == null) {
+                    replace(key, entry, toDirect(better));
+                }
+            }
+        };
+        if (executor != null) {
+            Encoder.compressAsync(copy, params, executor).whenComplete(swap);
+        } else {
+            Encoder.compressAsync(copy, params).whenComplete(swap);
+        }
+    }
+
+    private void replace(Key key, Entry entry, ByteBuffer better) {
+        lock.lock();
+        try {
+            /* Entry may have been evicted, or cleared, meanwhile. */
+            if (entries.get(key) != entry || better.capacity() >= entry.data.capacity()) {
+                return;
+            }
+            storedBytes += better.capacity() - entry.data.capacity();
+            entry.data = better;
+            upgrades.incrementAndGet();
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /* Called with lock held. */
+    private void evict() {
+        Iterator<Map.Entry<Key, Entry>> it = entries.entrySet().iterator();
+        while (storedBytes > capacity && it.hasNext()) {
+            storedBytes -= it.next().getValue().data.capacity();
+            it.remove();
+        }
+    }
+
+    private static ByteBuffer compressBuffer(ByteBuffer input, Encoder.Parameters params) throws IOException {
+        ByteBuffer source = input.duplicate();
+        if (source.isDirect()) {
+            int maxSize = Encoder.maxCompressedSize(source.remaining());
+            if (maxSize != 0) {
+                ByteBuffer output = ByteBuffer.allocateDirect(maxSize);
+                Encoder.compress(source, output, params);
+                ((Buffer) output).flip();
+                return output;
+            }
+        }
+        byte[] data = new byte[source.remaining()];
+        source.get(data);
+        return ByteBuffer.wrap(Encoder.compress(data, params));
+    }
+
+    /* Copies into an exactly sized direct buffer, so that capacity is the stored size. */
+    private static ByteBuffer toDirect(ByteBuffer buffer) {
+        if (buffer.isDirect() && buffer.position() == 0 && buffer.remaining() == buffer.capacity()) {
+            return buffer;
+        }
+        ByteBuffer copy = ByteBuffer.allocateDirect(buffer.remaining());
+        copy.put(buffer.duplicate());
+        ((Buffer) copy).flip();
+        return copy;
+    }
+
+    private static byte[] digest(ByteBuffer input) {
+        try {
+            MessageDigest sha = MessageDigest.getInstance("SHA-256");
+            sha.update(input.duplicate());
+            return sha.digest();
+        } catch (NoSuchAlgorithmException e) {
+            throw new IllegalStateException("SHA-256 is not available", e);
+        }
+    }
+
+    private static final class Key {
+        private final byte[] digest;
+        private final int length;
+        private final int quality;
+        private final String parameters;
+        private final int hash;
+
+        Key(byte[] digest, int length, int quality, String parameters) {
+            this.digest = digest;
+            this.length = length;
+            this.quality = quality;
+            this.parameters = parameters;
+            this.hash = 31 * (31 * Arrays.hashCode(digest) + quality) + parameters.hashCode();
+        }
+
+        @Override
+        public boolean equals(Object o) {
+            if (!(o instanceof Key)) {
+                return false;
+            }
+            Key other = (Key) o;
+            return length == other.length && quality == other.quality
+                    && Arrays.equals(digest, other.digest) && parameters.equals(other.parameters);
+        }
+
+        @Override
+        public int hashCode() {
+            return hash;
+        }
+    }
+
+    private static final class Entry {
+        volatile ByteBuffer data;
+
+        Entry(ByteBuffer data) {
+            this.data = data;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+/**
+ * Prediction of {@link Encoder#estimate(java.nio.ByteBuffer, Encoder.Parameters)}.
+ * <p>
+ * Size is typically within 30% of the real one; highly redundant inputs larger
+ * than the sampled part are predicted on the large side. Time comes from a
+ * per-quality model calibrated on a 2 GHz x86-64 core, so compare it between
+ * qualities rather than against a wall clock.
+ */
+public final class CompressionEstimate {
+    private final long compressedSize;
+    private final long encodeNanos;
+
+    public CompressionEstimate(long compressedSize, long encodeNanos) {
+        this.compressedSize = compressedSize;
+        this.encodeNanos = encodeNanos;
+    }
+
+    /**
+     * @return predicted size of one-shot compressed stream
+     */
+    public long getCompressedSize() {
+        return compressedSize;
+    }
+
+    /**
+     * @return predicted CPU time of one-shot compression, in nanoseconds
+     */
+    public long getEncodeNanos() {
+        return encodeNanos;
+    }
+
+    @Override
+    public String toString() {
+        return "CompressionEstimate{compressedSize=" + compressedSize + ", encodeNanos=" + encodeNanos + '}';
+    }
+}
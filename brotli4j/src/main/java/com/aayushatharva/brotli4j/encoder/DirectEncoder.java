@@ -0,0 +1,153 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Streaming encoder that works on caller-owned direct buffers.
+ * <p>
+ * Unlike {@link BrotliEncoderChannel}, input is not copied to an intermediate buffer, and
+ * output is not handed out in an encoder-owned one: native encoder reads straight from
+ * the source buffers and writes straight into the destination ones. Several buffers can
+ * be passed at once, e.g. pieces of a composite network buffer; they are consumed and
+ * filled in order, and their positions are advanced.
+ * <p>
+ * Each method returns {@code false} when destinations are full before the work is done;
+ * then it MUST be called again with the same remaining input and more output space.
+ * With {@link Encoder.Parameter#WORK_BUDGET} set, it also returns {@code false} once the
+ * budget is spent, with input left and output space to spare; event loops call it again
+ * on their next turn.
+ * <p>
+ * Instances are not thread-safe.
+ */
+public final class DirectEncoder implements AutoCloseable {
+    /* Input is never staged, so the staging buffer is as small as allowed. */
+    private static final int STAGING_BUFFER_SIZE = 1;
+
+    private final EncoderJNI.Wrapper encoder;
+    private final List<PreparedDictionary> dictionaries = new ArrayList<>();
+    private boolean closed;
+
+    /**
+     * @param params encoding parameters
+     * @throws IOException if native encoder can not be created
+     */
+    public DirectEncoder(Encoder.Parameters params) throws IOException {
+        this.encoder = new EncoderJNI.Wrapper(STAGING_BUFFER_SIZE, params.getQuality(), params.getWindow(),
+                params.getMode(), params.getAllocator());
+        if (!params.applyTo(encoder)) {
+            encoder.destroy();
+            throw new IOException("failed to initialize native brotli encoder");
+        }
+        if (!params.admit(encoder, 0)) {
+            encoder.destroy();
+            throw new IOException("native memory budget is exhausted");
+        }
+    }
+
+    /**
+     * Attaches dictionary; MUST be invoked before the first portion of input.
+     */
+    public void attachDictionary(PreparedDictionary dictionary) throws IOException {
+        boolean ok;
+        if (dictionary instanceof EncoderJNI.SharedPreparedDictionary) {
+            // Native encoder keeps its own registry reference.
+            ok = encoder.attachSharedDictionary((EncoderJNI.SharedPreparedDictionary) dictionary);
+        } else {
+            ok = encoder.attachDictionary(dictionary.getData());
+            // Reference to native prepared dictionary wrapper should be held till the end of encoding.
+            dictionaries.add(dictionary);
+        }
+        if (!ok) {
+            throw new IOException("failed to attach dictionary");
+        }
+    }
+
+    /**
+     * Compresses input; encoder may keep some output until more input is given or stream
+     * is flushed.
+     *
+     * @return {@code true} if all input is consumed and there is no pending output
+     */
+    public boolean process(ByteBuffer[] srcs, ByteBuffer[] dsts) throws IOException {
+        return push(EncoderJNI.Operation.PROCESS, srcs, dsts);
+    }
+
+    /**
+     * Compresses input and completes the current output block, so that all the input
+     * passed so far could be decoded.
+     *
+     * @return {@code true} if the flush is complete
+     */
+    public boolean flush(ByteBuffer[] srcs, ByteBuffer[] dsts) throws IOException {
+        return push(EncoderJNI.Operation.FLUSH, srcs, dsts);
+    }
+
+    /**
+     * Compresses the last portion of input and finalizes the stream.
+     *
+     * @return {@code true} if the stream is complete
+     */
+    public boolean finish(ByteBuffer[] srcs, ByteBuffer[] dsts) throws IOException {
+        push(EncoderJNI.Operation.FINISH, srcs, dsts);
+        return encoder.isFinished();
+    }
+
+    public boolean isFinished() {
+        return encoder.isFinished();
+    }
+
+    /**
+     * Prepares encoder for a new stream with the same parameters; attached dictionaries
+     * are dropped. Native buffers are kept, so a reset encoder starts faster than a new one.
+     *
+     * @return {@code false} if encoder could not be reset and should be closed
+     */
+    public boolean reset() {
+        if (closed) {
+            throw new IllegalStateException("encoder is closed");
+        }
+        dictionaries.clear();
+        return encoder.reset();
+    }
+
+    private boolean push(EncoderJNI.Operation op, ByteBuffer[] srcs, ByteBuffer[] dsts) throws IOException {
+        encoder.push(op, srcs, dsts);
+        if (!encoder.isSuccess()) {
+            throw new IOException("encoding failed");
+        }
+        return !encoder.hasRemainingInput() && !encoder.hasMoreOutput();
+    }
+
+    /**
+     * Releases native resources; stream is not finalized.
+     */
+    @Override
+    public void close() {
+        if (closed) {
+            return;
+        }
+        closed = true;
+        encoder.destroy();
+        dictionaries.clear();
+    }
+}
@@ -23,24 +23,75 @@
 
 package com.aayushatharva.brotli4j.encoder;
 
+import com.aayushatharva.brotli4j.common.DirectBufferPool;
+import com.aayushatharva.brotli4j.common.MemoryStats;
+import com.aayushatharva.brotli4j.common.NativeMemoryBudget;
+
 import java.io.IOException;
+import java.io.InputStream;
 import java.nio.Buffer;
 import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
 import java.nio.channels.WritableByteChannel;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
 import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.EnumMap;
+import java.util.HashMap;
 import java.util.List;
+import java.util.Locale;
+import java.util.Map;
+import java.util.Properties;
+import java.util.concurrent.Callable;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.Executor;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.atomic.AtomicInteger;
 
 /**
  * Base class for OutputStream / Channel implementations.
  */
 public class Encoder {
+    /* Smaller chunks lose too much compression ratio to be worth a thread. */
+    private static final int MIN_PARALLEL_CHUNK_SIZE = 1 << 22;
+
+    /* Bounds of adaptive input buffer; see adaptInputBuffer. */
+    private static final int INITIAL_ADAPTIVE_BUFFER_SIZE = 16384;
+    private static final int MIN_ADAPTIVE_BUFFER_SIZE = DirectBufferPool.MIN_CAPACITY;
+    private static final int MAX_ADAPTIVE_BUFFER_SIZE = 1 << 20;
+
+    /* BROTLI_ENCODER_PROFILE_SIZE in encode.h. */
+    private static final int PROFILE_SIZE = 67;
+
+    /* Longest metadata block allowed by the format. */
+    static final int MAX_METADATA_SIZE = 1 << 24;
+
     private final WritableByteChannel destination;
     private final List<PreparedDictionary> dictionaries;
     private final EncoderJNI.Wrapper encoder;
     private ByteBuffer buffer;
-    final ByteBuffer inputBuffer;
+    ByteBuffer inputBuffer;
     boolean closed;
 
+    /* Upper bound of adaptive input buffer size; 0 if buffer size is fixed. */
+    private final int maxInputBufferSize;
+
+    /* Cost accounting for adaptive quality; unused otherwise. */
+    private final AdaptiveQuality adaptive;
+    private final int quality;
+    private long inputBytes;
+    private long outputBytes;
+    private long encodeNanos;
+
+    private final IncompressibleListener incompressibleListener;
+    private final StatsListener statsListener;
+
     /**
      * https://www.brotli.org/encode.html#aa6f
      * See encode.h, typedef enum BrotliEncoderMode
@@ -61,13 +112,221 @@ public class Encoder {
         /**
          * Compression mode used in WOFF 2.0.
          */
-        FONT;
+        FONT,
+        /**
+         * Compression mode is guessed from the first few KiB of input. Binary input of
+         * 16- or 32-bit fields additionally gets matching distance coding.
+         */
+        AUTO;
 
         public static Mode of(int value) {
             return values()[value];
         }
     }
 
+    /**
+     * Huge page policy of large native tables, see {@link Parameters#setHugePages(HugePages)}.
+     *
+     * <strong>Important</strong>: The ordinal value of the
+     * policies should be the same as brotli4j::HugePages in allocator.h
+     */
+    public enum HugePages {
+        /**
+         * Regular pages.
+         */
+        NONE,
+        /**
+         * Transparent huge pages, requested with {@code madvise(MADV_HUGEPAGE)}.
+         */
+        TRANSPARENT,
+        /**
+         * Pages from the reserved hugetlbfs pool; falls back to regular pages when
+         * the pool is exhausted.
+         */
+        EXPLICIT
+    }
+
+    /**
+     * Advanced encoder parameters, see {@link Parameters#setParameter(Parameter, int)}.
+     *
+     * <strong>Important</strong>: The code of each parameter should be the same as the
+     * value of the matching {@code BrotliEncoderParameter} constant in encode.h
+     */
+    public enum Parameter {
+        /**
+         * log2 of the maximal input block size, in range [16, 24]; 0 lets encoder choose.
+         */
+        LGBLOCK(3),
+        /**
+         * Non-zero disables literal context modeling; faster, and often no worse for
+         * binary data that is not text-like.
+         */
+        DISABLE_LITERAL_CONTEXT_MODELING(4),
+        /**
+         * Estimated total input size; lets encoder pick smaller hash tables and window
+         * for small payloads.
+         */
+        SIZE_HINT(5),
+        /**
+         * Non-zero enables "Large Window Brotli", with {@link Parameters#setWindow(int)}
+         * up to 30, for quality 3 and above. Such streams are not compatible with
+         * RFC 7932 decoders.
+         */
+        LARGE_WINDOW(6),
+        /**
+         * Number of postfix bits of distance codes, in range [0, 3].
+         */
+        NPOSTFIX(7),
+        /**
+         * Number of direct distance codes, a multiple of {@code 1 << NPOSTFIX} up to 120.
+         */
+        NDIRECT(8),
+        /**
+         * Number of bytes the produced data follows; the stream header is omitted.
+         */
+        STREAM_OFFSET(9),
+        /**
+         * Non-zero makes encoder pick the shortest encoding for meta-blocks of up to 4 KiB;
+         * for streams flushed after every short message, e.g. server-sent events. Output
+         * is never larger, at the cost of encoding such meta-blocks up to three times.
+         */
+        LOW_LATENCY_FLUSH(12),
+        /**
+         * Match finder of qualities 2 to 9: 2, 3, 4 or 54 (hash tables, fastest), 5 or 6
+         * (bucketed chains), 35, 55 or 65 (3, 54 or 6 plus a rolling hash for distant
+         * matches), 40, 41 or 42 (forgetful chains for windows up to 64 KiB; refused
+         * below quality 4); 0 lets quality and window choose.
+         */
+        HASHER_TYPE(13),
+        /**
+         * log2 of the number of buckets of hashers 5, 6 and 65, in range [10, 24]; 0 lets
+         * encoder choose.
+         */
+        HASHER_BUCKET_BITS(14),
+        /**
+         * log2 of the chain depth of hashers 5, 6 and 65, in range [0, 10]; quality - 1
+         * unless set. The hash table takes {@code 4 << (bucket bits + block bits)} bytes.
+         */
+        HASHER_BLOCK_BITS(15),
+        /**
+         * Number of recent distances hashers 5, 6 and 65 try before hash lookups, in
+         * range [1, 16]; 0 lets encoder choose.
+         */
+        HASHER_NUM_LAST_DISTANCES(16),
+        /**
+         * Non-zero pairs the match finder of qualities 2 to 9 with a sparse rolling-hash
+         * index of the whole window, which finds long repeats far beyond the reach of
+         * hash chains, e.g. in VM images or database dumps; takes 64 MiB. Use with
+         * {@link #LARGE_WINDOW} to reach repeats up to 1 GiB apart.
+         */
+        LONG_DISTANCE_MATCHING(17),
+        /**
+         * Non-zero makes encoder count meta-blocks, matches and literals, and CPU ticks
+         * spent per stage; see {@link Encoder#getStats()}. Costs a few tick counter reads
+         * per meta-block.
+         */
+        COLLECT_STATS(18),
+        /**
+         * 1 makes encoder compute CRC-32C of the input while copying it in, see
+         * {@link Encoder#getChecksum()}; 2 also appends it to the stream as a metadata
+         * block, which {@link com.aayushatharva.brotli4j.decoder.Decoder#enableChecksum()}
+         * verifies and other decoders skip. The trailer costs a flush and 10 bytes.
+         */
+        CHECKSUM(19),
+        /**
+         * Non-zero makes output a fragment for {@link Encoder#concatenate(Parameters, byte[]...)};
+         * see {@link Encoder#compressFragment(byte[], Parameters)}.
+         */
+        FRAGMENT(20),
+        /**
+         * Non-zero makes stream start with its uncompressed size, so that
+         * {@link com.aayushatharva.brotli4j.decoder.Decoder#decompress(byte[])} decodes into
+         * a single exactly sized array. Costs 15 bytes; declared only by one-shot
+         * {@link Encoder#compress(byte[], Parameters)}, where the size is known up front.
+         */
+        DECLARE_SIZE(21),
+        /**
+         * log2 of the number of recent positions kept in the match trees of qualities 10
+         * and 11, in range [10, 30]; 0 (default) spans the whole window. Trees take 8 bytes
+         * per position, 128 MiB for a 24-bit window; positions beyond a smaller tree are
+         * found through a 2 MiB hash chain, at some cost in ratio.
+         */
+        HASHER_TREE_BITS(22),
+        /**
+         * Number of input bytes one push encodes before it returns with the rest of input
+         * unconsumed; 0 (default) is unlimited. Lets event loops interleave long streams
+         * with other work, see {@link DirectEncoder}. Work is counted in whole input
+         * blocks, so {@link #LGBLOCK} bounds the time of a single push.
+         */
+        WORK_BUDGET(23),
+        /**
+         * log2 of the average size of content-defined chunks, in range [10, 24]; 0 (default)
+         * disables them. Stream is flushed at cut points chosen by a rolling hash of the
+         * content, which move along with it when data is inserted or removed; chunks are 1/4
+         * to 4 times the average size. Each cut costs a flush.
+         */
+        CHUNK_BITS(24),
+        /**
+         * Non-zero makes each {@link #CHUNK_BITS} chunk independent of the data before it, so
+         * that identical regions of different versions compress to identical bytes, which
+         * deduplicating storage keeps once. Holds past the first window of the stream, and
+         * for qualities 0 and 1 only if pushes pass the same pieces of input. Costs some
+         * ratio, more with smaller chunks.
+         */
+        INDEPENDENT_CHUNKS(25),
+        /**
+         * Non-zero makes qualities 5 to 9 choose matches with the shortest-path search of
+         * quality 10, over the matches their hash chains find, without its refinement;
+         * quality 9 with it sits between qualities 9 and 10 in ratio, and mostly in speed.
+         * Qualities that use other hashers, or {@link #LONG_DISTANCE_MATCHING}, switch to a
+         * hash chain.
+         */
+        SHORTEST_PATH(26),
+        /**
+         * log2 of the first input block size (10-24), or 0. The first block is compressed at
+         * quality 4 or less and pushed out as soon as it is filled, without a flush, so that
+         * streamed documents start arriving early; next blocks double in size up to
+         * {@link #LGBLOCK}, at the requested quality. Ignored by qualities 0 and 1.
+         */
+        FIRST_BLOCK_BITS(27);
+
+        final int code;
+
+        Parameter(int code) {
+            this.code = code;
+        }
+    }
+
+    /**
+     * Receives the outcome of the entropy pre-scan, see
+     * {@link Parameters#setSkipIncompressible(boolean)}.
+     */
+    public interface IncompressibleListener {
+        /**
+         * Invoked when stream is finished.
+         *
+         * @param inputBytes  size of the stream input
+         * @param storedBytes part of the input stored without compression
+         */
+        void onFinished(long inputBytes, long storedBytes);
+    }
+
+    /**
+     * Receives per-stage work counters of finished streams, see
+     * {@link Parameters#setStatsListener(StatsListener)}.
+     */
+    public interface StatsListener {
+        /**
+         * Invoked when stream is finished.
+         *
+         * @param quality     quality the stream was encoded with, -1 for default
+         * @param inputBytes  size of the stream input
+         * @param outputBytes size of the compressed stream
+         * @param stats       counters of the stream
+         */
+        void onFinished(int quality, long inputBytes, long outputBytes, EncoderStats stats);
+    }
+
     /**
      * Brotli encoder settings.
      */
@@ -75,6 +334,15 @@ public class Encoder {
         private int quality = -1;
         private int lgwin = -1;
         private Mode mode;
+        private boolean pooledAllocator;
+        private HugePages hugePages = HugePages.NONE;
+        private AdaptiveQuality adaptive;
+        private boolean skipIncompressible;
+        private IncompressibleListener incompressibleListener;
+        private StatsListener statsListener;
+        private long memoryLimit;
+        private byte[] profile;
+        private final EnumMap<Parameter, Integer> extra = new EnumMap<>(Parameter.class);
 
         public Parameters() {
         }
@@ -83,6 +351,139 @@ public class Encoder {
             this.quality = other.quality;
             this.lgwin = other.lgwin;
             this.mode = other.mode;
+            this.pooledAllocator = other.pooledAllocator;
+            this.hugePages = other.hugePages;
+            this.adaptive = other.adaptive;
+            this.skipIncompressible = other.skipIncompressible;
+            this.incompressibleListener = other.incompressibleListener;
+            this.statsListener = other.statsListener;
+            this.memoryLimit = other.memoryLimit;
+            this.profile = other.profile;
+            this.extra.putAll(other.extra);
+        }
+
+        /**
+         * Loads a preset written by the native tuner; see {@code brotli_bench -o} in
+         * brotli/tools/bench.c.
+         *
+         * @param presets preset file
+         * @param name    preset key, e.g. {@code html.2}
+         * @return parameters of the preset
+         * @throws IOException              if file can not be read
+         * @throws IllegalArgumentException if there is no such preset or it is malformed
+         */
+        public static Parameters fromPreset(Path presets, String name) throws IOException {
+            String preset = loadPresets(presets).getProperty(name);
+            if (preset == null) {
+                throw new IllegalArgumentException("no preset " + name + " in " + presets);
+            }
+            return parsePreset(parseFields(name, preset));
+        }
+
+        /**
+         * Loads the preset of {@code contentType} that has the best ratio among the ones
+         * that compressed at least {@code minSpeed} MB/s when tuned, or the fastest one
+         * if none did.
+         *
+         * @param presets     preset file
+         * @param contentType name the presets were tuned under, {@code brotli_bench -n}
+         * @param minSpeed    required compression throughput, MB/s
+         * @return parameters of the preset
+         * @throws IOException              if file can not be read
+         * @throws IllegalArgumentException if there are no such presets or one is malformed
+         */
+        public static Parameters fromPreset(Path presets, String contentType, double minSpeed)
+                throws IOException {
+            Properties all = loadPresets(presets);
+            String prefix = contentType + ".";
+            Map<String, String> best = null;
+            Map<String, String> fastest = null;
+            for (String key : all.stringPropertyNames()) {
+                if (!key.startsWith(prefix)) {
+                    continue;
+                }
+                Map<String, String> fields = parseFields(key, all.getProperty(key));
+                double speed = parseDouble(fields, "speed");
+                if (fastest == null || speed > parseDouble(fastest, "speed")) {
+                    fastest = fields;
+                }
+                if (speed >= minSpeed
+                        && (best == null || parseDouble(fields, "ratio") > parseDouble(best, "ratio"))) {
+                    best = fields;
+                }
+            }
+            if (fastest == null) {
+                throw new IllegalArgumentException("no presets for " + contentType + " in " + presets);
+            }
+            return parsePreset(best != null ? best : fastest);
+        }
+
+        private static Properties loadPresets(Path presets) throws IOException {
+            Properties properties = new Properties();
+            try (InputStream in = Files.newInputStream(presets)) {
+                properties.load(in);
+            }
+            return properties;
+        }
+
+        /* Splits "quality=5 window=22 ..." into fields; key is kept for messages. */
+        private static Map<String, String> parseFields(String key, String preset) {
+            Map<String, String> fields = new HashMap<>();
+            fields.put("", key);
+            for (String field : preset.trim().split("\\s+")) {
+                int separator = field.indexOf('=');
+                if (separator <= 0) {
+                    throw new IllegalArgumentException("malformed preset " + key + ": " + field);
+                }
+                fields.put(field.substring(0, separator), field.substring(separator + 1));
+            }
+            return fields;
+        }
+
+        private static int parseInt(Map<String, String> fields, String name) {
+            String value = fields.get(name);
+            try {
+                return Integer.parseInt(value);
+            } catch (NumberFormatException e) {
+                throw new IllegalArgumentException("malformed " + name + " of preset " + fields.get(""), e);
+            }
+        }
+
+        private static double parseDouble(Map<String, String> fields, String name) {
+            String value = fields.get(name);
+            try {
+                return Double.parseDouble(value);
+            } catch (NullPointerException | NumberFormatException e) {
+                throw new IllegalArgumentException("malformed " + name + " of preset " + fields.get(""), e);
+            }
+        }
+
+        private static Parameters parsePreset(Map<String, String> fields) {
+            Parameters params = new Parameters()
+                    .setQuality(parseInt(fields, "quality"))
+                    .setWindow(parseInt(fields, "window"));
+            String mode = fields.get("mode");
+            if (mode != null) {
+                try {
+                    params.setMode(Mode.valueOf(mode.toUpperCase(Locale.ROOT)));
+                } catch (IllegalArgumentException e) {
+                    throw new IllegalArgumentException("malformed mode of preset " + fields.get(""), e);
+                }
+            }
+            /* Tuner writes defaults as 0, or -1 for block bits. */
+            if (fields.containsKey("lgblock") && parseInt(fields, "lgblock") != 0) {
+                params.setParameter(Parameter.LGBLOCK, parseInt(fields, "lgblock"));
+            }
+            if (fields.containsKey("hasher") && parseInt(fields, "hasher") != 0) {
+                params.setParameter(Parameter.HASHER_TYPE, parseInt(fields, "hasher"));
+            }
+            if (fields.containsKey("bucket") && parseInt(fields, "bucket") != 0) {
+                params.setParameter(Parameter.HASHER_BUCKET_BITS, parseInt(fields, "bucket"));
+            }
+            if (fields.containsKey("block") && parseInt(fields, "block") >= 0) {
+                params.setParameter(Parameter.HASHER_BLOCK_BITS, parseInt(fields, "block"));
+            }
+            return params;
         }
 
         /**
@@ -97,11 +498,12 @@ public class Encoder {
         }
 
         /**
-         * @param lgwin log2(LZ window size), or -1 for default
+         * @param lgwin log2(LZ window size), or -1 for default; values above 24 take
+         *              effect only with {@link Parameter#LARGE_WINDOW}
          */
         public Parameters setWindow(int lgwin) {
-            if ((lgwin != -1) && ((lgwin < 10) || (lgwin > 24))) {
-                throw new IllegalArgumentException("lgwin should be in range [10, 24], or -1");
+            if ((lgwin != -1) && ((lgwin < 10) || (lgwin > 30))) {
+                throw new IllegalArgumentException("lgwin should be in range [10, 30], or -1");
             }
             this.lgwin = lgwin;
             return this;
@@ -114,6 +516,251 @@ public class Encoder {
             this.mode = mode;
             return this;
         }
+
+        /**
+         * Native encoder memory is taken from per-thread caches of size-classed blocks,
+         * instead of malloc. Reduces heap fragmentation of long-running processes that
+         * create many encoders.
+         *
+         * @param pooledAllocator whether to use the pooled native allocator
+         */
+        public Parameters setPooledAllocator(boolean pooledAllocator) {
+            this.pooledAllocator = pooledAllocator;
+            return this;
+        }
+
+        /**
+         * Native blocks of 2 MiB and more (hasher tables, ring buffer of large windows)
+         * are mapped directly and backed by huge pages, which cuts TLB misses of their
+         * random access. Pages are touched first by the thread that compresses, so the
+         * kernel places them on its NUMA node. Has effect on Linux only.
+         *
+         * @param hugePages huge page policy, or {@code null} for {@link HugePages#NONE}
+         */
+        public Parameters setHugePages(HugePages hugePages) {
+            this.hugePages = hugePages != null ? hugePages : HugePages.NONE;
+            return this;
+        }
+
+        /**
+         * Streams created with these parameters take quality and window from
+         * {@code adaptive} instead, and report their encoding cost back to it.
+         * One-shot {@code compress} methods are not affected.
+         *
+         * @param adaptive shared controller, or {@code null} to use fixed settings
+         */
+        public Parameters setAdaptiveQuality(AdaptiveQuality adaptive) {
+            this.adaptive = adaptive;
+            return this;
+        }
+
+        /**
+         * Streams created with these parameters estimate entropy of each input block
+         * before compressing it; blocks that look random (already compressed or
+         * encrypted data) are stored as is, at a fraction of the CPU cost.
+         * One-shot {@code compress} methods are not affected.
+         *
+         * @param skipIncompressible whether to pre-scan input blocks
+         */
+        public Parameters setSkipIncompressible(boolean skipIncompressible) {
+            this.skipIncompressible = skipIncompressible;
+            return this;
+        }
+
+        /**
+         * @param listener notified how much of each stream was stored uncompressed,
+         *                 or {@code null}; only used with {@link #setSkipIncompressible(boolean)}
+         */
+        public Parameters setIncompressibleListener(IncompressibleListener listener) {
+            this.incompressibleListener = listener;
+            return this;
+        }
+
+        /**
+         * Streams created with these parameters collect per-stage work counters, and
+         * pass them to {@code listener} when finished; e.g. to export them as metrics
+         * and tune quality per route. One-shot {@code compress} methods are not affected.
+         *
+         * @param listener notified of counters of each stream, or {@code null} to
+         *                 disable collection
+         */
+        public Parameters setStatsListener(StatsListener listener) {
+            this.statsListener = listener;
+            return this;
+        }
+
+        /**
+         * Caps working memory of each encoder created with these parameters, for
+         * servers that keep many mostly idle streams open. Window and quality are
+         * lowered as needed to fit; between flushes the encoder keeps only its
+         * window, everything else is released once a flush completes.
+         *
+         * @param memoryLimit bytes, or 0 for unlimited
+         */
+        public Parameters setMemoryLimit(long memoryLimit) {
+            if (memoryLimit < 0) {
+                throw new IllegalArgumentException("memory limit can not be negative");
+            }
+            this.memoryLimit = memoryLimit;
+            return this;
+        }
+
+        /**
+         * Encoders created with these parameters take the literal context map from
+         * {@code profile} instead of choosing one per meta-block, and use it from
+         * quality 3 on; qualities 10 and 11 are not affected. Best suited for many
+         * small, structurally similar payloads, like API responses.
+         *
+         * @param profile profile made by {@link Encoder#trainProfile(List, int)},
+         *                or {@code null} for none
+         */
+        public Parameters setProfile(byte[] profile) {
+            if (profile != null && profile.length != PROFILE_SIZE) {
+                throw new IllegalArgumentException("profile should be " + PROFILE_SIZE + " bytes long");
+            }
+            this.profile = profile != null ? profile.clone() : null;
+            return this;
+        }
+
+        /**
+         * Sets a parameter that has no dedicated setter. Values are checked, and clamped
+         * to the nearest valid ones, by the native encoder.
+         *
+         * @param parameter parameter to set
+         * @param value     non-negative value
+         */
+        public Parameters setParameter(Parameter parameter, int value) {
+            if (value < 0) {
+                throw new IllegalArgumentException("parameter value can not be negative");
+            }
+            extra.put(parameter, value);
+            return this;
+        }
+
+        /**
+         * Restores the default value of a parameter set by {@link #setParameter(Parameter, int)}.
+         */
+        public Parameters clearParameter(Parameter parameter) {
+            extra.remove(parameter);
+            return this;
+        }
+
+        /**
+         * @return copy of these parameters with fixed {@code quality}
+         */
+        Parameters withQuality(int quality) {
+            Parameters copy = new Parameters(this);
+            copy.adaptive = null;
+            return copy.setQuality(quality);
+        }
+
+        /**
+         * Describes the settings that affect one-shot output, except for quality.
+         */
+        String outputKey() {
+            return getWindow() + "/" + mode + "/" + extra + "/" + Arrays.toString(profile);
+        }
+
+        int getQuality() {
+            return adaptive != null ? adaptive.getQuality() : quality;
+        }
+
+        int getWindow() {
+            return adaptive != null ? adaptive.getWindow() : lgwin;
+        }
+
+        Mode getMode() {
+            return mode;
+        }
+
+        int getAllocator() {
+            return (pooledAllocator ? EncoderJNI.ALLOCATOR_POOLED : 0)
+                    | (hugePages.ordinal() << EncoderJNI.ALLOCATOR_HUGE_PAGES_SHIFT);
+        }
+
+        boolean hasExtraParameters() {
+            return !extra.isEmpty() || profile != null;
+        }
+
+        /**
+         * Applies settings beyond the ones passed at creation to a fresh encoder.
+         *
+         * @return {@code false} if any of them is rejected by the native encoder
+         */
+        boolean applyTo(EncoderJNI.Wrapper encoder) {
+            if (skipIncompressible && !encoder.setSkipIncompressible(true)) {
+                return false;
+            }
+            if (memoryLimit != 0 && !encoder.setMemoryLimit(memoryLimit)) {
+                return false;
+            }
+            if (statsListener != null && !encoder.setParameter(Parameter.COLLECT_STATS.code, 1)) {
+                return false;
+            }
+            return applyExtraParametersTo(encoder);
+        }
+
+        /**
+         * Reserves the estimated peak memory of a fresh encoder in {@link NativeMemoryBudget};
+         * if allowed, window and quality are lowered to fit the room left.
+         *
+         * @param sizeHint input size, or 0 if unknown
+         * @return {@code false} if the budget has no room for the encoder
+         */
+        boolean admit(EncoderJNI.Wrapper encoder, long sizeHint) {
+            if (NativeMemoryBudget.getLimit() == 0) {
+                return true;
+            }
+            // Native encoder assumes 1 GiB for streams of unknown length as well.
+            long inputSize = sizeHint > 0 ? sizeHint : 1L << 30;
+            int quality = getQuality() < 0 ? 11 : getQuality();
+            long estimate = EncoderJNI.estimatePeakMemory(quality, getWindow(), inputSize);
+            if (memoryLimit != 0) {
+                estimate = Math.min(estimate, memoryLimit);
+            }
+            long minimum = estimate;
+            if (NativeMemoryBudget.isDegrade()) {
+                // Memory limit lowers quality down to 2 and window down to 1 KiB.
+                minimum = Math.min(estimate, EncoderJNI.estimatePeakMemory(Math.min(quality, 2), 10, inputSize));
+            }
+            long reserved = encoder.reserveMemory(estimate, minimum, NativeMemoryBudget.getMaxWait());
+            return reserved != 0 && (reserved >= estimate || encoder.setMemoryLimit(reserved));
+        }
+
+        /**
+         * Applies only settings of {@link #setParameter(Parameter, int)}; the ones that
+         * affect streams only are left out.
+         */
+        boolean applyExtraParametersTo(EncoderJNI.Wrapper encoder) {
+            if (profile != null && !encoder.setProfile(profile)) {
+                return false;
+            }
+            for (Map.Entry<Parameter, Integer> entry : extra.entrySet()) {
+                if (!encoder.setParameter(entry.getKey().code, entry.getValue())) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    /**
+     * Creates a Encoder wrapper with adaptive input buffer.
+     * <p>
+     * Input buffer is taken from {@link DirectBufferPool}. It grows while writes keep
+     * filling it, up to the input block size of the encoder, so that each push covers
+     * a whole block; flushes of little data shrink it back.
+     *
+     * @param destination underlying destination
+     * @param params      encoding parameters
+     */
+    Encoder(WritableByteChannel destination, Parameters params) throws IOException {
+        this(destination, params, 1,
+                Math.min(inputBlockSize(params.getQuality(), params.getWindow()), MAX_ADAPTIVE_BUFFER_SIZE));
+        ByteBuffer pooled = DirectBufferPool.acquire(
+                Math.min(INITIAL_ADAPTIVE_BUFFER_SIZE, maxInputBufferSize));
+        encoder.setInputBuffer(pooled);
+        this.inputBuffer = pooled;
     }
 
     /**
@@ -125,6 +772,11 @@ public class Encoder {
      */
     Encoder(WritableByteChannel destination, Parameters params, int inputBufferSize)
             throws IOException {
+        this(destination, params, inputBufferSize, 0);
+    }
+
+    private Encoder(WritableByteChannel destination, Parameters params, int inputBufferSize,
+                    int maxInputBufferSize) throws IOException {
         if (inputBufferSize <= 0) {
             throw new IllegalArgumentException("buffer size must be positive");
         }
@@ -133,8 +785,99 @@ public class Encoder {
         }
         this.dictionaries = new ArrayList<>();
         this.destination = destination;
-        this.encoder = new EncoderJNI.Wrapper(inputBufferSize, params.quality, params.lgwin, params.mode);
+        this.adaptive = params.adaptive;
+        this.quality = params.getQuality();
+        this.encoder = new EncoderJNI.Wrapper(inputBufferSize, quality, params.getWindow(), params.mode,
+                params.getAllocator());
+        this.incompressibleListener = params.skipIncompressible ? params.incompressibleListener : null;
+        this.statsListener = params.statsListener;
+        if (!params.applyTo(encoder)) {
+            encoder.destroy();
+            throw new IOException("failed to initialize native brotli encoder");
+        }
+        if (!params.admit(encoder, 0)) {
+            encoder.destroy();
+            throw new IOException("native memory budget is exhausted");
+        }
         this.inputBuffer = this.encoder.getInputBuffer();
+        this.maxInputBufferSize = maxInputBufferSize;
+    }
+
+    /**
+     * Creates an encoder that continues the stream of {@code original}.
+     * <p>
+     * Input of {@code original} is flushed first; {@code destination} receives only output
+     * produced after that.
+     *
+     * @param original    encoder to copy
+     * @param destination underlying destination of the copy
+     */
+    Encoder(Encoder original, WritableByteChannel destination) throws IOException {
+        if (destination == null) {
+            throw new NullPointerException("destination can not be null");
+        }
+        original.encode(EncoderJNI.Operation.FLUSH);
+        this.dictionaries = new ArrayList<>();
+        this.destination = destination;
+        this.adaptive = original.adaptive;
+        this.quality = original.quality;
+        this.incompressibleListener = original.incompressibleListener;
+        this.statsListener = original.statsListener;
+        this.maxInputBufferSize = original.maxInputBufferSize;
+        this.encoder = original.encoder.fork();
+        if (maxInputBufferSize != 0) {
+            ByteBuffer pooled = DirectBufferPool.acquire(original.inputBuffer.capacity());
+            encoder.setInputBuffer(pooled);
+            this.inputBuffer = pooled;
+        } else {
+            this.inputBuffer = encoder.getInputBuffer();
+        }
+    }
+
+    /**
+     * Returns the number of input bytes the encoder processes at once; mirrors
+     * choice of {@code lgblock} in {@code BrotliEncoderComputeParams}.
+     */
+    static int inputBlockSize(int quality, int lgwin) {
+        if (quality < 0 || quality > 11) {
+            quality = 11;
+        }
+        lgwin = (lgwin < 0) ? 22 : Math.max(10, Math.min(24, lgwin));
+        int lgblock;
+        if (quality <= 1) {
+            lgblock = lgwin;
+        } else if (quality < 4) {
+            lgblock = 14;
+        } else {
+            lgblock = (quality >= 9 && lgwin > 16) ? Math.min(18, lgwin) : 16;
+        }
+        return 1 << lgblock;
+    }
+
+    /**
+     * Resizes adaptive input buffer after all of {@code pushed} bytes are consumed.
+     * <p>
+     * Buffer filled by writes is doubled; buffer flushed while less than a quarter full
+     * is halved.
+     */
+    private void adaptInputBuffer(EncoderJNI.Operation op, int pushed) {
+        int capacity = inputBuffer.capacity();
+        int size;
+        if (op == EncoderJNI.Operation.PROCESS && pushed == capacity && capacity < maxInputBufferSize) {
+            size = capacity * 2;
+        } else if (op == EncoderJNI.Operation.FLUSH && pushed < capacity / 4
+                && capacity > MIN_ADAPTIVE_BUFFER_SIZE) {
+            size = capacity / 2;
+        } else {
+            return;
+        }
+        ByteBuffer resized = DirectBufferPool.acquire(size);
+        if (!encoder.setInputBuffer(resized)) {
+            DirectBufferPool.release(resized);
+            return;
+        }
+        DirectBufferPool.release(inputBuffer);
+        inputBuffer = resized;
     }
 
     private void fail(String message) throws IOException {
@@ -147,6 +890,13 @@ public class Encoder {
     }
 
     public void attachDictionary(PreparedDictionary dictionary) throws IOException {
+        if (dictionary instanceof EncoderJNI.SharedPreparedDictionary) {
+            // Native encoder keeps its own registry reference.
+            if (!encoder.attachSharedDictionary((EncoderJNI.SharedPreparedDictionary) dictionary)) {
+                fail("failed to attach dictionary");
+            }
+            return;
+        }
         if (!encoder.attachDictionary(dictionary.getData())) {
             fail("failed to attach dictionary");
         }
@@ -154,6 +904,29 @@ public class Encoder {
         dictionaries.add(dictionary);
     }
 
+    /**
+     * Returns memory used by native encoder state of this stream.
+     */
+    public MemoryStats getMemoryStats() {
+        return encoder.getMemoryStats();
+    }
+
+    /**
+     * Returns per-stage work counters of this stream; zeroes unless enabled with
+     * {@link Parameter#COLLECT_STATS} or {@link Parameters#setStatsListener(StatsListener)}.
+     */
+    public EncoderStats getStats() {
+        return encoder.getStats();
+    }
+
+    /**
+     * Returns CRC-32C of the input pushed so far; 0 unless enabled with
+     * {@link Parameter#CHECKSUM}.
+     */
+    public int getChecksum() {
+        return encoder.getChecksum();
+    }
+
     /**
      * @param force repeat pushing until all output is consumed
      * @return true if all encoder output is consumed
@@ -183,6 +956,7 @@ public class Encoder {
             return true;
         }
         boolean hasInput = true;
+        int pushed = 0;
         while (true) {
             if (!encoder.isSuccess()) {
                 fail("encoding failed");
@@ -190,22 +964,71 @@ public class Encoder {
                 return false;
             } else if (encoder.hasMoreOutput()) {
                 buffer = encoder.pull();
+                outputBytes += buffer.remaining();
             } else if (encoder.hasRemainingInput()) {
-                encoder.push(op, 0);
+                push(op, 0);
             } else if (hasInput) {
-                encoder.push(op, inputBuffer.limit());
+                pushed = inputBuffer.limit();
+                inputBytes += pushed;
+                push(op, pushed);
                 hasInput = false;
             } else {
                 ((Buffer) inputBuffer).clear();
+                if (maxInputBufferSize != 0 && op != EncoderJNI.Operation.FINISH) {
+                    adaptInputBuffer(op, pushed);
+                }
                 return true;
             }
         }
     }
 
+    private void push(EncoderJNI.Operation op, int length) {
+        if (adaptive == null) {
+            encoder.push(op, length);
+            return;
+        }
+        long start = System.nanoTime();
+        encoder.push(op, length);
+        encodeNanos += System.nanoTime() - start;
+    }
+
     void flush() throws IOException {
         encode(EncoderJNI.Operation.FLUSH);
     }
 
+    /**
+     * Flushes input written so far and writes {@code length} bytes of {@code data} as a
+     * metadata block; metadata is taken straight from the array.
+     */
+    void writeMetadata(byte[] data, int offset, int length) throws IOException {
+        if (offset < 0 || length < 0 || offset > data.length - length) {
+            throw new IndexOutOfBoundsException("invalid metadata region");
+        }
+        if (length > MAX_METADATA_SIZE) {
+            throw new IllegalArgumentException("metadata is longer than 16 MiB");
+        }
+        encode(EncoderJNI.Operation.FLUSH);
+        int consumed = 0;
+        boolean started = false;
+        while (true) {
+            if (!encoder.isSuccess()) {
+                fail("encoding failed");
+            } else if (!pushOutput(true)) {
+                return;
+            } else if (encoder.hasMoreOutput()) {
+                buffer = encoder.pull();
+                outputBytes += buffer.remaining();
+            } else if (!started || consumed < length) {
+                // Block is over once all of it is consumed and its output is pulled.
+                started = true;
+                consumed += encoder.push(EncoderJNI.Operation.EMIT_METADATA, data, offset + consumed,
+                        length - consumed);
+            } else {
+                return;
+            }
+        }
+    }
+
     void close() throws IOException {
         if (closed) {
             return;
@@ -213,8 +1036,20 @@ public class Encoder {
         closed = true;
         try {
             encode(EncoderJNI.Operation.FINISH);
+            if (adaptive != null) {
+                adaptive.record(quality, inputBytes, outputBytes, encodeNanos);
+            }
+            if (incompressibleListener != null) {
+                incompressibleListener.onFinished(inputBytes, encoder.getStoredIncompressibleBytes());
+            }
+            if (statsListener != null) {
+                statsListener.onFinished(quality, inputBytes, outputBytes, encoder.getStats());
+            }
         } finally {
             encoder.destroy();
+            if (maxInputBufferSize != 0) {
+                DirectBufferPool.release(inputBuffer);
+            }
             destination.close();
         }
     }
@@ -229,44 +1064,659 @@ public class Encoder {
             return empty;
         }
         /* data.length > 0 */
-        EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(data.length, params.quality, params.lgwin, params.mode);
+        /* Input is read straight from data, so input buffer size does not matter. */
+        /* Pooled encoders keep parameters over reset, so only plain ones are pooled. */
+        boolean pooled = data.length <= EncoderPool.BUFFER_SIZE && !params.hasExtraParameters();
+        EncoderJNI.Wrapper encoder = pooled
+                ? EncoderPool.acquire(params.quality, params.lgwin, params.mode, params.getAllocator())
+                : new EncoderJNI.Wrapper(EncoderPool.BUFFER_SIZE, params.quality, params.lgwin, params.mode,
+                        params.getAllocator());
+        if (!pooled && !params.applyExtraParametersTo(encoder)) {
+            encoder.destroy();
+            throw new IOException("failed to initialize native brotli encoder");
+        }
+        if (!pooled && !params.admit(encoder, data.length)) {
+            encoder.destroy();
+            throw new IOException("native memory budget is exhausted");
+        }
+        try {
+            return encodeAll(encoder, data);
+        } finally {
+            if (pooled) {
+                EncoderPool.release(encoder);
+            } else {
+                encoder.destroy();
+            }
+        }
+    }
+
+    /**
+     * Feeds the whole (non-empty) data to a fresh encoder and collects the stream.
+     */
+    private static byte[] encodeAll(EncoderJNI.Wrapper encoder, byte[] data) throws IOException {
         ArrayList<byte[]> output = new ArrayList<byte[]>();
         int totalOutputSize = 0;
+        int offset = encoder.push(EncoderJNI.Operation.FINISH, data, 0, data.length);
+        while (true) {
+            if (!encoder.isSuccess()) {
+                throw new IOException("encoding failed");
+            } else if (encoder.hasMoreOutput()) {
+                ByteBuffer buffer = encoder.pull();
+                byte[] chunk = new byte[buffer.remaining()];
+                buffer.get(chunk);
+                output.add(chunk);
+                totalOutputSize += chunk.length;
+            } else if (offset < data.length) {
+                offset += encoder.push(EncoderJNI.Operation.FINISH, data, offset, data.length - offset);
+            } else if (!encoder.isFinished()) {
+                encoder.push(EncoderJNI.Operation.FINISH, 0);
+            } else {
+                break;
+            }
+        }
+        if (output.size() == 1) {
+            return output.get(0);
+        }
+        byte[] result = new byte[totalOutputSize];
+        int resultOffset = 0;
+        for (byte[] chunk : output) {
+            System.arraycopy(chunk, 0, result, resultOffset, chunk.length);
+            resultOffset += chunk.length;
+        }
+        return result;
+    }
+
+    public static byte[] compress(byte[] data) throws IOException {
+        return compress(data, new Parameters());
+    }
+
+    /**
+     * Encodes data as a delta against a previous version of it.
+     * <p>
+     * The reference is used as a raw dictionary, so the result is decoded with
+     * {@code Decoder.decompressDelta} given the same reference. Qualities below 5 do
+     * not search dictionaries and gain nothing. Unless set, the window is the
+     * smallest one covering data: reference bytes are addressed past it.
+     *
+     * @param data      data to encode
+     * @param reference previous version; MUST be direct; the whole capacity is used
+     * @param params    encoding parameters
+     */
+    public static byte[] compressDelta(byte[] data, ByteBuffer reference, Parameters params)
+            throws IOException {
+        if (data.length == 0) {
+            return compress(data, params);
+        }
+        int quality = (params.quality < 0) ? 11 : params.quality;
+        int lgwin = params.lgwin;
+        if (lgwin < 0) {
+            lgwin = 10;
+            while (lgwin < 24 && (1 << lgwin) - 16 < data.length) {
+                lgwin++;
+            }
+        }
+        PreparedDictionary dictionary = EncoderJNI.prepareLeanDictionary(reference, quality);
+        EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(EncoderPool.BUFFER_SIZE, quality, lgwin,
+                params.mode, params.getAllocator());
         try {
-            encoder.getInputBuffer().put(data);
-            encoder.push(EncoderJNI.Operation.FINISH, data.length);
-            while (true) {
+            if (!params.applyExtraParametersTo(encoder) || !encoder.attachDictionary(dictionary.getData())) {
+                throw new IOException("failed to initialize native brotli encoder");
+            }
+            return encodeAll(encoder, data);
+        } finally {
+            encoder.destroy();
+            // Prepared dictionary must stay reachable until the encoder is gone.
+            dictionary.getData();
+        }
+    }
+
+    /**
+     * Encodes data as a delta against a previous version stored in a file.
+     * <p>
+     * The file is memory-mapped, not read; it MUST NOT change while being encoded.
+     *
+     * @see #compressDelta(byte[], ByteBuffer, Parameters)
+     */
+    public static byte[] compressDelta(byte[] data, Path reference, Parameters params) throws IOException {
+        try (FileChannel channel = FileChannel.open(reference, StandardOpenOption.READ)) {
+            return compressDelta(data, channel.map(FileChannel.MapMode.READ_ONLY, 0, channel.size()), params);
+        }
+    }
+
+    /**
+     * Compresses a file, saving a checkpoint once every {@code interval} bytes of input;
+     * if the checkpoint exists, compression resumes from it instead of starting over.
+     * <p>
+     * At each checkpoint the stream is flushed and the output is forced to the storage
+     * before the checkpoint file is atomically replaced, so that a run killed at any
+     * moment loses at most one interval of work. A resumed run truncates the output to
+     * the checkpoint and continues the same stream with the window primed from the
+     * checkpoint; quality and window are taken from it, the other parameters MUST be the
+     * same. The checkpoint is deleted once the stream is complete. Checkpoints are
+     * interchangeable with the ones of {@code brotli --checkpoint}.
+     *
+     * @param input      file to compress; MUST NOT change between runs
+     * @param output     compressed file
+     * @param checkpoint checkpoint file
+     * @param interval   input bytes between checkpoints; each costs a flush and a write
+     *                   of up to a window of input
+     * @param params     encoding parameters
+     * @return size of the compressed file
+     */
+    public static long compressResumable(Path input, Path output, Path checkpoint, long interval,
+                                         Parameters params) throws IOException {
+        if (interval <= 0) {
+            throw new IllegalArgumentException("interval must be positive");
+        }
+        Checkpoint saved = Checkpoint.read(checkpoint);
+        int quality = (saved != null) ? saved.quality : ((params.quality < 0) ? 11 : params.quality);
+        int lgwin = (saved != null) ? saved.lgwin : ((params.lgwin < 0) ? 22 : params.lgwin);
+        EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(EncoderPool.BUFFER_SIZE, quality, lgwin,
+                params.mode, params.getAllocator());
+        try (FileChannel in = FileChannel.open(input, StandardOpenOption.READ);
+             FileChannel out = (saved != null)
+                     ? FileChannel.open(output, StandardOpenOption.WRITE)
+                     : FileChannel.open(output, StandardOpenOption.WRITE, StandardOpenOption.CREATE,
+                     StandardOpenOption.TRUNCATE_EXISTING)) {
+            if (!params.applyTo(encoder)
+                    || (lgwin > 24 && !encoder.setParameter(Parameter.LARGE_WINDOW.code, 1))) {
+                throw new IOException("failed to initialize native brotli encoder");
+            }
+            long inputOffset = 0;
+            long outputOffset = 0;
+            if (saved != null) {
+                if (in.size() < saved.inputOffset || out.size() < saved.outputOffset) {
+                    throw new IOException("checkpoint does not match input or output");
+                }
+                inputOffset = saved.inputOffset;
+                outputOffset = saved.outputOffset;
+                out.truncate(outputOffset);
+                if (!encoder.setParameter(Parameter.STREAM_OFFSET.code, (int) Math.min(inputOffset, 1L << 30))
+                        || !encoder.primeWindow(saved.window)) {
+                    throw new IOException("failed to resume from checkpoint");
+                }
+            }
+            in.position(inputOffset);
+            out.position(outputOffset);
+
+            ByteBuffer inputBuffer = encoder.getInputBuffer();
+            long nextCheckpoint = inputOffset + interval;
+            EncoderJNI.Operation op = EncoderJNI.Operation.PROCESS;
+            boolean eof = false;
+            while (!encoder.isFinished()) {
                 if (!encoder.isSuccess()) {
                     throw new IOException("encoding failed");
                 } else if (encoder.hasMoreOutput()) {
                     ByteBuffer buffer = encoder.pull();
-                    byte[] chunk = new byte[buffer.remaining()];
-                    buffer.get(chunk);
-                    output.add(chunk);
-                    totalOutputSize += chunk.length;
-                } else if (!encoder.isFinished()) {
-                    encoder.push(EncoderJNI.Operation.FINISH, 0);
+                    while (buffer.hasRemaining()) {
+                        outputOffset += out.write(buffer);
+                    }
+                } else if (encoder.hasRemainingInput()) {
+                    encoder.push(op, 0);
+                } else if (op == EncoderJNI.Operation.FLUSH) {
+                    // Flush is complete: everything read so far is decodable from the output.
+                    out.force(false);
+                    long windowSize = Math.min(inputOffset, Checkpoint.maxWindowSize(lgwin));
+                    ByteBuffer window = ByteBuffer.allocate((int) windowSize);
+                    while (window.hasRemaining()) {
+                        if (in.read(window, inputOffset - window.remaining()) < 0) {
+                            throw new IOException("input is truncated");
+                        }
+                    }
+                    ((Buffer) window).flip();
+                    Checkpoint.write(checkpoint, inputOffset, outputOffset, quality, lgwin, window);
+                    nextCheckpoint = inputOffset + interval;
+                    op = EncoderJNI.Operation.PROCESS;
                 } else {
-                    break;
+                    ((Buffer) inputBuffer).clear();
+                    while (!eof && inputBuffer.hasRemaining()) {
+                        eof = in.read(inputBuffer) < 0;
+                    }
+                    inputOffset += inputBuffer.position();
+                    if (eof) {
+                        op = EncoderJNI.Operation.FINISH;
+                    } else if (inputOffset >= nextCheckpoint) {
+                        op = EncoderJNI.Operation.FLUSH;
+                    }
+                    encoder.push(op, inputBuffer.position());
                 }
             }
+            out.force(false);
+            Files.deleteIfExists(checkpoint);
+            return outputOffset;
         } finally {
             encoder.destroy();
         }
-        if (output.size() == 1) {
-            return output.get(0);
+    }
+
+    /**
+     * Compresses file {@code input} to file {@code output} in native code.
+     * <p>
+     * Input is memory-mapped and output is written as it is produced, so neither passes
+     * through the Java heap; encoder size hint is the input size. Unless set, window is
+     * the smallest one that covers the input, as {@code brotli} CLI chooses it.
+     *
+     * @param input  file to compress; MUST NOT change while being compressed
+     * @param output compressed file; created or truncated
+     * @param params encoding parameters
+     * @return size of the compressed file
+     */
+    public static long compressFile(Path input, Path output, Parameters params) throws IOException {
+        return compressFile(input, output, params, 1);
+    }
+
+    /**
+     * Compresses file {@code input} to file {@code output} in native code, using up to
+     * {@code threads} threads.
+     * <p>
+     * With several threads, input is cut into chunks of max(4 MiB, window) bytes, which
+     * are compressed in rounds of {@code threads} by copies of the encoder, each with the
+     * window primed by the preceding input. The result is a single regular stream, almost
+     * as dense as the one of a single thread; every thread needs an encoder of its own,
+     * and compressed chunks of a round are held in native memory until it is written.
+     * Content-defined chunks of {@link Parameter#CHUNK_BITS} are cut by a single thread.
+     *
+     * @param threads maximal number of threads to use
+     * @see #compressFile(Path, Path, Parameters)
+     */
+    public static long compressFile(Path input, Path output, Parameters params, int threads) throws IOException {
+        if (threads < 1) {
+            throw new IllegalArgumentException("threads must be positive");
         }
-        byte[] result = new byte[totalOutputSize];
-        int offset = 0;
-        for (byte[] chunk : output) {
-            System.arraycopy(chunk, 0, result, offset, chunk.length);
-            offset += chunk.length;
+        long size = Files.size(input);
+        int lgwin = params.lgwin;
+        if (lgwin < 0) {
+            lgwin = 10;
+            while (lgwin < 24 && (1L << lgwin) - 16 < size) {
+                lgwin++;
+            }
+        }
+        EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(1, params.quality, lgwin, params.mode,
+                params.getAllocator());
+        try {
+            if (!params.applyTo(encoder)
+                    || (lgwin > 24 && !encoder.setParameter(Parameter.LARGE_WINDOW.code, 1))) {
+                throw new IOException("failed to initialize native brotli encoder");
+            }
+            if (!params.admit(encoder, size)) {
+                throw new IOException("native memory budget is exhausted");
+            }
+            if (params.extra.getOrDefault(Parameter.CHUNK_BITS, 0) != 0) {
+                threads = 1;
+            }
+            return encoder.compressFile(input.toString(), output.toString(), threads);
+        } finally {
+            encoder.destroy();
+        }
+    }
+
+    /**
+     * Encodes data as a fragment that {@link #concatenate(Parameters, byte[]...)} joins
+     * with other fragments into a single stream, without recompressing them.
+     * <p>
+     * Fragment has no stream header and no references to the static dictionary, whose
+     * distances depend on the position in the stream; so fragments can be cached and
+     * joined in any order. On short text fragments are a few percent larger than
+     * regular streams. {@link Parameter#LARGE_WINDOW} is ignored.
+     *
+     * @param data   data to encode
+     * @param params encoding parameters; window MUST NOT exceed the one of the joined stream
+     */
+    public static byte[] compressFragment(byte[] data, Parameters params) throws IOException {
+        EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(EncoderPool.BUFFER_SIZE, params.quality,
+                params.lgwin, params.mode, params.getAllocator());
+        try {
+            if (!params.applyExtraParametersTo(encoder) || !encoder.setParameter(Parameter.FRAGMENT.code, 1)) {
+                throw new IOException("failed to initialize native brotli encoder");
+            }
+            return encodeAll(encoder, data);
+        } finally {
+            encoder.destroy();
+        }
+    }
+
+    /**
+     * Joins fragments made by {@link #compressFragment(byte[], Parameters)} into a single
+     * stream; only the stream header and the final byte are added.
+     *
+     * @param params    parameters the fragments are encoded with; only window is used
+     * @param fragments fragments, in stream order
+     * @return stream that decodes to concatenation of the fragments' data
+     */
+    public static byte[] concatenate(Parameters params, byte[]... fragments) throws IOException {
+        return EncoderJNI.concatenate(fragments, (params.lgwin < 0) ? 22 : params.lgwin);
+    }
+
+    /**
+     * Encodes many small payloads, each into a separate stream, in a single native call.
+     * <p>
+     * Slices are compressed in order by one encoder, directly from {@code input} into
+     * the remaining part of {@code output}; it is pooled, unless {@code params} set
+     * {@link Parameters#setParameter(Parameter, int)} or {@link Parameters#setProfile(byte[])}. If output space runs out, the rest of
+     * slices is left untouched and may be compressed by another call.
+     *
+     * @param input   data to encode; MUST be direct
+     * @param slices  {offset, length} pairs of absolute {@code input} indices
+     * @param output  destination of encoded data; MUST be direct; its position is
+     *                advanced past the written data
+     * @param offsets receives absolute {@code output} index of each stream start,
+     *                followed by the end of the last stream; MUST have at least
+     *                {@code slices.length / 2 + 1} elements
+     * @param params  encoding parameters; ones that affect streams only (e.g. adaptive
+     *                input buffer) are not used
+     * @return number of compressed slices
+     * @throws IOException if encoding fails
+     */
+    public static int compressBatch(ByteBuffer input, int[] slices, ByteBuffer output, int[] offsets,
+                                    Parameters params) throws IOException {
+        if (slices.length % 2 != 0) {
+            throw new IllegalArgumentException("slices must be (offset, length) pairs");
+        }
+        /* Encoder keeps parameters over reset between slices; extra ones need a fresh one. */
+        boolean pooled = !params.hasExtraParameters();
+        EncoderJNI.Wrapper encoder = pooled
+                ? EncoderPool.acquire(params.quality, params.lgwin, params.mode, params.getAllocator())
+                : new EncoderJNI.Wrapper(EncoderPool.BUFFER_SIZE, params.quality, params.lgwin, params.mode,
+                        params.getAllocator());
+        if (!pooled && !params.applyExtraParametersTo(encoder)) {
+            encoder.destroy();
+            throw new IOException("failed to initialize native brotli encoder");
+        }
+        try {
+            return encoder.compressBatch(input, slices, slices.length / 2, output, offsets);
+        } finally {
+            if (pooled) {
+                EncoderPool.release(encoder);
+            } else {
+                encoder.destroy();
+            }
+        }
+    }
+
+    public static int compressBatch(ByteBuffer input, int[] slices, ByteBuffer output, int[] offsets)
+            throws IOException {
+        return compressBatch(input, slices, output, offsets, new Parameters());
+    }
+
+    /**
+     * Encodes the given data buffer using up to {@code threads} threads.
+     * <p>
+     * Input is split into independently compressed chunks of at least 4 MiB.
+     * Chunks do not reference each other, so compression ratio is slightly worse
+     * than of {@link #compress(byte[], Parameters)}; the result is a regular
+     * brotli stream that any decoder accepts.
+     *
+     * @param data    data to encode
+     * @param params  encoding parameters
+     * @param threads maximal number of threads to use
+     * @return encoded data
+     * @throws IOException if encoding fails
+     */
+    public static byte[] compressParallel(final byte[] data, Parameters params, int threads)
+            throws IOException {
+        if (threads < 1) {
+            throw new IllegalArgumentException("threads must be positive");
+        }
+        int chunkSize = Math.max(MIN_PARALLEL_CHUNK_SIZE, (int) ((data.length + (long) threads - 1) / threads));
+        if (threads == 1 || data.length <= chunkSize) {
+            return compress(data, params);
+        }
+        final int quality = params.quality;
+        final int lgwin = params.lgwin;
+        final Mode mode = params.mode;
+        int chunks = (int) ((data.length + (long) chunkSize - 1) / chunkSize);
+        ExecutorService executor = Executors.newFixedThreadPool(Math.min(threads, chunks));
+        try {
+            List<Future<byte[]>> parts = new ArrayList<Future<byte[]>>(chunks);
+            for (int i = 0; i < chunks; i++) {
+                final int offset = i * chunkSize;
+                final int length = Math.min(chunkSize, data.length - offset);
+                final boolean last = i == chunks - 1;
+                parts.add(executor.submit(new Callable<byte[]>() {
+                    @Override
+                    public byte[] call() throws IOException {
+                        return EncoderJNI.compressChunk(data, offset, length, quality, lgwin, mode, last);
+                    }
+                }));
+            }
+            List<byte[]> output = new ArrayList<byte[]>(chunks);
+            long totalOutputSize = 0;
+            for (Future<byte[]> part : parts) {
+                byte[] chunk = part.get();
+                output.add(chunk);
+                totalOutputSize += chunk.length;
+            }
+            if (totalOutputSize > Integer.MAX_VALUE) {
+                throw new IOException("encoded data is too large");
+            }
+            byte[] result = new byte[(int) totalOutputSize];
+            int offset = 0;
+            for (byte[] chunk : output) {
+                System.arraycopy(chunk, 0, result, offset, chunk.length);
+                offset += chunk.length;
+            }
+            return result;
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            throw new IOException("interrupted", e);
+        } catch (ExecutionException e) {
+            Throwable cause = e.getCause();
+            if (cause instanceof IOException) {
+                throw (IOException) cause;
+            }
+            throw new IOException("encoding failed", cause);
+        } finally {
+            executor.shutdownNow();
+        }
+    }
+
+    /**
+     * Shared pool of daemon threads for {@link #compressAsync(ByteBuffer, Parameters)}.
+     * Each worker keeps its own pooled native encoders.
+     */
+    private static final class AsyncExecutorHolder {
+        static final ExecutorService EXECUTOR = Executors.newFixedThreadPool(
+                Runtime.getRuntime().availableProcessors(), new DaemonThreadFactory());
+
+        private static final class DaemonThreadFactory implements ThreadFactory {
+            private final AtomicInteger counter = new AtomicInteger();
+
+            @Override
+            public Thread newThread(Runnable runnable) {
+                Thread thread = new Thread(runnable, "brotli4j-encoder-" + counter.incrementAndGet());
+                thread.setDaemon(true);
+                return thread;
+            }
+        }
+    }
+
+    /**
+     * Encodes the remaining bytes of {@code input} on a shared pool of worker threads.
+     *
+     * @see #compressAsync(ByteBuffer, Parameters, Executor)
+     */
+    public static CompletableFuture<ByteBuffer> compressAsync(ByteBuffer input, Parameters params) {
+        return compressAsync(input, params, AsyncExecutorHolder.EXECUTOR);
+    }
+
+    /**
+     * Encodes the remaining bytes of {@code input} on the given executor.
+     * <p>
+     * Useful to keep heavy compression off I/O threads. The position of {@code input} is
+     * not changed, but its remaining bytes MUST NOT be modified until the returned future
+     * completes. Parameters are copied, so {@code params} may be changed right away.
+     *
+     * @param input    data to encode; direct or heap
+     * @param params   encoding parameters
+     * @param executor runs compression
+     * @return future that receives the buffer with encoded data, ready to be read
+     */
+    public static CompletableFuture<ByteBuffer> compressAsync(ByteBuffer input, Parameters params,
+                                                              Executor executor) {
+        final ByteBuffer source = input.duplicate();
+        final Parameters snapshot = new Parameters(params);
+        final CompletableFuture<ByteBuffer> result = new CompletableFuture<ByteBuffer>();
+        try {
+            executor.execute(new Runnable() {
+                @Override
+                public void run() {
+                    try {
+                        result.complete(compressBuffer(source, snapshot));
+                    } catch (Throwable t) {
+                        result.completeExceptionally(t);
+                    }
+                }
+            });
+        } catch (RuntimeException e) {
+            result.completeExceptionally(e);
         }
         return result;
     }
 
-    public static byte[] compress(byte[] data) throws IOException {
-        return compress(data, new Parameters());
+    private static ByteBuffer compressBuffer(ByteBuffer input, Parameters params) throws IOException {
+        /* Small payloads go through pooled encoders; big direct ones are encoded in place. */
+        if (input.isDirect() && input.remaining() > EncoderPool.BUFFER_SIZE) {
+            int maxSize = maxCompressedSize(input.remaining());
+            if (maxSize != 0) {
+                ByteBuffer output = ByteBuffer.allocateDirect(maxSize);
+                compress(input, output, params);
+                ((Buffer) output).flip();
+                return output;
+            }
+        }
+        byte[] data = new byte[input.remaining()];
+        input.get(data);
+        return ByteBuffer.wrap(compress(data, params));
+    }
+
+    /**
+     * Encodes the remaining bytes of {@code input} into {@code output} in one shot.
+     * <p>
+     * Both buffers MUST be direct. No intermediate copies are made; {@code output}
+     * should have at least {@link #maxCompressedSize(int)} bytes remaining to
+     * guarantee success. Buffer positions are advanced past consumed / produced data.
+     *
+     * @param input  data to encode; MUST be direct
+     * @param output destination of encoded data; MUST be direct
+     * @param params encoding parameters
+     * @return number of bytes written to {@code output}
+     * @throws IOException if encoding fails, e.g. when {@code output} is too small
+     */
+    public static int compress(ByteBuffer input, ByteBuffer output, Parameters params) throws IOException {
+        if (params.hasExtraParameters()) {
+            /* One-shot native API takes only quality, window and mode. */
+            Parameters oneShot = new Parameters(params);
+            oneShot.adaptive = null;
+            oneShot.skipIncompressible = false;
+            oneShot.memoryLimit = 0;
+            int start = output.position();
+            try (DirectEncoder encoder = new DirectEncoder(oneShot)) {
+                if (!encoder.finish(new ByteBuffer[]{input}, new ByteBuffer[]{output})) {
+                    throw new IOException("encoding failed");
+                }
+            }
+            return output.position() - start;
+        }
+        return EncoderJNI.compress(input, output, params.quality, params.lgwin, params.mode);
+    }
+
+    public static int compress(ByteBuffer input, ByteBuffer output) throws IOException {
+        return compress(input, output, new Parameters());
+    }
+
+    /**
+     * Encodes as much of the remaining bytes of {@code input} as fits the remaining
+     * space of {@code output}, e.g. a datagram or a storage page, into a complete stream.
+     * <p>
+     * Input position is advanced past the consumed part only; the rest can be
+     * passed to the next call, which starts a new stream. Size of output is checked
+     * per meta-block while compressing: the block that would overflow is cut and
+     * ends the stream, so nothing has to be recompressed with less input. If
+     * {@code output} is too small for any input, an empty stream is written.
+     * Qualities 0 and 1 are compressed as 2.
+     *
+     * @param input  data to encode; MUST be direct
+     * @param output destination of encoded data; MUST be direct
+     * @param params encoding parameters; only quality, window and mode are used
+     * @return number of bytes written to {@code output}
+     * @throws IOException if encoding fails, e.g. when {@code output} can not hold
+     *                     even an empty stream
+     */
+    public static int compressToBudget(ByteBuffer input, ByteBuffer output, Parameters params) throws IOException {
+        return EncoderJNI.compressToBudget(input, output, params.quality, params.lgwin, params.mode);
+    }
+
+    /**
+     * Estimates peak of native memory used by encoder state to compress
+     * {@code sizeHint} bytes with the given parameters; input / output buffers
+     * are not included.
+     *
+     * @param params   encoding parameters
+     * @param sizeHint expected input size, or 0 if unknown
+     * @return estimated number of bytes
+     */
+    public static long estimatePeakMemory(Parameters params, long sizeHint) {
+        return EncoderJNI.estimatePeakMemory(params.quality, params.lgwin, sizeHint);
+    }
+
+    /**
+     * Predicts the size and CPU cost of compressing remaining bytes of
+     * {@code input} with the given parameters, without compressing it.
+     * <p>
+     * Only up to 64 KiB sampled across the input are looked at, so this is cheap
+     * enough to decide per payload whether compression is worth it, or which
+     * quality fits a latency budget. Buffer position is not changed.
+     *
+     * @param input  data to look at; direct or heap
+     * @param params encoding parameters; only quality and window are used
+     * @return prediction
+     */
+    public static CompressionEstimate estimate(ByteBuffer input, Parameters params) {
+        return EncoderJNI.estimate(input, params.quality, params.lgwin);
+    }
+
+    /**
+     * Returns the size of output buffer that is enough to hold the result of
+     * one-shot encoding of {@code inputSize} bytes.
+     *
+     * @param inputSize size of data to encode
+     * @return worst-case compressed size, or 0 if {@code inputSize} is too large
+     */
+    public static int maxCompressedSize(int inputSize) {
+        long result = EncoderJNI.maxCompressedSize(inputSize);
+        return result > Integer.MAX_VALUE ? 0 : (int) result;
+    }
+
+    /**
+     * Learns an encoder profile from sample data, see {@link Parameters#setProfile(byte[])}.
+     * <p>
+     * Candidate literal context maps are compared by compressing every sample with
+     * them, so training takes about a dozen compressions of all samples.
+     *
+     * @param samples typical payloads the profile is meant for
+     * @param quality quality the profile is tuned for, clamped to [3, 9]
+     * @return profile data
+     */
+    public static byte[] trainProfile(List<byte[]> samples, int quality) {
+        if (samples.isEmpty()) {
+            throw new IllegalArgumentException("no samples");
+        }
+        long totalSize = 0;
+        int[] sizes = new int[samples.size()];
+        for (int i = 0; i < sizes.length; ++i) {
+            sizes[i] = samples.get(i).length;
+            totalSize += sizes[i];
+        }
+        if (totalSize > Integer.MAX_VALUE - 8) {
+            throw new IllegalArgumentException("samples are too big");
+        }
+        byte[] joined = new byte[(int) totalSize];
+        int offset = 0;
+        for (byte[] sample : samples) {
+            System.arraycopy(sample, 0, joined, offset, sample.length);
+            offset += sample.length;
+        }
+        return EncoderJNI.trainProfile(joined, sizes, quality);
     }
 
     /**
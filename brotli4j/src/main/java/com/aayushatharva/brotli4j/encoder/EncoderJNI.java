@@ -23,38 +23,140 @@
 
 package com.aayushatharva.brotli4j.encoder;
 
+import com.aayushatharva.brotli4j.common.MemoryStats;
+import com.aayushatharva.brotli4j.common.NativeMemoryBudget;
+
 import java.io.IOException;
+import java.nio.Buffer;
 import java.nio.ByteBuffer;
 
 /**
  * JNI wrapper for brotli encoder.
  */
 class EncoderJNI {
+    /* Bits of Wrapper allocator policy; huge page policy is Encoder.HugePages ordinal. */
+    static final int ALLOCATOR_POOLED = 1;
+    static final int ALLOCATOR_HUGE_PAGES_SHIFT = 1;
+
     private static native ByteBuffer nativeCreate(long[] context);
 
-    private static native void nativePush(long[] context, int length);
+    private static native ByteBuffer nativeFork(long handle, long[] context);
+
+    private static native int nativePush(long handle, int operation, int length);
+
+    private static native long nativePushArray(long handle, int operation, byte[] data, int offset, int length);
+
+    private static native long nativePull(long handle);
+
+    private static native int nativePushVectored(long handle, int operation, ByteBuffer[] srcs,
+                                                 int[] srcRegions, ByteBuffer[] dsts, int[] dstRegions);
+
+    private static native ByteBuffer nativeGetOutputBuffer(long handle);
+
+    private static native void nativeDestroy(long handle);
+
+    private static native boolean nativeReset(long handle);
+
+    private static native boolean nativeSetInputBuffer(long handle, ByteBuffer buffer);
+
+    private static native void nativeGetMemoryStats(long handle, long[] stats);
+
+    private static native boolean nativeSetSkipIncompressible(long handle, boolean enable);
+
+    private static native boolean nativeSetMemoryLimit(long handle, long limit);
+
+    private static native long nativeReserveMemory(long handle, long bytes, long minBytes, long waitMillis);
+
+    private static native boolean nativeSetParameter(long handle, int parameter, int value);
+
+    private static native boolean nativeSetProfile(long handle, byte[] profile);
+
+    private static native long nativeGetStoredIncompressibleBytes(long handle);
+
+    private static native void nativeGetStats(long handle, long[] stats);
+
+    private static native int nativeGetChecksum(long handle);
+
+    private static native long nativeGetTotalOut(long handle);
+
+    private static native int nativeCompressBatch(long handle, ByteBuffer input, int[] slices, int count,
+                                                  ByteBuffer output, int outputOffset, int outputLength,
+                                                  int[] offsets);
 
-    private static native ByteBuffer nativePull(long[] context);
+    private static native long nativeCompressFile(long handle, String input, String output, int lgwin,
+                                                  int threads);
 
-    private static native void nativeDestroy(long[] context);
+    private static native boolean nativeAttachDictionary(long handle, ByteBuffer dictionary);
 
-    private static native boolean nativeAttachDictionary(long[] context, ByteBuffer dictionary);
+    private static native boolean nativePrimeWindow(long handle, ByteBuffer window, int offset, int length);
 
     private static native ByteBuffer nativePrepareDictionary(ByteBuffer dictionary, long type);
 
+    private static native ByteBuffer nativePrepareLeanDictionary(ByteBuffer reference, int quality);
+
     private static native void nativeDestroyDictionary(ByteBuffer dictionary);
 
+    private static native long nativeAcquireSharedDictionary(ByteBuffer dictionary, long type);
+
+    private static native ByteBuffer nativeSharedDictionaryData(long dictionary);
+
+    private static native void nativeReleaseSharedDictionary(long dictionary);
+
+    private static native boolean nativeAttachSharedDictionary(long handle, long dictionary);
+
+    private static native long nativeCompress(ByteBuffer input, int inputOffset, int inputLength,
+                                              ByteBuffer output, int outputOffset, int outputLength,
+                                              int quality, int lgwin, int mode);
+
+    private static native boolean nativeCompressToBudget(ByteBuffer input, int inputOffset, int inputLength,
+                                                         ByteBuffer output, int outputOffset, int outputLength,
+                                                         int quality, int lgwin, int mode, long[] result);
+
+    private static native long nativeMaxCompressedSize(long inputSize);
+
+    private static native long nativeEstimatePeakMemory(int quality, int lgwin, long sizeHint);
+
+    private static native boolean nativeEstimate(int quality, int lgwin, ByteBuffer direct, byte[] array,
+                                                 int offset, int length, long[] result);
+
+    private static native byte[] nativeCompressChunk(byte[] data, int offset, int length,
+                                                     int quality, int lgwin, int mode,
+                                                     long streamOffset, boolean last);
+
+    private static native byte[] nativeEncodeMetadata(byte[] data, long streamOffset, boolean last);
+
+    private static native byte[] nativeConcatenate(byte[][] fragments, int lgwin);
+
+    private static native byte[] nativeTrainProfile(byte[] samples, int[] sizes, int quality);
+
+    private static native byte[] nativeTrainDictionary(byte[] samples, int[] sizes, int limit,
+                                                       boolean serialized);
+
     enum Operation {
         PROCESS,
         FLUSH,
-        FINISH
+        FINISH,
+        /**
+         * Flushes pending input, then writes the pushed bytes as a metadata block; only
+         * for pushes from a heap array. Until the block is complete, the rest of it has
+         * to be pushed again, also after all of it is consumed: the encoder returns to
+         * regular input when a push of nothing produces no output.
+         */
+        EMIT_METADATA
     }
 
     private static class PreparedDictionaryImpl implements PreparedDictionary {
         private ByteBuffer data;
+        /* Memory that lean dictionaries point to; null if data is copied. */
+        private final ByteBuffer source;
 
         private PreparedDictionaryImpl(ByteBuffer data) {
+            this(data, null);
+        }
+
+        private PreparedDictionaryImpl(ByteBuffer data, ByteBuffer source) {
             this.data = data;
+            this.source = source;
         }
 
         @Override
@@ -91,48 +193,538 @@ class EncoderJNI {
         return new PreparedDictionaryImpl(dictionaryData);
     }
 
+    /**
+     * Prepares a previous version of the data for delta compression.
+     * <p>
+     * Reference is indexed in place rather than copied, so a memory-mapped file
+     * is never loaded as a whole; it MUST NOT be modified while in use.
+     *
+     * @param reference previous version; MUST be direct
+     * @param quality   quality the reference is going to be searched at
+     */
+    static PreparedDictionary prepareLeanDictionary(ByteBuffer reference, int quality) {
+        if (!reference.isDirect()) {
+            throw new IllegalArgumentException("only direct buffers allowed");
+        }
+        ByteBuffer dictionaryData = nativePrepareLeanDictionary(reference, quality);
+        if (dictionaryData == null) {
+            throw new IllegalStateException("OOM or reference is too big");
+        }
+        return new PreparedDictionaryImpl(dictionaryData, reference);
+    }
+
+    /**
+     * Dictionary owned by the process-wide native registry.
+     * <p>
+     * Each instance holds one registry reference; encoders take their own ones when
+     * the dictionary is attached, so they do not depend on this object being reachable.
+     */
+    static final class SharedPreparedDictionary implements PreparedDictionary {
+        private final long handle;
+        private final ByteBuffer data;
+
+        private SharedPreparedDictionary(long handle) {
+            this.handle = handle;
+            this.data = nativeSharedDictionaryData(handle);
+        }
+
+        long getHandle() {
+            return handle;
+        }
+
+        @Override
+        public ByteBuffer getData() {
+            return data;
+        }
+
+        @Override
+        protected void finalize() throws Throwable {
+            try {
+                // Waits for attachments in progress, see Wrapper#attachSharedDictionary.
+                synchronized (this) {
+                    nativeReleaseSharedDictionary(handle);
+                }
+            } finally {
+                super.finalize();
+            }
+        }
+    }
+
+    /**
+     * Returns raw or serialized dictionary prepared through the process-wide registry.
+     * <p>
+     * Data of the same type and contents is prepared only once while any instance
+     * returned for it (or an encoder it is attached to) is alive.
+     *
+     * @param dictionary           raw / serialized dictionary data; MUST be direct
+     * @param sharedDictionaryType dictionary data type
+     */
+    static PreparedDictionary prepareSharedDictionary(ByteBuffer dictionary, int sharedDictionaryType) {
+        if (!dictionary.isDirect()) {
+            throw new IllegalArgumentException("only direct buffers allowed");
+        }
+        long handle = nativeAcquireSharedDictionary(dictionary, sharedDictionaryType);
+        if (handle == 0) {
+            throw new IllegalStateException("OOM");
+        }
+        return new SharedPreparedDictionary(handle);
+    }
+
+    /**
+     * Compresses {@code input} remaining bytes into {@code output} in one shot.
+     * Both buffers MUST be direct; their positions are advanced by the amount
+     * of consumed / produced bytes.
+     *
+     * @return number of bytes written to {@code output}
+     */
+    static int compress(ByteBuffer input, ByteBuffer output, int quality, int lgwin, Encoder.Mode mode)
+            throws IOException {
+        if (!input.isDirect() || !output.isDirect()) {
+            throw new IllegalArgumentException("only direct buffers allowed");
+        }
+        long encodedSize = nativeCompress(input, input.position(), input.remaining(),
+                output, output.position(), output.remaining(),
+                quality, lgwin, mode != null ? mode.ordinal() : -1);
+        if (encodedSize < 0) {
+            throw new IOException("encoding failed");
+        }
+        ((Buffer) input).position(input.limit());
+        ((Buffer) output).position(output.position() + (int) encodedSize);
+        return (int) encodedSize;
+    }
+
+    /**
+     * Compresses as much of {@code input} remaining bytes as fits {@code output}
+     * remaining space into a complete stream. Both buffers MUST be direct; their
+     * positions are advanced by the amount of consumed / produced bytes.
+     *
+     * @return number of bytes written to {@code output}
+     */
+    static int compressToBudget(ByteBuffer input, ByteBuffer output, int quality, int lgwin, Encoder.Mode mode)
+            throws IOException {
+        if (!input.isDirect() || !output.isDirect()) {
+            throw new IllegalArgumentException("only direct buffers allowed");
+        }
+        long[] result = new long[2];
+        if (!nativeCompressToBudget(input, input.position(), input.remaining(),
+                output, output.position(), output.remaining(),
+                quality, lgwin, mode != null ? mode.ordinal() : -1, result)) {
+            throw new IOException("encoding failed");
+        }
+        ((Buffer) input).position(input.position() + (int) result[0]);
+        ((Buffer) output).position(output.position() + (int) result[1]);
+        return (int) result[1];
+    }
+
+    /**
+     * Compresses {@code length} bytes of {@code data} starting at {@code offset}
+     * as a part of a stream that begins at {@code data[0]}.
+     * <p>
+     * Outputs of consecutive chunks concatenate into a single valid stream;
+     * only the {@code last} chunk finishes it.
+     *
+     * @return compressed chunk
+     */
+    static byte[] compressChunk(byte[] data, int offset, int length, int quality, int lgwin,
+                                Encoder.Mode mode, boolean last) throws IOException {
+        return compressChunk(data, offset, length, quality, lgwin, mode, offset, last);
+    }
+
+    /**
+     * Compresses {@code length} bytes of {@code data} starting at {@code offset}
+     * as a part of a stream that has {@code streamOffset} bytes before the chunk.
+     *
+     * @return compressed chunk
+     */
+    static byte[] compressChunk(byte[] data, int offset, int length, int quality, int lgwin,
+                                Encoder.Mode mode, long streamOffset, boolean last) throws IOException {
+        byte[] result = nativeCompressChunk(data, offset, length, quality, lgwin,
+                mode != null ? mode.ordinal() : -1, streamOffset, last);
+        if (result == null) {
+            throw new IOException("encoding failed");
+        }
+        return result;
+    }
+
+    /**
+     * Encodes {@code data} (at most 16 MiB) as a metadata block that continues a
+     * stream after {@code streamOffset} bytes of flushed chunks.
+     *
+     * @param last whether the block finishes the stream
+     * @return encoded block
+     */
+    static byte[] encodeMetadata(byte[] data, long streamOffset, boolean last) throws IOException {
+        byte[] result = nativeEncodeMetadata(data, streamOffset, last);
+        if (result == null) {
+            throw new IOException("encoding failed");
+        }
+        return result;
+    }
+
+    /**
+     * Joins fragments encoded with {@link Encoder.Parameter#FRAGMENT} into a single
+     * stream with window {@code lgwin}.
+     *
+     * @return joined stream
+     */
+    static byte[] concatenate(byte[][] fragments, int lgwin) throws IOException {
+        for (byte[] fragment : fragments) {
+            if (fragment == null) {
+                throw new NullPointerException("fragment");
+            }
+        }
+        byte[] result = nativeConcatenate(fragments, lgwin);
+        if (result == null) {
+            throw new IOException("invalid window or stream is too long");
+        }
+        return result;
+    }
+
+    /**
+     * Trains a raw dictionary of at most {@code limit} bytes on samples stored one
+     * after another in {@code samples}.
+     *
+     * @param serialized whether to return it in shared dictionary format
+     * @return trained dictionary
+     */
+    static byte[] trainDictionary(byte[] samples, int[] sizes, int limit, boolean serialized) {
+        byte[] result = nativeTrainDictionary(samples, sizes, limit, serialized);
+        if (result == null) {
+            throw new IllegalStateException("dictionary training failed");
+        }
+        return result;
+    }
+
+    /**
+     * Trains an encoder profile for {@code quality} on samples stored one after
+     * another in {@code samples}.
+     */
+    static byte[] trainProfile(byte[] samples, int[] sizes, int quality) {
+        byte[] result = nativeTrainProfile(samples, sizes, quality);
+        if (result == null) {
+            throw new IllegalStateException("profile training failed");
+        }
+        return result;
+    }
+
+    /**
+     * Returns the worst-case one-shot compressed size for the given input size.
+     */
+    static long maxCompressedSize(long inputSize) {
+        return nativeMaxCompressedSize(inputSize);
+    }
+
+    /**
+     * Returns approximate peak of native memory used by encoder state.
+     */
+    static long estimatePeakMemory(int quality, int lgwin, long sizeHint) {
+        return nativeEstimatePeakMemory(quality, lgwin, sizeHint);
+    }
+
+    /**
+     * Predicts compressed size and encoding time of {@code input} remaining bytes;
+     * buffer position is not changed.
+     */
+    static CompressionEstimate estimate(ByteBuffer input, int quality, int lgwin) {
+        long[] result = new long[2];
+        boolean ok;
+        if (input.isDirect()) {
+            ok = nativeEstimate(quality, lgwin, input, null, input.position(), input.remaining(), result);
+        } else if (input.hasArray()) {
+            ok = nativeEstimate(quality, lgwin, null, input.array(),
+                    input.arrayOffset() + input.position(), input.remaining(), result);
+        } else {
+            /* Read-only heap buffer; copy without moving the original. */
+            byte[] copy = new byte[input.remaining()];
+            input.duplicate().get(copy);
+            ok = nativeEstimate(quality, lgwin, null, copy, 0, copy.length, result);
+        }
+        if (!ok) {
+            throw new IllegalArgumentException("estimation failed");
+        }
+        return new CompressionEstimate(result[0], result[1]);
+    }
+
     static class Wrapper {
-        protected final long[] context = new long[5];
-        private final ByteBuffer inputBuffer;
+        /* Status bits; see encoder_jni.cc */
+        private static final int SUCCESS = 1;
+        private static final int HAS_MORE_OUTPUT = 2;
+        private static final int HAS_REMAINING_INPUT = 4;
+        private static final int IS_FINISHED = 8;
+
+        private long handle;
+        private int status = SUCCESS;
+        private final ByteBuffer ownInputBuffer;
+        private ByteBuffer inputBuffer;
+        private final ByteBuffer outputBuffer;
+        private final int quality;
+        private final int lgwin;
+        private final Encoder.Mode mode;
+        private final int allocator;
         private boolean fresh = true;
 
         Wrapper(int inputBufferSize, int quality, int lgwin, Encoder.Mode mode)
                 throws IOException {
+            this(inputBufferSize, quality, lgwin, mode, 0);
+        }
+
+        Wrapper(int inputBufferSize, int quality, int lgwin, Encoder.Mode mode, int allocator)
+                throws IOException {
             if (inputBufferSize <= 0) {
                 throw new IOException("buffer size must be positive");
             }
-            this.context[1] = inputBufferSize;
-            this.context[2] = quality;
-            this.context[3] = lgwin;
-            this.context[4] = mode != null ? mode.ordinal() : -1;
-            this.inputBuffer = nativeCreate(this.context);
-            if (this.context[0] == 0) {
+            long[] context = new long[6];
+            context[1] = inputBufferSize;
+            context[2] = quality;
+            context[3] = lgwin;
+            context[4] = mode != null ? mode.ordinal() : -1;
+            context[5] = allocator;
+            this.quality = quality;
+            this.lgwin = lgwin;
+            this.mode = mode;
+            this.allocator = allocator;
+            this.ownInputBuffer = nativeCreate(context);
+            this.inputBuffer = ownInputBuffer;
+            if (context[0] == 0) {
+                throw new IOException("failed to initialize native brotli encoder");
+            }
+            this.handle = context[0];
+            this.outputBuffer = nativeGetOutputBuffer(handle);
+            if (this.outputBuffer == null) {
+                destroy();
                 throw new IOException("failed to initialize native brotli encoder");
             }
-            this.context[1] = 1;
-            this.context[2] = 0;
-            this.context[3] = 0;
-            this.context[4] = 0;
+        }
+
+        private Wrapper(Wrapper original) throws IOException {
+            long[] context = new long[2];
+            context[1] = original.ownInputBuffer.capacity();
+            this.quality = original.quality;
+            this.lgwin = original.lgwin;
+            this.mode = original.mode;
+            this.allocator = original.allocator;
+            this.ownInputBuffer = nativeFork(original.handle, context);
+            this.inputBuffer = ownInputBuffer;
+            if (context[0] == 0) {
+                throw new IOException("failed to fork native brotli encoder");
+            }
+            this.handle = context[0];
+            this.outputBuffer = nativeGetOutputBuffer(handle);
+            if (this.outputBuffer == null) {
+                destroy();
+                throw new IOException("failed to fork native brotli encoder");
+            }
+            this.status = original.status;
+            this.fresh = original.fresh;
+        }
+
+        /**
+         * Creates a copy of encoder that continues the stream from the current position.
+         * <p>
+         * All pushed input should be flushed and all output pulled. Encoders with attached
+         * dictionaries can not be copied.
+         */
+        Wrapper fork() throws IOException {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            return new Wrapper(this);
         }
 
         boolean attachDictionary(ByteBuffer dictionary) {
             if (!dictionary.isDirect()) {
                 throw new IllegalArgumentException("only direct buffers allowed");
             }
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli decoder is already destroyed");
             }
             if (!fresh) {
                 throw new IllegalStateException("decoding is already started");
             }
-            return nativeAttachDictionary(context, dictionary);
+            return nativeAttachDictionary(handle, dictionary);
+        }
+
+        /**
+         * Fills the window with the tail of input compressed by a previous run, so that
+         * the stream continues it; {@link Encoder.Parameter#STREAM_OFFSET} MUST be set
+         * to the size of that input first.
+         *
+         * @param window direct buffer; its remaining bytes are used
+         */
+        boolean primeWindow(ByteBuffer window) {
+            if (!window.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            return nativePrimeWindow(handle, window, window.position(), window.remaining());
+        }
+
+        boolean attachSharedDictionary(SharedPreparedDictionary dictionary) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            // Holding the lock keeps the dictionary reachable until the encoder takes its
+            // reference, as the finalizer synchronizes on it as well.
+            synchronized (dictionary) {
+                return nativeAttachSharedDictionary(handle, dictionary.getHandle());
+            }
+        }
+
+        /**
+         * Makes encoder stage input in {@code buffer} instead of the buffer allocated with it.
+         * <p>
+         * The buffer is referenced until replaced or the encoder is destroyed.
+         *
+         * @param buffer direct buffer; null to return to the own one
+         * @return false if staged input is not consumed yet
+         */
+        boolean setInputBuffer(ByteBuffer buffer) {
+            if (buffer != null && !buffer.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!nativeSetInputBuffer(handle, buffer)) {
+                return false;
+            }
+            inputBuffer = (buffer != null) ? buffer : ownInputBuffer;
+            ((Buffer) inputBuffer).clear();
+            return true;
+        }
+
+        /**
+         * Makes encoder store near-random input blocks without searching them for matches.
+         * Setting is kept over {@link #reset()}.
+         */
+        boolean setSkipIncompressible(boolean enable) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            return nativeSetSkipIncompressible(handle, enable);
+        }
+
+        /**
+         * Caps encoder working memory; idle memory is released after each flush.
+         * Setting is kept over {@link #reset()}.
+         *
+         * @param limit bytes, or 0 for unlimited
+         */
+        boolean setMemoryLimit(long limit) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            return nativeSetMemoryLimit(handle, limit);
+        }
+
+        /**
+         * Reserves native memory for this encoder in {@link NativeMemoryBudget}, waiting up
+         * to {@code waitMillis} for room, then settling for at least {@code minBytes}.
+         * Reservation is kept over {@link #reset()} and released by {@link #destroy()}.
+         *
+         * @return reserved bytes, or 0 if the budget has no room
+         */
+        long reserveMemory(long bytes, long minBytes, long waitMillis) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            return nativeReserveMemory(handle, bytes, minBytes, waitMillis);
+        }
+
+        /**
+         * Sets one of {@link Encoder.Parameter} values by its {@code BrotliEncoderParameter}
+         * code. Setting is kept over {@link #reset()}.
+         */
+        boolean setParameter(int parameter, int value) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            return nativeSetParameter(handle, parameter, value);
+        }
+
+        /**
+         * Sets a profile made by {@link Encoder#trainProfile(java.util.List, int)}.
+         * Setting is kept over {@link #reset()}.
+         *
+         * @param profile profile data, or {@code null} to clear it
+         */
+        boolean setProfile(byte[] profile) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            return nativeSetProfile(handle, profile);
+        }
+
+        /**
+         * Returns number of input bytes of the current stream stored uncompressed
+         * by the entropy pre-scan.
+         */
+        long getStoredIncompressibleBytes() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            return nativeGetStoredIncompressibleBytes(handle);
+        }
+
+        /**
+         * Returns per-stage counters of the current stream; zeroes unless collection
+         * is enabled.
+         */
+        EncoderStats getStats() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            long[] stats = new long[6];
+            nativeGetStats(handle, stats);
+            return new EncoderStats(stats[0], stats[1], stats[2], stats[3], stats[4], stats[5]);
+        }
+
+        /**
+         * Returns CRC-32C of input consumed so far; 0 unless checksum is enabled.
+         */
+        int getChecksum() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            return nativeGetChecksum(handle);
+        }
+
+        /**
+         * Returns number of bytes native encoder reports as produced so far; output of
+         * {@link #compressBatch} is not counted.
+         */
+        long getTotalOut() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            return nativeGetTotalOut(handle);
         }
 
         void push(Operation op, int length) {
             if (length < 0) {
                 throw new IllegalArgumentException("negative block length");
             }
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli encoder is already destroyed");
             }
             if (!isSuccess() || hasMoreOutput()) {
@@ -141,56 +733,228 @@ class EncoderJNI {
             if (hasRemainingInput() && length != 0) {
                 throw new IllegalStateException("pushing input to encoder over previous input");
             }
-            context[1] = op.ordinal();
             fresh = false;
-            nativePush(context, length);
+            status = nativePush(handle, op.ordinal(), length);
+        }
+
+        /**
+         * Pushes data straight from a heap array, without staging it in the input buffer.
+         * <p>
+         * Only a bounded window of the array is consumed per invocation; while
+         * {@link #hasRemainingInput()} the rest of the data MUST be pushed again (after
+         * pulling the output, if any). {@code op} takes effect with the last window.
+         *
+         * @return number of consumed bytes
+         */
+        int push(Operation op, byte[] data, int offset, int length) {
+            if (offset < 0 || length < 0 || offset > data.length - length) {
+                throw new IndexOutOfBoundsException("invalid input region");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!isSuccess() || hasMoreOutput()) {
+                throw new IllegalStateException("pushing input to encoder in unexpected state");
+            }
+            fresh = false;
+            long result = nativePushArray(handle, op.ordinal(), data, offset, length);
+            status = (int) result;
+            return (int) (result >>> 32);
+        }
+
+        /**
+         * Compresses straight from {@code srcs} into {@code dsts}; all buffers MUST be direct.
+         * <p>
+         * Sources are consumed and destinations filled in order; positions of all the
+         * buffers are advanced. Returns when destinations are full or {@code op} is
+         * complete; in the former case it MUST be repeated with the rest of input.
+         */
+        void push(Operation op, ByteBuffer[] srcs, ByteBuffer[] dsts) {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!isSuccess()) {
+                throw new IllegalStateException("pushing input to encoder in unexpected state");
+            }
+            int[] srcRegions = regions(srcs);
+            int[] dstRegions = regions(dsts);
+            fresh = false;
+            status = nativePushVectored(handle, op.ordinal(), srcs, srcRegions, dsts, dstRegions);
+            if (isSuccess()) {
+                for (int i = 0; i < srcs.length; ++i) {
+                    ((Buffer) srcs[i]).position(srcRegions[2 * i]);
+                }
+                for (int i = 0; i < dsts.length; ++i) {
+                    ((Buffer) dsts[i]).position(dstRegions[2 * i]);
+                }
+            }
+        }
+
+        private static int[] regions(ByteBuffer[] buffers) {
+            int[] regions = new int[2 * buffers.length];
+            for (int i = 0; i < buffers.length; ++i) {
+                if (!buffers[i].isDirect()) {
+                    throw new IllegalArgumentException("only direct buffers allowed");
+                }
+                regions[2 * i] = buffers[i].position();
+                regions[2 * i + 1] = buffers[i].limit();
+            }
+            return regions;
         }
 
         boolean isSuccess() {
-            return context[1] != 0;
+            return (status & SUCCESS) != 0;
         }
 
         boolean hasMoreOutput() {
-            return context[2] != 0;
+            return (status & HAS_MORE_OUTPUT) != 0;
         }
 
         boolean hasRemainingInput() {
-            return context[3] != 0;
+            return (status & HAS_REMAINING_INPUT) != 0;
         }
 
         boolean isFinished() {
-            return context[4] != 0;
+            return (status & IS_FINISHED) != 0;
         }
 
         ByteBuffer getInputBuffer() {
             return inputBuffer;
         }
 
+        /**
+         * Pulls the next piece of output.
+         * <p>
+         * The same buffer is returned by every invocation; all the produced data
+         * MUST be consumed before pulling again.
+         */
         ByteBuffer pull() {
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli encoder is already destroyed");
             }
             if (!isSuccess() || !hasMoreOutput()) {
                 throw new IllegalStateException("pulling while data is not ready");
             }
             fresh = false;
-            return nativePull(context);
+            long result = nativePull(handle);
+            status = (int) result;
+            ((Buffer) outputBuffer).clear();
+            ((Buffer) outputBuffer).limit((int) (result >>> 32));
+            return outputBuffer;
+        }
+
+        /**
+         * Compresses each of {@code count} input slices into a separate stream.
+         * <p>
+         * Encoder is reset before every slice. Compressed streams are written one after
+         * another to the remaining part of {@code output}, until one does not fit.
+         * Both buffers MUST be direct; {@code output} position is advanced past the
+         * written data.
+         *
+         * @param slices  {offset, length} pairs of absolute {@code input} indices
+         * @param offsets receives absolute {@code output} index of each stream start,
+         *                followed by the end of the last stream
+         * @return number of compressed slices
+         */
+        int compressBatch(ByteBuffer input, int[] slices, int count, ByteBuffer output, int[] offsets)
+                throws IOException {
+            if (!input.isDirect() || !output.isDirect()) {
+                throw new IllegalArgumentException("only direct buffers allowed");
+            }
+            if (count < 0 || count > slices.length / 2 || count >= offsets.length) {
+                throw new IndexOutOfBoundsException("invalid slice count");
+            }
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            fresh = false;
+            int done = nativeCompressBatch(handle, input, slices, count,
+                    output, output.position(), output.remaining(), offsets);
+            if (done < 0) {
+                throw new IOException("encoding failed");
+            }
+            ((Buffer) output).position(offsets[done]);
+            return done;
+        }
+
+        /**
+         * Compresses file {@code input} to file {@code output} natively; data does not
+         * pass through Java. Encoder MUST be fresh; it is left unusable.
+         *
+         * @param threads maximal number of threads; more than one are used only for
+         *                inputs bigger than max(4 MiB, window) and without dictionaries
+         * @return compressed size
+         */
+        long compressFile(String input, String output, int threads) throws IOException {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!fresh) {
+                throw new IllegalStateException("encoding is already started");
+            }
+            fresh = false;
+            long result = nativeCompressFile(handle, input, output, (lgwin < 0) ? 22 : lgwin, threads);
+            if (result == -1) {
+                throw new IOException("failed to read " + input + " or write " + output);
+            } else if (result < 0) {
+                throw new IOException("encoding failed");
+            }
+            return result;
+        }
+
+        /**
+         * Checks if encoder was created with the given parameters.
+         */
+        boolean matches(int quality, int lgwin, Encoder.Mode mode, int allocator) {
+            return this.quality == quality && this.lgwin == lgwin && this.mode == mode
+                    && this.allocator == allocator;
+        }
+
+        /**
+         * Prepares encoder for a new stream with the same parameters.
+         * Native buffers and hash tables are kept; attached dictionaries are released.
+         *
+         * @return false if encoder could not be reset; it should be destroyed then
+         */
+        boolean reset() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            if (!nativeReset(handle)) {
+                return false;
+            }
+            status = SUCCESS;
+            ((Buffer) inputBuffer).clear();
+            fresh = true;
+            return true;
+        }
+
+        /**
+         * Returns memory used by native encoder state.
+         */
+        MemoryStats getMemoryStats() {
+            if (handle == 0) {
+                throw new IllegalStateException("brotli encoder is already destroyed");
+            }
+            long[] stats = new long[3];
+            nativeGetMemoryStats(handle, stats);
+            return new MemoryStats(stats[0], stats[1], stats[2]);
         }
 
         /**
          * Releases native resources.
          */
         void destroy() {
-            if (context[0] == 0) {
+            if (handle == 0) {
                 throw new IllegalStateException("brotli encoder is already destroyed");
             }
-            nativeDestroy(context);
-            context[0] = 0;
+            nativeDestroy(handle);
+            handle = 0;
         }
 
         @Override
         protected void finalize() throws Throwable {
-            if (context[0] != 0) {
+            if (handle != 0) {
                 /* TODO: log resource leak? */
                 destroy();
             }
@@ -0,0 +1,75 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+import java.io.IOException;
+import java.util.ArrayDeque;
+import java.util.Iterator;
+
+/**
+ * Per-thread pool of resettable native encoders, keyed by (quality, lgwin, mode, allocator).
+ * <p>
+ * Reusing an encoder saves allocation and zeroing of its ring buffer and hash tables,
+ * which dominates the cost of compressing small payloads.
+ */
+final class EncoderPool {
+    /**
+     * Input buffer size of pooled encoders; larger payloads are not pooled.
+     */
+    static final int BUFFER_SIZE = 65536;
+
+    private static final int MAX_IDLE_PER_THREAD = 4;
+
+    private static final ThreadLocal<ArrayDeque<EncoderJNI.Wrapper>> IDLE =
+            ThreadLocal.withInitial(ArrayDeque::new);
+
+    // Disallow instantiation.
+    private EncoderPool() {
+    }
+
+    /**
+     * Takes an idle encoder with given parameters, or creates a new one.
+     */
+    static EncoderJNI.Wrapper acquire(int quality, int lgwin, Encoder.Mode mode, int allocator)
+            throws IOException {
+        Iterator<EncoderJNI.Wrapper> it = IDLE.get().iterator();
+        while (it.hasNext()) {
+            EncoderJNI.Wrapper encoder = it.next();
+            if (encoder.matches(quality, lgwin, mode, allocator)) {
+                it.remove();
+                return encoder;
+            }
+        }
+        return new EncoderJNI.Wrapper(BUFFER_SIZE, quality, lgwin, mode, allocator);
+    }
+
+    /**
+     * Resets the encoder and returns it to the pool of the current thread.
+     */
+    static void release(EncoderJNI.Wrapper encoder) {
+        if (!encoder.reset()) {
+            encoder.destroy();
+            return;
+        }
+        ArrayDeque<EncoderJNI.Wrapper> idle = IDLE.get();
+        idle.addFirst(encoder);
+        if (idle.size() > MAX_IDLE_PER_THREAD) {
+            idle.removeLast().destroy();
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+/**
+ * Snapshot of per-stage work counters of a single encoder state.
+ * <p>
+ * Counters are collected only when enabled with {@link Encoder.Parameter#COLLECT_STATS}
+ * or {@link Encoder.Parameters#setStatsListener(Encoder.StatsListener)}, and are taken
+ * since creation or the last reset. Tick unit is CPU-specific (time-stamp counter on
+ * x86), so only ratios of tick counters are meaningful, e.g. to see which stage
+ * dominates at a given quality.
+ */
+public final class EncoderStats {
+    private final long metaBlocks;
+    private final long matches;
+    private final long literals;
+    private final long matchSearchTicks;
+    private final long metaBlockTicks;
+    private final long storeTicks;
+
+    public EncoderStats(long metaBlocks, long matches, long literals, long matchSearchTicks,
+                        long metaBlockTicks, long storeTicks) {
+        this.metaBlocks = metaBlocks;
+        this.matches = matches;
+        this.literals = literals;
+        this.matchSearchTicks = matchSearchTicks;
+        this.metaBlockTicks = metaBlockTicks;
+        this.storeTicks = storeTicks;
+    }
+
+    /**
+     * @return number of meta-blocks produced; input blocks at qualities 0 and 1
+     */
+    public long getMetaBlocks() {
+        return metaBlocks;
+    }
+
+    /**
+     * @return number of backward references found; not counted at qualities 0 and 1
+     */
+    public long getMatches() {
+        return matches;
+    }
+
+    /**
+     * @return number of bytes encoded as literals; not counted at qualities 0 and 1
+     */
+    public long getLiterals() {
+        return literals;
+    }
+
+    /**
+     * @return ticks spent in backward reference search; all the work of qualities 0 and 1
+     */
+    public long getMatchSearchTicks() {
+        return matchSearchTicks;
+    }
+
+    /**
+     * @return ticks spent in block splitting and histogram clustering
+     */
+    public long getMetaBlockTicks() {
+        return metaBlockTicks;
+    }
+
+    /**
+     * @return ticks spent in writing prefix codes and commands
+     */
+    public long getStoreTicks() {
+        return storeTicks;
+    }
+
+    @Override
+    public String toString() {
+        return "EncoderStats{metaBlocks=" + metaBlocks + ", matches=" + matches
+                + ", literals=" + literals + ", matchSearchTicks=" + matchSearchTicks
+                + ", metaBlockTicks=" + metaBlockTicks + ", storeTicks=" + storeTicks + '}';
+    }
+}
@@ -0,0 +1,186 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.encoder;
+
+import java.io.IOException;
+import java.io.InterruptedIOException;
+import java.io.OutputStream;
+import java.util.ArrayDeque;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/**
+ * Compresses a stream as independent chunks on a pool of worker threads.
+ * <p>
+ * The caller fills one chunk at a time; full chunks are handed to workers, each
+ * with a fresh native encoder, and compressed outputs are written to the
+ * destination strictly in submission order. Every chunk but the first is
+ * encoded with a stream offset, so the concatenation is a single regular
+ * brotli stream. At most {@code 2 * threads} chunks are in flight; the writer
+ * blocks on the oldest one beyond that.
+ */
+final class ParallelChunkEncoder {
+    private static final AtomicInteger THREAD_COUNTER = new AtomicInteger();
+
+    private final OutputStream destination;
+    private final int quality;
+    private final int lgwin;
+    private final Encoder.Mode mode;
+    private final int chunkSize;
+    private final int maxPending;
+    private final ExecutorService executor;
+    private final ArrayDeque<Pending> pending = new ArrayDeque<Pending>();
+    /* Input arrays of written chunks, reused for the next ones. */
+    private final ArrayDeque<byte[]> spare = new ArrayDeque<byte[]>();
+    private byte[] chunk;
+    private int chunkLength;
+    private long streamOffset;
+    boolean closed;
+
+    private static final class Pending {
+        final byte[] input;
+        final Future<byte[]> output;
+
+        Pending(byte[] input, Future<byte[]> output) {
+            this.input = input;
+            this.output = output;
+        }
+    }
+
+    ParallelChunkEncoder(OutputStream destination, Encoder.Parameters params, int threads, int chunkSize) {
+        if (threads < 1) {
+            throw new IllegalArgumentException("parallelism must be positive");
+        }
+        if (chunkSize <= 0) {
+            throw new IllegalArgumentException("chunk size must be positive");
+        }
+        if (destination == null) {
+            throw new NullPointerException("destination can not be null");
+        }
+        this.destination = destination;
+        this.quality = params.getQuality();
+        this.lgwin = params.getWindow();
+        this.mode = params.getMode();
+        this.chunkSize = chunkSize;
+        this.maxPending = 2 * threads;
+        this.executor = Executors.newFixedThreadPool(threads, new ThreadFactory() {
+            @Override
+            public Thread newThread(Runnable runnable) {
+                Thread thread = new Thread(runnable, "brotli4j-stream-encoder-" + THREAD_COUNTER.incrementAndGet());
+                thread.setDaemon(true);
+                return thread;
+            }
+        });
+        this.chunk = new byte[chunkSize];
+    }
+
+    void write(byte[] b, int off, int len) throws IOException {
+        while (len > 0) {
+            if (chunkLength == chunkSize) {
+                submit(false);
+            }
+            int limit = Math.min(len, chunkSize - chunkLength);
+            System.arraycopy(b, off, chunk, chunkLength, limit);
+            chunkLength += limit;
+            off += limit;
+            len -= limit;
+        }
+    }
+
+    void write(int b) throws IOException {
+        if (chunkLength == chunkSize) {
+            submit(false);
+        }
+        chunk[chunkLength++] = (byte) b;
+    }
+
+    /**
+     * Ends the current chunk and writes out everything submitted so far.
+     */
+    void flush() throws IOException {
+        if (chunkLength != 0) {
+            submit(false);
+        }
+        while (!pending.isEmpty()) {
+            writeOldest();
+        }
+        destination.flush();
+    }
+
+    void close() throws IOException {
+        if (closed) {
+            return;
+        }
+        closed = true;
+        try {
+            submit(true);
+            while (!pending.isEmpty()) {
+                writeOldest();
+            }
+        } finally {
+            executor.shutdownNow();
+            destination.close();
+        }
+    }
+
+    private void submit(final boolean last) throws IOException {
+        while (pending.size() >= maxPending) {
+            writeOldest();
+        }
+        final byte[] input = chunk;
+        final int length = chunkLength;
+        final long offset = streamOffset;
+        Future<byte[]> output = executor.submit(new Callable<byte[]>() {
+            @Override
+            public byte[] call() throws IOException {
+                return EncoderJNI.compressChunk(input, 0, length, quality, lgwin, mode, offset, last);
+            }
+        });
+        pending.addLast(new Pending(input, output));
+        streamOffset += length;
+        chunkLength = 0;
+        if (!last) {
+            byte[] next = spare.pollFirst();
+            chunk = next != null ? next : new byte[chunkSize];
+        }
+    }
+
+    private void writeOldest() throws IOException {
+        Pending oldest = pending.removeFirst();
+        byte[] output;
+        try {
+            output = oldest.output.get();
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            throw new InterruptedIOException("interrupted");
+        } catch (ExecutionException e) {
+            Throwable cause = e.getCause();
+            if (cause instanceof IOException) {
+                throw (IOException) cause;
+            }
+            throw new IOException("encoding failed", cause);
+        }
+        destination.write(output);
+        spare.addLast(oldest.input);
+    }
+}
@@ -23,11 +23,28 @@
 
 package com.aayushatharva.brotli4j.encoder;
 
+import java.io.IOException;
 import java.nio.ByteBuffer;
+import java.nio.file.Path;
 
 /**
  * Prepared dictionary data provider.
  */
 public interface PreparedDictionary {
     ByteBuffer getData();
+
+    /**
+     * Memory-maps a dictionary written by {@link PreparedDictionaryGenerator#save}.
+     * <p>
+     * Nothing is hashed or copied: encoders use the mapped pages directly, and they
+     * stay mapped while the returned object is reachable. The file MUST come from a
+     * trusted writer; only its header is validated.
+     *
+     * @param path prepared dictionary file
+     * @return dictionary ready to be attached to encoders
+     * @throws IOException if the file can not be mapped or is not a prepared dictionary
+     */
+    static PreparedDictionary load(Path path) throws IOException {
+        return PreparedDictionaryGenerator.load(path);
+    }
 }
@@ -22,11 +22,16 @@
 */
 package com.aayushatharva.brotli4j.encoder;
 
+import java.io.IOException;
 import java.nio.Buffer;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
 import java.nio.IntBuffer;
 import java.nio.ShortBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
+import java.util.List;
 
 /**
  * Java prepared (raw) dictionary producer.
@@ -34,7 +39,11 @@ import java.nio.ShortBuffer;
 public class PreparedDictionaryGenerator {
 
     private static final int MAGIC = 0xDEBCEDE0;
+    /* BROTLI_SHARED_DICTIONARY_RAW */
+    private static final int RAW_DICTIONARY_TYPE = 0;
     private static final long HASH_MULTIPLIER = 0x1fe35a7bd3579bd3L;
+    /* magic, source_offset, source_size, hash_bits, bucket_bits, slot_bits */
+    private static final int HEADER_SIZE = 6 * 4;
 
     private static class PreparedDictionaryImpl implements PreparedDictionary {
         private final ByteBuffer data;
@@ -57,6 +66,143 @@ public class PreparedDictionaryGenerator {
         return generate(src, 17, 3, 40, 5);
     }
 
+    /**
+     * Returns size of the flat prepared dictionary that starts at the beginning of
+     * {@code data}, as derived from its header; -1 if the header is not valid.
+     */
+    static long flatSize(ByteBuffer data) {
+        if (data.capacity() < HEADER_SIZE) {
+            return -1;
+        }
+        ByteBuffer header = data.duplicate().order(ByteOrder.nativeOrder());
+        if (header.getInt(0) != MAGIC) {
+            return -1;
+        }
+        long totalItems = header.getInt(4) & 0xFFFFFFFFL;
+        long sourceSize = header.getInt(8) & 0xFFFFFFFFL;
+        int bucketBits = header.getInt(16);
+        int slotBits = header.getInt(20);
+        if (bucketBits < 0 || bucketBits >= 24 || slotBits < 0 || slotBits > bucketBits
+                || bucketBits - slotBits >= 16) {
+            return -1;
+        }
+        return HEADER_SIZE + (4L << slotBits) + (2L << bucketBits) + 4 * totalItems + sourceSize;
+    }
+
+    /**
+     * Writes a dictionary made by {@link #generate} to a file in its in-memory layout.
+     * <p>
+     * The file is loaded back without any hashing by {@link PreparedDictionary#load(Path)}.
+     * Multi-byte fields are in the native byte order of the writing machine, so the
+     * file is only usable on hosts of the same endianness.
+     *
+     * @param dictionary dictionary produced by {@link #generate}
+     * @param path       file to (over)write
+     * @throws IOException if writing fails
+     */
+    public static void save(PreparedDictionary dictionary, Path path) throws IOException {
+        ByteBuffer data = dictionary.getData().duplicate();
+        if (flatSize(data) != data.capacity()) {
+            throw new IllegalArgumentException("only dictionaries made by generate can be saved");
+        }
+        ((Buffer) data).clear();
+        try (FileChannel channel = FileChannel.open(path, StandardOpenOption.CREATE,
+                StandardOpenOption.TRUNCATE_EXISTING, StandardOpenOption.WRITE)) {
+            while (data.hasRemaining()) {
+                channel.write(data);
+            }
+        }
+    }
+
+    /**
+     * Memory-maps a dictionary written by {@link #save}.
+     *
+     * @see PreparedDictionary#load(Path)
+     */
+    static PreparedDictionary load(Path path) throws IOException {
+        try (FileChannel channel = FileChannel.open(path, StandardOpenOption.READ)) {
+            long size = channel.size();
+            if (size > Integer.MAX_VALUE) {
+                throw new IOException("prepared dictionary file is too large");
+            }
+            ByteBuffer data = channel.map(FileChannel.MapMode.READ_ONLY, 0, size);
+            if (flatSize(data) != size) {
+                throw new IOException("not a prepared dictionary file");
+            }
+            return new PreparedDictionaryImpl(data);
+        }
+    }
+
+    /**
+     * Returns raw dictionary prepared natively and cached process-wide.
+     *
+     * @see #generateShared(ByteBuffer, int)
+     */
+    public static PreparedDictionary generateShared(ByteBuffer src) {
+        return generateShared(src, RAW_DICTIONARY_TYPE);
+    }
+
+    /**
+     * Returns dictionary prepared natively and cached process-wide.
+     * <p>
+     * Data is looked up by type and contents; if the same dictionary is still in use
+     * anywhere in the process, the already prepared instance is returned instead of
+     * preparing it again. It stays cached while any returned object or any encoder it
+     * is attached to is alive. Encoders attach such dictionaries without creating JNI
+     * global references.
+     *
+     * @param src                  raw / serialized dictionary data; MUST be direct
+     * @param sharedDictionaryType dictionary data type
+     */
+    public static PreparedDictionary generateShared(ByteBuffer src, int sharedDictionaryType) {
+        return EncoderJNI.prepareSharedDictionary(src, sharedDictionaryType);
+    }
+
+    /**
+     * Trains a raw (LZ77) dictionary on sample data.
+     *
+     * @see #train(List, int, boolean)
+     */
+    public static byte[] train(List<byte[]> samples, int maxSize) {
+        return train(samples, maxSize, false);
+    }
+
+    /**
+     * Trains a dictionary on sample data.
+     * <p>
+     * Substrings shared by most samples are picked, the most useful ones go to the end
+     * of the dictionary. When all samples fit into {@code maxSize} the result is their
+     * concatenation. Raw dictionaries can be passed to {@link #generate(ByteBuffer)} or
+     * {@link #generateShared(ByteBuffer)}; serialized ones are attached to the decoder
+     * and prepared for the encoder as {@code BROTLI_SHARED_DICTIONARY_SERIALIZED}.
+     *
+     * @param samples    typical payloads the dictionary is meant for
+     * @param maxSize    size limit of the raw dictionary in bytes
+     * @param serialized whether to wrap the result into shared dictionary format
+     * @return trained dictionary
+     */
+    public static byte[] train(List<byte[]> samples, int maxSize, boolean serialized) {
+        if (maxSize < 8) {
+            throw new IllegalArgumentException("maxSize is too small");
+        }
+        long totalSize = 0;
+        int[] sizes = new int[samples.size()];
+        for (int i = 0; i < sizes.length; ++i) {
+            sizes[i] = samples.get(i).length;
+            totalSize += sizes[i];
+        }
+        if (totalSize > Integer.MAX_VALUE - 8) {
+            throw new IllegalArgumentException("samples are too big");
+        }
+        byte[] joined = new byte[(int) totalSize];
+        int offset = 0;
+        for (byte[] sample : samples) {
+            System.arraycopy(sample, 0, joined, offset, sample.length);
+            offset += sample.length;
+        }
+        return EncoderJNI.trainDictionary(joined, sizes, maxSize, serialized);
+    }
+
     public static PreparedDictionary generate(ByteBuffer src,
                                               int bucketBits, int slotBits, int hashBits, int blockBits) {
         ((Buffer) src).clear();  // Just in case...
@@ -18,7 +18,15 @@ package com.aayushatharva.brotli4j;
 
 import org.junit.jupiter.api.Test;
 
+import java.io.IOException;
+import java.nio.file.FileSystems;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.attribute.PosixFilePermissions;
+import java.util.Arrays;
+
 import static org.junit.jupiter.api.Assertions.*;
+import static org.junit.jupiter.api.Assumptions.assumeTrue;
 
 class Brotli4jLoaderTest {
 
@@ -26,4 +34,32 @@ class Brotli4jLoaderTest {
     void load() {
         assertDoesNotThrow(Brotli4jLoader::ensureAvailability);
     }
+
+    @Test
+    void variant() {
+        Brotli4jLoader.ensureAvailability();
+        String variant = Brotli4jLoader.getVariant();
+        // No variant is reported for a library found in java.library.path.
+        if (variant != null && System.getProperty(Brotli4jLoader.VARIANT_PROPERTY) == null) {
+            assertTrue(Arrays.asList("baseline", "x86-64-v2", "x86-64-v3", "x86-64-v4", "armv8.2-a")
+                    .contains(variant), variant);
+        }
+    }
+
+    @Test
+    void cacheDirectoryMustBePrivate() throws IOException {
+        assumeTrue(FileSystems.getDefault().supportedFileAttributeViews().contains("posix"));
+        Path dir = Files.createTempDirectory("brotli4j-cache");
+        try {
+            Files.setPosixFilePermissions(dir, PosixFilePermissions.fromString("rwx------"));
+            assertEquals(dir, Brotli4jLoader.createPrivateDirectory(dir));
+
+            Files.setPosixFilePermissions(dir, PosixFilePermissions.fromString("rwxrwxrwx"));
+            assertThrows(IOException.class, () -> Brotli4jLoader.createPrivateDirectory(dir));
+            Files.setPosixFilePermissions(dir, PosixFilePermissions.fromString("rwx-w----"));
+            assertThrows(IOException.class, () -> Brotli4jLoader.createPrivateDirectory(dir));
+        } finally {
+            Files.delete(dir);
+        }
+    }
 }
@@ -0,0 +1,44 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.common;
+
+import com.aayushatharva.brotli4j.Brotli4jLoader;
+import org.junit.jupiter.api.BeforeAll;
+import org.junit.jupiter.api.Test;
+
+import java.io.IOException;
+import java.nio.file.Paths;
+
+import static org.junit.jupiter.api.Assertions.assertTrue;
+
+class BrotliCommonTest {
+
+    @BeforeAll
+    static void load() {
+        Brotli4jLoader.ensureAvailability();
+    }
+
+    @Test
+    void builtInDictionaryData() throws IOException {
+        // Default native build carries the RFC dictionary.
+        assertTrue(BrotliCommon.isDictionaryDataSet());
+        // Nothing is opened, so the file does not have to exist.
+        BrotliCommon.setDictionaryData(Paths.get("no-such-dictionary.bin"));
+        BrotliCommon.setDictionaryData(new byte[BrotliCommon.RFC_DICTIONARY_SIZE]);
+    }
+}
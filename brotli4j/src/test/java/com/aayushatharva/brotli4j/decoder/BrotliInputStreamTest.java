@@ -17,12 +17,21 @@
 package com.aayushatharva.brotli4j.decoder;
 
 import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.encoder.BrotliOutputStream;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+import com.aayushatharva.brotli4j.encoder.PreparedDictionary;
+import com.aayushatharva.brotli4j.encoder.PreparedDictionaryGenerator;
 import org.junit.jupiter.api.BeforeAll;
 import org.junit.jupiter.api.Test;
 
 import java.io.ByteArrayInputStream;
 import java.io.ByteArrayOutputStream;
 import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.List;
 
 import static org.junit.jupiter.api.Assertions.*;
 
@@ -53,4 +62,101 @@ class BrotliInputStreamTest {
 
         assertEquals("Meow", baos.toString());
     }
+
+    @Test
+    void preparedDictionary() throws IOException {
+        byte[] words = "Meow, Woof, Quack, Moo; ".getBytes();
+        byte[] rawBytes = new byte[4096];
+        for (int i = 0; i < rawBytes.length; ++i) {
+            rawBytes[i] = words[i % words.length];
+        }
+        byte[] serializedBytes = PreparedDictionaryGenerator.train(
+                Collections.singletonList(rawBytes), rawBytes.length, true);
+        ByteBuffer raw = ByteBuffer.allocateDirect(rawBytes.length);
+        raw.put(rawBytes);
+        ByteBuffer serialized = ByteBuffer.allocateDirect(serializedBytes.length);
+        serialized.put(serializedBytes);
+        byte[] data = "Woof, Quack, Meow, Moo; Meow, Woof, Quack".getBytes();
+
+        byte[] compressed = compress(data, PreparedDictionaryGenerator.generate(raw));
+        DecoderDictionary dictionary = DecoderDictionary.prepare(raw);
+        // The same parsed dictionary serves any number of streams.
+        for (int i = 0; i < 3; ++i) {
+            BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed));
+            input.attachDictionary(dictionary);
+            assertArrayEquals(data, readAll(input));
+        }
+
+        // Nothing else could be attached on top of it.
+        BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed));
+        input.attachDictionary(dictionary);
+        assertThrows(IOException.class, () -> input.attachDictionary(raw));
+
+        compressed = compress(data, PreparedDictionaryGenerator.generateShared(serialized, 1));
+        BrotliInputStream serializedInput = new BrotliInputStream(new ByteArrayInputStream(compressed));
+        serializedInput.attachDictionary(DecoderDictionary.prepareSerialized(serialized));
+        assertArrayEquals(data, readAll(serializedInput));
+    }
+
+    @Test
+    void metadata() throws IOException {
+        byte[] record = "Meow, Woof, Quack, Moo; ".getBytes();
+        byte[] big = new byte[100000];
+        for (int i = 0; i < big.length; ++i) {
+            big[i] = (byte) (i * 31);
+        }
+
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream output = new BrotliOutputStream(baos, new Encoder.Parameters().setQuality(5));
+        output.writeMetadata(new byte[0]);
+        output.write(record);
+        output.writeMetadata("one".getBytes());
+        output.write(record);
+        output.write(record);
+        output.writeMetadata(big);
+        output.write(record);
+        output.close();
+
+        final List<Long> positions = new ArrayList<>();
+        final List<byte[]> blocks = new ArrayList<>();
+        // Small input buffer makes blocks arrive in many pieces.
+        BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(baos.toByteArray()), 7);
+        input.setMetadataListener(new Decoder.MetadataListener() {
+            @Override
+            public void onMetadata(long position, byte[] data) {
+                positions.add(position);
+                blocks.add(data);
+            }
+        });
+        assertEquals(4 * record.length, readAll(input).length);
+
+        assertEquals(Arrays.asList(0L, (long) record.length, 3L * record.length), positions);
+        assertArrayEquals(new byte[0], blocks.get(0));
+        assertArrayEquals("one".getBytes(), blocks.get(1));
+        assertArrayEquals(big, blocks.get(2));
+
+        // Without listener metadata is skipped.
+        input = new BrotliInputStream(new ByteArrayInputStream(baos.toByteArray()));
+        assertEquals(4 * record.length, readAll(input).length);
+    }
+
+    private static byte[] compress(byte[] data, PreparedDictionary dictionary) throws IOException {
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream output = new BrotliOutputStream(baos, new Encoder.Parameters().setQuality(11));
+        output.attachDictionary(dictionary);
+        output.write(data);
+        output.close();
+        return baos.toByteArray();
+    }
+
+    private static byte[] readAll(BrotliInputStream input) throws IOException {
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        byte[] buffer = new byte[256];
+        int read;
+        while ((read = input.read(buffer)) > -1) {
+            baos.write(buffer, 0, read);
+        }
+        input.close();
+        return baos.toByteArray();
+    }
 }
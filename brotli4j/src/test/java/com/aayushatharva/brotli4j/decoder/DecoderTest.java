@@ -17,10 +17,23 @@
 package com.aayushatharva.brotli4j.decoder;
 
 import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.encoder.BrotliSeekableOutputStream;
+import com.aayushatharva.brotli4j.encoder.Encoder;
 import org.junit.jupiter.api.BeforeAll;
 import org.junit.jupiter.api.Test;
 
+import java.io.ByteArrayInputStream;
 import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.channels.Channels;
+import java.nio.channels.FileChannel;
+import java.nio.channels.ReadableByteChannel;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
+import java.util.Arrays;
+import java.util.Random;
 
 import static org.junit.jupiter.api.Assertions.*;
 
@@ -39,4 +52,328 @@ class DecoderTest {
         assertEquals(DecoderJNI.Status.DONE, directDecompress.getResultStatus());
         assertEquals("Meow", new String(directDecompress.getDecompressedData()));
     }
+
+    @Test
+    void decompressWithPooledDecoder() throws IOException {
+        for (int i = 0; i < 3; i++) {
+            DirectDecompress directDecompress = Decoder.decompress(compressedData);
+            assertEquals(DecoderJNI.Status.DONE, directDecompress.getResultStatus());
+            assertEquals("Meow", new String(directDecompress.getDecompressedData()));
+        }
+    }
+
+    @Test
+    void decompressIntoBuffer() throws IOException {
+        ByteBuffer direct = ByteBuffer.allocateDirect(16);
+        assertEquals(4, Decoder.decompress(compressedData, direct));
+        assertEquals(4, direct.position());
+        byte[] decoded = new byte[4];
+        ((Buffer) direct).flip();
+        direct.get(decoded);
+        assertEquals("Meow", new String(decoded));
+
+        byte[] array = new byte[8];
+        assertEquals(4, Decoder.decompress(compressedData, array, 2, 6));
+        assertEquals("Meow", new String(array, 2, 4));
+
+        assertThrows(IOException.class, () -> Decoder.decompress(compressedData, new byte[3], 0, 3));
+    }
+
+    @Test
+    void decompressBatch() throws IOException {
+        int n = compressedData.length;
+        ByteBuffer src = ByteBuffer.allocateDirect(2 * n);
+        src.put(compressedData);
+        src.put(compressedData);
+        ByteBuffer dst = ByteBuffer.allocateDirect(16);
+        // Second slice is truncated.
+        int[] slices = new int[]{0, n, n, n - 3, n, n};
+        int[] offsets = new int[4];
+        DecoderJNI.Status[] statuses = new DecoderJNI.Status[3];
+
+        assertEquals(3, Decoder.decompressBatch(src, slices, dst, offsets, statuses));
+        assertArrayEquals(new DecoderJNI.Status[]{DecoderJNI.Status.DONE, DecoderJNI.Status.NEEDS_MORE_INPUT,
+                DecoderJNI.Status.DONE}, statuses);
+        assertArrayEquals(new int[]{0, 4, 4, 8}, offsets);
+        assertEquals(8, dst.position());
+
+        byte[] data = new byte[8];
+        ((Buffer) dst).flip();
+        dst.get(data);
+        assertEquals("MeowMeow", new String(data));
+    }
+
+    @Test
+    void decompressSkewedLiterals() throws IOException {
+        // Short code of the frequent literal followed by codes that do not fit the root table.
+        byte[] data = new byte[200000];
+        Random random = new Random(1);
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) (random.nextInt(10) < 6 ? 'a' : random.nextInt(256));
+        }
+        for (int quality = 0; quality <= 1; quality++) {
+            byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(quality));
+            DirectDecompress result = Decoder.decompress(compressed);
+            assertEquals(DecoderJNI.Status.DONE, result.getResultStatus());
+            assertArrayEquals(data, result.getDecompressedData());
+        }
+    }
+
+    @Test
+    void pooledDecoderCachesPrefixCodes() throws IOException {
+        // Literal statistics differ per stream, and so do their prefix codes.
+        byte[][] data = new byte[4][];
+        byte[][] compressed = new byte[data.length][];
+        for (int i = 0; i < data.length; i++) {
+            Random random = new Random(i);
+            int alphabet = 4 + 20 * i;
+            data[i] = new byte[4096];
+            for (int j = 0; j < data[i].length; j++) {
+                data[i][j] = (byte) ('A' + Math.min(random.nextInt(alphabet), random.nextInt(alphabet)));
+            }
+            compressed[i] = Encoder.compress(data[i], new Encoder.Parameters().setQuality(5));
+        }
+        // Codes are cached on the second sighting; later rounds decode from the cache.
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < data.length; i++) {
+                DirectDecompress result = Decoder.decompress(compressed[i]);
+                assertEquals(DecoderJNI.Status.DONE, result.getResultStatus());
+                assertArrayEquals(data[i], result.getDecompressedData());
+            }
+        }
+    }
+
+    @Test
+    void lowMemoryDecoder() throws IOException {
+        byte[] data = seekableTestData();
+        byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(5));
+
+        long[] retained = new long[2];
+        for (int lowMemory = 0; lowMemory < 2; lowMemory++) {
+            BrotliDecoderChannel channel = new BrotliDecoderChannel(
+                    Channels.newChannel(new ByteArrayInputStream(compressed)));
+            if (lowMemory == 1) {
+                channel.enableLowMemory();
+            }
+            ByteBuffer decoded = ByteBuffer.allocate(data.length);
+            while (channel.read(decoded) != -1) {
+                // Keep reading.
+            }
+            assertArrayEquals(data, decoded.array());
+            retained[lowMemory] = channel.getMemoryStats().getCurrentBytes();
+            channel.close();
+        }
+        // Prefix code tables are not kept after the last metablock.
+        assertTrue(retained[1] < retained[0]);
+    }
+
+    @Test
+    void decoderStats() throws IOException {
+        byte[] data = seekableTestData();
+        byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(5));
+
+        BrotliDecoderChannel channel = new BrotliDecoderChannel(
+                Channels.newChannel(new ByteArrayInputStream(compressed)));
+        channel.enableStats();
+        ByteBuffer decoded = ByteBuffer.allocate(data.length);
+        while (channel.read(decoded) != -1) {
+            // Keep reading.
+        }
+        assertArrayEquals(data, decoded.array());
+        DecoderStats stats = channel.getStats();
+        channel.close();
+        assertTrue(stats.getMetaBlocks() > 0);
+        assertTrue(stats.getPrefixCodes() > 0);
+        assertTrue(stats.getRingBufferAllocations() > 0);
+        // Dictionary words are the only bytes not produced by literals and copies.
+        assertTrue(stats.getLiteralBytes() + stats.getCopiedBytes() <= data.length);
+        assertTrue(stats.getLiteralBytes() + stats.getCopiedBytes() > 0);
+    }
+
+    @Test
+    void directDecoderChannel() throws IOException {
+        byte[] data = seekableTestData();
+        byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(5));
+        ReadableByteChannel source = Channels.newChannel(new ByteArrayInputStream(compressed));
+        // Small buffers make both input refills and full output happen many times.
+        ByteBuffer input = ByteBuffer.allocateDirect(37);
+        ((Buffer) input).limit(0);
+        ByteBuffer dst = ByteBuffer.allocateDirect(1000);
+        byte[] decoded = new byte[data.length];
+        int total = 0;
+        try (DirectDecoderChannel channel = new DirectDecoderChannel(source, input)) {
+            assertThrows(IllegalArgumentException.class, () -> channel.read(ByteBuffer.allocate(16)));
+            int read;
+            while ((read = channel.read(dst)) != -1) {
+                assertTrue(read > 0);
+                ((Buffer) dst).flip();
+                dst.get(decoded, total, read);
+                total += read;
+                ((Buffer) dst).clear();
+            }
+        }
+        assertEquals(data.length, total);
+        assertArrayEquals(data, decoded);
+
+        source = Channels.newChannel(new ByteArrayInputStream(compressed, 0, compressed.length - 1));
+        try (DirectDecoderChannel channel = new DirectDecoderChannel(source)) {
+            assertThrows(IOException.class, () -> {
+                while (channel.read(dst) != -1) {
+                    ((Buffer) dst).clear();
+                }
+            });
+        }
+    }
+
+    private static byte[] seekableTestData() {
+        byte[] data = new byte[300000];
+        Random random = new Random(5);
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i % 1000 < 500) ? 'a' + (i * 7) % 13 : 'a' + random.nextInt(26));
+        }
+        return data;
+    }
+
+    private static Path writeSeekable(byte[] data) throws IOException {
+        Path path = Files.createTempFile("brotli4j", ".br");
+        // Chunk offsets are both below and above the window size.
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(9).setWindow(18);
+        try (BrotliSeekableOutputStream output =
+                     new BrotliSeekableOutputStream(Files.newOutputStream(path), params, 65536)) {
+            output.write(data, 0, 100000);
+            output.flush();
+            output.write(data, 100000, data.length - 100000);
+        }
+        return path;
+    }
+
+    @Test
+    void seekableFileRandomAccess() throws IOException {
+        byte[] data = seekableTestData();
+        Path path = writeSeekable(data);
+        try {
+            // Whole file is a regular brotli stream.
+            DirectDecompress whole = Decoder.decompress(Files.readAllBytes(path));
+            assertEquals(DecoderJNI.Status.DONE, whole.getResultStatus());
+            assertArrayEquals(data, whole.getDecompressedData());
+
+            Random random = new Random(7);
+            try (BrotliSeekableFile file = Decoder.openSeekable(FileChannel.open(path, StandardOpenOption.READ))) {
+                assertEquals(data.length, file.size());
+                assertEquals(6, file.getChunkCount());
+                for (int i = 0; i < 20; i++) {
+                    int position = random.nextInt(data.length);
+                    ByteBuffer dst = ByteBuffer.allocate(100);
+                    int read = file.read(position, dst);
+                    assertTrue(read > 0);
+                    for (int j = 0; j < read; j++) {
+                        assertEquals(data[position + j], dst.get(j));
+                    }
+                }
+                assertEquals(-1, file.read(data.length, ByteBuffer.allocate(1)));
+            }
+        } finally {
+            Files.delete(path);
+        }
+    }
+
+    @Test
+    void decompressParallel() throws IOException {
+        byte[] data = seekableTestData();
+        Path path = writeSeekable(data);
+        try (FileChannel channel = FileChannel.open(path, StandardOpenOption.READ)) {
+            assertArrayEquals(data, Decoder.decompressParallel(channel, 4));
+            assertArrayEquals(data, Decoder.decompressParallel(channel, 1));
+        } finally {
+            Files.delete(path);
+        }
+    }
+
+    @Test
+    void checksumTrailerIsVerified() throws IOException {
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5)
+                .setParameter(Encoder.Parameter.CHECKSUM, 2);
+        // CRC-32C check value.
+        assertEquals(0xE3069283, decodeWithChecksum(Encoder.compress("123456789".getBytes(), params)));
+
+        byte[] data = seekableTestData();
+        byte[] compressed = Encoder.compress(data, params);
+        assertEquals(decodeWithChecksum(compressed), decodeWithChecksum(compressed));
+        // Trailer is the "crcC" magic followed by little-endian CRC.
+        int trailer = -1;
+        for (int i = compressed.length - 8; i >= 0 && trailer < 0; i--) {
+            if (compressed[i] == 'c' && compressed[i + 1] == 'r' && compressed[i + 2] == 'c'
+                    && compressed[i + 3] == 'C') {
+                trailer = i + 4;
+            }
+        }
+        assertTrue(trailer > 0);
+        compressed[trailer] ^= 1;
+        // Decoders not asked to verify skip it as any other metadata.
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+        assertThrows(IOException.class, () -> decodeWithChecksum(compressed));
+    }
+
+    private static int decodeWithChecksum(byte[] compressed) throws IOException {
+        try (BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed))) {
+            input.enableChecksum();
+            byte[] buffer = new byte[4096];
+            while (input.read(buffer) != -1) {
+                // Keep reading.
+            }
+            return input.getChecksum();
+        }
+    }
+
+    @Test
+    void decompressPrefix() throws IOException {
+        byte[] data = seekableTestData();
+        byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(5));
+
+        byte[] prefix = Decoder.decompressPrefix(compressed, 1000);
+        assertArrayEquals(Arrays.copyOf(data, 1000), prefix);
+        // Limit above the stream size gives the whole content.
+        assertArrayEquals(data, Decoder.decompressPrefix(compressed, data.length + 5));
+        assertEquals(0, Decoder.decompressPrefix(compressed, 0).length);
+        // Truncated stream yields what could be decoded.
+        byte[] partial = Decoder.decompressPrefix(Arrays.copyOf(compressed, compressed.length / 2), data.length);
+        assertTrue(partial.length > 0 && partial.length < data.length);
+        assertArrayEquals(Arrays.copyOf(data, partial.length), partial);
+
+        byte[] corrupted = compressed.clone();
+        // Reserved window bits value.
+        corrupted[0] = 0x11;
+        assertThrows(IOException.class, () -> Decoder.decompressPrefix(corrupted, 100));
+    }
+
+    @Test
+    void declaredSizePreallocatesOutput() throws IOException {
+        byte[] data = seekableTestData();
+        byte[] plain = Encoder.compress(data, new Encoder.Parameters().setQuality(5));
+        byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(5)
+                .setParameter(Encoder.Parameter.DECLARE_SIZE, 1));
+        assertTrue(compressed.length <= plain.length + 16);
+
+        DecoderJNI.Wrapper decoder = new DecoderJNI.Wrapper(1024);
+        try {
+            decoder.push(compressed, 0, compressed.length);
+            assertEquals(DecoderJNI.Status.NEEDS_MORE_OUTPUT, decoder.getStatus());
+            assertEquals(data.length, decoder.getDeclaredSize());
+        } finally {
+            decoder.destroy();
+        }
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+
+        // Size is "Size" magic followed by little-endian value; a wrong one is rejected.
+        int position = -1;
+        for (int i = 0; i + 4 <= compressed.length && position < 0; i++) {
+            if (compressed[i] == 'S' && compressed[i + 1] == 'i' && compressed[i + 2] == 'z'
+                    && compressed[i + 3] == 'e') {
+                position = i + 4;
+            }
+        }
+        assertTrue(position > 0);
+        compressed[position]--;
+        assertEquals(DecoderJNI.Status.ERROR, Decoder.decompress(compressed).getResultStatus());
+    }
 }
@@ -17,11 +17,18 @@
 package com.aayushatharva.brotli4j.encoder;
 
 import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.decoder.BrotliInputStream;
+import com.aayushatharva.brotli4j.decoder.Decoder;
+import com.aayushatharva.brotli4j.decoder.DecoderJNI;
+import com.aayushatharva.brotli4j.decoder.DirectDecompress;
 import org.junit.jupiter.api.BeforeAll;
 import org.junit.jupiter.api.Test;
 
+import java.io.ByteArrayInputStream;
 import java.io.ByteArrayOutputStream;
 import java.io.IOException;
+import java.nio.charset.StandardCharsets;
+import java.util.Random;
 
 import static org.junit.jupiter.api.Assertions.*;
 
@@ -44,4 +51,261 @@ class BrotliOutputStreamTest {
 
         assertArrayEquals(compressedData, baos.toByteArray());
     }
+
+    @Test
+    void compressParallel() throws IOException {
+        // Three full chunks, a flushed partial one and a short tail.
+        byte[] data = new byte[13 * 1024 * 1024 + 5];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i * 31 + (i >> 7)) % 97);
+        }
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream brotliOutputStream =
+                new BrotliOutputStream(baos, new Encoder.Parameters().setQuality(1), 16384, 3);
+        int split = 12 * 1024 * 1024 + 100;
+        brotliOutputStream.write(data, 0, split);
+        brotliOutputStream.flush();
+        brotliOutputStream.write(data[split]);
+        brotliOutputStream.write(data, split + 1, data.length - split - 1);
+        brotliOutputStream.close();
+
+        DirectDecompress decompressed = Decoder.decompress(baos.toByteArray());
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void firstBlock() throws IOException {
+        StringBuilder text = new StringBuilder();
+        Random random = new Random(7);
+        while (text.length() < (256 << 10)) {
+            text.append("<li class=\"item\"><a href=\"/page/").append(random.nextInt(1000))
+                    .append("\">Page ").append(random.nextInt(1000)).append("</a></li>\n");
+        }
+        byte[] data = text.toString().getBytes(StandardCharsets.UTF_8);
+
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(11)
+                .setParameter(Encoder.Parameter.FIRST_BLOCK_BITS, 12);
+        BrotliOutputStream output = new BrotliOutputStream(baos, params, 4096);
+        // Full input buffer is pushed with the next byte; the first block is out unflushed.
+        output.write(data, 0, 4097);
+        assertTrue(baos.size() > 0);
+        output.write(data, 4097, data.length - 4097);
+        output.close();
+
+        DirectDecompress decompressed = Decoder.decompress(baos.toByteArray());
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void adaptiveQuality() throws IOException {
+        byte[] data = new byte[64 * 1024];
+        for (int i = 0; i < data.length; ++i) {
+            data[i] = (byte) ("Meow, Woof, Quack, Moo; ".charAt(i % 24) + i / 4096);
+        }
+        // 1 ns per MiB can not be met: every decision lowers quality.
+        AdaptiveQuality adaptive = new AdaptiveQuality(4, 9, 1)
+                .setWindowRange(16, 22)
+                .setDecisionBytes(data.length);
+        Encoder.Parameters params = new Encoder.Parameters().setAdaptiveQuality(adaptive);
+        assertEquals(9, adaptive.getQuality());
+        assertEquals(22, adaptive.getWindow());
+        for (int i = 0; i < 8; ++i) {
+            ByteArrayOutputStream baos = new ByteArrayOutputStream();
+            BrotliOutputStream output = new BrotliOutputStream(baos, params);
+            output.write(data);
+            output.close();
+
+            DirectDecompress decompressed = Decoder.decompress(baos.toByteArray());
+            assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+            assertArrayEquals(data, decompressed.getDecompressedData());
+            assertEquals(Math.max(4, 8 - i), adaptive.getQuality());
+        }
+        assertEquals(16, adaptive.getWindow());
+        assertTrue(adaptive.getNanosPerMegabyte() > 1);
+        assertTrue(adaptive.getRatio() > 1);
+    }
+
+    @Test
+    void skipIncompressible() throws IOException {
+        byte[] data = new byte[1024 * 1024];
+        for (int i = 0; i < data.length / 2; ++i) {
+            data[i] = (byte) "Meow, Woof, Quack, Moo; ".charAt(i % 24);
+        }
+        byte[] noise = new byte[data.length / 2];
+        new Random(42).nextBytes(noise);
+        System.arraycopy(noise, 0, data, data.length / 2, noise.length);
+
+        final long[] outcome = new long[2];
+        Encoder.Parameters params = new Encoder.Parameters()
+                .setSkipIncompressible(true)
+                .setIncompressibleListener(new Encoder.IncompressibleListener() {
+                    @Override
+                    public void onFinished(long inputBytes, long storedBytes) {
+                        outcome[0] = inputBytes;
+                        outcome[1] = storedBytes;
+                    }
+                });
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream output = new BrotliOutputStream(baos, params);
+        output.write(data);
+        output.close();
+
+        DirectDecompress decompressed = Decoder.decompress(baos.toByteArray());
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+        assertEquals(data.length, outcome[0]);
+        // Noise is stored, text is not.
+        assertTrue(outcome[1] >= noise.length / 2);
+        assertTrue(outcome[1] <= noise.length);
+    }
+
+    @Test
+    void statsListener() throws IOException {
+        byte[] data = new byte[512 * 1024];
+        Random random = new Random(5);
+        for (int i = 0; i < data.length; ++i) {
+            data[i] = (byte) ('a' + (i % 64 < 48 ? i % 5 : random.nextInt(26)));
+        }
+
+        final EncoderStats[] outcome = new EncoderStats[1];
+        final long[] sizes = new long[2];
+        Encoder.Parameters params = new Encoder.Parameters()
+                .setQuality(5)
+                .setStatsListener(new Encoder.StatsListener() {
+                    @Override
+                    public void onFinished(int quality, long inputBytes, long outputBytes,
+                                           EncoderStats stats) {
+                        assertEquals(5, quality);
+                        sizes[0] = inputBytes;
+                        sizes[1] = outputBytes;
+                        outcome[0] = stats;
+                    }
+                });
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream output = new BrotliOutputStream(baos, params);
+        output.write(data);
+        output.close();
+
+        EncoderStats stats = outcome[0];
+        assertNotNull(stats);
+        assertEquals(data.length, sizes[0]);
+        assertEquals(baos.size(), sizes[1]);
+        assertTrue(stats.getMetaBlocks() >= 1);
+        assertTrue(stats.getMatches() > 0);
+        assertTrue(stats.getLiterals() > 0 && stats.getLiterals() < data.length);
+        assertTrue(stats.getMatchSearchTicks() > 0);
+        assertTrue(stats.getStoreTicks() > 0);
+    }
+
+    @Test
+    void adaptiveBuffer() throws IOException {
+        byte[] data = new byte[3 * 1024 * 1024];
+        Random random = new Random(3);
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ('a' + (i % 1000 < 700 ? i % 7 : random.nextInt(26)));
+        }
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5);
+
+        ByteArrayOutputStream adaptive = new ByteArrayOutputStream();
+        try (BrotliOutputStream output = new BrotliOutputStream(adaptive, params)) {
+            // Large writes grow the buffer, small flushed ones shrink it again.
+            output.write(data, 0, 2 * 1024 * 1024);
+            for (int offset = 2 * 1024 * 1024; offset < data.length; offset += 100) {
+                output.write(data, offset, Math.min(100, data.length - offset));
+                if (offset % 100000 == 0) {
+                    output.flush();
+                }
+            }
+        }
+
+        ByteArrayOutputStream decoded = new ByteArrayOutputStream();
+        byte[] chunk = new byte[100000];
+        try (BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(adaptive.toByteArray()))) {
+            int read;
+            while ((read = input.read(chunk)) != -1) {
+                decoded.write(chunk, 0, read);
+            }
+        }
+        assertArrayEquals(data, decoded.toByteArray());
+    }
+
+    @Test
+    void lowLatencyFlush() throws IOException {
+        byte[][] outputs = new byte[2][];
+        byte[] data = null;
+        for (int flag = 0; flag < 2; ++flag) {
+            Random random = new Random(7);
+            Encoder.Parameters params = new Encoder.Parameters().setQuality(11)
+                    .setParameter(Encoder.Parameter.LOW_LATENCY_FLUSH, flag);
+            ByteArrayOutputStream events = new ByteArrayOutputStream();
+            ByteArrayOutputStream baos = new ByteArrayOutputStream();
+            try (BrotliOutputStream output = new BrotliOutputStream(baos, params)) {
+                for (int i = 0; i < 200; ++i) {
+                    byte[] event = ("data: {\"id\":" + i + ",\"user\":\"user" + random.nextInt(50)
+                            + "\",\"price\":" + random.nextInt(1000) + "}\n\n").getBytes();
+                    events.write(event);
+                    output.write(event);
+                    output.flush();
+                }
+            }
+            data = events.toByteArray();
+            outputs[flag] = baos.toByteArray();
+        }
+        for (byte[] compressed : outputs) {
+            DirectDecompress decompressed = Decoder.decompress(compressed);
+            assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+            assertArrayEquals(data, decompressed.getDecompressedData());
+        }
+        assertTrue(outputs[1].length <= outputs[0].length);
+    }
+
+    @Test
+    void fork() throws IOException {
+        StringBuilder template = new StringBuilder("<html><head><title>Meow</title></head><body>");
+        for (int i = 0; i < 500; ++i) {
+            template.append("<div class=\"row\">cell ").append(i % 17).append("</div>");
+        }
+        byte[] prefix = template.toString().getBytes();
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(9);
+
+        ByteArrayOutputStream shared = new ByteArrayOutputStream();
+        BrotliOutputStream original = new BrotliOutputStream(shared, params, 4096);
+        original.write(prefix);
+        ByteArrayOutputStream[] tails = new ByteArrayOutputStream[2];
+        BrotliOutputStream[] forks = new BrotliOutputStream[2];
+        for (int i = 0; i < 2; ++i) {
+            tails[i] = new ByteArrayOutputStream();
+            forks[i] = original.fork(tails[i]);
+        }
+        byte[] head = shared.toByteArray();
+        original.close();
+
+        for (int i = 0; i < 2; ++i) {
+            byte[] tail = ("<p>user " + i + "</p><div class=\"row\">cell 3</div></body></html>").getBytes();
+            forks[i].write(tail);
+            forks[i].close();
+            byte[] compressed = new byte[head.length + tails[i].size()];
+            System.arraycopy(head, 0, compressed, 0, head.length);
+            System.arraycopy(tails[i].toByteArray(), 0, compressed, head.length, tails[i].size());
+
+            // Same bytes as a single stream flushed after the prefix.
+            ByteArrayOutputStream whole = new ByteArrayOutputStream();
+            try (BrotliOutputStream output = new BrotliOutputStream(whole, params, 4096)) {
+                output.write(prefix);
+                output.flush();
+                output.write(tail);
+            }
+            assertArrayEquals(whole.toByteArray(), compressed);
+
+            byte[] data = new byte[prefix.length + tail.length];
+            System.arraycopy(prefix, 0, data, 0, prefix.length);
+            System.arraycopy(tail, 0, data, prefix.length, tail.length);
+            DirectDecompress decompressed = Decoder.decompress(compressed);
+            assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+            assertArrayEquals(data, decompressed.getDecompressedData());
+        }
+    }
 }
@@ -17,13 +17,39 @@
 package com.aayushatharva.brotli4j.encoder;
 
 import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.common.MemoryStats;
+import com.aayushatharva.brotli4j.common.NativeMemoryBudget;
+import com.aayushatharva.brotli4j.decoder.BrotliInputStream;
+import com.aayushatharva.brotli4j.decoder.Decoder;
+import com.aayushatharva.brotli4j.decoder.DecoderJNI;
+import com.aayushatharva.brotli4j.decoder.DirectDecompress;
 import org.junit.jupiter.api.BeforeAll;
 import org.junit.jupiter.api.Test;
 
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
 import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.nio.channels.Channels;
+import java.nio.channels.WritableByteChannel;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.Random;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.atomic.AtomicInteger;
 
 import static org.junit.jupiter.api.Assertions.assertArrayEquals;
 import static org.junit.jupiter.api.Assertions.assertEquals;
+import static org.junit.jupiter.api.Assertions.assertNotEquals;
+import static org.junit.jupiter.api.Assertions.assertThrows;
+import static org.junit.jupiter.api.Assertions.assertTrue;
 
 class EncoderTest {
 
@@ -44,6 +70,471 @@ class EncoderTest {
         assertArrayEquals(compressedData, Encoder.compress("Meow".getBytes(), new Encoder.Parameters().setQuality(6)));
     }
 
+    @Test
+    void compressWithPooledEncoder() throws IOException {
+        final byte[] text = "Some long text, very long text".getBytes();
+        final Encoder.Parameters parameters = new Encoder.Parameters().setQuality(5);
+
+        // Second call reuses the encoder released by the first one.
+        final byte[] first = Encoder.compress(text, parameters);
+        final byte[] second = Encoder.compress(text, parameters);
+        assertArrayEquals(first, second);
+    }
+
+    @Test
+    void compressWithPooledAllocator() throws IOException {
+        byte[] data = new byte[300000];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("brotli".charAt(i % 6) + (i / 1000) % 7);
+        }
+        final Encoder.Parameters parameters = new Encoder.Parameters().setQuality(9);
+        final byte[] expected = Encoder.compress(data, parameters);
+
+        // Second round is served by blocks cached on the first one.
+        parameters.setPooledAllocator(true);
+        for (int i = 0; i < 2; i++) {
+            assertArrayEquals(expected, Encoder.compress(data, parameters));
+        }
+        assertArrayEquals(data, Decoder.decompress(expected).getDecompressedData());
+    }
+
+    @Test
+    void compressWithHugePages() throws IOException {
+        byte[] data = new byte[300000];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("brotli".charAt(i % 6) + (i / 1000) % 7);
+        }
+        final Encoder.Parameters parameters = new Encoder.Parameters().setQuality(9).setWindow(24);
+        final byte[] expected = Encoder.compress(data, parameters);
+
+        // Allocation policy must not change the output.
+        for (Encoder.HugePages policy : Encoder.HugePages.values()) {
+            parameters.setHugePages(policy);
+            assertArrayEquals(expected, Encoder.compress(data, parameters));
+        }
+        assertArrayEquals(data, Decoder.decompress(expected).getDecompressedData());
+    }
+
+    @Test
+    void memoryStatsStayWithinEstimate() throws IOException {
+        byte[] data = new byte[100000];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("brotli".charAt(i % 6) + (i / 1000) % 7);
+        }
+        EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(data.length, 9, 20, null);
+        try {
+            ByteBuffer input = encoder.getInputBuffer();
+            input.put(data);
+            encoder.push(EncoderJNI.Operation.FINISH, data.length);
+            while (!encoder.isFinished() || encoder.hasMoreOutput()) {
+                if (encoder.hasMoreOutput()) {
+                    encoder.pull();
+                } else {
+                    encoder.push(EncoderJNI.Operation.FINISH, 0);
+                }
+            }
+
+            MemoryStats stats = encoder.getMemoryStats();
+            assertTrue(stats.getAllocationCount() > 0);
+            assertTrue(stats.getPeakBytes() >= stats.getCurrentBytes());
+            long estimate = Encoder.estimatePeakMemory(
+                    new Encoder.Parameters().setQuality(9).setWindow(20), data.length);
+            assertTrue(stats.getPeakBytes() <= estimate);
+
+            // Reset keeps buffers, but restarts counting.
+            assertTrue(encoder.reset());
+            stats = encoder.getMemoryStats();
+            assertEquals(0, stats.getAllocationCount());
+            assertEquals(stats.getCurrentBytes(), stats.getPeakBytes());
+        } finally {
+            encoder.destroy();
+        }
+    }
+
+    @Test
+    void totalOutCountsMetadataBlocks() throws IOException {
+        byte[] data = new byte[5000];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("brotli ".charAt(i % 7) + (i / 97) % 5);
+        }
+        // Checksum trailer and declared size are written as metadata blocks.
+        Encoder.Parameter[] parameters = {Encoder.Parameter.CHECKSUM, Encoder.Parameter.DECLARE_SIZE};
+        int[] values = {2, 1};
+        for (int i = 0; i < parameters.length; i++) {
+            // Streaming: input is staged in pieces.
+            EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(1024, 5, 20, null);
+            try {
+                assertTrue(encoder.setParameter(parameters[i].code, values[i]));
+                long produced = 0;
+                for (int offset = 0; offset < data.length; offset += 1024) {
+                    int length = Math.min(1024, data.length - offset);
+                    EncoderJNI.Operation op = (offset + length == data.length)
+                            ? EncoderJNI.Operation.FINISH : EncoderJNI.Operation.PROCESS;
+                    encoder.getInputBuffer().put(data, offset, length);
+                    encoder.push(op, length);
+                    while (encoder.hasMoreOutput() || encoder.hasRemainingInput()) {
+                        if (encoder.hasMoreOutput()) {
+                            produced += encoder.pull().remaining();
+                        } else {
+                            encoder.push(op, 0);
+                        }
+                    }
+                }
+                assertTrue(encoder.isFinished());
+                assertEquals(produced, encoder.getTotalOut());
+            } finally {
+                encoder.destroy();
+            }
+
+            // One-shot: the whole input is pushed with FINISH at once.
+            encoder = new EncoderJNI.Wrapper(1024, 5, 20, null);
+            try {
+                assertTrue(encoder.setParameter(parameters[i].code, values[i]));
+                long produced = 0;
+                int offset = encoder.push(EncoderJNI.Operation.FINISH, data, 0, data.length);
+                while (!encoder.isFinished()) {
+                    if (encoder.hasMoreOutput()) {
+                        produced += encoder.pull().remaining();
+                    } else {
+                        offset += encoder.push(EncoderJNI.Operation.FINISH, data, offset, data.length - offset);
+                    }
+                }
+                assertEquals(data.length, offset);
+                assertEquals(produced, encoder.getTotalOut());
+            } finally {
+                encoder.destroy();
+            }
+        }
+    }
+
+    @Test
+    void estimateCompressedSize() {
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5);
+        byte[] random = new byte[256 * 1024];
+        new Random(42).nextBytes(random);
+        ByteBuffer heap = ByteBuffer.wrap(random);
+        CompressionEstimate estimate = Encoder.estimate(heap, params);
+        assertEquals(0, heap.position());
+        assertTrue(estimate.getCompressedSize() > random.length * 9L / 10);
+        assertTrue(estimate.getCompressedSize() <= Encoder.maxCompressedSize(random.length));
+
+        byte[] text = new byte[256 * 1024];
+        for (int i = 0; i < text.length; i++) {
+            text[i] = (byte) "hello brotli, ".charAt(i % 14);
+        }
+        ByteBuffer direct = ByteBuffer.allocateDirect(text.length);
+        direct.put(text);
+        ((Buffer) direct).flip();
+        CompressionEstimate repetitive = Encoder.estimate(direct, params);
+        assertEquals(0, direct.position());
+        assertTrue(repetitive.getCompressedSize() < text.length / 100);
+        assertTrue(repetitive.getEncodeNanos() > 0);
+    }
+
+    @Test
+    void memoryLimitReleasesIdleMemory() throws IOException {
+        long limit = 1024 * 1024;
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(9).setMemoryLimit(limit);
+        byte[] data = new byte[200 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("brotli".charAt(i % 6) + (i / 1000) % 7);
+        }
+
+        ByteArrayOutputStream compressed = new ByteArrayOutputStream();
+        Encoder encoder = new Encoder(Channels.newChannel(compressed), params, 16 * 1024);
+        for (int offset = 0; offset < data.length; offset += 10 * 1024) {
+            encoder.inputBuffer.put(data, offset, Math.min(10 * 1024, data.length - offset));
+            encoder.flush();
+
+            // Between flushes only the window is kept.
+            MemoryStats stats = encoder.getMemoryStats();
+            assertTrue(stats.getPeakBytes() <= limit);
+            assertTrue(stats.getCurrentBytes() < stats.getPeakBytes());
+        }
+        encoder.close();
+
+        assertArrayEquals(data, Decoder.decompress(compressed.toByteArray()).getDecompressedData());
+    }
+
+    @Test
+    void compressDirectBuffers() throws IOException {
+        byte[] data = "Meow".getBytes();
+        ByteBuffer src = ByteBuffer.allocateDirect(data.length);
+        src.put(data);
+        src.flip();
+        ByteBuffer dst = ByteBuffer.allocateDirect(Encoder.maxCompressedSize(data.length));
+
+        int written = Encoder.compress(src, dst);
+        assertEquals(compressedData.length, written);
+        assertEquals(0, src.remaining());
+        assertEquals(written, dst.position());
+
+        dst.flip();
+        byte[] result = new byte[written];
+        dst.get(result);
+        assertArrayEquals(compressedData, result);
+    }
+
+    @Test
+    void compressToBudget() throws IOException {
+        StringBuilder text = new StringBuilder();
+        Random random = new Random(5);
+        for (int i = 0; i < 2000; i++) {
+            text.append("sensor=").append(random.nextInt(16)).append(" value=").append(random.nextInt(1000)).append('\n');
+        }
+        byte[] data = text.toString().getBytes(StandardCharsets.US_ASCII);
+        ByteBuffer src = ByteBuffer.allocateDirect(data.length);
+        src.put(data);
+        src.flip();
+        ByteBuffer packet = ByteBuffer.allocateDirect(1400);
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5);
+
+        ByteArrayOutputStream decoded = new ByteArrayOutputStream();
+        int packets = 0;
+        while (src.hasRemaining()) {
+            int start = src.position();
+            packet.clear();
+            int written = Encoder.compressToBudget(src, packet, params);
+            assertEquals(written, packet.position());
+            assertTrue(src.position() > start);
+            packet.flip();
+            byte[] stream = new byte[written];
+            packet.get(stream);
+            decoded.write(Decoder.decompress(stream).getDecompressedData());
+            packets++;
+        }
+        assertArrayEquals(data, decoded.toByteArray());
+        // Budget is filled, so packets are hardly more than the compressed size needs.
+        assertTrue(packets <= Encoder.compress(data, params).length / 1400 + 2);
+
+        packet.clear().limit(0);
+        src.rewind();
+        assertThrows(IOException.class, () -> Encoder.compressToBudget(src, packet, params));
+    }
+
+    @Test
+    void compressWithParameters() throws IOException {
+        byte[] data = new byte[100000];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i % 16 < 4) ? i / 16 : i % 16);
+        }
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(9)
+                .setParameter(Encoder.Parameter.DISABLE_LITERAL_CONTEXT_MODELING, 1)
+                .setParameter(Encoder.Parameter.SIZE_HINT, data.length)
+                .setParameter(Encoder.Parameter.LGBLOCK, 16)
+                .setParameter(Encoder.Parameter.NPOSTFIX, 2)
+                .setParameter(Encoder.Parameter.NDIRECT, 8);
+
+        byte[] compressed = Encoder.compress(data, params);
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+
+        ByteBuffer src = ByteBuffer.allocateDirect(data.length);
+        src.put(data);
+        src.flip();
+        ByteBuffer dst = ByteBuffer.allocateDirect(Encoder.maxCompressedSize(data.length));
+        int written = Encoder.compress(src, dst, params);
+        dst.flip();
+        byte[] direct = new byte[written];
+        dst.get(direct);
+        assertArrayEquals(data, Decoder.decompress(direct).getDecompressedData());
+
+        // "Large Window Brotli" streams need a decoder that accepts them.
+        params.setWindow(25).setParameter(Encoder.Parameter.LARGE_WINDOW, 1);
+        compressed = Encoder.compress(data, params);
+        assertNotEquals(DecoderJNI.Status.DONE, Decoder.decompress(compressed).getResultStatus());
+        ByteArrayOutputStream decoded = new ByteArrayOutputStream();
+        try (BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed))) {
+            input.enableLargeWindow();
+            byte[] chunk = new byte[16384];
+            int read;
+            while ((read = input.read(chunk)) != -1) {
+                decoded.write(chunk, 0, read);
+            }
+        }
+        assertArrayEquals(data, decoded.toByteArray());
+    }
+
+    @Test
+    void compressWithCustomHasher() throws IOException {
+        byte[] data = new byte[200000];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("brotli".charAt(i % 6) + (i / 1000) % 7);
+        }
+        for (int type : new int[]{2, 4, 5, 6, 35, 40, 54, 65}) {
+            Encoder.Parameters params = new Encoder.Parameters().setQuality(5)
+                    .setParameter(Encoder.Parameter.HASHER_TYPE, type)
+                    .setParameter(Encoder.Parameter.HASHER_BUCKET_BITS, 16)
+                    .setParameter(Encoder.Parameter.HASHER_BLOCK_BITS, 2)
+                    .setParameter(Encoder.Parameter.HASHER_NUM_LAST_DISTANCES, 16);
+            byte[] compressed = Encoder.compress(data, params);
+            assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+        }
+
+        // H10 is reserved for qualities 10 and 11.
+        Encoder.Parameters invalid = new Encoder.Parameters()
+                .setParameter(Encoder.Parameter.HASHER_TYPE, 10);
+        assertThrows(IOException.class, () -> Encoder.compress(data, invalid));
+        // Forgetful chains take quality 4 and above.
+        for (int type : new int[]{40, 41, 42}) {
+            Encoder.Parameters forgetful = new Encoder.Parameters().setQuality(3)
+                    .setParameter(Encoder.Parameter.HASHER_TYPE, type);
+            assertThrows(IOException.class, () -> Encoder.compress(data, forgetful));
+        }
+    }
+
+    @Test
+    void compressWithTruncatedTree() throws IOException {
+        // Repeats 64 KiB apart are beyond the 16-bit tree, within the 18-bit window.
+        byte[] block = new byte[40000];
+        new Random(11).nextBytes(block);
+        byte[] data = new byte[4 * 65536];
+        for (int i = 0; i < data.length; i += 65536) {
+            System.arraycopy(block, 0, data, i, block.length);
+        }
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(11).setWindow(18)
+                .setParameter(Encoder.Parameter.HASHER_TREE_BITS, 16);
+        byte[] compressed = Encoder.compress(data, params);
+        assertTrue(compressed.length < 2 * block.length);
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+    }
+
+    @Test
+    void compressWithIndependentChunks() throws IOException {
+        Random random = new Random(11);
+        byte[] data = new byte[1 << 20];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ('a' + random.nextInt(8));
+        }
+        // Insertion shifts the rest of input, but chunks past it are cut at the same content.
+        byte[] edited = new byte[data.length + 5];
+        System.arraycopy(data, 0, edited, 0, 100000);
+        System.arraycopy(data, 100000, edited, 100005, data.length - 100000);
+
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5).setWindow(16)
+                .setParameter(Encoder.Parameter.CHUNK_BITS, 12)
+                .setParameter(Encoder.Parameter.INDEPENDENT_CHUNKS, 1);
+        byte[] compressed = Encoder.compress(data, params);
+        byte[] compressedEdited = Encoder.compress(edited, params);
+        int common = 0;
+        while (common < compressed.length && common < compressedEdited.length
+                && compressed[compressed.length - 1 - common]
+                == compressedEdited[compressedEdited.length - 1 - common]) {
+            common++;
+        }
+        assertTrue(common > compressed.length * 3 / 4);
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+        assertArrayEquals(edited, Decoder.decompress(compressedEdited).getDecompressedData());
+    }
+
+    @Test
+    void compressWithIndependentChunksAndCompositeHasher() throws IOException {
+        // Large window and size hint make quality 4 pick H55, which has a rolling hash.
+        Random random = new Random(13);
+        byte[] block = new byte[4096];
+        for (int i = 0; i < block.length; i++) {
+            block[i] = (byte) ('a' + random.nextInt(16));
+        }
+        byte[] data = new byte[2 << 20];
+        for (int i = 0; i < data.length; i += block.length) {
+            System.arraycopy(block, 0, data, i, block.length);
+            data[i + random.nextInt(block.length)] = '.';
+        }
+        for (int chunkBits : new int[]{10, 12}) {
+            Encoder.Parameters params = new Encoder.Parameters().setQuality(4).setWindow(26)
+                    .setParameter(Encoder.Parameter.LARGE_WINDOW, 1)
+                    .setParameter(Encoder.Parameter.SIZE_HINT, data.length)
+                    .setParameter(Encoder.Parameter.CHUNK_BITS, chunkBits)
+                    .setParameter(Encoder.Parameter.INDEPENDENT_CHUNKS, 1);
+            byte[] compressed = Encoder.compress(data, params);
+            ByteArrayOutputStream decoded = new ByteArrayOutputStream();
+            try (BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed))) {
+                input.enableLargeWindow();
+                byte[] chunk = new byte[16384];
+                int read;
+                while ((read = input.read(chunk)) != -1) {
+                    decoded.write(chunk, 0, read);
+                }
+            }
+            assertArrayEquals(data, decoded.toByteArray());
+        }
+    }
+
+    @Test
+    void compressWithLongDistanceMatching() throws IOException {
+        // Random block repeated 3 MiB later; hash chains lose track of it.
+        byte[] block = new byte[1 << 20];
+        byte[] gap = new byte[2 << 20];
+        Random random = new Random(7);
+        random.nextBytes(block);
+        random.nextBytes(gap);
+        byte[] data = new byte[2 * block.length + gap.length];
+        System.arraycopy(block, 0, data, 0, block.length);
+        System.arraycopy(gap, 0, data, block.length, gap.length);
+        System.arraycopy(block, 0, data, block.length + gap.length, block.length);
+
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5).setWindow(22);
+        byte[] regular = Encoder.compress(data, params);
+        byte[] compressed = Encoder.compress(data, params
+                .setParameter(Encoder.Parameter.LONG_DISTANCE_MATCHING, 1));
+        assertTrue(compressed.length < regular.length - block.length / 2);
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+    }
+
+    @Test
+    void compressWithShortestPath() throws IOException {
+        StringBuilder text = new StringBuilder();
+        Random random = new Random(5);
+        String[] words = {"encoder", "decoder", "window", "block", "stream", "quality", "hash"};
+        while (text.length() < (256 << 10)) {
+            text.append(words[random.nextInt(words.length)]).append(random.nextInt(100))
+                    .append(random.nextInt(4) == 0 ? ".\n" : " ");
+        }
+        byte[] data = text.toString().getBytes(StandardCharsets.UTF_8);
+
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(9);
+        byte[] regular = Encoder.compress(data, params);
+        byte[] compressed = Encoder.compress(data, params
+                .setParameter(Encoder.Parameter.SHORTEST_PATH, 1));
+        assertTrue(compressed.length < regular.length);
+        assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+    }
+
+    @Test
+    void compressWithProfile() throws IOException {
+        String[] levels = {"INFO", "WARN", "DEBUG", "ERROR"};
+        String[] words = {"cache", "miss", "user", "session", "latency", "alpha", "beta"};
+        Random random = new Random(11);
+        List<byte[]> samples = new ArrayList<>();
+        for (int i = 0; i < 60; ++i) {
+            StringBuilder sample = new StringBuilder();
+            for (int j = 0; j < 20; ++j) {
+                sample.append("{\"ts\": ").append(1700000000 + random.nextInt(1 << 20))
+                        .append(", \"level\": \"").append(levels[random.nextInt(levels.length)])
+                        .append("\", \"latency_ms\": ").append(random.nextInt(100000) / 1000.0)
+                        .append(", \"msg\": \"");
+                for (int k = random.nextInt(6); k >= 0; --k) {
+                    sample.append(words[random.nextInt(words.length)]).append(' ');
+                }
+                sample.append("\"}\n");
+            }
+            samples.add(sample.toString().getBytes(StandardCharsets.UTF_8));
+        }
+        byte[] profile = Encoder.trainProfile(samples.subList(0, 30), 3);
+
+        Encoder.Parameters plain = new Encoder.Parameters().setQuality(3);
+        Encoder.Parameters profiled = new Encoder.Parameters().setQuality(3).setProfile(profile);
+        long plainSize = 0;
+        long profiledSize = 0;
+        for (byte[] sample : samples.subList(30, 60)) {
+            plainSize += Encoder.compress(sample, plain).length;
+            byte[] compressed = Encoder.compress(sample, profiled);
+            profiledSize += compressed.length;
+            assertArrayEquals(sample, Decoder.decompress(compressed).getDecompressedData());
+        }
+        assertTrue(profiledSize < plainSize);
+        assertThrows(IllegalArgumentException.class, () -> plain.setProfile(new byte[3]));
+    }
+
     @Test
     void compressWithModes() throws IOException {
         final byte[] text = "Some long text, very long text".getBytes();
@@ -58,4 +549,589 @@ class EncoderTest {
         final byte[] compressedFont = Encoder.compress(text, parameters.setMode(Encoder.Mode.FONT));
         assertEquals(31, compressedFont.length);
     }
+
+    @Test
+    void compressWithAutoMode() throws IOException {
+        // Records of four little-endian 32-bit fields.
+        byte[] data = new byte[64 * 1024];
+        for (int i = 0; i < data.length / 16; i++) {
+            int[] fields = {i * 7, i % 13, 1000 + (i * 31) % 16, (int) ((i * 2654435761L) % 100000)};
+            for (int j = 0; j < 16; j++) {
+                data[16 * i + j] = (byte) (fields[j / 4] >>> (8 * (j % 4)));
+            }
+        }
+        Encoder.Parameters parameters = new Encoder.Parameters().setQuality(5);
+        byte[] compressedGeneric = Encoder.compress(data, parameters.setMode(Encoder.Mode.GENERIC));
+        byte[] compressedAuto = Encoder.compress(data, parameters.setMode(Encoder.Mode.AUTO));
+        // Aligned distance codes are picked for such input.
+        assertTrue(compressedAuto.length < compressedGeneric.length);
+
+        DirectDecompress decompressed = Decoder.decompress(compressedAuto);
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void directEncoderScatterGather() throws IOException {
+        byte[] data = new byte[200 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) "Meow, Woof, Quack, Moo; ".charAt((i * 7 + (i >> 10)) % 24);
+        }
+        ByteBuffer[] srcs = new ByteBuffer[3];
+        int[] bounds = {0, 1000, 150 * 1024, data.length};
+        for (int i = 0; i < srcs.length; i++) {
+            srcs[i] = ByteBuffer.allocateDirect(bounds[i + 1] - bounds[i]);
+            srcs[i].put(data, bounds[i], bounds[i + 1] - bounds[i]);
+            ((Buffer) srcs[i]).flip();
+        }
+
+        ByteArrayOutputStream compressed = new ByteArrayOutputStream();
+        ByteBuffer[] dsts = {ByteBuffer.allocateDirect(100), ByteBuffer.allocateDirect(157)};
+        try (DirectEncoder encoder = new DirectEncoder(new Encoder.Parameters().setQuality(5))) {
+            boolean done = false;
+            while (!done) {
+                done = encoder.finish(srcs, dsts);
+                for (ByteBuffer dst : dsts) {
+                    ((Buffer) dst).flip();
+                    while (dst.hasRemaining()) {
+                        compressed.write(dst.get());
+                    }
+                    ((Buffer) dst).clear();
+                }
+            }
+            assertTrue(encoder.isFinished());
+        }
+        for (ByteBuffer src : srcs) {
+            assertEquals(0, src.remaining());
+        }
+
+        DirectDecompress decompressed = Decoder.decompress(compressed.toByteArray());
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void directEncoderWorkBudget() throws IOException {
+        byte[] data = new byte[1024 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i * 31 + (i >> 7)) % 97);
+        }
+        ByteBuffer src = ByteBuffer.allocateDirect(data.length);
+        src.put(data);
+        ((Buffer) src).flip();
+        ByteBuffer dst = ByteBuffer.allocateDirect(2 * data.length);
+
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(5)
+                .setParameter(Encoder.Parameter.LGBLOCK, 16)
+                .setParameter(Encoder.Parameter.WORK_BUDGET, 100 * 1024);
+        int yields = 0;
+        try (DirectEncoder encoder = new DirectEncoder(params)) {
+            while (!encoder.finish(new ByteBuffer[]{src}, new ByteBuffer[]{dst})) {
+                // Output space is plenty; only the budget makes encoder return early.
+                assertTrue(src.remaining() > 0);
+                yields++;
+            }
+        }
+        assertTrue(yields >= 4);
+
+        ((Buffer) dst).flip();
+        byte[] compressed = new byte[dst.remaining()];
+        dst.get(compressed);
+        DirectDecompress decompressed = Decoder.decompress(compressed);
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void nativeMemoryBudget() throws IOException {
+        byte[] data = new byte[1024 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i * 31 + (i >> 7)) % 97);
+        }
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(11).setWindow(22);
+        long estimate = Encoder.estimatePeakMemory(params, 1L << 30);
+        NativeMemoryBudget.setLimit(estimate + estimate / 2);
+        NativeMemoryBudget.setDegrade(false);
+        ByteArrayOutputStream first = new ByteArrayOutputStream();
+        ByteArrayOutputStream second = new ByteArrayOutputStream();
+        try {
+            try (BrotliOutputStream admitted = new BrotliOutputStream(first, params)) {
+                assertTrue(NativeMemoryBudget.getChargedBytes() >= estimate);
+                // No room for another encoder with the same parameters.
+                assertThrows(IOException.class, () -> new BrotliOutputStream(new ByteArrayOutputStream(), params));
+
+                NativeMemoryBudget.setDegrade(true);
+                try (BrotliOutputStream degraded = new BrotliOutputStream(second, params)) {
+                    degraded.write(data);
+                }
+                admitted.write(data);
+            }
+            assertTrue(NativeMemoryBudget.getChargedBytes() < estimate);
+        } finally {
+            NativeMemoryBudget.setLimit(0);
+            NativeMemoryBudget.setDegrade(true);
+        }
+
+        for (ByteArrayOutputStream compressed : Arrays.asList(first, second)) {
+            DirectDecompress decompressed = Decoder.decompress(compressed.toByteArray());
+            assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+            assertArrayEquals(data, decompressed.getDecompressedData());
+        }
+    }
+
+    @Test
+    void compressLargeHeapArray() throws IOException {
+        // Bigger than a single pinned window, so input is consumed in several pushes.
+        byte[] data = new byte[3 * 1024 * 1024 + 17];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i * 31 + (i >> 7)) % 97);
+        }
+        byte[] compressed = Encoder.compress(data, new Encoder.Parameters().setQuality(1));
+
+        DirectDecompress decompressed = Decoder.decompress(compressed);
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void compressParallel() throws IOException {
+        // Three chunks, the last one shorter than the others.
+        byte[] data = new byte[9 * 1024 * 1024 + 5];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ((i * 31 + (i >> 7)) % 97);
+        }
+        byte[] compressed = Encoder.compressParallel(data, new Encoder.Parameters().setQuality(1), 3);
+
+        DirectDecompress decompressed = Decoder.decompress(compressed);
+        assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+        assertArrayEquals(data, decompressed.getDecompressedData());
+    }
+
+    @Test
+    void compressBatch() throws IOException {
+        byte[] data = "MeowMeow".getBytes();
+        ByteBuffer src = ByteBuffer.allocateDirect(data.length);
+        src.put(data);
+        ByteBuffer dst = ByteBuffer.allocateDirect(2 * compressedData.length + 1);
+        dst.position(1);
+        int[] offsets = new int[3];
+
+        assertEquals(2, Encoder.compressBatch(src, new int[]{0, 4, 4, 4}, dst, offsets));
+        assertEquals(1, offsets[0]);
+        assertEquals(1 + compressedData.length, offsets[1]);
+        assertEquals(dst.capacity(), offsets[2]);
+        assertEquals(dst.capacity(), dst.position());
+
+        byte[] stream = new byte[compressedData.length];
+        dst.position(offsets[1]);
+        dst.get(stream);
+        assertArrayEquals(compressedData, stream);
+    }
+
+    @Test
+    void compressBatchExtraParameters() throws IOException {
+        byte[] data = "MeowMeow".getBytes();
+        ByteBuffer src = ByteBuffer.allocateDirect(data.length);
+        src.put(data);
+        ByteBuffer dst = ByteBuffer.allocateDirect(256);
+        int[] offsets = new int[3];
+        Encoder.Parameters params = new Encoder.Parameters().setParameter(Encoder.Parameter.CHECKSUM, 2);
+
+        assertEquals(2, Encoder.compressBatch(src, new int[]{0, 4, 4, 4}, dst, offsets, params));
+        for (int i = 0; i < 2; i++) {
+            // Checksum trailer is appended to each stream.
+            byte[] stream = new byte[offsets[i + 1] - offsets[i]];
+            assertTrue(stream.length > compressedData.length);
+            dst.position(offsets[i]);
+            dst.get(stream);
+            DirectDecompress decompressed = Decoder.decompress(stream);
+            assertEquals(DecoderJNI.Status.DONE, decompressed.getResultStatus());
+            assertArrayEquals("Meow".getBytes(), decompressed.getDecompressedData());
+        }
+    }
+
+    @Test
+    void compressAsync() throws ExecutionException, InterruptedException {
+        ByteBuffer src = ByteBuffer.allocateDirect(4);
+        src.put("Meow".getBytes());
+        ((Buffer) src).flip();
+
+        ByteBuffer compressed = Encoder.compressAsync(src, new Encoder.Parameters()).get();
+        assertEquals(0, src.position());
+        byte[] data = new byte[compressed.remaining()];
+        compressed.get(data);
+        assertArrayEquals(compressedData, data);
+    }
+
+    @Test
+    void sharedDictionary() throws IOException {
+        ByteBuffer raw = wordsDictionary();
+        ByteBuffer copy = wordsDictionary();
+        ByteBuffer other = ByteBuffer.allocateDirect(4096);
+
+        // Same contents resolve to the same native instance.
+        PreparedDictionary first = PreparedDictionaryGenerator.generateShared(raw);
+        PreparedDictionary second = PreparedDictionaryGenerator.generateShared(copy);
+        PreparedDictionary third = PreparedDictionaryGenerator.generateShared(other);
+        assertEquals(((EncoderJNI.SharedPreparedDictionary) first).getHandle(),
+                ((EncoderJNI.SharedPreparedDictionary) second).getHandle());
+        assertNotEquals(((EncoderJNI.SharedPreparedDictionary) first).getHandle(),
+                ((EncoderJNI.SharedPreparedDictionary) third).getHandle());
+
+        byte[] data = "Woof, Quack, Meow, Moo; Meow, Woof, Quack".getBytes();
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream output = new BrotliOutputStream(baos, new Encoder.Parameters().setQuality(11));
+        output.attachDictionary(second);
+        output.write(data);
+        output.close();
+
+        assertArrayEquals(data, decompressWithDictionary(baos.toByteArray(), raw, data.length));
+    }
+
+    @Test
+    void preparedDictionarySharedByEncoders() throws IOException {
+        ByteBuffer raw = wordsDictionary();
+        PreparedDictionary dictionary = PreparedDictionaryGenerator.generate(raw);
+        byte[] data = "Woof, Quack, Meow, Moo; Meow, Woof, Quack".getBytes();
+
+        ByteArrayOutputStream firstBaos = new ByteArrayOutputStream();
+        ByteArrayOutputStream secondBaos = new ByteArrayOutputStream();
+        BrotliOutputStream first = new BrotliOutputStream(firstBaos, new Encoder.Parameters().setQuality(11));
+        BrotliOutputStream second = new BrotliOutputStream(secondBaos, new Encoder.Parameters().setQuality(11));
+        first.attachDictionary(dictionary);
+        second.attachDictionary(dictionary);
+        first.write(data);
+        second.write(data, 0, data.length / 2);
+        second.flush();
+
+        // Destroying the first encoder leaves the dictionary usable by the second one.
+        first.close();
+        second.write(data, data.length / 2, data.length - data.length / 2);
+        second.close();
+
+        assertTrue(secondBaos.size() < data.length);
+        assertArrayEquals(data, decompressWithDictionary(firstBaos.toByteArray(), raw, data.length));
+        assertArrayEquals(data, decompressWithDictionary(secondBaos.toByteArray(), raw, data.length));
+    }
+
+    private static ByteBuffer wordsDictionary() {
+        byte[] words = "Meow, Woof, Quack, Moo; ".getBytes();
+        ByteBuffer raw = ByteBuffer.allocateDirect(4096);
+        while (raw.hasRemaining()) {
+            raw.put(words[raw.position() % words.length]);
+        }
+        return raw;
+    }
+
+    private static byte[] decompressWithDictionary(byte[] compressed, ByteBuffer raw, int length)
+            throws IOException {
+        BrotliInputStream input = new BrotliInputStream(new ByteArrayInputStream(compressed));
+        input.attachDictionary(raw);
+        byte[] decoded = new byte[length];
+        int offset = 0;
+        while (offset < decoded.length) {
+            int read = input.read(decoded, offset, decoded.length - offset);
+            assertTrue(read > 0);
+            offset += read;
+        }
+        assertEquals(-1, input.read());
+        input.close();
+        return decoded;
+    }
+
+    @Test
+    void loadSavedDictionary() throws IOException {
+        ByteBuffer raw = wordsDictionary();
+        Path path = Files.createTempFile("brotli4j", ".dict");
+        try {
+            PreparedDictionaryGenerator.save(PreparedDictionaryGenerator.generate(raw), path);
+            PreparedDictionary dictionary = PreparedDictionary.load(path);
+
+            byte[] data = "Woof, Quack, Meow, Moo; Meow, Woof, Quack".getBytes();
+            ByteArrayOutputStream baos = new ByteArrayOutputStream();
+            BrotliOutputStream output = new BrotliOutputStream(baos, new Encoder.Parameters().setQuality(11));
+            output.attachDictionary(dictionary);
+            output.write(data);
+            output.close();
+            // The dictionary is used: output is smaller than the data itself.
+            assertTrue(baos.size() < data.length / 2);
+
+            assertArrayEquals(data, decompressWithDictionary(baos.toByteArray(), raw, data.length));
+        } finally {
+            Files.delete(path);
+        }
+    }
+
+    @Test
+    void compressDelta() throws IOException {
+        Random random = new Random(7);
+        byte[] previous = new byte[256 * 1024];
+        for (int i = 0; i < previous.length; ++i) {
+            previous[i] = (byte) ('a' + random.nextInt(26));
+        }
+        // Next version: same data with a few spots edited.
+        byte[] current = previous.clone();
+        for (int i = 0; i < 16; ++i) {
+            current[random.nextInt(current.length)] = '#';
+        }
+        Path path = Files.createTempFile("brotli4j", ".old");
+        try {
+            Files.write(path, previous);
+            Encoder.Parameters params = new Encoder.Parameters().setQuality(5);
+            byte[] delta = Encoder.compressDelta(current, path, params);
+            assertTrue(delta.length * 100 < Encoder.compress(current, params).length);
+
+            DirectDecompress result = Decoder.decompressDelta(delta, path);
+            assertEquals(DecoderJNI.Status.DONE, result.getResultStatus());
+            assertArrayEquals(current, result.getDecompressedData());
+        } finally {
+            Files.delete(path);
+        }
+    }
+
+    @Test
+    void compressResumable() throws IOException {
+        Random random = new Random(5);
+        byte[] data = new byte[3 * 1024 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("resumable ".charAt(i % 10) + random.nextInt(3));
+        }
+        Path input = Files.createTempFile("brotli4j", ".in");
+        Path output = Files.createTempFile("brotli4j", ".br");
+        Path checkpoint = input.resolveSibling(input.getFileName() + ".checkpoint");
+        try {
+            Files.write(input, data);
+            Encoder.Parameters params = new Encoder.Parameters().setQuality(5).setWindow(18);
+            long size = Encoder.compressResumable(input, output, checkpoint, 1 << 20, params);
+            assertEquals(size, Files.size(output));
+            assertTrue(Files.notExists(checkpoint));
+            assertArrayEquals(data, Decoder.decompress(Files.readAllBytes(output)).getDecompressedData());
+
+            // A run killed after the checkpoint at 1 MiB: flushed prefix followed by junk.
+            int offset = 1 << 20;
+            ByteArrayOutputStream prefix = new ByteArrayOutputStream();
+            EncoderJNI.Wrapper encoder = new EncoderJNI.Wrapper(EncoderPool.BUFFER_SIZE, 5, 18, null);
+            try {
+                int pushed = encoder.push(EncoderJNI.Operation.FLUSH, data, 0, offset);
+                while (encoder.hasMoreOutput() || encoder.hasRemainingInput() || pushed < offset) {
+                    if (encoder.hasMoreOutput()) {
+                        ByteBuffer buffer = encoder.pull();
+                        byte[] chunk = new byte[buffer.remaining()];
+                        buffer.get(chunk);
+                        prefix.write(chunk);
+                    } else if (encoder.hasRemainingInput()) {
+                        encoder.push(EncoderJNI.Operation.FLUSH, 0);
+                    } else {
+                        pushed += encoder.push(EncoderJNI.Operation.FLUSH, data, pushed, offset - pushed);
+                    }
+                }
+            } finally {
+                encoder.destroy();
+            }
+            int windowSize = (1 << 18) - 16;
+            Checkpoint.write(checkpoint, offset, prefix.size(), 5, 18,
+                    ByteBuffer.wrap(data, offset - windowSize, windowSize));
+            prefix.write(new byte[12345]);
+            Files.write(output, prefix.toByteArray());
+
+            size = Encoder.compressResumable(input, output, checkpoint, 1 << 20, params);
+            assertEquals(size, Files.size(output));
+            assertTrue(Files.notExists(checkpoint));
+            assertArrayEquals(data, Decoder.decompress(Files.readAllBytes(output)).getDecompressedData());
+        } finally {
+            Files.deleteIfExists(checkpoint);
+            Files.delete(input);
+            Files.delete(output);
+        }
+    }
+
+    @Test
+    void compressFile() throws IOException {
+        Random random = new Random(7);
+        byte[] data = new byte[10 * 1024 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("mapped file ".charAt(i % 12) + random.nextInt(4));
+        }
+        Path input = Files.createTempFile("brotli4j", ".in");
+        Path output = Files.createTempFile("brotli4j", ".br");
+        Path decoded = Files.createTempFile("brotli4j", ".out");
+        try {
+            Files.write(input, data);
+            Encoder.Parameters params = new Encoder.Parameters().setQuality(5);
+            for (int threads : new int[]{1, 3}) {
+                long size = Encoder.compressFile(input, output, params, threads);
+                assertEquals(size, Files.size(output));
+                assertEquals(data.length, Decoder.decompressFile(output, decoded));
+                assertArrayEquals(data, Files.readAllBytes(decoded));
+            }
+
+            Files.write(input, new byte[0]);
+            Encoder.compressFile(input, output, params);
+            assertEquals(0, Decoder.decompressFile(output, decoded));
+
+            Files.write(output, Arrays.copyOf(Encoder.compress(data), 1000));
+            assertThrows(IOException.class, () -> Decoder.decompressFile(output, decoded));
+        } finally {
+            Files.delete(input);
+            Files.delete(output);
+            Files.delete(decoded);
+        }
+    }
+
+    @Test
+    void fromPreset() throws IOException {
+        Path path = Files.createTempFile("brotli4j", ".presets");
+        try {
+            Files.write(path, Arrays.asList(
+                    "# text: 2 files, 600000 bytes, 3 of 24 cases",
+                    "text.0=quality=1 window=22 mode=text lgblock=16 hasher=0 bucket=0 block=-1"
+                            + " ratio=3.455 speed=186.11 memory=1753",
+                    "text.1=quality=3 window=22 mode=generic lgblock=0 hasher=0 bucket=0 block=-1"
+                            + " ratio=3.564 speed=100.36 memory=9187",
+                    "text.2=quality=5 window=20 mode=text lgblock=18 hasher=6 bucket=15 block=4"
+                            + " ratio=3.811 speed=38.23 memory=11298"), StandardCharsets.ISO_8859_1);
+
+            assertEquals(3, Encoder.Parameters.fromPreset(path, "text", 100).getQuality());
+            assertEquals(1, Encoder.Parameters.fromPreset(path, "text", 1000).getQuality());
+            Encoder.Parameters params = Encoder.Parameters.fromPreset(path, "text.2");
+            assertEquals(5, params.getQuality());
+            assertEquals(20, params.getWindow());
+            assertEquals(Encoder.Mode.TEXT, params.getMode());
+
+            byte[] data = new byte[100000];
+            for (int i = 0; i < data.length; i++) {
+                data[i] = (byte) ("preset".charAt(i % 6) + (i / 1000) % 5);
+            }
+            DirectDecompress result = Decoder.decompress(Encoder.compress(data, params));
+            assertArrayEquals(data, result.getDecompressedData());
+
+            assertThrows(IllegalArgumentException.class, () -> Encoder.Parameters.fromPreset(path, "html", 0));
+            assertThrows(IllegalArgumentException.class, () -> Encoder.Parameters.fromPreset(path, "text.9"));
+        } finally {
+            Files.delete(path);
+        }
+    }
+
+    @Test
+    void compressedCacheUpgradesInBackground() throws IOException {
+        byte[] data = new byte[200 * 1024];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ("cached body ".charAt(i % 12) + (i / 777) % 9);
+        }
+        ByteBuffer input = ByteBuffer.allocateDirect(data.length);
+        input.put(data);
+        ((Buffer) input).flip();
+        // Same-thread executor makes the upgrade finish before compress returns.
+        CompressedCache cache = new CompressedCache(1 << 20, Runnable::run);
+        Encoder.Parameters params = new Encoder.Parameters().setQuality(11);
+
+        ByteBuffer quick = cache.compress(input, params);
+        assertEquals(0, input.position());
+        assertEquals(1, cache.getMisses());
+        assertEquals(1, cache.getUpgrades());
+        ByteBuffer upgraded = cache.compress(input, params);
+        assertEquals(1, cache.getHits());
+        assertTrue(upgraded.remaining() < quick.remaining());
+        assertEquals(upgraded.remaining(), cache.getStoredBytes());
+        for (ByteBuffer stream : new ByteBuffer[]{quick, upgraded}) {
+            byte[] compressed = new byte[stream.remaining()];
+            stream.get(compressed);
+            assertArrayEquals(data, Decoder.decompress(compressed).getDecompressedData());
+        }
+
+        cache.compress(input, new Encoder.Parameters().setQuality(5));
+        assertEquals(2, cache.getMisses());
+        assertEquals(2, cache.size());
+        cache.clear();
+        assertEquals(0, cache.getStoredBytes());
+    }
+
+    @Test
+    void trainDictionary() throws IOException {
+        List<byte[]> samples = new ArrayList<>();
+        for (int i = 0; i < 200; ++i) {
+            samples.add(("{\"id\":" + i * 7919 + ",\"user\":{\"name\":\"user" + i % 13
+                    + "\",\"verified\":" + (i % 3 == 0) + "},\"status\":\"shipped\"}").getBytes());
+        }
+        byte[] raw = PreparedDictionaryGenerator.train(samples, 1024);
+        assertTrue(raw.length > 0 && raw.length <= 1024);
+        byte[] serialized = PreparedDictionaryGenerator.train(samples, 1024, true);
+        assertEquals((byte) 0x91, serialized[0]);
+        assertEquals(0, serialized[1]);
+
+        ByteBuffer dictionary = ByteBuffer.allocateDirect(raw.length);
+        dictionary.put(raw);
+        byte[] data = "{\"id\":123456,\"user\":{\"name\":\"user5\",\"verified\":false},\"status\":\"shipped\"}"
+                .getBytes();
+        ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        BrotliOutputStream output = new BrotliOutputStream(baos, new Encoder.Parameters().setQuality(11));
+        output.attachDictionary(PreparedDictionaryGenerator.generate(dictionary));
+        output.write(data);
+        output.close();
+        assertTrue(baos.size() < Encoder.compress(data).length);
+
+        assertArrayEquals(data, decompressWithDictionary(baos.toByteArray(), dictionary, data.length));
+    }
+
+    @Test
+    void offloadedChannelWrites() throws IOException {
+        byte[] data = new byte[300000];
+        Random random = new Random(3);
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) ('a' + random.nextInt(8));
+        }
+        final AtomicInteger offloaded = new AtomicInteger();
+        final ExecutorService pool = Executors.newSingleThreadExecutor();
+        try {
+            ByteArrayOutputStream compressed = new ByteArrayOutputStream();
+            WritableByteChannel sink = Channels.newChannel(compressed);
+            BrotliEncoderChannel channel = new BrotliEncoderChannel(sink, new Encoder.Parameters().setQuality(5));
+            channel.setOffloadExecutor(command -> {
+                offloaded.incrementAndGet();
+                pool.execute(command);
+            }, 65536);
+            // Big writes go to the pool, small ones are compressed in place.
+            channel.write(ByteBuffer.wrap(data, 0, 200000));
+            channel.write(ByteBuffer.wrap(data, 200000, 1000));
+            channel.write(ByteBuffer.wrap(data, 201000, data.length - 201000));
+            channel.close();
+            assertEquals(2, offloaded.get());
+            assertArrayEquals(data, Decoder.decompress(compressed.toByteArray()).getDecompressedData());
+        } finally {
+            pool.shutdownNow();
+        }
+    }
+
+    @Test
+    void concatenateFragments() throws IOException {
+        byte[][] parts = {
+                "<html><head><title>Cached page</title></head><body>".getBytes(StandardCharsets.UTF_8),
+                new byte[0],
+                "<div class=\"header\">Welcome back, the information you requested</div>"
+                        .getBytes(StandardCharsets.UTF_8),
+                "x".getBytes(StandardCharsets.UTF_8),
+                "</body></html>".getBytes(StandardCharsets.UTF_8)
+        };
+        Encoder.Parameters params = new Encoder.Parameters().setWindow(20);
+        byte[][] fragments = new byte[parts.length][];
+        for (int i = 0; i < parts.length; i++) {
+            params.setQuality(i * 5 % 12);
+            fragments[i] = Encoder.compressFragment(parts[i], params);
+        }
+        // Any order is fine; reversed one puts every fragment at a new position.
+        for (int order = 0; order < 2; order++) {
+            ByteArrayOutputStream expected = new ByteArrayOutputStream();
+            byte[][] ordered = new byte[parts.length][];
+            for (int i = 0; i < parts.length; i++) {
+                int index = (order == 0) ? i : parts.length - 1 - i;
+                expected.write(parts[index]);
+                ordered[i] = fragments[index];
+            }
+            byte[] stream = Encoder.concatenate(params, ordered);
+            DirectDecompress result = Decoder.decompress(stream);
+            assertEquals(DecoderJNI.Status.DONE, result.getResultStatus());
+            assertArrayEquals(expected.toByteArray(), result.getDecompressedData());
+        }
+        assertArrayEquals(new byte[0], Decoder.decompress(Encoder.concatenate(params)).getDecompressedData());
+    }
 }
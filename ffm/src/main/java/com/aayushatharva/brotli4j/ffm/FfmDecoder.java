@@ -0,0 +1,186 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.ffm;
+
+import com.aayushatharva.brotli4j.decoder.DecoderJNI;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+
+import static java.lang.foreign.ValueLayout.ADDRESS;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Brotli decoder calling {@code BrotliDecoderDecompressStream} through a downcall handle.
+ * <p>
+ * Compressed data is read from, and decoded data is written to, native
+ * {@link MemorySegment}s in place. Instances are not thread-safe.
+ */
+public final class FfmDecoder implements AutoCloseable {
+
+    /* BrotliDecoderParameter values; see decode.h */
+    private static final int PARAM_LARGE_WINDOW = 1;
+
+    /* Layout of stream pointers: {available_in, next_in, available_out, next_out} */
+    private static final long AVAILABLE_IN = 0;
+    private static final long NEXT_IN = 8;
+    private static final long AVAILABLE_OUT = 16;
+    private static final long NEXT_OUT = 24;
+
+    private final Arena arena;
+    private final MemorySegment io;
+    private MemorySegment state;
+    private DecoderJNI.Status lastStatus = DecoderJNI.Status.NEEDS_MORE_INPUT;
+
+    public FfmDecoder() {
+        MemorySegment created;
+        try {
+            created = (MemorySegment) NativeApi.DECODER_CREATE_INSTANCE.invokeExact(
+                    MemorySegment.NULL, MemorySegment.NULL, MemorySegment.NULL);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+        if (created.equals(MemorySegment.NULL)) {
+            throw new OutOfMemoryError("failed to initialize native brotli decoder");
+        }
+        this.state = created;
+        this.arena = Arena.ofShared();
+        this.io = arena.allocate(32, 8);
+    }
+
+    /**
+     * Decompresses the whole {@code input} into {@code output} with {@code BrotliDecoderDecompress}.
+     *
+     * @param input  native segment with compressed data
+     * @param output native segment for decoded data
+     * @return number of bytes written; -1 if data is corrupted or does not fit {@code output}
+     */
+    public static long decompress(MemorySegment input, MemorySegment output) {
+        FfmEncoder.checkNative(input, output);
+        try (Arena scratch = Arena.ofConfined()) {
+            MemorySegment decodedSize = scratch.allocate(JAVA_LONG);
+            decodedSize.set(JAVA_LONG, 0, output.byteSize());
+            int result = (int) NativeApi.DECODER_DECOMPRESS.invokeExact(input.byteSize(), input,
+                    decodedSize, output);
+            /* BROTLI_DECODER_RESULT_SUCCESS */
+            return result == 1 ? decodedSize.get(JAVA_LONG, 0) : -1;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    /**
+     * Accepts "Large Window Brotli" streams; has to be called before decoding.
+     *
+     * @return {@code false} if decoding is already started
+     */
+    public boolean setLargeWindow(boolean enabled) {
+        try {
+            return (int) NativeApi.DECODER_SET_PARAMETER.invokeExact(handle(), PARAM_LARGE_WINDOW,
+                    enabled ? 1 : 0) != 0;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    /**
+     * Consumes as much of {@code input} and fills as much of {@code output} as possible.
+     * <p>
+     * Afterwards {@link #getStatus()} tells what is next: {@code NEEDS_MORE_INPUT} after all the
+     * input is consumed, {@code NEEDS_MORE_OUTPUT} when {@code output} is full, {@code DONE} at the
+     * end of stream; unconsumed input MUST be passed again.
+     *
+     * @param input  native segment; may be empty
+     * @param output native segment
+     * @return number of consumed and produced bytes
+     */
+    public Progress decompressStream(MemorySegment input, MemorySegment output) {
+        FfmEncoder.checkNative(input, output);
+        if (lastStatus == DecoderJNI.Status.ERROR || lastStatus == DecoderJNI.Status.DONE) {
+            throw new IllegalStateException("decoding in " + lastStatus + " state");
+        }
+        long availableIn = input.byteSize();
+        long availableOut = output.byteSize();
+        io.set(JAVA_LONG, AVAILABLE_IN, availableIn);
+        io.set(ADDRESS, NEXT_IN, input);
+        io.set(JAVA_LONG, AVAILABLE_OUT, availableOut);
+        io.set(ADDRESS, NEXT_OUT, output);
+        int result;
+        try {
+            result = (int) NativeApi.DECODER_DECOMPRESS_STREAM.invokeExact(handle(),
+                    io.asSlice(AVAILABLE_IN), io.asSlice(NEXT_IN), io.asSlice(AVAILABLE_OUT),
+                    io.asSlice(NEXT_OUT), MemorySegment.NULL);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+        /* BrotliDecoderResult values match the first Status ordinals. */
+        lastStatus = DecoderJNI.Status.values()[result];
+        return new Progress(availableIn - io.get(JAVA_LONG, AVAILABLE_IN),
+                availableOut - io.get(JAVA_LONG, AVAILABLE_OUT));
+    }
+
+    public DecoderJNI.Status getStatus() {
+        return lastStatus;
+    }
+
+    public boolean hasMoreOutput() {
+        try {
+            return (int) NativeApi.DECODER_HAS_MORE_OUTPUT.invokeExact(handle()) != 0;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    /**
+     * @return name of the error that stopped decoding, e.g. {@code PADDING_1}
+     */
+    public String getErrorString() {
+        try {
+            int code = (int) NativeApi.DECODER_GET_ERROR_CODE.invokeExact(handle());
+            MemorySegment name = (MemorySegment) NativeApi.DECODER_ERROR_STRING.invokeExact(code);
+            return name.reinterpret(Long.MAX_VALUE).getString(0);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    private MemorySegment handle() {
+        if (state == null) {
+            throw new IllegalStateException("brotli decoder is already destroyed");
+        }
+        return state;
+    }
+
+    /**
+     * Releases native resources.
+     */
+    @Override
+    public void close() {
+        if (state == null) {
+            return;
+        }
+        try {
+            NativeApi.DECODER_DESTROY_INSTANCE.invokeExact(state);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        } finally {
+            state = null;
+            arena.close();
+        }
+    }
+}
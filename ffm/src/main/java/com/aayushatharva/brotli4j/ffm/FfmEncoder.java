@@ -0,0 +1,209 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.ffm;
+
+import com.aayushatharva.brotli4j.encoder.Encoder;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+
+import static java.lang.foreign.ValueLayout.ADDRESS;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Brotli encoder calling {@code BrotliEncoderCompressStream} through a downcall handle.
+ * <p>
+ * Input and output are native {@link MemorySegment}s, read and written in place; nothing
+ * is staged in intermediate buffers. Instances are not thread-safe.
+ */
+public final class FfmEncoder implements AutoCloseable {
+
+    /**
+     * <strong>Important</strong>: The ordinal value of the
+     * operations should be the same as BrotliEncoderOperation in encode.h
+     */
+    public enum Operation {
+        PROCESS,
+        FLUSH,
+        FINISH
+    }
+
+    /* BrotliEncoderParameter values; see encode.h */
+    private static final int PARAM_MODE = 0;
+    private static final int PARAM_QUALITY = 1;
+    private static final int PARAM_LGWIN = 2;
+
+    /* Layout of stream pointers: {available_in, next_in, available_out, next_out} */
+    private static final long AVAILABLE_IN = 0;
+    private static final long NEXT_IN = 8;
+    private static final long AVAILABLE_OUT = 16;
+    private static final long NEXT_OUT = 24;
+
+    private final Arena arena;
+    private final MemorySegment io;
+    private MemorySegment state;
+
+    /**
+     * @param quality compression quality, 0..11
+     * @param lgwin   log2 of window size, 10..24
+     * @param mode    compression mode; {@code null} for default
+     */
+    public FfmEncoder(int quality, int lgwin, Encoder.Mode mode) {
+        MemorySegment created;
+        try {
+            created = (MemorySegment) NativeApi.ENCODER_CREATE_INSTANCE.invokeExact(
+                    MemorySegment.NULL, MemorySegment.NULL, MemorySegment.NULL);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+        if (created.equals(MemorySegment.NULL)) {
+            throw new OutOfMemoryError("failed to initialize native brotli encoder");
+        }
+        this.state = created;
+        this.arena = Arena.ofShared();
+        this.io = arena.allocate(32, 8);
+        if (!setParameter(PARAM_QUALITY, quality) || !setParameter(PARAM_LGWIN, lgwin)
+                || (mode != null && !setParameter(PARAM_MODE, mode.ordinal()))) {
+            close();
+            throw new IllegalArgumentException("invalid encoder parameters");
+        }
+    }
+
+    /**
+     * Upper bound of compressed size of {@code inputSize} bytes, for {@link #compress(MemorySegment, MemorySegment, int)}.
+     *
+     * @return 0 if the result does not fit {@code size_t}
+     */
+    public static long maxCompressedSize(long inputSize) {
+        try {
+            return (long) NativeApi.ENCODER_MAX_COMPRESSED_SIZE.invokeExact(inputSize);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    /**
+     * Compresses the whole {@code input} into {@code output} with {@code BrotliEncoderCompress}.
+     *
+     * @param input   native segment with data to compress
+     * @param output  native segment, see {@link #maxCompressedSize(long)}
+     * @param quality compression quality, 0..11
+     * @return number of bytes written; -1 if output is too small
+     */
+    public static long compress(MemorySegment input, MemorySegment output, int quality) {
+        checkNative(input, output);
+        try (Arena scratch = Arena.ofConfined()) {
+            MemorySegment encodedSize = scratch.allocate(JAVA_LONG);
+            encodedSize.set(JAVA_LONG, 0, output.byteSize());
+            int ok = (int) NativeApi.ENCODER_COMPRESS.invokeExact(quality, 22, 0, input.byteSize(), input,
+                    encodedSize, output);
+            return ok != 0 ? encodedSize.get(JAVA_LONG, 0) : -1;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    /**
+     * Consumes as much of {@code input} and fills as much of {@code output} as possible.
+     * <p>
+     * FLUSH and FINISH have to be repeated with the rest of the input until
+     * {@link #hasMoreOutput()} is {@code false} (and, for FINISH, {@link #isFinished()} is
+     * {@code true}); input MUST not change in between.
+     *
+     * @param input  native segment; may be empty
+     * @param output native segment
+     * @return number of consumed and produced bytes
+     */
+    public Progress compressStream(MemorySegment input, MemorySegment output, Operation op) {
+        checkNative(input, output);
+        long availableIn = input.byteSize();
+        long availableOut = output.byteSize();
+        io.set(JAVA_LONG, AVAILABLE_IN, availableIn);
+        io.set(ADDRESS, NEXT_IN, input);
+        io.set(JAVA_LONG, AVAILABLE_OUT, availableOut);
+        io.set(ADDRESS, NEXT_OUT, output);
+        int ok;
+        try {
+            ok = (int) NativeApi.ENCODER_COMPRESS_STREAM.invokeExact(handle(), op.ordinal(),
+                    io.asSlice(AVAILABLE_IN), io.asSlice(NEXT_IN), io.asSlice(AVAILABLE_OUT),
+                    io.asSlice(NEXT_OUT), MemorySegment.NULL);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+        if (ok == 0) {
+            throw new IllegalStateException("brotli encoder failed");
+        }
+        return new Progress(availableIn - io.get(JAVA_LONG, AVAILABLE_IN),
+                availableOut - io.get(JAVA_LONG, AVAILABLE_OUT));
+    }
+
+    public boolean isFinished() {
+        try {
+            return (int) NativeApi.ENCODER_IS_FINISHED.invokeExact(handle()) != 0;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    public boolean hasMoreOutput() {
+        try {
+            return (int) NativeApi.ENCODER_HAS_MORE_OUTPUT.invokeExact(handle()) != 0;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    private boolean setParameter(int parameter, int value) {
+        try {
+            return (int) NativeApi.ENCODER_SET_PARAMETER.invokeExact(handle(), parameter, value) != 0;
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        }
+    }
+
+    private MemorySegment handle() {
+        if (state == null) {
+            throw new IllegalStateException("brotli encoder is already destroyed");
+        }
+        return state;
+    }
+
+    static void checkNative(MemorySegment input, MemorySegment output) {
+        if (!input.isNative() || !output.isNative()) {
+            throw new IllegalArgumentException("only native segments allowed");
+        }
+    }
+
+    /**
+     * Releases native resources.
+     */
+    @Override
+    public void close() {
+        if (state == null) {
+            return;
+        }
+        try {
+            NativeApi.ENCODER_DESTROY_INSTANCE.invokeExact(state);
+        } catch (Throwable t) {
+            throw NativeApi.rethrow(t);
+        } finally {
+            state = null;
+            arena.close();
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.ffm;
+
+import com.aayushatharva.brotli4j.Brotli4jLoader;
+
+import java.lang.foreign.FunctionDescriptor;
+import java.lang.foreign.Linker;
+import java.lang.foreign.MemorySegment;
+import java.lang.foreign.SymbolLookup;
+import java.lang.invoke.MethodHandle;
+
+import static java.lang.foreign.ValueLayout.ADDRESS;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Downcall handles of the brotli C API, looked up in the library loaded by {@link Brotli4jLoader}.
+ * <p>
+ * {@code size_t} is bound as {@code long}; all supported platforms are 64-bit. Calls that
+ * neither block nor call back are linked with {@link Linker.Option#critical(boolean)}, which
+ * skips the thread state transition.
+ */
+final class NativeApi {
+
+    static final MethodHandle ENCODER_CREATE_INSTANCE;
+    static final MethodHandle ENCODER_SET_PARAMETER;
+    static final MethodHandle ENCODER_COMPRESS_STREAM;
+    static final MethodHandle ENCODER_IS_FINISHED;
+    static final MethodHandle ENCODER_HAS_MORE_OUTPUT;
+    static final MethodHandle ENCODER_DESTROY_INSTANCE;
+    static final MethodHandle ENCODER_MAX_COMPRESSED_SIZE;
+    static final MethodHandle ENCODER_COMPRESS;
+
+    static final MethodHandle DECODER_CREATE_INSTANCE;
+    static final MethodHandle DECODER_SET_PARAMETER;
+    static final MethodHandle DECODER_DECOMPRESS_STREAM;
+    static final MethodHandle DECODER_HAS_MORE_OUTPUT;
+    static final MethodHandle DECODER_GET_ERROR_CODE;
+    static final MethodHandle DECODER_ERROR_STRING;
+    static final MethodHandle DECODER_DESTROY_INSTANCE;
+    static final MethodHandle DECODER_DECOMPRESS;
+
+    static {
+        Brotli4jLoader.ensureAvailability();
+        if (ADDRESS.byteSize() != JAVA_LONG.byteSize()) {
+            throw new UnsupportedOperationException("only 64-bit platforms are supported");
+        }
+        Linker linker = Linker.nativeLinker();
+        SymbolLookup lookup = SymbolLookup.loaderLookup();
+
+        ENCODER_CREATE_INSTANCE = bind(linker, lookup, "BrotliEncoderCreateInstance", false,
+                FunctionDescriptor.of(ADDRESS, ADDRESS, ADDRESS, ADDRESS));
+        ENCODER_SET_PARAMETER = bind(linker, lookup, "BrotliEncoderSetParameter", true,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS, JAVA_INT, JAVA_INT));
+        ENCODER_COMPRESS_STREAM = bind(linker, lookup, "BrotliEncoderCompressStream", false,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS, JAVA_INT, ADDRESS, ADDRESS, ADDRESS, ADDRESS, ADDRESS));
+        ENCODER_IS_FINISHED = bind(linker, lookup, "BrotliEncoderIsFinished", true,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS));
+        ENCODER_HAS_MORE_OUTPUT = bind(linker, lookup, "BrotliEncoderHasMoreOutput", true,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS));
+        ENCODER_DESTROY_INSTANCE = bind(linker, lookup, "BrotliEncoderDestroyInstance", false,
+                FunctionDescriptor.ofVoid(ADDRESS));
+        ENCODER_MAX_COMPRESSED_SIZE = bind(linker, lookup, "BrotliEncoderMaxCompressedSize", true,
+                FunctionDescriptor.of(JAVA_LONG, JAVA_LONG));
+        ENCODER_COMPRESS = bind(linker, lookup, "BrotliEncoderCompress", false,
+                FunctionDescriptor.of(JAVA_INT, JAVA_INT, JAVA_INT, JAVA_INT, JAVA_LONG, ADDRESS, ADDRESS, ADDRESS));
+
+        DECODER_CREATE_INSTANCE = bind(linker, lookup, "BrotliDecoderCreateInstance", false,
+                FunctionDescriptor.of(ADDRESS, ADDRESS, ADDRESS, ADDRESS));
+        DECODER_SET_PARAMETER = bind(linker, lookup, "BrotliDecoderSetParameter", true,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS, JAVA_INT, JAVA_INT));
+        DECODER_DECOMPRESS_STREAM = bind(linker, lookup, "BrotliDecoderDecompressStream", false,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS, ADDRESS, ADDRESS, ADDRESS, ADDRESS, ADDRESS));
+        DECODER_HAS_MORE_OUTPUT = bind(linker, lookup, "BrotliDecoderHasMoreOutput", true,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS));
+        DECODER_GET_ERROR_CODE = bind(linker, lookup, "BrotliDecoderGetErrorCode", true,
+                FunctionDescriptor.of(JAVA_INT, ADDRESS));
+        DECODER_ERROR_STRING = bind(linker, lookup, "BrotliDecoderErrorString", true,
+                FunctionDescriptor.of(ADDRESS, JAVA_INT));
+        DECODER_DESTROY_INSTANCE = bind(linker, lookup, "BrotliDecoderDestroyInstance", false,
+                FunctionDescriptor.ofVoid(ADDRESS));
+        DECODER_DECOMPRESS = bind(linker, lookup, "BrotliDecoderDecompress", false,
+                FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, ADDRESS, ADDRESS));
+    }
+
+    // Disallow instantiation.
+    private NativeApi() {
+    }
+
+    private static MethodHandle bind(Linker linker, SymbolLookup lookup, String name, boolean critical,
+                                     FunctionDescriptor descriptor) {
+        MemorySegment symbol = lookup.find(name)
+                .orElseThrow(() -> new UnsatisfiedLinkError("brotli native library does not export " + name));
+        if (critical) {
+            return linker.downcallHandle(symbol, descriptor, Linker.Option.critical(false));
+        }
+        return linker.downcallHandle(symbol, descriptor);
+    }
+
+    /**
+     * Rethrows failures of {@link MethodHandle#invokeExact}; downcalls only throw unchecked ones.
+     */
+    static RuntimeException rethrow(Throwable t) {
+        if (t instanceof RuntimeException) {
+            return (RuntimeException) t;
+        }
+        if (t instanceof Error) {
+            throw (Error) t;
+        }
+        return new IllegalStateException(t);
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ *   Copyright 2021, Aayush Atharva
+ *
+ *   Brotli4j licenses this file to you under the
+ *   Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+package com.aayushatharva.brotli4j.ffm;
+
+import com.aayushatharva.brotli4j.decoder.DecoderJNI;
+import org.junit.jupiter.api.Test;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.nio.charset.StandardCharsets;
+
+import static java.lang.foreign.ValueLayout.JAVA_BYTE;
+import static org.junit.jupiter.api.Assertions.*;
+
+class FfmTest {
+
+    private static byte[] testData() {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < 20000; i++) {
+            sb.append("line ").append(i % 397).append(": brotli over java.lang.foreign\n");
+        }
+        return sb.toString().getBytes(StandardCharsets.UTF_8);
+    }
+
+    @Test
+    void oneShotRoundTrip() {
+        byte[] data = testData();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment input = arena.allocateFrom(JAVA_BYTE, data);
+            MemorySegment compressed = arena.allocate(FfmEncoder.maxCompressedSize(data.length));
+            long compressedSize = FfmEncoder.compress(input, compressed, 5);
+            assertTrue(compressedSize > 0 && compressedSize < data.length);
+
+            MemorySegment decoded = arena.allocate(data.length);
+            assertEquals(data.length, FfmDecoder.decompress(compressed.asSlice(0, compressedSize), decoded));
+            assertArrayEquals(data, decoded.toArray(JAVA_BYTE));
+        }
+    }
+
+    @Test
+    void streamingRoundTrip() {
+        byte[] data = testData();
+        try (Arena arena = Arena.ofConfined();
+             FfmEncoder encoder = new FfmEncoder(9, 18, null);
+             FfmDecoder decoder = new FfmDecoder()) {
+            MemorySegment input = arena.allocateFrom(JAVA_BYTE, data);
+            MemorySegment compressed = arena.allocate(data.length);
+            // Small output makes the encoder report pending output many times.
+            MemorySegment chunk = arena.allocate(1000);
+            long inputPos = 0;
+            long compressedSize = 0;
+            while (!encoder.isFinished()) {
+                Progress progress = encoder.compressStream(input.asSlice(inputPos), chunk,
+                        FfmEncoder.Operation.FINISH);
+                MemorySegment.copy(chunk, 0, compressed, compressedSize, progress.produced());
+                inputPos += progress.consumed();
+                compressedSize += progress.produced();
+            }
+            assertEquals(data.length, inputPos);
+
+            MemorySegment decoded = arena.allocate(data.length);
+            long compressedPos = 0;
+            long decodedSize = 0;
+            while (decoder.getStatus() != DecoderJNI.Status.DONE) {
+                // Feed compressed data in small pieces, output in the remaining space.
+                long piece = Math.min(777, compressedSize - compressedPos);
+                Progress progress = decoder.decompressStream(compressed.asSlice(compressedPos, piece),
+                        decoded.asSlice(decodedSize));
+                assertNotEquals(DecoderJNI.Status.ERROR, decoder.getStatus());
+                compressedPos += progress.consumed();
+                decodedSize += progress.produced();
+            }
+            assertEquals(compressedSize, compressedPos);
+            assertArrayEquals(data, decoded.toArray(JAVA_BYTE));
+        }
+    }
+
+    @Test
+    void corruptedStream() {
+        try (Arena arena = Arena.ofConfined(); FfmDecoder decoder = new FfmDecoder()) {
+            MemorySegment input = arena.allocateFrom(JAVA_BYTE, new byte[]{-1, -1, -1, -1});
+            decoder.decompressStream(input, arena.allocate(16));
+            assertEquals(DecoderJNI.Status.ERROR, decoder.getStatus());
+            assertFalse(decoder.getErrorString().isEmpty());
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.flow;
+
+import com.aayushatharva.brotli4j.decoder.DecoderJNI;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * Decompresses upstream buffers holding a single brotli stream.
+ * <p>
+ * Native decoder reads the input in place and writes straight into the emitted buffers;
+ * decoded data stays in the decoder ring buffer until the subscriber asks for it.
+ * Subscriber gets an {@link IOException} if the stream is corrupt, truncated or followed
+ * by more data.
+ *
+ * @see BrotliProcessor
+ */
+public final class BrotliDecodingProcessor extends BrotliProcessor {
+    /* Input is never staged, so the staging buffer is as small as allowed. */
+    private static final int STAGING_BUFFER_SIZE = 1;
+
+    private final DecoderJNI.Wrapper decoder;
+
+    /**
+     * @throws IOException if native decoder can not be created
+     */
+    public BrotliDecodingProcessor() throws IOException {
+        this(DEFAULT_OUTPUT_BUFFER_SIZE);
+    }
+
+    /**
+     * @param outputBufferSize capacity of emitted buffers
+     * @throws IOException if native decoder can not be created
+     */
+    public BrotliDecodingProcessor(int outputBufferSize) throws IOException {
+        super(outputBufferSize);
+        this.decoder = new DecoderJNI.Wrapper(STAGING_BUFFER_SIZE);
+    }
+
+    @Override
+    boolean process(ByteBuffer input, ByteBuffer output) throws IOException {
+        if (decoder.getStatus() == DecoderJNI.Status.DONE) {
+            if (input.hasRemaining()) {
+                throw new IOException("unexpected data after the end of brotli stream");
+            }
+            return true;
+        }
+        decoder.decompress(input, output);
+        switch (decoder.getStatus()) {
+            case NEEDS_MORE_INPUT:
+            case DONE:
+                return true;
+            case NEEDS_MORE_OUTPUT:
+                return false;
+            default:
+                throw new IOException("corrupt brotli stream");
+        }
+    }
+
+    @Override
+    boolean finish(ByteBuffer output) throws IOException {
+        if (decoder.getStatus() != DecoderJNI.Status.DONE) {
+            throw new IOException("truncated brotli stream");
+        }
+        return true;
+    }
+
+    @Override
+    void release() {
+        decoder.destroy();
+    }
+}
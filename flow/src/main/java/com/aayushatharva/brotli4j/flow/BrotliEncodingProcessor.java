@@ -0,0 +1,86 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.flow;
+
+import com.aayushatharva.brotli4j.encoder.DirectEncoder;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * Compresses upstream buffers into a single brotli stream; the stream is finished when
+ * upstream completes.
+ * <p>
+ * Native encoder writes straight into the emitted buffers, so output stays in the
+ * encoder until the subscriber asks for it.
+ *
+ * @see BrotliProcessor
+ */
+public final class BrotliEncodingProcessor extends BrotliProcessor {
+    private static final ByteBuffer[] NO_INPUT = new ByteBuffer[0];
+
+    private final DirectEncoder encoder;
+    private final ByteBuffer[] srcs = new ByteBuffer[1];
+    private final ByteBuffer[] dsts = new ByteBuffer[1];
+
+    /**
+     * @param params encoding parameters
+     * @throws IOException if native encoder can not be created
+     */
+    public BrotliEncodingProcessor(Encoder.Parameters params) throws IOException {
+        this(params, DEFAULT_OUTPUT_BUFFER_SIZE);
+    }
+
+    /**
+     * @param params           encoding parameters
+     * @param outputBufferSize capacity of emitted buffers
+     * @throws IOException if native encoder can not be created
+     */
+    public BrotliEncodingProcessor(Encoder.Parameters params, int outputBufferSize) throws IOException {
+        super(outputBufferSize);
+        this.encoder = new DirectEncoder(params);
+    }
+
+    @Override
+    boolean process(ByteBuffer input, ByteBuffer output) throws IOException {
+        srcs[0] = input;
+        dsts[0] = output;
+        try {
+            return encoder.process(srcs, dsts);
+        } finally {
+            srcs[0] = null;
+            dsts[0] = null;
+        }
+    }
+
+    @Override
+    boolean finish(ByteBuffer output) throws IOException {
+        dsts[0] = output;
+        try {
+            return encoder.finish(NO_INPUT, dsts);
+        } finally {
+            dsts[0] = null;
+        }
+    }
+
+    @Override
+    void release() {
+        encoder.close();
+    }
+}
@@ -0,0 +1,310 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.flow;
+
+import com.aayushatharva.brotli4j.common.DirectBufferPool;
+
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.util.Objects;
+import java.util.concurrent.Flow;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicLong;
+
+/**
+ * Demand-driven {@link Flow.Processor} over a native brotli coder.
+ * <p>
+ * Native coder runs only while the subscriber has outstanding demand: each emitted
+ * buffer answers one unit of it. Upstream items are requested one at a time, once the
+ * previous one is consumed, so at most one input item and one output buffer are held
+ * besides the native state, however slow the subscriber is; there is no queue.
+ * <p>
+ * Output buffers are direct ones taken from {@link DirectBufferPool}; ownership passes to
+ * the subscriber, which MAY return them with {@link DirectBufferPool#release(ByteBuffer)}.
+ * A buffer is emitted when it is full, or when an input item is consumed and some output
+ * is ready. Direct input buffers are read in place, and their positions are advanced;
+ * heap ones are copied in pieces to a pooled direct buffer.
+ * <p>
+ * Processor has a single subscriber. Signals are serialized by a work-in-progress
+ * counter; native coder is released on completion, error or cancellation.
+ */
+public abstract class BrotliProcessor implements Flow.Processor<ByteBuffer, ByteBuffer> {
+    /**
+     * The default capacity of emitted buffers.
+     */
+    public static final int DEFAULT_OUTPUT_BUFFER_SIZE = 65536;
+
+    private static final int STAGING_BUFFER_SIZE = 65536;
+
+    private final int outputBufferSize;
+    private final AtomicInteger wip = new AtomicInteger();
+    private final AtomicLong demand = new AtomicLong();
+
+    private volatile Flow.Subscription upstream;
+    private volatile Flow.Subscriber<? super ByteBuffer> downstream;
+    private volatile ByteBuffer incoming;
+    private volatile boolean upstreamDone;
+    private volatile Throwable upstreamError;
+    private volatile Throwable requestError;
+    private volatile boolean cancelled;
+
+    /* Accessed only in drain(). */
+    private boolean requested;
+    private boolean terminated;
+    /* Upstream MAY subscribe after termination; it is cancelled then. */
+    private boolean cancelUpstream;
+    private ByteBuffer source;
+    private ByteBuffer staging;
+    private ByteBuffer output;
+
+    BrotliProcessor(int outputBufferSize) {
+        if (outputBufferSize <= 0 || outputBufferSize > DirectBufferPool.MAX_CAPACITY) {
+            throw new IllegalArgumentException("invalid output buffer size");
+        }
+        this.outputBufferSize = outputBufferSize;
+    }
+
+    /**
+     * Codes as much of {@code input} as fits {@code output}.
+     *
+     * @return {@code true} if input is consumed and no output is pending
+     */
+    abstract boolean process(ByteBuffer input, ByteBuffer output) throws IOException;
+
+    /**
+     * Ends the stream after the last input.
+     *
+     * @return {@code true} if the stream is complete and no output is pending
+     */
+    abstract boolean finish(ByteBuffer output) throws IOException;
+
+    /**
+     * Releases native coder; invoked once.
+     */
+    abstract void release();
+
+    @Override
+    public void subscribe(Flow.Subscriber<? super ByteBuffer> subscriber) {
+        Objects.requireNonNull(subscriber, "subscriber");
+        synchronized (this) {
+            if (downstream == null) {
+                downstream = subscriber;
+                subscriber.onSubscribe(new Subscription());
+                drain();
+                return;
+            }
+        }
+        subscriber.onSubscribe(new Flow.Subscription() {
+            @Override
+            public void request(long n) {
+            }
+
+            @Override
+            public void cancel() {
+            }
+        });
+        subscriber.onError(new IllegalStateException("processor has a subscriber already"));
+    }
+
+    @Override
+    public void onSubscribe(Flow.Subscription subscription) {
+        Objects.requireNonNull(subscription, "subscription");
+        synchronized (this) {
+            if (upstream == null) {
+                upstream = subscription;
+                drain();
+                return;
+            }
+        }
+        subscription.cancel();
+    }
+
+    @Override
+    public void onNext(ByteBuffer item) {
+        incoming = Objects.requireNonNull(item, "item");
+        drain();
+    }
+
+    @Override
+    public void onError(Throwable throwable) {
+        upstreamError = Objects.requireNonNull(throwable, "throwable");
+        drain();
+    }
+
+    @Override
+    public void onComplete() {
+        upstreamDone = true;
+        drain();
+    }
+
+    private final class Subscription implements Flow.Subscription {
+        @Override
+        public void request(long n) {
+            if (n <= 0) {
+                requestError = new IllegalArgumentException("non-positive request: " + n);
+            } else {
+                demand.getAndAccumulate(n, (a, b) -> (a + b < 0) ? Long.MAX_VALUE : a + b);
+            }
+            drain();
+        }
+
+        @Override
+        public void cancel() {
+            cancelled = true;
+            drain();
+        }
+    }
+
+    private void drain() {
+        if (wip.getAndIncrement() != 0) {
+            return;
+        }
+        int missed = 1;
+        do {
+            if (!terminated) {
+                try {
+                    work();
+                } catch (IOException | RuntimeException e) {
+                    terminate(e, true);
+                }
+            }
+            Flow.Subscription subscription = upstream;
+            if (cancelUpstream && subscription != null) {
+                cancelUpstream = false;
+                subscription.cancel();
+            }
+            missed = wip.addAndGet(-missed);
+        } while (missed != 0);
+    }
+
+    private void work() throws IOException {
+        Flow.Subscriber<? super ByteBuffer> subscriber = downstream;
+        while (!terminated) {
+            if (cancelled) {
+                terminate(null, false);
+                return;
+            }
+            if (subscriber == null) {
+                return;
+            }
+            if (requestError != null) {
+                terminate(requestError, true);
+                return;
+            }
+            if (upstreamError != null) {
+                terminate(upstreamError, false);
+                return;
+            }
+            if (source == null && incoming != null) {
+                source = incoming;
+                incoming = null;
+                requested = false;
+            }
+            if (demand.get() == 0) {
+                return;
+            }
+            if (output == null) {
+                output = DirectBufferPool.acquire(outputBufferSize);
+                ((Buffer) output).limit(outputBufferSize);
+            }
+
+            boolean done;
+            if (source != null) {
+                done = process(input(), output);
+                if (done && !source.hasRemaining() && (staging == null || !staging.hasRemaining())) {
+                    source = null;
+                    if (staging != null) {
+                        DirectBufferPool.release(staging);
+                        staging = null;
+                    }
+                }
+            } else if (upstreamDone) {
+                done = finish(output);
+                if (done) {
+                    if (output.position() != 0) {
+                        emit(subscriber);
+                    }
+                    terminate(null, false);
+                    return;
+                }
+            } else {
+                if (!requested && upstream != null) {
+                    requested = true;
+                    upstream.request(1);
+                }
+                return;
+            }
+            if (!output.hasRemaining() || (done && output.position() != 0)) {
+                emit(subscriber);
+            }
+        }
+    }
+
+    /* Remaining part of the current item, in native-accessible memory. */
+    private ByteBuffer input() {
+        if (source.isDirect()) {
+            return source;
+        }
+        if (staging == null) {
+            staging = DirectBufferPool.acquire(Math.min(Math.max(source.remaining(), 1), STAGING_BUFFER_SIZE));
+            ((Buffer) staging).limit(0);
+        }
+        if (!staging.hasRemaining() && source.hasRemaining()) {
+            ((Buffer) staging).clear();
+            int length = Math.min(staging.remaining(), source.remaining());
+            ByteBuffer slice = source.duplicate();
+            ((Buffer) slice).limit(slice.position() + length);
+            staging.put(slice);
+            ((Buffer) source).position(source.position() + length);
+            ((Buffer) staging).flip();
+        }
+        return staging;
+    }
+
+    private void emit(Flow.Subscriber<? super ByteBuffer> subscriber) {
+        ByteBuffer buffer = output;
+        output = null;
+        ((Buffer) buffer).flip();
+        demand.decrementAndGet();
+        subscriber.onNext(buffer);
+    }
+
+    private void terminate(Throwable error, boolean cancelUpstream) {
+        terminated = true;
+        this.cancelUpstream = (cancelUpstream || cancelled) && !upstreamDone;
+        release();
+        if (staging != null) {
+            DirectBufferPool.release(staging);
+            staging = null;
+        }
+        if (output != null) {
+            DirectBufferPool.release(output);
+            output = null;
+        }
+        source = null;
+        incoming = null;
+        if (!cancelled) {
+            if (error != null) {
+                downstream.onError(error);
+            } else {
+                downstream.onComplete();
+            }
+        }
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ *   Copyright 2021, Aayush Atharva
+ *
+ *   Brotli4j licenses this file to you under the
+ *   Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+package com.aayushatharva.brotli4j.flow;
+
+import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+import org.junit.jupiter.api.BeforeAll;
+import org.junit.jupiter.api.Test;
+
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.Random;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.Flow;
+import java.util.concurrent.SubmissionPublisher;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicLong;
+
+import static org.junit.jupiter.api.Assertions.*;
+
+class BrotliProcessorTest {
+
+    @BeforeAll
+    static void load() {
+        Brotli4jLoader.ensureAvailability();
+    }
+
+    private static byte[] testData() {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < 50000; i++) {
+            sb.append("event ").append(i % 997).append(": flow processor\n");
+        }
+        return sb.toString().getBytes(StandardCharsets.UTF_8);
+    }
+
+    /* Requests one buffer at a time, as a slow consumer would. */
+    private static final class Collector implements Flow.Subscriber<ByteBuffer> {
+        final ByteArrayOutputStream data = new ByteArrayOutputStream();
+        final CompletableFuture<byte[]> result = new CompletableFuture<>();
+        Flow.Subscription subscription;
+
+        @Override
+        public void onSubscribe(Flow.Subscription subscription) {
+            this.subscription = subscription;
+            subscription.request(1);
+        }
+
+        @Override
+        public void onNext(ByteBuffer item) {
+            byte[] chunk = new byte[item.remaining()];
+            item.get(chunk);
+            data.write(chunk, 0, chunk.length);
+            subscription.request(1);
+        }
+
+        @Override
+        public void onError(Throwable throwable) {
+            result.completeExceptionally(throwable);
+        }
+
+        @Override
+        public void onComplete() {
+            result.complete(data.toByteArray());
+        }
+    }
+
+    @Test
+    void roundTrip() throws Exception {
+        byte[] data = testData();
+        BrotliEncodingProcessor encoder = new BrotliEncodingProcessor(new Encoder.Parameters().setQuality(5), 4096);
+        BrotliDecodingProcessor decoder = new BrotliDecodingProcessor(4096);
+        Collector collector = new Collector();
+        encoder.subscribe(decoder);
+        decoder.subscribe(collector);
+        try (SubmissionPublisher<ByteBuffer> publisher = new SubmissionPublisher<>()) {
+            publisher.subscribe(encoder);
+            for (int offset = 0; offset < data.length; offset += 10000) {
+                int length = Math.min(10000, data.length - offset);
+                ByteBuffer item = (offset % 20000 == 0)
+                        ? ByteBuffer.wrap(data, offset, length)
+                        : ByteBuffer.allocateDirect(length).put(data, offset, length).flip();
+                publisher.submit(item);
+            }
+        }
+        assertArrayEquals(data, collector.result.get(10, TimeUnit.SECONDS));
+    }
+
+    @Test
+    void upstreamIsNotDrainedWithoutDemand() throws Exception {
+        AtomicLong requested = new AtomicLong();
+        BrotliEncodingProcessor encoder = new BrotliEncodingProcessor(new Encoder.Parameters().setQuality(0), 1024);
+        encoder.onSubscribe(new Flow.Subscription() {
+            @Override
+            public void request(long n) {
+                requested.addAndGet(n);
+            }
+
+            @Override
+            public void cancel() {
+            }
+        });
+        assertEquals(0, requested.get());
+
+        AtomicLong received = new AtomicLong();
+        encoder.subscribe(new Flow.Subscriber<ByteBuffer>() {
+            @Override
+            public void onSubscribe(Flow.Subscription subscription) {
+                subscription.request(1);
+            }
+
+            @Override
+            public void onNext(ByteBuffer item) {
+                received.incrementAndGet();
+            }
+
+            @Override
+            public void onError(Throwable throwable) {
+            }
+
+            @Override
+            public void onComplete() {
+            }
+        });
+        assertEquals(1, requested.get());
+        // Random data fills the only requested output buffer long before it is consumed.
+        byte[] noise = new byte[1 << 20];
+        new Random(5).nextBytes(noise);
+        encoder.onNext(ByteBuffer.wrap(noise));
+        assertEquals(1, received.get());
+        assertEquals(1, requested.get());
+    }
+
+    @Test
+    void truncatedStreamFails() throws Exception {
+        byte[] compressed = Encoder.compress(testData());
+        BrotliDecodingProcessor decoder = new BrotliDecodingProcessor();
+        Collector collector = new Collector();
+        decoder.subscribe(collector);
+        try (SubmissionPublisher<ByteBuffer> publisher = new SubmissionPublisher<>()) {
+            publisher.subscribe(decoder);
+            publisher.submit(ByteBuffer.wrap(compressed, 0, compressed.length / 2));
+        }
+        Exception e = assertThrows(Exception.class, () -> collector.result.get(10, TimeUnit.SECONDS));
+        assertTrue(e.getCause() instanceof IOException);
+    }
+}
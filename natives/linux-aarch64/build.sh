@@ -4,18 +4,48 @@ CURPATH=$(pwd)
 TARGET_CLASSES_PATH="target/classes/lib/linux-aarch64"
 TARGET_PATH="target"
 
+# CPU-specific variants packaged next to the baseline library; Brotli4jLoader
+# loads the best one the CPU supports. Set BROTLI4J_VARIANTS to build a
+# subset ("" for the baseline only) and BROTLI4J_PGO_CORPUS to a list of
+# files to train all the libraries on.
+VARIANTS=${BROTLI4J_VARIANTS-"armv8.2-a"}
+
 exitWithError() {
   cd ${CURPATH}
   echo "*** An error occurred. Please check log messages. ***"
   exit $1
 }
 
+# Builds libbrotli.so in the current directory with $1 code generation flags.
+buildLibrary() {
+  if [ -n "$BROTLI4J_PGO_CORPUS" ]; then
+    cmake "$CURPATH/../.." -DBROTLI4J_ARCH_FLAGS="$1" -DBROTLI4J_PGO=GENERATE || exitWithError $?
+    make || exitWithError $?
+    ./brotli4j_train -i 1 $BROTLI4J_PGO_CORPUS > /dev/null || exitWithError $?
+    cmake "$CURPATH/../.." -DBROTLI4J_ARCH_FLAGS="$1" -DBROTLI4J_PGO=USE || exitWithError $?
+  else
+    cmake "$CURPATH/../.." -DBROTLI4J_ARCH_FLAGS="$1" || exitWithError $?
+  fi
+  make || exitWithError $?
+}
+
 mkdir -p "$TARGET_CLASSES_PATH"
 
 cd "$TARGET_PATH"
-cmake ../../../ || exitWithError $?
-make || exitWithError $?
+buildLibrary ""
 rm -f "$CURPATH/${TARGET_CLASSES_PATH}/libbrotli.so"
 cp "./libbrotli.so" "$CURPATH/${TARGET_CLASSES_PATH}" || exitWithError $?
 
+for VARIANT in $VARIANTS; do
+  case "$VARIANT" in
+    armv8.2-a) FLAGS="-march=armv8.2-a" ;;
+    *) echo "unknown variant $VARIANT"; exitWithError 1 ;;
+  esac
+  mkdir -p "$CURPATH/$TARGET_PATH/$VARIANT" "$CURPATH/${TARGET_CLASSES_PATH}/$VARIANT"
+  cd "$CURPATH/$TARGET_PATH/$VARIANT"
+  buildLibrary "$FLAGS"
+  rm -f "$CURPATH/${TARGET_CLASSES_PATH}/$VARIANT/libbrotli.so"
+  cp "./libbrotli.so" "$CURPATH/${TARGET_CLASSES_PATH}/$VARIANT" || exitWithError $?
+done
+
 cd "${CURPATH}"
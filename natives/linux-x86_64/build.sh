@@ -4,18 +4,54 @@ CURPATH=$(pwd)
 TARGET_CLASSES_PATH="target/classes/lib/linux-x86_64"
 TARGET_PATH="target"
 
+# CPU-specific variants packaged next to the baseline library; Brotli4jLoader
+# loads the best one the CPU supports. Flags spell out the x86-64 psABI
+# levels, as -march=x86-64-vN needs GCC 11. Set BROTLI4J_VARIANTS to build a
+# subset ("" for the baseline only) and BROTLI4J_PGO_CORPUS to a list of
+# files to train all the libraries on.
+X86_64_V2="-mcx16 -msahf -mpopcnt -msse3 -mssse3 -msse4.1 -msse4.2"
+X86_64_V3="$X86_64_V2 -mavx -mavx2 -mbmi -mbmi2 -mf16c -mfma -mlzcnt -mmovbe -mxsave"
+X86_64_V4="$X86_64_V3 -mavx512f -mavx512bw -mavx512cd -mavx512dq -mavx512vl"
+VARIANTS=${BROTLI4J_VARIANTS-"x86-64-v2 x86-64-v3 x86-64-v4"}
+
 exitWithError() {
   cd ${CURPATH}
   echo "*** An error occurred. Please check log messages. ***"
   exit $1
 }
 
+# Builds libbrotli.so in the current directory with $1 code generation flags.
+buildLibrary() {
+  if [ -n "$BROTLI4J_PGO_CORPUS" ]; then
+    cmake "$CURPATH/../.." -DBROTLI4J_ARCH_FLAGS="$1" -DBROTLI4J_PGO=GENERATE || exitWithError $?
+    make || exitWithError $?
+    ./brotli4j_train -i 1 $BROTLI4J_PGO_CORPUS > /dev/null || exitWithError $?
+    cmake "$CURPATH/../.." -DBROTLI4J_ARCH_FLAGS="$1" -DBROTLI4J_PGO=USE || exitWithError $?
+  else
+    cmake "$CURPATH/../.." -DBROTLI4J_ARCH_FLAGS="$1" || exitWithError $?
+  fi
+  make || exitWithError $?
+}
+
 mkdir -p "$TARGET_CLASSES_PATH"
 
 cd "$TARGET_PATH"
-cmake ../../../ || exitWithError $?
-make || exitWithError $?
+buildLibrary ""
 rm -f "$CURPATH/${TARGET_CLASSES_PATH}/libbrotli.so"
 cp "./libbrotli.so" "$CURPATH/${TARGET_CLASSES_PATH}" || exitWithError $?
 
+for VARIANT in $VARIANTS; do
+  case "$VARIANT" in
+    x86-64-v2) FLAGS="$X86_64_V2" ;;
+    x86-64-v3) FLAGS="$X86_64_V3" ;;
+    x86-64-v4) FLAGS="$X86_64_V4" ;;
+    *) echo "unknown variant $VARIANT"; exitWithError 1 ;;
+  esac
+  mkdir -p "$CURPATH/$TARGET_PATH/$VARIANT" "$CURPATH/${TARGET_CLASSES_PATH}/$VARIANT"
+  cd "$CURPATH/$TARGET_PATH/$VARIANT"
+  buildLibrary "$FLAGS"
+  rm -f "$CURPATH/${TARGET_CLASSES_PATH}/$VARIANT/libbrotli.so"
+  cp "./libbrotli.so" "$CURPATH/${TARGET_CLASSES_PATH}/$VARIANT" || exitWithError $?
+done
+
 cd "${CURPATH}"
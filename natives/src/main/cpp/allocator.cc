@@ -0,0 +1,365 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "allocator.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/* Keeps blocks aligned as malloc does. */
+const size_t kHeaderSize = 16;
+
+/* Pooled sizes are in (2^(kMinLog - 1), 2^kMaxLog] range; other blocks are
+   served by malloc directly. */
+const int kMinLog = 12;
+const int kMaxLog = 28;
+const uint32_t kNumClasses = (kMaxLog - kMinLog + 1) * 4;
+const uint32_t kUnpooled = kNumClasses;
+
+/* Free blocks kept by a single thread; the rest goes back to malloc. */
+const size_t kMaxCachedBytes = (size_t)64 << 20;
+
+typedef struct FreeBlock {
+  FreeBlock* next;
+} FreeBlock;
+
+struct ThreadCache {
+  FreeBlock* free_lists[kNumClasses];
+  size_t cached_bytes;
+
+  ThreadCache() : cached_bytes(0) {
+    for (uint32_t i = 0; i < kNumClasses; ++i) free_lists[i] = nullptr;
+  }
+
+  ~ThreadCache() {
+    for (uint32_t i = 0; i < kNumClasses; ++i) {
+      while (!!free_lists[i]) {
+        FreeBlock* block = free_lists[i];
+        free_lists[i] = block->next;
+        free(block);
+      }
+    }
+  }
+};
+
+thread_local ThreadCache cache;
+
+/* Returns size class for |size| bytes; kUnpooled if it is too small or big. */
+uint32_t SizeClass(size_t size) {
+  if (size <= ((size_t)1 << (kMinLog - 1)) ||
+      size > ((size_t)1 << kMaxLog)) {
+    return kUnpooled;
+  }
+  size_t n = size - 1;
+  int log = kMinLog - 1;
+  while ((n >> log) > 1) ++log;
+  /* Quarter of the power of two determines class inside of it. */
+  uint32_t quarter = (uint32_t)(n >> (log - 2)) & 3;
+  return (uint32_t)(log - kMinLog + 1) * 4 + quarter;
+}
+
+size_t ClassSize(uint32_t size_class) {
+  int log = (int)(size_class >> 2) + kMinLog - 1;
+  return (size_t)((size_class & 3) + 5) << (log - 2);
+}
+
+/* Marks of TrackedAlloc blocks, stored after the size. */
+const uint32_t kHeapBlock = 0;
+const uint32_t kMappedBlock = 1;
+
+size_t MappedSize(size_t size) {
+  return (size + brotli4j::kHugePageSize - 1) & ~(brotli4j::kHugePageSize - 1);
+}
+
+/* Big blocks are mapped as one regular page, that ends with the header,
+   followed by huge pages holding the data; so data is aligned to huge pages,
+   and no huge page is spent on the header. Returns the header address, or
+   nullptr if such mapping is not possible; regular heap is used then. */
+uint8_t* MapHugePages(size_t size, brotli4j::HugePages policy) {
+#if defined(__linux__)
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t mapped_size = MappedSize(size);
+  /* Over-map by a huge page to align the data; the excess is unmapped. */
+  size_t reserved_size = page_size + mapped_size + brotli4j::kHugePageSize;
+  void* reserved = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserved == MAP_FAILED) return nullptr;
+  uint8_t* start = static_cast<uint8_t*>(reserved);
+  uint8_t* data = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(start) + page_size +
+       brotli4j::kHugePageSize - 1) &
+      ~(uintptr_t)(brotli4j::kHugePageSize - 1));
+  uint8_t* head = data - page_size;
+  uint8_t* end = data + mapped_size;
+  if (head != start) munmap(start, (size_t)(head - start));
+  if (end != start + reserved_size) {
+    munmap(end, (size_t)(start + reserved_size - end));
+  }
+  bool mapped_huge = false;
+#if defined(MAP_HUGETLB)
+  if (policy == brotli4j::kExplicitHugePages) {
+    mapped_huge = mmap(data, mapped_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) !=
+        MAP_FAILED;
+    /* Failed MAP_FIXED might have dropped the range; map it again. */
+    if (!mapped_huge &&
+        mmap(data, mapped_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+      munmap(head, page_size);
+      return nullptr;
+    }
+  }
+#endif
+#if defined(MADV_HUGEPAGE)
+  if (!mapped_huge) madvise(data, mapped_size, MADV_HUGEPAGE);
+#endif
+  return data - kHeaderSize;
+#else
+  (void)size;
+  (void)policy;
+  return nullptr;
+#endif
+}
+
+void UnmapHugePages(uint8_t* block, size_t size) {
+#if defined(__linux__)
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  uint8_t* data = block + kHeaderSize;
+  munmap(data - page_size, page_size);
+  munmap(data, MappedSize(size));
+#else
+  (void)block;
+  (void)size;
+#endif
+}
+
+/* Global budget; see SetMemoryBudget. */
+std::atomic<size_t> budget_limit(0);
+std::atomic<size_t> charged_bytes(0);
+std::atomic<size_t> allocated_bytes(0);
+std::atomic<size_t> peak_allocated_bytes(0);
+/* Signalled when a reservation is released. Decoders have none, so waiters
+   also poll for their frees. */
+std::mutex budget_mutex;
+std::condition_variable budget_released;
+const long kBudgetPollMs = 10;
+
+size_t Charge(size_t reserved, size_t current) {
+  return (reserved > current) ? reserved : current;
+}
+
+/* Adds |delta| to the charge, unless it would exceed the limit. */
+bool AddCharge(size_t delta) {
+  if (delta == 0) return true;
+  size_t limit = budget_limit.load(std::memory_order_relaxed);
+  if (limit == 0) {
+    charged_bytes.fetch_add(delta, std::memory_order_relaxed);
+    return true;
+  }
+  size_t charged = charged_bytes.load(std::memory_order_relaxed);
+  do {
+    if (charged + delta > limit) return false;
+  } while (!charged_bytes.compare_exchange_weak(charged, charged + delta,
+                                                std::memory_order_relaxed));
+  return true;
+}
+
+void NoteAllocated(size_t size) {
+  size_t allocated =
+      allocated_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = peak_allocated_bytes.load(std::memory_order_relaxed);
+  while (allocated > peak &&
+         !peak_allocated_bytes.compare_exchange_weak(peak, allocated,
+             std::memory_order_relaxed)) {
+  }
+}
+
+/* Sets reservation of |stats| to |bytes|, or to the room left if it is at
+   least |min_bytes|. */
+size_t TryReserve(brotli4j::MemoryStats* stats, size_t bytes,
+                  size_t min_bytes) {
+  size_t limit = budget_limit.load(std::memory_order_relaxed);
+  size_t own = Charge(stats->reserved_bytes, stats->current_bytes);
+  size_t charged = charged_bytes.load(std::memory_order_relaxed);
+  while (true) {
+    size_t others = charged - own;
+    size_t room = bytes;
+    if (limit != 0) {
+      size_t left = (limit > others) ? limit - others : 0;
+      if (room > left) room = left;
+    }
+    if (room == 0 || room < min_bytes) return 0;
+    size_t next = others + Charge(room, stats->current_bytes);
+    if (charged_bytes.compare_exchange_weak(charged, next,
+                                            std::memory_order_relaxed)) {
+      stats->reserved_bytes = room;
+      return room;
+    }
+  }
+}
+
+}  /* namespace */
+
+namespace brotli4j {
+
+void* PooledAlloc(void* /*opaque*/, size_t size) {
+  uint32_t size_class = SizeClass(size);
+  uint8_t* block;
+  if (size_class != kUnpooled && !!cache.free_lists[size_class]) {
+    FreeBlock* free_block = cache.free_lists[size_class];
+    cache.free_lists[size_class] = free_block->next;
+    cache.cached_bytes -= ClassSize(size_class);
+    block = reinterpret_cast<uint8_t*>(free_block);
+  } else {
+    size_t block_size =
+        (size_class != kUnpooled) ? ClassSize(size_class) : size;
+    block = static_cast<uint8_t*>(malloc(kHeaderSize + block_size));
+    if (!block) return nullptr;
+  }
+  *reinterpret_cast<uint32_t*>(block) = size_class;
+  return block + kHeaderSize;
+}
+
+void PooledFree(void* /*opaque*/, void* address) {
+  if (!address) return;
+  uint8_t* block = static_cast<uint8_t*>(address) - kHeaderSize;
+  uint32_t size_class = *reinterpret_cast<uint32_t*>(block);
+  if (size_class != kUnpooled) {
+    size_t class_size = ClassSize(size_class);
+    if (cache.cached_bytes + class_size <= kMaxCachedBytes) {
+      FreeBlock* free_block = reinterpret_cast<FreeBlock*>(block);
+      free_block->next = cache.free_lists[size_class];
+      cache.free_lists[size_class] = free_block;
+      cache.cached_bytes += class_size;
+      return;
+    }
+  }
+  free(block);
+}
+
+void* TrackedAlloc(void* opaque, size_t size) {
+  MemoryStats* stats = static_cast<MemoryStats*>(opaque);
+  size_t charge = Charge(stats->reserved_bytes, stats->current_bytes + size) -
+      Charge(stats->reserved_bytes, stats->current_bytes);
+  if (!AddCharge(charge)) return nullptr;
+  size_t total = kHeaderSize + size;
+  uint32_t kind = kHeapBlock;
+  uint8_t* block = nullptr;
+  if (stats->huge_pages != kNoHugePages && size >= kHugePageSize) {
+    block = MapHugePages(size, stats->huge_pages);
+    if (!!block) kind = kMappedBlock;
+  }
+  if (!block) {
+    block = static_cast<uint8_t*>(
+        stats->pooled ? PooledAlloc(nullptr, total) : malloc(total));
+  }
+  if (!block) {
+    charged_bytes.fetch_sub(charge, std::memory_order_relaxed);
+    return nullptr;
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  *reinterpret_cast<uint32_t*>(block + sizeof(size_t)) = kind;
+  NoteAllocated(size);
+  stats->current_bytes += size;
+  if (stats->current_bytes > stats->peak_bytes) {
+    stats->peak_bytes = stats->current_bytes;
+  }
+  stats->allocation_count++;
+  return block + kHeaderSize;
+}
+
+void TrackedFree(void* opaque, void* address) {
+  if (!address) return;
+  MemoryStats* stats = static_cast<MemoryStats*>(opaque);
+  uint8_t* block = static_cast<uint8_t*>(address) - kHeaderSize;
+  size_t size = *reinterpret_cast<size_t*>(block);
+  charged_bytes.fetch_sub(
+      Charge(stats->reserved_bytes, stats->current_bytes) -
+          Charge(stats->reserved_bytes, stats->current_bytes - size),
+      std::memory_order_relaxed);
+  allocated_bytes.fetch_sub(size, std::memory_order_relaxed);
+  stats->current_bytes -= size;
+  if (*reinterpret_cast<uint32_t*>(block + sizeof(size_t)) == kMappedBlock) {
+    UnmapHugePages(block, size);
+  } else if (stats->pooled) {
+    PooledFree(nullptr, block);
+  } else {
+    free(block);
+  }
+}
+
+void SetMemoryBudget(size_t limit) {
+  budget_limit.store(limit, std::memory_order_relaxed);
+  /* A raised limit might let waiters in. */
+  std::lock_guard<std::mutex> lock(budget_mutex);
+  budget_released.notify_all();
+}
+
+void GetMemoryBudget(size_t* values) {
+  values[0] = budget_limit.load(std::memory_order_relaxed);
+  values[1] = charged_bytes.load(std::memory_order_relaxed);
+  values[2] = allocated_bytes.load(std::memory_order_relaxed);
+  values[3] = peak_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+size_t ReserveMemory(MemoryStats* stats, size_t bytes, size_t min_bytes,
+                     long wait_ms) {
+  size_t reserved = TryReserve(stats, bytes, bytes);
+  if (reserved == 0 && wait_ms > 0) {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_ms);
+    std::unique_lock<std::mutex> lock(budget_mutex);
+    while (reserved == 0) {
+      std::chrono::steady_clock::time_point now =
+          std::chrono::steady_clock::now();
+      if (now >= deadline) break;
+      std::chrono::steady_clock::time_point poll =
+          now + std::chrono::milliseconds(kBudgetPollMs);
+      budget_released.wait_until(lock, (poll < deadline) ? poll : deadline);
+      reserved = TryReserve(stats, bytes, bytes);
+    }
+  }
+  if (reserved == 0 && min_bytes < bytes) {
+    reserved = TryReserve(stats, bytes, min_bytes);
+  }
+  return reserved;
+}
+
+void ReleaseMemory(MemoryStats* stats) {
+  if (stats->reserved_bytes == 0) return;
+  charged_bytes.fetch_sub(
+      Charge(stats->reserved_bytes, stats->current_bytes) -
+          stats->current_bytes,
+      std::memory_order_relaxed);
+  stats->reserved_bytes = 0;
+  std::lock_guard<std::mutex> lock(budget_mutex);
+  budget_released.notify_all();
+}
+
+}  /* namespace brotli4j */
@@ -0,0 +1,92 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BROTLI4J_ALLOCATOR_H_
+#define BROTLI4J_ALLOCATOR_H_
+
+#include <cstddef>
+
+namespace brotli4j {
+
+/* Allocation hooks for Brotli{En,De}coderCreateInstance.
+
+   Blocks of more than 2 KiB (hash tables, ring buffers, command arrays,
+   Huffman groups) are rounded up to size classes, four per power of two,
+   and freed blocks are kept in free lists of the freeing thread to serve
+   the next allocations of the same class. Recurring large transient
+   allocations then stop reaching malloc and fragmenting the heap.
+   |opaque| is not used. */
+void* PooledAlloc(void* opaque, size_t size);
+void PooledFree(void* opaque, void* address);
+
+/* How blocks of at least kHugePageSize bytes are backed. */
+enum HugePages {
+  kNoHugePages = 0,
+  /* Anonymous mapping aligned to huge pages, with madvise(MADV_HUGEPAGE). */
+  kTransparentHugePages = 1,
+  /* MAP_HUGETLB mapping from the reserved pool; transparent if it is empty. */
+  kExplicitHugePages = 2
+};
+
+const size_t kHugePageSize = (size_t)2 << 20;
+
+/* Memory used by a single encoder or decoder instance. */
+typedef struct MemoryStats {
+  /* Whether blocks are obtained with PooledAlloc rather than malloc. */
+  bool pooled;
+  /* Policy for big blocks (hash tables, ring buffers); those are mapped
+     directly, bypassing pool. Mappings are populated by the first thread that
+     touches them, i.e. the one that runs the encoder, which keeps pages on its
+     NUMA node. Only Linux has huge pages; elsewhere the policy is ignored. */
+  HugePages huge_pages;
+  size_t current_bytes;
+  size_t peak_bytes;
+  size_t allocation_count;
+  /* Bytes admitted in the global budget with ReserveMemory. */
+  size_t reserved_bytes;
+} MemoryStats;
+
+/* Allocation hooks that account requested sizes in MemoryStats passed as
+   |opaque|, and in the global budget. */
+void* TrackedAlloc(void* opaque, size_t size);
+void TrackedFree(void* opaque, void* address);
+
+/* Process-wide budget of TrackedAlloc memory.
+
+   Each instance is charged the bigger of its reservation and its current
+   allocations; an allocation that would take the total charge over the limit
+   fails, so that the stream fails rather than the process. An instance never
+   fails within its reservation. Limit 0 means unlimited. */
+void SetMemoryBudget(size_t limit);
+
+/* Fills {limit, charged, allocated, peak allocated} bytes. */
+void GetMemoryBudget(size_t* values);
+
+/* Replaces reservation of |stats| with |bytes|. If there is no room, waits
+   up to |wait_ms| milliseconds for other instances to release theirs, then
+   takes the room left, if it is at least |min_bytes|. Returns reserved size;
+   0 if refused. */
+size_t ReserveMemory(MemoryStats* stats, size_t bytes, size_t min_bytes,
+                     long wait_ms);
+
+/* Drops reservation of |stats|; called when its instance is destroyed. */
+void ReleaseMemory(MemoryStats* stats);
+
+}  /* namespace brotli4j */
+
+#endif  /* BROTLI4J_ALLOCATOR_H_ */
@@ -25,6 +25,8 @@
 
 #include "dictionary.h"
 
+#include "allocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -35,17 +37,17 @@ extern "C" {
  * @param buffer direct ByteBuffer
  * @returns false if dictionary data was already set; otherwise true
  */
-JNIEXPORT jint JNICALL
+JNIEXPORT jboolean JNICALL
 Java_com_aayushatharva_brotli4j_common_CommonJNI_nativeSetDictionaryData(
     JNIEnv* env, jobject /*jobj*/, jobject buffer) {
   jobject buffer_ref = env->NewGlobalRef(buffer);
   if (!buffer_ref) {
-    return false;
+    return JNI_FALSE;
   }
   uint8_t* data = static_cast<uint8_t*>(env->GetDirectBufferAddress(buffer));
   if (!data) {
     env->DeleteGlobalRef(buffer_ref);
-    return false;
+    return JNI_FALSE;
   }
 
   BrotliSetDictionaryData(data);
@@ -56,7 +58,43 @@ Java_com_aayushatharva_brotli4j_common_CommonJNI_nativeSetDictionaryData(
   } else {
     /* Don't release reference; it is an intended memory leak. */
   }
-  return true;
+  return JNI_TRUE;
+}
+
+/**
+ * Checks whether dictionary data is already available, e.g. compiled into
+ * the library (unless built with BROTLI_EXTERNAL_DICTIONARY_DATA).
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_common_CommonJNI_nativeHasDictionaryData(
+    JNIEnv* /*env*/, jobject /*jobj*/) {
+  return static_cast<jboolean>(!!BrotliGetDictionary()->data);
+}
+
+/**
+ * Sets the process-wide native memory budget; see brotli4j::SetMemoryBudget.
+ *
+ * @param limit bytes; 0 for unlimited
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_common_CommonJNI_nativeSetMemoryBudget(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong limit) {
+  brotli4j::SetMemoryBudget(static_cast<size_t>(limit));
+}
+
+/**
+ * Reports the process-wide native memory budget.
+ *
+ * @param values {out_limit, out_charged, out_allocated, out_peakAllocated}
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_common_CommonJNI_nativeGetMemoryBudget(
+    JNIEnv* env, jobject /*jobj*/, jlongArray values) {
+  size_t budget[4];
+  brotli4j::GetMemoryBudget(budget);
+  jlong result[4];
+  for (int i = 0; i < 4; ++i) result[i] = static_cast<jlong>(budget[i]);
+  env->SetLongArrayRegion(values, 0, 4, result);
 }
 
 #ifdef __cplusplus
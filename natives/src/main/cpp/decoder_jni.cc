@@ -23,26 +23,251 @@
 
 #include <jni.h>
 
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <new>
 
 #include <brotli/decode.h>
 
+#include "allocator.h"
+#include "file_io.h"
+
 namespace {
+/* Dictionary parsed once and used by any number of decoders. */
+typedef struct PreparedDictionary {
+  BrotliSharedDictionary* dictionary;
+  /* Keeps the parsed data alive; dictionary points into it. */
+  jobject data_ref;
+  /* Java owner and each decoder using it hold one reference. */
+  std::atomic<size_t> refcount;
+} PreparedDictionary;
+
 /* A structure used to persist the decoder's state in between calls. */
 typedef struct DecoderHandle {
   BrotliDecoderState* state;
 
   jobject dictionary_refs[15];
   size_t dictionary_count;
+  PreparedDictionary* prepared_dictionary;
 
+  /* Staging buffer allocated with the handle. */
+  uint8_t* input_storage;
+  /* Active staging buffer: |input_storage| or memory of a Java buffer
+     installed with nativeSetInputBuffer. */
   uint8_t* input_start;
   size_t input_offset;
   size_t input_length;
+
+  /* Copies of Java array windows pushed with nativePushArray; grown on
+     demand up to kMaxArrayWindow. */
+  uint8_t* array_storage;
+  size_t array_storage_size;
+
+  /* Output is copied here, so that Java side reuses a single view. */
+  uint8_t* output_start;
+  size_t output_size;
+
+  /* Accounts allocations of |state|; outlives it. */
+  brotli4j::MemoryStats memory_stats;
+
+  /* Metadata blocks not taken by Java side yet, while capture is enabled:
+     {position: 8 bytes, length: 4 bytes, data} records, little-endian. */
+  uint8_t* metadata;
+  size_t metadata_size;
+  size_t metadata_capacity;
+  /* Leading part of |metadata| made of complete blocks. */
+  size_t metadata_ready;
+  /* Bytes of the block being read that are not seen yet. */
+  size_t metadata_pending;
+  /* Some metadata could not be kept. */
+  bool metadata_lost;
 } DecoderHandle;
 
+/* Status codes; has-more-output flag is or-ed to them. */
+const jint kError = 0;
+const jint kDone = 1;
+const jint kNeedsMoreInput = 2;
+const jint kNeedsMoreOutput = 3;
+const jint kOk = 4;
+const jint kHasMoreOutput = 8;
+const jint kHasMetadata = 16;
+
+/* Minimal size of output buffer; smaller one would make pulls too chatty. */
+const size_t kMinOutputSize = 65536;
+
+/* Maximal number of bytes of Java array consumed by a single nativePushArray.
+   Window is copied out rather than pinned: a call may decode a whole ring
+   buffer, and GC would be blocked all that time. */
+const size_t kMaxArrayWindow = 1 << 20;
+
 /* Obtain handle from opaque pointer. */
-DecoderHandle* getHandle(void* opaque) {
-  return static_cast<DecoderHandle*>(opaque);
+DecoderHandle* getHandle(jlong cookie) {
+  return reinterpret_cast<DecoderHandle*>(cookie);
+}
+
+void ReleasePreparedDictionary(JNIEnv* env, PreparedDictionary* dictionary) {
+  if (dictionary->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  BrotliSharedDictionaryDestroyInstance(dictionary->dictionary);
+  env->DeleteGlobalRef(dictionary->data_ref);
+  delete dictionary;
+}
+
+/* Drops everything attached to the decoder. */
+void ReleaseDictionaries(JNIEnv* env, DecoderHandle* handle) {
+  for (size_t i = 0; i < handle->dictionary_count; ++i) {
+    env->DeleteGlobalRef(handle->dictionary_refs[i]);
+    handle->dictionary_refs[i] = nullptr;
+  }
+  handle->dictionary_count = 0;
+  if (handle->prepared_dictionary) {
+    ReleasePreparedDictionary(env, handle->prepared_dictionary);
+    handle->prepared_dictionary = nullptr;
+  }
+}
+
+/* Appends |size| bytes to the metadata records of |handle|. */
+void AppendMetadata(DecoderHandle* handle, const uint8_t* data, size_t size) {
+  if (handle->metadata_lost) return;
+  if (handle->metadata_size + size > handle->metadata_capacity) {
+    size_t capacity =
+        handle->metadata_capacity ? 2 * handle->metadata_capacity : 4096;
+    while (capacity < handle->metadata_size + size) capacity *= 2;
+    uint8_t* grown = new (std::nothrow) uint8_t[capacity];
+    if (!grown) {
+      handle->metadata_lost = true;
+      return;
+    }
+    if (handle->metadata_size != 0) {
+      memcpy(grown, handle->metadata, handle->metadata_size);
+    }
+    delete[] handle->metadata;
+    handle->metadata = grown;
+    handle->metadata_capacity = capacity;
+  }
+  memcpy(handle->metadata + handle->metadata_size, data, size);
+  handle->metadata_size += size;
+}
+
+/* brotli_decoder_metadata_start_func; starts a record. */
+void OnMetadataStart(void* opaque, size_t size) {
+  DecoderHandle* handle = static_cast<DecoderHandle*>(opaque);
+  uint64_t position = BrotliDecoderGetDecodedSize(handle->state);
+  uint8_t header[12];
+  for (int i = 0; i < 8; ++i) {
+    header[i] = static_cast<uint8_t>(position >> (8 * i));
+  }
+  for (int i = 0; i < 4; ++i) {
+    header[8 + i] = static_cast<uint8_t>(size >> (8 * i));
+  }
+  AppendMetadata(handle, header, sizeof(header));
+  handle->metadata_pending = size;
+  if (size == 0) handle->metadata_ready = handle->metadata_size;
+}
+
+/* brotli_decoder_metadata_chunk_func; chunk points into input. */
+void OnMetadataChunk(void* opaque, const uint8_t* data, size_t size) {
+  DecoderHandle* handle = static_cast<DecoderHandle*>(opaque);
+  AppendMetadata(handle, data, size);
+  handle->metadata_pending -= size;
+  if (handle->metadata_pending == 0) {
+    handle->metadata_ready = handle->metadata_size;
+  }
+}
+
+/* Drops all the metadata records. */
+void ClearMetadata(DecoderHandle* handle) {
+  handle->metadata_size = 0;
+  handle->metadata_ready = 0;
+  handle->metadata_pending = 0;
+  handle->metadata_lost = false;
+}
+
+/* Or-s kHasMetadata to |status| if there are records to take. */
+jint WithMetadataFlag(DecoderHandle* handle, jint status) {
+  if (handle->metadata_ready != 0 || handle->metadata_lost) {
+    status |= kHasMetadata;
+  }
+  return status;
+}
+
+/* Returns |handle|'s buffer for copies of Java arrays, grown to at least
+   |size| bytes; null if out of memory. */
+uint8_t* GetArrayStorage(DecoderHandle* handle, size_t size) {
+  if (handle->array_storage_size < size) {
+    uint8_t* grown = new (std::nothrow) uint8_t[size];
+    if (!grown) return nullptr;
+    delete[] handle->array_storage;
+    handle->array_storage = grown;
+    handle->array_storage_size = size;
+  }
+  return handle->array_storage;
+}
+
+jint getStatus(DecoderHandle* handle) {
+  jint status;
+  bool has_more_output = !!BrotliDecoderHasMoreOutput(handle->state);
+  if (has_more_output) {
+    status = kNeedsMoreOutput;
+  } else if (BrotliDecoderIsFinished(handle->state)) {
+    /* Bytes after stream end are not allowed. */
+    status = (handle->input_offset == handle->input_length) ? kDone : kError;
+  } else {
+    /* Can proceed, or more data is required? */
+    status = (handle->input_offset == handle->input_length) ?
+        kNeedsMoreInput : kOk;
+  }
+  return WithMetadataFlag(handle,
+      status | (has_more_output ? kHasMoreOutput : 0));
+}
+
+/* Decodes pending input; if out is not null, output is written straight into
+   caller memory, otherwise it is kept in decoder. See nativePush for
+   input_length semantics and status codes. Number of bytes written is put
+   in upper 32 bits of result. */
+jlong decodeInto(DecoderHandle* handle, jint input_length,
+                 uint8_t* out, size_t out_size) {
+  if (input_length != 0) {
+    /* Still have unconsumed data. Workflow is broken. */
+    if (handle->input_offset < handle->input_length) {
+      return kError;
+    }
+    handle->input_offset = 0;
+    handle->input_length = input_length;
+  }
+
+  const uint8_t* in = handle->input_start + handle->input_offset;
+  size_t in_size = handle->input_length - handle->input_offset;
+  size_t available_out = out_size;
+  BrotliDecoderResult result = BrotliDecoderDecompressStream(
+      handle->state, &in_size, &in, &available_out, out ? &out : nullptr,
+      nullptr);
+  handle->input_offset = handle->input_length - in_size;
+  jint status;
+  switch (result) {
+    case BROTLI_DECODER_RESULT_SUCCESS:
+      /* Bytes after stream end are not allowed. */
+      status = (handle->input_offset == handle->input_length) ? kDone : kError;
+      break;
+
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+      status = kNeedsMoreInput;
+      break;
+
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+      status = kNeedsMoreOutput;
+      break;
+
+    default:
+      status = kError;
+      break;
+  }
+  if (BrotliDecoderHasMoreOutput(handle->state)) status |= kHasMoreOutput;
+  status = WithMetadataFlag(handle, status);
+  jlong written = static_cast<jlong>(out_size - available_out);
+  return (written << 32) | status;
 }
 
 }  /* namespace */
@@ -57,7 +282,8 @@ extern "C" {
  * Cookie to address created decoder is stored in out_cookie. In case of failure
  * cookie is 0.
  *
- * @param ctx {out_cookie, in_directBufferSize} tuple
+ * @param ctx {out_cookie, in_directBufferSize, out_reserved,
+ *            in_pooledAllocator} tuple
  * @returns direct ByteBuffer if directBufferSize is not 0; otherwise null
  */
 JNIEXPORT jobject JNICALL
@@ -65,8 +291,8 @@ Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeCreate(
     JNIEnv* env, jobject /*jobj*/, jlongArray ctx) {
   bool ok = true;
   DecoderHandle* handle = nullptr;
-  jlong context[3];
-  env->GetLongArrayRegion(ctx, 0, 3, context);
+  jlong context[4];
+  env->GetLongArrayRegion(ctx, 0, 4, context);
   size_t input_size = context[1];
   context[0] = 0;
   context[2] = 0;
@@ -78,29 +304,61 @@ Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeCreate(
       handle->dictionary_refs[i] = nullptr;
     }
     handle->dictionary_count = 0;
+    handle->prepared_dictionary = nullptr;
     handle->input_offset = 0;
     handle->input_length = 0;
     handle->input_start = nullptr;
+    handle->input_storage = nullptr;
+    handle->array_storage = nullptr;
+    handle->array_storage_size = 0;
+    handle->output_start = nullptr;
+    handle->output_size = 0;
+    handle->memory_stats.pooled = false;
+    handle->memory_stats.huge_pages = brotli4j::kNoHugePages;
+    handle->memory_stats.current_bytes = 0;
+    handle->memory_stats.peak_bytes = 0;
+    handle->memory_stats.allocation_count = 0;
+    handle->memory_stats.reserved_bytes = 0;
+    handle->metadata = nullptr;
+    handle->metadata_capacity = 0;
+    ClearMetadata(handle);
 
     if (input_size == 0) {
       ok = false;
     } else {
-      handle->input_start = new (std::nothrow) uint8_t[input_size];
-      ok = !!handle->input_start;
+      handle->input_storage = new (std::nothrow) uint8_t[input_size];
+      handle->input_start = handle->input_storage;
+      ok = !!handle->input_storage;
     }
   }
 
   if (ok) {
-    handle->state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    handle->output_size =
+        (input_size > kMinOutputSize) ? input_size : kMinOutputSize;
+    handle->output_start = new (std::nothrow) uint8_t[handle->output_size];
+    ok = !!handle->output_start;
+  }
+
+  if (ok) {
+    handle->memory_stats.pooled = (context[3] != 0);
+    handle->state = BrotliDecoderCreateInstance(brotli4j::TrackedAlloc,
+        brotli4j::TrackedFree, &handle->memory_stats);
     ok = !!handle->state;
   }
 
+  if (ok) {
+    /* Decoders are reused for many streams, often produced alike. */
+    BrotliDecoderSetParameter(handle->state,
+        BROTLI_DECODER_PARAM_HUFFMAN_TABLE_CACHE, 1);
+  }
+
   if (ok) {
     /* TODO: future versions (e.g. when 128-bit architecture comes)
                      might require thread-safe cookie<->handle mapping. */
     context[0] = reinterpret_cast<jlong>(handle);
   } else if (!!handle) {
-    if (!!handle->input_start) delete[] handle->input_start;
+    if (!!handle->input_storage) delete[] handle->input_storage;
+    if (!!handle->output_start) delete[] handle->output_start;
     delete handle;
   }
 
@@ -110,7 +368,7 @@ Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeCreate(
     return nullptr;
   }
 
-  return env->NewDirectByteBuffer(handle->input_start, input_size);
+  return env->NewDirectByteBuffer(handle->input_storage, input_size);
 }
 
 /**
@@ -123,113 +381,619 @@ Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeCreate(
  *  - 3 needs more output to process further
  *  - 4 ok, can proceed further without additional input
  *
- * @param ctx {in_cookie, out_status} tuple
+ * Status code is or-ed with 8 if decoder has more output, and with 16 if
+ * there are metadata records to take with nativeTakeMetadata.
+ *
+ * @param cookie decoder handle
  * @param input_length number of bytes provided in input or direct input;
  *                     0 to process further previous input
+ * @returns status
  */
-JNIEXPORT void JNICALL
+JNIEXPORT jint JNICALL
 Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativePush(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx, jint input_length) {
-  jlong context[3];
-  env->GetLongArrayRegion(ctx, 0, 3, context);
-  DecoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
-  context[1] = 0;  /* ERROR */
-  context[2] = 0;
-  env->SetLongArrayRegion(ctx, 0, 3, context);
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jint input_length) {
+  DecoderHandle* handle = getHandle(cookie);
+  return static_cast<jint>(decodeInto(handle, input_length, nullptr, 0));
+}
 
-  if (input_length != 0) {
-    /* Still have unconsumed data. Workflow is broken. */
-    if (handle->input_offset < handle->input_length) {
-      return;
-    }
-    handle->input_offset = 0;
-    handle->input_length = input_length;
+/**
+ * Push data to decoder directly from Java byte array.
+ *
+ * At most kMaxArrayWindow bytes are copied out of the array and consumed;
+ * longer input is processed over several invocations. Input staged with nativePush
+ * MUST be consumed before.
+ *
+ * @param cookie decoder handle
+ * @returns number of consumed bytes in upper 32 bits; status (see nativePush)
+ *          in lower 32 bits
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativePushArray(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jbyteArray input,
+    jint input_offset, jint input_length) {
+  DecoderHandle* handle = getHandle(cookie);
+
+  /* Still have unconsumed staged data. Workflow is broken. */
+  if (handle->input_offset < handle->input_length) {
+    return kError;
+  }
+  if (input_offset < 0 || input_length < 0 ||
+      input_offset > env->GetArrayLength(input) - input_length) {
+    return kError;
   }
 
-  /* Actual decompression. */
-  const uint8_t* in = handle->input_start + handle->input_offset;
-  size_t in_size = handle->input_length - handle->input_offset;
+  size_t length = static_cast<size_t>(input_length);
+  size_t window = (length > kMaxArrayWindow) ? kMaxArrayWindow : length;
+  uint8_t* data = nullptr;
+  if (window != 0) {
+    data = GetArrayStorage(handle, window);
+    if (!data) {
+      return kError;
+    }
+    env->GetByteArrayRegion(input, input_offset, static_cast<jsize>(window),
+        reinterpret_cast<jbyte*>(data));
+  }
+  const uint8_t* in = data;
+  size_t in_size = window;
   size_t out_size = 0;
-  BrotliDecoderResult status = BrotliDecoderDecompressStream(
+  BrotliDecoderResult result = BrotliDecoderDecompressStream(
       handle->state, &in_size, &in, &out_size, nullptr, nullptr);
-  handle->input_offset = handle->input_length - in_size;
-  switch (status) {
+  size_t consumed = window - in_size;
+  jint status;
+  switch (result) {
     case BROTLI_DECODER_RESULT_SUCCESS:
       /* Bytes after stream end are not allowed. */
-      context[1] = (handle->input_offset == handle->input_length) ? 1 : 0;
+      status = (consumed == length) ? kDone : kError;
       break;
 
     case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
-      context[1] = 2;
+      /* Rest of input did not fit into the window? */
+      status = (consumed == length) ? kNeedsMoreInput : kOk;
       break;
 
     case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
-      context[1] = 3;
+      status = kNeedsMoreOutput;
       break;
 
     default:
-      context[1] = 0;
+      status = kError;
       break;
   }
-  context[2] = BrotliDecoderHasMoreOutput(handle->state) ? 1 : 0;
-  env->SetLongArrayRegion(ctx, 0, 3, context);
+  if (BrotliDecoderHasMoreOutput(handle->state)) status |= kHasMoreOutput;
+  status = WithMetadataFlag(handle, status);
+  return (static_cast<jlong>(consumed) << 32) | status;
 }
 
 /**
- * Pull decompressed data from decoder.
+ * Makes the decoder stage input in memory of a direct ByteBuffer.
  *
- * @param ctx {in_cookie, out_status} tuple
- * @returns direct ByteBuffer; all the produced data MUST be consumed before
- *          any further invocation; null in case of error
+ * Caller keeps |buffer| alive while it is installed and never pushes more
+ * bytes than its capacity.
+ *
+ * @param cookie decoder handle
+ * @param buffer direct ByteBuffer; null to return to the own staging buffer
+ * @returns false if staged input is not consumed yet, or buffer is not direct
  */
-JNIEXPORT jobject JNICALL
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeSetInputBuffer(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject buffer) {
+  DecoderHandle* handle = getHandle(cookie);
+  if (handle->input_offset < handle->input_length) {
+    return JNI_FALSE;
+  }
+  uint8_t* start = handle->input_storage;
+  if (!!buffer) {
+    start = static_cast<uint8_t*>(env->GetDirectBufferAddress(buffer));
+    if (!start) {
+      return JNI_FALSE;
+    }
+  }
+  handle->input_start = start;
+  handle->input_offset = 0;
+  handle->input_length = 0;
+  return JNI_TRUE;
+}
+
+/**
+ * Pull decompressed data from decoder into the output buffer.
+ *
+ * @param cookie decoder handle
+ * @returns number of bytes placed into output buffer in upper 32 bits;
+ *          status (see nativePush) in lower 32 bits
+ */
+JNIEXPORT jlong JNICALL
 Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativePull(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx) {
-  jlong context[3];
-  env->GetLongArrayRegion(ctx, 0, 3, context);
-  DecoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
-  size_t data_length = 0;
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
+  size_t data_length = handle->output_size;
   const uint8_t* data = BrotliDecoderTakeOutput(handle->state, &data_length);
-  bool hasMoreOutput = !!BrotliDecoderHasMoreOutput(handle->state);
-  if (hasMoreOutput) {
-    context[1] = 3;
-  } else if (BrotliDecoderIsFinished(handle->state)) {
-    /* Bytes after stream end are not allowed. */
-    context[1] = (handle->input_offset == handle->input_length) ? 1 : 0;
-  } else {
-    /* Can proceed, or more data is required? */
-    context[1] = (handle->input_offset == handle->input_length) ? 2 : 4;
+  if (data_length != 0) {
+    memcpy(handle->output_start, data, data_length);
   }
-  context[2] = hasMoreOutput ? 1 : 0;
-  env->SetLongArrayRegion(ctx, 0, 3, context);
-  return env->NewDirectByteBuffer(const_cast<uint8_t*>(data), data_length);
+  return (static_cast<jlong>(data_length) << 32) | getStatus(handle);
+}
+
+/**
+ * Returns direct ByteBuffer that views decoder output buffer.
+ *
+ * @param cookie decoder handle
+ */
+JNIEXPORT jobject JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeGetOutputBuffer(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
+  return env->NewDirectByteBuffer(handle->output_start,
+      static_cast<jlong>(handle->output_size));
+}
+
+/**
+ * Decode data directly into direct ByteBuffer region.
+ *
+ * Output is not staged in the decoder.
+ *
+ * @param cookie decoder handle
+ * @param input_length number of bytes provided in input buffer;
+ *                     0 to process further previous input
+ * @returns number of bytes written to output in upper 32 bits, status (see
+ *          nativePush) in lower 32 bits; -1 if output is not accessible
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeDecompressInto(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jint input_length,
+    jobject output, jint output_offset, jint output_length) {
+  DecoderHandle* handle = getHandle(cookie);
+  uint8_t* out = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  jlong capacity = env->GetDirectBufferCapacity(output);
+  if (!out || output_offset < 0 || output_length < 0 ||
+      output_offset > capacity - output_length) {
+    return -1;
+  }
+  return decodeInto(handle, input_length, out + output_offset,
+      static_cast<size_t>(output_length));
+}
+
+/**
+ * Decode data from a direct ByteBuffer region directly into another one.
+ *
+ * Neither input nor output is staged in the decoder. Input staged with
+ * nativePush MUST be consumed before.
+ *
+ * @param cookie decoder handle
+ * @param regions {input_position, input_limit, output_position, output_limit};
+ *                positions are advanced past consumed / produced data
+ * @returns status (see nativePush)
+ */
+JNIEXPORT jint JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeDecompressDirect(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject input, jobject output,
+    jintArray regions) {
+  DecoderHandle* handle = getHandle(cookie);
+
+  /* Still have unconsumed staged data. Workflow is broken. */
+  if (handle->input_offset < handle->input_length) {
+    return kError;
+  }
+  jint region[4];
+  env->GetIntArrayRegion(regions, 0, 4, region);
+  const uint8_t* in =
+      static_cast<const uint8_t*>(env->GetDirectBufferAddress(input));
+  uint8_t* out = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  if (!in || !out || region[0] < 0 || region[0] > region[1] ||
+      region[1] > env->GetDirectBufferCapacity(input) || region[2] < 0 ||
+      region[2] > region[3] ||
+      region[3] > env->GetDirectBufferCapacity(output)) {
+    return kError;
+  }
+
+  size_t in_size = static_cast<size_t>(region[1] - region[0]);
+  size_t out_size = static_cast<size_t>(region[3] - region[2]);
+  in += region[0];
+  out += region[2];
+  size_t available_in = in_size;
+  size_t available_out = out_size;
+  BrotliDecoderResult result = BrotliDecoderDecompressStream(
+      handle->state, &available_in, &in, &available_out, &out, nullptr);
+  jint status;
+  switch (result) {
+    case BROTLI_DECODER_RESULT_SUCCESS:
+      /* Bytes after stream end are not allowed. */
+      status = (available_in == 0) ? kDone : kError;
+      break;
+
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+      status = kNeedsMoreInput;
+      break;
+
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+      status = kNeedsMoreOutput;
+      break;
+
+    default:
+      status = kError;
+      break;
+  }
+  if (BrotliDecoderHasMoreOutput(handle->state)) status |= kHasMoreOutput;
+  status = WithMetadataFlag(handle, status);
+  region[0] += static_cast<jint>(in_size - available_in);
+  region[2] += static_cast<jint>(out_size - available_out);
+  env->SetIntArrayRegion(regions, 0, 4, region);
+  return status;
+}
+
+/**
+ * Decode data into byte array region.
+ *
+ * Output is decoded into the handle output buffer and copied out one buffer
+ * at a time, so that the array is never pinned while decoding.
+ *
+ * @param cookie decoder handle
+ * @param input_length number of bytes provided in input buffer;
+ *                     0 to process further previous input
+ * @returns number of bytes written to output in upper 32 bits, status (see
+ *          nativePush) in lower 32 bits; -1 if output is not accessible
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeDecompressIntoArray(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jint input_length,
+    jbyteArray output, jint output_offset, jint output_length) {
+  DecoderHandle* handle = getHandle(cookie);
+  jsize capacity = env->GetArrayLength(output);
+  if (output_offset < 0 || output_length < 0 ||
+      output_offset > capacity - output_length) {
+    return -1;
+  }
+  jlong written = 0;
+  jlong result;
+  while (true) {
+    size_t chunk = static_cast<size_t>(output_length - written);
+    if (chunk > handle->output_size) chunk = handle->output_size;
+    result = decodeInto(handle, input_length, handle->output_start, chunk);
+    input_length = 0;
+    jlong chunk_written = result >> 32;
+    if (chunk_written != 0) {
+      env->SetByteArrayRegion(output,
+          output_offset + static_cast<jint>(written),
+          static_cast<jsize>(chunk_written),
+          reinterpret_cast<const jbyte*>(handle->output_start));
+    }
+    written += chunk_written;
+    /* Continue only while decoder stops on a full buffer. */
+    jint status = static_cast<jint>(result & 7);
+    if (status != kNeedsMoreOutput ||
+        chunk_written != static_cast<jlong>(chunk) ||
+        written == output_length) {
+      break;
+    }
+  }
+  return (written << 32) | (result & 0xFFFFFFFF);
+}
+
+/**
+ * Decodes many independent streams with a single decoder into one output
+ * region.
+ *
+ * Decoder is reset before every slice, so its ring buffer and Huffman tables
+ * are reused across the batch; attached dictionaries are released. Decoded
+ * data is placed back to back; output of a slice that fails to decode is
+ * dropped. Slices are processed in order until one of them does not fit the
+ * output region.
+ *
+ * @param cookie decoder handle
+ * @param slices {offset, length} pairs addressing compressed streams in input
+ * @param count number of slices
+ * @param offsets receives start of each decoded item in output, followed by
+ *                the end of the last one; MUST have count + 1 elements
+ * @param statuses receives status code (see nativePush) of each slice
+ * @returns number of processed slices; -1 in case of error
+ */
+JNIEXPORT jint JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeDecompressBatch(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject input,
+    jintArray slices, jint count, jobject output, jint output_offset,
+    jint output_length, jintArray offsets, jintArray statuses) {
+  DecoderHandle* handle = getHandle(cookie);
+  if (!input || !output || count < 0 ||
+      env->GetArrayLength(slices) / 2 < count ||
+      env->GetArrayLength(offsets) <= count ||
+      env->GetArrayLength(statuses) < count) {
+    return -1;
+  }
+  const uint8_t* in =
+      static_cast<uint8_t*>(env->GetDirectBufferAddress(input));
+  uint8_t* out = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  if (!in || !out) {
+    return -1;
+  }
+  jlong input_capacity = env->GetDirectBufferCapacity(input);
+  if (output_offset < 0 || output_length < 0 ||
+      output_offset + static_cast<jlong>(output_length) >
+          env->GetDirectBufferCapacity(output)) {
+    return -1;
+  }
+
+  /* Slice bounds, followed by status codes. */
+  jint* bounds = new (std::nothrow) jint[3 * static_cast<size_t>(count) + 1];
+  if (!bounds) {
+    return -1;
+  }
+  jint* codes = bounds + 2 * count + 1;
+  env->GetIntArrayRegion(slices, 0, 2 * count, bounds);
+  for (jint i = 0; i < count; ++i) {
+    jint offset = bounds[2 * i];
+    jint length = bounds[2 * i + 1];
+    if (offset < 0 || length < 0 ||
+        offset + static_cast<jlong>(length) > input_capacity) {
+      delete[] bounds;
+      return -1;
+    }
+  }
+
+  /* Item starts are written over consumed slice bounds. */
+  jint* starts = bounds;
+  uint8_t* next_out = out + output_offset;
+  uint8_t* out_end = next_out + output_length;
+  handle->input_offset = 0;
+  handle->input_length = 0;
+  jint done = 0;
+  bool ok = true;
+  for (; done < count; ++done) {
+    const uint8_t* next_in = in + bounds[2 * done];
+    size_t available_in = static_cast<size_t>(bounds[2 * done + 1]);
+    ok = !!BrotliDecoderResetInstance(handle->state);
+    if (!ok) break;
+    ReleaseDictionaries(env, handle);
+    uint8_t* item_start = next_out;
+    starts[done] = static_cast<jint>(item_start - out);
+    size_t available_out = static_cast<size_t>(out_end - next_out);
+    BrotliDecoderResult result = BrotliDecoderDecompressStream(handle->state,
+        &available_in, &next_in, &available_out, &next_out, nullptr);
+    if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+      /* Does not fit; drop partial output. */
+      next_out = item_start;
+      break;
+    }
+    jint status;
+    if (result == BROTLI_DECODER_RESULT_SUCCESS) {
+      /* Bytes after stream end are not allowed. */
+      status = (available_in == 0) ? kDone : kError;
+    } else if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+      status = kNeedsMoreInput;
+    } else {
+      status = kError;
+    }
+    if (status != kDone) next_out = item_start;
+    codes[done] = status;
+  }
+  starts[done] = static_cast<jint>(next_out - out);
+  /* Items are not told apart in metadata records. */
+  ClearMetadata(handle);
+  if (ok) {
+    env->SetIntArrayRegion(offsets, 0, done + 1, starts);
+    env->SetIntArrayRegion(statuses, 0, done, codes);
+  }
+  delete[] bounds;
+  return ok ? done : -1;
 }
 
 /**
  * Releases all used resources.
  *
- * @param ctx {in_cookie} tuple
+ * @param cookie decoder handle
  */
 JNIEXPORT void JNICALL
 Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeDestroy(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx) {
-  jlong context[3];
-  env->GetLongArrayRegion(ctx, 0, 3, context);
-  DecoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
   BrotliDecoderDestroyInstance(handle->state);
-  for (size_t i = 0; i < handle->dictionary_count; ++i) {
-    env->DeleteGlobalRef(handle->dictionary_refs[i]);
-  }
-  delete[] handle->input_start;
+  ReleaseDictionaries(env, handle);
+  delete[] handle->input_storage;
+  delete[] handle->array_storage;
+  delete[] handle->output_start;
+  delete[] handle->metadata;
   delete handle;
 }
 
+/**
+ * Prepares decoder for a new stream.
+ *
+ * Attached dictionaries are released; ring-buffer is retained.
+ *
+ * @param cookie decoder handle
+ * @returns false in case of failure; decoder could be only destroyed then
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeReset(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
+  bool ok = !!BrotliDecoderResetInstance(handle->state);
+  ReleaseDictionaries(env, handle);
+  handle->input_offset = 0;
+  handle->input_length = 0;
+  ClearMetadata(handle);
+  /* Retained buffers stay accounted; peak and count restart. */
+  handle->memory_stats.peak_bytes = handle->memory_stats.current_bytes;
+  handle->memory_stats.allocation_count = 0;
+  return static_cast<jboolean>(ok);
+}
+
+/**
+ * Makes the decoder keep metadata blocks until they are taken with
+ * nativeTakeMetadata; kept over resets.
+ *
+ * @param cookie decoder handle
+ * @param enabled whether to keep metadata; records not taken are dropped when
+ *                disabled
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeSetMetadataCapture(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jboolean enabled) {
+  DecoderHandle* handle = getHandle(cookie);
+  if (enabled) {
+    BrotliDecoderSetMetadataCallbacks(handle->state, OnMetadataStart,
+        OnMetadataChunk, handle);
+  } else {
+    BrotliDecoderSetMetadataCallbacks(handle->state, nullptr, nullptr,
+        nullptr);
+    ClearMetadata(handle);
+  }
+}
+
+/**
+ * Takes records of metadata blocks completed since the previous invocation.
+ *
+ * Records are {position: 8 bytes, length: 4 bytes, data}, little-endian;
+ * position is the number of bytes decoded before the block.
+ *
+ * @param cookie decoder handle
+ * @returns records; null if some metadata could not be kept
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeTakeMetadata(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
+  if (handle->metadata_lost) {
+    ClearMetadata(handle);
+    return nullptr;
+  }
+  size_t ready = handle->metadata_ready;
+  jbyteArray result = env->NewByteArray(static_cast<jsize>(ready));
+  if (!result) {
+    return nullptr;
+  }
+  if (ready != 0) {
+    env->SetByteArrayRegion(result, 0, static_cast<jsize>(ready),
+        reinterpret_cast<const jbyte*>(handle->metadata));
+  }
+  /* Block being read stays. */
+  handle->metadata_size -= ready;
+  if (handle->metadata_size != 0) {
+    memmove(handle->metadata, handle->metadata + ready,
+        handle->metadata_size);
+  }
+  handle->metadata_ready = 0;
+  return result;
+}
+
+/**
+ * Sets BROTLI_DECODER_PARAM_STREAM_OFFSET for the next stream.
+ *
+ * @param cookie decoder handle
+ * @param stream_offset number of bytes that stream data follows
+ * @returns false if decoding is already started
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeSetStreamOffset(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jlong stream_offset) {
+  DecoderHandle* handle = getHandle(cookie);
+  if (stream_offset < 0) {
+    return JNI_FALSE;
+  }
+  /* Bigger values have the same effect. */
+  jlong max_offset = static_cast<jlong>(1) << 30;
+  return static_cast<jboolean>(!!BrotliDecoderSetParameter(handle->state,
+      BROTLI_DECODER_PARAM_STREAM_OFFSET, static_cast<uint32_t>(
+          stream_offset < max_offset ? stream_offset : max_offset)));
+}
+
+/**
+ * Sets one of the flag-like decoder parameters; value is kept over resets.
+ *
+ * @param cookie decoder handle
+ * @param parameter BROTLI_DECODER_PARAM_DISABLE_RING_BUFFER_REALLOCATION,
+ *                  BROTLI_DECODER_PARAM_LARGE_WINDOW,
+ *                  BROTLI_DECODER_PARAM_LOW_MEMORY,
+ *                  BROTLI_DECODER_PARAM_COLLECT_STATS or
+ *                  BROTLI_DECODER_PARAM_CHECKSUM
+ * @param value new value
+ * @returns false if decoding is already started
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeSetParameter(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jint parameter,
+    jint value) {
+  DecoderHandle* handle = getHandle(cookie);
+  BrotliDecoderParameter p = static_cast<BrotliDecoderParameter>(parameter);
+  if (p != BROTLI_DECODER_PARAM_DISABLE_RING_BUFFER_REALLOCATION &&
+      p != BROTLI_DECODER_PARAM_LARGE_WINDOW &&
+      p != BROTLI_DECODER_PARAM_LOW_MEMORY &&
+      p != BROTLI_DECODER_PARAM_COLLECT_STATS &&
+      p != BROTLI_DECODER_PARAM_CHECKSUM) {
+    return JNI_FALSE;
+  }
+  return static_cast<jboolean>(!!BrotliDecoderSetParameter(handle->state, p,
+      static_cast<uint32_t>(value)));
+}
+
+/**
+ * Reports memory allocated by the decoder state (JNI buffers are excluded).
+ *
+ * @param cookie decoder handle
+ * @param stats {out_currentBytes, out_peakBytes, out_allocationCount} tuple;
+ *              peak and count are taken since creation or the last reset
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeGetMemoryStats(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jlongArray stats) {
+  DecoderHandle* handle = getHandle(cookie);
+  jlong values[3];
+  values[0] = static_cast<jlong>(handle->memory_stats.current_bytes);
+  values[1] = static_cast<jlong>(handle->memory_stats.peak_bytes);
+  values[2] = static_cast<jlong>(handle->memory_stats.allocation_count);
+  env->SetLongArrayRegion(stats, 0, 3, values);
+}
+
+/**
+ * Reads counters enabled with BROTLI_DECODER_PARAM_COLLECT_STATS.
+ *
+ * @param cookie decoder handle
+ * @param stats out: BrotliDecoderStat values, BROTLI_DECODER_NUM_STATS items
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeGetStats(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jlongArray stats) {
+  DecoderHandle* handle = getHandle(cookie);
+  uint64_t counters[BROTLI_DECODER_NUM_STATS];
+  jlong values[BROTLI_DECODER_NUM_STATS];
+  size_t count = BrotliDecoderGetStats(
+      handle->state, BROTLI_DECODER_NUM_STATS, counters);
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = static_cast<jlong>(counters[i]);
+  }
+  env->SetLongArrayRegion(stats, 0, static_cast<jsize>(count), values);
+}
+
+/**
+ * @param cookie decoder handle
+ * @returns CRC-32C of output produced so far, if
+ *          BROTLI_DECODER_PARAM_CHECKSUM is set
+ */
+JNIEXPORT jint JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeGetChecksum(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
+  return static_cast<jint>(BrotliDecoderGetChecksum(handle->state));
+}
+
+/**
+ * @param cookie decoder handle
+ * @returns uncompressed size declared by the stream; -1 if it is not known
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeGetDeclaredSize(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  DecoderHandle* handle = getHandle(cookie);
+  uint64_t size = 0;
+  if (!BrotliDecoderGetDeclaredSize(handle->state, &size) ||
+      size > 0x7FFFFFFFFFFFFFFFull) {
+    return -1;
+  }
+  return static_cast<jlong>(size);
+}
+
 JNIEXPORT jboolean JNICALL
 Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeAttachDictionary(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx, jobject dictionary) {
-  jlong context[3];
-  env->GetLongArrayRegion(ctx, 0, 3, context);
-  DecoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject dictionary) {
+  DecoderHandle* handle = getHandle(cookie);
   jobject ref = nullptr;
   uint8_t* address = nullptr;
   jlong capacity = 0;
@@ -264,6 +1028,153 @@ Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeAttachDictionary(
   return static_cast<jboolean>(ok);
 }
 
+/**
+ * Parses a dictionary once, for use by any number of decoders.
+ *
+ * Buffer is referenced, not copied; it MUST NOT be modified afterwards.
+ *
+ * @param dictionary direct buffer with dictionary data
+ * @param type BrotliSharedDictionaryType of the data
+ * @returns prepared dictionary handle; 0 in case of failure
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativePrepareDictionary(
+    JNIEnv* env, jobject /*jobj*/, jobject dictionary, jlong type) {
+  if (!dictionary || (type != BROTLI_SHARED_DICTIONARY_RAW &&
+      type != BROTLI_SHARED_DICTIONARY_SERIALIZED)) {
+    return 0;
+  }
+  uint8_t* address =
+      static_cast<uint8_t*>(env->GetDirectBufferAddress(dictionary));
+  jlong capacity = env->GetDirectBufferCapacity(dictionary);
+  if (!address || capacity <= 0 || capacity >= (1 << 30)) {
+    return 0;
+  }
+  PreparedDictionary* prepared = new (std::nothrow) PreparedDictionary();
+  if (!prepared) {
+    return 0;
+  }
+  prepared->refcount.store(1, std::memory_order_relaxed);
+  prepared->data_ref = env->NewGlobalRef(dictionary);
+  prepared->dictionary =
+      BrotliSharedDictionaryCreateInstance(nullptr, nullptr, nullptr);
+  bool ok = !!prepared->data_ref && !!prepared->dictionary;
+  if (ok) {
+    ok = !!BrotliSharedDictionaryAttach(prepared->dictionary,
+        static_cast<BrotliSharedDictionaryType>(type),
+        static_cast<size_t>(capacity), address);
+  }
+  if (!ok) {
+    BrotliSharedDictionaryDestroyInstance(prepared->dictionary);
+    if (prepared->data_ref) env->DeleteGlobalRef(prepared->data_ref);
+    delete prepared;
+    return 0;
+  }
+  return reinterpret_cast<jlong>(prepared);
+}
+
+/**
+ * Drops Java owner reference to the prepared dictionary.
+ *
+ * Decoders that use it keep it alive until they are reset or destroyed.
+ *
+ * @param dictionary prepared dictionary handle
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeReleaseDictionary(
+    JNIEnv* env, jobject /*jobj*/, jlong dictionary) {
+  ReleasePreparedDictionary(env,
+      reinterpret_cast<PreparedDictionary*>(dictionary));
+}
+
+/**
+ * Makes decoder use a prepared dictionary; nothing is parsed or copied.
+ *
+ * @param cookie decoder handle
+ * @param dictionary prepared dictionary handle
+ * @returns false if another dictionary is attached already
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeAttachPreparedDictionary(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jlong dictionary) {
+  DecoderHandle* handle = getHandle(cookie);
+  PreparedDictionary* prepared =
+      reinterpret_cast<PreparedDictionary*>(dictionary);
+  if (handle->prepared_dictionary) {
+    return JNI_FALSE;
+  }
+  if (!BrotliDecoderAttachSharedDictionary(handle->state,
+      prepared->dictionary)) {
+    return JNI_FALSE;
+  }
+  prepared->refcount.fetch_add(1, std::memory_order_relaxed);
+  handle->prepared_dictionary = prepared;
+  return JNI_TRUE;
+}
+
+/**
+ * Decompresses file |input| to file |output| without passing data through
+ * Java.
+ *
+ * Input is memory-mapped and read in place; output is written as it is
+ * produced. Input MUST be a single complete stream.
+ *
+ * @param cookie fresh decoder handle
+ * @returns decompressed size; -1 if files can not be read or written, -2 if
+ *          input is corrupted, truncated or followed by other data
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_decoder_DecoderJNI_nativeDecompressFile(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jstring input,
+    jstring output) {
+  const jlong kFileError = -1;
+  const jlong kDecodingError = -2;
+  DecoderHandle* handle = getHandle(cookie);
+  const char* input_path = env->GetStringUTFChars(input, nullptr);
+  if (!input_path) return kFileError;
+  brotli4j::MappedFile file;
+  bool mapped = brotli4j::MapFile(input_path, &file);
+  env->ReleaseStringUTFChars(input, input_path);
+  if (!mapped) return kFileError;
+
+  FILE* out = nullptr;
+  const char* output_path = env->GetStringUTFChars(output, nullptr);
+  if (!!output_path) {
+    out = brotli4j::OpenOutputFile(output_path);
+    env->ReleaseStringUTFChars(output, output_path);
+  }
+  if (!out) {
+    brotli4j::UnmapFile(&file);
+    return kFileError;
+  }
+
+  const uint8_t* next_in = file.data;
+  size_t available_in = file.size;
+  jlong total = 0;
+  BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+  while (total >= 0 && result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+    size_t available_out = 0;
+    result = BrotliDecoderDecompressStream(handle->state, &available_in,
+        &next_in, &available_out, nullptr, nullptr);
+    while (total >= 0 && BrotliDecoderHasMoreOutput(handle->state)) {
+      size_t length = 0;
+      const uint8_t* data = BrotliDecoderTakeOutput(handle->state, &length);
+      if (length != 0 && fwrite(data, 1, length, out) != length) {
+        total = kFileError;
+      } else {
+        total += static_cast<jlong>(length);
+      }
+    }
+  }
+  if (total >= 0 &&
+      (result != BROTLI_DECODER_RESULT_SUCCESS || available_in != 0)) {
+    total = kDecodingError;
+  }
+  if (fclose(out) != 0 && total >= 0) total = kFileError;
+  brotli4j::UnmapFile(&file);
+  return total;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,156 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "dictionary_registry.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace brotli4j {
+
+struct SharedDictionary {
+  std::atomic<size_t> refcount;
+  BrotliEncoderPreparedDictionary* prepared;
+  BrotliSharedDictionaryType type;
+  uint64_t hash;
+  size_t size;
+  /* Copy of the source; keys the registry together with |type|. */
+  uint8_t* data;
+  SharedDictionary* next;
+};
+
+}  /* namespace brotli4j */
+
+namespace {
+
+using brotli4j::SharedDictionary;
+
+/* Power of two; few distinct dictionaries are expected per process. */
+const size_t kNumBuckets = 64;
+
+std::mutex registry_mutex;
+SharedDictionary* buckets[kNumBuckets];
+
+uint64_t Hash(const uint8_t* data, size_t size) {
+  const uint64_t kMul = 0x9E3779B97F4A7C15ull;
+  uint64_t h = size * kMul;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    h = (h ^ word) * kMul;
+    h ^= h >> 29;
+  }
+  for (; i < size; ++i) {
+    h = (h ^ data[i]) * kMul;
+  }
+  return h ^ (h >> 32);
+}
+
+SharedDictionary** BucketOf(uint64_t hash) {
+  return &buckets[hash & (kNumBuckets - 1)];
+}
+
+/* Adds a reference unless the last one is already gone; an entry that
+   reached zero is about to be unlinked by its releaser and can not be
+   revived. */
+bool TryRetain(SharedDictionary* dictionary) {
+  size_t count = dictionary->refcount.load(std::memory_order_relaxed);
+  while (count != 0) {
+    if (dictionary->refcount.compare_exchange_weak(count, count + 1,
+        std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Destroy(SharedDictionary* dictionary) {
+  BrotliEncoderDestroyPreparedDictionary(dictionary->prepared);
+  delete[] dictionary->data;
+  delete dictionary;
+}
+
+}  /* namespace */
+
+namespace brotli4j {
+
+SharedDictionary* AcquireSharedDictionary(BrotliSharedDictionaryType type,
+    const uint8_t* data, size_t size) {
+  uint64_t hash = Hash(data, size);
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  SharedDictionary** bucket = BucketOf(hash);
+  for (SharedDictionary* entry = *bucket; !!entry; entry = entry->next) {
+    if (entry->hash == hash && entry->type == type && entry->size == size &&
+        memcmp(entry->data, data, size) == 0 && TryRetain(entry)) {
+      return entry;
+    }
+  }
+
+  /* Preparing under the lock makes concurrent requests for the same data
+     wait for a single preparation instead of repeating it. */
+  SharedDictionary* entry = new (std::nothrow) SharedDictionary();
+  if (!entry) {
+    return nullptr;
+  }
+  entry->data = new (std::nothrow) uint8_t[size > 0 ? size : 1];
+  entry->prepared = nullptr;
+  if (!!entry->data) {
+    memcpy(entry->data, data, size);
+    entry->prepared = BrotliEncoderPrepareDictionary(type, size, entry->data,
+        BROTLI_MAX_QUALITY, nullptr, nullptr, nullptr);
+  }
+  if (!entry->prepared) {
+    delete[] entry->data;
+    delete entry;
+    return nullptr;
+  }
+  entry->refcount.store(1, std::memory_order_relaxed);
+  entry->type = type;
+  entry->hash = hash;
+  entry->size = size;
+  entry->next = *bucket;
+  *bucket = entry;
+  return entry;
+}
+
+void RetainSharedDictionary(SharedDictionary* dictionary) {
+  dictionary->refcount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ReleaseSharedDictionary(SharedDictionary* dictionary) {
+  if (dictionary->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    SharedDictionary** link = BucketOf(dictionary->hash);
+    while (*link != dictionary) link = &(*link)->next;
+    *link = dictionary->next;
+  }
+  Destroy(dictionary);
+}
+
+BrotliEncoderPreparedDictionary* GetPreparedDictionary(
+    SharedDictionary* dictionary) {
+  return dictionary->prepared;
+}
+
+}  /* namespace brotli4j */
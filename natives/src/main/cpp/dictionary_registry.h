@@ -0,0 +1,57 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BROTLI4J_DICTIONARY_REGISTRY_H_
+#define BROTLI4J_DICTIONARY_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <brotli/encode.h>
+
+namespace brotli4j {
+
+/* Process-wide registry of prepared encoder dictionaries.
+
+   Dictionaries are keyed by type and contents, so preparing the same data
+   again returns the instance that is already registered instead of running
+   BrotliEncoderPrepareDictionary once more. Each reference is counted
+   atomically; the instance is unregistered and destroyed when the last one
+   is released. Retain / Release are lock-free and may be called from any
+   thread; Acquire takes the registry lock. */
+typedef struct SharedDictionary SharedDictionary;
+
+/* Returns registered dictionary with the same type and contents, preparing
+   and registering it first if needed. The caller owns one reference.
+   Returns nullptr if |type| is unsupported or preparation fails. */
+SharedDictionary* AcquireSharedDictionary(BrotliSharedDictionaryType type,
+    const uint8_t* data, size_t size);
+
+/* Adds a reference to |dictionary|, which MUST already be owned. */
+void RetainSharedDictionary(SharedDictionary* dictionary);
+
+/* Drops a reference to |dictionary|. */
+void ReleaseSharedDictionary(SharedDictionary* dictionary);
+
+/* Returns prepared dictionary; valid while a reference is owned. */
+BrotliEncoderPreparedDictionary* GetPreparedDictionary(
+    SharedDictionary* dictionary);
+
+}  /* namespace brotli4j */
+
+#endif  /* BROTLI4J_DICTIONARY_REGISTRY_H_ */
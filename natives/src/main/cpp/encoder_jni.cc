@@ -23,11 +23,23 @@
 
 #include <jni.h>
 
+#include <cstdio>
+#include <cstring>
 #include <new>
+#include <system_error>
+#include <thread>
 
 #include <brotli/encode.h>
 
+#include "allocator.h"
+#include "dictionary_registry.h"
+#include "file_io.h"
+
 namespace {
+/* Largest reference every window can address: BROTLI_MAX_DISTANCE less the
+   backward limit of a 24-bit window. */
+const jlong kMaxReferenceSize = 0x3FFFFFC - ((1 << 24) - 16);
+
 /* A structure used to persist the encoder's state in between calls. */
 typedef struct EncoderHandle {
   BrotliEncoderState* state;
@@ -35,14 +47,386 @@ typedef struct EncoderHandle {
   jobject dictionary_refs[15];
   size_t dictionary_count;
 
+  /* Registry dictionaries are kept alive by a reference of their own. */
+  brotli4j::SharedDictionary* shared_dictionaries[15];
+  size_t shared_dictionary_count;
+
+  /* Staging buffer allocated with the handle. */
+  uint8_t* input_storage;
+  /* Active staging buffer: |input_storage| or memory of a Java buffer
+     installed with nativeSetInputBuffer. */
   uint8_t* input_start;
   size_t input_offset;
   size_t input_last;
+
+  /* Copies of Java array windows pushed with nativePushArray; grown on
+     demand up to kMaxArrayWindow. */
+  uint8_t* array_storage;
+  size_t array_storage_size;
+
+  /* Quality requested at creation; -1 if default. */
+  int quality;
+
+  /* Encoder writes output here, so that Java side reuses a single view. */
+  uint8_t* output_start;
+  size_t output_size;
+  /* Bytes of |output_start| not pulled yet. */
+  size_t output_length;
+  /* Output produced by encoder so far, as it reports. */
+  size_t total_out;
+
+  /* Operation of the last push; pulls continue it. */
+  BrotliEncoderOperation last_op;
+  /* Last push left part of its input unconsumed; it is pushed again. */
+  bool input_pending;
+
+  /* Accounts allocations of |state|; outlives it. */
+  brotli4j::MemoryStats memory_stats;
+
+  /* Whether BROTLI_PARAM_MEMORY_LIMIT is set, and a flush requested by the
+     last push has not let encoder release idle memory yet. */
+  bool memory_limited;
+  bool flush_pending;
 } EncoderHandle;
 
+/* Status bits returned by nativePush / nativePull. */
+const jint kSuccess = 1;
+const jint kHasMoreOutput = 2;
+const jint kHasRemainingInput = 4;
+const jint kIsFinished = 8;
+
+/* Minimal size of output buffer; smaller one would make pulls too chatty. */
+const size_t kMinOutputSize = 65536;
+
+/* Maximal number of bytes of Java array consumed by a single nativePushArray.
+   It is big enough for the first window to give the same size hint to the
+   encoder as the whole input would. */
+const size_t kMaxArrayWindow = 1 << 20;
+
+/* Maximal input pinned with GetPrimitiveArrayCritical. Only qualities 0 and
+   1 pin; they encode such input in well under a millisecond. Otherwise a
+   block may be encoded for hundreds of milliseconds, with GC blocked. */
+const size_t kMaxCriticalWindow = 1 << 16;
+
 /* Obtain handle from opaque pointer. */
-EncoderHandle* getHandle(void* opaque) {
-  return static_cast<EncoderHandle*>(opaque);
+EncoderHandle* getHandle(jlong cookie) {
+  return reinterpret_cast<EncoderHandle*>(cookie);
+}
+
+/* Frees buffers of |handle| and |handle| itself; state is not touched. */
+void DeleteHandle(EncoderHandle* handle) {
+  delete[] handle->input_storage;
+  delete[] handle->array_storage;
+  delete[] handle->output_start;
+  delete handle;
+}
+
+/* Creates handle with |input_size| bytes of staging buffer and output buffer;
+   encoder state is left to caller. Returns null on failure. */
+EncoderHandle* NewHandle(size_t input_size) {
+  if (input_size == 0) return nullptr;
+  EncoderHandle* handle = new (std::nothrow) EncoderHandle();
+  if (!handle) return nullptr;
+  for (int i = 0; i < 15; ++i) {
+    handle->dictionary_refs[i] = nullptr;
+    handle->shared_dictionaries[i] = nullptr;
+  }
+  handle->state = nullptr;
+  handle->dictionary_count = 0;
+  handle->shared_dictionary_count = 0;
+  handle->input_offset = 0;
+  handle->input_last = 0;
+  handle->array_storage = nullptr;
+  handle->array_storage_size = 0;
+  handle->quality = -1;
+  handle->output_length = 0;
+  handle->total_out = 0;
+  handle->last_op = BROTLI_OPERATION_PROCESS;
+  handle->input_pending = false;
+  handle->memory_stats.pooled = false;
+  handle->memory_stats.huge_pages = brotli4j::kNoHugePages;
+  handle->memory_stats.current_bytes = 0;
+  handle->memory_stats.peak_bytes = 0;
+  handle->memory_stats.allocation_count = 0;
+  handle->memory_stats.reserved_bytes = 0;
+  handle->memory_limited = false;
+  handle->flush_pending = false;
+  handle->input_storage = new (std::nothrow) uint8_t[input_size];
+  handle->input_start = handle->input_storage;
+  handle->output_size =
+      (input_size > kMinOutputSize) ? input_size : kMinOutputSize;
+  handle->output_start = new (std::nothrow) uint8_t[handle->output_size];
+  if (!handle->input_storage || !handle->output_start) {
+    DeleteHandle(handle);
+    return nullptr;
+  }
+  return handle;
+}
+
+/* Drops references to all the dictionaries attached to |handle|. */
+void ReleaseDictionaries(JNIEnv* env, EncoderHandle* handle) {
+  for (size_t i = 0; i < handle->dictionary_count; ++i) {
+    env->DeleteGlobalRef(handle->dictionary_refs[i]);
+    handle->dictionary_refs[i] = nullptr;
+  }
+  handle->dictionary_count = 0;
+  for (size_t i = 0; i < handle->shared_dictionary_count; ++i) {
+    brotli4j::ReleaseSharedDictionary(handle->shared_dictionaries[i]);
+    handle->shared_dictionaries[i] = nullptr;
+  }
+  handle->shared_dictionary_count = 0;
+}
+
+/* Remembers whether |op| asked for a flush. */
+void NoteOperation(EncoderHandle* handle, BrotliEncoderOperation op) {
+  if (handle->memory_limited) {
+    handle->flush_pending = (op == BROTLI_OPERATION_FLUSH);
+  }
+}
+
+/* Output storage is released only when it has been pushed out, i.e. here
+   rather than inside the encoder. */
+void ReleaseIdleMemoryAfterFlush(EncoderHandle* handle) {
+  if (handle->flush_pending &&
+      !BrotliEncoderHasMoreOutput(handle->state) &&
+      BrotliEncoderReleaseIdleMemory(handle->state)) {
+    handle->flush_pending = false;
+  }
+}
+
+/* Returns |handle|'s buffer for copies of Java arrays, grown to at least
+   |size| bytes; null if out of memory. */
+uint8_t* GetArrayStorage(EncoderHandle* handle, size_t size) {
+  if (handle->array_storage_size < size) {
+    uint8_t* grown = new (std::nothrow) uint8_t[size];
+    if (!grown) return nullptr;
+    delete[] handle->array_storage;
+    handle->array_storage = grown;
+    handle->array_storage_size = size;
+  }
+  return handle->array_storage;
+}
+
+/* Runs |op| over |*in_size| bytes at |*in|; output is written right into
+   the free part of the output buffer. */
+BROTLI_BOOL Encode(EncoderHandle* handle, BrotliEncoderOperation op,
+    size_t* in_size, const uint8_t** in) {
+  size_t available_out = handle->output_size - handle->output_length;
+  uint8_t* next_out = handle->output_start + handle->output_length;
+  BROTLI_BOOL result = BrotliEncoderCompressStream(
+      handle->state, op, in_size, in, &available_out, &next_out,
+      &handle->total_out);
+  handle->output_length = handle->output_size - available_out;
+  handle->last_op = op;
+  handle->input_pending = *in_size != 0;
+  return result;
+}
+
+jint getStatus(EncoderHandle* handle) {
+  jint status = kSuccess;
+  if (handle->output_length != 0 ||
+      BrotliEncoderHasMoreOutput(handle->state)) {
+    status |= kHasMoreOutput;
+  }
+  if (handle->input_offset != handle->input_last) status |= kHasRemainingInput;
+  /* Stream is over once its tail is pulled as well. */
+  if (handle->output_length == 0 && BrotliEncoderIsFinished(handle->state)) {
+    status |= kIsFinished;
+  }
+  return status;
+}
+
+/* Feeds |in_size| bytes to |state| with operation |op| and appends all the
+   produced output to |*output|, whose capacity is doubled when exhausted.
+   Caller owns |*output| regardless of the result. */
+bool DrainStream(BrotliEncoderState* state, BrotliEncoderOperation op,
+    const uint8_t* in, size_t in_size, uint8_t** output, size_t* output_size) {
+  size_t output_capacity = *output_size;
+  bool ok = true;
+  while (ok) {
+    size_t out_size = 0;
+    ok = !!BrotliEncoderCompressStream(
+        state, op, &in_size, &in, &out_size, nullptr, nullptr);
+    if (!ok) break;
+    if (BrotliEncoderHasMoreOutput(state)) {
+      size_t data_length = 0;
+      const uint8_t* data_out = BrotliEncoderTakeOutput(state, &data_length);
+      if (*output_size + data_length > output_capacity) {
+        size_t capacity = output_capacity ? 2 * output_capacity : 65536;
+        while (capacity < *output_size + data_length) capacity *= 2;
+        uint8_t* grown = new (std::nothrow) uint8_t[capacity];
+        ok = !!grown;
+        if (!ok) break;
+        if (*output_size != 0) memcpy(grown, *output, *output_size);
+        delete[] *output;
+        *output = grown;
+        output_capacity = capacity;
+      }
+      memcpy(*output + *output_size, data_out, data_length);
+      *output_size += data_length;
+      continue;
+    }
+    if (in_size == 0 &&
+        (op != BROTLI_OPERATION_FINISH || BrotliEncoderIsFinished(state))) {
+      break;
+    }
+  }
+  return ok;
+}
+
+/* Returns address of the |index|-th direct buffer of |buffers|; null if it
+   is not direct or is shorter than |limit|. */
+uint8_t* DirectAddress(JNIEnv* env, jobjectArray buffers, jsize index,
+    jint limit) {
+  jobject buffer = env->GetObjectArrayElement(buffers, index);
+  uint8_t* address = nullptr;
+  if (!!buffer) {
+    address = static_cast<uint8_t*>(env->GetDirectBufferAddress(buffer));
+    if (env->GetDirectBufferCapacity(buffer) < limit) address = nullptr;
+    env->DeleteLocalRef(buffer);
+  }
+  return address;
+}
+
+/* Copies |size| bytes of |data| to a new Java array; null on failure. */
+jbyteArray ToByteArray(JNIEnv* env, const uint8_t* data, size_t size) {
+  jbyteArray result = env->NewByteArray(static_cast<jsize>(size));
+  if (!!result && size != 0) {
+    env->SetByteArrayRegion(result, 0, static_cast<jsize>(size),
+        reinterpret_cast<const jbyte*>(data));
+  }
+  return result;
+}
+
+/* Bigger stream offsets have the same effect. */
+void SetStreamOffset(BrotliEncoderState* state, jlong stream_offset) {
+  if (stream_offset != 0) {
+    jlong max_offset = static_cast<jlong>(1) << 30;
+    BrotliEncoderSetParameter(state, BROTLI_PARAM_STREAM_OFFSET,
+        static_cast<uint32_t>(
+            stream_offset < max_offset ? stream_offset : max_offset));
+  }
+}
+
+/* Result codes of nativeCompressFile. */
+const jlong kFileError = -1;
+const jlong kEncodingError = -2;
+
+/* Minimal input size of a chunk compressed on its own thread. */
+const size_t kMinFileChunkSize = 4 << 20;
+
+/* A chunk of nativeCompressFile input, compressed by a fork of the encoder. */
+typedef struct FileChunk {
+  size_t offset;
+  size_t size;
+  bool last;
+  uint8_t* output;
+  size_t output_size;
+  bool ok;
+} FileChunk;
+
+bool WriteAll(FILE* file, const uint8_t* data, size_t size) {
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+/* Encodes the whole |input| with |state| in place and streams the output to
+   |out|; returns compressed size or one of the error codes. */
+jlong CompressMapped(BrotliEncoderState* state, const uint8_t* input,
+    size_t input_size, FILE* out) {
+  if (input_size != 0 &&
+      !BrotliEncoderAttachInput(state, input_size, input)) {
+    return kEncodingError;
+  }
+  jlong total = 0;
+  while (!BrotliEncoderIsFinished(state)) {
+    size_t available_out = 0;
+    if (!BrotliEncoderCompressStream(state, BROTLI_OPERATION_FINISH,
+        &input_size, &input, &available_out, nullptr, nullptr)) {
+      return kEncodingError;
+    }
+    size_t length = 0;
+    const uint8_t* data = BrotliEncoderTakeOutput(state, &length);
+    if (!WriteAll(out, data, length)) return kFileError;
+    total += static_cast<jlong>(length);
+  }
+  return total;
+}
+
+/* Compresses |chunk| of |input| with a fork of |original|. The window is
+   primed with the input just before the chunk, so chunks may reference each
+   other as a single run would. */
+void CompressFileChunk(const BrotliEncoderState* original,
+    const uint8_t* input, size_t max_window, FileChunk* chunk) {
+  BrotliEncoderState* state =
+      BrotliEncoderForkInstance(original, nullptr, nullptr, nullptr);
+  chunk->ok = !!state;
+  if (chunk->ok) {
+    BrotliEncoderSetParameter(state, BROTLI_PARAM_SIZE_HINT,
+        static_cast<uint32_t>(chunk->size));
+  }
+  if (chunk->ok && chunk->offset != 0) {
+    size_t window = chunk->offset < max_window ? chunk->offset : max_window;
+    SetStreamOffset(state, static_cast<jlong>(chunk->offset));
+    chunk->ok = !!BrotliEncoderPrimeWindow(state, window,
+        input + chunk->offset - window);
+  }
+  if (chunk->ok) {
+    chunk->ok = DrainStream(state,
+        chunk->last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH,
+        input + chunk->offset, chunk->size, &chunk->output,
+        &chunk->output_size);
+  }
+  if (!!state) BrotliEncoderDestroyInstance(state);
+}
+
+/* Encodes |input| on up to |threads| threads, in rounds of one chunk per
+   thread; outputs of a round are written in order once it is complete.
+   Returns compressed size or one of the error codes. */
+jlong CompressMappedParallel(const BrotliEncoderState* state,
+    const uint8_t* input, size_t input_size, size_t chunk_size,
+    size_t max_window, size_t threads, FILE* out) {
+  FileChunk* chunks = new (std::nothrow) FileChunk[threads];
+  std::thread* workers = new (std::nothrow) std::thread[threads];
+  jlong total = (!!chunks && !!workers) ? 0 : kEncodingError;
+  for (size_t offset = 0; total >= 0 && offset < input_size;) {
+    size_t count = 0;
+    for (; count < threads && offset < input_size; ++count) {
+      FileChunk* chunk = &chunks[count];
+      chunk->offset = offset;
+      chunk->size = input_size - offset < chunk_size ?
+          input_size - offset : chunk_size;
+      offset += chunk->size;
+      chunk->last = offset == input_size;
+      chunk->output = nullptr;
+      chunk->output_size = 0;
+      chunk->ok = false;
+    }
+    /* The first chunk of a round is compressed on the calling thread. */
+    for (size_t i = 1; i < count; ++i) {
+      try {
+        workers[i] = std::thread(CompressFileChunk, state, input, max_window,
+            &chunks[i]);
+      } catch (const std::system_error&) {
+        CompressFileChunk(state, input, max_window, &chunks[i]);
+      }
+    }
+    CompressFileChunk(state, input, max_window, &chunks[0]);
+    for (size_t i = 1; i < count; ++i) {
+      if (workers[i].joinable()) workers[i].join();
+    }
+    for (size_t i = 0; i < count; ++i) {
+      if (total >= 0 && !chunks[i].ok) total = kEncodingError;
+      if (total >= 0 &&
+          !WriteAll(out, chunks[i].output, chunks[i].output_size)) {
+        total = kFileError;
+      }
+      if (total >= 0) total += static_cast<jlong>(chunks[i].output_size);
+      delete[] chunks[i].output;
+    }
+  }
+  delete[] workers;
+  delete[] chunks;
+  return total;
 }
 
 }  /* namespace */
@@ -57,40 +441,30 @@ extern "C" {
  * Cookie to address created encoder is stored in out_cookie. In case of failure
  * cookie is 0.
  *
- * @param ctx {out_cookie, in_directBufferSize, in_quality, in_lgwin} tuple
+ * @param ctx {out_cookie, in_directBufferSize, in_quality, in_lgwin, in_mode,
+ *            in_allocator} tuple; allocator bit 0 selects pooled allocator,
+ *            bits 1-2 are brotli4j::HugePages policy
  * @returns direct ByteBuffer if directBufferSize is not 0; otherwise null
  */
 JNIEXPORT jobject JNICALL
 Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCreate(
     JNIEnv* env, jobject /*jobj*/, jlongArray ctx) {
-  bool ok = true;
-  EncoderHandle* handle = nullptr;
-  jlong context[5];
-  env->GetLongArrayRegion(ctx, 0, 5, context);
+  jlong context[6];
+  env->GetLongArrayRegion(ctx, 0, 6, context);
   size_t input_size = context[1];
   context[0] = 0;
-  handle = new (std::nothrow) EncoderHandle();
-  ok = !!handle;
+  EncoderHandle* handle = NewHandle(input_size);
+  bool ok = !!handle;
 
   if (ok) {
-    for (int i = 0; i < 15; ++i) {
-      handle->dictionary_refs[i] = nullptr;
-    }
-    handle->dictionary_count = 0;
-    handle->input_offset = 0;
-    handle->input_last = 0;
-    handle->input_start = nullptr;
-
-    if (input_size == 0) {
-      ok = false;
-    } else {
-      handle->input_start = new (std::nothrow) uint8_t[input_size];
-      ok = !!handle->input_start;
+    handle->memory_stats.pooled = (context[5] & 1) != 0;
+    if (((context[5] >> 1) & 3) == brotli4j::kTransparentHugePages) {
+      handle->memory_stats.huge_pages = brotli4j::kTransparentHugePages;
+    } else if (((context[5] >> 1) & 3) == brotli4j::kExplicitHugePages) {
+      handle->memory_stats.huge_pages = brotli4j::kExplicitHugePages;
     }
-  }
-
-  if (ok) {
-    handle->state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+    handle->state = BrotliEncoderCreateInstance(brotli4j::TrackedAlloc,
+        brotli4j::TrackedFree, &handle->memory_stats);
     ok = !!handle->state;
   }
 
@@ -98,6 +472,7 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCreate(
     int quality = context[2];
     if (quality >= 0) {
       BrotliEncoderSetParameter(handle->state, BROTLI_PARAM_QUALITY, quality);
+      handle->quality = quality;
     }
     int lgwin = context[3];
     if (lgwin >= 0) {
@@ -114,8 +489,7 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCreate(
                      might require thread-safe cookie<->handle mapping. */
     context[0] = reinterpret_cast<jlong>(handle);
   } else if (!!handle) {
-    if (!!handle->input_start) delete[] handle->input_start;
-    delete handle;
+    DeleteHandle(handle);
   }
 
   env->SetLongArrayRegion(ctx, 0, 1, context);
@@ -124,39 +498,92 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCreate(
     return nullptr;
   }
 
-  return env->NewDirectByteBuffer(handle->input_start, input_size);
+  return env->NewDirectByteBuffer(handle->input_storage, input_size);
+}
+
+/**
+ * Creates a copy of idle encoder; see BrotliEncoderForkInstance.
+ *
+ * Original must have no staged input and no output left to pull. Copy gets
+ * buffers of its own and the allocator policy of the original.
+ *
+ * @param ctx {out_cookie, in_directBufferSize} tuple; out_cookie is 0 in
+ *            case of failure
+ * @returns direct ByteBuffer of the copy; null in case of failure
+ */
+JNIEXPORT jobject JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeFork(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jlongArray ctx) {
+  EncoderHandle* original = getHandle(cookie);
+  jlong context[2];
+  env->GetLongArrayRegion(ctx, 0, 2, context);
+  size_t input_size = context[1];
+  context[0] = 0;
+  EncoderHandle* handle = nullptr;
+  bool ok = original->input_offset == original->input_last &&
+      original->output_length == 0 &&
+      !BrotliEncoderHasMoreOutput(original->state);
+
+  if (ok) {
+    handle = NewHandle(input_size);
+    ok = !!handle;
+  }
+
+  if (ok) {
+    handle->memory_stats.pooled = original->memory_stats.pooled;
+    handle->memory_stats.huge_pages = original->memory_stats.huge_pages;
+    handle->memory_limited = original->memory_limited;
+    handle->quality = original->quality;
+    handle->total_out = original->total_out;
+    handle->state = BrotliEncoderForkInstance(original->state,
+        brotli4j::TrackedAlloc, brotli4j::TrackedFree, &handle->memory_stats);
+    ok = !!handle->state;
+  }
+
+  if (ok) {
+    context[0] = reinterpret_cast<jlong>(handle);
+  } else if (!!handle) {
+    DeleteHandle(handle);
+  }
+
+  env->SetLongArrayRegion(ctx, 0, 1, context);
+
+  if (!ok) {
+    return nullptr;
+  }
+
+  return env->NewDirectByteBuffer(handle->input_storage, input_size);
 }
 
 /**
  * Push data to encoder.
  *
- * @param ctx {in_cookie, in_operation_out_success, out_has_more_output,
- *             out_has_remaining_input} tuple
+ * @param cookie encoder handle
+ * @param operation 0 / 1 / 2 / 3 for PROCESS / FLUSH / FINISH / EMIT_METADATA
  * @param input_length number of bytes provided in input or direct input;
  *                     0 to process further previous input
+ * @returns {kSuccess, kHasMoreOutput, kHasRemainingInput, kIsFinished}
+ *          bit set; 0 in case of error
  */
-JNIEXPORT void JNICALL
+JNIEXPORT jint JNICALL
 Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePush(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx, jint input_length) {
-  jlong context[5];
-  env->GetLongArrayRegion(ctx, 0, 5, context);
-  EncoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
-  int operation = context[1];
-  context[1] = 0;  /* ERROR */
-  env->SetLongArrayRegion(ctx, 0, 5, context);
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jint operation,
+    jint input_length) {
+  EncoderHandle* handle = getHandle(cookie);
 
   BrotliEncoderOperation op;
   switch (operation) {
     case 0: op = BROTLI_OPERATION_PROCESS; break;
     case 1: op = BROTLI_OPERATION_FLUSH; break;
     case 2: op = BROTLI_OPERATION_FINISH; break;
-    default: return;  /* ERROR */
+    case 3: op = BROTLI_OPERATION_EMIT_METADATA; break;
+    default: return 0;  /* ERROR */
   }
 
   if (input_length != 0) {
     /* Still have unconsumed data. Workflow is broken. */
     if (handle->input_offset < handle->input_last) {
-      return;
+      return 0;
     }
     handle->input_offset = 0;
     handle->input_last = input_length;
@@ -165,68 +592,1144 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePush(
   /* Actual compression. */
   const uint8_t* in = handle->input_start + handle->input_offset;
   size_t in_size = handle->input_last - handle->input_offset;
-  size_t out_size = 0;
-  BROTLI_BOOL status = BrotliEncoderCompressStream(
-      handle->state, op, &in_size, &in, &out_size, nullptr, nullptr);
+  NoteOperation(handle, op);
+  BROTLI_BOOL status = Encode(handle, op, &in_size, &in);
   handle->input_offset = handle->input_last - in_size;
-  if (!!status) {
-    context[1] = 1;
-    context[2] = BrotliEncoderHasMoreOutput(handle->state) ? 1 : 0;
-    context[3] = (handle->input_offset != handle->input_last) ? 1 : 0;
-    context[4] = BrotliEncoderIsFinished(handle->state) ? 1 : 0;
+  if (!status) return 0;
+  ReleaseIdleMemoryAfterFlush(handle);
+  return getStatus(handle);
+}
+
+/**
+ * Push data to encoder directly from Java byte array.
+ *
+ * At most kMaxArrayWindow bytes are consumed; longer input is processed over
+ * several invocations. Window is copied out of the array before encoding,
+ * unless quality is 0 or 1 and the whole input fits kMaxCriticalWindow; then
+ * the array is pinned instead. Input staged with nativePush MUST be consumed
+ * before.
+ *
+ * @param cookie encoder handle
+ * @param operation 0 / 1 / 2 / 3 for PROCESS / FLUSH / FINISH / EMIT_METADATA;
+ *                  it is applied when the rest of input fits into the window;
+ *                  metadata (at most 16 MiB) is always taken in one window,
+ *                  as the encoder expects the rest of the block on each call
+ * @returns number of consumed bytes in upper 32 bits; status bit set (see
+ *          nativePush) in lower 32 bits, kHasRemainingInput is set if not all
+ *          of input_length bytes were consumed
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePushArray(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jint operation,
+    jbyteArray input, jint input_offset, jint input_length) {
+  EncoderHandle* handle = getHandle(cookie);
+
+  BrotliEncoderOperation op;
+  switch (operation) {
+    case 0: op = BROTLI_OPERATION_PROCESS; break;
+    case 1: op = BROTLI_OPERATION_FLUSH; break;
+    case 2: op = BROTLI_OPERATION_FINISH; break;
+    case 3: op = BROTLI_OPERATION_EMIT_METADATA; break;
+    default: return 0;  /* ERROR */
+  }
+
+  /* Still have unconsumed staged data. Workflow is broken. */
+  if (handle->input_offset < handle->input_last) {
+    return 0;
+  }
+  if (input_offset < 0 || input_length < 0 ||
+      input_offset > env->GetArrayLength(input) - input_length) {
+    return 0;
+  }
+
+  size_t length = static_cast<size_t>(input_length);
+  size_t window = (length > kMaxArrayWindow) ? kMaxArrayWindow : length;
+  if (op == BROTLI_OPERATION_EMIT_METADATA) window = length;
+  if (window < length) op = BROTLI_OPERATION_PROCESS;
+  bool pinned = handle->quality >= 0 && handle->quality <= 1 &&
+      length <= kMaxCriticalWindow;
+
+  uint8_t* data = nullptr;
+  /* Metadata longer than kMaxArrayWindow is copied to a temporary buffer. */
+  uint8_t* scratch = nullptr;
+  if (window != 0 && pinned) {
+    data = static_cast<uint8_t*>(env->GetPrimitiveArrayCritical(input, nullptr));
+    if (!data) {
+      return 0;
+    }
+    data += input_offset;
+  } else if (window != 0) {
+    if (window > kMaxArrayWindow) {
+      data = scratch = new (std::nothrow) uint8_t[window];
+    } else {
+      data = GetArrayStorage(handle, window);
+    }
+    if (!data) {
+      return 0;
+    }
+    env->GetByteArrayRegion(input, input_offset, static_cast<jsize>(window),
+        reinterpret_cast<jbyte*>(data));
+  }
+  const uint8_t* in = data;
+  size_t in_size = window;
+  NoteOperation(handle, op);
+  BROTLI_BOOL status = Encode(handle, op, &in_size, &in);
+  if (data != nullptr && pinned) {
+    env->ReleasePrimitiveArrayCritical(input, data - input_offset, JNI_ABORT);
+  }
+  delete[] scratch;
+  if (!status) {
+    return 0;
   }
-  env->SetLongArrayRegion(ctx, 0, 5, context);
+  ReleaseIdleMemoryAfterFlush(handle);
+  size_t consumed = window - in_size;
+  jint result = getStatus(handle);
+  if (consumed < length) result |= kHasRemainingInput;
+  return (static_cast<jlong>(consumed) << 32) | result;
 }
 
 /**
- * Pull decompressed data from encoder.
+ * Compresses straight from / into direct buffers, without staging copies.
  *
- * @param ctx {in_cookie, out_success, out_has_more_output,
- *             out_has_remaining_input} tuple
- * @returns direct ByteBuffer; all the produced data MUST be consumed before
- *          any further invocation; null in case of error
+ * Sources are consumed in order; output is written to destinations in
+ * order, until they are full or |operation| is complete. The operation is
+ * applied with the last source that has data; others are processed with
+ * PROCESS. Input staged with nativePush MUST be consumed before.
+ *
+ * @param cookie encoder handle
+ * @param operation 0 / 1 / 2 for PROCESS / FLUSH / FINISH
+ * @param srcs direct source buffers
+ * @param src_regions {position, limit} pair per source; positions are
+ *                    advanced past the consumed data
+ * @param dsts direct destination buffers
+ * @param dst_regions {position, limit} pair per destination; positions are
+ *                    advanced past the produced data
+ * @returns status bit set (see nativePush); kHasRemainingInput is set if some
+ *          source is not consumed; 0 in case of error
  */
-JNIEXPORT jobject JNICALL
+JNIEXPORT jint JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePushVectored(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jint operation,
+    jobjectArray srcs, jintArray src_regions, jobjectArray dsts,
+    jintArray dst_regions) {
+  EncoderHandle* handle = getHandle(cookie);
+
+  BrotliEncoderOperation op;
+  switch (operation) {
+    case 0: op = BROTLI_OPERATION_PROCESS; break;
+    case 1: op = BROTLI_OPERATION_FLUSH; break;
+    case 2: op = BROTLI_OPERATION_FINISH; break;
+    default: return 0;  /* ERROR */
+  }
+
+  /* Still have unconsumed staged data. Workflow is broken. */
+  if (handle->input_offset < handle->input_last) {
+    return 0;
+  }
+
+  jsize num_srcs = env->GetArrayLength(srcs);
+  jsize num_dsts = env->GetArrayLength(dsts);
+  if (env->GetArrayLength(src_regions) != 2 * num_srcs ||
+      env->GetArrayLength(dst_regions) != 2 * num_dsts) {
+    return 0;
+  }
+  jint* src_pos = new (std::nothrow) jint[2 * num_srcs + 1];
+  jint* dst_pos = new (std::nothrow) jint[2 * num_dsts + 1];
+  bool ok = !!src_pos && !!dst_pos;
+  if (ok) {
+    env->GetIntArrayRegion(src_regions, 0, 2 * num_srcs, src_pos);
+    env->GetIntArrayRegion(dst_regions, 0, 2 * num_dsts, dst_pos);
+  }
+
+  /* Operation is applied with the last source that has data. */
+  jsize last_src = 0;
+  for (jsize i = 0; ok && i < num_srcs; ++i) {
+    if (src_pos[2 * i] < 0 || src_pos[2 * i] > src_pos[2 * i + 1]) ok = false;
+    if (src_pos[2 * i] != src_pos[2 * i + 1]) last_src = i;
+  }
+  for (jsize i = 0; ok && i < num_dsts; ++i) {
+    if (dst_pos[2 * i] < 0 || dst_pos[2 * i] > dst_pos[2 * i + 1]) ok = false;
+  }
+
+  jsize si = 0;
+  jsize di = 0;
+  const uint8_t* src = nullptr;
+  uint8_t* dst = nullptr;
+  jsize src_index = -1;
+  jsize dst_index = -1;
+  while (ok && !BrotliEncoderIsFinished(handle->state)) {
+    while (si < num_srcs && src_pos[2 * si] == src_pos[2 * si + 1]) si++;
+    while (di < num_dsts && dst_pos[2 * di] == dst_pos[2 * di + 1]) di++;
+    if (di == num_dsts) break;  /* Out of output space. */
+    if (si < num_srcs && si != src_index) {
+      src = DirectAddress(env, srcs, si, src_pos[2 * si + 1]);
+      src_index = si;
+      if (!src) ok = false;
+    }
+    if (di != dst_index) {
+      dst = DirectAddress(env, dsts, di, dst_pos[2 * di + 1]);
+      dst_index = di;
+      if (!dst) ok = false;
+    }
+    if (!ok) break;
+
+    BrotliEncoderOperation current_op =
+        (si < last_src) ? BROTLI_OPERATION_PROCESS : op;
+    const uint8_t* in = nullptr;
+    size_t in_size = 0;
+    if (si < num_srcs) {
+      in = src + src_pos[2 * si];
+      in_size = static_cast<size_t>(src_pos[2 * si + 1] - src_pos[2 * si]);
+    }
+    uint8_t* out = dst + dst_pos[2 * di];
+    size_t out_size =
+        static_cast<size_t>(dst_pos[2 * di + 1] - dst_pos[2 * di]);
+    size_t in_left = in_size;
+    size_t out_left = out_size;
+    ok = !!BrotliEncoderCompressStream(handle->state, current_op, &in_left,
+        &in, &out_left, &out, &handle->total_out);
+    if (si < num_srcs) src_pos[2 * si] += static_cast<jint>(in_size - in_left);
+    dst_pos[2 * di] += static_cast<jint>(out_size - out_left);
+    /* Encoder returns with output space left only when operation is done,
+       or when its work budget is spent; the latter ends this push. */
+    if (ok && out_left != 0 && si >= last_src && in_left == 0) break;
+    if (ok && out_left != 0 && in_left != 0) break;
+  }
+
+  jint result = 0;
+  if (ok) {
+    env->SetIntArrayRegion(src_regions, 0, 2 * num_srcs, src_pos);
+    env->SetIntArrayRegion(dst_regions, 0, 2 * num_dsts, dst_pos);
+    result = getStatus(handle);
+    for (jsize i = 0; i < num_srcs; ++i) {
+      if (src_pos[2 * i] != src_pos[2 * i + 1]) result |= kHasRemainingInput;
+    }
+  }
+  if (!!src_pos) delete[] src_pos;
+  if (!!dst_pos) delete[] dst_pos;
+  return result;
+}
+
+/**
+ * Makes the encoder stage input in memory of a direct ByteBuffer.
+ *
+ * Caller keeps |buffer| alive while it is installed and never pushes more
+ * bytes than its capacity.
+ *
+ * @param cookie encoder handle
+ * @param buffer direct ByteBuffer; null to return to the own staging buffer
+ * @returns false if staged input is not consumed yet, or buffer is not direct
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeSetInputBuffer(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject buffer) {
+  EncoderHandle* handle = getHandle(cookie);
+  if (handle->input_offset < handle->input_last) {
+    return JNI_FALSE;
+  }
+  uint8_t* start = handle->input_storage;
+  if (!!buffer) {
+    start = static_cast<uint8_t*>(env->GetDirectBufferAddress(buffer));
+    if (!start) {
+      return JNI_FALSE;
+    }
+  }
+  handle->input_start = start;
+  handle->input_offset = 0;
+  handle->input_last = 0;
+  return JNI_TRUE;
+}
+
+/**
+ * Pull compressed data from encoder into the output buffer.
+ *
+ * Pushes write output straight into the buffer. If it is empty, output kept
+ * by encoder is written there, continuing the operation of the last push
+ * (or PROCESS, if that push left input unconsumed). In the middle of a
+ * metadata block nothing is pulled and kHasMoreOutput is cleared; the rest
+ * of the block MUST be pushed then.
+ *
+ * @param cookie encoder handle
+ * @returns number of bytes placed into output buffer in upper 32 bits;
+ *          status bit set (see nativePush) in lower 32 bits
+ */
+JNIEXPORT jlong JNICALL
 Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePull(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx) {
-  jlong context[5];
-  env->GetLongArrayRegion(ctx, 0, 5, context);
-  EncoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
-  size_t data_length = 0;
-  const uint8_t* data = BrotliEncoderTakeOutput(handle->state, &data_length);
-  context[1] = 1;
-  context[2] = BrotliEncoderHasMoreOutput(handle->state) ? 1 : 0;
-  context[3] = (handle->input_offset != handle->input_last) ? 1 : 0;
-  context[4] = BrotliEncoderIsFinished(handle->state) ? 1 : 0;
-  env->SetLongArrayRegion(ctx, 0, 5, context);
-  return env->NewDirectByteBuffer(const_cast<uint8_t*>(data), data_length);
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
+  if (handle->output_length == 0 &&
+      BrotliEncoderHasMoreOutput(handle->state)) {
+    BrotliEncoderOperation last_op = handle->last_op;
+    bool input_pending = handle->input_pending;
+    /* Caller pushes the rest of metadata block instead; output goes first. */
+    if (input_pending && last_op == BROTLI_OPERATION_EMIT_METADATA) {
+      return getStatus(handle) & ~kHasMoreOutput;
+    }
+    /* Operation takes effect only with the rest of input. */
+    size_t in_size = 0;
+    const uint8_t* in = nullptr;
+    if (!Encode(handle, input_pending ? BROTLI_OPERATION_PROCESS : last_op,
+        &in_size, &in)) {
+      return 0;
+    }
+    handle->last_op = last_op;
+    handle->input_pending = input_pending;
+  }
+  size_t data_length = handle->output_length;
+  handle->output_length = 0;
+  ReleaseIdleMemoryAfterFlush(handle);
+  return (static_cast<jlong>(data_length) << 32) | getStatus(handle);
+}
+
+/**
+ * Returns direct ByteBuffer that views encoder output buffer.
+ *
+ * @param cookie encoder handle
+ */
+JNIEXPORT jobject JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeGetOutputBuffer(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
+  return env->NewDirectByteBuffer(handle->output_start,
+      static_cast<jlong>(handle->output_size));
 }
 
 /**
  * Releases all used resources.
  *
- * @param ctx {in_cookie} tuple
+ * @param cookie encoder handle
  */
 JNIEXPORT void JNICALL
 Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeDestroy(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx) {
-  jlong context[2];
-  env->GetLongArrayRegion(ctx, 0, 2, context);
-  EncoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
   BrotliEncoderDestroyInstance(handle->state);
-  for (size_t i = 0; i < handle->dictionary_count; ++i) {
-    env->DeleteGlobalRef(handle->dictionary_refs[i]);
+  brotli4j::ReleaseMemory(&handle->memory_stats);
+  ReleaseDictionaries(env, handle);
+  DeleteHandle(handle);
+}
+
+/**
+ * One-shot compression from a direct buffer region into another one.
+ *
+ * No encoder handle is created and no input is staged; data is read from and
+ * written to the caller-owned memory directly.
+ *
+ * @param input direct ByteBuffer with data to compress
+ * @param output direct ByteBuffer that receives compressed data
+ * @returns number of bytes written to output; -1 in case of error (e.g. when
+ *          output region is too small)
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCompress(
+    JNIEnv* env, jobject /*jobj*/, jobject input, jint input_offset,
+    jint input_length, jobject output, jint output_offset, jint output_length,
+    jint quality, jint lgwin, jint mode) {
+  if (!input || !output) {
+    return -1;
   }
-  delete[] handle->input_start;
-  delete handle;
+  uint8_t* in = static_cast<uint8_t*>(env->GetDirectBufferAddress(input));
+  uint8_t* out = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  if (!in || !out) {
+    return -1;
+  }
+  if (input_offset < 0 || input_length < 0 || output_offset < 0 ||
+      output_length < 0 ||
+      input_offset + static_cast<jlong>(input_length) >
+          env->GetDirectBufferCapacity(input) ||
+      output_offset + static_cast<jlong>(output_length) >
+          env->GetDirectBufferCapacity(output)) {
+    return -1;
+  }
+
+  size_t encoded_size = static_cast<size_t>(output_length);
+  /* BrotliEncoderCompress would switch to "Large Window Brotli" otherwise. */
+  if (lgwin > BROTLI_MAX_WINDOW_BITS) lgwin = BROTLI_MAX_WINDOW_BITS;
+  BROTLI_BOOL ok = BrotliEncoderCompress(
+      quality >= 0 ? quality : BROTLI_DEFAULT_QUALITY,
+      lgwin >= 0 ? lgwin : BROTLI_DEFAULT_WINDOW,
+      mode >= 0 ? static_cast<BrotliEncoderMode>(mode) : BROTLI_DEFAULT_MODE,
+      static_cast<size_t>(input_length), in + input_offset,
+      &encoded_size, out + output_offset);
+  if (!ok) {
+    return -1;
+  }
+  return static_cast<jlong>(encoded_size);
+}
+
+/**
+ * Compresses as much of input as fits the output region into a complete
+ * stream.
+ *
+ * @param input direct ByteBuffer with data to compress
+ * @param output direct ByteBuffer that receives compressed data; its region is
+ *               the output budget
+ * @param result receives number of consumed input bytes and length of stream
+ * @returns false in case of error (e.g. when even empty stream does not fit)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCompressToBudget(
+    JNIEnv* env, jobject /*jobj*/, jobject input, jint input_offset,
+    jint input_length, jobject output, jint output_offset, jint output_length,
+    jint quality, jint lgwin, jint mode, jlongArray result) {
+  if (!input || !output || env->GetArrayLength(result) < 2) {
+    return JNI_FALSE;
+  }
+  uint8_t* in = static_cast<uint8_t*>(env->GetDirectBufferAddress(input));
+  uint8_t* out = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  if (!in || !out) {
+    return JNI_FALSE;
+  }
+  if (input_offset < 0 || input_length < 0 || output_offset < 0 ||
+      output_length < 0 ||
+      input_offset + static_cast<jlong>(input_length) >
+          env->GetDirectBufferCapacity(input) ||
+      output_offset + static_cast<jlong>(output_length) >
+          env->GetDirectBufferCapacity(output)) {
+    return JNI_FALSE;
+  }
+
+  size_t consumed_size = 0;
+  size_t encoded_size = static_cast<size_t>(output_length);
+  /* BrotliEncoderCompressToBudget would switch to "Large Window Brotli"
+     otherwise. */
+  if (lgwin > BROTLI_MAX_WINDOW_BITS) lgwin = BROTLI_MAX_WINDOW_BITS;
+  BROTLI_BOOL ok = BrotliEncoderCompressToBudget(
+      quality >= 0 ? quality : BROTLI_DEFAULT_QUALITY,
+      lgwin >= 0 ? lgwin : BROTLI_DEFAULT_WINDOW,
+      mode >= 0 ? static_cast<BrotliEncoderMode>(mode) : BROTLI_DEFAULT_MODE,
+      static_cast<size_t>(input_length), in + input_offset,
+      &consumed_size, &encoded_size, out + output_offset);
+  if (!ok) {
+    return JNI_FALSE;
+  }
+  jlong values[2] = {static_cast<jlong>(consumed_size),
+                     static_cast<jlong>(encoded_size)};
+  env->SetLongArrayRegion(result, 0, 2, values);
+  return JNI_TRUE;
+}
+
+/**
+ * Compresses a chunk of a bigger input with a dedicated encoder instance.
+ *
+ * Outputs of consecutive chunks concatenate into a single valid stream: all
+ * but the last chunk are flushed, and all but the first one are encoded with
+ * BROTLI_PARAM_STREAM_OFFSET, so that stream header is omitted. Chunk data is
+ * copied out of the array, so it is not pinned while compressing.
+ *
+ * @param stream_offset number of input bytes before this chunk
+ * @param last whether this chunk finishes the stream
+ * @returns compressed chunk; null in case of error
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCompressChunk(
+    JNIEnv* env, jobject /*jobj*/, jbyteArray data, jint offset, jint length,
+    jint quality, jint lgwin, jint mode, jlong stream_offset, jboolean last) {
+  if (offset < 0 || length < 0 || stream_offset < 0 ||
+      offset > env->GetArrayLength(data) - length) {
+    return nullptr;
+  }
+  uint8_t* input = new (std::nothrow) uint8_t[length > 0 ? length : 1];
+  if (!input) {
+    return nullptr;
+  }
+  env->GetByteArrayRegion(data, offset, length,
+      reinterpret_cast<jbyte*>(input));
+
+  bool ok = true;
+  BrotliEncoderState* state =
+      BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+  ok = !!state;
+  if (ok) {
+    if (quality >= 0) {
+      BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, quality);
+    }
+    if (lgwin >= 0) {
+      BrotliEncoderSetParameter(state, BROTLI_PARAM_LGWIN, lgwin);
+    }
+    if (mode >= 0) {
+      BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, mode);
+    }
+    SetStreamOffset(state, stream_offset);
+  }
+
+  uint8_t* output = nullptr;
+  size_t output_size = 0;
+  if (ok) {
+    ok = DrainStream(state,
+        last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH,
+        input, static_cast<size_t>(length), &output, &output_size);
+  }
+  if (!!state) BrotliEncoderDestroyInstance(state);
+  delete[] input;
+
+  jbyteArray result = ok ? ToByteArray(env, output, output_size) : nullptr;
+  delete[] output;
+  return result;
+}
+
+/**
+ * Compresses file |input| to file |output| without passing data through Java.
+ *
+ * Input is memory-mapped and read in place; output is written as it is
+ * produced. BROTLI_PARAM_SIZE_HINT is set from the input size. With several
+ * threads, input is cut into chunks of max(4 MiB, window) bytes, compressed
+ * by forks of the encoder, each with the window primed by preceding input;
+ * the encoder itself is left fresh then. Encoders with attached dictionaries
+ * can not be forked and always use a single thread.
+ *
+ * @param cookie fresh encoder handle
+ * @param lgwin window bits the encoder is created with
+ * @param threads maximal number of threads
+ * @returns compressed size; -1 if files can not be read or written, -2 if
+ *          encoding fails
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCompressFile(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jstring input, jstring output,
+    jint lgwin, jint threads) {
+  EncoderHandle* handle = getHandle(cookie);
+  const char* input_path = env->GetStringUTFChars(input, nullptr);
+  if (!input_path) return kFileError;
+  brotli4j::MappedFile file;
+  bool mapped = brotli4j::MapFile(input_path, &file);
+  env->ReleaseStringUTFChars(input, input_path);
+  if (!mapped) return kFileError;
+
+  FILE* out = nullptr;
+  const char* output_path = env->GetStringUTFChars(output, nullptr);
+  if (!!output_path) {
+    out = brotli4j::OpenOutputFile(output_path);
+    env->ReleaseStringUTFChars(output, output_path);
+  }
+  if (!out) {
+    brotli4j::UnmapFile(&file);
+    return kFileError;
+  }
+
+  size_t max_hint = static_cast<size_t>(1) << 30;
+  BrotliEncoderSetParameter(handle->state, BROTLI_PARAM_SIZE_HINT,
+      static_cast<uint32_t>(file.size < max_hint ? file.size : max_hint));
+  size_t window = (static_cast<size_t>(1) << lgwin) - 16;
+  size_t chunk_size = window + 16 > kMinFileChunkSize ?
+      window + 16 : kMinFileChunkSize;
+  jlong result;
+  if (threads > 1 && file.size > chunk_size &&
+      handle->dictionary_count + handle->shared_dictionary_count == 0) {
+    result = CompressMappedParallel(handle->state, file.data, file.size,
+        chunk_size, window, static_cast<size_t>(threads), out);
+  } else {
+    result = CompressMapped(handle->state, file.data, file.size, out);
+  }
+  if (fclose(out) != 0 && result >= 0) result = kFileError;
+  brotli4j::UnmapFile(&file);
+  return result;
+}
+
+/**
+ * Encodes |data| as a metadata block that continues a stream.
+ *
+ * Decoders skip metadata, so the block may be placed after any flushed chunk
+ * produced by nativeCompressChunk.
+ *
+ * @param stream_offset number of input bytes before this block
+ * @param last whether the empty last meta-block follows the metadata
+ * @returns encoded block; null in case of error
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeEncodeMetadata(
+    JNIEnv* env, jobject /*jobj*/, jbyteArray data, jlong stream_offset,
+    jboolean last) {
+  jsize length = env->GetArrayLength(data);
+  if (stream_offset < 0 || length > (1 << 24)) {
+    return nullptr;
+  }
+  uint8_t* input = new (std::nothrow) uint8_t[length > 0 ? length : 1];
+  if (!input) {
+    return nullptr;
+  }
+  env->GetByteArrayRegion(data, 0, length, reinterpret_cast<jbyte*>(input));
+
+  BrotliEncoderState* state =
+      BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+  bool ok = !!state;
+  uint8_t* output = nullptr;
+  size_t output_size = 0;
+  if (ok) {
+    SetStreamOffset(state, stream_offset);
+    ok = DrainStream(state, BROTLI_OPERATION_EMIT_METADATA, input,
+        static_cast<size_t>(length), &output, &output_size);
+  }
+  if (ok && last) {
+    ok = DrainStream(state, BROTLI_OPERATION_FINISH, input, 0, &output,
+        &output_size);
+  }
+  if (!!state) BrotliEncoderDestroyInstance(state);
+  delete[] input;
+
+  jbyteArray result = ok ? ToByteArray(env, output, output_size) : nullptr;
+  delete[] output;
+  return result;
+}
+
+/**
+ * Joins fragments made with BROTLI_PARAM_FRAGMENT into a single stream.
+ *
+ * @param fragments fragment data, in stream order
+ * @param lgwin window of the stream; not less than window of any fragment
+ * @returns stream; null in case of error
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeConcatenate(
+    JNIEnv* env, jobject /*jobj*/, jobjectArray fragments, jint lgwin) {
+  jsize count = env->GetArrayLength(fragments);
+  size_t* sizes = new (std::nothrow) size_t[count > 0 ? count : 1];
+  const uint8_t** data =
+      new (std::nothrow) const uint8_t*[count > 0 ? count : 1];
+  jbyteArray* arrays = new (std::nothrow) jbyteArray[count > 0 ? count : 1];
+  bool ok = !!sizes && !!data && !!arrays;
+  jsize pinned = 0;
+  size_t total = BROTLI_CONCATENATE_OVERHEAD;
+  for (jsize i = 0; ok && i < count; ++i) {
+    arrays[i] =
+        static_cast<jbyteArray>(env->GetObjectArrayElement(fragments, i));
+    if (!arrays[i]) {
+      ok = false;
+      break;
+    }
+    sizes[i] = static_cast<size_t>(env->GetArrayLength(arrays[i]));
+    total += sizes[i];
+    data[i] = reinterpret_cast<const uint8_t*>(
+        env->GetByteArrayElements(arrays[i], nullptr));
+    if (!data[i]) {
+      env->DeleteLocalRef(arrays[i]);
+      ok = false;
+      break;
+    }
+    pinned = i + 1;
+  }
+  if (ok && total > 0x7FFFFFFF) {
+    ok = false;
+  }
+
+  uint8_t* output = nullptr;
+  size_t output_size = total;
+  if (ok) {
+    output = new (std::nothrow) uint8_t[total];
+    ok = !!output;
+  }
+  if (ok) {
+    ok = !!BrotliEncoderConcatenate(lgwin, static_cast<size_t>(count), sizes,
+        data, &output_size, output);
+  }
+  for (jsize i = 0; i < pinned; ++i) {
+    env->ReleaseByteArrayElements(arrays[i],
+        reinterpret_cast<jbyte*>(const_cast<uint8_t*>(data[i])), JNI_ABORT);
+    env->DeleteLocalRef(arrays[i]);
+  }
+  delete[] arrays;
+  delete[] data;
+  delete[] sizes;
+
+  jbyteArray result = ok ? ToByteArray(env, output, output_size) : nullptr;
+  delete[] output;
+  return result;
+}
+
+/**
+ * Trains a raw dictionary of at most |limit| bytes on concatenated samples.
+ *
+ * @param sizes sizes of the samples stored one after another in |samples|
+ * @param serialized whether to wrap the result in shared dictionary format
+ * @returns trained dictionary; null in case of error
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeTrainDictionary(
+    JNIEnv* env, jobject /*jobj*/, jbyteArray samples, jintArray sizes,
+    jint limit, jboolean serialized) {
+  jsize length = env->GetArrayLength(samples);
+  jsize count = env->GetArrayLength(sizes);
+  if (limit <= 0) {
+    return nullptr;
+  }
+  jint* jsizes = new (std::nothrow) jint[count > 0 ? count : 1];
+  size_t* sample_sizes = new (std::nothrow) size_t[count > 0 ? count : 1];
+  uint8_t* input = new (std::nothrow) uint8_t[length > 0 ? length : 1];
+  size_t output_size = static_cast<size_t>(limit) +
+      BROTLI_SERIALIZED_DICTIONARY_OVERHEAD;
+  uint8_t* dictionary = new (std::nothrow) uint8_t[output_size];
+  uint8_t* output = serialized ?
+      new (std::nothrow) uint8_t[output_size] : dictionary;
+  bool ok = jsizes && sample_sizes && input && dictionary && output;
+  if (ok) {
+    env->GetIntArrayRegion(sizes, 0, count, jsizes);
+    env->GetByteArrayRegion(samples, 0, length,
+        reinterpret_cast<jbyte*>(input));
+    size_t total = 0;
+    for (jsize i = 0; ok && i < count; ++i) {
+      ok = jsizes[i] >= 0;
+      sample_sizes[i] = static_cast<size_t>(jsizes[i]);
+      total += sample_sizes[i];
+    }
+    ok = ok && total <= static_cast<size_t>(length);
+  }
+  size_t dictionary_size = static_cast<size_t>(limit);
+  if (ok) {
+    ok = !!BrotliEncoderTrainDictionary(static_cast<size_t>(count),
+        sample_sizes, input, &dictionary_size, dictionary);
+  }
+  if (ok && serialized) {
+    ok = !!BrotliEncoderSerializeDictionary(dictionary_size, dictionary,
+        &output_size, output);
+  } else {
+    output_size = dictionary_size;
+  }
+
+  jbyteArray result = ok ? ToByteArray(env, output, output_size) : nullptr;
+  if (output != dictionary) delete[] output;
+  delete[] dictionary;
+  delete[] input;
+  delete[] sample_sizes;
+  delete[] jsizes;
+  return result;
+}
+
+/**
+ * Trains an encoder profile for |quality| on concatenated samples.
+ *
+ * @param sizes sizes of the samples stored one after another in |samples|
+ * @returns BROTLI_ENCODER_PROFILE_SIZE bytes; null in case of error
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeTrainProfile(
+    JNIEnv* env, jobject /*jobj*/, jbyteArray samples, jintArray sizes,
+    jint quality) {
+  jsize length = env->GetArrayLength(samples);
+  jsize count = env->GetArrayLength(sizes);
+  jint* jsizes = new (std::nothrow) jint[count > 0 ? count : 1];
+  size_t* sample_sizes = new (std::nothrow) size_t[count > 0 ? count : 1];
+  uint8_t* input = new (std::nothrow) uint8_t[length > 0 ? length : 1];
+  uint8_t profile[BROTLI_ENCODER_PROFILE_SIZE];
+  bool ok = jsizes && sample_sizes && input;
+  if (ok) {
+    env->GetIntArrayRegion(sizes, 0, count, jsizes);
+    env->GetByteArrayRegion(samples, 0, length,
+        reinterpret_cast<jbyte*>(input));
+    size_t total = 0;
+    for (jsize i = 0; ok && i < count; ++i) {
+      ok = jsizes[i] >= 0;
+      sample_sizes[i] = static_cast<size_t>(jsizes[i]);
+      total += sample_sizes[i];
+    }
+    ok = ok && total <= static_cast<size_t>(length);
+  }
+  if (ok) {
+    ok = !!BrotliEncoderTrainProfile(quality, static_cast<size_t>(count),
+        sample_sizes, input, profile);
+  }
+
+  jbyteArray result =
+      ok ? ToByteArray(env, profile, BROTLI_ENCODER_PROFILE_SIZE) : nullptr;
+  delete[] input;
+  delete[] sample_sizes;
+  delete[] jsizes;
+  return result;
+}
+
+/**
+ * Compresses many small payloads with a single encoder, each into its own
+ * stream.
+ *
+ * Encoder is reset before every slice, so its buffers and hash tables are
+ * reused across the batch; attached dictionaries are released. Data is read
+ * from and written to the direct buffers without intermediate copies. Slices
+ * are processed in order until one of them does not fit the output region.
+ *
+ * @param cookie encoder handle
+ * @param slices {offset, length} pairs addressing input data
+ * @param count number of slices
+ * @param offsets receives start of each compressed stream in output, followed
+ *                by the end of the last one; MUST have count + 1 elements
+ * @returns number of compressed slices; -1 in case of error
+ */
+JNIEXPORT jint JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeCompressBatch(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject input,
+    jintArray slices, jint count, jobject output, jint output_offset,
+    jint output_length, jintArray offsets) {
+  EncoderHandle* handle = getHandle(cookie);
+  if (!input || !output || count < 0 ||
+      env->GetArrayLength(slices) / 2 < count ||
+      env->GetArrayLength(offsets) <= count) {
+    return -1;
+  }
+  uint8_t* in = static_cast<uint8_t*>(env->GetDirectBufferAddress(input));
+  uint8_t* out = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  if (!in || !out) {
+    return -1;
+  }
+  jlong input_capacity = env->GetDirectBufferCapacity(input);
+  if (output_offset < 0 || output_length < 0 ||
+      output_offset + static_cast<jlong>(output_length) >
+          env->GetDirectBufferCapacity(output)) {
+    return -1;
+  }
+
+  jint* bounds = new (std::nothrow) jint[2 * static_cast<size_t>(count) + 1];
+  if (!bounds) {
+    return -1;
+  }
+  env->GetIntArrayRegion(slices, 0, 2 * count, bounds);
+  for (jint i = 0; i < count; ++i) {
+    jint offset = bounds[2 * i];
+    jint length = bounds[2 * i + 1];
+    if (offset < 0 || length < 0 ||
+        offset + static_cast<jlong>(length) > input_capacity) {
+      delete[] bounds;
+      return -1;
+    }
+  }
+
+  /* Stream starts are written over consumed slice bounds. */
+  jint* starts = bounds;
+  uint8_t* next_out = out + output_offset;
+  uint8_t* out_end = next_out + output_length;
+  handle->input_offset = 0;
+  handle->input_last = 0;
+  handle->output_length = 0;
+  handle->total_out = 0;
+  handle->last_op = BROTLI_OPERATION_PROCESS;
+  handle->input_pending = false;
+  jint done = 0;
+  bool ok = true;
+  for (; done < count; ++done) {
+    const uint8_t* next_in = in + bounds[2 * done];
+    size_t available_in = static_cast<size_t>(bounds[2 * done + 1]);
+    ok = !!BrotliEncoderResetInstance(handle->state);
+    if (!ok) break;
+    ReleaseDictionaries(env, handle);
+    uint8_t* slice_start = next_out;
+    starts[done] = static_cast<jint>(slice_start - out);
+    size_t available_out = static_cast<size_t>(out_end - next_out);
+    while (ok && !BrotliEncoderIsFinished(handle->state) &&
+        available_out != 0) {
+      ok = !!BrotliEncoderCompressStream(handle->state,
+          BROTLI_OPERATION_FINISH, &available_in, &next_in, &available_out,
+          &next_out, nullptr);
+    }
+    if (!ok) break;
+    if (!BrotliEncoderIsFinished(handle->state)) {
+      /* Does not fit; drop partial output. */
+      next_out = slice_start;
+      break;
+    }
+  }
+  starts[done] = static_cast<jint>(next_out - out);
+  if (ok) {
+    env->SetIntArrayRegion(offsets, 0, done + 1, starts);
+  }
+  delete[] bounds;
+  return ok ? done : -1;
+}
+
+/**
+ * Upper bound of the one-shot compressed size; 0 if input is too large.
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeMaxCompressedSize(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong input_size) {
+  if (input_size < 0) {
+    return 0;
+  }
+  return static_cast<jlong>(
+      BrotliEncoderMaxCompressedSize(static_cast<size_t>(input_size)));
+}
+
+/**
+ * Approximate peak of memory allocated by encoder state; see
+ * BrotliEncoderEstimatePeakMemoryUsage. Negative quality / lgwin select
+ * defaults.
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeEstimatePeakMemory(
+    JNIEnv* /*env*/, jobject /*jobj*/, jint quality, jint lgwin,
+    jlong size_hint) {
+  if (quality < 0) quality = BROTLI_DEFAULT_QUALITY;
+  if (lgwin < 0) lgwin = BROTLI_DEFAULT_WINDOW;
+  size_t input_size = (size_hint > 0) ? static_cast<size_t>(size_hint) : 0;
+  return static_cast<jlong>(
+      BrotliEncoderEstimatePeakMemoryUsage(quality, lgwin, input_size));
+}
+
+/**
+ * Predicts compressed size and encoding time; see BrotliEncoderEstimate.
+ * Negative quality / lgwin select defaults.
+ *
+ * @param direct direct buffer with data, or null
+ * @param array array with data if direct is null
+ * @param result receives predicted size and nanoseconds
+ * @returns false in case of invalid arguments
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeEstimate(
+    JNIEnv* env, jobject /*jobj*/, jint quality, jint lgwin, jobject direct,
+    jbyteArray array, jint offset, jint length, jlongArray result) {
+  if (quality < 0) quality = BROTLI_DEFAULT_QUALITY;
+  if (lgwin < 0) lgwin = BROTLI_DEFAULT_WINDOW;
+  if (offset < 0 || length < 0 || env->GetArrayLength(result) < 2) {
+    return JNI_FALSE;
+  }
+  jlong capacity = direct ? env->GetDirectBufferCapacity(direct) :
+      (array ? env->GetArrayLength(array) : -1);
+  if (offset + static_cast<jlong>(length) > capacity) {
+    return JNI_FALSE;
+  }
+
+  /* Only a few samples are read, so critical access is short. */
+  uint8_t* data = nullptr;
+  if (direct) {
+    data = static_cast<uint8_t*>(env->GetDirectBufferAddress(direct));
+  } else if (length != 0) {
+    data = static_cast<uint8_t*>(env->GetPrimitiveArrayCritical(array, nullptr));
+  }
+  if (!data && length != 0) {
+    return JNI_FALSE;
+  }
+  size_t compressed_size = 0;
+  uint64_t encode_nanos = 0;
+  bool ok = !!BrotliEncoderEstimate(quality, lgwin,
+      static_cast<size_t>(length), data ? data + offset : nullptr,
+      &compressed_size, &encode_nanos);
+  if (!direct && data) {
+    env->ReleasePrimitiveArrayCritical(array, data, JNI_ABORT);
+  }
+  if (ok) {
+    jlong values[2] = {static_cast<jlong>(compressed_size),
+                       static_cast<jlong>(encode_nanos)};
+    env->SetLongArrayRegion(result, 0, 2, values);
+  }
+  return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Prepares encoder for a new stream with the same parameters.
+ *
+ * Internal buffers and hash tables are kept allocated; attached dictionaries
+ * are released.
+ *
+ * @param cookie encoder handle
+ * @returns false if encoder can not be reused
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeReset(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
+  bool ok = !!BrotliEncoderResetInstance(handle->state);
+  ReleaseDictionaries(env, handle);
+  handle->input_offset = 0;
+  handle->input_last = 0;
+  handle->output_length = 0;
+  handle->total_out = 0;
+  handle->last_op = BROTLI_OPERATION_PROCESS;
+  handle->input_pending = false;
+  /* Retained buffers stay accounted; peak and count restart. */
+  handle->memory_stats.peak_bytes = handle->memory_stats.current_bytes;
+  handle->memory_stats.allocation_count = 0;
+  return static_cast<jboolean>(ok);
+}
+
+/**
+ * Reports memory allocated by the encoder state (JNI buffers are excluded).
+ *
+ * @param cookie encoder handle
+ * @param stats {out_currentBytes, out_peakBytes, out_allocationCount} tuple;
+ *              peak and count are taken since creation or the last reset
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeGetMemoryStats(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jlongArray stats) {
+  EncoderHandle* handle = getHandle(cookie);
+  jlong values[3];
+  values[0] = static_cast<jlong>(handle->memory_stats.current_bytes);
+  values[1] = static_cast<jlong>(handle->memory_stats.peak_bytes);
+  values[2] = static_cast<jlong>(handle->memory_stats.allocation_count);
+  env->SetLongArrayRegion(stats, 0, 3, values);
+}
+
+/**
+ * Toggles ::BROTLI_PARAM_SKIP_INCOMPRESSIBLE; value is kept over resets.
+ *
+ * @param cookie encoder handle
+ * @param enable whether near-random blocks are stored without compression
+ * @returns false if parameter could not be set (encoding is started)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeSetSkipIncompressible(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jboolean enable) {
+  EncoderHandle* handle = getHandle(cookie);
+  return static_cast<jboolean>(!!BrotliEncoderSetParameter(handle->state,
+      BROTLI_PARAM_SKIP_INCOMPRESSIBLE, enable ? 1u : 0u));
+}
+
+/**
+ * Sets one of parameters without a dedicated setter; value is kept over
+ * resets.
+ *
+ * @param cookie encoder handle
+ * @param parameter BrotliEncoderParameter in range
+ *                  [BROTLI_PARAM_LGBLOCK, BROTLI_PARAM_STREAM_OFFSET], or
+ *                  [BROTLI_PARAM_LOW_LATENCY_FLUSH,
+ *                  BROTLI_PARAM_FIRST_BLOCK_BITS]
+ * @param value new value
+ * @returns false if parameter could not be set (encoding is started)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeSetParameter(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jint parameter,
+    jint value) {
+  EncoderHandle* handle = getHandle(cookie);
+  bool supported = (parameter >= BROTLI_PARAM_LGBLOCK &&
+                    parameter <= BROTLI_PARAM_STREAM_OFFSET) ||
+                   (parameter >= BROTLI_PARAM_LOW_LATENCY_FLUSH &&
+                    parameter <= BROTLI_PARAM_FIRST_BLOCK_BITS);
+  if (!supported || value < 0) {
+    return JNI_FALSE;
+  }
+  return static_cast<jboolean>(!!BrotliEncoderSetParameter(handle->state,
+      static_cast<BrotliEncoderParameter>(parameter),
+      static_cast<uint32_t>(value)));
+}
+
+/**
+ * Sets profile made by nativeTrainProfile; it is kept over resets.
+ *
+ * @param cookie encoder handle
+ * @param profile profile data; null to clear it
+ * @returns false if profile is malformed or encoding is started
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeSetProfile(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jbyteArray profile) {
+  EncoderHandle* handle = getHandle(cookie);
+  if (!profile) {
+    return static_cast<jboolean>(
+        !!BrotliEncoderSetProfile(handle->state, 0, nullptr));
+  }
+  if (env->GetArrayLength(profile) != BROTLI_ENCODER_PROFILE_SIZE) {
+    return JNI_FALSE;
+  }
+  uint8_t data[BROTLI_ENCODER_PROFILE_SIZE];
+  env->GetByteArrayRegion(profile, 0, BROTLI_ENCODER_PROFILE_SIZE,
+      reinterpret_cast<jbyte*>(data));
+  return static_cast<jboolean>(!!BrotliEncoderSetProfile(handle->state,
+      BROTLI_ENCODER_PROFILE_SIZE, data));
+}
+
+/**
+ * Sets ::BROTLI_PARAM_MEMORY_LIMIT; value is kept over resets.
+ *
+ * Besides, idle memory is released after each completed flush.
+ *
+ * @param cookie encoder handle
+ * @param limit bytes; 0 for unlimited
+ * @returns false if parameter could not be set (encoding is started)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeSetMemoryLimit(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jlong limit) {
+  EncoderHandle* handle = getHandle(cookie);
+  uint32_t value = (limit > 0xFFFFFFFFLL) ? 0xFFFFFFFFu :
+      static_cast<uint32_t>(limit);
+  if (limit < 0 || !BrotliEncoderSetParameter(handle->state,
+      BROTLI_PARAM_MEMORY_LIMIT, value)) {
+    return JNI_FALSE;
+  }
+  handle->memory_limited = (value != 0);
+  handle->flush_pending = false;
+  return JNI_TRUE;
+}
+
+/**
+ * Admits encoder to the global native memory budget; see
+ * brotli4j::ReserveMemory. Reservation is kept over resets.
+ *
+ * @param cookie encoder handle
+ * @param bytes estimated peak memory of the encoder
+ * @param min_bytes smallest reservation to settle for after waiting
+ * @param wait_ms how long to wait for other encoders to release memory
+ * @returns reserved bytes; 0 if the budget has no room
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeReserveMemory(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jlong bytes,
+    jlong min_bytes, jlong wait_ms) {
+  EncoderHandle* handle = getHandle(cookie);
+  if (bytes <= 0 || min_bytes < 0) {
+    return 0;
+  }
+  return static_cast<jlong>(brotli4j::ReserveMemory(&handle->memory_stats,
+      static_cast<size_t>(bytes), static_cast<size_t>(min_bytes),
+      static_cast<long>(wait_ms)));
+}
+
+/**
+ * @param cookie encoder handle
+ * @returns number of input bytes stored uncompressed by the entropy pre-scan
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeGetStoredIncompressibleBytes(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
+  return static_cast<jlong>(
+      BrotliEncoderGetStoredIncompressibleBytes(handle->state));
+}
+
+/**
+ * Reads counters enabled with ::BROTLI_PARAM_COLLECT_STATS.
+ *
+ * @param cookie encoder handle
+ * @param stats out: BrotliEncoderStat values, BROTLI_ENCODER_NUM_STATS items
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeGetStats(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jlongArray stats) {
+  EncoderHandle* handle = getHandle(cookie);
+  uint64_t counters[BROTLI_ENCODER_NUM_STATS];
+  jlong values[BROTLI_ENCODER_NUM_STATS];
+  size_t count = BrotliEncoderGetStats(
+      handle->state, BROTLI_ENCODER_NUM_STATS, counters);
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = static_cast<jlong>(counters[i]);
+  }
+  env->SetLongArrayRegion(stats, 0, static_cast<jsize>(count), values);
+}
+
+/**
+ * @param cookie encoder handle
+ * @returns number of bytes encoder reports as produced by pushes so far
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeGetTotalOut(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
+  return static_cast<jlong>(handle->total_out);
+}
+
+/**
+ * @param cookie encoder handle
+ * @returns CRC-32C of input consumed so far, if ::BROTLI_PARAM_CHECKSUM is set
+ */
+JNIEXPORT jint JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeGetChecksum(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie) {
+  EncoderHandle* handle = getHandle(cookie);
+  return static_cast<jint>(BrotliEncoderGetChecksum(handle->state));
 }
 
 JNIEXPORT jboolean JNICALL
 Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeAttachDictionary(
-    JNIEnv* env, jobject /*jobj*/, jlongArray ctx, jobject dictionary) {
-  jlong context[2];
-  env->GetLongArrayRegion(ctx, 0, 2, context);
-  EncoderHandle* handle = getHandle(reinterpret_cast<void*>(context[0]));
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject dictionary) {
+  EncoderHandle* handle = getHandle(cookie);
   jobject ref = nullptr;
   uint8_t* address = nullptr;
 
@@ -234,7 +1737,8 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeAttachDictionary(
   if (ok && !dictionary) {
     ok = false;
   }
-  if (ok && handle->dictionary_count >= 15) {
+  if (ok &&
+      handle->dictionary_count + handle->shared_dictionary_count >= 15) {
     ok = false;
   }
   if (ok) {
@@ -255,6 +1759,64 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeAttachDictionary(
   return static_cast<jboolean>(ok);
 }
 
+/**
+ * Primes the window with the tail of input compressed by a previous run, see
+ * BrotliEncoderPrimeWindow; stream offset should be set beforehand.
+ *
+ * @param cookie encoder handle
+ * @param window direct buffer with the window
+ * @param offset position of the window in the buffer
+ * @param length window size
+ * @returns false if window is rejected or encoding is started
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePrimeWindow(
+    JNIEnv* env, jobject /*jobj*/, jlong cookie, jobject window, jint offset,
+    jint length) {
+  EncoderHandle* handle = getHandle(cookie);
+  if (!window) {
+    return JNI_FALSE;
+  }
+  uint8_t* data = static_cast<uint8_t*>(env->GetDirectBufferAddress(window));
+  if (!data || offset < 0 || length < 0 ||
+      offset + static_cast<jlong>(length) >
+          env->GetDirectBufferCapacity(window)) {
+    return JNI_FALSE;
+  }
+  return static_cast<jboolean>(!!BrotliEncoderPrimeWindow(handle->state,
+      static_cast<size_t>(length), data + offset));
+}
+
+/**
+ * Attaches a dictionary from the process-wide registry.
+ *
+ * Unlike nativeAttachDictionary no global reference is created; encoder
+ * keeps the dictionary alive with a registry reference until reset or
+ * destruction.
+ *
+ * @param cookie encoder handle
+ * @param dictionary registry handle, see nativeAcquireSharedDictionary
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeAttachSharedDictionary(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong cookie, jlong dictionary) {
+  EncoderHandle* handle = getHandle(cookie);
+  brotli4j::SharedDictionary* shared =
+      reinterpret_cast<brotli4j::SharedDictionary*>(dictionary);
+  if (!shared ||
+      handle->dictionary_count + handle->shared_dictionary_count >= 15) {
+    return JNI_FALSE;
+  }
+  if (!BrotliEncoderAttachPreparedDictionary(handle->state,
+      brotli4j::GetPreparedDictionary(shared))) {
+    return JNI_FALSE;
+  }
+  brotli4j::RetainSharedDictionary(shared);
+  handle->shared_dictionaries[handle->shared_dictionary_count] = shared;
+  handle->shared_dictionary_count++;
+  return JNI_TRUE;
+}
+
 JNIEXPORT void JNICALL
 Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeDestroyDictionary(
     JNIEnv* env, jobject /*jobj*/, jobject dictionary) {
@@ -298,6 +1860,97 @@ Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePrepareDictionary(
   return env->NewDirectByteBuffer(prepared_dictionary, 4);
 }
 
+/**
+ * Prepares a previous version of the data for delta compression.
+ *
+ * Unlike nativePrepareDictionary, the buffer is referenced, not copied; it
+ * MUST outlive the returned handle and MUST NOT be modified.
+ *
+ * @param reference direct buffer with the previous version
+ * @param quality quality the reference is going to be searched at
+ * @returns 4-byte buffer at prepared dictionary address; null on failure
+ */
+JNIEXPORT jobject JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativePrepareLeanDictionary(
+    JNIEnv* env, jobject /*jobj*/, jobject reference, jint quality) {
+  if (!reference) {
+    return nullptr;
+  }
+  uint8_t* address =
+      static_cast<uint8_t*>(env->GetDirectBufferAddress(reference));
+  if (!address) {
+    return nullptr;
+  }
+  jlong capacity = env->GetDirectBufferCapacity(reference);
+  if ((capacity <= 0) || (capacity > kMaxReferenceSize)) {
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(capacity);
+  BrotliEncoderPreparedDictionary* prepared_dictionary =
+      BrotliEncoderPrepareLeanDictionary(size, address, quality,
+        nullptr, nullptr, nullptr);
+  if (!prepared_dictionary) {
+    return nullptr;
+  }
+  return env->NewDirectByteBuffer(prepared_dictionary, 4);
+}
+
+/**
+ * Prepares a dictionary through the process-wide registry.
+ *
+ * If a dictionary of the same type and contents is already registered, it
+ * is returned without being prepared again.
+ *
+ * @returns registry handle that owns one reference; 0 in case of error
+ */
+JNIEXPORT jlong JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeAcquireSharedDictionary(
+    JNIEnv* env, jobject /*jobj*/, jobject dictionary, jlong type) {
+  if (!dictionary) {
+    return 0;
+  }
+  uint8_t* address =
+      static_cast<uint8_t*>(env->GetDirectBufferAddress(dictionary));
+  if (!address) {
+    return 0;
+  }
+  jlong capacity = env->GetDirectBufferCapacity(dictionary);
+  if ((capacity <= 0) || (capacity >= (1 << 30))) {
+    return 0;
+  }
+  brotli4j::SharedDictionary* shared = brotli4j::AcquireSharedDictionary(
+      static_cast<BrotliSharedDictionaryType>(type), address,
+      static_cast<size_t>(capacity));
+  return reinterpret_cast<jlong>(shared);
+}
+
+/**
+ * Creates a view of the registry dictionary for nativeAttachDictionary.
+ *
+ * The view does not own a reference.
+ */
+JNIEXPORT jobject JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeSharedDictionaryData(
+    JNIEnv* env, jobject /*jobj*/, jlong dictionary) {
+  brotli4j::SharedDictionary* shared =
+      reinterpret_cast<brotli4j::SharedDictionary*>(dictionary);
+  /* Size is 4 - just enough to check magic bytes. */
+  return env->NewDirectByteBuffer(brotli4j::GetPreparedDictionary(shared), 4);
+}
+
+/**
+ * Drops the reference owned by a registry handle.
+ */
+JNIEXPORT void JNICALL
+Java_com_aayushatharva_brotli4j_encoder_EncoderJNI_nativeReleaseSharedDictionary(
+    JNIEnv* /*env*/, jobject /*jobj*/, jlong dictionary) {
+  if (dictionary == 0) {
+    return;
+  }
+  brotli4j::ReleaseSharedDictionary(
+      reinterpret_cast<brotli4j::SharedDictionary*>(dictionary));
+}
+
 #ifdef __cplusplus
 }
 #endif
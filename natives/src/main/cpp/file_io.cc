@@ -0,0 +1,146 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "file_io.h"
+
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(_WIN32)
+/* Converts UTF-8 |path| to a new wide string; nullptr on failure. */
+wchar_t* WidePath(const char* path) {
+  int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+  if (length <= 0) return nullptr;
+  wchar_t* result = new (std::nothrow) wchar_t[length];
+  if (result && MultiByteToWideChar(CP_UTF8, 0, path, -1, result, length) <= 0) {
+    delete[] result;
+    result = nullptr;
+  }
+  return result;
+}
+#endif
+
+}  /* namespace */
+
+namespace brotli4j {
+
+#if defined(_WIN32)
+
+bool MapFile(const char* path, MappedFile* file) {
+  file->data = nullptr;
+  file->size = 0;
+  file->mapping = nullptr;
+  wchar_t* wide_path = WidePath(path);
+  if (!wide_path) return false;
+  HANDLE handle = CreateFileW(wide_path, GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  delete[] wide_path;
+  if (handle == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  bool ok = !!GetFileSizeEx(handle, &size) &&
+      static_cast<unsigned long long>(size.QuadPart) <= SIZE_MAX;
+  if (ok && size.QuadPart != 0) {
+    HANDLE mapping =
+        CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ok = !!mapping;
+    if (ok) {
+      file->data = static_cast<const uint8_t*>(
+          MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      ok = !!file->data;
+      if (ok) {
+        file->size = static_cast<size_t>(size.QuadPart);
+        file->mapping = mapping;
+      } else {
+        CloseHandle(mapping);
+      }
+    }
+  }
+  CloseHandle(handle);
+  return ok;
+}
+
+void UnmapFile(MappedFile* file) {
+  if (file->data) {
+    UnmapViewOfFile(file->data);
+    CloseHandle(static_cast<HANDLE>(file->mapping));
+  }
+  file->data = nullptr;
+  file->size = 0;
+  file->mapping = nullptr;
+}
+
+FILE* OpenOutputFile(const char* path) {
+  wchar_t* wide_path = WidePath(path);
+  if (!wide_path) return nullptr;
+  FILE* result = _wfopen(wide_path, L"wb");
+  delete[] wide_path;
+  return result;
+}
+
+#else
+
+bool MapFile(const char* path, MappedFile* file) {
+  file->data = nullptr;
+  file->size = 0;
+  file->mapping = nullptr;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat info;
+  bool ok = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+      static_cast<unsigned long long>(info.st_size) <= SIZE_MAX;
+  if (ok && info.st_size != 0) {
+    size_t size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ok = data != MAP_FAILED;
+    if (ok) {
+#if defined(MADV_SEQUENTIAL)
+      madvise(data, size, MADV_SEQUENTIAL);
+#endif
+      file->data = static_cast<const uint8_t*>(data);
+      file->size = size;
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+void UnmapFile(MappedFile* file) {
+  if (file->data) {
+    munmap(const_cast<uint8_t*>(file->data), file->size);
+  }
+  file->data = nullptr;
+  file->size = 0;
+}
+
+FILE* OpenOutputFile(const char* path) {
+  return fopen(path, "wb");
+}
+
+#endif
+
+}  /* namespace brotli4j */
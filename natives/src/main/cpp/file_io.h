@@ -0,0 +1,50 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BROTLI4J_FILE_IO_H_
+#define BROTLI4J_FILE_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace brotli4j {
+
+/* Read-only mapping of a whole file. */
+typedef struct MappedFile {
+  /* nullptr for an empty file. */
+  const uint8_t* data;
+  size_t size;
+  /* Platform handle of the mapping. */
+  void* mapping;
+} MappedFile;
+
+/* Maps file at UTF-8 |path|; returns false if it can not be opened or
+   mapped. Pages are advised to be read sequentially. */
+bool MapFile(const char* path, MappedFile* file);
+
+/* Unmaps |file|; safe to call on an empty one. */
+void UnmapFile(MappedFile* file);
+
+/* Creates or truncates file at UTF-8 |path| for binary writing; nullptr on
+   failure. */
+FILE* OpenOutputFile(const char* path);
+
+}  /* namespace brotli4j */
+
+#endif  /* BROTLI4J_FILE_IO_H_ */
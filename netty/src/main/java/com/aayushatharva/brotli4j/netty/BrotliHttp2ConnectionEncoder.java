@@ -0,0 +1,58 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.netty;
+
+import io.netty.channel.ChannelHandlerContext;
+import io.netty.channel.embedded.EmbeddedChannel;
+import io.netty.handler.codec.http2.CompressorHttp2ConnectionEncoder;
+import io.netty.handler.codec.http2.Http2ConnectionEncoder;
+import io.netty.handler.codec.http2.Http2Exception;
+import io.netty.util.AsciiString;
+
+/**
+ * {@link CompressorHttp2ConnectionEncoder} that compresses streams with
+ * {@code content-encoding: br} through {@link NativeBrotliEncoder}.
+ * <p>
+ * Every DATA frame is pushed with a single brotli flush, so the peer can decode each
+ * frame as soon as it arrives and no flush is issued within a frame; the last frame
+ * finishes the stream and returns the native encoder to the pool.
+ */
+public class BrotliHttp2ConnectionEncoder extends CompressorHttp2ConnectionEncoder {
+    private static final AsciiString BR = AsciiString.cached("br");
+
+    private final NativeEncoderPool pool;
+
+    /**
+     * @param delegate encoder to pass compressed frames to
+     * @param pool     pool to take native encoders from
+     */
+    public BrotliHttp2ConnectionEncoder(Http2ConnectionEncoder delegate, NativeEncoderPool pool) {
+        super(delegate);
+        this.pool = pool;
+    }
+
+    @Override
+    protected EmbeddedChannel newContentCompressor(ChannelHandlerContext ctx, CharSequence contentEncoding)
+            throws Http2Exception {
+        if (BR.contentEqualsIgnoreCase(contentEncoding)) {
+            return new EmbeddedChannel(ctx.channel().id(), ctx.channel().metadata().hasDisconnect(),
+                    ctx.channel().config(), new NativeBrotliEncoder(pool));
+        }
+        return super.newContentCompressor(ctx, contentEncoding);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.netty;
+
+import io.netty.channel.ChannelHandlerContext;
+import io.netty.channel.embedded.EmbeddedChannel;
+import io.netty.handler.codec.http.HttpContentCompressor;
+import io.netty.handler.codec.http.HttpHeaderNames;
+import io.netty.handler.codec.http.HttpResponse;
+
+/**
+ * {@link HttpContentCompressor} that serves {@code br} through {@link NativeBrotliEncoder}.
+ * <p>
+ * Responses of clients that accept brotli are compressed with pooled native encoders;
+ * other encodings are negotiated by {@link HttpContentCompressor} as usual. Output of
+ * every HTTP content is flushed, so chunked responses stream without delay.
+ */
+public class BrotliHttpContentCompressor extends HttpContentCompressor {
+    private final NativeEncoderPool pool;
+    private ChannelHandlerContext ctx;
+
+    /**
+     * @param pool pool to take native encoders from
+     */
+    public BrotliHttpContentCompressor(NativeEncoderPool pool) {
+        this.pool = pool;
+    }
+
+    @Override
+    public void handlerAdded(ChannelHandlerContext ctx) throws Exception {
+        this.ctx = ctx;
+        super.handlerAdded(ctx);
+    }
+
+    @Override
+    protected Result beginEncode(HttpResponse httpResponse, String acceptEncoding) throws Exception {
+        if (httpResponse.headers().contains(HttpHeaderNames.CONTENT_ENCODING) || !acceptsBrotli(acceptEncoding)) {
+            return super.beginEncode(httpResponse, acceptEncoding);
+        }
+        return new Result("br", new EmbeddedChannel(ctx.channel().id(), ctx.channel().metadata().hasDisconnect(),
+                ctx.channel().config(), new NativeBrotliEncoder(pool)));
+    }
+
+    /**
+     * Returns {@code true} if {@code br} is listed in Accept-Encoding with non-zero weight.
+     */
+    static boolean acceptsBrotli(String acceptEncoding) {
+        for (String coding : acceptEncoding.split(",")) {
+            int semicolon = coding.indexOf(';');
+            String name = (semicolon < 0 ? coding : coding.substring(0, semicolon)).trim();
+            if (!name.equalsIgnoreCase("br")) {
+                continue;
+            }
+            if (semicolon < 0) {
+                return true;
+            }
+            int equals = coding.indexOf('=', semicolon);
+            if (equals < 0) {
+                return true;
+            }
+            try {
+                return Float.parseFloat(coding.substring(equals + 1).trim()) > 0;
+            } catch (NumberFormatException e) {
+                return false;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,203 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.netty;
+
+import com.aayushatharva.brotli4j.encoder.DirectEncoder;
+import io.netty.buffer.ByteBuf;
+import io.netty.buffer.Unpooled;
+import io.netty.channel.ChannelHandlerContext;
+import io.netty.channel.ChannelOutboundHandlerAdapter;
+import io.netty.channel.ChannelPromise;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * Compresses outbound {@link ByteBuf}s into a single brotli stream.
+ * <p>
+ * Native encoder is taken from a {@link NativeEncoderPool} for the first write and
+ * returned to it when the stream is finished. Direct input buffers are read in place;
+ * heap ones are copied once into a pooled direct buffer. Output is written straight into
+ * pooled direct buffers of the channel allocator, which are passed on when they are full.
+ * <p>
+ * Each {@code flush()} completes the current brotli block (BROTLI_OPERATION_FLUSH), so
+ * everything written so far can be decoded; the content encoders of this module invoke
+ * it exactly once per HTTP content or HTTP/2 DATA frame. Closing the channel finishes the
+ * stream. Instances are not sharable.
+ */
+public final class NativeBrotliEncoder extends ChannelOutboundHandlerAdapter {
+    private static final int PROCESS = 0;
+    private static final int FLUSH = 1;
+    private static final int FINISH = 2;
+
+    private static final int DEFAULT_OUTPUT_CHUNK_SIZE = 16384;
+    private static final ByteBuffer[] NO_INPUT = new ByteBuffer[0];
+
+    private final NativeEncoderPool pool;
+    private final int outputChunkSize;
+    private final ByteBuffer[] dsts = new ByteBuffer[1];
+    private DirectEncoder encoder;
+    private ByteBuf output;
+    private boolean finished;
+
+    /**
+     * @param pool pool to take native encoder from
+     */
+    public NativeBrotliEncoder(NativeEncoderPool pool) {
+        this(pool, DEFAULT_OUTPUT_CHUNK_SIZE);
+    }
+
+    /**
+     * @param pool            pool to take native encoder from
+     * @param outputChunkSize capacity of output buffers passed to the next handler
+     */
+    public NativeBrotliEncoder(NativeEncoderPool pool, int outputChunkSize) {
+        if (outputChunkSize <= 0) {
+            throw new IllegalArgumentException("outputChunkSize should be positive");
+        }
+        this.pool = pool;
+        this.outputChunkSize = outputChunkSize;
+    }
+
+    /**
+     * Returns {@code true} if the stream is finished; further writes are rejected.
+     */
+    public boolean isFinished() {
+        return finished;
+    }
+
+    @Override
+    public void write(ChannelHandlerContext ctx, Object msg, ChannelPromise promise) throws Exception {
+        if (!(msg instanceof ByteBuf)) {
+            ctx.write(msg, promise);
+            return;
+        }
+        ByteBuf in = (ByteBuf) msg;
+        ByteBuf copy = null;
+        try {
+            if (finished) {
+                throw new IOException("brotli stream is already finished");
+            }
+            if (!in.isReadable()) {
+                ctx.write(Unpooled.EMPTY_BUFFER, promise);
+                return;
+            }
+            if (!in.isDirect()) {
+                copy = ctx.alloc().directBuffer(in.readableBytes());
+                copy.writeBytes(in, in.readerIndex(), in.readableBytes());
+            }
+            ByteBuf source = copy != null ? copy : in;
+            encode(ctx, PROCESS, source.nioBuffers(source.readerIndex(), source.readableBytes()));
+            in.skipBytes(in.readableBytes());
+        } finally {
+            in.release();
+            if (copy != null) {
+                copy.release();
+            }
+        }
+        // Compressed bytes may stay buffered till flush; the write is complete once consumed.
+        ctx.write(Unpooled.EMPTY_BUFFER, promise);
+    }
+
+    @Override
+    public void flush(ChannelHandlerContext ctx) throws Exception {
+        if (encoder != null && !finished) {
+            encode(ctx, FLUSH, NO_INPUT);
+            emitOutput(ctx);
+        }
+        ctx.flush();
+    }
+
+    @Override
+    public void close(ChannelHandlerContext ctx, ChannelPromise promise) throws Exception {
+        try {
+            finish(ctx);
+        } finally {
+            ctx.flush();
+            ctx.close(promise);
+        }
+    }
+
+    @Override
+    public void handlerRemoved(ChannelHandlerContext ctx) {
+        if (encoder != null) {
+            // Stream is not finished; encoder can not be reset to a usable state cheaply.
+            encoder.close();
+            encoder = null;
+        }
+        if (output != null) {
+            output.release();
+            output = null;
+        }
+    }
+
+    private void finish(ChannelHandlerContext ctx) throws IOException {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        encode(ctx, FINISH, NO_INPUT);
+        emitOutput(ctx);
+        DirectEncoder done = encoder;
+        encoder = null;
+        pool.release(done);
+    }
+
+    /**
+     * Pushes input through the native encoder; full output buffers are written to the
+     * next handler.
+     */
+    private void encode(ChannelHandlerContext ctx, int op, ByteBuffer[] srcs) throws IOException {
+        if (encoder == null) {
+            encoder = pool.acquire();
+        }
+        boolean done;
+        do {
+            if (output == null) {
+                output = ctx.alloc().directBuffer(outputChunkSize);
+            }
+            int writerIndex = output.writerIndex();
+            ByteBuffer dst = output.internalNioBuffer(writerIndex, output.writableBytes());
+            int start = dst.position();
+            dsts[0] = dst;
+            switch (op) {
+                case PROCESS:
+                    done = encoder.process(srcs, dsts);
+                    break;
+                case FLUSH:
+                    done = encoder.flush(srcs, dsts);
+                    break;
+                default:
+                    done = encoder.finish(srcs, dsts);
+                    break;
+            }
+            output.writerIndex(writerIndex + dst.position() - start);
+            if (!output.isWritable()) {
+                ctx.write(output);
+                output = null;
+            }
+        } while (!done);
+    }
+
+    private void emitOutput(ChannelHandlerContext ctx) {
+        if (output != null && output.isReadable()) {
+            ctx.write(output);
+            output = null;
+        }
+    }
+}
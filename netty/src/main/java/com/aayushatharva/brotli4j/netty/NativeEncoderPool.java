@@ -0,0 +1,95 @@
+/*
+ * This file is part of Brotli4j.
+ * Copyright (c) 2020-2021 Aayush Atharva
+ *
+ * Brotli4j is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Brotli4j is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Brotli4j.  If not, see <https://www.gnu.org/licenses/>.
+ */
+package com.aayushatharva.brotli4j.netty;
+
+import com.aayushatharva.brotli4j.encoder.DirectEncoder;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+import io.netty.util.concurrent.FastThreadLocal;
+
+import java.io.IOException;
+import java.util.ArrayDeque;
+
+/**
+ * Pool of resettable native encoders with the same parameters, kept per event loop.
+ * <p>
+ * Each event loop thread takes and returns encoders without synchronization; idle
+ * encoders are destroyed when the thread terminates. Reusing an encoder saves allocation
+ * and zeroing of its ring buffer and hash tables on every response.
+ */
+public final class NativeEncoderPool {
+    private static final int DEFAULT_MAX_IDLE = 16;
+
+    private final Encoder.Parameters params;
+    private final int maxIdle;
+    private final FastThreadLocal<ArrayDeque<DirectEncoder>> idle = new FastThreadLocal<ArrayDeque<DirectEncoder>>() {
+        @Override
+        protected ArrayDeque<DirectEncoder> initialValue() {
+            return new ArrayDeque<>();
+        }
+
+        @Override
+        protected void onRemoval(ArrayDeque<DirectEncoder> encoders) {
+            for (DirectEncoder encoder : encoders) {
+                encoder.close();
+            }
+            encoders.clear();
+        }
+    };
+
+    /**
+     * @param params encoding parameters of pooled encoders
+     */
+    public NativeEncoderPool(Encoder.Parameters params) {
+        this(params, DEFAULT_MAX_IDLE);
+    }
+
+    /**
+     * @param params  encoding parameters of pooled encoders
+     * @param maxIdle maximal number of idle encoders kept per thread
+     */
+    public NativeEncoderPool(Encoder.Parameters params, int maxIdle) {
+        if (maxIdle < 0) {
+            throw new IllegalArgumentException("maxIdle should be non-negative");
+        }
+        this.params = params;
+        this.maxIdle = maxIdle;
+    }
+
+    /**
+     * Takes an idle encoder of the current thread, or creates a new one.
+     */
+    public DirectEncoder acquire() throws IOException {
+        DirectEncoder encoder = idle.get().pollFirst();
+        return encoder != null ? encoder : new DirectEncoder(params);
+    }
+
+    /**
+     * Resets the encoder and returns it to the pool of the current thread.
+     */
+    public void release(DirectEncoder encoder) {
+        if (!encoder.reset()) {
+            encoder.close();
+            return;
+        }
+        ArrayDeque<DirectEncoder> encoders = idle.get();
+        encoders.addFirst(encoder);
+        if (encoders.size() > maxIdle) {
+            encoders.removeLast().close();
+        }
+    }
+}
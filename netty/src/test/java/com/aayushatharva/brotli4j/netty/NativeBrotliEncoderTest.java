@@ -0,0 +1,117 @@
+/*
+ *   Copyright 2021, Aayush Atharva
+ *
+ *   Brotli4j licenses this file to you under the
+ *   Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+package com.aayushatharva.brotli4j.netty;
+
+import com.aayushatharva.brotli4j.Brotli4jLoader;
+import com.aayushatharva.brotli4j.decoder.Decoder;
+import com.aayushatharva.brotli4j.decoder.DecoderJNI;
+import com.aayushatharva.brotli4j.decoder.DirectDecompress;
+import com.aayushatharva.brotli4j.encoder.Encoder;
+import io.netty.buffer.ByteBuf;
+import io.netty.buffer.ByteBufAllocator;
+import io.netty.buffer.Unpooled;
+import io.netty.channel.embedded.EmbeddedChannel;
+import org.junit.jupiter.api.BeforeAll;
+import org.junit.jupiter.api.Test;
+
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.nio.charset.StandardCharsets;
+
+import static org.junit.jupiter.api.Assertions.*;
+
+class NativeBrotliEncoderTest {
+
+    @BeforeAll
+    static void load() {
+        Brotli4jLoader.ensureAvailability();
+    }
+
+    private static byte[] testData() {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < 20000; i++) {
+            sb.append("<li>item ").append(i % 397).append(" of a streamed response</li>\n");
+        }
+        return sb.toString().getBytes(StandardCharsets.UTF_8);
+    }
+
+    private static byte[] drain(EmbeddedChannel channel, ByteArrayOutputStream sink) {
+        ByteBuf buf;
+        while ((buf = channel.readOutbound()) != null) {
+            byte[] bytes = new byte[buf.readableBytes()];
+            buf.readBytes(bytes);
+            buf.release();
+            sink.write(bytes, 0, bytes.length);
+        }
+        return sink.toByteArray();
+    }
+
+    private static byte[] decode(byte[] compressed) throws IOException {
+        DirectDecompress result = Decoder.decompress(compressed);
+        assertEquals(DecoderJNI.Status.DONE, result.getResultStatus());
+        return result.getDecompressedData();
+    }
+
+    @Test
+    void directAndHeapChunksRoundTrip() throws IOException {
+        byte[] data = testData();
+        NativeEncoderPool pool = new NativeEncoderPool(new Encoder.Parameters().setQuality(5));
+        EmbeddedChannel channel = new EmbeddedChannel(new NativeBrotliEncoder(pool, 1024));
+        ByteArrayOutputStream sink = new ByteArrayOutputStream();
+        int half = data.length / 2;
+
+        ByteBuf direct = ByteBufAllocator.DEFAULT.directBuffer(half);
+        direct.writeBytes(data, 0, half);
+        assertTrue(channel.writeOutbound(direct));
+        // Every flush completes a block, so the first half is out before the rest is written.
+        assertTrue(drain(channel, sink).length > 0);
+
+        channel.writeOutbound(Unpooled.wrappedBuffer(data, half, data.length - half));
+        channel.finish();
+        byte[] compressed = drain(channel, sink);
+
+        assertTrue(compressed.length < data.length / 4);
+        assertArrayEquals(data, decode(compressed));
+    }
+
+    @Test
+    void pooledEncoderIsReused() throws IOException {
+        byte[] data = testData();
+        NativeEncoderPool pool = new NativeEncoderPool(new Encoder.Parameters().setQuality(4));
+        byte[] first = null;
+        for (int i = 0; i < 3; i++) {
+            EmbeddedChannel channel = new EmbeddedChannel(new NativeBrotliEncoder(pool));
+            channel.writeOutbound(Unpooled.wrappedBuffer(data));
+            channel.finish();
+            byte[] compressed = drain(channel, new ByteArrayOutputStream());
+            if (first == null) {
+                first = compressed;
+            }
+            // Reset encoder produces exactly the same stream.
+            assertArrayEquals(first, compressed);
+            assertArrayEquals(data, decode(compressed));
+        }
+    }
+
+    @Test
+    void acceptEncodingNegotiation() {
+        assertTrue(BrotliHttpContentCompressor.acceptsBrotli("gzip, deflate, br"));
+        assertTrue(BrotliHttpContentCompressor.acceptsBrotli("br;q=0.5, gzip;q=1.0"));
+        assertFalse(BrotliHttpContentCompressor.acceptsBrotli("br;q=0, gzip"));
+        assertFalse(BrotliHttpContentCompressor.acceptsBrotli("gzip, brotli"));
+    }
+}